@@ -113,6 +113,17 @@ end package;
 
 package body textio is
 
+    subtype read_chunk_t is string(1 to 128);
+
+    -- Reads characters up to the end of the line or the end of the chunk
+    -- and sets EOL if the end of the line or file was reached
+    procedure nvc_read_chunk (file f : text;
+                              chunk  : out read_chunk_t;
+                              used   : out natural;
+                              eol    : out boolean);
+
+    attribute foreign of nvc_read_chunk : procedure is "_nvc_textio_read_chunk";
+
     procedure grow (l        : inout line;
                     extra    : in natural;
                     old_size : out natural ) is
@@ -240,10 +251,49 @@ package body textio is
 
     procedure read (l     : inout line;
                     value : out integer;
-                    good  : out boolean ) is
+                    good  : out boolean )
+    is
+        alias s       : string(1 to l'length) is l.all;
+        variable pos    : positive := 1;
+        variable neg    : boolean := false;
+        variable digit  : natural;
+        variable result : integer := 0;
     begin
-        -- TODO
-        report "unimplemented" severity failure;
+        good := false;
+
+        while pos <= s'length and (s(pos) = ' ' or s(pos) = HT) loop
+            pos := pos + 1;
+        end loop;
+
+        if pos <= s'length and (s(pos) = '-' or s(pos) = '+') then
+            neg := s(pos) = '-';
+            pos := pos + 1;
+        end if;
+
+        if pos > s'length or s(pos) < '0' or s(pos) > '9' then
+            return;
+        end if;
+
+        -- Accumulate a negative result so integer'low can be read
+        while pos <= s'length and s(pos) >= '0' and s(pos) <= '9' loop
+            digit := character'pos(s(pos)) - character'pos('0');
+            if result < (integer'low + digit) / 10 then
+                return;
+            end if;
+            result := result * 10 - digit;
+            pos := pos + 1;
+        end loop;
+
+        if neg then
+            value := result;
+        elsif result = integer'low then
+            return;
+        else
+            value := -result;
+        end if;
+
+        consume(l, pos - 1);
+        good := true;
     end procedure;
 
     procedure read (l     : inout line;
@@ -312,40 +362,38 @@ package body textio is
     end procedure;
 
     procedure readline (file f: text; l: inout line) is
-        variable tmp  : line;
-        variable ch   : string(1 to 1);
-        variable used : natural;
-        variable got  : integer;
+        variable tmp   : line;
+        variable chunk : read_chunk_t;
+        variable used  : natural;
+        variable got   : natural;
+        variable eol   : boolean;
+        variable old   : natural;
     begin
         if l /= null then
             deallocate(l);
         end if;
 
-        tmp := new string(1 to 128);
+        -- Reading a chunk at a time avoids a call into the runtime and
+        -- an ENDFILE check for every character
+        tmp := new string(1 to chunk'length);
         loop
-            exit when endfile(f);
-
-            read(f, ch, got);
-            exit when got /= 1;
-
-            next when ch(1) = CR;
-
-            if ch(1) = LF then
-                exit;
-            else
-                if used = tmp'length then
-                    grow(tmp, 128, used);
-                end if;
-                used := used + 1;
-                tmp(used) := ch(1);
+            nvc_read_chunk(f, chunk, got, eol);
+            if used + got > tmp'length then
+                grow(tmp, tmp'length, old);
             end if;
+            tmp(used + 1 to used + got) := chunk(1 to got);
+            used := used + got;
+            exit when eol;
         end loop;
 
         if used = 0 then
+            deallocate(tmp);
             l := new string'("");
-        else
+        elsif used < tmp'length then
             shrink(tmp, used);
             l := tmp;
+        else
+            l := tmp;
         end if;
     end procedure;
 
@@ -21,11 +21,14 @@
 #include "common.h"
 #include "vcode.h"
 #include "array.h"
+#include "hash.h"
 #include "rt/rt.h"
 #include "rt/cover.h"
+#include "rt/meta.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <llvm-c/Core.h>
 #include <llvm-c/BitWriter.h>
@@ -60,6 +63,8 @@ DECLARE_AND_DEFINE_ARRAY(size_list)
 static LLVMModuleRef  module = NULL;
 static LLVMBuilderRef builder = NULL;
 static LLVMValueRef   mod_name = NULL;
+static hash_t        *pgo_counts = NULL;
+static uint64_t       pgo_max = 0;
 
 static LLVMValueRef cgen_support_fn(const char *name);
 
@@ -311,8 +316,10 @@ static LLVMValueRef cgen_get_var(vcode_var_t var, cgen_ctx_t *ctx)
 
 static LLVMValueRef cgen_tmp_alloc(LLVMValueRef bytes, LLVMTypeRef type)
 {
-   LLVMValueRef _tmp_stack_ptr = LLVMGetNamedGlobal(module, "_tmp_stack");
-   LLVMValueRef _tmp_alloc_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   LLVMValueRef _tmp_stack_ptr =
+      LLVMBuildCall(builder, llvm_fn("_tmp_stack_ptr"), NULL, 0, "");
+   LLVMValueRef _tmp_alloc_ptr =
+      LLVMBuildCall(builder, llvm_fn("_tmp_alloc_ptr"), NULL, 0, "");
 
    LLVMValueRef alloc = LLVMBuildLoad(builder, _tmp_alloc_ptr, "alloc");
    LLVMValueRef stack = LLVMBuildLoad(builder, _tmp_stack_ptr, "stack");
@@ -1101,13 +1108,42 @@ static void cgen_op_image(int op, cgen_ctx_t *ctx)
    vcode_reg_t arg = vcode_get_arg(op, 0);
    vcode_type_t arg_type = vcode_reg_type(arg);
    vtype_kind_t arg_kind = vtype_kind(arg_type);
+   vcode_reg_t result = vcode_get_result(op);
 
-   const bool is_signed = arg_kind == VCODE_TYPE_INT && vtype_low(arg_type) < 0;
-   const bool real = (arg_kind == VCODE_TYPE_REAL);
-   LLVMOpcode cop = real ? LLVMBitCast : (is_signed ? LLVMSExt : LLVMZExt);
    LLVMValueRef res = LLVMBuildAlloca(builder,
                                       llvm_uarray_type(LLVMInt8Type(), 1),
                                       "image");
+
+   // Integers and reals need no type information so avoid recalling the
+   // tree at runtime
+   switch (vcode_get_subkind(op)) {
+   case IMAGE_INTEGER:
+      {
+         const bool is_signed = vtype_low(arg_type) < 0;
+         LLVMValueRef iargs[] = {
+            LLVMBuildCast(builder, is_signed ? LLVMSExt : LLVMZExt,
+                          ctx->regs[arg], LLVMInt64Type(), ""),
+            res
+         };
+         LLVMBuildCall(builder, llvm_fn("_image_int"),
+                       iargs, ARRAY_LEN(iargs), "");
+         ctx->regs[result] = LLVMBuildLoad(builder, res, cgen_reg_name(result));
+      }
+      return;
+
+   case IMAGE_REAL:
+      {
+         LLVMValueRef iargs[] = { ctx->regs[arg], res };
+         LLVMBuildCall(builder, llvm_fn("_image_real"),
+                       iargs, ARRAY_LEN(iargs), "");
+         ctx->regs[result] = LLVMBuildLoad(builder, res, cgen_reg_name(result));
+      }
+      return;
+   }
+
+   const bool is_signed = arg_kind == VCODE_TYPE_INT && vtype_low(arg_type) < 0;
+   const bool real = (arg_kind == VCODE_TYPE_REAL);
+   LLVMOpcode cop = real ? LLVMBitCast : (is_signed ? LLVMSExt : LLVMZExt);
    LLVMValueRef iargs[] = {
       LLVMBuildCast(builder, cop, ctx->regs[arg], LLVMInt64Type(), ""),
       llvm_int32(vcode_get_index(op)),
@@ -1117,7 +1153,6 @@ static void cgen_op_image(int op, cgen_ctx_t *ctx)
    };
    LLVMBuildCall(builder, llvm_fn("_image"), iargs, ARRAY_LEN(iargs), "");
 
-   vcode_reg_t result = vcode_get_result(op);
    ctx->regs[result] = LLVMBuildLoad(builder, res, cgen_reg_name(result));
 }
 
@@ -1172,6 +1207,32 @@ static void cgen_op_cast(int op, cgen_ctx_t *ctx)
                                         cgen_reg_name(result));
 }
 
+static LLVMValueRef cgen_entry_alloca(LLVMTypeRef type, LLVMValueRef count,
+                                      const char *name, cgen_ctx_t *ctx)
+{
+   // A fixed size alloca placed in the entry block is allocated once
+   // in the function prologue and can be promoted to SSA values by
+   // LLVM whereas one inside a loop grows the stack on each iteration
+
+   LLVMBasicBlockRef entry_bb = LLVMGetEntryBasicBlock(ctx->fn);
+   LLVMValueRef first = LLVMGetFirstInstruction(entry_bb);
+
+   LLVMBuilderRef entry_builder = LLVMCreateBuilder();
+   if (first != NULL)
+      LLVMPositionBuilderBefore(entry_builder, first);
+   else
+      LLVMPositionBuilderAtEnd(entry_builder, entry_bb);
+
+   LLVMValueRef ptr;
+   if (count == NULL)
+      ptr = LLVMBuildAlloca(entry_builder, type, name);
+   else
+      ptr = LLVMBuildArrayAlloca(entry_builder, type, count, name);
+
+   LLVMDisposeBuilder(entry_builder);
+   return ptr;
+}
+
 static void cgen_op_alloca(int op, cgen_ctx_t *ctx)
 {
    vcode_reg_t result = vcode_get_result(op);
@@ -1183,12 +1244,17 @@ static void cgen_op_alloca(int op, cgen_ctx_t *ctx)
          bytes = LLVMBuildMul(builder, bytes, cgen_get_arg(op, 0, ctx), "");
       ctx->regs[result] = cgen_tmp_alloc(bytes, type);
    }
-   else if (vcode_count_args(op) == 0)
-      ctx->regs[result] = LLVMBuildAlloca(builder, type, cgen_reg_name(result));
    else {
-      LLVMValueRef count = cgen_get_arg(op, 0, ctx);
-      ctx->regs[result] = LLVMBuildArrayAlloca(builder, type, count,
-                                               cgen_reg_name(result));
+      LLVMValueRef count = NULL;
+      if (vcode_count_args(op) > 0)
+         count = cgen_get_arg(op, 0, ctx);
+
+      if (count == NULL || LLVMIsConstant(count))
+         ctx->regs[result] = cgen_entry_alloca(type, count,
+                                               cgen_reg_name(result), ctx);
+      else
+         ctx->regs[result] = LLVMBuildArrayAlloca(builder, type, count,
+                                                  cgen_reg_name(result));
    }
 }
 
@@ -2113,8 +2179,11 @@ static void cgen_op_bit_shift(int op, cgen_ctx_t *ctx)
 
 static void cgen_op_bit_vec_op(int op, cgen_ctx_t *ctx)
 {
-   LLVMValueRef tmp = LLVMBuildAlloca(builder,
-                                      llvm_uarray_type(LLVMInt1Type(), 1),
+   // Operations on std_logic vectors have byte elements
+   const bool logic = vcode_get_subkind(op) >= LOGIC_VEC_NOT;
+   LLVMTypeRef elem = logic ? LLVMInt8Type() : LLVMInt1Type();
+
+   LLVMValueRef tmp = LLVMBuildAlloca(builder, llvm_uarray_type(elem, 1),
                                       "bit_vec_op");
 
    LLVMValueRef left_data = cgen_get_arg(op, 0, ctx);
@@ -2128,7 +2197,7 @@ static void cgen_op_bit_vec_op(int op, cgen_ctx_t *ctx)
       right_dir  = cgen_get_arg(op, 5, ctx);
    }
    else {
-      right_data = LLVMConstNull(LLVMPointerType(LLVMInt1Type(), 0));
+      right_data = LLVMConstNull(LLVMPointerType(elem, 0));
       right_len  = llvm_int32(0);
       right_dir  = llvm_int1(0);
    }
@@ -2143,7 +2212,8 @@ static void cgen_op_bit_vec_op(int op, cgen_ctx_t *ctx)
       right_dir,
       tmp
    };
-   LLVMBuildCall(builder, llvm_fn("_bit_vec_op"), args, ARRAY_LEN(args), "");
+   LLVMBuildCall(builder, llvm_fn(logic ? "_logic_vec_op" : "_bit_vec_op"),
+                 args, ARRAY_LEN(args), "");
 
    vcode_reg_t result = vcode_get_result(op);
    ctx->regs[result] = LLVMBuildLoad(builder, tmp, cgen_reg_name(result));
@@ -2291,10 +2361,42 @@ static void cgen_op_cover_stmt(int op, cgen_ctx_t *ctx)
    LLVMValueRef count_ptr = LLVMBuildGEP(builder, cover_counts,
                                          indexes, ARRAY_LEN(indexes), "");
 
-   LLVMValueRef count = LLVMBuildLoad(builder, count_ptr, "cover_count");
-   LLVMValueRef count1 = LLVMBuildAdd(builder, count, llvm_int32(1), "");
+   switch (opt_get_int("cover")) {
+   case COVER_BITMAP:
+      // A plain store does not depend on the previous value
+      LLVMBuildStore(builder, llvm_int32(1), count_ptr);
+      break;
+
+   case COVER_ONCE:
+      {
+         // The branch is always taken once the statement has been hit
+         // so the store is skipped and the cache line stays clean
+
+         LLVMBasicBlockRef hit_bb  = LLVMAppendBasicBlock(ctx->fn, "hit");
+         LLVMBasicBlockRef done_bb = LLVMAppendBasicBlock(ctx->fn, "done");
+
+         LLVMValueRef count = LLVMBuildLoad(builder, count_ptr, "");
+         LLVMValueRef seen  = LLVMBuildICmp(builder, LLVMIntNE, count,
+                                            llvm_int32(0), "");
+         LLVMBuildCondBr(builder, seen, done_bb, hit_bb);
+
+         LLVMPositionBuilderAtEnd(builder, hit_bb);
+         LLVMBuildStore(builder, llvm_int32(1), count_ptr);
+         LLVMBuildBr(builder, done_bb);
 
-   LLVMBuildStore(builder, count1, count_ptr);
+         LLVMPositionBuilderAtEnd(builder, done_bb);
+      }
+      break;
+
+   default:
+      {
+         LLVMValueRef count = LLVMBuildLoad(builder, count_ptr, "cover_count");
+         LLVMValueRef count1 = LLVMBuildAdd(builder, count, llvm_int32(1), "");
+
+         LLVMBuildStore(builder, count1, count_ptr);
+      }
+      break;
+   }
 }
 
 static void cgen_op_cover_cond(int op, cgen_ctx_t *ctx)
@@ -2320,12 +2422,28 @@ static void cgen_op_cover_cond(int op, cgen_ctx_t *ctx)
 
    LLVMValueRef mask1 = LLVMBuildOr(builder, mask, or, "");
 
-   LLVMBuildStore(builder, mask1, mask_ptr);
+   if (opt_get_int("cover") == COVER_ONCE) {
+      // Only write the mask back if this outcome has not been seen
+      LLVMBasicBlockRef hit_bb  = LLVMAppendBasicBlock(ctx->fn, "hit");
+      LLVMBasicBlockRef done_bb = LLVMAppendBasicBlock(ctx->fn, "done");
+
+      LLVMValueRef seen = LLVMBuildICmp(builder, LLVMIntEQ, mask1, mask, "");
+      LLVMBuildCondBr(builder, seen, done_bb, hit_bb);
+
+      LLVMPositionBuilderAtEnd(builder, hit_bb);
+      LLVMBuildStore(builder, mask1, mask_ptr);
+      LLVMBuildBr(builder, done_bb);
+
+      LLVMPositionBuilderAtEnd(builder, done_bb);
+   }
+   else
+      LLVMBuildStore(builder, mask1, mask_ptr);
 }
 
 static void cgen_op_heap_save(int op, cgen_ctx_t *ctx)
 {
-   LLVMValueRef cur_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   LLVMValueRef cur_ptr =
+      LLVMBuildCall(builder, llvm_fn("_tmp_alloc_ptr"), NULL, 0, "");
 
    vcode_reg_t result = vcode_get_result(op);
    ctx->regs[result] = LLVMBuildLoad(builder, cur_ptr, cgen_reg_name(result));
@@ -2333,7 +2451,8 @@ static void cgen_op_heap_save(int op, cgen_ctx_t *ctx)
 
 static void cgen_op_heap_restore(int op, cgen_ctx_t *ctx)
 {
-   LLVMValueRef cur_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   LLVMValueRef cur_ptr =
+      LLVMBuildCall(builder, llvm_fn("_tmp_alloc_ptr"), NULL, 0, "");
    LLVMBuildStore(builder, cgen_get_arg(op, 0, ctx), cur_ptr);
 }
 
@@ -2892,6 +3011,74 @@ static void cgen_procedure(LLVMTypeRef display_type)
    cgen_free_context(&ctx);
 }
 
+static void cgen_pgo_load(const char *fname)
+{
+   // Read the process activation counts written by nvc -r --pgo-collect
+
+   FILE *f = fopen(fname, "r");
+   if (f == NULL)
+      fatal_errno("%s", fname);
+
+   pgo_counts = hash_new(1024, true);
+   pgo_max = 0;
+
+   char line[1024];
+   while (fgets(line, sizeof(line), f) != NULL) {
+      if (line[0] == '#')
+         continue;
+
+      char *name;
+      const uint64_t count = strtoull(line, &name, 10);
+      if (name == line || *name != ' ')
+         fatal("%s: malformed profile line: %s", fname, line);
+
+      name++;
+      name[strcspn(name, "\r\n")] = '\0';
+
+      // Stored off by one so a process that never ran can be told apart
+      // from one missing from the profile
+      hash_put(pgo_counts, ident_new(name), (void *)(uintptr_t)(count + 1));
+      pgo_max = MAX(pgo_max, count);
+   }
+
+   fclose(f);
+}
+
+static void cgen_pgo_process(LLVMValueRef fn, LLVMValueRef entry_br)
+{
+   // Move rarely run processes out of the way of hot ones and weight the
+   // branch taken on every activation after the first
+
+   if (pgo_counts == NULL)
+      return;
+
+   const uintptr_t entry =
+      (uintptr_t)hash_get(pgo_counts, vcode_unit_name());
+   if (entry == 0)
+      return;
+
+   const uint64_t count = entry - 1;
+
+   if (count * 1000 <= pgo_max) {
+      LLVMAddFunctionAttr(fn, LLVMOptimizeForSizeAttribute);
+#ifdef __ELF__
+      LLVMSetSection(fn, ".text.unlikely");
+#endif
+   }
+#ifdef __ELF__
+   else if (count * 10 >= pgo_max)
+      LLVMSetSection(fn, ".text.hot");
+#endif
+
+   LLVMValueRef weights[] = {
+      LLVMMDString("branch_weights", 14),
+      llvm_int32(1),
+      llvm_int32(MIN(MAX(count, 1), INT32_MAX))
+   };
+   LLVMSetMetadata(entry_br, LLVMGetMDKindID("prof", 4),
+                   LLVMMDNode(weights, ARRAY_LEN(weights)));
+}
+
 static void cgen_process(vcode_unit_t code)
 {
    vcode_select_unit(code);
@@ -2917,7 +3104,8 @@ static void cgen_process(vcode_unit_t code)
    LLVMPositionBuilderAtEnd(builder, entry_bb);
    LLVMValueRef reset = LLVMBuildICmp(builder, LLVMIntNE, LLVMGetParam(fn, 0),
                                       llvm_int32(0), "reset");
-   LLVMBuildCondBr(builder, reset, reset_bb, jump_bb);
+   LLVMValueRef entry_br = LLVMBuildCondBr(builder, reset, reset_bb, jump_bb);
+   cgen_pgo_process(fn, entry_br);
 
    LLVMPositionBuilderAtEnd(builder, reset_bb);
 
@@ -3045,7 +3233,7 @@ static void cgen_coverage_state(tree_t t)
 
    const int cond_tags = tree_attr_int(t, ident_new("cond_tags"), 0);
    if (cond_tags > 0) {
-      LLVMTypeRef type = LLVMArrayType(LLVMInt32Type(), stmt_tags);
+      LLVMTypeRef type = LLVMArrayType(LLVMInt32Type(), cond_tags);
       LLVMValueRef var = LLVMAddGlobal(module, type, "cover_conds");
       LLVMSetInitializer(var, LLVMGetUndef(type));
    }
@@ -3146,11 +3334,21 @@ static void cgen_top(tree_t t)
    cgen_subprograms(t);
 
    if (tree_kind(t) == T_ELAB) {
+      // Processes not already lowered are lowered here and their vcode
+      // freed once translated so only one is held in memory at a time
       const int nstmts = tree_stmts(t);
       for (int i = 0; i < nstmts; i++) {
          tree_t p = tree_stmt(t, i);
+
+         const bool stream = !tree_has_code(p);
+         if (stream)
+            lower_elab_process(t, p);
+
          cgen_subprograms(p);
          cgen_process(tree_code(p));
+
+         if (stream)
+            lower_release(p);
       }
    }
 }
@@ -3278,6 +3476,24 @@ static LLVMValueRef cgen_support_fn(const char *name)
                            LLVMFunctionType(LLVMVoidType(),
                                             args, ARRAY_LEN(args), false));
    }
+   else if (strcmp(name, "_image_int") == 0) {
+      LLVMTypeRef args[] = {
+         LLVMInt64Type(),
+         LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0)
+      };
+      fn = LLVMAddFunction(module, "_image_int",
+                           LLVMFunctionType(LLVMVoidType(),
+                                            args, ARRAY_LEN(args), false));
+   }
+   else if (strcmp(name, "_image_real") == 0) {
+      LLVMTypeRef args[] = {
+         LLVMDoubleType(),
+         LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0)
+      };
+      fn = LLVMAddFunction(module, "_image_real",
+                           LLVMFunctionType(LLVMVoidType(),
+                                            args, ARRAY_LEN(args), false));
+   }
    else if (strcmp(name, "_debug_out") == 0) {
       LLVMTypeRef args[] = {
          LLVMInt32Type(),
@@ -3454,6 +3670,21 @@ static LLVMValueRef cgen_support_fn(const char *name)
                            LLVMFunctionType(LLVMVoidType(),
                                             args, ARRAY_LEN(args), false));
    }
+   else if (strcmp(name, "_logic_vec_op") == 0) {
+      LLVMTypeRef args[] = {
+         LLVMInt32Type(),
+         LLVMPointerType(LLVMInt8Type(), 0),
+         LLVMInt32Type(),
+         LLVMInt1Type(),
+         LLVMPointerType(LLVMInt8Type(), 0),
+         LLVMInt32Type(),
+         LLVMInt1Type(),
+         LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0)
+      };
+      fn = LLVMAddFunction(module, "_logic_vec_op",
+                           LLVMFunctionType(LLVMVoidType(),
+                                            args, ARRAY_LEN(args), false));
+   }
    else if (strcmp(name, "_test_net_flag") == 0) {
       LLVMTypeRef args[] = {
          llvm_void_ptr(),
@@ -3489,6 +3720,22 @@ static LLVMValueRef cgen_support_fn(const char *name)
                            LLVMFunctionType(LLVMVoidType(),
                                             NULL, 0, false));
    }
+   else if (strcmp(name, "_tmp_stack_ptr") == 0) {
+      // The temporary stack is per thread as processes may be executed
+      // concurrently but the JIT cannot relocate references to thread
+      // local variables so find it through the runtime: the result is
+      // the same for the whole call so it can be computed once
+      LLVMTypeRef result = LLVMPointerType(llvm_void_ptr(), 0);
+      fn = LLVMAddFunction(module, "_tmp_stack_ptr",
+                           LLVMFunctionType(result, NULL, 0, false));
+      LLVMAddFunctionAttr(fn, LLVMReadNoneAttribute);
+   }
+   else if (strcmp(name, "_tmp_alloc_ptr") == 0) {
+      LLVMTypeRef result = LLVMPointerType(LLVMInt32Type(), 0);
+      fn = LLVMAddFunction(module, "_tmp_alloc_ptr",
+                           LLVMFunctionType(result, NULL, 0, false));
+      LLVMAddFunctionAttr(fn, LLVMReadNoneAttribute);
+   }
 
    if (fn != NULL)
       LLVMAddFunctionAttr(fn, LLVMNoUnwindAttribute);
@@ -3512,17 +3759,6 @@ static void cgen_module_name(tree_t top)
    LLVMSetLinkage(mod_name, LLVMPrivateLinkage);
 }
 
-static void cgen_tmp_stack(void)
-{
-   LLVMValueRef _tmp_stack =
-      LLVMAddGlobal(module, llvm_void_ptr(), "_tmp_stack");
-   LLVMSetLinkage(_tmp_stack, LLVMExternalLinkage);
-
-   LLVMValueRef _tmp_alloc =
-      LLVMAddGlobal(module, LLVMInt32Type(), "_tmp_alloc");
-   LLVMSetLinkage(_tmp_alloc, LLVMExternalLinkage);
-}
-
 void cgen(tree_t top)
 {
    tree_kind_t kind = tree_kind(top);
@@ -3533,10 +3769,18 @@ void cgen(tree_t top)
    builder = LLVMCreateBuilder();
 
    cgen_module_name(top);
-   cgen_tmp_stack();
+
+   const char *pgo_use = opt_get_str("pgo-use");
+   if (kind == T_ELAB && pgo_use != NULL)
+      cgen_pgo_load(pgo_use);
 
    cgen_top(top);
 
+   if (pgo_counts != NULL) {
+      hash_free(pgo_counts);
+      pgo_counts = NULL;
+   }
+
    if (opt_get_int("dump-llvm"))
       LLVMDumpModule(module);
 
@@ -3553,6 +3797,8 @@ void cgen(tree_t top)
    fclose(f);
    free(fname);
 
+   meta_write(top);
+
    LLVMDisposeBuilder(builder);
 
    tree_add_attr_ptr(top, llvm_i, module);
@@ -785,4 +785,8 @@ void intern_strings(void)
    simple_name_i    = ident_new("simple_name");
    std_i            = ident_new("STD");
    nnets_i          = ident_new("nnets");
+   comb_i           = ident_new("comb");
+   edge_i           = ident_new("edge");
+   implicit_i       = ident_new("implicit");
+   serial_i         = ident_new("serial");
 }
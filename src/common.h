@@ -188,6 +188,10 @@ GLOBAL ident_t impure_io_i;
 GLOBAL ident_t simple_name_i;
 GLOBAL ident_t std_i;
 GLOBAL ident_t nnets_i;
+GLOBAL ident_t comb_i;
+GLOBAL ident_t edge_i;
+GLOBAL ident_t implicit_i;
+GLOBAL ident_t serial_i;
 
 void intern_strings();
 
@@ -18,6 +18,7 @@
 #include "phase.h"
 #include "util.h"
 #include "common.h"
+#include "hash.h"
 #include "rt/cover.h"
 
 #include <ctype.h>
@@ -52,13 +53,6 @@ typedef struct map_list {
    tree_t name;
 } map_list_t;
 
-typedef struct copy_list copy_list_t;
-
-struct copy_list {
-   copy_list_t *next;
-   tree_t       tree;
-};
-
 typedef struct {
    lib_t    lib;
    ident_t  name;
@@ -74,6 +68,28 @@ struct generic_list {
    bool            used;
 };
 
+typedef struct share_list share_list_t;
+
+struct share_list {
+   share_list_t *next;
+   tree_t        arch;
+   tree_t       *generics;
+   int           ngenerics;
+   tree_t       *subprograms;
+   ident_t      *names;
+   int           nsubprograms;
+};
+
+typedef struct {
+   tree_t *copies;
+   tree_t *shared;
+   bool   *ok;
+   int     count;
+   hash_t *local;
+   hash_t *inst;
+   bool    safe;
+} share_params_t;
+
 static void elab_arch(tree_t t, const elab_ctx_t *ctx);
 static void elab_block(tree_t t, const elab_ctx_t *ctx);
 static void elab_stmts(tree_t t, const elab_ctx_t *ctx);
@@ -84,6 +100,9 @@ static void elab_copy_context(tree_t src, const elab_ctx_t *ctx);
 static int errors = 0;
 
 static generic_list_t *generic_override = NULL;
+static share_list_t   *share_list = NULL;
+static int             n_copies = 0;
+static unsigned        n_shared = 0;
 
 static ident_t hpathf(ident_t path, char sep, const char *fmt, ...)
 {
@@ -498,7 +517,7 @@ static ident_t elab_formal_name(tree_t t)
    return tree_ident(t);
 }
 
-static map_list_t *elab_map(tree_t t, tree_t arch,
+static map_list_t *elab_map(tree_t t, tree_t arch, ghash_t *shared,
                             tree_formals_t tree_Fs, tree_formal_t tree_F,
                             tree_actuals_t tree_As, tree_actual_t tree_A)
 {
@@ -588,11 +607,11 @@ static map_list_t *elab_map(tree_t t, tree_t arch,
          .actuals = ractuals,
          .count   = count
       };
-      tree_rewrite(arch, rewrite_refs, &params);
+      tree_rewrite_skip(arch, shared, rewrite_refs, &params);
 
       tree_t ent = tree_ref(arch);
       if (tree_stmts(ent) > 0 || tree_decls(ent) > 0)
-         tree_rewrite(ent, rewrite_refs, &params);
+         tree_rewrite_skip(ent, shared, rewrite_refs, &params);
    }
 
    free(have_formals);
@@ -786,49 +805,39 @@ static bool elab_should_copy(tree_t t)
 
 static void elab_build_copy_list(tree_t t, void *context)
 {
-   copy_list_t **list = context;
-
-   if (elab_should_copy(t)) {
-      copy_list_t *new = xmalloc(sizeof(copy_list_t));
-      new->tree = t;
-      new->next = *list;
+   ghash_t *copy = context;
 
-      *list = new;
-   }
+   if (elab_should_copy(t))
+      ghash_put(copy, t, t);
 }
 
 static bool elab_copy_trees(tree_t t, void *context)
 {
-   copy_list_t *list = context;
+   ghash_t *copy = context;
 
-   if (elab_should_copy(t)) {
-      for (; list != NULL; list = list->next) {
-         if (list->tree == t)
-            return true;
-      }
-   }
-
-   return false;
+   return elab_should_copy(t) && ghash_get(copy, t) != NULL;
 }
 
-static tree_t elab_copy(tree_t t)
+static tree_t elab_copy(tree_t t, ghash_t *shared)
 {
-   copy_list_t *copy_list = NULL;
-   tree_visit(t, elab_build_copy_list, &copy_list);
+   // Only the trees that belong to the instance and their ancestors
+   // are copied: the roots of untouched subtrees still shared with the
+   // original are added to `shared' so later rewrites can skip them
+
+   ghash_t *copy = ghash_new(GHASH_PTR, 64);
+   tree_visit(t, elab_build_copy_list, copy);
 
    // For achitectures, also make a copy of the entity ports
    if (tree_kind(t) == T_ARCH)
-      tree_visit(tree_ref(t), elab_build_copy_list, &copy_list);
+      tree_visit(tree_ref(t), elab_build_copy_list, copy);
 
-   tree_t copy = tree_copy(t, elab_copy_trees, copy_list);
+   tree_t result = tree_copy_shared(t, elab_copy_trees, copy, shared);
 
-   while (copy_list != NULL) {
-      copy_list_t *tmp = copy_list->next;
-      free(copy_list);
-      copy_list = tmp;
-   }
+   n_copies++;
+   n_shared += ghash_members(shared);
 
-   return copy;
+   ghash_free(copy);
+   return result;
 }
 
 static bool elab_compatible_map(tree_t comp, tree_t entity, char *what,
@@ -944,8 +953,7 @@ static tree_t elab_default_binding(tree_t inst, lib_t *new_lib,
       }
    }
 
-   tree_t arch = elab_copy(pick_arch(tree_loc(comp),
-                                     tree_ident(entity), new_lib, ctx));
+   tree_t arch = pick_arch(tree_loc(comp), tree_ident(entity), new_lib, ctx);
 
    // Check entity is compatible with component declaration
 
@@ -959,17 +967,355 @@ static tree_t elab_default_binding(tree_t inst, lib_t *new_lib,
    return arch;
 }
 
+static bool elab_same_value(tree_t a, tree_t b)
+{
+   if (tree_kind(a) != tree_kind(b))
+      return false;
+
+   switch (tree_kind(a)) {
+   case T_LITERAL:
+      if (tree_subkind(a) != tree_subkind(b))
+         return false;
+
+      switch (tree_subkind(a)) {
+      case L_INT:
+         return tree_ival(a) == tree_ival(b);
+      case L_REAL:
+         return tree_dval(a) == tree_dval(b);
+      default:
+         return false;
+      }
+
+   case T_REF:
+      return tree_ref(a) == tree_ref(b)
+         && tree_kind(tree_ref(a)) == T_ENUM_LIT;
+
+   default:
+      return false;
+   }
+}
+
+static bool elab_generic_values(tree_t inst, tree_t ent, tree_t *values)
+{
+   // Collect the value of each generic if they are all simple constants
+   // that can be compared between instances
+
+   const int ngenerics = tree_generics(ent);
+   for (int i = 0; i < ngenerics; i++) {
+      tree_t g = tree_generic(ent, i);
+      values[i] = tree_has_value(g) ? tree_value(g) : NULL;
+   }
+
+   const int ngenmaps = tree_genmaps(inst);
+   for (int i = 0; i < ngenmaps; i++) {
+      tree_t p = tree_genmap(inst, i);
+
+      switch (tree_subkind(p)) {
+      case P_POS:
+         values[tree_pos(p)] = tree_value(p);
+         break;
+      case P_NAMED:
+         {
+            ident_t name = elab_formal_name(tree_name(p));
+            for (int j = 0; j < ngenerics; j++) {
+               if (tree_ident(tree_generic(ent, j)) == name)
+                  values[j] = tree_value(p);
+            }
+         }
+         break;
+      default:
+         assert(false);
+      }
+   }
+
+   for (int i = 0; i < ngenerics; i++) {
+      if (values[i] == NULL)
+         return false;
+      else if (!elab_same_value(values[i], values[i]))
+         return false;   // Not a value we know how to compare
+   }
+
+   return true;
+}
+
+static bool elab_is_subprogram(tree_t t)
+{
+   const tree_kind_t kind = tree_kind(t);
+   return kind == T_FUNC_BODY || kind == T_PROC_BODY
+      || kind == T_FUNC_DECL || kind == T_PROC_DECL;
+}
+
+static bool elab_has_ref(tree_t t)
+{
+   switch (tree_kind(t)) {
+   case T_REF:
+   case T_FCALL:
+   case T_PCALL:
+   case T_CPCALL:
+      return tree_has_ref(t);
+   default:
+      return false;
+   }
+}
+
+static void elab_share_local_fn(tree_t t, void *context)
+{
+   share_params_t *params = context;
+   hash_put(params->local, t, t);
+}
+
+static void elab_share_check_fn(tree_t t, void *context)
+{
+   share_params_t *params = context;
+
+   if (!params->safe)
+      return;
+
+   if (tree_kind(t) == T_ATTR_REF) {
+      // The name attributes would report the first instance
+      const predef_attr_t predef = tree_attr_int(t, builtin_i, -1);
+      if (predef == ATTR_PATH_NAME || predef == ATTR_INSTANCE_NAME)
+         params->safe = false;
+      return;
+   }
+   else if (!elab_has_ref(t))
+      return;
+
+   tree_t decl = tree_ref(t);
+   if (hash_get(params->local, decl) != NULL)
+      return;
+
+   switch (tree_kind(decl)) {
+   case T_SIGNAL_DECL:
+   case T_PORT_DECL:
+   case T_FILE_DECL:
+      params->safe = false;
+      return;
+   default:
+      break;
+   }
+
+   if (hash_get(params->inst, decl) == NULL)
+      return;   // Declared in a package
+   else if (simple_name(istr(tree_ident(decl)))[0] == ':')
+      return;   // Never copied so already shared by every instance
+
+   for (int i = 0; i < params->count; i++) {
+      if (params->copies[i] == decl && params->ok[i])
+         return;
+   }
+
+   params->safe = false;
+}
+
+static tree_t elab_share_rewrite_fn(tree_t t, void *context)
+{
+   hash_t *map = context;
+
+   tree_t shared = hash_get(map, t);
+   if (shared != NULL)
+      return shared;
+
+   if (elab_has_ref(t) && (shared = hash_get(map, tree_ref(t))))
+      tree_set_ref(t, shared);
+
+   return t;
+}
+
+static bool elab_share_partner(const share_params_t *params, int n)
+{
+   // A subprogram declaration can only be shared along with its body
+   // and vice versa otherwise calls would resolve to different names
+
+   tree_t t = params->copies[n];
+   const bool is_body =
+      tree_kind(t) == T_FUNC_BODY || tree_kind(t) == T_PROC_BODY;
+
+   bool have_body = is_body;
+   for (int i = 0; i < params->count; i++) {
+      tree_t other = params->copies[i];
+      if (i == n || tree_ident(other) != tree_ident(t)
+          || !type_eq(tree_type(other), tree_type(t)))
+         continue;
+      else if (!params->ok[i])
+         return false;
+      else if (!is_body)
+         have_body = true;
+   }
+
+   return have_body;
+}
+
+static void elab_share_subprograms(tree_t inst, tree_t orig, tree_t arch)
+{
+   // Instances of the same architecture with identical generic values
+   // get identical copies of any subprogram that does not touch signals
+   // so point these back at the subprograms from the first instance
+   // and only generate code for them once
+
+   tree_t ent = tree_ref(orig);
+   const int ngenerics = tree_generics(ent);
+   tree_t *values = xmalloc(sizeof(tree_t) * MAX(ngenerics, 1));
+   if (!elab_generic_values(inst, ent, values)) {
+      free(values);
+      return;
+   }
+
+   share_list_t *it;
+   for (it = share_list; it != NULL; it = it->next) {
+      if (it->arch != orig)
+         continue;
+
+      int i;
+      for (i = 0; i < ngenerics; i++) {
+         if (!elab_same_value(it->generics[i], values[i]))
+            break;
+      }
+
+      if (i == ngenerics)
+         break;
+   }
+
+   const int ndecls = tree_decls(arch);
+
+   if (it == NULL) {
+      share_list_t *new = xmalloc(sizeof(share_list_t));
+      new->next         = share_list;
+      new->arch         = orig;
+      new->generics     = values;
+      new->ngenerics    = ngenerics;
+      new->subprograms  = xmalloc(sizeof(tree_t) * MAX(ndecls, 1));
+      new->names        = xmalloc(sizeof(ident_t) * MAX(ndecls, 1));
+      new->nsubprograms = 0;
+
+      for (int i = 0; i < ndecls; i++) {
+         tree_t d = tree_decl(arch, i);
+         if (elab_is_subprogram(d)) {
+            new->subprograms[new->nsubprograms] = d;
+            new->names[new->nsubprograms++] = tree_ident(d);
+         }
+      }
+
+      share_list = new;
+      return;
+   }
+
+   free(values);
+
+   share_params_t params = {
+      .copies = xmalloc(sizeof(tree_t) * MAX(ndecls, 1)),
+      .shared = xmalloc(sizeof(tree_t) * MAX(ndecls, 1)),
+      .ok     = xmalloc(sizeof(bool) * MAX(ndecls, 1)),
+      .count  = 0
+   };
+
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(arch, i);
+      if (!elab_is_subprogram(d))
+         continue;
+      else if (simple_name(istr(tree_ident(d)))[0] == ':')
+         continue;   // Not copied
+
+      for (int j = 0; j < it->nsubprograms; j++) {
+         tree_t s = it->subprograms[j];
+         if (it->names[j] == tree_ident(d) && tree_kind(s) == tree_kind(d)
+             && type_eq(tree_type(s), tree_type(d))) {
+            params.copies[params.count] = d;
+            params.shared[params.count] = s;
+            params.ok[params.count++] = true;
+            break;
+         }
+      }
+   }
+
+   if (params.count > 0) {
+      tree_t copy_ent = tree_ref(arch);
+
+      params.inst = hash_new(ndecls * 2 + 16, true);
+      for (int i = 0; i < ndecls; i++)
+         hash_put(params.inst, tree_decl(arch, i), arch);
+
+      const int nedecls = tree_decls(copy_ent);
+      for (int i = 0; i < nedecls; i++)
+         hash_put(params.inst, tree_decl(copy_ent, i), copy_ent);
+
+      const int nports = tree_ports(copy_ent);
+      for (int i = 0; i < nports; i++)
+         hash_put(params.inst, tree_port(copy_ent, i), copy_ent);
+
+      const int ncgenerics = tree_generics(copy_ent);
+      for (int i = 0; i < ncgenerics; i++)
+         hash_put(params.inst, tree_generic(copy_ent, i), copy_ent);
+
+      bool changed;
+      do {
+         changed = false;
+         for (int i = 0; i < params.count; i++) {
+            if (!params.ok[i])
+               continue;
+
+            tree_t d = params.copies[i];
+            params.safe = elab_share_partner(&params, i);
+
+            if (params.safe && tree_kind(d) != T_FUNC_DECL
+                && tree_kind(d) != T_PROC_DECL) {
+               params.local = hash_new(256, true);
+               tree_visit(d, elab_share_local_fn, &params);
+               tree_visit(d, elab_share_check_fn, &params);
+               hash_free(params.local);
+            }
+
+            if (!params.safe) {
+               params.ok[i] = false;
+               changed = true;
+            }
+         }
+      } while (changed);
+
+      hash_t *map = hash_new(params.count * 2 + 16, true);
+      int nshared = 0;
+      for (int i = 0; i < params.count; i++) {
+         if (params.ok[i]) {
+            hash_put(map, params.copies[i], params.shared[i]);
+            nshared++;
+         }
+      }
+
+      if (nshared > 0)
+         tree_rewrite(arch, elab_share_rewrite_fn, map);
+
+      hash_free(map);
+      hash_free(params.inst);
+   }
+
+   free(params.copies);
+   free(params.shared);
+   free(params.ok);
+}
+
+static void elab_free_share_list(void)
+{
+   while (share_list != NULL) {
+      share_list_t *tmp = share_list->next;
+      free(share_list->generics);
+      free(share_list->subprograms);
+      free(share_list->names);
+      free(share_list);
+      share_list = tmp;
+   }
+}
+
 static void elab_instance(tree_t t, const elab_ctx_t *ctx)
 {
    lib_t new_lib = NULL;
-   tree_t arch = NULL;
+   tree_t orig = NULL;
    switch (tree_class(t)) {
    case C_ENTITY:
-      arch = elab_copy(pick_arch(tree_loc(t), tree_ident2(t), &new_lib, ctx));
+      orig = pick_arch(tree_loc(t), tree_ident2(t), &new_lib, ctx);
       break;
 
    case C_COMPONENT:
-      arch = elab_default_binding(t, &new_lib, ctx);
+      orig = elab_default_binding(t, &new_lib, ctx);
       break;
 
    case C_CONFIGURATION:
@@ -980,15 +1326,20 @@ static void elab_instance(tree_t t, const elab_ctx_t *ctx)
       assert(false);
    }
 
-   if (arch == NULL)
+   if (orig == NULL)
       return;
 
-   map_list_t *maps = elab_map(t, arch, tree_ports, tree_port,
+   ghash_t *shared = ghash_new(GHASH_PTR, 64);
+   tree_t arch = elab_copy(orig, shared);
+
+   map_list_t *maps = elab_map(t, arch, shared, tree_ports, tree_port,
                                tree_params, tree_param);
 
-   (void)elab_map(t, arch, tree_generics, tree_generic,
+   (void)elab_map(t, arch, shared, tree_generics, tree_generic,
                   tree_genmaps, tree_genmap);
 
+   ghash_free(shared);
+
    ident_t ninst = hpathf(ctx->inst, '@', "%s(%s)",
                           simple_name(istr(tree_ident2(arch))),
                           simple_name(istr(tree_ident(arch))));
@@ -1009,6 +1360,8 @@ static void elab_instance(tree_t t, const elab_ctx_t *ctx)
    elab_funcs(arch, entity, ctx);
    simplify(arch);
 
+   elab_share_subprograms(t, orig, arch);
+
    elab_map_nets(maps);
 
    while (maps != NULL) {
@@ -1167,7 +1520,8 @@ static void elab_for_generate(tree_t t, elab_ctx_t *ctx)
    range_bounds(tree_range(t), &low, &high);
 
    for (int64_t i = low; i <= high; i++) {
-      tree_t copy = elab_copy(t);
+      ghash_t *shared = ghash_new(GHASH_PTR, 64);
+      tree_t copy = elab_copy(t, shared);
 
       tree_t genvar = tree_ref(copy);
 
@@ -1179,7 +1533,8 @@ static void elab_for_generate(tree_t t, elab_ctx_t *ctx)
          .actuals = actuals,
          .count   = 1
       };
-      tree_rewrite(copy, rewrite_refs, &params);
+      tree_rewrite_skip(copy, shared, rewrite_refs, &params);
+      ghash_free(shared);
       simplify(copy);
 
       ident_t npath = hpathf(ctx->path, '\0', "[%"PRIi64"]", i);
@@ -1232,6 +1587,131 @@ static void elab_rename_subprograms(tree_t t, ident_t prefix)
    }
 }
 
+static void elab_comb_visit_fn(tree_t t, void *context)
+{
+   bool *comb = context;
+
+   switch (tree_kind(t)) {
+   case T_ATTR_REF:
+      switch (tree_attr_int(t, builtin_i, -1)) {
+      case ATTR_EVENT:
+      case ATTR_ACTIVE:
+      case ATTR_LAST_EVENT:
+      case ATTR_LAST_ACTIVE:
+      case ATTR_LAST_VALUE:
+      case ATTR_DELAYED:
+      case ATTR_STABLE:
+      case ATTR_QUIET:
+      case ATTR_TRANSACTION:
+         *comb = false;
+         break;
+      default:
+         break;
+      }
+      break;
+
+   case T_FCALL:
+   case T_PCALL:
+      {
+         // Subprograms with signal parameters such as rising_edge may
+         // test for events
+         tree_t decl = tree_ref(t);
+         const int nports = tree_ports(decl);
+         for (int i = 0; i < nports; i++) {
+            if (tree_class(tree_port(decl, i)) == C_SIGNAL)
+               *comb = false;
+         }
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+static bool elab_is_combinational(tree_t t)
+{
+   // A process is combinational if it only suspends on its static
+   // sensitivity list and its behaviour does not depend on when events
+   // occurred: it can then be evaluated once its inputs have settled
+
+   if (tree_flags(t) & TREE_F_POSTPONED)
+      return false;
+   else if (tree_attr_int(t, implicit_i, -1) != -1)
+      return false;   // Updated by the kernel rather than run
+
+   const int nstmts = tree_stmts(t);
+   if (nstmts == 0)
+      return false;
+
+   tree_t last = tree_stmt(t, nstmts - 1);
+   if (tree_kind(last) != T_WAIT || !tree_attr_int(last, static_i, 0))
+      return false;
+
+   if (tree_visit_only(t, NULL, NULL, T_WAIT) != 1)
+      return false;
+
+   bool comb = true;
+   tree_visit(t, elab_comb_visit_fn, &comb);
+   return comb;
+}
+
+static void elab_serial_visit_fn(tree_t t, void *context)
+{
+   bool *serial = context;
+
+   switch (tree_kind(t)) {
+   case T_REF:
+      {
+         tree_t decl = tree_ref(t);
+         switch (tree_kind(decl)) {
+         case T_FILE_DECL:
+            *serial = true;
+            break;
+         case T_VAR_DECL:
+            if (tree_flags(decl) & TREE_F_SHARED)
+               *serial = true;
+            else if (type_kind(tree_type(decl)) == T_PROTECTED)
+               *serial = true;
+            break;
+         default:
+            break;
+         }
+      }
+      break;
+
+   case T_FCALL:
+      if (tree_flags(tree_ref(t)) & TREE_F_IMPURE)
+         *serial = true;
+      break;
+
+   case T_PCALL:
+      {
+         // Only procedures analysed in the same unit record whether
+         // they reference a file or shared variable
+         tree_t decl = tree_ref(t);
+         if (tree_kind(decl) != T_PROC_BODY
+             || tree_attr_int(decl, impure_io_i, 0) != 0)
+            *serial = true;
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+static bool elab_is_serial(tree_t t)
+{
+   // Processes which access files, shared variables or protected
+   // objects may observe each other directly rather than through
+   // signals and so cannot run in parallel
+
+   bool serial = false;
+   tree_visit(t, elab_serial_visit_fn, &serial);
+   return serial;
+}
+
 static void elab_process(tree_t t, const elab_ctx_t *ctx)
 {
    // Rename local functions in this process to avoid collisions in the
@@ -1241,6 +1721,12 @@ static void elab_process(tree_t t, const elab_ctx_t *ctx)
 
    tree_add_attr_str(t, inst_name_i,
                      ident_prefix(ctx->inst, ident_new(":"), '\0'));
+
+   if (elab_is_combinational(t))
+      tree_add_attr_int(t, comb_i, 1);
+
+   if (elab_is_serial(t))
+      tree_add_attr_int(t, serial_i, 1);
 }
 
 static void elab_stmts(tree_t t, const elab_ctx_t *ctx)
@@ -1416,7 +1902,7 @@ static void elab_top_level_generics(tree_t arch, const elab_ctx_t *ctx)
                   istr(name));
    }
 
-   (void)elab_map(ent, arch, tree_generics, tree_generic, NULL, NULL);
+   (void)elab_map(ent, arch, NULL, tree_generics, tree_generic, NULL, NULL);
 }
 
 static void elab_entity_arch(tree_t t, tree_t arch, const elab_ctx_t *ctx)
@@ -1614,12 +2100,109 @@ void elab_set_generic(const char *name, const char *value)
    generic_override = new;
 }
 
+static ident_t elab_key(void)
+{
+   // Summarise the options that change the elaborated design or the
+   // code generated from it
+
+   LOCAL_TEXT_BUF tb = tb_new();
+   tb_printf(tb, "cover=%d,opt=%d,native=%d,prune=%d,fuse=%d",
+             opt_get_int("cover"), opt_get_int("optimise"),
+             opt_get_int("native"), opt_get_int("prune"),
+             opt_get_int("fuse"));
+
+   for (generic_list_t *it = generic_override; it != NULL; it = it->next)
+      tb_printf(tb, ",%s=%s", istr(it->name), it->value);
+
+   return ident_new(tb_get(tb));
+}
+
+typedef struct {
+   lib_t       lib;
+   ident_t     entity;
+   lib_mtime_t mtime;
+   bool        stale;
+} cache_params_t;
+
+static void elab_cache_arch_fn(ident_t name, int kind, void *context)
+{
+   cache_params_t *params = context;
+
+   // A newer architecture would be picked instead of the cached one
+   if (kind == T_ARCH && ident_until(name, '-') == params->entity
+       && lib_mtime(params->lib, name) > params->mtime)
+      params->stale = true;
+}
+
+static bool elab_unit_stale(lib_t lib, ident_t name, lib_mtime_t mtime)
+{
+   tree_t unit = lib_get(lib, name);
+   if (unit == NULL)
+      return true;
+   else if (lib_mtime(lib, name) > mtime)
+      return true;
+
+   switch (tree_kind(unit)) {
+   case T_PACKAGE:
+      {
+         ident_t body_i = ident_prefix(name, ident_new("body"), '-');
+         if (lib_get(lib, body_i) != NULL)
+            return lib_mtime(lib, body_i) > mtime;
+         else
+            return false;
+      }
+
+   case T_ENTITY:
+      {
+         cache_params_t params = { lib, name, mtime, false };
+         lib_walk_index(lib, elab_cache_arch_fn, &params);
+         return params.stale;
+      }
+
+   default:
+      return false;
+   }
+}
+
+tree_t elab_cached(tree_t top)
+{
+   ident_t name = ident_prefix(tree_ident(top), ident_new("elab"), '.');
+
+   tree_t e = lib_get(lib_work(), name);
+   if (e == NULL || tree_kind(e) != T_ELAB)
+      return NULL;
+   else if (tree_attr_str(e, ident_new("elab_key")) != elab_key())
+      return NULL;
+
+   const lib_mtime_t mtime = lib_mtime(lib_work(), name);
+
+   // The pseudo context added during elaboration names every entity,
+   // architecture, and package the design was built from
+
+   const int ncontext = tree_contexts(e);
+   for (int i = 0; i < ncontext; i++) {
+      tree_t c = tree_context(e, i);
+      if (tree_kind(c) != T_USE)
+         continue;
+
+      ident_t cname = tree_ident(c);
+      lib_t lib = lib_find(ident_until(cname, '.'), false);
+      if (lib == NULL || elab_unit_stale(lib, cname, mtime))
+         return NULL;
+   }
+
+   return e;
+}
+
 tree_t elab(tree_t top)
 {
    tree_t e = tree_new(T_ELAB);
    tree_set_ident(e, ident_prefix(tree_ident(top),
                                   ident_new("elab"), '.'));
 
+   n_copies = 0;
+   n_shared = 0;
+
    netid_t next_net = 0;
    elab_ctx_t ctx = {
       .out      = e,
@@ -1644,16 +2227,36 @@ tree_t elab(tree_t top)
    }
 
    elab_context_signals(&ctx);
+   elab_free_share_list();
+
+   if (opt_get_int("verbose"))
+      notef("copied %d instances sharing %u subtrees with the original",
+            n_copies, n_shared);
 
    if (errors > 0)
       return NULL;
 
    tree_add_attr_int(e, nnets_i, next_net);
+   tree_add_attr_str(e, ident_new("elab_key"), elab_key());
 
    if (opt_get_int("cover"))
       cover_tag(e);
 
+   stats_phase_begin("bounds");
    bounds_check(e);
+   stats_phase_end();
+
+   if (opt_get_int("prune")) {
+      stats_phase_begin("prune");
+      prune_design(e);
+      stats_phase_end();
+   }
+
+   if (opt_get_int("fuse")) {
+      stats_phase_begin("fuse");
+      fuse_processes(e);
+      stats_phase_end();
+   }
 
    for (generic_list_t *it = generic_override; it != NULL; it = it->next) {
       if (!it->used)
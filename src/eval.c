@@ -18,6 +18,9 @@
 #include "phase.h"
 #include "util.h"
 #include "common.h"
+#include "hash.h"
+#include "interp.h"
+#include "vcode.h"
 
 #include <assert.h>
 #include <string.h>
@@ -26,27 +29,52 @@
 
 #define VTABLE_SZ 16
 #define MAX_ITERS 1000
+#define MAX_ELEMS 4096
 
 typedef struct vtable vtable_t;
 typedef struct vtframe vtframe_t;
+typedef struct binding binding_t;
+typedef struct thunk thunk_t;
+typedef struct thunk_func thunk_func_t;
+
+struct binding {
+   ident_t    name;
+   tree_t     value;
+   vtframe_t *frame;
+   binding_t *shadow;
+};
 
 struct vtframe {
-   struct {
-      ident_t name;
-      tree_t  value;
-   } binding[VTABLE_SZ];
-
+   binding_t  binding[VTABLE_SZ];
    size_t     size;
    vtframe_t *down;
 };
 
+// Each name maps to its innermost binding which links to any binding
+// of the same name it shadows in an outer frame
 struct vtable {
    vtframe_t *top;
+   ghash_t   *names;
    bool       failed;
    ident_t    exit;
    tree_t     result;
 };
 
+// Function bodies lowered to vcode for a single call
+struct thunk_func {
+   tree_t       body;
+   vcode_unit_t unit;
+   ident_t      name;
+   bool         owned;
+};
+
+struct thunk {
+   thunk_func_t *funcs;
+   int           nfuncs;
+   int           maxfuncs;
+   bool          failed;
+};
+
 static void eval_stmt(tree_t t, vtable_t *v);
 static tree_t eval_expr(tree_t t, vtable_t *v);
 
@@ -71,6 +99,15 @@ static void vtable_push(vtable_t *v)
 static void vtable_pop(vtable_t *v)
 {
    vtframe_t *f = v->top;
+
+   for (size_t i = f->size; i-- > 0;) {
+      binding_t *b = &(f->binding[i]);
+      if (b->shadow != NULL)
+         ghash_put(v->names, b->name, b->shadow);
+      else
+         ghash_delete(v->names, b->name);
+   }
+
    v->top    = f->down;
    v->result = NULL;
    free(f);
@@ -82,35 +119,32 @@ static void vtable_bind(vtable_t *v, ident_t name, tree_t value)
    if (f == NULL)
       return;
 
-   for (size_t i = 0; i < f->size; i++) {
-      if (f->binding[i].name == name) {
-         f->binding[i].value = value;
-         return;
-      }
+   if (v->names == NULL)
+      v->names = ghash_new(GHASH_PTR, VTABLE_SZ);
+
+   binding_t *b = ghash_get(v->names, name);
+   if (b != NULL && b->frame == f) {
+      b->value = value;
+      return;
    }
 
    assert(f->size < VTABLE_SZ);
-   f->binding[f->size].name  = name;
-   f->binding[f->size].value = value;
-   ++(f->size);
-}
+   binding_t *new = &(f->binding[f->size++]);
+   new->name   = name;
+   new->value  = value;
+   new->frame  = f;
+   new->shadow = b;
 
-static tree_t vtframe_get(vtframe_t *f, ident_t name)
-{
-   if (f == NULL)
-      return NULL;
-   else {
-      for (size_t i = 0; i < f->size; i++) {
-         if (f->binding[i].name == name)
-            return f->binding[i].value;
-      }
-      return vtframe_get(f->down, name);
-   }
+   ghash_put(v->names, name, new);
 }
 
 static tree_t vtable_get(vtable_t *v, ident_t name)
 {
-   return vtframe_get(v->top, name);
+   if (v->names == NULL)
+      return NULL;
+
+   binding_t *b = ghash_get(v->names, name);
+   return b == NULL ? NULL : b->value;
 }
 
 static bool folded(tree_t t)
@@ -649,6 +683,269 @@ static void eval_stmt(tree_t t, vtable_t *v)
    }
 }
 
+static void thunk_add(thunk_t *th, tree_t body)
+{
+   for (int i = 0; i < th->nfuncs; i++) {
+      if (th->funcs[i].body == body)
+         return;
+   }
+
+   if (th->nfuncs == th->maxfuncs) {
+      th->maxfuncs = MAX(th->maxfuncs * 2, 4);
+      th->funcs = xrealloc(th->funcs, th->maxfuncs * sizeof(thunk_func_t));
+   }
+
+   thunk_func_t *f = &(th->funcs[th->nfuncs++]);
+   f->body  = body;
+   f->unit  = NULL;
+   f->name  = NULL;
+   f->owned = false;
+}
+
+static void thunk_visit(tree_t t, void *context)
+{
+   thunk_t *th = context;
+
+   switch (tree_kind(t)) {
+   case T_REF:
+      {
+         // Signals and files only exist once the design is elaborated
+         // and deferred constants are not known until the package body
+         tree_t decl = tree_ref(t);
+         const tree_kind_t kind = tree_kind(decl);
+         if (kind == T_SIGNAL_DECL || kind == T_FILE_DECL)
+            th->failed = true;
+         else if (kind == T_CONST_DECL && !tree_has_value(decl))
+            th->failed = true;
+      }
+      break;
+
+   case T_FCALL:
+      {
+         tree_t decl = tree_ref(t);
+         if (tree_attr_str(decl, builtin_i) != NULL)
+            break;
+         else if (tree_kind(decl) == T_FUNC_BODY)
+            thunk_add(th, decl);
+         else
+            th->failed = true;
+      }
+      break;
+
+   case T_PCALL:
+      th->failed = true;
+      break;
+
+   default:
+      break;
+   }
+}
+
+static bool thunk_lower(thunk_t *th, int nth)
+{
+   tree_t body = th->funcs[nth].body;
+
+   const int nports = tree_ports(body);
+   for (int i = 0; i < nports; i++) {
+      const class_t class = tree_class(tree_port(body, i));
+      if (class == C_SIGNAL || class == C_FILE)
+         return false;
+   }
+
+   tree_visit(body, thunk_visit, th);
+   if (th->failed)
+      return false;
+
+   // May have moved when the visitor added callees
+   thunk_func_t *f = &(th->funcs[nth]);
+
+   // Subprograms nested in another body can only be reached through
+   // their parent which the interpreter cannot follow
+   if (tree_attr_int(f->body, nested_i, 0) > 0)
+      return true;
+
+   if (tree_has_code(f->body))
+      f->unit = tree_code(f->body);
+   else {
+      f->unit  = lower_func(f->body);
+      f->owned = true;
+   }
+
+   vcode_select_unit(f->unit);
+   f->name = vcode_unit_name();
+   vcode_close();
+
+   return true;
+}
+
+static void thunk_free(thunk_t *th)
+{
+   for (int i = 0; i < th->nfuncs; i++) {
+      thunk_func_t *f = &(th->funcs[i]);
+      if (f->owned) {
+         vcode_select_unit(f->unit);
+         vcode_unit_t context = vcode_unit_context();
+         vcode_unit_unref(f->unit);
+         vcode_unit_unref(context);
+      }
+   }
+
+   free(th->funcs);
+}
+
+static vcode_unit_t thunk_resolve(ident_t name, void *context)
+{
+   thunk_t *th = context;
+   for (int i = 0; i < th->nfuncs; i++) {
+      if (th->funcs[i].name == name)
+         return th->funcs[i].unit;
+   }
+
+   return NULL;
+}
+
+static tree_t eval_scalar_lit(tree_t t, type_t type, interp_scalar_t value)
+{
+   tree_t lit;
+   if (type_is_real(type))
+      lit = get_real_lit(t, value.real);
+   else if (type_is_enum(type)) {
+      type_t base = type_base_recur(type);
+      if (value.integer < 0
+          || value.integer >= (int64_t)type_enum_literals(base))
+         return NULL;
+
+      tree_t elit = type_enum_literal(base, value.integer);
+
+      lit = tree_new(T_REF);
+      tree_set_loc(lit, tree_loc(t));
+      tree_set_ref(lit, elit);
+      tree_set_ident(lit, tree_ident(elit));
+   }
+   else
+      lit = get_int_lit(t, value.integer);
+
+   tree_set_type(lit, type);
+   return lit;
+}
+
+static bool eval_array_length(type_t type, int64_t *length)
+{
+   // Only one dimensional arrays of scalars with static bounds such as
+   // lookup tables and ROM contents are folded into an aggregate
+
+   if (type_is_unconstrained(type) || type_dims(type) != 1)
+      return false;
+   else if (!type_is_scalar(type_elem(type)))
+      return false;
+
+   int64_t low, high;
+   if (!folded_bounds(type_dim(type, 0), &low, &high))
+      return false;
+
+   *length = MAX(high - low + 1, 0);
+   return *length <= MAX_ELEMS;
+}
+
+static tree_t eval_vcode(tree_t t)
+{
+   // Lower the function and everything it calls to vcode and run it
+   // through the interpreter returning NULL if this is not possible
+
+   tree_t decl = tree_ref(t);
+   if (tree_kind(decl) != T_FUNC_BODY)
+      return NULL;
+   else if (tree_attr_str(decl, builtin_i) != NULL)
+      return NULL;
+
+   type_t type = tree_type(t);
+   int64_t length = -1;
+   if (type_is_array(type)) {
+      if (!eval_array_length(type, &length))
+         return NULL;
+   }
+   else if (!type_is_scalar(type))
+      return NULL;
+
+   const int nparams = tree_params(t);
+   interp_scalar_t args[MAX(nparams, 1)];
+   for (int i = 0; i < nparams; i++) {
+      tree_t p = tree_param(t, i);
+      if (tree_subkind(p) != P_POS)
+         return NULL;
+
+      tree_t value = tree_value(p);
+      int64_t ival;
+      double rval;
+      unsigned pos;
+      if (folded_int(value, &ival))
+         args[i].integer = ival;
+      else if (folded_real(value, &rval))
+         args[i].real = rval;
+      else if (folded_enum(value, &pos))
+         args[i].integer = pos;
+      else
+         return NULL;
+   }
+
+   thunk_t th = {
+      .funcs    = NULL,
+      .nfuncs   = 0,
+      .maxfuncs = 0,
+      .failed   = false
+   };
+
+   thunk_add(&th, decl);
+
+   bool ok = true;
+   for (int i = 0; ok && i < th.nfuncs; i++)
+      ok = thunk_lower(&th, i);
+
+   interp_scalar_t *elems = NULL, result;
+   if (length >= 0) {
+      elems = xmalloc(MAX(length, 1) * sizeof(interp_scalar_t));
+      ok = ok && th.funcs[0].unit != NULL
+         && interp_eval_array(th.funcs[0].unit, thunk_resolve, &th,
+                              args, nparams, elems, length);
+   }
+   else
+      ok = ok && th.funcs[0].unit != NULL
+         && interp_eval(th.funcs[0].unit, thunk_resolve, &th,
+                        args, nparams, &result);
+
+   thunk_free(&th);
+
+   tree_t folded = NULL;
+   if (!ok)
+      ;
+   else if (length >= 0) {
+      type_t elem = type_elem(type);
+
+      folded = tree_new(T_AGGREGATE);
+      tree_set_loc(folded, tree_loc(t));
+      tree_set_type(folded, type);
+
+      for (int i = 0; folded != NULL && i < length; i++) {
+         tree_t value = eval_scalar_lit(t, elem, elems[i]);
+         if (value == NULL)
+            folded = NULL;
+         else {
+            tree_t a = tree_new(T_ASSOC);
+            tree_set_loc(a, tree_loc(t));
+            tree_set_subkind(a, A_POS);
+            tree_set_value(a, value);
+
+            tree_add_assoc(folded, a);
+         }
+      }
+   }
+   else
+      folded = eval_scalar_lit(t, type, result);
+
+   free(elems);
+   return folded;
+}
+
 tree_t eval(tree_t fcall)
 {
    assert(tree_kind(fcall) == T_FCALL);
@@ -659,12 +956,21 @@ tree_t eval(tree_t fcall)
       have_debug = true;
    }
 
+   tree_t folded = eval_vcode(fcall);
+   if (folded != NULL)
+      return folded;
+
    vtable_t vt = {
       .top    = NULL,
+      .names  = NULL,
       .failed = false,
       .exit   = NULL,
       .result = NULL
    };
    tree_t r = eval_fcall(fcall, &vt);
+
+   if (vt.names != NULL)
+      ghash_free(vt.names);
+
    return vt.failed ? fcall : r;
 }
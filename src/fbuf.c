@@ -18,44 +18,151 @@
 #include "util.h"
 #include "fbuf.h"
 #include "fastlz.h"
+#include "lz4.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
-#define SPILL_SIZE 65536
-#define BLOCK_SIZE (SPILL_SIZE - (SPILL_SIZE / 16))
+#define SPILL_SIZE   65536
+#define BLOCK_SIZE   (SPILL_SIZE - (SPILL_SIZE / 16))
+#define HEADER_SIZE  4
+#define MAX_INFLIGHT 64
+
+// Files start with a short uncompressed header recording the codec
+// followed by a sequence of independently compressed blocks each
+// prefixed with a four byte big-endian length
+
+typedef struct block block_t;
+
+struct block {
+   uint8_t      *in;
+   size_t        len;
+   uint8_t      *out;
+   int           outlen;
+   fbuf_codec_t  codec;
+   bool          done;
+   block_t      *next;
+};
 
 struct fbuf {
-   fbuf_mode_t  mode;
-   char        *fname;
-   FILE        *file;
-   uint8_t     *wbuf;
-   size_t       wpend;
-   uint8_t     *rbuf;
-   size_t       rptr;
-   size_t       ravail;
-   size_t       roff;
-   uint8_t     *rmap;
-   size_t       maplen;
-   fbuf_t      *next;
-   fbuf_t      *prev;
+   fbuf_mode_t   mode;
+   fbuf_codec_t  codec;
+   char         *fname;
+   char         *tmpname;
+   FILE         *file;
+   uint8_t      *wbuf;
+   size_t        wpend;
+   size_t        wblkno;
+   block_t      *inflight[MAX_INFLIGHT];
+   unsigned      ihead;
+   unsigned      icount;
+   uint64_t      trailer;
+   bool          has_trailer;
+   uint8_t      *rbuf;
+   size_t        rptr;
+   size_t        ravail;
+   size_t        roff;
+   size_t        rblkno;
+   size_t        rnext;
+   size_t       *blocks;
+   size_t        nblocks;
+   uint8_t      *rmap;
+   size_t        maplen;
+   struct stat   st;
+   fbuf_t       *next;
+   fbuf_t       *prev;
 };
 
-static fbuf_t *open_list = NULL;
+static fbuf_t          *open_list = NULL;
+static fbuf_codec_t     default_codec = FBUF_CODEC_FASTLZ;
+static int              nworkers = 0;
+static pthread_t       *workers = NULL;
+static block_t         *queue_head = NULL;
+static block_t         *queue_tail = NULL;
+static pthread_mutex_t  queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   queue_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   queue_done = PTHREAD_COND_INITIALIZER;
+
+static const char magic[HEADER_SIZE - 1] = { 'N', 'V', 'C' };
 
 void fbuf_cleanup(void)
 {
    for (fbuf_t *it = open_list; it != NULL; it = it->next) {
       if (it->mode == FBUF_OUT) {
          fclose(it->file);
-         remove(it->fname);
+         remove(it->tmpname);
+      }
+   }
+}
+
+void fbuf_set_codec(fbuf_codec_t codec)
+{
+   default_codec = codec;
+}
+
+static void fbuf_compress(block_t *b)
+{
+   switch (b->codec) {
+   case FBUF_CODEC_FASTLZ:
+      if (b->len < 16) {
+         // Write dummy bytes at end to meet fastlz block size requirement
+         memset(b->in + b->len, '\0', 16 - b->len);
+         b->len = 16;
       }
+      b->outlen = fastlz_compress_level(2, b->in, b->len, b->out);
+      break;
+
+   case FBUF_CODEC_LZ4:
+      b->outlen = LZ4_compress((const char *)b->in, (char *)b->out, b->len);
+      break;
+
+   case FBUF_CODEC_NONE:
+      memcpy(b->out, b->in, b->len);
+      b->outlen = b->len;
+      break;
+   }
+
+   assert((b->outlen > 0) && (b->outlen <= SPILL_SIZE));
+}
+
+static void *fbuf_worker(void *arg)
+{
+   pthread_mutex_lock(&queue_lock);
+
+   for (;;) {
+      while (queue_head == NULL)
+         pthread_cond_wait(&queue_work, &queue_lock);
+
+      block_t *b = queue_head;
+      if ((queue_head = b->next) == NULL)
+         queue_tail = NULL;
+
+      pthread_mutex_unlock(&queue_lock);
+
+      fbuf_compress(b);
+
+      pthread_mutex_lock(&queue_lock);
+      b->done = true;
+      pthread_cond_broadcast(&queue_done);
+   }
+
+   return NULL;
+}
+
+void fbuf_set_threads(int nthreads)
+{
+   // Worker threads are created once and live until the process exits
+   for (; nworkers < nthreads; nworkers++) {
+      workers = xrealloc(workers, (nworkers + 1) * sizeof(pthread_t));
+      if (pthread_create(&(workers[nworkers]), NULL, fbuf_worker, NULL))
+         fatal_errno("pthread_create");
    }
 }
 
@@ -66,17 +173,30 @@ fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
    switch (mode) {
    case FBUF_OUT:
       {
-         FILE *h = fopen(file, "w");
-         if (h == NULL)
+         // Write to a temporary file and rename it over the original
+         // when closed so any existing mapping of the file stays valid
+         // and concurrent readers only ever see a complete file
+         char *tmpname = xasprintf("%s.tmp.%d", file, getpid());
+
+         FILE *h = fopen(tmpname, "w");
+         if (h == NULL) {
+            free(tmpname);
             return NULL;
+         }
+
+         f = xcalloc(sizeof(struct fbuf));
+
+         f->file    = h;
+         f->tmpname = tmpname;
+         f->codec   = default_codec;
+         f->wbuf    = xmalloc(SPILL_SIZE);
 
-         f = xmalloc(sizeof(struct fbuf));
+         uint8_t header[HEADER_SIZE];
+         memcpy(header, magic, sizeof(magic));
+         header[HEADER_SIZE - 1] = f->codec;
 
-         f->file  = h;
-         f->rmap  = NULL;
-         f->rbuf  = NULL;
-         f->wbuf  = xmalloc(SPILL_SIZE);
-         f->wpend = 0;
+         if (fwrite(header, HEADER_SIZE, 1, f->file) != 1)
+            fatal("fwrite failed");
       }
       break;
 
@@ -96,16 +216,21 @@ fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
 
          close(fd);
 
-         f = xmalloc(sizeof(struct fbuf));
+         f = xcalloc(sizeof(struct fbuf));
 
-         f->file   = NULL;
          f->rmap   = rmap;
          f->rbuf   = xmalloc(SPILL_SIZE);
-         f->rptr   = 0;
-         f->roff   = 0;
-         f->ravail = 0;
+         f->roff   = HEADER_SIZE;
          f->maplen = buf.st_size;
-         f->wbuf   = NULL;
+         f->st     = buf;
+
+         if (f->maplen < HEADER_SIZE
+             || memcmp(f->rmap, magic, sizeof(magic)) != 0
+             || f->rmap[HEADER_SIZE - 1] > FBUF_CODEC_NONE)
+            fatal("file %s was not written by this version of "
+                  PACKAGE_NAME " and should be regenerated", file);
+
+         f->codec = f->rmap[HEADER_SIZE - 1];
       }
       break;
    }
@@ -121,38 +246,112 @@ fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
    return (open_list = f);
 }
 
+const struct stat *fbuf_stat(fbuf_t *f)
+{
+   // Status of the file when it was opened for reading
+   assert(f->mode == FBUF_IN);
+   return &(f->st);
+}
+
+static void fbuf_retire(fbuf_t *f)
+{
+   // Write out the oldest block once it has been compressed
+   assert(f->icount > 0);
+
+   block_t *b = f->inflight[f->ihead];
+
+   if (nworkers > 0) {
+      pthread_mutex_lock(&queue_lock);
+      while (!b->done)
+         pthread_cond_wait(&queue_done, &queue_lock);
+      pthread_mutex_unlock(&queue_lock);
+   }
+
+   const uint8_t blksz[4] = {
+      (b->outlen >> 24) & 0xff,
+      (b->outlen >> 16) & 0xff,
+      (b->outlen >> 8) & 0xff,
+      b->outlen & 0xff
+   };
+
+   if (fwrite(blksz, 4, 1, f->file) != 1)
+      fatal("fwrite failed");
+
+   if (fwrite(b->out, b->outlen, 1, f->file) != 1)
+      fatal("fwrite failed");
+
+   f->ihead = (f->ihead + 1) % MAX_INFLIGHT;
+   f->icount--;
+
+   free(b->in);
+   free(b->out);
+   free(b);
+}
+
 static void fbuf_maybe_flush(fbuf_t *f, size_t more, bool finish)
 {
    assert(more <= BLOCK_SIZE);
    if (f->wpend + more > BLOCK_SIZE) {
-      if (f->wpend < 16) {
-         // Write dummy bytes at and to meet fastlz block size requirement
-         assert(finish);
-         f->wpend = 16;
-      }
+      assert(f->wpend >= 16 || finish);
 
-      uint8_t out[SPILL_SIZE];
-      const int ret = fastlz_compress_level(2, f->wbuf, f->wpend, out);
+      block_t *b = xmalloc(sizeof(block_t));
+      b->in    = f->wbuf;
+      b->len   = f->wpend;
+      b->out   = xmalloc(SPILL_SIZE);
+      b->codec = f->codec;
+      b->done  = false;
+      b->next  = NULL;
 
-      assert((ret > 0) && (ret < SPILL_SIZE));
+      f->wbuf  = xmalloc(SPILL_SIZE);
+      f->wpend = 0;
+      f->wblkno++;
 
-      const uint8_t blksz[4] = {
-         (ret >> 24) & 0xff,
-         (ret >> 16) & 0xff,
-         (ret >> 8) & 0xff,
-         ret & 0xff
-      };
+      const unsigned limit = MIN(MAX_INFLIGHT, nworkers * 2);
 
-      if (fwrite(blksz, 4, 1, f->file) != 1)
-         fatal("fwrite failed");
+      if (f->icount == MAX(limit, 1))
+         fbuf_retire(f);
 
-      if (fwrite(out, ret, 1, f->file) != 1)
-         fatal("fwrite failed");
+      f->inflight[(f->ihead + f->icount) % MAX_INFLIGHT] = b;
+      f->icount++;
 
-      f->wpend = 0;
+      if (nworkers > 0) {
+         pthread_mutex_lock(&queue_lock);
+         if (queue_tail == NULL)
+            queue_head = queue_tail = b;
+         else
+            queue_tail = queue_tail->next = b;
+         pthread_cond_signal(&queue_work);
+         pthread_mutex_unlock(&queue_lock);
+      }
+      else
+         fbuf_compress(b);
+
+      if (finish || nworkers == 0) {
+         while (f->icount > 0)
+            fbuf_retire(f);
+      }
    }
 }
 
+static uint32_t fbuf_block_size(fbuf_t *f, size_t off)
+{
+   if (off + sizeof(uint32_t) > f->maplen)
+      fatal("file %s is truncated", f->fname);
+
+   const uint8_t *blksz_raw = f->rmap + off;
+
+   const uint32_t blksz =
+      (uint32_t)(blksz_raw[0] << 24)
+      | (uint32_t)(blksz_raw[1] << 16)
+      | (uint32_t)(blksz_raw[2] << 8)
+      | (uint32_t)blksz_raw[3];
+
+   if (blksz > SPILL_SIZE || off + sizeof(uint32_t) + blksz > f->maplen)
+      fatal("file %s has invalid compression format", f->fname);
+
+   return blksz;
+}
+
 static void fbuf_maybe_read(fbuf_t *f, size_t more)
 {
    assert(more <= BLOCK_SIZE);
@@ -160,25 +359,33 @@ static void fbuf_maybe_read(fbuf_t *f, size_t more)
       const size_t overlap = f->ravail - f->rptr;
       memcpy(f->rbuf, f->rbuf + f->rptr, overlap);
 
-      const uint8_t *blksz_raw = f->rmap + f->roff;
-
-      const uint32_t blksz =
-         (uint32_t)(blksz_raw[0] << 24)
-         | (uint32_t)(blksz_raw[1] << 16)
-         | (uint32_t)(blksz_raw[2] << 8)
-         | (uint32_t)blksz_raw[3];
-
-      if (blksz > SPILL_SIZE)
-         fatal("file %s has invalid compression format", f->fname);
-
-      f->roff += sizeof(uint32_t);
-
-      const int ret = fastlz_decompress(f->rmap + f->roff,
-                                        blksz,
-                                        f->rbuf + overlap,
-                                        SPILL_SIZE - overlap);
+      const uint32_t blksz = fbuf_block_size(f, f->roff);
+      const uint8_t *in = f->rmap + f->roff + sizeof(uint32_t);
+      const size_t max = SPILL_SIZE - overlap;
+
+      f->rblkno = f->rnext++;
+      f->roff  += sizeof(uint32_t);
+
+      int ret = 0;
+      switch (f->codec) {
+      case FBUF_CODEC_FASTLZ:
+         ret = fastlz_decompress(in, blksz, f->rbuf + overlap, max);
+         break;
+
+      case FBUF_CODEC_LZ4:
+         ret = LZ4_decompress_safe((const char *)in,
+                                   (char *)f->rbuf + overlap, blksz, max);
+         break;
+
+      case FBUF_CODEC_NONE:
+         if (blksz <= max) {
+            memcpy(f->rbuf + overlap, in, blksz);
+            ret = blksz;
+         }
+         break;
+      }
 
-      if (ret == 0)
+      if (ret <= 0)
          fatal("file %s has invalid compression format", f->fname);
 
       f->roff  += blksz;
@@ -192,15 +399,32 @@ void fbuf_close(fbuf_t *f)
    if (f->rmap != NULL) {
       munmap((void *)f->rmap, f->maplen);
       free(f->rbuf);
+      free(f->blocks);
    }
 
    if (f->wbuf != NULL) {
       fbuf_maybe_flush(f, BLOCK_SIZE, true);
       free(f->wbuf);
+
+      if (f->has_trailer) {
+         uint8_t raw[8];
+         for (int i = 0; i < 8; i++)
+            raw[i] = (f->trailer >> (56 - i * 8)) & 0xff;
+
+         if (fwrite(raw, sizeof(raw), 1, f->file) != 1)
+            fatal("fwrite failed");
+      }
    }
 
-   if (f->file != NULL)
-      fclose(f->file);
+   if (f->file != NULL) {
+      if (fclose(f->file) != 0)
+         fatal_errno("fclose: %s", f->tmpname);
+
+      if (rename(f->tmpname, f->fname) != 0)
+         fatal_errno("rename: %s", f->fname);
+
+      free(f->tmpname);
+   }
 
    if (f->prev == NULL) {
       assert(f == open_list);
@@ -218,6 +442,80 @@ void fbuf_close(fbuf_t *f)
    free(f);
 }
 
+uint64_t fbuf_tell(fbuf_t *f)
+{
+   // Positions encode the number of the block in the upper bits and
+   // the offset within the uncompressed data below
+   if (f->mode == FBUF_OUT)
+      return ((uint64_t)f->wblkno << 16) | f->wpend;
+   else
+      return ((uint64_t)f->rblkno << 16) | f->rptr;
+}
+
+static size_t fbuf_block_offset(fbuf_t *f, size_t blkno)
+{
+   // Find block offsets by following the chain of length prefixes
+   if (f->nblocks == 0) {
+      f->blocks = xmalloc(sizeof(size_t) * 16);
+      f->blocks[f->nblocks++] = HEADER_SIZE;
+   }
+
+   while (f->nblocks <= blkno) {
+      const size_t prev = f->blocks[f->nblocks - 1];
+      const size_t next = prev + sizeof(uint32_t) + fbuf_block_size(f, prev);
+
+      if ((f->nblocks & (f->nblocks - 1)) == 0 && f->nblocks >= 16)
+         f->blocks = xrealloc(f->blocks, sizeof(size_t) * f->nblocks * 2);
+
+      f->blocks[f->nblocks++] = next;
+   }
+
+   return f->blocks[blkno];
+}
+
+void fbuf_seek(fbuf_t *f, uint64_t pos)
+{
+   assert(f->mode == FBUF_IN);
+
+   const size_t blkno = pos >> 16;
+   const size_t ptr   = pos & 0xffff;
+
+   if (blkno != f->rblkno || f->ravail == 0) {
+      f->roff   = fbuf_block_offset(f, blkno);
+      f->rnext  = blkno;
+      f->rptr   = 0;
+      f->ravail = 0;
+      fbuf_maybe_read(f, 1);
+   }
+
+   if (ptr > f->ravail)
+      fatal("file %s has invalid compression format", f->fname);
+
+   f->rptr = ptr;
+}
+
+void fbuf_put_trailer(fbuf_t *f, uint64_t value)
+{
+   assert(f->mode == FBUF_OUT);
+
+   f->trailer     = value;
+   f->has_trailer = true;
+}
+
+uint64_t fbuf_get_trailer(fbuf_t *f)
+{
+   assert(f->mode == FBUF_IN);
+
+   if (f->maplen < HEADER_SIZE + 8)
+      fatal("file %s is truncated", f->fname);
+
+   uint64_t value = 0;
+   for (int i = 0; i < 8; i++)
+      value = (value << 8) | f->rmap[f->maplen - 8 + i];
+
+   return value;
+}
+
 void write_u32(uint32_t u, fbuf_t *f)
 {
    fbuf_maybe_flush(f, 4, false);
@@ -253,6 +551,24 @@ void write_u8(uint8_t u, fbuf_t *f)
    *(f->wbuf + f->wpend++) = u;
 }
 
+void write_uint(uint64_t u, fbuf_t *f)
+{
+   // Unsigned LEB128: seven bits in each byte with the top bit set on
+   // all but the last byte
+   fbuf_maybe_flush(f, 10, false);
+   while (u >= 0x80) {
+      *(f->wbuf + f->wpend++) = (u & 0x7f) | 0x80;
+      u >>= 7;
+   }
+   *(f->wbuf + f->wpend++) = u;
+}
+
+void write_int(int64_t i, fbuf_t *f)
+{
+   // Zig-zag encoding keeps small negative numbers short
+   write_uint(((uint64_t)i << 1) ^ (uint64_t)(i >> 63), f);
+}
+
 void write_raw(const void *buf, size_t len, fbuf_t *f)
 {
    fbuf_maybe_flush(f, len, false);
@@ -304,6 +620,39 @@ uint64_t read_u64(fbuf_t *f)
    return val;
 }
 
+uint64_t read_uint(fbuf_t *f)
+{
+   uint64_t val = 0;
+
+   if (likely(f->rptr + 10 <= f->ravail)) {
+      // Fast path when the longest encoding is already buffered
+      const uint8_t *p = f->rbuf + f->rptr;
+      for (int shift = 0; shift < 64; shift += 7) {
+         const uint8_t byte = *p++;
+         val |= (uint64_t)(byte & 0x7f) << shift;
+         if (!(byte & 0x80))
+            break;
+      }
+      f->rptr = p - f->rbuf;
+   }
+   else {
+      for (int shift = 0; shift < 64; shift += 7) {
+         const uint8_t byte = read_u8(f);
+         val |= (uint64_t)(byte & 0x7f) << shift;
+         if (!(byte & 0x80))
+            break;
+      }
+   }
+
+   return val;
+}
+
+int64_t read_int(fbuf_t *f)
+{
+   const uint64_t u = read_uint(f);
+   return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
 void read_raw(void *buf, size_t len, fbuf_t *f)
 {
    fbuf_maybe_read(f, len);
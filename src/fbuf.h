@@ -26,25 +26,48 @@
 
 typedef struct fbuf fbuf_t;
 
+struct stat;
+
 typedef enum {
    FBUF_IN,
    FBUF_OUT,
 } fbuf_mode_t;
 
+typedef enum {
+   FBUF_CODEC_FASTLZ,
+   FBUF_CODEC_LZ4,
+   FBUF_CODEC_NONE
+} fbuf_codec_t;
+
 fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode);
 void fbuf_close(fbuf_t *f);
+const struct stat *fbuf_stat(fbuf_t *f);
 void fbuf_cleanup(void);
 
+// Codec for files opened for writing afterwards and number of threads
+// used to compress blocks in the background
+void fbuf_set_codec(fbuf_codec_t codec);
+void fbuf_set_threads(int nthreads);
+
+uint64_t fbuf_tell(fbuf_t *f);
+void fbuf_seek(fbuf_t *f, uint64_t pos);
+void fbuf_put_trailer(fbuf_t *f, uint64_t value);
+uint64_t fbuf_get_trailer(fbuf_t *f);
+
 void write_u32(uint32_t u, fbuf_t *f);
 void write_u16(uint16_t s, fbuf_t *f);
 void write_u64(uint64_t i, fbuf_t *f);
 void write_u8(uint8_t u, fbuf_t *f);
+void write_uint(uint64_t u, fbuf_t *f);
+void write_int(int64_t i, fbuf_t *f);
 void write_raw(const void *buf, size_t len, fbuf_t *f);
 
 uint32_t read_u32(fbuf_t *f);
 uint16_t read_u16(fbuf_t *f);
 uint64_t read_u64(fbuf_t *f);
 uint8_t read_u8(fbuf_t *f);
+uint64_t read_uint(fbuf_t *f);
+int64_t read_int(fbuf_t *f);
 void read_raw(void *buf, size_t len, fbuf_t *f);
 
 #endif  // _FBUF_H
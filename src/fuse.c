@@ -0,0 +1,325 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "tree.h"
+#include "phase.h"
+#include "common.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+//
+// Merge small combinational processes that are sensitive to the same
+// signals into a single process
+//
+
+#define FUSE_MAX_NODES 64    // Size of the largest process to merge
+#define FUSE_MAX_PROCS 32    // Largest number of processes in a cluster
+
+typedef struct {
+   tree_t    proc;
+   int       index;
+   uint64_t  hash;
+   tree_t    wait;
+} fuse_cand_t;
+
+typedef struct {
+   bool ok;
+} fuse_check_ctx_t;
+
+static tree_t fuse_signal_decl(tree_t name)
+{
+   for (;;) {
+      switch (tree_kind(name)) {
+      case T_ARRAY_REF:
+      case T_ARRAY_SLICE:
+      case T_RECORD_REF:
+         name = tree_value(name);
+         break;
+      case T_REF:
+         {
+            tree_t decl = tree_ref(name);
+            return tree_kind(decl) == T_SIGNAL_DECL ? decl : NULL;
+         }
+      default:
+         return NULL;
+      }
+   }
+}
+
+static void fuse_check_fn(tree_t t, void *_ctx)
+{
+   fuse_check_ctx_t *ctx = _ctx;
+
+   switch (tree_kind(t)) {
+   case T_ASSERT:
+   case T_PCALL:
+      // Keep reports attributed to the original process and procedures
+      // may contain wait statements
+      ctx->ok = false;
+      break;
+
+   case T_SIGNAL_ASSIGN:
+      {
+         // Running the process again when an unrelated input changes
+         // would reschedule a delayed transaction
+         const int nwaves = tree_waveforms(t);
+         for (int i = 0; i < nwaves; i++) {
+            if (tree_has_delay(tree_waveform(t, i)))
+               ctx->ok = false;
+         }
+
+         if (tree_has_reject(t)
+             || fuse_signal_decl(tree_target(t)) == NULL)
+            ctx->ok = false;
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+static bool fuse_candidate(tree_t proc, fuse_cand_t *cand)
+{
+   if (tree_kind(proc) != T_PROCESS || !tree_attr_int(proc, comb_i, 0))
+      return false;
+   else if (tree_decls(proc) > 0)
+      return false;
+
+   const int nstmts = tree_stmts(proc);
+   tree_t wait = tree_stmt(proc, nstmts - 1);
+   assert(tree_kind(wait) == T_WAIT);
+
+   const int ntriggers = tree_triggers(wait);
+   if (ntriggers == 0)
+      return false;
+
+   // The sensitivity list must name whole signals so it can be compared
+   // by declaration
+   uint64_t hash = ntriggers;
+   for (int i = 0; i < ntriggers; i++) {
+      tree_t trigger = tree_trigger(wait, i);
+      if (tree_kind(trigger) != T_REF
+          || tree_kind(tree_ref(trigger)) != T_SIGNAL_DECL)
+         return false;
+
+      // Order independent so the same set of signals hashes the same
+      hash += (uintptr_t)tree_ref(trigger) * 0x9e3779b97f4a7c15ull;
+   }
+
+   fuse_check_ctx_t ctx = { .ok = true };
+   if (tree_visit(proc, fuse_check_fn, &ctx) > FUSE_MAX_NODES || !ctx.ok)
+      return false;
+
+   cand->proc = proc;
+   cand->hash = hash;
+   cand->wait = wait;
+   return true;
+}
+
+static int fuse_cand_cmp(const void *a, const void *b)
+{
+   const fuse_cand_t *ca = a, *cb = b;
+
+   if (ca->hash != cb->hash)
+      return (ca->hash > cb->hash) - (ca->hash < cb->hash);
+   else
+      return ca->index - cb->index;
+}
+
+static bool fuse_same_triggers(tree_t a, tree_t b)
+{
+   const int ntriggers = tree_triggers(a);
+   if (tree_triggers(b) != ntriggers)
+      return false;
+
+   for (int i = 0; i < ntriggers; i++) {
+      tree_t decl = tree_ref(tree_trigger(a, i));
+
+      bool found = false;
+      for (int j = 0; j < ntriggers && !found; j++)
+         found = (tree_ref(tree_trigger(b, j)) == decl);
+
+      if (!found)
+         return false;
+   }
+
+   return true;
+}
+
+typedef struct {
+   int *owner;
+   int  cluster;
+   bool ok;
+   bool claim;
+} fuse_driver_ctx_t;
+
+static void fuse_driver_fn(tree_t t, void *_ctx)
+{
+   fuse_driver_ctx_t *ctx = _ctx;
+
+   tree_t decl = fuse_signal_decl(tree_target(t));
+   assert(decl != NULL);
+
+   const int nnets = tree_nets(decl);
+   for (int i = 0; i < nnets; i++) {
+      const netid_t nid = tree_net(decl, i);
+      if (ctx->claim)
+         ctx->owner[nid] = ctx->cluster;
+      else if (ctx->owner[nid] == ctx->cluster)
+         ctx->ok = false;
+   }
+}
+
+static bool fuse_claim_drivers(tree_t proc, int *owner, int cluster)
+{
+   // Each process has its own driver for every signal it assigns so
+   // two processes driving the same net cannot be merged without
+   // changing the resolved value
+
+   fuse_driver_ctx_t ctx = {
+      .owner   = owner,
+      .cluster = cluster,
+      .ok      = true,
+      .claim   = false
+   };
+   tree_visit_only(proc, fuse_driver_fn, &ctx, T_SIGNAL_ASSIGN);
+
+   if (!ctx.ok)
+      return false;
+
+   ctx.claim = true;
+   tree_visit_only(proc, fuse_driver_fn, &ctx, T_SIGNAL_ASSIGN);
+   return true;
+}
+
+static tree_t fuse_merge(fuse_cand_t **members, int nmembers)
+{
+   tree_t first = members[0]->proc;
+
+   tree_t p = tree_new(T_PROCESS);
+   tree_set_ident(p, tree_ident(first));
+   tree_set_loc(p, tree_loc(first));
+   tree_add_attr_str(p, inst_name_i, tree_attr_str(first, inst_name_i));
+   tree_add_attr_int(p, comb_i, 1);
+
+   for (int i = 0; i < nmembers; i++) {
+      tree_t proc = members[i]->proc;
+      const int nstmts = tree_stmts(proc);
+      for (int j = 0; j < nstmts - 1; j++)
+         tree_add_stmt(p, tree_stmt(proc, j));
+   }
+
+   tree_add_stmt(p, members[0]->wait);
+   return p;
+}
+
+static tree_t fuse_rewrite_fn(tree_t t, void *ctx)
+{
+   hash_t *map = ctx;
+
+   if (tree_kind(t) != T_PROCESS)
+      return t;
+
+   void *with = hash_get(map, t);
+   if (with == NULL)
+      return t;
+   else if (with == map)
+      return NULL;   // Merged into another process
+   else
+      return with;
+}
+
+void fuse_processes(tree_t top)
+{
+   const int nstmts = tree_stmts(top);
+   fuse_cand_t *cands = xmalloc(MAX(nstmts, 1) * sizeof(fuse_cand_t));
+
+   int ncands = 0;
+   for (int i = 0; i < nstmts; i++) {
+      if (fuse_candidate(tree_stmt(top, i), &(cands[ncands])))
+         cands[ncands++].index = i;
+   }
+
+   // Sorting by the hash of the sensitivity list brings together all
+   // the processes that may be merged while keeping them in their
+   // original order within each run
+
+   qsort(cands, ncands, sizeof(fuse_cand_t), fuse_cand_cmp);
+
+   const int nnets = tree_attr_int(top, nnets_i, 0);
+   int *owner = xmalloc(MAX(nnets, 1) * sizeof(int));
+   for (int i = 0; i < nnets; i++)
+      owner[i] = -1;
+
+   fuse_cand_t **members = xmalloc(FUSE_MAX_PROCS * sizeof(fuse_cand_t *));
+   hash_t *map = hash_new(MAX(ncands * 2, 16), true);
+
+   int nclusters = 0, nmerged = 0, nfused = 0;
+   bool *used = xcalloc(MAX(ncands, 1) * sizeof(bool));
+
+   for (int i = 0; i < ncands; i++) {
+      if (used[i])
+         continue;
+
+      const int cluster = nclusters++;
+      int nmembers = 0;
+
+      members[nmembers++] = &(cands[i]);
+      used[i] = true;
+      fuse_claim_drivers(cands[i].proc, owner, cluster);
+
+      for (int j = i + 1; j < ncands && nmembers < FUSE_MAX_PROCS; j++) {
+         if (cands[j].hash != cands[i].hash)
+            break;
+         else if (used[j])
+            continue;
+         else if (!fuse_same_triggers(cands[i].wait, cands[j].wait))
+            continue;
+         else if (!fuse_claim_drivers(cands[j].proc, owner, cluster))
+            break;
+
+         members[nmembers++] = &(cands[j]);
+         used[j] = true;
+      }
+
+      if (nmembers == 1)
+         continue;
+
+      hash_put(map, members[0]->proc, fuse_merge(members, nmembers));
+      for (int j = 1; j < nmembers; j++)
+         hash_put(map, members[j]->proc, map);
+
+      nmerged += nmembers;
+      nfused++;
+   }
+
+   if (nmerged > 0)
+      tree_rewrite(top, fuse_rewrite_fn, map);
+
+   if (opt_get_int("verbose"))
+      notef("fused %d processes into %d", nmerged, nfused);
+
+   hash_free(map);
+   free(used);
+   free(members);
+   free(owner);
+   free(cands);
+}
@@ -23,157 +23,137 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 typedef struct {
-   group_t   *groups;
-   group_t   *free_list;
-   groupid_t  next_gid;
-   group_t  **lookup;
-   int        nnets;
+   netid_t net;
+   int32_t cover;    // Change in the number of slices covering the net
+   int32_t split;    // Change in the number of ranges split into nets
+} group_edge_t;
+
+typedef struct {
+   group_t      *groups;
+   groupid_t     next_gid;
+   group_edge_t *edges;
+   size_t        nedges;
+   size_t        maxedges;
+   int           nnets;
+   bool         *observed;
 } group_nets_ctx_t;
 
 static void group_target(tree_t t, group_nets_ctx_t *ctx);
 
-static groupid_t group_alloc(group_nets_ctx_t *ctx,
-                             netid_t first, unsigned length)
+static void group_alloc(group_nets_ctx_t *ctx, netid_t first, unsigned length)
 {
-   group_t *g;
-   if (ctx->free_list != NULL) {
-      g = ctx->free_list;
-      ctx->free_list = g->next;
-   }
-   else
-      g = xmalloc(sizeof(group_t));
-
+   group_t *g = xmalloc(sizeof(group_t));
    g->next   = ctx->groups;
    g->gid    = ctx->next_gid++;
    g->first  = first;
    g->length = length;
+   g->flags  = 0;
 
    ctx->groups = g;
+}
 
-   for (netid_t i = first; i < first + length; i++)
-      ctx->lookup[i] = g;
-
-   return g->gid;
+static int group_edge_cmp(const void *a, const void *b)
+{
+   const netid_t na = ((const group_edge_t *)a)->net;
+   const netid_t nb = ((const group_edge_t *)b)->net;
+   return (na > nb) - (na < nb);
 }
 
-static void group_unlink(group_nets_ctx_t *ctx, group_t *where)
+static void group_compact(group_nets_ctx_t *ctx)
 {
-   where->gid = GROUPID_INVALID;
+   // Sort the edges and merge those at the same net: an edge whose
+   // deltas cancel out must be kept as it is still a group boundary
 
-   if (where == ctx->groups)
-      ctx->groups = where->next;
-   else {
-      for (group_t *it = ctx->groups; it != NULL; it = it->next) {
-         if (it->next == where) {
-            it->next = where->next;
-            return;
-         }
+   qsort(ctx->edges, ctx->nedges, sizeof(group_edge_t), group_edge_cmp);
+
+   size_t wptr = 0;
+   for (size_t i = 0; i < ctx->nedges; i++) {
+      if (wptr > 0 && ctx->edges[wptr - 1].net == ctx->edges[i].net) {
+         ctx->edges[wptr - 1].cover += ctx->edges[i].cover;
+         ctx->edges[wptr - 1].split += ctx->edges[i].split;
       }
-      fatal_trace("unlink group not in list");
+      else
+         ctx->edges[wptr++] = ctx->edges[i];
    }
+
+   ctx->nedges = wptr;
 }
 
-static void group_reuse(group_nets_ctx_t *ctx, group_t *group)
+static void group_edge(group_nets_ctx_t *ctx, netid_t net, int cover, int split)
 {
-   group->next = ctx->free_list;
-   ctx->free_list = group;
+   if (ctx->nedges == ctx->maxedges) {
+      // Many slices repeat the same boundaries so try merging those
+      // before growing the array
+      group_compact(ctx);
+
+      if (ctx->nedges >= ctx->maxedges / 2) {
+         ctx->maxedges = MAX(ctx->maxedges * 2, 256);
+         ctx->edges = xrealloc(ctx->edges,
+                               ctx->maxedges * sizeof(group_edge_t));
+      }
+   }
+
+   group_edge_t *e = &(ctx->edges[ctx->nedges++]);
+   e->net   = net;
+   e->cover = cover;
+   e->split = split;
 }
 
-static groupid_t group_add(group_nets_ctx_t *ctx, netid_t first, int length)
+static void group_add(group_nets_ctx_t *ctx, netid_t first, int length)
 {
+   // Each driver, sensitivity, or declaration slice must be a union of
+   // groups so only its endpoints are recorded here and the smallest
+   // partition satisfying every slice is found later by group_build
+
    assert(length > 0);
    assert(first < ctx->nnets);
    assert(first + length <= ctx->nnets);
 
-   for (netid_t i = first; i < first + length; i++) {
-      group_t *it = ctx->lookup[i];
-      if (it == NULL || it->gid == GROUPID_INVALID)
-         continue;
+   group_edge(ctx, first, 1, 0);
+   group_edge(ctx, first + length, -1, 0);
+}
 
-      if ((it->first == first) && (it->length == length)) {
-         // Exactly matches
-         return it->gid;
-      }
-      else if (it->first >= first + length) {
-         // Disjoint, to the right
-      }
-      else if (first >= it->first + it->length) {
-         // Disjoint, to the left
-      }
-      else if ((first == it->first) && (length > it->length)) {
-         // Overlaps on left
-         group_add(ctx, first + it->length, length - it->length);
-         return GROUPID_INVALID;
-      }
-      else if ((first > it->first)
-               && (first + length == it->first + it->length)) {
-         // Overlaps on right
-         group_unlink(ctx, it);
-         group_add(ctx, it->first, first - it->first);
-         group_reuse(ctx, it);
-         return group_alloc(ctx, first, length);
-      }
-      else if ((first > it->first)
-               && (first + length < it->first + it->length)) {
-         // Overlaps completely
-         group_unlink(ctx, it);
-         group_add(ctx, it->first, first - it->first);
-         group_add(ctx, first + length,
-                   it->first + it->length - first - length);
-         group_reuse(ctx, it);
-         return group_alloc(ctx, first, length);
-      }
-      else if ((first < it->first)
-               && (first + length > it->first + it->length)) {
-         // Contains in middle
-         group_add(ctx, first, it->first - first);
-         group_add(ctx, it->first + it->length,
-                   first + length - it->first - it->length);
-         return GROUPID_INVALID;
-      }
-      else if ((first == it->first)
-               && (first + length < it->first + it->length)) {
-         // Contains on left
-         group_unlink(ctx, it);
-         group_add(ctx, first + length, it->length - length);
-         group_reuse(ctx, it);
-         return group_alloc(ctx, first, length);
-      }
-      else if ((first < it->first)
-               && (first + length == it->first + it->length)) {
-         // Contains on right
-         group_add(ctx, first, it->first - first);
-         return GROUPID_INVALID;
-      }
-      else if ((first < it->first) && (first + length > it->first)) {
-         // Split left
-         group_unlink(ctx, it);
-         group_add(ctx, first, it->first - first);
-         group_add(ctx, it->first, first + length - it->first);
-         group_add(ctx, first + length,
-                   it->first + it->length - first - length);
-         group_reuse(ctx, it);
-         return GROUPID_INVALID;
-      }
-      else if ((first > it->first) && (it->first + it->length > first)) {
-         // Split right
-         group_unlink(ctx, it);
-         group_add(ctx, it->first, first - it->first);
-         group_add(ctx, first, it->first + it->length - first);
-         group_add(ctx, it->first + it->length,
-                   first + length - it->first - it->length);
-         group_reuse(ctx, it);
-         return GROUPID_INVALID;
+static void group_split(group_nets_ctx_t *ctx, netid_t first, int length)
+{
+   // Place every net in the range in a group of its own
+
+   assert(length > 0);
+   assert(first + length <= ctx->nnets);
+
+   group_edge(ctx, first, 0, 1);
+   group_edge(ctx, first + length, 0, -1);
+}
+
+static void group_build(group_nets_ctx_t *ctx)
+{
+   // Sweep over the sorted boundaries creating a group between each
+   // consecutive pair where at least one slice covers the nets
+
+   group_compact(ctx);
+
+   int cover = 0, split = 0;
+   for (size_t i = 0; i + 1 < ctx->nedges; i++) {
+      cover += ctx->edges[i].cover;
+      split += ctx->edges[i].split;
+
+      const netid_t first = ctx->edges[i].net;
+      const netid_t next  = ctx->edges[i + 1].net;
+
+      if (split > 0) {
+         for (netid_t nid = first; nid < next; nid++)
+            group_alloc(ctx, nid, 1);
       }
-      else
-         fatal("unhandled case in group_add: first=%d length=%d "
-               "it->first=%d it->length=%d", first, length,
-               it->first, it->length);
+      else if (cover > 0)
+         group_alloc(ctx, first, next - first);
    }
 
-   return group_alloc(ctx, first, length);
+   free(ctx->edges);
+   ctx->edges    = NULL;
+   ctx->nedges   = 0;
+   ctx->maxedges = 0;
 }
 
 static bool group_contains_record(type_t type)
@@ -272,14 +252,26 @@ static void group_ref(tree_t target, group_nets_ctx_t *ctx, int start, int n)
    }
 }
 
+static void ungroup_decl(tree_t decl, group_nets_ctx_t *ctx)
+{
+   const int nnets = tree_nets(decl);
+   for (int i = 0; i < nnets;) {
+      const netid_t first = tree_net(decl, i);
+
+      int length = 1;
+      while (i + length < nnets && tree_net(decl, i + length) == first + length)
+         length++;
+
+      group_split(ctx, first, length);
+      i += length;
+   }
+}
+
 static void ungroup_ref(tree_t target, group_nets_ctx_t *ctx)
 {
    tree_t decl = tree_ref(target);
-   if (tree_kind(decl) == T_SIGNAL_DECL) {
-      const int nnets = tree_nets(decl);
-      for (int i = 0; i < nnets; i++)
-         group_add(ctx, tree_net(decl, i), 1);
-   }
+   if (tree_kind(decl) == T_SIGNAL_DECL)
+      ungroup_decl(decl, ctx);
 }
 
 static void ungroup_name(tree_t name, group_nets_ctx_t *ctx)
@@ -450,9 +442,63 @@ static void ungroup_proc_params(tree_t t, group_nets_ctx_t *ctx)
       if (tree_kind(decl) != T_SIGNAL_DECL)
          return;
 
-      const int nnets = tree_nets(decl);
-      for (int i = 0; i < nnets; i++)
-         group_add(ctx, tree_net(decl, i), 1);
+      ungroup_decl(decl, ctx);
+   }
+}
+
+static void group_observe(tree_t name, group_nets_ctx_t *ctx)
+{
+   // Conservatively mark every net of a signal whose events or
+   // transactions may be observed
+
+   for (;;) {
+      switch (tree_kind(name)) {
+      case T_ARRAY_REF:
+      case T_ARRAY_SLICE:
+      case T_RECORD_REF:
+         name = tree_value(name);
+         continue;
+      case T_REF:
+         break;
+      default:
+         return;
+      }
+      break;
+   }
+
+   tree_t decl = tree_ref(name);
+   switch (tree_kind(decl)) {
+   case T_SIGNAL_DECL:
+      {
+         const int nnets = tree_nets(decl);
+         for (int i = 0; i < nnets; i++)
+            ctx->observed[tree_net(decl, i)] = true;
+      }
+      break;
+   case T_ALIAS:
+      group_observe(tree_value(decl), ctx);
+      break;
+   default:
+      break;
+   }
+}
+
+static void group_observe_params(tree_t t, group_nets_ctx_t *ctx)
+{
+   // A subprogram may wait on or test attributes of any signal passed
+   // to it as a signal parameter
+
+   tree_t decl = tree_ref(t);
+   const int nports = tree_ports(decl);
+
+   const int nparams = tree_params(t);
+   for (int i = 0; i < nparams; i++) {
+      tree_t p = tree_param(t, i);
+      if (tree_subkind(p) == P_POS && i < nports
+          && tree_class(tree_port(decl, i)) != C_SIGNAL)
+         continue;
+
+      group_observe(tree_value(p), ctx);
    }
 }
 
@@ -468,13 +514,38 @@ static void group_nets_visit_fn(tree_t t, void *_ctx)
    case T_WAIT:
       {
          const int ntriggers = tree_triggers(t);
-         for (int i = 0; i < ntriggers; i++)
+         for (int i = 0; i < ntriggers; i++) {
             group_target(tree_trigger(t, i), ctx);
+            group_observe(tree_trigger(t, i), ctx);
+         }
       }
       break;
 
    case T_PCALL:
       ungroup_proc_params(t, ctx);
+      group_observe_params(t, ctx);
+      break;
+
+   case T_FCALL:
+      group_observe_params(t, ctx);
+      break;
+
+   case T_ATTR_REF:
+      switch (tree_attr_int(t, builtin_i, -1)) {
+      case ATTR_EVENT:
+      case ATTR_ACTIVE:
+      case ATTR_LAST_EVENT:
+      case ATTR_LAST_ACTIVE:
+      case ATTR_LAST_VALUE:
+      case ATTR_DELAYED:
+      case ATTR_STABLE:
+      case ATTR_QUIET:
+      case ATTR_TRANSACTION:
+         group_observe(tree_name(t), ctx);
+         break;
+      default:
+         break;
+      }
       break;
 
    case T_SIGNAL_DECL:
@@ -487,24 +558,78 @@ static void group_nets_visit_fn(tree_t t, void *_ctx)
    }
 }
 
+static int group_first_cmp(const void *a, const void *b)
+{
+   const netid_t fa = (*(const group_t **)a)->first;
+   const netid_t fb = (*(const group_t **)b)->first;
+   return (fa > fb) - (fa < fb);
+}
+
 static void group_write_netdb(tree_t top, group_nets_ctx_t *ctx)
 {
    char *name = xasprintf("_%s.netdb", istr(tree_ident(top)));
 
-   fbuf_t *f = lib_fbuf_open(lib_work(), name, FBUF_OUT);
+   FILE *f = lib_fopen(lib_work(), name, "w");
    if (f == NULL)
-      fatal("failed to create net database file %s", name);
+      fatal_errno("failed to create net database file %s", name);
 
    free(name);
 
-   for (group_t *it = ctx->groups; it != NULL; it = it->next) {
-      write_u32(it->gid, f);
-      write_u32(it->first, f);
-      write_u32(it->length, f);
+   // Groups are written sorted by their first net and renumbered in
+   // that order so the runtime can search the mapped file directly
+
+   const unsigned ngroups = ctx->next_gid;
+   group_t **sorted = xmalloc(ngroups * sizeof(group_t *));
+
+   unsigned n = 0;
+   for (group_t *it = ctx->groups; it != NULL; it = it->next)
+      sorted[n++] = it;
+   assert(n == ngroups);
+
+   qsort(sorted, ngroups, sizeof(group_t *), group_first_cmp);
+
+   netid_t *first = xmalloc(ngroups * sizeof(netid_t));
+   uint32_t *length = xmalloc(ngroups * sizeof(uint32_t));
+   uint8_t *flags = xmalloc(ngroups);
+
+   for (unsigned i = 0; i < ngroups; i++) {
+      group_t *it = sorted[i];
+
+      it->flags = GROUP_F_NO_READERS;
+      for (netid_t nid = it->first; nid < it->first + it->length; nid++) {
+         if (ctx->observed[nid]) {
+            it->flags &= ~GROUP_F_NO_READERS;
+            break;
+         }
+      }
+
+      it->gid   = i;
+      first[i]  = it->first;
+      length[i] = it->length;
+      flags[i]  = it->flags;
    }
-   write_u32(GROUPID_INVALID, f);
 
-   fbuf_close(f);
+   const netdb_hdr_t hdr = {
+      .magic   = NETDB_MAGIC,
+      .version = NETDB_VERSION,
+      .ngroups = ngroups,
+      .nnets   = ctx->nnets
+   };
+
+   bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+   ok = ok && fwrite(first, sizeof(netid_t), ngroups, f) == ngroups;
+   ok = ok && fwrite(length, sizeof(uint32_t), ngroups, f) == ngroups;
+   ok = ok && fwrite(flags, 1, ngroups, f) == ngroups;
+
+   if (!ok)
+      fatal_errno("failed to write net database");
+
+   fclose(f);
+
+   free(sorted);
+   free(first);
+   free(length);
+   free(flags);
 }
 
 static void group_free_list(group_t *list)
@@ -518,11 +643,13 @@ static void group_free_list(group_t *list)
 
 static void group_init_context(group_nets_ctx_t *ctx, int nnets)
 {
-   ctx->groups    = NULL;
-   ctx->next_gid  = 0;
-   ctx->lookup    = xcalloc(nnets * sizeof(group_t *));
-   ctx->nnets     = nnets;
-   ctx->free_list = NULL;
+   ctx->groups   = NULL;
+   ctx->next_gid = 0;
+   ctx->edges    = NULL;
+   ctx->nedges   = 0;
+   ctx->maxedges = 0;
+   ctx->nnets    = nnets;
+   ctx->observed = xcalloc(nnets * sizeof(bool));
 }
 
 void group_nets(tree_t top)
@@ -532,19 +659,23 @@ void group_nets(tree_t top)
    group_nets_ctx_t ctx;
    group_init_context(&ctx, nnets);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    group_write_netdb(top, &ctx);
 
    if (opt_get_int("verbose")) {
-      int ngroups = 0;
-      for (group_t *it = ctx.groups; it != NULL; it = it->next)
+      int ngroups = 0, nsilent = 0;
+      for (group_t *it = ctx.groups; it != NULL; it = it->next) {
          ngroups++;
+         if (it->flags & GROUP_F_NO_READERS)
+            nsilent++;
+      }
 
       notef("%d nets, %d groups", nnets, ngroups);
       notef("nets:groups ratio %.3f", (float)nnets / (float)ngroups);
+      notef("%d groups with no readers", nsilent);
    }
 
    group_free_list(ctx.groups);
-   group_free_list(ctx.free_list);
-   free(ctx.lookup);
+   free(ctx.observed);
 }
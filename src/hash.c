@@ -21,6 +21,14 @@
 #include <string.h>
 #include <assert.h>
 
+#if defined __x86_64__ || defined __i386__
+#include <emmintrin.h>
+#define GHASH_SSE2 1
+#elif defined __aarch64__
+#include <arm_neon.h>
+#define GHASH_NEON 1
+#endif
+
 struct hash {
    unsigned     size;
    unsigned     members;
@@ -167,3 +175,358 @@ bool hash_iter(hash_t *h, hash_iter_t *now, const void **key, void **value)
    *now = HASH_END;
    return false;
 }
+
+// Generic hash table
+//
+// Slots are split into groups of sixteen each with a control byte that
+// is either empty, deleted, or the low seven bits of the hash of the
+// key stored there. A lookup compares the whole group of control bytes
+// at once and only touches the keys whose bits match. Probing stops at
+// the first group with an empty slot so a slot can be marked empty again
+// on deletion unless its group is full. A separate array records the
+// slots in insertion order and is compacted when the table is rebuilt,
+// and each slot holds its position in that array.
+
+#define GROUP_SIZE   16
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+#define ORDER_DEAD   UINT32_MAX
+
+typedef struct {
+   uint64_t  key;
+   void     *value;
+} ghash_slot_t;
+
+struct ghash {
+   ghash_kind_t  kind;
+   unsigned      ngroups;
+   unsigned      members;
+   unsigned      used;
+   int8_t       *ctrl;
+   ghash_slot_t *slots;
+   uint32_t     *rank;
+   uint32_t     *order;
+   unsigned      norder;
+   unsigned      ordalloc;
+};
+
+static inline unsigned group_match(const int8_t *ctrl, int8_t byte)
+{
+#if GHASH_SSE2
+   const __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(byte)));
+#elif GHASH_NEON
+   static const uint8_t bits[16] = {
+      1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+   };
+   const uint8x16_t eq = vceqq_s8(vld1q_s8(ctrl), vdupq_n_s8(byte));
+   const uint8x16_t m = vandq_u8(eq, vld1q_u8(bits));
+   return vaddv_u8(vget_low_u8(m)) | (vaddv_u8(vget_high_u8(m)) << 8);
+#else
+   unsigned mask = 0;
+   for (int i = 0; i < GROUP_SIZE; i++)
+      mask |= (ctrl[i] == byte) << i;
+   return mask;
+#endif
+}
+
+static inline unsigned group_match_free(const int8_t *ctrl)
+{
+   // Empty and deleted are the only control bytes with the top bit set
+#if GHASH_SSE2
+   return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+   unsigned mask = 0;
+   for (int i = 0; i < GROUP_SIZE; i++)
+      mask |= (ctrl[i] < 0) << i;
+   return mask;
+#endif
+}
+
+static inline uint64_t ghash_hash(ghash_t *h, uint64_t key)
+{
+   if (h->kind == GHASH_STR) {
+      // FNV-1a
+      const char *p = (const char *)(uintptr_t)key;
+      for (key = UINT64_C(14695981039346656037); *p; p++)
+         key = (key ^ (uint8_t)*p) * UINT64_C(1099511628211);
+   }
+
+   // Finaliser from MurmurHash3
+   key ^= key >> 33;
+   key *= UINT64_C(0xff51afd7ed558ccd);
+   key ^= key >> 33;
+   return key;
+}
+
+static inline bool ghash_eq(ghash_t *h, uint64_t a, uint64_t b)
+{
+   if (h->kind == GHASH_STR)
+      return strcmp((const char *)(uintptr_t)a, (const char *)(uintptr_t)b)
+         == 0;
+   else
+      return a == b;
+}
+
+ghash_t *ghash_new(ghash_kind_t kind, int size)
+{
+   ghash_t *h = xmalloc(sizeof(ghash_t));
+   memset(h, '\0', sizeof(ghash_t));
+   h->kind = kind;
+
+   // Storage is allocated on the first insertion
+   h->ordalloc = MAX(size, 8);
+
+   return h;
+}
+
+void ghash_free(ghash_t *h)
+{
+   if (h->kind == GHASH_STR) {
+      for (unsigned i = 0; i < h->norder; i++) {
+         if (h->order[i] != ORDER_DEAD)
+            free((void *)(uintptr_t)h->slots[h->order[i]].key);
+      }
+   }
+
+   free(h->ctrl);
+   free(h->slots);
+   free(h->rank);
+   free(h->order);
+   free(h);
+}
+
+unsigned ghash_members(ghash_t *h)
+{
+   return h->members;
+}
+
+static int ghash_find(ghash_t *h, uint64_t key, uint64_t hash)
+{
+   if (h->ngroups == 0)
+      return -1;
+
+   const int8_t h2 = hash & 0x7f;
+   const unsigned mask = h->ngroups - 1;
+
+   unsigned g = (hash >> 7) & mask;
+
+   for (unsigned step = 1;; g = (g + step++) & mask) {
+      const int8_t *ctrl = h->ctrl + g * GROUP_SIZE;
+      for (unsigned m = group_match(ctrl, h2); m != 0; m &= m - 1) {
+         const unsigned slot = g * GROUP_SIZE + __builtin_ctz(m);
+         if (ghash_eq(h, h->slots[slot].key, key))
+            return slot;
+      }
+
+      if (group_match(ctrl, CTRL_EMPTY) != 0)
+         return -1;
+   }
+}
+
+static unsigned ghash_place(ghash_t *h, uint64_t hash)
+{
+   const unsigned mask = h->ngroups - 1;
+
+   unsigned g = (hash >> 7) & mask;
+   for (unsigned step = 1;; g = (g + step++) & mask) {
+      const unsigned m = group_match_free(h->ctrl + g * GROUP_SIZE);
+      if (m != 0) {
+         const unsigned slot = g * GROUP_SIZE + __builtin_ctz(m);
+         if (h->ctrl[slot] == CTRL_EMPTY)
+            h->used++;
+         h->ctrl[slot] = hash & 0x7f;
+         return slot;
+      }
+   }
+}
+
+static void ghash_rebuild(ghash_t *h, unsigned ngroups)
+{
+   const unsigned nslots = ngroups * GROUP_SIZE;
+
+   ghash_slot_t *old = h->slots;
+
+   free(h->ctrl);
+   free(h->rank);
+
+   h->ngroups = ngroups;
+   h->used    = 0;
+   h->ctrl    = xmalloc(nslots);
+   h->slots   = xmalloc(nslots * sizeof(ghash_slot_t));
+   h->rank    = xmalloc(nslots * sizeof(uint32_t));
+   memset(h->ctrl, CTRL_EMPTY, nslots);
+
+   // Drop deleted keys while preserving the order of the rest
+   unsigned n = 0;
+   for (unsigned i = 0; i < h->norder; i++) {
+      if (h->order[i] != ORDER_DEAD) {
+         const ghash_slot_t *from = &(old[h->order[i]]);
+         const unsigned slot = ghash_place(h, ghash_hash(h, from->key));
+         h->slots[slot] = *from;
+         h->rank[slot]  = n;
+         h->order[n++] = slot;
+      }
+   }
+
+   assert(n == h->members);
+   h->norder = n;
+
+   free(old);
+}
+
+static void ghash_insert(ghash_t *h, uint64_t key, void *value)
+{
+   const uint64_t hash = ghash_hash(h, key);
+
+   const int slot = ghash_find(h, key, hash);
+   if (slot >= 0) {
+      h->slots[slot].value = value;
+      return;
+   }
+
+   if (h->used + 1 > h->ngroups * GROUP_SIZE * 7 / 8) {
+      // Grow unless most of the used slots are deleted keys
+      const unsigned want =
+         MAX(h->members + 1, (h->order == NULL) ? h->ordalloc : 0);
+      unsigned ngroups = MAX(h->ngroups, 1);
+      while (want > ngroups * GROUP_SIZE / 2)
+         ngroups *= 2;
+      ghash_rebuild(h, ngroups);
+   }
+
+   if (h->order == NULL)
+      h->order = xmalloc(h->ordalloc * sizeof(uint32_t));
+   else if (h->norder == h->ordalloc) {
+      if (h->members < h->norder / 2)
+         ghash_rebuild(h, h->ngroups);
+      else {
+         h->ordalloc *= 2;
+         h->order = xrealloc(h->order, h->ordalloc * sizeof(uint32_t));
+      }
+   }
+
+   if (h->kind == GHASH_STR) {
+      const char *str = (const char *)(uintptr_t)key;
+      const size_t len = strlen(str) + 1;
+      char *copy = xmalloc(len);
+      memcpy(copy, str, len);
+      key = (uintptr_t)copy;
+   }
+
+   const unsigned where = ghash_place(h, hash);
+   h->slots[where].key   = key;
+   h->slots[where].value = value;
+   h->rank[where]        = h->norder;
+
+   h->order[h->norder++] = where;
+   h->members++;
+}
+
+static bool ghash_remove(ghash_t *h, uint64_t key)
+{
+   const int slot = ghash_find(h, key, ghash_hash(h, key));
+   if (slot < 0)
+      return false;
+
+   if (h->kind == GHASH_STR)
+      free((void *)(uintptr_t)h->slots[slot].key);
+
+   h->order[h->rank[slot]] = ORDER_DEAD;
+   h->members--;
+
+   // No probe sequence continues past a group containing an empty slot
+   const unsigned group = slot & ~(GROUP_SIZE - 1);
+   if (group_match(h->ctrl + group, CTRL_EMPTY) != 0) {
+      h->ctrl[slot] = CTRL_EMPTY;
+      h->used--;
+   }
+   else
+      h->ctrl[slot] = CTRL_DELETED;
+
+   return true;
+}
+
+static void *ghash_lookup(ghash_t *h, uint64_t key)
+{
+   const int slot = ghash_find(h, key, ghash_hash(h, key));
+   return slot < 0 ? NULL : h->slots[slot].value;
+}
+
+static bool ghash_next(ghash_t *h, hash_iter_t *now, uint64_t *key,
+                       void **value)
+{
+   assert(*now != HASH_END);
+
+   while (*now < h->norder) {
+      const uint32_t slot = h->order[(*now)++];
+      if (slot != ORDER_DEAD) {
+         *key   = h->slots[slot].key;
+         *value = h->slots[slot].value;
+         return true;
+      }
+   }
+
+   *now = HASH_END;
+   return false;
+}
+void ghash_put(ghash_t *h, const void *key, void *value)
+{
+   assert(h->kind != GHASH_INT);
+   assert(key != NULL);
+   ghash_insert(h, (uintptr_t)key, value);
+}
+
+void *ghash_get(ghash_t *h, const void *key)
+{
+   assert(h->kind != GHASH_INT);
+   return ghash_lookup(h, (uintptr_t)key);
+}
+
+bool ghash_delete(ghash_t *h, const void *key)
+{
+   assert(h->kind != GHASH_INT);
+   return ghash_remove(h, (uintptr_t)key);
+}
+
+void ghash_put_int(ghash_t *h, int64_t key, void *value)
+{
+   assert(h->kind == GHASH_INT);
+   ghash_insert(h, key, value);
+}
+
+void *ghash_get_int(ghash_t *h, int64_t key)
+{
+   assert(h->kind == GHASH_INT);
+   return ghash_lookup(h, key);
+}
+
+bool ghash_delete_int(ghash_t *h, int64_t key)
+{
+   assert(h->kind == GHASH_INT);
+   return ghash_remove(h, key);
+}
+
+bool ghash_iter(ghash_t *h, hash_iter_t *now, const void **key, void **value)
+{
+   assert(h->kind != GHASH_INT);
+
+   uint64_t k;
+   if (!ghash_next(h, now, &k, value))
+      return false;
+
+   *key = (const void *)(uintptr_t)k;
+   return true;
+}
+
+bool ghash_iter_int(ghash_t *h, hash_iter_t *now, int64_t *key, void **value)
+{
+   assert(h->kind == GHASH_INT);
+
+   uint64_t k;
+   if (!ghash_next(h, now, &k, value))
+      return false;
+
+   *key = k;
+   return true;
+}
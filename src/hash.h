@@ -37,4 +37,29 @@ void *hash_get_nth(hash_t *h, const void *key, int *n);
 void hash_replace(hash_t *h, void *value, void *with);
 bool hash_iter(hash_t *h, hash_iter_t *now, const void **key, void **value);
 
+// Open addressing table with one control byte per slot probed a group
+// at a time and entries kept in insertion order. Keys are unique and
+// putting an existing key replaces its value. Identifiers are interned
+// so ident_t keys use GHASH_PTR. String keys are copied.
+
+typedef struct ghash ghash_t;
+
+typedef enum {
+   GHASH_PTR,
+   GHASH_INT,
+   GHASH_STR
+} ghash_kind_t;
+
+ghash_t *ghash_new(ghash_kind_t kind, int size);
+void ghash_free(ghash_t *h);
+unsigned ghash_members(ghash_t *h);
+void ghash_put(ghash_t *h, const void *key, void *value);
+void *ghash_get(ghash_t *h, const void *key);
+bool ghash_delete(ghash_t *h, const void *key);
+void ghash_put_int(ghash_t *h, int64_t key, void *value);
+void *ghash_get_int(ghash_t *h, int64_t key);
+bool ghash_delete_int(ghash_t *h, int64_t key);
+bool ghash_iter(ghash_t *h, hash_iter_t *now, const void **key, void **value);
+bool ghash_iter_int(ghash_t *h, hash_iter_t *now, int64_t *key, void **value);
+
 #endif  // _HASH_H
@@ -24,145 +24,146 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-
-#define MAP_DEPTH 3
-
-typedef struct clist clist_t;
-typedef struct trie  trie_t;
-
-struct clist {
-   char     value;
-   trie_t  *down;
-   clist_t *left;
-   clist_t *right;
+#include <pthread.h>
+
+// Identifiers are interned in an open-addressed hash table split into
+// shards selected by the top bits of the hash, each with its own lock,
+// so that several threads may intern strings at once. The characters
+// are stored inline after the header in an append-only arena which is
+// never freed and hence istr can return a pointer directly.
+
+#define SHARD_BITS  6
+#define NUM_SHARDS  (1 << SHARD_BITS)
+#define INIT_SLOTS  256
+#define ARENA_CHUNK (64 * 1024)
+
+struct ident {
+   uint32_t length;
+   uint32_t hash;
+   uint32_t write_gen;
+   uint32_t write_index;
+   char     bytes[0];
 };
 
-struct trie {
-   char      value;
-   uint16_t  write_gen;
-   uint16_t  depth;
-   uint32_t  write_index;
-   trie_t   *up;
-   clist_t  *list;
-   trie_t   *map[0];
-};
+typedef struct {
+   pthread_mutex_t  lock;
+   ident_t         *table;
+   unsigned         size;
+   unsigned         members;
+   char            *arena;
+   size_t           arena_left;
+} shard_t;
 
 struct ident_rd_ctx {
    fbuf_t  *file;
    size_t   cache_sz;
    size_t   cache_alloc;
    ident_t *cache;
+   char    *buf;
+   size_t   buf_sz;
 };
 
 struct ident_wr_ctx {
    fbuf_t   *file;
    uint32_t  next_index;
-   uint16_t  generation;
+   uint32_t  generation;
 };
 
-typedef struct {
-   trie_t  trie;
-   trie_t *map[256];
-} root_t;
-
-static root_t root = {
-   {
-      .value       = '\0',
-      .write_gen   = 0,
-      .write_index = 0,
-      .depth       = 1,
-      .up          = NULL
-   }
+static shard_t shards[NUM_SHARDS] = {
+   [0 ... NUM_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
 };
 
-static trie_t *alloc_node(char ch, trie_t *prev)
+static inline uint32_t ident_hash(const char *str, size_t len)
 {
-   const size_t mapsz = (prev->depth < MAP_DEPTH) ? 256 * sizeof(trie_t *) : 0;
-
-   trie_t *t = xmalloc(sizeof(trie_t) + mapsz);
-   t->value     = ch;
-   t->depth     = prev->depth + 1;
-   t->up        = prev;
-   t->write_gen = 0;
-   t->list      = NULL;
+   // FNV-1a
+   uint32_t h = UINT32_C(2166136261);
+   for (size_t i = 0; i < len; i++)
+      h = (h ^ (uint8_t)str[i]) * UINT32_C(16777619);
+   return h;
+}
 
-   if (mapsz > 0)
-      memset(t->map, '\0', mapsz);
+static ident_t ident_alloc(shard_t *s, const char *str, size_t len,
+                           uint32_t hash)
+{
+   const size_t size =
+      (sizeof(struct ident) + len + 1 + sizeof(void *) - 1)
+      & ~(sizeof(void *) - 1);
 
-   if (prev->depth <= MAP_DEPTH)
-      prev->map[(unsigned char)ch] = t;
+   ident_t id;
+   if (size > ARENA_CHUNK / 4)
+      id = xmalloc(size);
    else {
-      clist_t *c = xmalloc(sizeof(clist_t));
-      c->value    = ch;
-      c->down     = t;
-      c->left     = NULL;
-      c->right    = NULL;
-
-      clist_t *it, **where;
-      for (it = prev->list, where = &(prev->list);
-           it != NULL;
-           where = (ch < it->value ? &(it->left) : &(it->right)),
-              it = *where)
-         ;
+      if (s->arena_left < size) {
+         s->arena      = xmalloc(ARENA_CHUNK);
+         s->arena_left = ARENA_CHUNK;
+      }
 
-      *where = c;
+      id = (ident_t)s->arena;
+      s->arena      += size;
+      s->arena_left -= size;
    }
 
-   return t;
-}
+   id->length      = len;
+   id->hash        = hash;
+   id->write_gen   = 0;
+   id->write_index = 0;
 
-static void build_trie(const char *str, trie_t *prev, trie_t **end)
-{
-   assert(*str != '\0');
-   assert(prev != NULL);
+   memcpy(id->bytes, str, len);
+   id->bytes[len] = '\0';
 
-   trie_t *t = alloc_node(*str, prev);
+   return id;
+}
 
-   if (*(++str) == '\0')
-      *end = t;
-   else
-      build_trie(str, t, end);
+static ident_t *ident_probe(shard_t *s, const char *str, size_t len,
+                            uint32_t hash)
+{
+   for (unsigned slot = hash & (s->size - 1);;
+        slot = (slot + 1) & (s->size - 1)) {
+      ident_t id = s->table[slot];
+      if (id == NULL)
+         return &(s->table[slot]);
+      else if (id->hash == hash && id->length == len
+               && memcmp(id->bytes, str, len) == 0)
+         return &(s->table[slot]);
+   }
 }
 
-static clist_t *search_node(trie_t *t, char ch)
+static void ident_grow(shard_t *s)
 {
-   clist_t *it;
-   for (it = t->list;
-        (it != NULL) && (it->value != ch);
-        it = (ch < it->value ? it->left : it->right))
-      ;
+   ident_t *old = s->table;
+   const unsigned old_size = s->size;
+
+   s->size  = (old_size == 0) ? INIT_SLOTS : old_size * 2;
+   s->table = xmalloc(s->size * sizeof(ident_t));
+   memset(s->table, '\0', s->size * sizeof(ident_t));
+
+   for (unsigned i = 0; i < old_size; i++) {
+      if (old[i] != NULL)
+         *ident_probe(s, old[i]->bytes, old[i]->length, old[i]->hash) = old[i];
+   }
 
-   return it;
+   free(old);
 }
 
-static bool search_trie(const char **str, trie_t *t, trie_t **end)
+static ident_t ident_lookup(const char *str, size_t len, bool create)
 {
-   assert(**str != '\0');
-   assert(t != NULL);
+   const uint32_t hash = ident_hash(str, len);
+   shard_t *s = &(shards[hash >> (32 - SHARD_BITS)]);
 
-   trie_t *next = NULL;
+   pthread_mutex_lock(&(s->lock));
 
-   if (t->depth <= MAP_DEPTH)
-      next = t->map[(unsigned char)**str];
-   else {
-      clist_t *it = search_node(t, **str);
-      next = (it != NULL) ? it->down : NULL;
-   }
+   if (unlikely(s->members >= s->size / 2))
+      ident_grow(s);
 
-   if (next == NULL) {
-      *end = t;
-      return false;
+   ident_t *slot = ident_probe(s, str, len, hash);
+   if (*slot == NULL && create) {
+      *slot = ident_alloc(s, str, len, hash);
+      s->members++;
    }
-   else {
-      (*str)++;
 
-      if (**str == '\0') {
-         *end = next;
-         return true;
-      }
-      else
-         return search_trie(str, next, end);
-   }
+   ident_t result = *slot;
+   pthread_mutex_unlock(&(s->lock));
+   return result;
 }
 
 ident_t ident_new(const char *str)
@@ -170,11 +171,7 @@ ident_t ident_new(const char *str)
    assert(str != NULL);
    assert(*str != '\0');
 
-   trie_t *result;
-   if (!search_trie(&str, &(root.trie), &result))
-      build_trie(str, result, &result);
-
-   return result;
+   return ident_lookup(str, strlen(str), true);
 }
 
 bool ident_interned(const char *str)
@@ -182,34 +179,27 @@ bool ident_interned(const char *str)
    assert(str != NULL);
    assert(*str != '\0');
 
-   trie_t *result;
-   return search_trie(&str, &(root.trie), &result);
+   return ident_lookup(str, strlen(str), false) != NULL;
 }
 
 const char *istr(ident_t ident)
 {
    assert(ident != NULL);
 
-   char *p = get_fmt_buf(ident->depth) + ident->depth - 1;
-   *p = '\0';
-
-   trie_t *it;
-   for (it = ident; it->value != '\0'; it = it->up)
-      *(--p) = it->value;
-
-   return p;
+   return ident->bytes;
 }
 
 ident_wr_ctx_t ident_write_begin(fbuf_t *f)
 {
-   static uint16_t ident_wr_gen = 1;
-   assert(ident_wr_gen > 0);
+   static uint32_t ident_wr_gen = 0;
 
    struct ident_wr_ctx *ctx = xmalloc(sizeof(struct ident_wr_ctx));
    ctx->file       = f;
-   ctx->generation = ident_wr_gen++;
+   ctx->generation = __atomic_add_fetch(&ident_wr_gen, 1, __ATOMIC_RELAXED);
    ctx->next_index = 0;
 
+   assert(ctx->generation > 0);
+
    return ctx;
 }
 
@@ -228,7 +218,7 @@ void ident_write(ident_t ident, ident_wr_ctx_t ctx)
       write_u32(ident->write_index, ctx->file);
    else {
       write_u32(UINT32_MAX, ctx->file);
-      write_raw(istr(ident), ident->depth, ctx->file);
+      write_raw(ident->bytes, ident->length + 1, ctx->file);
 
       ident->write_gen   = ctx->generation;
       ident->write_index = ctx->next_index++;
@@ -244,6 +234,8 @@ ident_rd_ctx_t ident_read_begin(fbuf_t *f)
    ctx->cache_alloc = 256;
    ctx->cache_sz    = 0;
    ctx->cache       = xmalloc(ctx->cache_alloc * sizeof(ident_t));
+   ctx->buf_sz      = 128;
+   ctx->buf         = xmalloc(ctx->buf_sz);
 
    return ctx;
 }
@@ -251,6 +243,7 @@ ident_rd_ctx_t ident_read_begin(fbuf_t *f)
 void ident_read_end(ident_rd_ctx_t ctx)
 {
    free(ctx->cache);
+   free(ctx->buf);
    free(ctx);
 }
 
@@ -263,28 +256,22 @@ ident_t ident_read(ident_rd_ctx_t ctx)
          ctx->cache = xrealloc(ctx->cache, ctx->cache_alloc * sizeof(ident_t));
       }
 
-      trie_t *p = &(root.trie);
+      size_t len = 0;
       char ch;
       while ((ch = read_u8(ctx->file)) != '\0') {
-         trie_t *next = NULL;
-         if (p->depth <= MAP_DEPTH)
-            next = p->map[(unsigned char)ch];
-         else {
-            clist_t *it = search_node(p, ch);
-            next = (it != NULL) ? it->down : NULL;
+         if (len == ctx->buf_sz) {
+            ctx->buf_sz *= 2;
+            ctx->buf = xrealloc(ctx->buf, ctx->buf_sz);
          }
-
-         if (next != NULL)
-            p = next;
-         else
-            p = alloc_node(ch, p);
+         ctx->buf[len++] = ch;
       }
 
-      if (p == &(root.trie))
+      if (len == 0)
          return NULL;
       else {
-         ctx->cache[ctx->cache_sz++] = p;
-         return p;
+         ident_t id = ident_lookup(ctx->buf, len, true);
+         ctx->cache[ctx->cache_sz++] = id;
+         return id;
       }
    }
    else {
@@ -297,20 +284,36 @@ ident_t ident_uniq(const char *prefix)
 {
    static int counter = 0;
 
-   const char *start = prefix;
-   trie_t *end;
-   if (search_trie(&start, &(root.trie), &end)) {
-      const size_t len = strlen(prefix) + 16;
-      char buf[len];
-      snprintf(buf, len, "%s%d", prefix, counter++);
+   const size_t plen = strlen(prefix);
+   const uint32_t hash = ident_hash(prefix, plen);
+   shard_t *s = &(shards[hash >> (32 - SHARD_BITS)]);
+
+   // Check and insert atomically so concurrent callers with the same
+   // prefix cannot both receive the bare prefix
+   pthread_mutex_lock(&(s->lock));
 
-      return ident_new(buf);
+   if (unlikely(s->members >= s->size / 2))
+      ident_grow(s);
+
+   ident_t *slot = ident_probe(s, prefix, plen, hash);
+   ident_t result = NULL;
+   if (*slot == NULL) {
+      result = *slot = ident_alloc(s, prefix, plen, hash);
+      s->members++;
    }
-   else {
-      trie_t *result;
-      build_trie(start, end, &result);
-      return result;
+
+   pthread_mutex_unlock(&(s->lock));
+
+   if (result == NULL) {
+      const size_t len = plen + 16;
+      char buf[len];
+      snprintf(buf, len, "%s%d",
+               prefix, __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+
+      result = ident_new(buf);
    }
+
+   return result;
 }
 
 ident_t ident_prefix(ident_t a, ident_t b, char sep)
@@ -320,24 +323,19 @@ ident_t ident_prefix(ident_t a, ident_t b, char sep)
    else if (b == NULL)
       return a;
 
-   trie_t *result;
+   const size_t len = a->length + (sep != '\0') + b->length;
+   char buf[len];
+   char *p = buf;
 
-   if (sep != '\0') {
-      // Append separator
-      const char sep_str[] = { sep, '\0' };
-      const char *p_sep_str = sep_str;
-      if (!search_trie(&p_sep_str, a, &result))
-         build_trie(p_sep_str, result, &result);
-   }
-   else
-      result = a;
+   memcpy(p, a->bytes, a->length);
+   p += a->length;
 
-   // Append b
-   const char *bstr = istr(b);
-   if (!search_trie(&bstr, result, &result))
-      build_trie(bstr, result, &result);
+   if (sep != '\0')
+      *p++ = sep;
 
-   return result;
+   memcpy(p, b->bytes, b->length);
+
+   return ident_lookup(buf, len, true);
 }
 
 ident_t ident_strip(ident_t a, ident_t b)
@@ -345,36 +343,40 @@ ident_t ident_strip(ident_t a, ident_t b)
    assert(a != NULL);
    assert(b != NULL);
 
-   while (a->value == b->value && b->value != '\0') {
-      a = a->up;
-      b = b->up;
-   }
+   if (b->length > a->length)
+      return NULL;
 
-   return (b->value == '\0' ? a : NULL);
+   const size_t len = a->length - b->length;
+   if (memcmp(a->bytes + len, b->bytes, b->length) != 0)
+      return NULL;
+   else if (len == a->length)
+      return a;
+   else
+      return ident_lookup(a->bytes, len, true);
 }
 
 char ident_char(ident_t i, unsigned n)
 {
-   if (i == NULL)
+   if (i == NULL || n >= i->length)
       return '\0';
-   else if (n == 0)
-      return i->value;
    else
-      return ident_char(i->up, n - 1);
+      return i->bytes[i->length - n - 1];
 }
 
 ident_t ident_suffix_until(ident_t i, char c, ident_t shared)
 {
    assert(i != NULL);
 
-   ident_t r = i;
-   while (i->value != '\0' && i->up != shared) {
-      if (i->value == c)
-         r = i->up;
-      i = i->up;
+   // The character immediately following shared is assumed to be the
+   // separator and is not considered
+   const size_t start = (shared == NULL) ? 0 : shared->length + 1;
+
+   for (size_t pos = start; pos < i->length; pos++) {
+      if (i->bytes[pos] == c)
+         return ident_lookup(i->bytes, pos, true);
    }
 
-   return r;
+   return i;
 }
 
 ident_t ident_until(ident_t i, char c)
@@ -382,79 +384,66 @@ ident_t ident_until(ident_t i, char c)
    return ident_suffix_until(i, c, NULL);
 }
 
+static int ident_rindex(ident_t i, char c)
+{
+   for (int pos = i->length - 1; pos >= 0; pos--) {
+      if (i->bytes[pos] == c)
+         return pos;
+   }
+
+   return -1;
+}
+
 ident_t ident_runtil(ident_t i, char c)
 {
    assert(i != NULL);
 
-   while (i->value != '\0') {
-      if (i->value == c)
-         return i->up;
-      i = i->up;
-   }
-
-   return i;
+   const int pos = ident_rindex(i, c);
+   return ident_lookup(i->bytes, (pos < 0) ? 0 : pos, true);
 }
 
 ident_t ident_from(ident_t i, char c)
 {
    assert(i != NULL);
 
-   char buf[i->depth + 1];
-   char *p = buf + i->depth;
-   *p-- = '\0';
-
-   char *from = NULL;
-   while (i->value != '\0') {
-      if (i->value == c)
-         from = p + 1;
-      *p-- = i->value;
-      i = i->up;
-   }
+   const char *p = memchr(i->bytes, c, i->length);
+   if (p == NULL)
+      return NULL;
 
-   return (from == NULL) ? NULL : ident_new(from);
+   return ident_lookup(p + 1, i->length - (p - i->bytes) - 1, true);
 }
 
 ident_t ident_rfrom(ident_t i, char c)
 {
    assert(i != NULL);
 
-   char buf[i->depth + 1];
-   char *p = buf + i->depth;
-   *p-- = '\0';
+   const int pos = ident_rindex(i, c);
+   if (pos < 0)
+      return NULL;
 
-   while (i->value != '\0') {
-      if (i->value == c)
-         return ident_new(p + 1);
-      *p-- = i->value;
-      i = i->up;
-   }
-
-   return NULL;
+   return ident_lookup(i->bytes + pos + 1, i->length - pos - 1, true);
 }
 
 bool icmp(ident_t i, const char *s)
 {
    assert(i != NULL);
 
-   trie_t *result;
-   if (!search_trie(&s, &(root.trie), &result))
-      return false;
-   else
-      return result == i;
+   return strcmp(i->bytes, s) == 0;
 }
 
-static bool ident_glob_walk(const trie_t *i, const char *g,
-                            const char *const end)
+static bool ident_glob_walk(const char *s, const char *const send,
+                            const char *g, const char *const gend)
 {
-   if (i->value == '\0')
-      return (g < end);
-   else if (g < end)
+   // A wildcard matches one or more characters
+   if (s == send)
+      return (g == gend);
+   else if (g == gend)
       return false;
    else if (*g == '*')
-      return ident_glob_walk(i->up, g, end)
-         || ident_glob_walk(i->up, g - 1, end);
-   else if (i->value == *g)
-      return ident_glob_walk(i->up, g - 1, end);
+      return ident_glob_walk(s + 1, send, g, gend)
+         || ident_glob_walk(s + 1, send, g + 1, gend);
+   else if (*s == *g)
+      return ident_glob_walk(s + 1, send, g + 1, gend);
    else
       return false;
 }
@@ -466,7 +455,8 @@ bool ident_glob(ident_t i, const char *glob, int length)
    if (length < 0)
       length = strlen(glob);
 
-   return ident_glob_walk(i, glob + length - 1, glob);
+   return ident_glob_walk(i->bytes, i->bytes + i->length,
+                          glob, glob + length);
 }
 
 void ident_list_add(ident_list_t **list, ident_t i)
@@ -25,7 +25,8 @@
 typedef struct ident_wr_ctx *ident_wr_ctx_t;
 typedef struct ident_rd_ctx *ident_rd_ctx_t;
 
-// Intern a string as an identifier.
+// Intern a string as an identifier. This may be called from
+// multiple threads concurrently.
 ident_t ident_new(const char *str);
 
 // True if the given string was already interned.
@@ -69,8 +70,7 @@ bool icmp(ident_t i, const char *s);
 bool ident_glob(ident_t i, const char *glob, int length);
 
 // Convert an identifier reference to a NULL-terminated string.
-// This function is quite slow so its use should be avoided except
-// for printing.
+// The result is valid for the lifetime of the program.
 const char *istr(ident_t ident);
 
 ident_wr_ctx_t ident_write_begin(fbuf_t *f);
@@ -0,0 +1,1297 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "interp.h"
+#include "util.h"
+#include "common.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <math.h>
+
+#define MAX_DEPTH    256
+#define MAX_BRANCHES 1000000
+#define ARENA_SIZE   (1 << 20)
+
+typedef enum {
+   IK_INT,
+   IK_REAL,
+   IK_POINTER,
+   IK_UARRAY,
+   IK_OTHER
+} ikind_t;
+
+typedef enum {
+   CAST_INT,
+   CAST_INT_TO_REAL,
+   CAST_REAL_TO_INT,
+   CAST_COPY,
+   CAST_UARRAY
+} icast_t;
+
+typedef union {
+   int64_t  i;
+   double   r;
+   void    *p;
+} ireg_t;
+
+// Unconstrained arrays live in per-register storage so they can be
+// copied in and out of variables without allocating
+typedef struct {
+   int32_t left;
+   int32_t right;
+   int32_t dir;
+} idim_t;
+
+typedef struct {
+   void   *ptr;
+   idim_t  dims[];
+} iuarray_t;
+
+typedef struct interp interp_t;
+typedef struct ieval ieval_t;
+
+typedef struct {
+   vcode_op_t   kind;
+   vcode_reg_t  result;
+   int          nargs;
+   const int   *args;
+   const int   *targets;
+   int64_t      low;
+   int64_t      high;
+   size_t       size;
+   void        *ptr;
+   size_t       offset;
+   uint32_t     subkind;
+   vcode_cmp_t  cmp;
+   ikind_t      type;
+   uint8_t      bits;
+   bool         is_signed;
+} iop_t;
+
+struct interp {
+   ieval_t           *eval;
+   interp_t          *chain;
+   int                nregs;
+   ireg_t            *regs;
+   size_t             vsize;
+   size_t             usize;
+   uint8_t           *ustore;
+   int                nuregs;
+   int               *uregs;
+   int                nparams;
+   vcode_reg_t       *params;
+   size_t            *psizes;
+   int                nblocks;
+   int               *blocks;
+   iop_t             *ops;
+   int               *pool;
+   void             **consts;
+   int                nconsts;
+};
+
+// State shared by all the function units taking part in one
+// compile-time evaluation
+struct ieval {
+   jmp_buf              abort;
+   interp_resolve_fn_t  resolve;
+   void                *context;
+   hash_t              *units;
+   interp_t            *all;
+   uint8_t             *arena;
+   size_t               alloc;
+   int                  branches;
+   int                  depth;
+};
+
+static interp_t *interp_eval_unit(ieval_t *ev, ident_t name);
+static interp_t *interp_eval_new(ieval_t *ev, ident_t name, vcode_unit_t unit);
+static void interp_call(interp_t *in, const iop_t *op, const ireg_t *regs,
+                        ireg_t *result);
+
+static ikind_t interp_kind(vcode_type_t type)
+{
+   switch (vtype_kind(type)) {
+   case VCODE_TYPE_INT:
+   case VCODE_TYPE_OFFSET:
+      return IK_INT;
+   case VCODE_TYPE_REAL:
+      return IK_REAL;
+   case VCODE_TYPE_POINTER:
+   case VCODE_TYPE_ACCESS:
+   case VCODE_TYPE_SIGNAL:
+   case VCODE_TYPE_FILE:
+      return IK_POINTER;
+   case VCODE_TYPE_UARRAY:
+      return IK_UARRAY;
+   default:
+      return IK_OTHER;
+   }
+}
+
+static void interp_int_info(vcode_type_t type, uint8_t *bits, bool *is_signed)
+{
+   if (vtype_kind(type) == VCODE_TYPE_OFFSET) {
+      *bits      = 32;
+      *is_signed = true;
+   }
+   else {
+      *bits      = bits_for_range(vtype_low(type), vtype_high(type));
+      *is_signed = vtype_low(type) < 0;
+   }
+}
+
+static size_t interp_uarray_size(int ndims)
+{
+   return sizeof(iuarray_t) + ndims * sizeof(idim_t);
+}
+
+static size_t interp_size(vcode_type_t type)
+{
+   // Follows the layout chosen by cgen_type
+   switch (vtype_kind(type)) {
+   case VCODE_TYPE_INT:
+      {
+         const int bits = bits_for_range(vtype_low(type), vtype_high(type));
+         return bits <= 8 ? 1 : bits / 8;
+      }
+   case VCODE_TYPE_OFFSET:
+      return sizeof(int32_t);
+   case VCODE_TYPE_REAL:
+      return sizeof(double);
+   case VCODE_TYPE_POINTER:
+   case VCODE_TYPE_ACCESS:
+   case VCODE_TYPE_SIGNAL:
+   case VCODE_TYPE_FILE:
+      return sizeof(void *);
+   case VCODE_TYPE_CARRAY:
+      return vtype_size(type) * interp_size(vtype_elem(type));
+   case VCODE_TYPE_UARRAY:
+      return interp_uarray_size(vtype_dims(type));
+   case VCODE_TYPE_RECORD:
+      {
+         // Records are packed to match the LLVM structure type
+         size_t size = 0;
+         const int nfields = vtype_fields(type);
+         for (int i = 0; i < nfields; i++)
+            size += interp_size(vtype_field(type, i));
+         return size;
+      }
+   default:
+      fatal_trace("cannot get size of vcode type %d", vtype_kind(type));
+   }
+}
+
+static size_t interp_pointed_size(vcode_type_t type)
+{
+   if (vtype_kind(type) == VCODE_TYPE_SIGNAL)
+      return sizeof(netid_t);
+   else
+      return interp_size(vtype_pointed(type));
+}
+
+static inline int64_t interp_wrap(int64_t value, int bits, bool is_signed)
+{
+   if (bits >= 64)
+      return value;
+
+   const int shift = 64 - bits;
+   if (is_signed)
+      return (int64_t)((uint64_t)value << shift) >> shift;
+   else
+      return (int64_t)(((uint64_t)value << shift) >> shift);
+}
+
+static inline int64_t interp_load_int(const void *p, size_t size,
+                                      bool is_signed)
+{
+   switch (size) {
+   case 1:
+      return is_signed ? *(const int8_t *)p : *(const uint8_t *)p;
+   case 2:
+      {
+         uint16_t u;
+         memcpy(&u, p, sizeof(u));
+         return is_signed ? (int16_t)u : u;
+      }
+   case 4:
+      {
+         uint32_t u;
+         memcpy(&u, p, sizeof(u));
+         return is_signed ? (int32_t)u : u;
+      }
+   default:
+      {
+         int64_t i;
+         memcpy(&i, p, sizeof(i));
+         return i;
+      }
+   }
+}
+
+static inline void interp_store_int(void *p, size_t size, int64_t value)
+{
+   switch (size) {
+   case 1:
+      *(uint8_t *)p = value;
+      break;
+   case 2:
+      {
+         const uint16_t u = value;
+         memcpy(p, &u, sizeof(u));
+      }
+      break;
+   case 4:
+      {
+         const uint32_t u = value;
+         memcpy(p, &u, sizeof(u));
+      }
+      break;
+   default:
+      memcpy(p, &value, sizeof(value));
+      break;
+   }
+}
+
+static inline void interp_load(const iop_t *op, ireg_t *dst, const void *src)
+{
+   switch (op->type) {
+   case IK_INT:
+      dst->i = interp_load_int(src, op->size, op->is_signed);
+      break;
+   case IK_REAL:
+      memcpy(&(dst->r), src, sizeof(double));
+      break;
+   case IK_POINTER:
+      memcpy(&(dst->p), src, sizeof(void *));
+      break;
+   case IK_UARRAY:
+      memcpy(dst->p, src, op->size);
+      break;
+   default:
+      break;
+   }
+}
+
+static inline void interp_store(const iop_t *op, void *dst, const ireg_t *src)
+{
+   switch (op->type) {
+   case IK_INT:
+      interp_store_int(dst, op->size, src->i);
+      break;
+   case IK_REAL:
+      memcpy(dst, &(src->r), sizeof(double));
+      break;
+   case IK_POINTER:
+      memcpy(dst, &(src->p), sizeof(void *));
+      break;
+   case IK_UARRAY:
+      memcpy(dst, src->p, op->size);
+      break;
+   default:
+      break;
+   }
+}
+
+static void interp_abort(interp_t *in)
+{
+   // Give up on a compile-time evaluation, the caller falls back to
+   // leaving the expression unfolded
+   assert(in->eval != NULL);
+   longjmp(in->eval->abort, 1);
+}
+
+static void *interp_tmp_alloc(interp_t *in, size_t size)
+{
+   ieval_t *ev = in->eval;
+   if (ev->alloc + size > ARENA_SIZE)
+      interp_abort(in);
+
+   void *ptr = ev->arena + ev->alloc;
+   ev->alloc = (ev->alloc + size + 7) & ~7;
+   return ptr;
+}
+
+static bool interp_var_ptr(iop_t *iop, vcode_var_t var,
+                           const size_t *offsets)
+{
+   // Only local variables addressed relative to the frame are supported
+   if (vcode_var_context(var) != vcode_unit_depth())
+      return false;
+
+   iop->ptr    = NULL;
+   iop->offset = offsets[vcode_var_index(var)];
+   return true;
+}
+
+static bool interp_const_array(interp_t *in, iop_t *iop, int op,
+                               const bool *known)
+{
+   vcode_reg_t result = vcode_get_result(op);
+   vcode_type_t type  = vcode_reg_type(result);
+
+   if (vtype_kind(type) != VCODE_TYPE_POINTER)
+      return false;
+
+   vcode_type_t elem = vtype_pointed(type);
+   const ikind_t kind = interp_kind(elem);
+   if (kind != IK_INT && kind != IK_REAL)
+      return false;
+
+   const int length = vcode_count_args(op);
+   const size_t size = interp_size(elem);
+
+   uint8_t *data = xmalloc(MAX(length * size, 1));
+   for (int i = 0; i < length; i++) {
+      vcode_reg_t arg = vcode_get_arg(op, i);
+      if (!known[arg]) {
+         free(data);
+         return false;
+      }
+      else if (kind == IK_INT)
+         interp_store_int(data + i * size, size, in->regs[arg].i);
+      else
+         memcpy(data + i * size, &(in->regs[arg].r), sizeof(double));
+   }
+
+   in->consts = xrealloc(in->consts, (in->nconsts + 1) * sizeof(void *));
+   in->consts[in->nconsts++] = data;
+
+   in->regs[result].p = data;
+   iop->kind = VCODE_OP_COMMENT;
+   return true;
+}
+
+static bool interp_compile_op(interp_t *in, iop_t *iop, int op, int **pool,
+                              const size_t *offsets, bool *known)
+{
+   const vcode_op_t kind = vcode_get_op(op);
+
+   iop->kind   = kind;
+   iop->result = vcode_get_result(op);
+   iop->nargs  = vcode_count_args(op);
+   iop->args   = *pool;
+   iop->type   = IK_OTHER;
+
+   for (int i = 0; i < iop->nargs; i++)
+      *(*pool)++ = vcode_get_arg(op, i);
+
+   if (iop->result != VCODE_INVALID_REG) {
+      vcode_type_t rtype = vcode_reg_type(iop->result);
+      iop->type = interp_kind(rtype);
+      if (iop->type == IK_INT)
+         interp_int_info(rtype, &(iop->bits), &(iop->is_signed));
+   }
+
+   switch (kind) {
+   case VCODE_OP_COMMENT:
+   case VCODE_OP_RETURN:
+      return true;
+
+   case VCODE_OP_CONST:
+      // Constants are materialised once when the unit is translated
+      in->regs[iop->result].i = vcode_get_value(op);
+      known[iop->result] = true;
+      iop->kind = VCODE_OP_COMMENT;
+      return true;
+
+   case VCODE_OP_CONST_REAL:
+      in->regs[iop->result].r = vcode_get_real(op);
+      known[iop->result] = true;
+      iop->kind = VCODE_OP_COMMENT;
+      return true;
+
+   case VCODE_OP_CONST_ARRAY:
+      return interp_const_array(in, iop, op, known);
+
+   case VCODE_OP_NULL:
+      in->regs[iop->result].p = NULL;
+      iop->kind = VCODE_OP_COMMENT;
+      return true;
+
+   case VCODE_OP_ADD:
+   case VCODE_OP_SUB:
+   case VCODE_OP_MUL:
+   case VCODE_OP_DIV:
+   case VCODE_OP_NEG:
+   case VCODE_OP_ABS:
+   case VCODE_OP_EXP:
+      if (iop->type == IK_POINTER && kind == VCODE_OP_ADD) {
+         iop->size = interp_pointed_size(vcode_reg_type(iop->result));
+         return true;
+      }
+      return iop->type == IK_INT || iop->type == IK_REAL;
+
+   case VCODE_OP_MOD:
+   case VCODE_OP_REM:
+   case VCODE_OP_AND:
+   case VCODE_OP_OR:
+   case VCODE_OP_XOR:
+   case VCODE_OP_XNOR:
+   case VCODE_OP_NAND:
+   case VCODE_OP_NOR:
+   case VCODE_OP_NOT:
+      return iop->type == IK_INT;
+
+   case VCODE_OP_CMP:
+      {
+         iop->cmp  = vcode_get_cmp(op);
+         iop->type = interp_kind(vcode_reg_type(iop->args[0]));
+         return iop->type == IK_INT || iop->type == IK_REAL
+            || iop->type == IK_POINTER;
+      }
+
+   case VCODE_OP_SELECT:
+      if (iop->type == IK_UARRAY)
+         iop->size = interp_size(vcode_reg_type(iop->result));
+      return iop->type != IK_OTHER;
+
+   case VCODE_OP_CAST:
+      {
+         vcode_type_t atype = vcode_reg_type(iop->args[0]);
+         const ikind_t akind = interp_kind(atype);
+
+         if (vtype_kind(atype) == VCODE_TYPE_CARRAY)
+            iop->subkind = CAST_COPY;
+         else if (iop->type == IK_REAL && akind == IK_INT)
+            iop->subkind = CAST_INT_TO_REAL;
+         else if (iop->type == IK_INT && akind == IK_REAL)
+            iop->subkind = CAST_REAL_TO_INT;
+         else if (iop->type == IK_INT && akind == IK_INT)
+            iop->subkind = CAST_INT;
+         else if (iop->type == IK_UARRAY && akind == IK_UARRAY) {
+            iop->subkind = CAST_UARRAY;
+            iop->size = interp_size(vcode_reg_type(iop->result));
+         }
+         else if (iop->type == akind && akind != IK_OTHER)
+            iop->subkind = CAST_COPY;
+         else
+            return false;
+         return true;
+      }
+
+   case VCODE_OP_LOAD:
+   case VCODE_OP_STORE:
+   case VCODE_OP_INDEX:
+      {
+         vcode_var_t var = vcode_get_address(op);
+         if (!interp_var_ptr(iop, var, offsets))
+            return false;
+
+         if (kind == VCODE_OP_INDEX) {
+            iop->size = interp_pointed_size(vcode_reg_type(iop->result));
+            return true;
+         }
+
+         vcode_type_t vtype = vcode_var_type(var);
+         iop->type = interp_kind(vtype);
+         iop->size = interp_size(vtype);
+         if (iop->type == IK_INT)
+            interp_int_info(vtype, &(iop->bits), &(iop->is_signed));
+         return iop->type != IK_OTHER;
+      }
+
+   case VCODE_OP_LOAD_INDIRECT:
+      iop->size = interp_size(vcode_reg_type(iop->result));
+      return iop->type != IK_OTHER;
+
+   case VCODE_OP_STORE_INDIRECT:
+      {
+         vcode_type_t vtype = vcode_reg_type(iop->args[0]);
+         iop->type = interp_kind(vtype);
+         iop->size = interp_size(vtype);
+         return iop->type != IK_OTHER;
+      }
+
+   case VCODE_OP_COPY:
+   case VCODE_OP_MEMCMP:
+      if (kind == VCODE_OP_COPY)
+         iop->size = interp_size(vcode_get_type(op));
+      else
+         iop->size = interp_pointed_size(vcode_reg_type(iop->args[0]));
+      return true;
+
+   case VCODE_OP_MEMSET:
+      return true;
+
+   case VCODE_OP_RECORD_REF:
+      {
+         vcode_type_t rtype = vtype_pointed(vcode_reg_type(iop->args[0]));
+         const int field = vcode_get_field(op);
+         iop->size = 0;
+         for (int i = 0; i < field; i++)
+            iop->size += interp_size(vtype_field(rtype, i));
+         return true;
+      }
+
+   case VCODE_OP_ALLOCA:
+      iop->size = interp_size(vcode_get_type(op));
+      return true;
+
+   case VCODE_OP_JUMP:
+   case VCODE_OP_COND:
+   case VCODE_OP_CASE:
+      {
+         const int ntargets =
+            (kind == VCODE_OP_CASE) ? iop->nargs
+            : (kind == VCODE_OP_COND) ? 2 : 1;
+         iop->targets = *pool;
+         for (int i = 0; i < ntargets; i++)
+            *(*pool)++ = vcode_get_target(op, i);
+         return true;
+      }
+
+   case VCODE_OP_HEAP_SAVE:
+   case VCODE_OP_HEAP_RESTORE:
+   case VCODE_OP_UNWRAP:
+   case VCODE_OP_ASSERT:
+   case VCODE_OP_REPORT:
+      return true;
+
+   case VCODE_OP_BOUNDS:
+      {
+         vcode_type_t bounds = vcode_get_type(op);
+         if (vtype_kind(bounds) == VCODE_TYPE_REAL)
+            iop->kind = VCODE_OP_COMMENT;   // Not checked by cgen either
+         else {
+            iop->low  = vtype_low(bounds);
+            iop->high = vtype_high(bounds);
+         }
+      }
+      // Fall-through
+   case VCODE_OP_DYNAMIC_BOUNDS:
+      return true;
+
+   case VCODE_OP_INDEX_CHECK:
+      if (iop->nargs == 2) {
+         vcode_type_t bounds = vcode_get_type(op);
+         iop->low  = vtype_low(bounds);
+         iop->high = vtype_high(bounds);
+      }
+      return true;
+
+   case VCODE_OP_ARRAY_SIZE:
+      return true;
+
+   case VCODE_OP_WRAP:
+      iop->size = interp_size(vcode_reg_type(iop->result));
+      return true;
+
+   case VCODE_OP_UARRAY_LEFT:
+   case VCODE_OP_UARRAY_RIGHT:
+   case VCODE_OP_UARRAY_DIR:
+   case VCODE_OP_UARRAY_LEN:
+      iop->subkind = vcode_get_dim(op);
+      return true;
+
+   case VCODE_OP_FCALL:
+      {
+         // Only calls between functions being evaluated at compile
+         // time can be followed
+         if (iop->result == VCODE_INVALID_REG)
+            return false;
+         else if (iop->type == IK_UARRAY)
+            iop->size = interp_size(vcode_reg_type(iop->result));
+
+         vcode_state_t state;
+         vcode_state_save(&state);
+         iop->ptr = interp_eval_unit(in->eval, vcode_get_func(op));
+         vcode_state_restore(&state);
+
+         return iop->ptr != NULL;
+      }
+
+   default:
+      // Signals, waits, procedure calls, files, images, coverage and
+      // the rest cannot be evaluated at compile time
+      return false;
+   }
+}
+
+static bool interp_translate(interp_t *in, vcode_unit_t unit)
+{
+   vcode_select_unit(unit);
+
+   in->nregs = vcode_count_regs();
+   in->regs  = xmalloc(MAX(in->nregs, 1) * sizeof(ireg_t));
+   memset(in->regs, '\0', MAX(in->nregs, 1) * sizeof(ireg_t));
+
+   const int nvars = vcode_count_vars();
+   size_t *offsets LOCAL = xmalloc(MAX(nvars, 1) * sizeof(size_t));
+   for (int i = 0; i < nvars; i++) {
+      vcode_type_t vtype = vcode_var_type(vcode_var_handle(i));
+      in->vsize = (in->vsize + 7) & ~7;
+      offsets[i] = in->vsize;
+      in->vsize += interp_size(vtype);
+   }
+
+   in->uregs = xmalloc(MAX(in->nregs, 1) * sizeof(int));
+   for (int i = 0; i < in->nregs; i++) {
+      vcode_type_t rtype = vcode_reg_type(i);
+      if (vtype_kind(rtype) == VCODE_TYPE_UARRAY) {
+         in->uregs[in->nuregs++] = i;
+         in->usize += (interp_size(rtype) + 7) & ~7;
+      }
+   }
+
+   in->ustore = xmalloc(MAX(in->usize, 1));
+   uint8_t *up = in->ustore;
+   for (int i = 0; i < in->nuregs; i++) {
+      in->regs[in->uregs[i]].p = up;
+      up += (interp_size(vcode_reg_type(in->uregs[i])) + 7) & ~7;
+   }
+
+   if (vcode_unit_kind() == VCODE_UNIT_FUNCTION) {
+      in->nparams = vcode_count_params();
+      in->params  = xmalloc(MAX(in->nparams, 1) * sizeof(vcode_reg_t));
+      in->psizes  = xmalloc(MAX(in->nparams, 1) * sizeof(size_t));
+      for (int i = 0; i < in->nparams; i++) {
+         vcode_type_t ptype = vcode_param_type(i);
+         in->params[i] = vcode_param_reg(i);
+         in->psizes[i] = interp_kind(ptype) == IK_UARRAY
+            ? interp_size(ptype) : 0;
+      }
+   }
+
+   in->nblocks = vcode_count_blocks();
+   in->blocks  = xmalloc(in->nblocks * sizeof(int));
+
+   int nops = 0, nslots = 0;
+   for (int i = 0; i < in->nblocks; i++) {
+      vcode_select_block(i);
+      const int bops = vcode_count_ops();
+      for (int j = 0; j < bops; j++) {
+         nslots += vcode_count_args(j);
+         const vcode_op_t kind = vcode_get_op(j);
+         if (kind == VCODE_OP_CASE)
+            nslots += vcode_count_args(j);
+         else if (kind == VCODE_OP_COND)
+            nslots += 2;
+         else if (kind == VCODE_OP_JUMP)
+            nslots += 1;
+      }
+      nops += bops;
+   }
+
+   in->ops  = xmalloc(MAX(nops, 1) * sizeof(iop_t));
+   in->pool = xmalloc(MAX(nslots, 1) * sizeof(int));
+   memset(in->ops, '\0', MAX(nops, 1) * sizeof(iop_t));
+
+   // Constant arrays can only be built once their elements are known
+   // so translate all the scalar constants first
+   bool *known LOCAL = xmalloc(MAX(in->nregs, 1) * sizeof(bool));
+   memset(known, '\0', MAX(in->nregs, 1) * sizeof(bool));
+
+   for (int i = 0; i < in->nblocks; i++) {
+      vcode_select_block(i);
+      const int bops = vcode_count_ops();
+      for (int j = 0; j < bops; j++) {
+         const vcode_op_t kind = vcode_get_op(j);
+         if (kind == VCODE_OP_CONST)
+            in->regs[vcode_get_result(j)].i = vcode_get_value(j);
+         else if (kind == VCODE_OP_CONST_REAL)
+            in->regs[vcode_get_result(j)].r = vcode_get_real(j);
+         else
+            continue;
+
+         known[vcode_get_result(j)] = true;
+      }
+   }
+
+   int *pool = in->pool, n = 0;
+   for (int i = 0; i < in->nblocks; i++) {
+      vcode_select_block(i);
+      in->blocks[i] = n;
+
+      const int bops = vcode_count_ops();
+      for (int j = 0; j < bops; j++, n++) {
+         if (!interp_compile_op(in, &(in->ops[n]), j, &pool, offsets, known))
+            return false;
+      }
+   }
+
+   assert(pool <= in->pool + MAX(nslots, 1));
+   return true;
+}
+
+static void interp_free(interp_t *in)
+{
+   for (int i = 0; i < in->nconsts; i++)
+      free(in->consts[i]);
+
+   free(in->consts);
+   free(in->regs);
+   free(in->ustore);
+   free(in->uregs);
+   free(in->params);
+   free(in->psizes);
+   free(in->blocks);
+   free(in->ops);
+   free(in->pool);
+   free(in);
+}
+
+static interp_t *interp_eval_unit(ieval_t *ev, ident_t name)
+{
+   interp_t *in = hash_get(ev->units, name);
+   if (in != NULL)
+      return in;
+
+   vcode_unit_t unit = (*ev->resolve)(name, ev->context);
+   if (unit == NULL)
+      return NULL;
+
+   return interp_eval_new(ev, name, unit);
+}
+
+static interp_t *interp_eval_new(ieval_t *ev, ident_t name, vcode_unit_t unit)
+{
+   vcode_select_unit(unit);
+   if (vcode_unit_kind() != VCODE_UNIT_FUNCTION)
+      return NULL;
+
+   interp_t *in = xcalloc(sizeof(interp_t));
+   in->eval  = ev;
+   in->chain = ev->all;
+   ev->all   = in;
+
+   // Entered before translating the body so recursive calls resolve
+   // to the same unit
+   hash_put(ev->units, name, in);
+
+   return interp_translate(in, unit) ? in : NULL;
+}
+
+static inline bool interp_cmp(vcode_cmp_t cmp, int c)
+{
+   switch (cmp) {
+   case VCODE_CMP_EQ:  return c == 0;
+   case VCODE_CMP_NEQ: return c != 0;
+   case VCODE_CMP_LT:  return c < 0;
+   case VCODE_CMP_GT:  return c > 0;
+   case VCODE_CMP_LEQ: return c <= 0;
+   case VCODE_CMP_GEQ: return c >= 0;
+   default:            return false;
+   }
+}
+
+static inline int32_t interp_uarray_len(const idim_t *d)
+{
+   const int32_t diff = d->dir ? d->left - d->right : d->right - d->left;
+   return MAX(diff + 1, 0);
+}
+
+static void interp_exec(interp_t *in, ireg_t *regs, uint8_t *vars, int pc,
+                        ireg_t *result)
+{
+#define R(n)   (regs[op->args[(n)]])
+#define OUT    (regs[op->result])
+#define WRAP(x) interp_wrap((x), op->bits, op->is_signed)
+#define VAR    (op->ptr != NULL ? op->ptr : vars + op->offset)
+#define BRANCH() do {                                                 \
+      if (++(in->eval->branches) > MAX_BRANCHES)                      \
+         interp_abort(in);                                            \
+   } while (0)
+
+   for (;;) {
+      const iop_t *op = &(in->ops[pc++]);
+      switch (op->kind) {
+      case VCODE_OP_COMMENT:
+         break;
+
+      case VCODE_OP_RETURN:
+         if (op->nargs > 0)
+            *result = R(0);
+         return;
+
+      case VCODE_OP_JUMP:
+         BRANCH();
+         pc = in->blocks[op->targets[0]];
+         break;
+
+      case VCODE_OP_COND:
+         BRANCH();
+         pc = in->blocks[op->targets[R(0).i ? 0 : 1]];
+         break;
+
+      case VCODE_OP_CASE:
+         {
+            BRANCH();
+            int target = op->targets[0];
+            for (int i = 1; i < op->nargs; i++) {
+               if (R(i).i == R(0).i) {
+                  target = op->targets[i];
+                  break;
+               }
+            }
+            pc = in->blocks[target];
+         }
+         break;
+
+      case VCODE_OP_ADD:
+         if (op->type == IK_POINTER)
+            OUT.p = (uint8_t *)R(0).p + R(1).i * op->size;
+         else if (op->type == IK_REAL)
+            OUT.r = R(0).r + R(1).r;
+         else
+            OUT.i = WRAP(R(0).i + R(1).i);
+         break;
+
+      case VCODE_OP_SUB:
+         if (op->type == IK_REAL)
+            OUT.r = R(0).r - R(1).r;
+         else
+            OUT.i = WRAP(R(0).i - R(1).i);
+         break;
+
+      case VCODE_OP_MUL:
+         if (op->type == IK_REAL)
+            OUT.r = R(0).r * R(1).r;
+         else
+            OUT.i = WRAP(R(0).i * R(1).i);
+         break;
+
+      case VCODE_OP_DIV:
+         if (op->type == IK_REAL)
+            OUT.r = R(0).r / R(1).r;
+         else if (unlikely(R(1).i == 0))
+            interp_abort(in);
+         else
+            OUT.i = WRAP(R(0).i / R(1).i);
+         break;
+
+      case VCODE_OP_MOD:
+      case VCODE_OP_REM:
+         if (unlikely(R(1).i == 0))
+            interp_abort(in);
+         else if (op->kind == VCODE_OP_REM)
+            OUT.i = WRAP(R(0).i % R(1).i);
+         else {
+            // Unsigned remainder at the register width as cgen_op_mod
+            const uint64_t l = interp_wrap(R(0).i, op->bits, false);
+            const uint64_t r = interp_wrap(R(1).i, op->bits, false);
+            OUT.i = WRAP(l % r);
+         }
+         break;
+
+      case VCODE_OP_EXP:
+         if (op->type == IK_REAL)
+            OUT.r = pow(R(0).r, R(1).r);
+         else
+            OUT.i = WRAP(ipow(R(0).i, R(1).i));
+         break;
+
+      case VCODE_OP_NEG:
+         if (op->type == IK_REAL)
+            OUT.r = -R(0).r;
+         else
+            OUT.i = WRAP(-R(0).i);
+         break;
+
+      case VCODE_OP_ABS:
+         if (op->type == IK_REAL)
+            OUT.r = fabs(R(0).r);
+         else
+            OUT.i = WRAP(R(0).i < 0 ? -R(0).i : R(0).i);
+         break;
+
+      case VCODE_OP_NOT:
+         OUT.i = WRAP(~R(0).i);
+         break;
+
+      case VCODE_OP_AND:
+         OUT.i = R(0).i & R(1).i;
+         break;
+
+      case VCODE_OP_OR:
+         OUT.i = R(0).i | R(1).i;
+         break;
+
+      case VCODE_OP_XOR:
+         OUT.i = R(0).i ^ R(1).i;
+         break;
+
+      case VCODE_OP_XNOR:
+         OUT.i = WRAP(~(R(0).i ^ R(1).i));
+         break;
+
+      case VCODE_OP_NAND:
+         OUT.i = WRAP(~(R(0).i & R(1).i));
+         break;
+
+      case VCODE_OP_NOR:
+         OUT.i = WRAP(~(R(0).i | R(1).i));
+         break;
+
+      case VCODE_OP_CMP:
+         {
+            int c;
+            if (op->type == IK_REAL)
+               c = (R(0).r > R(1).r) - (R(0).r < R(1).r);
+            else if (op->type == IK_POINTER)
+               c = (R(0).p > R(1).p) - (R(0).p < R(1).p);
+            else
+               c = (R(0).i > R(1).i) - (R(0).i < R(1).i);
+            OUT.i = interp_cmp(op->cmp, c);
+         }
+         break;
+
+      case VCODE_OP_SELECT:
+         if (op->type == IK_UARRAY)
+            memcpy(OUT.p, R(0).i ? R(1).p : R(2).p, op->size);
+         else
+            OUT = R(0).i ? R(1) : R(2);
+         break;
+
+      case VCODE_OP_CAST:
+         switch (op->subkind) {
+         case CAST_INT:
+            OUT.i = WRAP(R(0).i);
+            break;
+         case CAST_INT_TO_REAL:
+            OUT.r = R(0).i;
+            break;
+         case CAST_REAL_TO_INT:
+            OUT.i = WRAP((int64_t)R(0).r);
+            break;
+         case CAST_UARRAY:
+            memcpy(OUT.p, R(0).p, op->size);
+            break;
+         default:
+            OUT = R(0);
+            break;
+         }
+         break;
+
+      case VCODE_OP_LOAD:
+         interp_load(op, &OUT, VAR);
+         break;
+
+      case VCODE_OP_STORE:
+         interp_store(op, VAR, &R(0));
+         break;
+
+      case VCODE_OP_INDEX:
+         OUT.p = (uint8_t *)VAR + (op->nargs > 0 ? R(0).i * op->size : 0);
+         break;
+
+      case VCODE_OP_LOAD_INDIRECT:
+         interp_load(op, &OUT, R(0).p);
+         break;
+
+      case VCODE_OP_STORE_INDIRECT:
+         interp_store(op, R(1).p, &R(0));
+         break;
+
+      case VCODE_OP_COPY:
+         memmove(R(0).p, R(1).p, (op->nargs > 2 ? R(2).i : 1) * op->size);
+         break;
+
+      case VCODE_OP_MEMSET:
+         memset(R(0).p, R(1).i, R(2).i);
+         break;
+
+      case VCODE_OP_MEMCMP:
+         OUT.i = memcmp(R(0).p, R(1).p, R(2).i * op->size) == 0;
+         break;
+
+      case VCODE_OP_RECORD_REF:
+         OUT.p = (uint8_t *)R(0).p + op->size;
+         break;
+
+      case VCODE_OP_ALLOCA:
+         OUT.p = interp_tmp_alloc(in, (op->nargs > 0 ? R(0).i : 1) * op->size);
+         break;
+
+      case VCODE_OP_HEAP_SAVE:
+         OUT.i = in->eval->alloc;
+         break;
+
+      case VCODE_OP_HEAP_RESTORE:
+         in->eval->alloc = R(0).i;
+         break;
+
+      case VCODE_OP_FCALL:
+         interp_call(op->ptr, op, regs, &OUT);
+         break;
+
+      case VCODE_OP_ASSERT:
+         // Leave the call unfolded so the failure is reported at run time
+         if (!R(0).i)
+            interp_abort(in);
+         break;
+
+      case VCODE_OP_REPORT:
+         interp_abort(in);
+         break;
+
+      case VCODE_OP_BOUNDS:
+         if (unlikely(R(0).i < op->low || R(0).i > op->high))
+            interp_abort(in);
+         break;
+
+      case VCODE_OP_DYNAMIC_BOUNDS:
+         if (unlikely(R(0).i < R(1).i || R(0).i > R(2).i))
+            interp_abort(in);
+         break;
+
+      case VCODE_OP_INDEX_CHECK:
+         {
+            const int64_t min = op->nargs == 2 ? op->low : R(2).i;
+            const int64_t max = op->nargs == 2 ? op->high : R(3).i;
+
+            if (R(1).i < R(0).i)
+               break;   // Null range
+
+            for (int i = 0; i < 2; i++) {
+               if (unlikely(R(i).i < min || R(i).i > max))
+                  interp_abort(in);
+            }
+         }
+         break;
+
+      case VCODE_OP_ARRAY_SIZE:
+         if (unlikely(R(0).i != R(1).i))
+            interp_abort(in);
+         break;
+
+      case VCODE_OP_WRAP:
+         {
+            iuarray_t *u = OUT.p;
+            u->ptr = R(0).p;
+
+            const int ndims = op->nargs / 3;
+            for (int i = 0; i < ndims; i++) {
+               u->dims[i].left  = R(i * 3 + 1).i;
+               u->dims[i].right = R(i * 3 + 2).i;
+               u->dims[i].dir   = R(i * 3 + 3).i;
+            }
+         }
+         break;
+
+      case VCODE_OP_UNWRAP:
+         OUT.p = ((iuarray_t *)R(0).p)->ptr;
+         break;
+
+      case VCODE_OP_UARRAY_LEFT:
+         OUT.i = ((iuarray_t *)R(0).p)->dims[op->subkind].left;
+         break;
+
+      case VCODE_OP_UARRAY_RIGHT:
+         OUT.i = ((iuarray_t *)R(0).p)->dims[op->subkind].right;
+         break;
+
+      case VCODE_OP_UARRAY_DIR:
+         OUT.i = ((iuarray_t *)R(0).p)->dims[op->subkind].dir;
+         break;
+
+      case VCODE_OP_UARRAY_LEN:
+         OUT.i = interp_uarray_len(&((iuarray_t *)R(0).p)->dims[op->subkind]);
+         break;
+
+      default:
+         fatal_trace("cannot interpret vcode op %s", vcode_op_string(op->kind));
+      }
+   }
+
+#undef R
+#undef OUT
+#undef WRAP
+#undef VAR
+#undef BRANCH
+}
+
+static ireg_t *interp_frame(interp_t *in, uint8_t **vars)
+{
+   // Function frames are allocated from the evaluation arena so an
+   // abandoned evaluation does not need to unwind them
+   const size_t rsize = MAX(in->nregs, 1) * sizeof(ireg_t);
+   ireg_t *regs = interp_tmp_alloc(in, rsize);
+   memcpy(regs, in->regs, rsize);
+
+   uint8_t *ustore = interp_tmp_alloc(in, in->usize);
+   for (int i = 0; i < in->nuregs; i++) {
+      const int r = in->uregs[i];
+      regs[r].p = ustore + ((uint8_t *)in->regs[r].p - in->ustore);
+   }
+
+   *vars = interp_tmp_alloc(in, in->vsize);
+   memset(*vars, '\0', in->vsize);
+
+   return regs;
+}
+
+static void interp_call(interp_t *in, const iop_t *op, const ireg_t *regs,
+                        ireg_t *result)
+{
+   ieval_t *ev = in->eval;
+   if (++(ev->depth) > MAX_DEPTH)
+      interp_abort(in);
+
+   const size_t mark = ev->alloc;
+
+   uint8_t *vars;
+   ireg_t *frame = interp_frame(in, &vars);
+
+   for (int i = 0; i < in->nparams; i++) {
+      const vcode_reg_t param = in->params[i];
+      if (in->psizes[i] > 0)
+         memcpy(frame[param].p, regs[op->args[i]].p, in->psizes[i]);
+      else
+         frame[param] = regs[op->args[i]];
+   }
+
+   ireg_t value = { .i = 0 };
+   interp_exec(in, frame, vars, in->blocks[0], &value);
+
+   if (op->type == IK_UARRAY)
+      memcpy(result->p, value.p, op->size);
+   else
+      *result = value;
+
+   // Scalar results cannot refer to anything the callee allocated
+   if (op->type == IK_INT || op->type == IK_REAL)
+      ev->alloc = mark;
+
+   ev->depth--;
+}
+
+static bool interp_eval_body(interp_t *in, const interp_scalar_t *args,
+                             const bool *is_real, ikind_t rkind, size_t rsize,
+                             bool rsigned, interp_scalar_t *result,
+                             int length)
+{
+   if (setjmp(in->eval->abort) != 0)
+      return false;
+
+   uint8_t *vars;
+   ireg_t *frame = interp_frame(in, &vars);
+
+   for (int i = 0; i < in->nparams; i++) {
+      if (is_real[i])
+         frame[in->params[i]].r = args[i].real;
+      else
+         frame[in->params[i]].i = args[i].integer;
+   }
+
+   ireg_t value = { .i = 0 };
+   interp_exec(in, frame, vars, in->blocks[0], &value);
+
+   if (length < 0) {
+      if (rkind == IK_REAL)
+         result->real = value.r;
+      else
+         result->integer = value.i;
+   }
+   else {
+      // The elements are in the arena which is still allocated
+      const uint8_t *p = value.p;
+      for (int i = 0; i < length; i++, p += rsize) {
+         if (rkind == IK_REAL)
+            memcpy(&(result[i].real), p, sizeof(double));
+         else
+            result[i].integer = interp_load_int(p, rsize, rsigned);
+      }
+   }
+
+   return true;
+}
+
+static bool interp_eval_result(vcode_unit_t unit,
+                               interp_resolve_fn_t resolve, void *context,
+                               const interp_scalar_t *args, int nargs,
+                               interp_scalar_t *result, int length)
+{
+   vcode_select_unit(unit);
+
+   if (vcode_unit_kind() != VCODE_UNIT_FUNCTION)
+      return false;
+
+   vcode_type_t rtype = vcode_unit_result();
+   if (length >= 0) {
+      // Constrained arrays are returned as a pointer to the elements
+      if (vtype_kind(rtype) != VCODE_TYPE_POINTER)
+         return false;
+      rtype = vtype_pointed(rtype);
+   }
+
+   const ikind_t rkind = interp_kind(rtype);
+   if (rkind != IK_INT && rkind != IK_REAL)
+      return false;
+
+   uint8_t rbits = 64;
+   bool rsigned = true;
+   if (rkind == IK_INT)
+      interp_int_info(rtype, &rbits, &rsigned);
+
+   const size_t rsize = interp_size(rtype);
+
+   if (vcode_count_params() != nargs)
+      return false;
+
+   bool is_real[MAX(nargs, 1)];
+   for (int i = 0; i < nargs; i++) {
+      const ikind_t pkind = interp_kind(vcode_param_type(i));
+      if (pkind != IK_INT && pkind != IK_REAL)
+         return false;
+      is_real[i] = (pkind == IK_REAL);
+   }
+
+   ieval_t ev = {
+      .resolve = resolve,
+      .context = context,
+      .units   = hash_new(16, true)
+   };
+
+   bool ok = false;
+   interp_t *in = interp_eval_new(&ev, vcode_unit_name(), unit);
+   if (in != NULL) {
+      ev.arena = xmalloc(ARENA_SIZE);
+      ok = interp_eval_body(in, args, is_real, rkind, rsize, rsigned,
+                            result, length);
+      free(ev.arena);
+   }
+
+   while (ev.all != NULL) {
+      interp_t *next = ev.all->chain;
+      interp_free(ev.all);
+      ev.all = next;
+   }
+
+   hash_free(ev.units);
+   vcode_close();
+   return ok;
+}
+
+bool interp_eval(vcode_unit_t unit, interp_resolve_fn_t resolve,
+                 void *context, const interp_scalar_t *args, int nargs,
+                 interp_scalar_t *result)
+{
+   return interp_eval_result(unit, resolve, context, args, nargs,
+                             result, -1);
+}
+
+bool interp_eval_array(vcode_unit_t unit, interp_resolve_fn_t resolve,
+                       void *context, const interp_scalar_t *args, int nargs,
+                       interp_scalar_t *elems, int length)
+{
+   return interp_eval_result(unit, resolve, context, args, nargs,
+                             elems, length);
+}
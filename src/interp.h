@@ -0,0 +1,45 @@
+//
+//  Copyright (C) 2015  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _INTERP_H
+#define _INTERP_H
+
+#include "vcode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef union {
+   int64_t integer;
+   double  real;
+} interp_scalar_t;
+
+// Returns the function unit with the given mangled name or NULL
+typedef vcode_unit_t (*interp_resolve_fn_t)(ident_t name, void *context);
+
+bool interp_eval(vcode_unit_t unit, interp_resolve_fn_t resolve,
+                 void *context, const interp_scalar_t *args, int nargs,
+                 interp_scalar_t *result);
+
+// Evaluate a function returning a constrained array of scalars with the
+// given number of elements
+bool interp_eval_array(vcode_unit_t unit, interp_resolve_fn_t resolve,
+                       void *context, const interp_scalar_t *args, int nargs,
+                       interp_scalar_t *elems, int length);
+
+#endif  // _INTERP_H
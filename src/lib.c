@@ -21,6 +21,8 @@
 #include "lib.h"
 #include "tree.h"
 #include "common.h"
+#include "hash.h"
+#include "fbuf.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -54,6 +56,9 @@ struct lib_unit {
 struct lib_index {
    ident_t      name;
    tree_kind_t  kind;
+   lib_mtime_t  mtime;   // Zero if not known
+   uint64_t     size;
+   bool         pending; // Not yet recorded in the journal
    lib_index_t *next;
 };
 
@@ -63,8 +68,11 @@ struct lib {
    unsigned     n_units;
    unsigned     units_alloc;
    lib_unit_t  *units;
+   hash_t      *lookup;       // Unit name to position in units plus one
    lib_index_t *index;
+   hash_t      *index_hash;   // Unit name to index entry
    int          lock_fd;
+   tree_arena_t arena;        // Units read from disk
 };
 
 struct lib_list {
@@ -80,6 +88,17 @@ struct search_path {
 static lib_t          work = NULL;
 static lib_list_t    *loaded = NULL;
 static search_path_t *search_paths = NULL;
+static hash_t        *source_mtimes = NULL;
+
+// Index files written before the file times were recorded start
+// directly with the number of entries
+#define INDEX_MAGIC 0x58444e49   // "INDX"
+
+// Each save appends the entries it changed to the journal which is
+// merged with the index when the library is opened and folded back
+// into the index once it grows past this size
+#define JOURNAL_MAGIC 0x4c4e524a   // "JRNL"
+#define JOURNAL_MAX   (64 * 1024)
 
 static const char *lib_file_path(lib_t lib, const char *name);
 
@@ -122,16 +141,127 @@ static void lib_unlock(lib_t lib)
       fatal_errno("flock");
 }
 
-static void lib_read_lock(lib_t lib)
+static void lib_index_update(lib_t lib, ident_t name, tree_kind_t kind,
+                             lib_mtime_t mtime, uint64_t size)
 {
-   if (flock(lib->lock_fd, LOCK_SH) < 0)
-      fatal_errno("flock");
+   lib_index_t *in = hash_get(lib->index_hash, name);
+   if (in == NULL) {
+      in = xmalloc(sizeof(lib_index_t));
+      in->name    = name;
+      in->pending = false;
+      in->next    = lib->index;
+
+      lib->index = in;
+      hash_put(lib->index_hash, name, in);
+   }
+
+   in->kind  = kind;
+   in->mtime = mtime;
+   in->size  = size;
 }
 
-static void lib_write_lock(lib_t lib)
+static void lib_journal_put(uint8_t **p, uint64_t value, int nbytes)
 {
-   if (flock(lib->lock_fd, LOCK_EX) < 0)
-      fatal_errno("flock");
+   for (int i = nbytes - 1; i >= 0; i--)
+      *(*p)++ = (value >> (i * 8)) & 0xff;
+}
+
+static uint64_t lib_journal_get(const uint8_t **p, int nbytes)
+{
+   uint64_t value = 0;
+   for (int i = 0; i < nbytes; i++)
+      value = (value << 8) | *(*p)++;
+   return value;
+}
+
+static uint8_t *lib_journal_read(lib_t lib, size_t *len)
+{
+   int fd = open(lib_file_path(lib, "_index.log"), O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("fstat");
+
+   uint8_t *buf = xmalloc(MAX(st.st_size, 1));
+   const ssize_t nread = read(fd, buf, st.st_size);
+   if (nread < 0)
+      fatal_errno("read: %s", lib_file_path(lib, "_index.log"));
+
+   close(fd);
+
+   *len = nread;
+   return buf;
+}
+
+static void lib_journal_apply(lib_t lib, const uint8_t *buf, size_t len)
+{
+   // Records are appended with a single write so anything short at the
+   // end is another process still appending and can be ignored
+   const uint8_t *p = buf, *end = buf + len;
+   while (end - p >= 8) {
+      if (lib_journal_get(&p, 4) != JOURNAL_MAGIC)
+         fatal("library %s corrupt: invalid index journal",
+               istr(lib->name));
+
+      const size_t reclen = lib_journal_get(&p, 4);
+      if (end - p < reclen)
+         break;
+
+      const uint8_t *recend = p + reclen;
+      while (p < recend) {
+         const size_t namelen = lib_journal_get(&p, 2);
+         ident_t name = ident_new((const char *)p);
+         p += namelen;
+
+         const tree_kind_t kind = lib_journal_get(&p, 2);
+         assert(kind < T_LAST_TREE_KIND);
+
+         const lib_mtime_t mtime = lib_journal_get(&p, 8);
+         const uint64_t size = lib_journal_get(&p, 8);
+
+         lib_index_update(lib, name, kind, mtime, size);
+      }
+   }
+}
+
+static void lib_read_index(lib_t lib)
+{
+   // The journal must be read before the index: it is only truncated
+   // after a new index containing all its entries has been renamed
+   // into place so no entries can be missed without taking a lock
+   size_t jlen = 0;
+   uint8_t *journal = lib_journal_read(lib, &jlen);
+
+   fbuf_t *f = lib_fbuf_open(lib, "_index", FBUF_IN);
+   if (f != NULL) {
+      ident_rd_ctx_t ictx = ident_read_begin(f);
+
+      uint32_t entries = read_u32(f);
+      const bool have_times = (entries == INDEX_MAGIC);
+      if (have_times)
+         entries = read_u32(f);
+
+      for (int i = 0; i < entries; i++) {
+         ident_t name = ident_read(ictx);
+         tree_kind_t kind = read_u16(f);
+         assert(kind < T_LAST_TREE_KIND);
+
+         const lib_mtime_t mtime = have_times ? read_u64(f) : 0;
+         const uint64_t size = have_times ? read_u64(f) : 0;
+
+         lib_index_update(lib, name, kind, mtime, size);
+      }
+
+      ident_read_end(ictx);
+      fbuf_close(f);
+   }
+
+   if (journal != NULL) {
+      lib_journal_apply(lib, journal, jlen);
+      free(journal);
+   }
 }
 
 static lib_t lib_init(const char *name, const char *rpath, int lock_fd)
@@ -142,6 +272,10 @@ static lib_t lib_init(const char *name, const char *rpath, int lock_fd)
    l->name    = upcase_name(name);
    l->index   = NULL;
    l->lock_fd = lock_fd;
+   l->arena   = NULL;
+
+   l->lookup     = hash_new(256, true);
+   l->index_hash = hash_new(256, true);
 
    if (realpath(rpath, l->path) == NULL)
       strncpy(l->path, rpath, PATH_MAX);
@@ -155,45 +289,25 @@ static lib_t lib_init(const char *name, const char *rpath, int lock_fd)
       const char *lock_path = lib_file_path(l, "_NVC_LIB");
       if ((l->lock_fd = open(lock_path, O_RDONLY)) < 0)
          fatal_errno("lib_init: %s", lock_path);
-
-      lib_read_lock(l);
    }
+   else if (*(l->path) != '\0')
+      lib_unlock(l);   // Held since creating the library
 
-   fbuf_t *f = lib_fbuf_open(l, "_index", FBUF_IN);
-   if (f != NULL) {
-      ident_rd_ctx_t ictx = ident_read_begin(f);
-
-      const int entries = read_u32(f);
-      for (int i = 0; i < entries; i++) {
-         ident_t name = ident_read(ictx);
-         tree_kind_t kind = read_u16(f);
-         assert(kind < T_LAST_TREE_KIND);
-
-         lib_index_t *in = xmalloc(sizeof(lib_index_t));
-         in->name = name;
-         in->kind = kind;
-         in->next = l->index;
+   if (*(l->path) != '\0')
+      lib_read_index(l);
 
-         l->index = in;
-      }
-
-      ident_read_end(ictx);
-      fbuf_close(f);
-   }
-
-   lib_unlock(l);
    return l;
 }
 
 static lib_index_t *lib_find_in_index(lib_t lib, ident_t name)
 {
-   lib_index_t *it;
-   for (it = lib->index;
-        (it != NULL) && (it->name != name);
-        it = it->next)
-      ;
+   return hash_get(lib->index_hash, name);
+}
 
-   return it;
+static lib_unit_t *lib_find_loaded(lib_t lib, ident_t name)
+{
+   const uintptr_t pos = (uintptr_t)hash_get(lib->lookup, name);
+   return (pos == 0) ? NULL : &(lib->units[pos - 1]);
 }
 
 static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
@@ -203,13 +317,8 @@ static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
    assert(lib != NULL);
    assert(unit != NULL);
 
-   lib_unit_t *where = NULL;
    ident_t name = tree_ident(unit);
-
-   for (unsigned i = 0; (where == NULL) && (i < lib->n_units); i++) {
-      if (tree_ident(lib->units[i].top) == tree_ident(unit))
-         where = &(lib->units[i]);
-   }
+   lib_unit_t *where = lib_find_loaded(lib, name);
 
    if (where == NULL) {
       if (lib->n_units == 0) {
@@ -223,6 +332,7 @@ static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
       }
 
       where = &(lib->units[lib->n_units++]);
+      hash_put(lib->lookup, name, (void *)(uintptr_t)lib->n_units);
    }
 
    where->top      = unit;
@@ -232,14 +342,8 @@ static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
    where->kind     = tree_kind(unit);
 
    lib_index_t *it = lib_find_in_index(lib, name);
-   if (it == NULL) {
-      lib_index_t *new = xmalloc(sizeof(lib_index_t));
-      new->name = name;
-      new->kind = tree_kind(unit);
-      new->next = lib->index;
-
-      lib->index = new;
-   }
+   if (it == NULL)
+      lib_index_update(lib, name, tree_kind(unit), 0, 0);
    else
       it->kind = tree_kind(unit);
 
@@ -281,7 +385,8 @@ static lib_t lib_find_at(const char *name, const char *path, bool exact)
 static const char *lib_file_path(lib_t lib, const char *name)
 {
    static char buf[PATH_MAX];
-   snprintf(buf, sizeof(buf), "%s/%s", lib->path, name);
+   if (snprintf(buf, sizeof(buf), "%s/%s", lib->path, name) >= sizeof(buf))
+      fatal("path to %s in library %s is too long", name, istr(lib->name));
    return buf;
 }
 
@@ -509,8 +614,25 @@ void lib_free(lib_t lib)
       }
    }
 
+   for (unsigned i = 0; i < lib->n_units; i++) {
+      if (lib->units[i].read_ctx != NULL)
+         tree_read_end(lib->units[i].read_ctx);
+   }
+
    if (lib->units != NULL)
       free(lib->units);
+
+   while (lib->index != NULL) {
+      lib_index_t *tmp = lib->index->next;
+      free(lib->index);
+      lib->index = tmp;
+   }
+
+   if (lib->arena != NULL)
+      tree_arena_free(lib->arena);
+
+   hash_free(lib->lookup);
+   hash_free(lib->index_hash);
    free(lib);
 }
 
@@ -575,7 +697,7 @@ void lib_put(lib_t lib, tree_t unit)
    lib_put_aux(lib, unit, NULL, true, usecs);
 }
 
-static lib_mtime_t lib_stat_mtime(struct stat *st)
+static lib_mtime_t lib_stat_mtime(const struct stat *st)
 {
    lib_mtime_t mt = lib_time_to_usecs(st->st_mtime);
 #if defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
@@ -599,45 +721,38 @@ static lib_unit_t *lib_get_aux(lib_t lib, ident_t ident)
    }
 
    // Search in the list of already loaded units
-   for (unsigned n = 0; n < lib->n_units; n++) {
-      if (tree_ident(lib->units[n].top) == ident)
-         return &(lib->units[n]);
-   }
+   lib_unit_t *unit = lib_find_loaded(lib, ident);
+   if (unit != NULL)
+      return unit;
 
    if (*(lib->path) == '\0')   // Temporary library
       return NULL;
 
-   lib_read_lock(lib);
-
-   // Otherwise search in the filesystem
-   DIR *d = opendir(lib->path);
-   if (d == NULL)
-      fatal("%s: %s", lib->path, strerror(errno));
+   // Otherwise open the unit file directly: the file name is the unit
+   // name and units are always renamed into place so no lock is needed
+   const char *name = istr(ident);
+   fbuf_t *f = lib_fbuf_open(lib, name, FBUF_IN);
+   if (f != NULL) {
+      const struct stat *st = fbuf_stat(f);
+      const lib_mtime_t mt = lib_stat_mtime(st);
+      const uint64_t size = st->st_size;
 
-   lib_unit_t *unit = NULL;
-   const char *search = istr(ident);
-   struct dirent *e;
-   while ((e = readdir(d))) {
-      if (strcmp(e->d_name, search) == 0) {
-         fbuf_t *f = lib_fbuf_open(lib, e->d_name, FBUF_IN);
-         tree_rd_ctx_t ctx = tree_read_begin(f, lib_file_path(lib, e->d_name));
-         tree_t top = tree_read(ctx);
-         fbuf_close(f);
+      if (lib->arena == NULL)
+         lib->arena = tree_arena_new();
 
-         struct stat st;
-         if (stat(lib_file_path(lib, e->d_name), &st) < 0)
-            fatal_errno("%s", e->d_name);
+      tree_arena_t prev = tree_arena_select(lib->arena);
+      tree_rd_ctx_t ctx = tree_read_begin(f, lib_file_path(lib, name));
+      tree_t top = tree_read(ctx);
+      tree_arena_select(prev);
+      fbuf_close(f);
 
-         lib_mtime_t mt = lib_stat_mtime(&st);
+      unit = lib_put_aux(lib, top, ctx, false, mt);
 
-         unit = lib_put_aux(lib, top, ctx, false, mt);
-         break;
-      }
+      lib_index_t *in = lib_find_in_index(lib, ident);
+      in->mtime = mt;
+      in->size  = size;
    }
 
-   closedir(d);
-   lib_unlock(lib);
-
    if (unit == NULL && lib_find_in_index(lib, ident) != NULL)
       fatal("library %s corrupt: unit %s present in index but missing "
             "on disk", istr(lib->name), istr(ident));
@@ -647,6 +762,13 @@ static lib_unit_t *lib_get_aux(lib_t lib, ident_t ident)
 
 lib_mtime_t lib_mtime(lib_t lib, ident_t ident)
 {
+   // Avoid loading the unit if the index has the time it was written
+   if (lib_find_loaded(lib, ident) == NULL) {
+      lib_index_t *in = lib_find_in_index(lib, ident);
+      if (in != NULL && in->mtime != 0)
+         return in->mtime;
+   }
+
    lib_unit_t *lu = lib_get_aux(lib, ident);
    assert(lu != NULL);
    return lu->mtime;
@@ -703,8 +825,21 @@ tree_t lib_get_check_stale(lib_t lib, ident_t ident)
       if (!opt_get_int("ignore-time")) {
          const loc_t *loc = tree_loc(lu->top);
 
-         struct stat st;
-         if ((stat(loc->file, &st) == 0) && (lu->mtime < lib_stat_mtime(&st)))
+         // Many units share a source file so only stat each once
+         if (source_mtimes == NULL)
+            source_mtimes = hash_new(64, true);
+
+         ident_t file_i = ident_new(loc->file);
+         lib_mtime_t *smt = hash_get(source_mtimes, file_i);
+         if (smt == NULL) {
+            smt = xmalloc(sizeof(lib_mtime_t));
+
+            struct stat st;
+            *smt = (stat(loc->file, &st) == 0) ? lib_stat_mtime(&st) : 0;
+            hash_put(source_mtimes, file_i, smt);
+         }
+
+         if (lu->mtime < *smt)
             fatal("design unit %s is older than its source file %s and must "
                   "be reanalysed\n(You can use the --ignore-time option to "
                   "skip this check)", istr(ident), loc->file);
@@ -722,12 +857,8 @@ ident_t lib_name(lib_t lib)
    return lib->name;
 }
 
-void lib_save(lib_t lib)
+static void lib_write_units(lib_t lib)
 {
-   assert(lib != NULL);
-
-   lib_write_lock(lib);
-
    for (unsigned n = 0; n < lib->n_units; n++) {
       if (lib->units[n].dirty) {
          const char *name = istr(tree_ident(lib->units[n].top));
@@ -740,9 +871,33 @@ void lib_save(lib_t lib)
          fbuf_close(f);
 
          lib->units[n].dirty = false;
+
+         // Writing the unit may have reused the buffer holding the name
+         name = istr(tree_ident(lib->units[n].top));
+
+         struct stat st;
+         if (stat(lib_file_path(lib, name), &st) < 0)
+            fatal_errno("%s", name);
+
+         lib_index_t *in =
+            lib_find_in_index(lib, tree_ident(lib->units[n].top));
+         in->mtime   = lib_stat_mtime(&st);
+         in->size    = st.st_size;
+         in->pending = true;
       }
    }
+}
+
+void lib_save_units(lib_t lib)
+{
+   // Write modified units without replacing the index
+   assert(lib != NULL);
 
+   lib_write_units(lib);
+}
+
+static void lib_write_index(lib_t lib)
+{
    lib_index_t *it;
    int index_sz = 0;
    for (it = lib->index; it != NULL; it = it->next, ++index_sz)
@@ -754,15 +909,125 @@ void lib_save(lib_t lib)
 
    ident_wr_ctx_t ictx = ident_write_begin(f);
 
+   write_u32(INDEX_MAGIC, f);
    write_u32(index_sz, f);
    for (it = lib->index; it != NULL; it = it->next) {
       ident_write(it->name, ictx);
       write_u16(it->kind, f);
+      write_u64(it->mtime, f);
+      write_u64(it->size, f);
    }
 
    ident_write_end(ictx);
    fbuf_close(f);
+}
+
+static off_t lib_journal_append(lib_t lib)
+{
+   size_t len = 8;
+   for (lib_index_t *it = lib->index; it != NULL; it = it->next) {
+      if (it->pending)
+         len += 2 + strlen(istr(it->name)) + 1 + 2 + 8 + 8;
+   }
+
+   if (len == 8)
+      return 0;
+
+   uint8_t *buf = xmalloc(len), *p = buf;
+   lib_journal_put(&p, JOURNAL_MAGIC, 4);
+   lib_journal_put(&p, len - 8, 4);
+
+   for (lib_index_t *it = lib->index; it != NULL; it = it->next) {
+      if (!it->pending)
+         continue;
+
+      const char *name = istr(it->name);
+      const size_t namelen = strlen(name) + 1;
+      lib_journal_put(&p, namelen, 2);
+      memcpy(p, name, namelen);
+      p += namelen;
+
+      lib_journal_put(&p, it->kind, 2);
+      lib_journal_put(&p, it->mtime, 8);
+      lib_journal_put(&p, it->size, 8);
+
+      it->pending = false;
+   }
+
+   assert(p == buf + len);
+
+   // Appends from other processes holding the shared lock cannot
+   // interleave with a single write to a file opened with O_APPEND
+   const char *path = lib_file_path(lib, "_index.log");
+   int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+   if (fd < 0)
+      fatal_errno("failed to open library %s index journal",
+                  istr(lib->name));
+
+   if (write(fd, buf, len) != len)
+      fatal_errno("write: %s", path);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("fstat");
+
+   close(fd);
+   free(buf);
+
+   return st.st_size;
+}
+
+void lib_save(lib_t lib)
+{
+   assert(lib != NULL);
+
+   lib_write_units(lib);
+
+   // Concurrent saves only share the lock so analysing disjoint units
+   // into the same library proceeds in parallel
+   if (flock(lib->lock_fd, LOCK_SH) < 0)
+      fatal_errno("flock");
+
+   const off_t jsize = lib_journal_append(lib);
+
    lib_unlock(lib);
+
+   // Fold the journal into the index if no other process is saving:
+   // merging the latest index and journal first preserves any entries
+   // written since this library was opened
+   if (jsize > JOURNAL_MAX && flock(lib->lock_fd, LOCK_EX | LOCK_NB) == 0) {
+      lib_read_index(lib);
+      lib_write_index(lib);
+
+      if (truncate(lib_file_path(lib, "_index.log"), 0) != 0)
+         fatal_errno("truncate");
+
+      lib_unlock(lib);
+   }
+}
+
+void lib_refresh(lib_t lib)
+{
+   // Forget units another process has written since they were loaded
+   // so the next lookup reads the new version from disk
+   assert(lib != NULL);
+
+   if (*(lib->path) == '\0')   // Temporary library
+      return;
+
+   lib_read_index(lib);
+
+   for (unsigned n = 0; n < lib->n_units; n++) {
+      lib_unit_t *lu = &(lib->units[n]);
+      ident_t name = tree_ident(lu->top);
+
+      if (lu->dirty || lib_find_loaded(lib, name) != lu)
+         continue;
+
+      lib_index_t *in = lib_find_in_index(lib, name);
+      if (in != NULL && in->mtime > lu->mtime)
+         hash_put(lib->lookup, name, NULL);
+   }
 }
 
 void lib_walk_index(lib_t lib, lib_index_fn_t fn, void *context)
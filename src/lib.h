@@ -41,6 +41,8 @@ void lib_realpath(lib_t lib, const char *name, char *buf, size_t buflen);
 void lib_destroy(lib_t lib);
 ident_t lib_name(lib_t lib);
 void lib_save(lib_t lib);
+void lib_save_units(lib_t lib);
+void lib_refresh(lib_t lib);
 void lib_mkdir(lib_t lib, const char *name);
 const char *lib_enum_search_paths(void **token);
 void lib_add_search_path(const char *path);
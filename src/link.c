@@ -19,6 +19,7 @@
 #include "phase.h"
 #include "tree.h"
 #include "common.h"
+#include "rt/rt.h"
 
 #include <stdlib.h>
 #include <stdarg.h>
@@ -28,6 +29,9 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
 
 #ifdef __CYGWIN__
 #include <process.h>
@@ -45,6 +49,7 @@
 #include <assert.h>
 
 #define MAX_ARGS          64
+#define MAX_PARTITIONS    32
 #define LINK_NATIVE_BYTES (100 * 1024)
 
 static char        **args = NULL;
@@ -272,7 +277,7 @@ static void link_args_end(void)
    free(args);
 }
 
-static void link_exec(void)
+static void link_print_args(void)
 {
    const bool quiet = (getenv("NVC_LINK_QUIET") != NULL);
 
@@ -280,6 +285,23 @@ static void link_exec(void)
       for (int i = 0; i < n_args; i++)
          printf("%s%c", args[i], (i + 1 == n_args ? '\n' : ' '));
    }
+}
+
+#ifndef __CYGWIN__
+static void link_wait(pid_t pid, const char *what)
+{
+   int status;
+   if (waitpid(pid, &status, 0) != pid)
+      fatal_errno("waitpid");
+
+   if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      fatal("%s failed with status %d", what, WEXITSTATUS(status));
+}
+#endif  // __CYGWIN__
+
+static void link_exec(void)
+{
+   link_print_args();
 
 #ifdef __CYGWIN__
    int status = spawnv(_P_WAIT, args[0], (const char * const *)args);
@@ -291,14 +313,8 @@ static void link_exec(void)
       execv(args[0], args);
       fatal_errno("execv");
    }
-   else if (pid > 0) {
-      int status;
-      if (waitpid(pid, &status, 0) != pid)
-         fatal_errno("waitpid");
-
-      if (WEXITSTATUS(status) != 0)
-         fatal("%s failed with status %d", args[0], WEXITSTATUS(status));
-   }
+   else if (pid > 0)
+      link_wait(pid, args[0]);
    else
       fatal_errno("fork");
 #endif  // __CYGWIN__
@@ -307,7 +323,138 @@ static void link_exec(void)
 }
 
 #ifdef ENABLE_NATIVE
-static void link_assembly(tree_t top)
+
+#ifdef LLVM_LLC_HAS_OBJ
+#define LINK_OBJ_EXT LLVM_OBJ_EXT
+#else
+#define LINK_OBJ_EXT "s"
+#endif
+
+static char *link_cache_dir(void)
+{
+   // Native code is cached by the hash of its bitcode in NVC_CACHE_DIR
+   // or ~/.cache/nvc which may be shared between users and machines
+
+   if (!opt_get_int("code-cache"))
+      return NULL;
+
+   const char *env = getenv("NVC_CACHE_DIR");
+   if (env != NULL)
+      return (*env == '\0') ? NULL : strdup(env);
+
+   const char *home = getenv("HOME");
+   if (home == NULL)
+      return NULL;
+
+   char *cache = xasprintf("%s/.cache", home);
+   if (mkdir(cache, 0777) != 0 && errno != EEXIST) {
+      free(cache);
+      return NULL;
+   }
+
+   char *dir = xasprintf("%s/nvc", cache);
+   free(cache);
+
+   if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+      free(dir);
+      return NULL;
+   }
+
+   return dir;
+}
+
+static uint64_t link_fnv1a(uint64_t hash, const void *data, size_t len)
+{
+   const uint8_t *p = data;
+   for (size_t i = 0; i < len; i++)
+      hash = (hash ^ p[i]) * UINT64_C(0x100000001b3);
+   return hash;
+}
+
+static void link_cache_key(LLVMModuleRef m, char *key, size_t len)
+{
+   // The key covers everything that affects the generated object code
+
+   const char *extra = getenv("NVC_LLC_ARG");
+   char *salt LOCAL = xasprintf("%s %s -O%d %s %s", PACKAGE_VERSION,
+                                LLVM_VERSION, opt_get_int("optimise"),
+                                extra ?: "", LINK_OBJ_EXT);
+
+   LLVMMemoryBufferRef buf = LLVMWriteBitcodeToMemoryBuffer(m);
+   const char *start = LLVMGetBufferStart(buf);
+   const size_t size = LLVMGetBufferSize(buf);
+
+   uint64_t h1 = UINT64_C(0xcbf29ce484222325);
+   uint64_t h2 = UINT64_C(0x84222325cbf29ce4);
+   h1 = link_fnv1a(h1, salt, strlen(salt));
+   h2 = link_fnv1a(h2, salt, strlen(salt));
+   h1 = link_fnv1a(h1, start, size);
+   h2 = link_fnv1a(h2 ^ size, start, size);
+
+   LLVMDisposeMemoryBuffer(buf);
+
+   checked_sprintf(key, len, "%016"PRIx64"%016"PRIx64, h1, h2);
+}
+
+static bool link_copy_file(const char *from, const char *to)
+{
+   FILE *in = fopen(from, "rb");
+   if (in == NULL)
+      return false;
+
+   // Write to a temporary file and rename so concurrent readers never
+   // see a partial object
+   char *tmp LOCAL = xasprintf("%s.%d.tmp", to, getpid());
+   FILE *out = fopen(tmp, "wb");
+   if (out == NULL) {
+      fclose(in);
+      return false;
+   }
+
+   char buf[16384];
+   size_t n;
+   bool ok = true;
+   while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+      ok = (fwrite(buf, 1, n, out) == n);
+
+   ok = !ferror(in) && ok;
+   fclose(in);
+   ok = (fclose(out) == 0) && ok;
+
+   if (ok && rename(tmp, to) == 0)
+      return true;
+
+   remove(tmp);
+   return false;
+}
+
+static bool link_cache_lookup(LLVMModuleRef m, const char *obj, char **cached)
+{
+   // Copy the object code generated from identical bitcode to obj if it
+   // is in the cache otherwise return where it should be stored
+
+   *cached = NULL;
+
+   char *cache LOCAL = link_cache_dir();
+   if (cache == NULL)
+      return false;
+
+   char key[33];
+   link_cache_key(m, key, sizeof(key));
+
+   char *path = xasprintf("%s/%s.%s", cache, key, LINK_OBJ_EXT);
+   if (link_copy_file(path, obj)) {
+      if (getenv("NVC_LINK_QUIET") == NULL)
+         printf("using cached %s\n", path);
+      free(path);
+      return true;
+   }
+
+   *cached = path;
+   return false;
+}
+
+static void link_compile(const char *bc, const char *obj, const char *cached)
 {
    link_args_begin();
 
@@ -317,7 +464,7 @@ static void link_assembly(tree_t top)
    link_arg_f("-relocation-model=pic");
    if (extra != NULL)
       link_arg_f("%s", extra);
-   link_output(top, "bc");
+   link_arg_f("%s", bc);
 #ifdef LLVM_LLC_HAS_OBJ
    link_arg_f("-filetype=obj");
 #endif
@@ -325,11 +472,30 @@ static void link_assembly(tree_t top)
    link_exec();
 
    link_args_end();
+
+   if (cached != NULL && !link_copy_file(obj, cached))
+      warnf("cannot write %s to native code cache", cached);
+}
+
+static void link_assembly(tree_t top)
+{
+   const char *base = istr(tree_kind(top) == T_ELAB
+                           ? link_elab_final(top) : tree_ident(top));
+
+   char lib_path[PATH_MAX];
+   lib_realpath(lib_work(), NULL, lib_path, sizeof(lib_path));
+
+   char *bc LOCAL = xasprintf("%s/_%s.bc", lib_path, base);
+   char *obj LOCAL = xasprintf("%s/_%s.%s", lib_path, base, LINK_OBJ_EXT);
+
+   char *cached LOCAL = NULL;
+   if (!link_cache_lookup(module, obj, &cached))
+      link_compile(bc, obj, cached);
 }
 #endif
 
 #ifdef ENABLE_NATIVE
-static void link_shared(tree_t top)
+static void link_shared(tree_t top, int nparts)
 {
    link_args_begin();
 
@@ -352,11 +518,18 @@ static void link_shared(tree_t top)
 
    link_output(top, "so");
 
-#ifdef LLVM_LLC_HAS_OBJ
-   link_output(top, LLVM_OBJ_EXT);
-#else
-   link_output(top, "s");
-#endif
+   const char *obj_ext = LINK_OBJ_EXT;
+
+   if (nparts > 1) {
+      char lib_path[PATH_MAX];
+      lib_realpath(lib_work(), NULL, lib_path, sizeof(lib_path));
+
+      for (int i = 0; i < nparts; i++)
+         link_arg_f("%s/_%s.part%d.%s", lib_path,
+                    istr(link_elab_final(top)), i, obj_ext);
+   }
+   else
+      link_output(top, obj_ext);
 
    const char *obj = getenv("NVC_FOREIGN_OBJ");
    if (obj != NULL)
@@ -380,7 +553,7 @@ static void link_native(tree_t top)
 {
 #ifdef ENABLE_NATIVE
    link_assembly(top);
-   link_shared(top);
+   link_shared(top, 1);
 #else
    fatal("native code generation is not available on this system");
 #endif
@@ -407,67 +580,215 @@ static void link_write_module(tree_t top)
    fclose(f);
 }
 
-static void link_opt(tree_t top)
+typedef void (*add_pass_fn_t)(LLVMPassManagerRef);
+
+typedef struct {
+   const char    *name;
+   add_pass_fn_t  add;
+   bool           analysis;
+} link_pass_t;
+
+#define PASS(name) { #name, LLVMAdd##name##Pass, false }
+#define ANALYSIS(name) { #name, LLVMAdd##name##Pass, true }
+
+// Quick cleanup for fast turnaround: -O1
+static const link_pass_t quick_passes[] = {
+   PASS(PromoteMemoryToRegister),
+   PASS(InstructionCombining),
+   PASS(CFGSimplification),
+   PASS(Verifier)
+};
+
+// Optimisations from LLVM opt -O2
+static const link_pass_t default_passes[] = {
+   PASS(PromoteMemoryToRegister),
+   PASS(GVN),
+   PASS(ConstantPropagation),
+   ANALYSIS(BasicAliasAnalysis),
+   ANALYSIS(TypeBasedAliasAnalysis),
+   PASS(SCCP),
+   PASS(GlobalOptimizer),
+   PASS(DeadArgElimination),
+   PASS(InstructionCombining),
+   PASS(CFGSimplification),
+   PASS(PruneEH),
+   PASS(FunctionInlining),
+   PASS(FunctionAttrs),
+   PASS(ArgumentPromotion),
+   PASS(EarlyCSE),
+   PASS(JumpThreading),
+   PASS(CorrelatedValuePropagation),
+   PASS(CFGSimplification),
+   PASS(InstructionCombining),
+   PASS(TailCallElimination),
+   PASS(CFGSimplification),
+   PASS(InstructionCombining),
+   PASS(Reassociate),
+   PASS(LoopRotate),
+   PASS(LoopUnswitch),
+   PASS(InstructionCombining),
+   PASS(IndVarSimplify),
+   PASS(LoopIdiom),
+   PASS(LoopDeletion),
+   PASS(LoopUnroll),
+   PASS(GVN),
+   PASS(MemCpyOpt),
+   PASS(SCCP),
+   PASS(InstructionCombining),
+   PASS(JumpThreading),
+   PASS(CorrelatedValuePropagation),
+   PASS(SLPVectorize),
+   PASS(AggressiveDCE),
+   PASS(CFGSimplification),
+   PASS(InstructionCombining),
+   PASS(LoopVectorize),
+   PASS(InstructionCombining),
+   PASS(CFGSimplification),
+   PASS(LoopUnroll),
+   PASS(StripDeadPrototypes),
+   PASS(GlobalDCE),
+   PASS(ConstantMerge),
+   PASS(Verifier)
+};
+
+// Second round of inlining and cleanup after -O2 for -O3
+static const link_pass_t aggressive_passes[] = {
+   ANALYSIS(BasicAliasAnalysis),
+   ANALYSIS(TypeBasedAliasAnalysis),
+   PASS(IPSCCP),
+   PASS(FunctionInlining),
+   PASS(InstructionCombining),
+   PASS(LICM),
+   PASS(DeadStoreElimination),
+   PASS(GVN),
+   PASS(InstructionCombining),
+   PASS(CFGSimplification),
+   PASS(GlobalDCE),
+   PASS(Verifier)
+};
+
+#undef PASS
+#undef ANALYSIS
+
+typedef struct {
+   const char *name;
+   double      ms;
+} pass_time_t;
+
+static void link_run_timed(const link_pass_t *passes, int npasses,
+                           pass_time_t *times, int *ntimes)
 {
-   LLVMPassManagerRef pm = LLVMCreatePassManager();
+   // Run each pass with its own pass manager so it can be timed
+   // separately but keep the alias analyses requested before it
+
+   for (int i = 0; i < npasses; i++) {
+      if (passes[i].analysis)
+         continue;
+
+      LLVMPassManagerRef pm = LLVMCreatePassManager();
+      for (int j = 0; j < i; j++) {
+         if (passes[j].analysis)
+            (*passes[j].add)(pm);
+      }
+      (*passes[i].add)(pm);
+
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      LLVMRunPassManager(pm, module);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      LLVMDisposePassManager(pm);
+
+      const double ms = (end.tv_sec - start.tv_sec) * 1000.0
+         + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+      int n;
+      for (n = 0; n < *ntimes; n++) {
+         if (strcmp(times[n].name, passes[i].name) == 0)
+            break;
+      }
+
+      if (n == *ntimes) {
+         times[n].name = passes[i].name;
+         times[n].ms   = 0.0;
+         (*ntimes)++;
+      }
+
+      times[n].ms += ms;
+   }
+}
 
-   // Basic cleanup optimisations
-   LLVMAddPromoteMemoryToRegisterPass(pm);
-   LLVMAddGVNPass(pm);
-   LLVMAddConstantPropagationPass(pm);
-
-   // Optimisations from LLVM opt -O2
-   LLVMAddBasicAliasAnalysisPass(pm);
-   LLVMAddTypeBasedAliasAnalysisPass(pm);
-   LLVMAddSCCPPass(pm);
-   LLVMAddGlobalOptimizerPass(pm);
-   LLVMAddDeadArgEliminationPass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddCFGSimplificationPass(pm);
-   LLVMAddPruneEHPass(pm);
-   LLVMAddFunctionInliningPass(pm);
-   LLVMAddFunctionAttrsPass(pm);
-   LLVMAddArgumentPromotionPass(pm);
-   LLVMAddEarlyCSEPass(pm);
-   LLVMAddJumpThreadingPass(pm);
-   LLVMAddCorrelatedValuePropagationPass(pm);
-   LLVMAddCFGSimplificationPass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddTailCallEliminationPass(pm);
-   LLVMAddCFGSimplificationPass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddReassociatePass(pm);
-   LLVMAddLoopRotatePass(pm);
-   LLVMAddLoopUnswitchPass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddIndVarSimplifyPass(pm);
-   LLVMAddLoopIdiomPass(pm);
-   LLVMAddLoopDeletionPass(pm);
-   LLVMAddLoopUnrollPass(pm);
-   LLVMAddGVNPass(pm);
-   LLVMAddMemCpyOptPass(pm);
-   LLVMAddSCCPPass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddJumpThreadingPass(pm);
-   LLVMAddCorrelatedValuePropagationPass(pm);
-   LLVMAddSLPVectorizePass(pm);
-   LLVMAddAggressiveDCEPass(pm);
-   LLVMAddCFGSimplificationPass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddLoopVectorizePass(pm);
-   LLVMAddInstructionCombiningPass(pm);
-   LLVMAddCFGSimplificationPass(pm);
-   LLVMAddLoopUnrollPass(pm);
-   LLVMAddStripDeadPrototypesPass(pm);
-   LLVMAddGlobalDCEPass(pm);
-   LLVMAddConstantMergePass(pm);
-
-   LLVMAddVerifierPass(pm);
+static int link_pass_time_cmp(const void *a, const void *b)
+{
+   const double diff = ((pass_time_t *)b)->ms - ((pass_time_t *)a)->ms;
+   return (diff > 0.0) - (diff < 0.0);
+}
+
+static void link_run_passes(const link_pass_t *passes, int npasses)
+{
+   LLVMPassManagerRef pm = LLVMCreatePassManager();
+   for (int i = 0; i < npasses; i++)
+      (*passes[i].add)(pm);
 
    LLVMRunPassManager(pm, module);
    LLVMDisposePassManager(pm);
 }
 
+static void link_opt(tree_t top)
+{
+   const int level = opt_get_int("optimise");
+
+   struct {
+      const link_pass_t *passes;
+      int                npasses;
+   } tiers[2];
+   int ntiers = 0;
+
+   switch (level) {
+   case 0:
+      return;
+   case 1:
+      tiers[ntiers].passes = quick_passes;
+      tiers[ntiers++].npasses = ARRAY_LEN(quick_passes);
+      break;
+   default:
+      tiers[ntiers].passes = default_passes;
+      tiers[ntiers++].npasses = ARRAY_LEN(default_passes);
+      if (level >= 3) {
+         tiers[ntiers].passes = aggressive_passes;
+         tiers[ntiers++].npasses = ARRAY_LEN(aggressive_passes);
+      }
+      break;
+   }
+
+   if (opt_get_int("time-passes")) {
+      const int maxtimes =
+         ARRAY_LEN(default_passes) + ARRAY_LEN(aggressive_passes);
+      pass_time_t times[maxtimes];
+      int ntimes = 0;
+
+      for (int i = 0; i < ntiers; i++)
+         link_run_timed(tiers[i].passes, tiers[i].npasses, times, &ntimes);
+
+      qsort(times, ntimes, sizeof(pass_time_t), link_pass_time_cmp);
+
+      double total = 0.0;
+      for (int i = 0; i < ntimes; i++)
+         total += times[i].ms;
+
+      printf("Optimisation pass timing for %s (-O%d):\n",
+             istr(tree_ident(top)), level);
+      for (int i = 0; i < ntimes; i++)
+         printf("  %-28s %10.1fms %5.1f%%\n", times[i].name, times[i].ms,
+                total > 0.0 ? times[i].ms * 100.0 / total : 0.0);
+      printf("  %-28s %10.1fms\n", "Total", total);
+   }
+   else {
+      for (int i = 0; i < ntiers; i++)
+         link_run_passes(tiers[i].passes, tiers[i].npasses);
+   }
+}
+
 static FILE *link_deps_file(tree_t top)
 {
    char *deps_name = xasprintf("_%s.deps.txt", istr(tree_ident(top)));
@@ -476,6 +797,182 @@ static FILE *link_deps_file(tree_t top)
    return fp;
 }
 
+#if defined ENABLE_NATIVE && !defined __CYGWIN__
+static bool link_is_local(LLVMValueRef v)
+{
+   const LLVMLinkage linkage = LLVMGetLinkage(v);
+   return linkage == LLVMPrivateLinkage || linkage == LLVMInternalLinkage;
+}
+
+static void link_make_visible(void)
+{
+   // Any definition may now be referenced from another partition so
+   // none of them can be private to the module
+
+   int anon = 0;
+
+   for (LLVMValueRef fn = LLVMGetFirstFunction(module);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (!LLVMIsDeclaration(fn) && link_is_local(fn)) {
+         LLVMSetLinkage(fn, LLVMExternalLinkage);
+         LLVMSetVisibility(fn, LLVMHiddenVisibility);
+      }
+   }
+
+   for (LLVMValueRef g = LLVMGetFirstGlobal(module);
+        g != NULL; g = LLVMGetNextGlobal(g)) {
+      if (LLVMIsDeclaration(g) || !link_is_local(g))
+         continue;
+      else if (LLVMIsGlobalConstant(g))
+         continue;   // Copied into every partition
+
+      const char *name = LLVMGetValueName(g);
+      if (*name == '\0') {
+         char *fresh LOCAL = xasprintf("_nvc_anon%d", anon++);
+         LLVMSetValueName(g, fresh);
+      }
+
+      LLVMSetLinkage(g, LLVMExternalLinkage);
+      LLVMSetVisibility(g, LLVMHiddenVisibility);
+   }
+}
+
+static void link_strip_body(LLVMValueRef fn)
+{
+   // Break all references between instructions before deleting them
+
+   for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn);
+        bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+      for (LLVMValueRef i = LLVMGetFirstInstruction(bb);
+           i != NULL; i = LLVMGetNextInstruction(i)) {
+         LLVMTypeRef type = LLVMTypeOf(i);
+         if (LLVMGetTypeKind(type) != LLVMVoidTypeKind)
+            LLVMReplaceAllUsesWith(i, LLVMGetUndef(type));
+      }
+   }
+
+   for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn);
+        bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+      LLVMValueRef i;
+      while ((i = LLVMGetFirstInstruction(bb)) != NULL)
+         LLVMInstructionEraseFromParent(i);
+   }
+
+   LLVMBasicBlockRef bb;
+   while ((bb = LLVMGetFirstBasicBlock(fn)) != NULL)
+      LLVMDeleteBasicBlock(bb);
+
+   LLVMSetLinkage(fn, LLVMExternalLinkage);
+}
+
+static LLVMModuleRef link_partition(int part, int nparts)
+{
+   // Keep the function bodies whose name hashes to this partition and
+   // turn the rest into declarations. Hashing the name rather than
+   // counting keeps the partitions stable when unrelated functions are
+   // added which lets the native code cache hit. Mutable globals are
+   // defined in the first partition only
+
+   LLVMModuleRef m = LLVMCloneModule(module);
+
+   for (LLVMValueRef fn = LLVMGetFirstFunction(m);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (LLVMIsDeclaration(fn))
+         continue;
+
+      const char *name = LLVMGetValueName(fn);
+      const uint64_t hash =
+         link_fnv1a(UINT64_C(0xcbf29ce484222325), name, strlen(name));
+      if ((hash % nparts) != part)
+         link_strip_body(fn);
+   }
+
+   if (part > 0) {
+      LLVMValueRef g = LLVMGetFirstGlobal(m);
+      while (g != NULL) {
+         LLVMValueRef next = LLVMGetNextGlobal(g);
+
+         if (LLVMGetLinkage(g) == LLVMAppendingLinkage)
+            LLVMDeleteGlobal(g);
+         else if (!LLVMIsDeclaration(g) && !link_is_local(g)) {
+            LLVMSetInitializer(g, NULL);
+            LLVMSetLinkage(g, LLVMExternalLinkage);
+         }
+
+         g = next;
+      }
+   }
+
+   return m;
+}
+
+static int link_count_functions(void)
+{
+   int count = 0;
+   for (LLVMValueRef fn = LLVMGetFirstFunction(module);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (!LLVMIsDeclaration(fn))
+         count++;
+   }
+
+   return count;
+}
+
+static void link_parallel(tree_t top, int nparts)
+{
+   // Split the design into several modules which are optimised and
+   // compiled to native code concurrently in child processes
+
+   link_make_visible();
+   link_write_module(top);
+
+   char lib_path[PATH_MAX];
+   lib_realpath(lib_work(), NULL, lib_path, sizeof(lib_path));
+
+   ident_t final = link_elab_final(top);
+
+   pid_t pids[MAX_PARTITIONS];
+   for (int i = 0; i < nparts; i++) {
+      LLVMModuleRef m = link_partition(i, nparts);
+
+      fflush(stdout);
+
+      if ((pids[i] = fork()) == 0) {
+         char *bc = xasprintf("%s/_%s.part%d.bc", lib_path, istr(final), i);
+         char *obj = xasprintf("%s/_%s.part%d.%s", lib_path, istr(final),
+                               i, LINK_OBJ_EXT);
+
+         // Look up the cache before optimising so a hit skips both
+         // the optimiser and llc
+         char *cached;
+         if (link_cache_lookup(m, obj, &cached))
+            exit(EXIT_SUCCESS);
+
+         module = m;
+         link_opt(top);
+
+         if (LLVMWriteBitcodeToFile(m, bc) != 0)
+            fatal("error writing LLVM bitcode to %s", bc);
+
+         link_compile(bc, obj, cached);
+         exit(EXIT_SUCCESS);
+      }
+      else if (pids[i] < 0)
+         fatal_errno("fork");
+
+      LLVMDisposeModule(m);
+   }
+
+   for (int i = 0; i < nparts; i++)
+      link_wait(pids[i], "llc");
+
+   if (opt_get_int("verbose"))
+      notef("compiled native code in %d parallel partitions", nparts);
+
+   link_shared(top, nparts);
+}
+#endif  // ENABLE_NATIVE && !__CYGWIN__
+
 void link_bc(tree_t top)
 {
    module = tree_attr_ptr(top, llvm_i);
@@ -483,14 +980,37 @@ void link_bc(tree_t top)
 
    const bool opt_en = opt_get_int("optimise");
 
+   stats_phase_begin("link context");
    FILE *deps = link_deps_file(top);
    link_all_context(top, deps, link_context_bc_fn);
    fclose(deps);
+   stats_phase_end();
 
-   if (opt_en)
+#if defined ENABLE_NATIVE && !defined __CYGWIN__
+   const int jobs = MIN(opt_get_int("elab-jobs"), MAX_PARTITIONS);
+   if (opt_get_int("native") && jobs > 1) {
+      if (!opt_en)
+         fatal("optimisation must be enabled for native code generation");
+
+      const int nparts = MIN(jobs, link_count_functions());
+      if (nparts > 1) {
+         stats_phase_begin("native");
+         link_parallel(top, nparts);
+         stats_phase_end();
+         return;
+      }
+   }
+#endif  // ENABLE_NATIVE && !__CYGWIN__
+
+   if (opt_en) {
+      stats_phase_begin("optimise");
       link_opt(top);
+      stats_phase_end();
+   }
 
+   stats_phase_begin("write bitcode");
    link_write_module(top);
+   stats_phase_end();
 
    bool native = false;
 
@@ -522,8 +1042,33 @@ void link_bc(tree_t top)
 #endif  // ENABLE_NATIVE
    }
 
-   if (native)
+   if (native) {
+      stats_phase_begin("native");
       link_native(top);
+      stats_phase_end();
+   }
+}
+
+bool link_up_to_date(tree_t top)
+{
+   ident_t final = link_elab_final(top);
+   const lib_mtime_t elab_mt = lib_mtime(lib_work(), tree_ident(top));
+
+   char *bc_name LOCAL = xasprintf("_%s.bc", istr(final));
+
+   lib_mtime_t bc_mt;
+   if (!lib_stat(lib_work(), bc_name, &bc_mt) || bc_mt < elab_mt)
+      return false;
+
+   if (opt_get_int("native")) {
+      char *so_name LOCAL = xasprintf("_%s.so", istr(final));
+
+      lib_mtime_t so_mt;
+      if (!lib_stat(lib_work(), so_name, &so_mt) || so_mt < bc_mt)
+         return false;
+   }
+
+   return true;
 }
 
 void link_package(tree_t pack)
@@ -543,7 +1088,17 @@ void link_package(tree_t pack)
 
    LLVMDisposeMemoryBuffer(buf);
 
+   // Designs are linked against the shared library rather than the
+   // bitcode so tag it with the runtime interface it was built for: the
+   // bitcode of several packages may still be linked together when the
+   // shared library is missing so the symbol must be weak
+   LLVMValueRef abi = LLVMAddGlobal(module, LLVMInt32Type(), RT_ABI_SYMBOL);
+   LLVMSetInitializer(abi, LLVMConstInt(LLVMInt32Type(), RT_ABI_VERSION, 0));
+   LLVMSetGlobalConstant(abi, true);
+   LLVMSetLinkage(abi, LLVMWeakODRLinkage);
+
    link_opt(pack);
+   link_write_module(pack);
    link_native(pack);
 }
 
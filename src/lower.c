@@ -38,6 +38,7 @@ typedef enum {
 } name_attr_t;
 
 #define MAX_CASE_ARCS 32
+#define MAX_CASE_BITS 63   // Largest packed key for an array case
 
 typedef struct case_arc   case_arc_t;
 typedef struct case_state case_state_t;
@@ -1006,6 +1007,49 @@ static vcode_reg_t lower_name_attr(tree_t ref, name_attr_t which)
    return emit_wrap(data, &dim0, 1);
 }
 
+static vcode_reg_t lower_enum_image(type_t type, vcode_reg_t value)
+{
+   // Slice the image out of a constant table holding the names of all
+   // the literals so no call into the runtime is needed
+
+   const int nlits = type_enum_literals(type);
+   vcode_type_t ctype = vtype_char();
+   vcode_type_t voffset = vtype_offset();
+
+   size_t nchars = 0;
+   for (int i = 0; i < nlits; i++)
+      nchars += strlen(istr(tree_ident(type_enum_literal(type, i))));
+
+   vcode_reg_t *chars LOCAL = xmalloc(MAX(nchars, 1) * sizeof(vcode_reg_t));
+   vcode_reg_t *starts LOCAL = xmalloc((nlits + 1) * sizeof(vcode_reg_t));
+
+   size_t pos = 0;
+   for (int i = 0; i < nlits; i++) {
+      starts[i] = emit_const(voffset, pos);
+      for (const char *p = istr(tree_ident(type_enum_literal(type, i)));
+           *p != '\0'; p++)
+         chars[pos++] = emit_const(ctype, *p);
+   }
+   starts[nlits] = emit_const(voffset, pos);
+
+   vcode_reg_t chars_reg =
+      emit_const_array(vtype_pointer(ctype), chars, nchars, true);
+   vcode_reg_t starts_reg =
+      emit_const_array(vtype_pointer(voffset), starts, nlits + 1, true);
+
+   vcode_reg_t index_reg = emit_cast(voffset, voffset, value);
+   vcode_reg_t next_reg  = emit_add(index_reg, emit_const(voffset, 1));
+   vcode_reg_t first_reg = emit_load_indirect(emit_add(starts_reg, index_reg));
+   vcode_reg_t last_reg  = emit_load_indirect(emit_add(starts_reg, next_reg));
+
+   vcode_dim_t dim0 = {
+      .left  = emit_const(voffset, 1),
+      .right = emit_sub(last_reg, first_reg),
+      .dir   = emit_const(vtype_bool(), RANGE_TO)
+   };
+   return emit_wrap(emit_add(chars_reg, first_reg), &dim0, 1);
+}
+
 static vcode_reg_t lower_narrow(type_t result, vcode_reg_t reg)
 {
    // Resize arithmetic result to width of target type
@@ -1283,6 +1327,43 @@ static vcode_type_t lower_func_result_type(tree_t func)
       return lower_type(result);
 }
 
+static bool lower_logic_vec_intrinsic(ident_t name, bit_vec_op_kind_t *kind)
+{
+   // The logical operators on std_logic_vector from IEEE.STD_LOGIC_1164
+   // are replaced by a runtime kernel which processes several elements
+   // at once but otherwise matches the package body exactly
+
+#if LLVM_MANGLES_NAMES
+#define LOGIC_VEC_FN(op, args) "IEEE.STD_LOGIC_1164." op "__V" args
+#else
+#define LOGIC_VEC_FN(op, args) "IEEE.STD_LOGIC_1164.\"" op "\"$V" args
+#endif
+
+   static const struct {
+      const char        *name;
+      bit_vec_op_kind_t  kind;
+   } intrinsics[] = {
+      { LOGIC_VEC_FN("not", "V"),   LOGIC_VEC_NOT  },
+      { LOGIC_VEC_FN("and", "VV"),  LOGIC_VEC_AND  },
+      { LOGIC_VEC_FN("or", "VV"),   LOGIC_VEC_OR   },
+      { LOGIC_VEC_FN("xor", "VV"),  LOGIC_VEC_XOR  },
+      { LOGIC_VEC_FN("xnor", "VV"), LOGIC_VEC_XNOR },
+      { LOGIC_VEC_FN("nand", "VV"), LOGIC_VEC_NAND },
+      { LOGIC_VEC_FN("nor", "VV"),  LOGIC_VEC_NOR  }
+   };
+
+#undef LOGIC_VEC_FN
+
+   for (int i = 0; i < ARRAY_LEN(intrinsics); i++) {
+      if (icmp(name, intrinsics[i].name)) {
+         *kind = intrinsics[i].kind;
+         return true;
+      }
+   }
+
+   return false;
+}
+
 static vcode_reg_t lower_fcall(tree_t fcall, expr_ctx_t ctx)
 {
    tree_t decl = tree_ref(fcall);
@@ -1293,6 +1374,15 @@ static vcode_reg_t lower_fcall(tree_t fcall, expr_ctx_t ctx)
 
    ident_t name = lower_mangle_func(decl, vcode_unit_context());
 
+   bit_vec_op_kind_t kind;
+   if (lower_logic_vec_intrinsic(name, &kind)) {
+      vcode_reg_t r0 = lower_subprogram_arg(fcall, 0);
+      vcode_reg_t r1 = VCODE_INVALID_REG;
+      if (kind != LOGIC_VEC_NOT)
+         r1 = lower_subprogram_arg(fcall, 1);
+      return lower_bit_vec_op(kind, r0, r1, fcall);
+   }
+
    const int nargs = tree_params(fcall);
    vcode_reg_t args[nargs];
    for (int i = 0; i < nargs; i++)
@@ -1941,6 +2031,96 @@ static bool lower_memset_bit_pattern(tree_t value, unsigned bits, uint8_t *byte)
    return true;
 }
 
+static void lower_dyn_agg_store(vcode_reg_t ptr_reg, vcode_reg_t what,
+                                type_t elem_type, bool multidim,
+                                vcode_reg_t stride)
+{
+   if (type_is_array(elem_type)) {
+      vcode_reg_t src_reg = lower_array_data(what);
+      vcode_reg_t length_reg = lower_array_total_len(elem_type, what);
+      emit_copy(ptr_reg, src_reg, length_reg);
+   }
+   else if (multidim) {
+      vcode_reg_t src_reg = lower_array_data(what);
+      emit_copy(ptr_reg, src_reg, stride);
+   }
+   else if (type_is_record(elem_type))
+      emit_copy(ptr_reg, what, VCODE_INVALID_REG);
+   else
+      emit_store_indirect(lower_reify(what), ptr_reg);
+}
+
+static bool lower_dyn_agg_can_fill(tree_t agg)
+{
+   // Without range associations each element other than those covered
+   // by others has exactly one association giving its value
+
+   const int nassocs = tree_assocs(agg);
+   for (int i = 0; i < nassocs; i++) {
+      if (tree_subkind(tree_assoc(agg, i)) == A_RANGE)
+         return false;
+   }
+
+   return true;
+}
+
+static void lower_dyn_agg_fill(vcode_reg_t mem_reg, vcode_reg_t def_reg,
+                               type_t elem_type, bool multidim,
+                               vcode_reg_t stride, vcode_reg_t len0_reg)
+{
+   // Store the others value in the first element and then repeatedly
+   // double the initialised prefix with a single copy so the loop runs
+   // a logarithmic number of times
+
+   vcode_type_t offset_type = vtype_offset();
+
+   vcode_block_t first_bb = emit_block();
+   vcode_block_t test_bb  = emit_block();
+   vcode_block_t body_bb  = emit_block();
+   vcode_block_t exit_bb  = emit_block();
+
+   vcode_reg_t zero_reg = emit_const(offset_type, 0);
+   vcode_reg_t one_reg  = emit_const(offset_type, 1);
+
+   vcode_reg_t done_var =
+      emit_alloca(offset_type, offset_type, VCODE_INVALID_REG);
+
+   vcode_reg_t empty_reg = emit_cmp(VCODE_CMP_EQ, len0_reg, zero_reg);
+   emit_cond(empty_reg, exit_bb, first_bb);
+
+   vcode_select_block(first_bb);
+   lower_dyn_agg_store(mem_reg, def_reg, elem_type, multidim, stride);
+   emit_store_indirect(one_reg, done_var);
+   emit_jump(test_bb);
+
+   vcode_select_block(test_bb);
+   vcode_reg_t done_reg = emit_load_indirect(done_var);
+   vcode_reg_t more_reg = emit_cmp(VCODE_CMP_LT, done_reg, len0_reg);
+   emit_cond(more_reg, body_bb, exit_bb);
+
+   vcode_select_block(body_bb);
+   vcode_reg_t left_reg = emit_sub(len0_reg, done_reg);
+   vcode_reg_t n_reg =
+      emit_select(emit_cmp(VCODE_CMP_LT, done_reg, left_reg),
+                  done_reg, left_reg);
+
+   vcode_reg_t dest_reg, count_reg;
+   if (stride != VCODE_INVALID_REG) {
+      dest_reg  = emit_add(mem_reg, emit_mul(done_reg, stride));
+      count_reg = emit_mul(n_reg, stride);
+   }
+   else {
+      dest_reg  = emit_add(mem_reg, done_reg);
+      count_reg = n_reg;
+   }
+
+   emit_copy(dest_reg, mem_reg, count_reg);
+   emit_store_indirect(emit_add(done_reg, n_reg), done_var);
+   emit_jump(test_bb);
+
+   vcode_select_block(exit_bb);
+}
+
 static vcode_reg_t lower_dyn_aggregate(tree_t agg, type_t type)
 {
    type_t agg_type = tree_type(agg);
@@ -1996,7 +2176,7 @@ static vcode_reg_t lower_dyn_aggregate(tree_t agg, type_t type)
 
    if (can_use_memset) {
       if (bits <= 8)
-         emit_memset(mem_reg, lower_reify_expr(tree_value(agg0)), len_reg);
+         emit_memset(mem_reg, def_reg, len_reg);
       else {
          vcode_reg_t byte_reg  = emit_const(vtype_int(0, 255), byte);
          emit_memset(mem_reg, byte_reg,
@@ -2032,6 +2212,56 @@ static vcode_reg_t lower_dyn_aggregate(tree_t agg, type_t type)
    if (type_is_array(elem_type) || multidim)
       len0_reg = lower_array_len(agg_type, 0, VCODE_INVALID_REG);
 
+   if (lower_dyn_agg_can_fill(agg)) {
+      // Fill with the others value then store each remaining element
+      // once: the element values are also only evaluated once
+
+      if (def_value != NULL) {
+         if (def_reg == VCODE_INVALID_REG)
+            def_reg = lower_expr(def_value, EXPR_RVALUE);
+
+         lower_dyn_agg_fill(mem_reg, def_reg, elem_type, multidim,
+                            stride, len0_reg);
+      }
+
+      for (int i = 0; i < nassocs; i++) {
+         tree_t a = tree_assoc(agg, i);
+
+         vcode_reg_t off_reg;
+         switch (tree_subkind(a)) {
+         case A_POS:
+            off_reg = emit_const(offset_type, tree_pos(a));
+            break;
+
+         case A_NAMED:
+            {
+               vcode_reg_t name_reg   = lower_reify_expr(tree_name(a));
+               vcode_reg_t downto_reg = emit_sub(left_reg, name_reg);
+               vcode_reg_t upto_reg   = emit_sub(name_reg, left_reg);
+
+               off_reg = emit_cast(offset_type, VCODE_INVALID_TYPE,
+                                   emit_select(dir_reg, downto_reg, upto_reg));
+            }
+            break;
+
+         default:
+            continue;
+         }
+
+         if (stride != VCODE_INVALID_REG)
+            off_reg = emit_mul(off_reg, stride);
+
+         vcode_reg_t value_reg = lower_expr(tree_value(a), EXPR_RVALUE);
+         lower_dyn_agg_store(emit_add(mem_reg, off_reg), value_reg,
+                             elem_type, multidim, stride);
+      }
+
+      emit_comment("End dynamic aggregrate line %d",
+                   tree_loc(agg)->first_line);
+
+      return emit_wrap(mem_reg, &dim0, 1);
+   }
+
    vcode_block_t test_bb = emit_block();
    vcode_block_t body_bb = emit_block();
    vcode_block_t exit_bb = emit_block();
@@ -2122,19 +2352,7 @@ static vcode_reg_t lower_dyn_aggregate(tree_t agg, type_t type)
       i_stride = emit_mul(i_loaded, stride);
 
    vcode_reg_t ptr_reg = emit_add(mem_reg, i_stride);
-   if (type_is_array(elem_type)) {
-      vcode_reg_t src_reg = lower_array_data(what);
-      vcode_reg_t length_reg = lower_array_total_len(elem_type, what);
-      emit_copy(ptr_reg, src_reg, length_reg);
-   }
-   else if (multidim) {
-      vcode_reg_t src_reg = lower_array_data(what);
-      emit_copy(ptr_reg, src_reg, stride);
-   }
-   else if (type_is_record(elem_type))
-      emit_copy(ptr_reg, what, VCODE_INVALID_REG);
-   else
-      emit_store_indirect(lower_reify(what), ptr_reg);
+   lower_dyn_agg_store(ptr_reg, what, elem_type, multidim, stride);
 
    emit_store_indirect(emit_add(i_loaded, emit_const(offset_type, 1)), ivar);
    emit_jump(test_bb);
@@ -2578,8 +2796,20 @@ static vcode_reg_t lower_attr_ref(tree_t expr, expr_ctx_t ctx)
    case ATTR_IMAGE:
       {
          tree_t value = tree_value(tree_param(expr, 0));
+         vcode_reg_t arg = lower_param(value, NULL, PORT_IN);
+
+         type_t base = type_base_recur(tree_type(name));
+         if (type_is_enum(base))
+            return lower_enum_image(base, arg);
+
+         image_kind_t kind = IMAGE_GENERIC;
+         if (type_is_integer(base))
+            kind = IMAGE_INTEGER;
+         else if (type_is_real(base))
+            kind = IMAGE_REAL;
+
          tmp_alloc_used = true;
-         return emit_image(lower_param(value, NULL, PORT_IN), tree_index(name));
+         return emit_image(arg, kind, tree_index(name));
       }
 
    case ATTR_VALUE:
@@ -2760,7 +2990,7 @@ static bool lower_signal_sequential_nets(tree_t decl)
    return (i == nnets) && (nnets > 0);
 }
 
-static void lower_sched_event(tree_t on, bool is_static)
+static void lower_sched_event(tree_t on, bool is_static, uint32_t edge)
 {
    tree_kind_t expr_kind = tree_kind(on);
    if (expr_kind != T_REF && expr_kind != T_ARRAY_REF
@@ -2788,7 +3018,7 @@ static void lower_sched_event(tree_t on, bool is_static)
 
    tree_kind_t kind = tree_kind(decl);
    if (kind == T_ALIAS) {
-      lower_sched_event(tree_value(decl), is_static);
+      lower_sched_event(tree_value(decl), is_static, edge);
       return;
    }
    else if (kind != T_SIGNAL_DECL && kind != T_PORT_DECL) {
@@ -2851,7 +3081,8 @@ static void lower_sched_event(tree_t on, bool is_static)
 
    const int flags =
       (sequential ? SCHED_SEQUENTIAL : 0)
-      | (is_static ? SCHED_STATIC : 0);
+      | (is_static ? SCHED_STATIC : 0)
+      | (edge << SCHED_EDGE_SHIFT);
 
    emit_sched_event(nets, n_elems, flags);
 }
@@ -2868,9 +3099,11 @@ static void lower_wait(tree_t wait)
       vcode_select_block(0);
    }
 
+   const uint32_t edge = is_static ? tree_attr_int(wait, edge_i, 0) : 0;
+
    const int ntriggers = tree_triggers(wait);
    for (int i = 0; i < ntriggers; i++)
-      lower_sched_event(tree_trigger(wait, i), is_static);
+      lower_sched_event(tree_trigger(wait, i), is_static, edge);
 
    if (is_static)
       vcode_select_block(active_bb);
@@ -2930,7 +3163,7 @@ static void lower_wait(tree_t wait)
       if (!is_static) {
          const int ntriggers = tree_triggers(wait);
          for (int i = 0; i < ntriggers; i++)
-            lower_sched_event(tree_trigger(wait, i), is_static);
+            lower_sched_event(tree_trigger(wait, i), is_static, 0);
       }
 
       emit_wait(resume, timeout_reg);
@@ -3675,10 +3908,206 @@ static void lower_case_cleanup(case_state_t *state, bool root)
       free(state);
 }
 
+static int lower_case_key_cmp(const void *a, const void *b)
+{
+   const int64_t ka = *(const int64_t *)a, kb = *(const int64_t *)b;
+   return (ka > kb) - (ka < kb);
+}
+
+static bool lower_case_packed(tree_t stmt, loop_stack_t *loops)
+{
+   // Small constant width selectors are packed into an integer with
+   // the leftmost element in the most significant position so the
+   // whole case statement is a single switch. If the full range of
+   // each element does not fit but the choices only use two element
+   // values then pack one bit per element and send any other value
+   // such as a metavalue to the others branch.
+
+   type_t type = tree_type(tree_value(stmt));
+
+   int64_t width;
+   if (!folded_length(type_dim(type, 0), &width) || width <= 0)
+      return false;
+
+   vcode_type_t velem = lower_type(type_elem(type));
+   const int64_t elow  = vtype_low(velem);
+   const int64_t ehigh = vtype_high(velem);
+
+   int bits = ilog2(ehigh - elow + 1);
+   int64_t zero = elow, one = elow;
+   bool binary = false;
+
+   const int nassocs = tree_assocs(stmt);
+
+   if (width * bits > MAX_CASE_BITS) {
+      if (width > MAX_CASE_BITS)
+         return false;
+
+      int nvalues = 0;
+      int64_t values[2];
+      for (int i = 0; i < nassocs; i++) {
+         tree_t a = tree_assoc(stmt, i);
+         if (tree_subkind(a) != A_NAMED)
+            continue;
+
+         tree_t name = tree_name(a);
+         for (int64_t j = 0; j < width; j++) {
+            const int64_t elem = lower_case_find_choice_element(name, j);
+            if (nvalues > 0 && elem == values[0])
+               continue;
+            else if (nvalues > 1 && elem == values[1])
+               continue;
+            else if (nvalues == 2)
+               return false;
+
+            values[nvalues++] = elem;
+         }
+      }
+
+      if (nvalues == 0)
+         return false;
+
+      zero   = values[0];
+      one    = values[nvalues - 1];
+      bits   = 1;
+      binary = true;
+   }
+
+   int64_t *keys LOCAL = xmalloc(MAX(nassocs, 1) * sizeof(int64_t));
+   int nkeys = 0;
+   for (int i = 0; i < nassocs; i++) {
+      tree_t a = tree_assoc(stmt, i);
+      if (tree_subkind(a) != A_NAMED)
+         continue;
+
+      tree_t name = tree_name(a);
+      int64_t key = 0;
+      for (int64_t j = 0; j < width; j++) {
+         const int64_t elem = lower_case_find_choice_element(name, j);
+         key = (key << bits) | (binary ? (elem == one) : elem - elow);
+      }
+
+      keys[nkeys++] = key;
+   }
+
+   int64_t *sorted LOCAL = xmalloc(MAX(nkeys, 1) * sizeof(int64_t));
+   memcpy(sorted, keys, nkeys * sizeof(int64_t));
+   qsort(sorted, nkeys, sizeof(int64_t), lower_case_key_cmp);
+
+   for (int i = 1; i < nkeys; i++) {
+      if (sorted[i] == sorted[i - 1])
+         fatal_at(tree_loc(stmt), "duplicate choice in case statement");
+   }
+
+   emit_comment("Packed case on %"PRIi64" elements of %d bits", width, bits);
+
+   vcode_reg_t val = lower_expr(tree_value(stmt), EXPR_RVALUE);
+   vcode_reg_t data_ptr = lower_array_data(val);
+
+   vcode_type_t vkey = vtype_int(0, INT64_MAX);
+   vcode_reg_t scale_reg = emit_const(vkey, INT64_C(1) << bits);
+   vcode_reg_t key_reg = emit_const(vkey, 0);
+   vcode_reg_t meta_reg = emit_const(vtype_bool(), 0);
+
+   for (int64_t i = 0; i < width; i++) {
+      vcode_reg_t ptr_reg  = emit_add(data_ptr, emit_const(vtype_offset(), i));
+      vcode_reg_t elem_reg = lower_reify(ptr_reg);
+
+      vcode_reg_t code_reg;
+      if (binary) {
+         vcode_type_t vtype = vcode_reg_type(elem_reg);
+         vcode_reg_t is_one =
+            emit_cmp(VCODE_CMP_EQ, elem_reg, emit_const(vtype, one));
+         vcode_reg_t is_zero =
+            emit_cmp(VCODE_CMP_EQ, elem_reg, emit_const(vtype, zero));
+
+         meta_reg = emit_or(meta_reg, emit_not(emit_or(is_one, is_zero)));
+         code_reg = emit_select(is_one, emit_const(vkey, 1),
+                                emit_const(vkey, 0));
+      }
+      else
+         code_reg = emit_sub(emit_cast(vkey, VCODE_INVALID_TYPE, elem_reg),
+                             emit_const(vkey, elow));
+
+      key_reg = emit_add(emit_mul(key_reg, scale_reg), code_reg);
+   }
+
+   vcode_block_t exit_bb   = emit_block();
+   vcode_block_t others_bb = exit_bb;
+
+   int others_assoc = -1;
+   for (int i = 0; i < nassocs; i++) {
+      if (tree_subkind(tree_assoc(stmt, i)) == A_OTHERS) {
+         others_assoc = i;
+         others_bb = emit_block();
+      }
+   }
+
+   int64_t meta_const;
+   if (!vcode_reg_const(meta_reg, &meta_const) || meta_const) {
+      vcode_block_t switch_bb = emit_block();
+      emit_cond(meta_reg, others_bb, switch_bb);
+      vcode_select_block(switch_bb);
+   }
+
+   vcode_block_t *blocks LOCAL = xmalloc(MAX(nkeys, 1) * sizeof(vcode_block_t));
+   vcode_reg_t *cases LOCAL = xmalloc(MAX(nkeys, 1) * sizeof(vcode_reg_t));
+
+   tree_t last = NULL;
+   int cptr = 0;
+   for (int i = 0; i < nassocs; i++) {
+      tree_t a = tree_assoc(stmt, i);
+      if (tree_subkind(a) != A_NAMED)
+         continue;
+
+      tree_t value = tree_value(a);
+      blocks[cptr] = (value != last) ? emit_block() : blocks[cptr - 1];
+      cases[cptr]  = emit_const(vkey, keys[cptr]);
+      cptr++;
+
+      last = value;
+   }
+
+   emit_case(key_reg, others_bb, cases, blocks, nkeys);
+
+   last = NULL;
+   cptr = 0;
+   for (int i = 0; i < nassocs; i++) {
+      tree_t a = tree_assoc(stmt, i);
+      if (tree_subkind(a) != A_NAMED)
+         continue;
+
+      tree_t value = tree_value(a);
+      if (value != last) {
+         vcode_select_block(blocks[cptr]);
+         lower_stmt(value, loops);
+         if (!vcode_block_finished())
+            emit_jump(exit_bb);
+
+         last = value;
+      }
+
+      cptr++;
+   }
+
+   if (others_assoc != -1) {
+      vcode_select_block(others_bb);
+      lower_stmt(tree_value(tree_assoc(stmt, others_assoc)), loops);
+      if (!vcode_block_finished())
+         emit_jump(exit_bb);
+   }
+
+   vcode_select_block(exit_bb);
+   return true;
+}
+
 static void lower_case_array(tree_t stmt, loop_stack_t *loops)
 {
-   // Case staments on arrays are implemented by building a decision tree
-   // where each state is mapped to a basic block
+   if (lower_case_packed(stmt, loops))
+      return;
+
+   // Larger case staments on arrays are implemented by building a
+   // decision tree where each state is mapped to a basic block
 
    vcode_block_t exit_bb   = emit_block();
    vcode_block_t others_bb = exit_bb;
@@ -4101,6 +4530,9 @@ static void lower_decl(tree_t decl)
 
 static void lower_finished(void)
 {
+   if (opt_get_int("optimise") > 0)
+      vcode_opt_forward();
+
    vcode_opt();
 
    if (verbose != NULL) {
@@ -4520,12 +4952,153 @@ static void lower_driver_fn(tree_t t, void *_ctx)
    }
 }
 
+static bool lower_is_ref_to(tree_t expr, tree_t decl)
+{
+   return tree_kind(expr) == T_REF && tree_ref(expr) == decl;
+}
+
+static uint32_t lower_enum_mask(type_t type, const char *const *lits,
+                                int nlits)
+{
+   type_t base = type_base_recur(type);
+
+   uint32_t mask = 0;
+   const int nenum = type_enum_literals(base);
+   for (int i = 0; i < nenum; i++) {
+      tree_t lit = type_enum_literal(base, i);
+      for (int j = 0; j < nlits; j++) {
+         if (icmp(tree_ident(lit), lits[j])) {
+            if (i >= SCHED_EDGE_MAX)
+               return 0;
+            mask |= 1u << i;
+         }
+      }
+   }
+
+   return mask;
+}
+
+static uint32_t lower_edge_value(tree_t expr, tree_t decl)
+{
+   // Match sig = 'x' or 'x' = sig
+   if (tree_kind(expr) != T_FCALL || tree_params(expr) != 2)
+      return 0;
+
+   ident_t builtin = tree_attr_str(tree_ref(expr), builtin_i);
+   if (builtin == NULL || !icmp(builtin, "eq"))
+      return 0;
+
+   tree_t lhs = tree_value(tree_param(expr, 0));
+   tree_t rhs = tree_value(tree_param(expr, 1));
+
+   tree_t lit;
+   if (lower_is_ref_to(lhs, decl))
+      lit = rhs;
+   else if (lower_is_ref_to(rhs, decl))
+      lit = lhs;
+   else
+      return 0;
+
+   if (tree_kind(lit) != T_REF || tree_kind(tree_ref(lit)) != T_ENUM_LIT)
+      return 0;
+
+   const unsigned pos = tree_pos(tree_ref(lit));
+   return pos < SCHED_EDGE_MAX ? 1u << pos : 0;
+}
+
+static bool lower_is_event_attr(tree_t expr, tree_t decl)
+{
+   return tree_kind(expr) == T_ATTR_REF
+      && tree_attr_int(expr, builtin_i, -1) == ATTR_EVENT
+      && lower_is_ref_to(tree_name(expr), decl);
+}
+
+static uint32_t lower_edge_condition(tree_t cond, tree_t decl)
+{
+   // Return the set of values for decl which can make the condition
+   // true or zero if it is not a recognised edge test
+
+   if (tree_kind(cond) != T_FCALL)
+      return 0;
+
+   tree_t fdecl = tree_ref(cond);
+   ident_t builtin = tree_attr_str(fdecl, builtin_i);
+   const int nparams = tree_params(cond);
+
+   if (builtin != NULL && icmp(builtin, "and") && nparams == 2) {
+      tree_t a = tree_value(tree_param(cond, 0));
+      tree_t b = tree_value(tree_param(cond, 1));
+
+      if (lower_is_event_attr(a, decl))
+         return lower_edge_value(b, decl);
+      else if (lower_is_event_attr(b, decl))
+         return lower_edge_value(a, decl);
+      else
+         return 0;
+   }
+   else if (builtin == NULL && nparams == 1
+            && lower_is_ref_to(tree_value(tree_param(cond, 0)), decl)) {
+      static const char *const rising[] = { "'1'", "'H'" };
+      static const char *const falling[] = { "'0'", "'L'" };
+
+      ident_t name = tree_ident(fdecl);
+      type_t type = tree_type(decl);
+
+      if (icmp(name, "IEEE.STD_LOGIC_1164.RISING_EDGE")
+          || icmp(name, "IEEE.NUMERIC_BIT.RISING_EDGE"))
+         return lower_enum_mask(type, rising, ARRAY_LEN(rising));
+      else if (icmp(name, "IEEE.STD_LOGIC_1164.FALLING_EDGE")
+               || icmp(name, "IEEE.NUMERIC_BIT.FALLING_EDGE"))
+         return lower_enum_mask(type, falling, ARRAY_LEN(falling));
+   }
+
+   return 0;
+}
+
+static void lower_edge_sensitivity(tree_t proc)
+{
+   // Recognise a process which is only sensitive to a single clock and
+   // does nothing unless a particular edge occurred: the process need
+   // not be woken for the other edge
+
+   if (tree_stmts(proc) != 2)
+      return;
+
+   tree_t body = tree_stmt(proc, 0);
+   tree_t wait = tree_stmt(proc, 1);
+
+   if (tree_kind(body) != T_IF || tree_else_stmts(body) > 0)
+      return;
+
+   if (tree_kind(wait) != T_WAIT || !tree_attr_int(wait, static_i, 0)
+       || tree_triggers(wait) != 1)
+      return;
+
+   tree_t trigger = tree_trigger(wait, 0);
+   if (tree_kind(trigger) != T_REF)
+      return;
+
+   tree_t decl = tree_ref(trigger);
+   const tree_kind_t kind = tree_kind(decl);
+   if (kind != T_SIGNAL_DECL
+       && (kind != T_PORT_DECL || tree_class(decl) != C_SIGNAL))
+      return;
+
+   if (!type_is_enum(tree_type(decl)))
+      return;
+
+   const uint32_t edge = lower_edge_condition(tree_value(body), decl);
+   if (edge != 0)
+      tree_add_attr_int(wait, edge_i, edge);
+}
+
 static void lower_process(tree_t proc, vcode_unit_t context)
 {
    vcode_unit_t vu = emit_process(tree_ident(proc), context);
 
    lower_decls(proc, vu);
    tree_visit(proc, lower_driver_fn, proc);
+   lower_edge_sensitivity(proc);
 
    vcode_block_t reset_bb = vcode_active_block();
 
@@ -4550,7 +5123,7 @@ static void lower_process(tree_t proc, vcode_unit_t context)
    lower_cleanup(proc);
 }
 
-static void lower_elab(tree_t unit)
+static void lower_elab_context(tree_t unit)
 {
    vcode_unit_t context = emit_context(tree_ident(unit));
    tree_set_code(unit, context);
@@ -4560,12 +5133,17 @@ static void lower_elab(tree_t unit)
    emit_return(VCODE_INVALID_REG);
 
    lower_finished();
+}
+
+static void lower_elab(tree_t unit)
+{
+   lower_elab_context(unit);
 
    const int nstmts = tree_stmts(unit);
    for (int i = 0; i < nstmts; i++) {
       tree_t s = tree_stmt(unit, i);
       assert(tree_kind(s) == T_PROCESS);
-      lower_process(s, context);
+      lower_process(s, tree_code(unit));
    }
 
    lower_cleanup(unit);
@@ -4598,13 +5176,18 @@ static void lower_package(tree_t unit)
    lower_cleanup(unit);
 }
 
-void lower_unit(tree_t unit)
+static void lower_set_verbose(void)
 {
    const char *venv = getenv("NVC_LOWER_VERBOSE");
    if (venv != NULL)
       verbose = isalpha((int)venv[0]) || venv[0] == ':' ? venv : "";
    else
       verbose = opt_get_str("dump-vcode");
+}
+
+void lower_unit(tree_t unit)
+{
+   lower_set_verbose();
 
    switch (tree_kind(unit)) {
    case T_ELAB:
@@ -4623,3 +5206,67 @@ void lower_unit(tree_t unit)
 
    vcode_close();
 }
+
+static void lower_forget(tree_t body)
+{
+   // Detach the code from the body and anything nested inside it so
+   // the enclosing unit is lowered as normal later
+   const int ndecls = tree_decls(body);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(body, i);
+      const tree_kind_t kind = tree_kind(d);
+      if ((kind == T_FUNC_BODY || kind == T_PROC_BODY) && tree_has_code(d)) {
+         vcode_unit_t vu = tree_code(d);
+         lower_forget(d);
+         vcode_unit_unref(vu);
+      }
+   }
+
+   tree_set_code(body, NULL);
+}
+
+void lower_elab_begin(tree_t unit)
+{
+   assert(tree_kind(unit) == T_ELAB);
+
+   lower_set_verbose();
+   lower_elab_context(unit);
+   vcode_close();
+}
+
+vcode_unit_t lower_elab_process(tree_t unit, tree_t proc)
+{
+   assert(tree_kind(proc) == T_PROCESS);
+
+   lower_process(proc, tree_code(unit));
+   vcode_close();
+
+   return tree_code(proc);
+}
+
+void lower_elab_end(tree_t unit)
+{
+   lower_cleanup(unit);
+}
+
+void lower_release(tree_t body)
+{
+   vcode_unit_t vu = tree_code(body);
+   lower_forget(body);
+   vcode_unit_unref(vu);
+}
+
+vcode_unit_t lower_func(tree_t body)
+{
+   assert(tree_kind(body) == T_FUNC_BODY);
+   assert(!tree_has_code(body));
+
+   vcode_unit_t context = emit_context(tree_ident(body));
+   lower_func_body(body, context);
+
+   vcode_unit_t vu = tree_code(body);
+   lower_forget(body);
+
+   vcode_close();
+   return vu;
+}
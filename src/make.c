@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 typedef enum {
@@ -54,6 +55,22 @@ struct rule {
    ident_t       source;
 };
 
+typedef enum {
+   STEP_WAITING,
+   STEP_RUNNING,
+   STEP_DONE
+} step_state_t;
+
+typedef struct {
+   rule_t       *rule;
+   step_state_t  state;
+   bool          stale;
+   bool          rebuilt;
+   pid_t         pid;
+   int          *deps;
+   int           n_deps;
+} step_t;
+
 static ident_t make_tag_i;
 
 static lib_t make_get_lib(ident_t name)
@@ -402,17 +419,22 @@ static void make_add_target(ident_t name, int kind, void *context)
    *(*outp)++ = lib_get(lib_work(), name);
 }
 
+static tree_t *make_all_targets(int *count)
+{
+   lib_t work = lib_work();
+   *count = lib_index_size(work);
+   tree_t *targets = xmalloc(*count * sizeof(tree_t));
+   tree_t *outp = targets;
+   lib_walk_index(work, make_add_target, &outp);
+   return targets;
+}
+
 void make(tree_t *targets, int count, FILE *out)
 {
    make_tag_i = ident_new("make_tag");
 
-   if (count == 0) {
-      lib_t work = lib_work();
-      count = lib_index_size(work);
-      targets = xmalloc(count * sizeof(tree_t));
-      tree_t *outp = targets;
-      lib_walk_index(work, make_add_target, &outp);
-   }
+   if (count == 0)
+      targets = make_all_targets(&count);
 
    make_header(targets, count, out);
 
@@ -438,3 +460,208 @@ void make(tree_t *targets, int count, FILE *out)
 
    free(targets);
 }
+
+static lib_mtime_t make_mtime(const char *path)
+{
+   // Zero if the file does not exist
+   struct stat st;
+   if (stat(path, &st) != 0)
+      return 0;
+
+   lib_mtime_t mt = (lib_mtime_t)st.st_mtime * 1000 * 1000;
+#if defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+   mt += st.st_mtimespec.tv_nsec / 1000;
+#elif defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+   mt += st.st_mtim.tv_nsec / 1000;
+#endif
+   return mt;
+}
+
+static bool make_rule_produces(rule_t *r, ident_t file)
+{
+   for (ident_list_t *it = r->outputs; it != NULL; it = it->next) {
+      if (it->ident == file)
+         return true;
+   }
+
+   return false;
+}
+
+static bool make_rule_stale(rule_t *r)
+{
+   lib_mtime_t oldest = UINT64_MAX;
+   for (ident_list_t *it = r->outputs; it != NULL; it = it->next) {
+      const lib_mtime_t mt = make_mtime(istr(it->ident));
+      if (mt == 0)
+         return true;
+      oldest = MIN(oldest, mt);
+   }
+
+   for (ident_list_t *it = r->inputs; it != NULL; it = it->next) {
+      if (!make_rule_produces(r, it->ident)
+          && make_mtime(istr(it->ident)) > oldest)
+         return true;
+   }
+
+   return false;
+}
+
+static void make_step_deps(step_t *steps, int n_steps, step_t *s)
+{
+   // A step waits for every other step which produces one of its inputs
+   int max_deps = 4;
+   s->deps = xmalloc(max_deps * sizeof(int));
+
+   for (int i = 0; i < n_steps; i++) {
+      if (&(steps[i]) == s)
+         continue;
+
+      for (ident_list_t *it = s->rule->inputs; it != NULL; it = it->next) {
+         if (make_rule_produces(steps[i].rule, it->ident)) {
+            ARRAY_APPEND(s->deps, i, s->n_deps, max_deps);
+            break;
+         }
+      }
+   }
+}
+
+static pid_t make_start_step(step_t *s, make_cmd_fn_t fn)
+{
+   const char *argv[5] = { PACKAGE };
+   int argc = 1;
+
+   switch (s->rule->kind) {
+   case RULE_ANALYSE:
+      notef("analysing %s", istr(s->rule->source));
+      argv[argc++] = "-a";
+      break;
+   case RULE_ELABORATE:
+      notef("elaborating %s", istr(s->rule->source));
+      argv[argc++] = "-e";
+      if (opt_get_int("native"))
+         argv[argc++] = "--native";
+      break;
+   }
+
+   argv[argc++] = istr(s->rule->source);
+   argv[argc] = NULL;
+
+   fflush(stdout);
+   fflush(stderr);
+
+   // The child inherits every library already loaded by this process
+   // rather than reading them again from disk
+   pid_t pid = fork();
+   if (pid < 0)
+      fatal_errno("fork");
+   else if (pid == 0)
+      exit((*fn)(argc, (char **)argv));
+
+   return pid;
+}
+
+int make_build(tree_t *targets, int count, int jobs, make_cmd_fn_t fn)
+{
+   make_tag_i = ident_new("make_tag");
+
+   if (count == 0)
+      targets = make_all_targets(&count);
+
+   rule_t *rules = NULL;
+   for (int i = 0; i < count; i++)
+      make_rule(targets[i], &rules);
+
+   int n_steps = 0;
+   for (rule_t *r = rules; r != NULL; r = r->next)
+      n_steps++;
+
+   step_t *steps = xcalloc(MAX(n_steps, 1) * sizeof(step_t));
+
+   int n = 0;
+   for (rule_t *r = rules; r != NULL; r = r->next, n++) {
+      steps[n].rule  = r;
+      steps[n].state = STEP_WAITING;
+      steps[n].stale = make_rule_stale(r);
+   }
+
+   for (int i = 0; i < n_steps; i++)
+      make_step_deps(steps, n_steps, &(steps[i]));
+
+   int running = 0, finished = 0, rebuilt = 0;
+   bool failed = false;
+
+   while (finished < n_steps) {
+      bool progress = false;
+
+      for (int i = 0; i < n_steps && running < jobs && !failed; i++) {
+         step_t *s = &(steps[i]);
+         if (s->state != STEP_WAITING)
+            continue;
+
+         bool ready = true;
+         for (int j = 0; j < s->n_deps && ready; j++) {
+            const step_t *d = &(steps[s->deps[j]]);
+            ready = (d->state == STEP_DONE);
+            s->stale |= d->rebuilt;
+         }
+
+         if (!ready)
+            continue;
+
+         progress = true;
+
+         if (s->stale) {
+            s->pid   = make_start_step(s, fn);
+            s->state = STEP_RUNNING;
+            running++;
+         }
+         else {
+            s->state = STEP_DONE;
+            finished++;
+         }
+      }
+
+      if (running == 0) {
+         if (failed)
+            break;
+         else if (!progress)
+            fatal("circular dependency between design units");
+         else
+            continue;
+      }
+
+      int status;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+         fatal_errno("waitpid");
+
+      for (int i = 0; i < n_steps; i++) {
+         step_t *s = &(steps[i]);
+         if (s->state == STEP_RUNNING && s->pid == pid) {
+            s->state   = STEP_DONE;
+            s->rebuilt = true;
+            running--;
+            finished++;
+            rebuilt++;
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+               failed = true;
+         }
+      }
+
+      // Later steps must see the units written by this one
+      lib_refresh(lib_work());
+   }
+
+   if (!failed && opt_get_int("verbose"))
+      notef("rebuilt %d of %d steps", rebuilt, n_steps);
+
+   for (int i = 0; i < n_steps; i++)
+      free(steps[i].deps);
+   free(steps);
+
+   make_free_rules(rules);
+   free(targets);
+
+   return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -18,13 +18,18 @@
 #include "util.h"
 #include "phase.h"
 #include "common.h"
+#include "vcode.h"
 #include "rt/rt.h"
+#include "rt/cover.h"
 
 #include <unistd.h>
 #include <getopt.h>
+#include <errno.h>
+#include <sys/wait.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include <assert.h>
 #if defined HAVE_TCL_TCL_H
 #include <tcl/tcl.h>
@@ -43,6 +48,7 @@ const char *version_string =
 static ident_t top_level = NULL;
 
 static int process_command(int argc, char **argv);
+static int parse_int(const char *str);
 
 static ident_t to_unit_name(const char *str)
 {
@@ -88,10 +94,21 @@ static unsigned parse_relax(const char *str)
    return mask;
 }
 
+static int parse_phase_stats(const char *str)
+{
+   if (str == NULL)
+      return STATS_SUMMARY;
+   else if (strcmp(str, "json") == 0)
+      return STATS_JSON;
+   else
+      fatal("invalid statistics format: %s", str);
+}
+
 static int scan_cmd(int start, int argc, char **argv)
 {
    const char *commands[] = {
-      "-a", "-e", "-r", "--codegen", "--dump", "--make", "--syntax", "--list"
+      "-a", "-e", "-r", "--codegen", "--dump", "--make", "--syntax", "--list",
+      "--cover-merge"
    };
 
    for (int i = start; i < argc; i++) {
@@ -104,20 +121,256 @@ static int scan_cmd(int start, int argc, char **argv)
    return argc;
 }
 
+typedef enum {
+   JOB_WAITING, JOB_RUNNING, JOB_DONE
+} job_state_t;
+
+typedef struct {
+   const char   *file;
+   tree_t       *units;
+   int           n_units;
+   ident_list_t *defines;
+   ident_list_t *needs;
+   job_state_t   state;
+   pid_t         pid;
+} analyse_job_t;
+
+static ident_t analyse_work_unit(ident_t name)
+{
+   // Map a selected name in the work library to a unit name
+   char *str = strdup(istr(name));
+   char *dot = strchr(str, '.');
+
+   ident_t result = NULL;
+   if (dot != NULL) {
+      *dot = '\0';
+      if (strcmp(str, "WORK") == 0 || icmp(lib_name(lib_work()), str)) {
+         char *end = strchr(dot + 1, '.');
+         if (end != NULL)
+            *end = '\0';
+         result = ident_prefix(lib_name(lib_work()), ident_new(dot + 1), '.');
+      }
+   }
+
+   free(str);
+   return result;
+}
+
+static void analyse_need_use(tree_t t, void *context)
+{
+   ident_t name = analyse_work_unit(tree_ident(t));
+   if (name != NULL)
+      ident_list_add((ident_list_t **)context, name);
+}
+
+static void analyse_need_instance(tree_t t, void *context)
+{
+   if (tree_class(t) != C_COMPONENT) {
+      ident_t name = analyse_work_unit(tree_ident2(t));
+      if (name != NULL)
+         ident_list_add((ident_list_t **)context, name);
+   }
+}
+
+static void analyse_job_deps(analyse_job_t *job)
+{
+   // Find the units defined by a file and the units in the work
+   // library it refers to from the parse trees alone
+   ident_t lname = lib_name(lib_work());
+
+   for (int i = 0; i < job->n_units; i++) {
+      tree_t unit = job->units[i];
+      ident_t qual = ident_prefix(lname, tree_ident(unit), '.');
+
+      switch (tree_kind(unit)) {
+      case T_ARCH:
+         {
+            ident_t ent = ident_prefix(lname, tree_ident2(unit), '.');
+            ident_list_add(&(job->needs), ent);
+            ident_list_add(&(job->defines),
+                           ident_prefix(ent, tree_ident(unit), '-'));
+         }
+         break;
+
+      case T_PACK_BODY:
+         ident_list_add(&(job->needs), qual);
+         ident_list_add(&(job->defines),
+                        ident_prefix(qual, ident_new("body"), '-'));
+         break;
+
+      case T_CONFIG:
+         ident_list_add(&(job->needs),
+                        ident_prefix(lname, tree_ident2(unit), '.'));
+         ident_list_add(&(job->defines), qual);
+         break;
+
+      default:
+         ident_list_add(&(job->defines), qual);
+         break;
+      }
+
+      tree_visit_only(unit, analyse_need_use, &(job->needs), T_USE);
+      tree_visit_only(unit, analyse_need_use, &(job->needs), T_CTXREF);
+      tree_visit_only(unit, analyse_need_instance, &(job->needs),
+                      T_INSTANCE);
+   }
+}
+
+static bool analyse_unit_match(ident_t need, ident_t unit)
+{
+   // An entity name also matches each of its architectures
+   const char *n = istr(need);
+   const size_t len = strlen(n);
+   const char *u = istr(unit);
+   return strncmp(n, u, len) == 0 && (u[len] == '\0' || u[len] == '-');
+}
+
+static bool analyse_lists_overlap(ident_list_t *needs, ident_list_t *units)
+{
+   for (ident_list_t *n = needs; n != NULL; n = n->next) {
+      for (ident_list_t *u = units; u != NULL; u = u->next) {
+         if (analyse_unit_match(n->ident, u->ident))
+            return true;
+      }
+   }
+
+   return false;
+}
+
+static bool analyse_conflict(analyse_job_t *a, analyse_job_t *b)
+{
+   return analyse_lists_overlap(a->needs, b->defines)
+      || analyse_lists_overlap(b->needs, a->defines)
+      || analyse_lists_overlap(a->defines, b->defines);
+}
+
+static bool analyse_job_units(analyse_job_t *job)
+{
+   tree_t *checked LOCAL = xmalloc(sizeof(tree_t) * MAX(job->n_units, 1));
+   int n_checked = 0;
+
+   for (int i = 0; i < job->n_units && sem_check(job->units[i]); i++)
+      checked[n_checked++] = job->units[i];
+
+   for (int i = 0; i < n_checked; i++) {
+      simplify(checked[i]);
+      bounds_check(checked[i]);
+   }
+
+   if (sem_errors() + bounds_errors() > 0)
+      return false;
+
+   lib_save_units(lib_work());
+
+   for (int i = 0; i < n_checked; i++) {
+      tree_kind_t kind = tree_kind(checked[i]);
+      const bool need_cgen =
+         (kind == T_PACK_BODY)
+         || ((kind == T_PACKAGE) && pack_needs_cgen(checked[i]));
+      if (need_cgen) {
+         lower_unit(checked[i]);
+         cgen(checked[i]);
+      }
+   }
+
+   return true;
+}
+
+static int analyse_parallel(analyse_job_t *jobs, int n_jobs, int max_procs)
+{
+   // Each file is checked in a child process once every earlier file
+   // it shares a unit with has finished so each child sees the library
+   // exactly as a serial run would
+   for (int i = 0; i < n_jobs; i++)
+      analyse_job_deps(&(jobs[i]));
+
+   int running = 0, finished = 0;
+   bool failed = false;
+
+   while (finished < n_jobs) {
+      for (int i = 0; i < n_jobs && running < max_procs && !failed; i++) {
+         if (jobs[i].state != JOB_WAITING)
+            continue;
+
+         bool ready = true;
+         for (int j = 0; j < i && ready; j++) {
+            if (jobs[j].state != JOB_DONE)
+               ready = !analyse_conflict(&jobs[i], &jobs[j]);
+         }
+
+         if (!ready)
+            continue;
+
+         fflush(stdout);
+         fflush(stderr);
+
+         pid_t pid = fork();
+         if (pid < 0)
+            fatal_errno("fork");
+         else if (pid == 0)
+            exit(analyse_job_units(&jobs[i]) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+         jobs[i].pid   = pid;
+         jobs[i].state = JOB_RUNNING;
+         running++;
+      }
+
+      if (running == 0)
+         break;
+
+      int status;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0)
+         fatal_errno("waitpid");
+
+      for (int i = 0; i < n_jobs; i++) {
+         if (jobs[i].state == JOB_RUNNING && jobs[i].pid == pid) {
+            jobs[i].state = JOB_DONE;
+            running--;
+            finished++;
+
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+               failed = true;
+         }
+      }
+   }
+
+   if (failed)
+      return EXIT_FAILURE;
+
+   // Load the new units in the same order as a serial run so the
+   // index is written identically
+   for (int i = 0; i < n_jobs; i++) {
+      for (ident_list_t *it = jobs[i].defines; it != NULL; it = it->next) {
+         if (lib_get(lib_work(), it->ident) == NULL)
+            fatal("unit %s missing after analysis", istr(it->ident));
+      }
+   }
+
+   lib_save(lib_work());
+   return EXIT_SUCCESS;
+}
+
 static int analyse(int argc, char **argv)
 {
    static struct option long_options[] = {
       { "bootstrap",       no_argument,       0, 'b' },
       { "dump-llvm",       no_argument,       0, 'D' },
       { "dump-vcode",      optional_argument, 0, 'v' },
+      { "jobs",            required_argument, 0, 'j' },
       { "prefer-explicit", no_argument,       0, 'p' },   // DEPRECATED
       { "relax",           required_argument, 0, 'R' },
+      { "stats",           optional_argument, 0, 'S' },
       { 0, 0, 0, 0 }
    };
 
    const int next_cmd = scan_cmd(2, argc, argv);
-   int c, index = 0;
-   const char *spec = "";
+   int c, index = 0, n_procs = 1;
+
+   // Statistics are only printed for the commands that ask for them
+   opt_set_int("phase-stats", STATS_NONE);
+
+   const char *spec = "j:";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 0:
@@ -125,6 +378,10 @@ static int analyse(int argc, char **argv)
          break;
       case '?':
          fatal("unrecognised analyse option %s", argv[optind - 1]);
+      case 'j':
+         if ((n_procs = parse_int(optarg)) < 1)
+            fatal("number of jobs must be at least one");
+         break;
       case 'b':
          opt_set_int("bootstrap", 1);
          break;
@@ -142,11 +399,62 @@ static int analyse(int argc, char **argv)
       case 'R':
          opt_set_int("relax", parse_relax(optarg));
          break;
+      case 'S':
+         opt_set_int("phase-stats", parse_phase_stats(optarg));
+         break;
       default:
          abort();
       }
    }
 
+   const int stats = opt_get_int("phase-stats");
+
+   if (n_procs > 1 && next_cmd - optind > 1) {
+      const int n_jobs = next_cmd - optind;
+      analyse_job_t *jobs LOCAL = xcalloc(sizeof(analyse_job_t) * n_jobs);
+
+      for (int i = 0; i < n_jobs; i++) {
+         analyse_job_t *job = &(jobs[i]);
+         job->file = argv[optind + i];
+         input_from_file(job->file);
+
+         size_t alloc = 8;
+         job->units = xmalloc(sizeof(tree_t) * alloc);
+
+         stats_phase_begin("parse");
+
+         tree_t unit;
+         while ((unit = parse()))
+            ARRAY_APPEND(job->units, unit, job->n_units, alloc);
+
+         stats_phase_end();
+      }
+
+      int status = EXIT_FAILURE;
+      if (parse_errors() == 0) {
+         stats_phase_begin("analyse jobs");
+         status = analyse_parallel(jobs, n_jobs, n_procs);
+         stats_phase_end();
+      }
+
+      if (stats != STATS_NONE)
+         stats_phase_report(stats == STATS_JSON);
+
+      for (int i = 0; i < n_jobs; i++) {
+         free(jobs[i].units);
+         ident_list_free(jobs[i].needs);
+         ident_list_free(jobs[i].defines);
+      }
+
+      if (status != EXIT_SUCCESS)
+         return status;
+
+      argc -= next_cmd - 1;
+      argv += next_cmd - 1;
+
+      return argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS;
+   }
+
    size_t unit_list_sz = 32;
    tree_t *units LOCAL = xmalloc(sizeof(tree_t) * unit_list_sz);
    int n_units = 0;
@@ -154,14 +462,33 @@ static int analyse(int argc, char **argv)
    for (int i = optind; i < next_cmd; i++) {
       input_from_file(argv[i]);
 
-      tree_t unit;
-      while ((unit = parse()) && sem_check(unit))
+      for (;;) {
+         stats_phase_begin("parse");
+         tree_t unit = parse();
+         stats_phase_end();
+
+         if (unit == NULL)
+            break;
+
+         stats_phase_begin("sem");
+         const bool ok = sem_check(unit);
+         stats_phase_end();
+
+         if (!ok)
+            break;
+
          ARRAY_APPEND(units, unit, n_units, unit_list_sz);
+      }
    }
 
    for (int i = 0; i < n_units; i++) {
+      stats_phase_begin("simp");
       simplify(units[i]);
+      stats_phase_end();
+
+      stats_phase_begin("bounds");
       bounds_check(units[i]);
+      stats_phase_end();
    }
 
    if (parse_errors() + sem_errors() + bounds_errors() > 0)
@@ -176,15 +503,25 @@ static int analyse(int argc, char **argv)
          units[i] = NULL;
    }
 
+   stats_phase_begin("save");
    lib_save(lib_work());
+   stats_phase_end();
 
    for (int i = 0; i < n_units; i++) {
       if (units[i] != NULL) {
+         stats_phase_begin("lower");
          lower_unit(units[i]);
+         stats_phase_end();
+
+         stats_phase_begin("cgen");
          cgen(units[i]);
+         stats_phase_end();
       }
    }
 
+   if (stats != STATS_NONE)
+      stats_phase_report(stats == STATS_JSON);
+
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
 
@@ -242,15 +579,26 @@ static int elaborate(int argc, char **argv)
       { "dump-llvm",   no_argument,       0, 'd' },
       { "dump-vcode",  optional_argument, 0, 'v' },
       { "native",      no_argument,       0, 'n' },
-      { "cover",       no_argument,       0, 'c' },
+      { "cover",       optional_argument, 0, 'c' },
       { "verbose",     no_argument,       0, 'V' },
+      { "no-cache",    no_argument,       0, 'C' },
+      { "jobs",        required_argument, 0, 'j' },
+      { "time-passes", no_argument,       0, 'T' },
+      { "pgo-use",     required_argument, 0, 'u' },
+      { "stats",       optional_argument, 0, 'S' },
+      { "prune",       no_argument,       0, 'P' },
+      { "fuse",        no_argument,       0, 'F' },
       { 0, 0, 0, 0 }
    };
 
    const int next_cmd = scan_cmd(2, argc, argv);
-   bool verbose = false;
+   bool verbose = false, use_cache = true;
    int c, index = 0;
-   const char *spec = "Vg:";
+
+   // Statistics are only printed for the commands that ask for them
+   opt_set_int("phase-stats", STATS_NONE);
+
+   const char *spec = "Vg:j:O:";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 'o':
@@ -266,7 +614,14 @@ static int elaborate(int argc, char **argv)
          opt_set_int("native", 1);
          break;
       case 'c':
-         opt_set_int("cover", 1);
+         if (optarg == NULL)
+            opt_set_int("cover", COVER_COUNT);
+         else if (strcmp(optarg, "bitmap") == 0)
+            opt_set_int("cover", COVER_BITMAP);
+         else if (strcmp(optarg, "once") == 0)
+            opt_set_int("cover", COVER_ONCE);
+         else
+            fatal("invalid coverage mode: %s", optarg);
          break;
       case 'V':
          verbose = true;
@@ -275,6 +630,41 @@ static int elaborate(int argc, char **argv)
       case 'g':
          parse_generic(optarg);
          break;
+      case 'C':
+         use_cache = false;
+         opt_set_int("code-cache", 0);
+         break;
+      case 'O':
+         {
+            const int level = parse_int(optarg);
+            if (level < 0 || level > 3)
+               fatal("optimisation level must be between 0 and 3");
+            opt_set_int("optimise", level);
+         }
+         break;
+      case 'T':
+         opt_set_int("time-passes", 1);
+         break;
+      case 'u':
+         opt_set_str("pgo-use", optarg);
+         break;
+      case 'S':
+         opt_set_int("phase-stats", parse_phase_stats(optarg));
+         break;
+      case 'P':
+         opt_set_int("prune", 1);
+         break;
+      case 'F':
+         opt_set_int("fuse", 1);
+         break;
+      case 'j':
+         {
+            const int jobs = parse_int(optarg);
+            if (jobs < 1)
+               fatal("number of jobs must be at least one");
+            opt_set_int("elab-jobs", jobs);
+         }
+         break;
       case 0:
          // Set a flag
          break;
@@ -296,29 +686,77 @@ static int elaborate(int argc, char **argv)
 
    elab_verbose(verbose, "loading top-level unit");
 
+   // Dumping intermediate output requires generating it again and the
+   // contents of a profile may have changed since the last build
+   if (use_cache && !opt_get_int("dump-llvm")
+       && opt_get_str("dump-vcode") == NULL
+       && opt_get_str("pgo-use") == NULL) {
+      tree_t e = elab_cached(unit);
+      if (e != NULL && link_up_to_date(e)) {
+         elab_verbose(verbose, "design is up to date");
+
+         argc -= next_cmd - 1;
+         argv += next_cmd - 1;
+
+         return argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS;
+      }
+   }
+
+   // The elaborated design is only freed on exit so allocate it from an
+   // arena rather than the garbage collected heap
+   tree_arena_t prev_arena = tree_arena_select(tree_arena_new());
+
+   stats_phase_begin("elab");
    tree_t e = elab(unit);
+   stats_phase_end();
+
    if (e == NULL)
       return EXIT_FAILURE;
 
    elab_verbose(verbose, "elaborating design");
 
+   stats_phase_begin("group nets");
    group_nets(e);
+   stats_phase_end();
    elab_verbose(verbose, "grouping nets");
 
+   tree_arena_select(prev_arena);
+
    // Save the library now so the code generator can attach temporary
    // meta data to trees
+   stats_phase_begin("save");
    lib_save(lib_work());
+   stats_phase_end();
    elab_verbose(verbose, "saving library");
 
-   lower_unit(e);
+   // Each process is lowered to vcode by the code generator just
+   // before it is needed so the vcode for the whole design is never
+   // held in memory at once
+   stats_phase_begin("lower");
+   lower_elab_begin(e);
+   stats_phase_end();
    elab_verbose(verbose, "generating intermediate code");
 
+   stats_phase_begin("cgen");
    cgen(e);
+   lower_elab_end(e);
+   stats_phase_end();
    elab_verbose(verbose, "generating LLVM");
 
+   const int stats = opt_get_int("phase-stats");
+   if (stats == STATS_SUMMARY) {
+      notef("elided %u bounds and index checks", vcode_elided_checks());
+      notef("at most %u vcode units live at once", vcode_peak_units());
+   }
+
+   stats_phase_begin("link");
    link_bc(e);
+   stats_phase_end();
    elab_verbose(verbose, "linking");
 
+   if (stats != STATS_NONE)
+      stats_phase_report(stats == STATS_JSON);
+
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
 
@@ -414,6 +852,154 @@ static rt_severity_t parse_severity(const char *str)
       fatal("invalid severity level: %s", str);
 }
 
+static void apply_job_options(char *line, uint64_t *stop_time, bool apply)
+{
+   char *save = NULL;
+   for (char *tok = strtok_r(line, " \t\r\n", &save); tok != NULL;
+        tok = strtok_r(NULL, " \t\r\n", &save)) {
+      char *eq = strchr(tok, '=');
+      if (strncmp(tok, "--stop-time=", 12) == 0)
+         *stop_time = parse_time(tok + 12);
+      else if (strncmp(tok, "--exit-severity=", 16) == 0) {
+         const rt_severity_t s = parse_severity(tok + 16);
+         if (apply)
+            rt_set_exit_severity(s);
+      }
+      else if (*tok != '-' && eq != NULL && eq != tok) {
+         if (apply) {
+            *eq = '\0';
+            setenv(tok, eq + 1, 1);
+         }
+      }
+      else
+         fatal("invalid job option %s", tok);
+   }
+}
+
+static bool run_one_job(tree_t e, const char *line, int lineno,
+                        uint64_t stop_time)
+{
+   // Each job is a copy-on-write fork of the initialised design with
+   // its own stop time, exit severity, and environment variables which
+   // VHPI plugins can read to choose seeds or test variants
+
+   char *copy LOCAL = strdup(line);
+   apply_job_options(copy, &stop_time, false);
+
+   fflush(stdout);
+   fflush(stderr);
+
+   const pid_t pid = fork();
+   if (pid < 0)
+      fatal_errno("fork");
+   else if (pid == 0) {
+      char *child_copy = strdup(line);
+      apply_job_options(child_copy, &stop_time, true);
+
+      rt_run_sim(stop_time);
+      rt_end_of_tool(e);
+      exit(EXIT_SUCCESS);
+   }
+
+   int status;
+   while (waitpid(pid, &status, 0) != pid) {
+      if (errno != EINTR)
+         fatal_errno("waitpid");
+   }
+
+   if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+      return true;
+   else if (WIFEXITED(status)) {
+      errorf("job on line %d failed with status %d", lineno,
+             WEXITSTATUS(status));
+      return false;
+   }
+   else {
+      errorf("job on line %d terminated by signal %d", lineno,
+             WTERMSIG(status));
+      return false;
+   }
+}
+
+static bool run_jobs(tree_t e, const char *file, uint64_t stop_time)
+{
+   FILE *f = fopen(file, "r");
+   if (f == NULL)
+      fatal_errno("failed to open %s", file);
+
+   int lineno = 0, njobs = 0, nfailed = 0;
+   char *line = NULL;
+   size_t linesz = 0;
+   while (getline(&line, &linesz, f) != -1) {
+      lineno++;
+
+      const char *p = line;
+      while (isspace((int)*p))
+         p++;
+
+      if (*p == '\0' || *p == '#')
+         continue;
+
+      njobs++;
+      if (!run_one_job(e, line, lineno, stop_time))
+         nfailed++;
+   }
+
+   free(line);
+   fclose(f);
+
+   notef("%d jobs run, %d failed", njobs, nfailed);
+   return nfailed == 0;
+}
+
+static int parse_size(const char *str)
+{
+   char *eptr = NULL;
+   const long long value = strtoll(str, &eptr, 0);
+
+   long long mult = 1;
+   if (*eptr == 'k' || *eptr == 'K')
+      mult = 1024, eptr++;
+   else if (*eptr == 'm' || *eptr == 'M')
+      mult = 1024 * 1024, eptr++;
+
+   if ((*eptr != '\0') || (value < 0) || (value * mult > INT_MAX))
+      fatal("invalid size: %s", str);
+
+   return value * mult;
+}
+
+static void parse_fst_options(const char *str)
+{
+   char *copy LOCAL = strdup(str);
+
+   for (char *token = strtok(copy, ","); token != NULL;
+        token = strtok(NULL, ",")) {
+      char *value = strchr(token, '=');
+      if (value != NULL)
+         *value++ = '\0';
+
+      if (strcmp(token, "pack") == 0 && value != NULL) {
+         if (strcmp(value, "zlib") == 0)
+            opt_set_int("fst-pack", 0);
+         else if (strcmp(value, "fastlz") == 0)
+            opt_set_int("fst-pack", 1);
+         else if (strcmp(value, "lz4") == 0)
+            opt_set_int("fst-pack", 2);
+         else
+            fatal("invalid FST pack type '%s'", value);
+      }
+      else if (strcmp(token, "parallel") == 0 && value == NULL)
+         opt_set_int("fst-parallel", 1);
+      else if (strcmp(token, "no-repack") == 0 && value == NULL)
+         opt_set_int("fst-repack", 0);
+      else if (strcmp(token, "block") == 0 && value != NULL)
+         opt_set_int("fst-block", parse_size(value));
+      else
+         fatal("invalid FST option '%s'", token);
+   }
+}
+
 static int run(int argc, char **argv)
 {
    static struct option long_options[] = {
@@ -421,26 +1007,48 @@ static int run(int argc, char **argv)
       { "batch",         no_argument,       0, 'b' },
       { "command",       no_argument,       0, 'c' },
       { "stop-time",     required_argument, 0, 's' },
-      { "stats",         no_argument,       0, 'S' },
+      { "stats",         optional_argument, 0, 'S' },
       { "wave",          optional_argument, 0, 'w' },
       { "stop-delta",    required_argument, 0, 'd' },
       { "format",        required_argument, 0, 'f' },
       { "include",       required_argument, 0, 'i' },
       { "exclude",       required_argument, 0, 'e' },
       { "exit-severity", required_argument, 0, 'x' },
+      { "threads",       required_argument, 0, 'H' },
+      { "cycle-based",   no_argument,       0, 'C' },
+      { "jobs",          required_argument, 0, 'J' },
+      { "lazy-jit",      no_argument,       0, 'Z' },
+      { "checkpoint-at", required_argument, 0, 'K' },
+      { "profile",       no_argument,       0, 'P' },
+      { "huge-pages",    optional_argument, 0, 'G' },
+      { "wave-async",    no_argument,       0, 'A' },
+      { "fst-options",   required_argument, 0, 'F' },
+      { "wave-start",    required_argument, 0, 'W' },
+      { "wave-stop",     required_argument, 0, 'E' },
+      { "wave-depth",    required_argument, 0, 'D' },
+      { "cover-db",      required_argument, 0, 'B' },
+      { "pgo-collect",   required_argument, 0, 'Q' },
+      { "listen",        required_argument, 0, 'L' },
+      { "activity",      required_argument, 0, 'a' },
+      { "perf-map",      no_argument,       0, 'M' },
 #if ENABLE_VHPI
       { "load",          required_argument, 0, 'l' },
       { "vhpi-trace",    no_argument,       0, 'T' },
+      { "vhpi-async-lag", required_argument, 0, 'V' },
 #endif
       { 0, 0, 0, 0 }
    };
 
-   enum { BATCH, COMMAND } mode = BATCH;
+   enum { BATCH, COMMAND, LISTEN } mode = BATCH;
    enum { LXT, FST, VCD} wave_fmt = FST;
 
    uint64_t stop_time = UINT64_MAX;
+   uint64_t checkpoint_at = 0;
+   uint64_t wave_start = 0, wave_stop = UINT64_MAX;
    const char *wave_fname = NULL;
    const char *vhpi_plugins = NULL;
+   const char *job_file = NULL;
+   const char *listen_addr = NULL;
 
    static bool have_run = false;
    if (have_run)
@@ -485,7 +1093,14 @@ static int run(int argc, char **argv)
             fatal("invalid waveform format: %s", optarg);
          break;
       case 'S':
-         opt_set_int("rt-stats", 1);
+         if (optarg == NULL)
+            opt_set_int("rt-stats", STATS_SUMMARY);
+         else if (strcmp(optarg, "detail") == 0)
+            opt_set_int("rt-stats", STATS_DETAIL);
+         else if (strcmp(optarg, "json") == 0)
+            opt_set_int("rt-stats", STATS_JSON);
+         else
+            fatal("invalid statistics format: %s", optarg);
          break;
       case 'w':
          if (optarg == NULL)
@@ -508,11 +1123,96 @@ static int run(int argc, char **argv)
       case 'x':
          rt_set_exit_severity(parse_severity(optarg));
          break;
+      case 'H':
+         opt_set_int("rt-threads", parse_int(optarg));
+         break;
+      case 'C':
+         opt_set_int("cycle-based", 1);
+         break;
+      case 'J':
+         job_file = optarg;
+         break;
+      case 'Z':
+         opt_set_int("lazy-jit", 1);
+         break;
+      case 'K':
+         checkpoint_at = parse_time(optarg);
+         break;
+      case 'P':
+         opt_set_int("rt-profile", 1);
+         break;
+      case 'A':
+         opt_set_int("wave-async", 1);
+         break;
+      case 'F':
+         parse_fst_options(optarg);
+         break;
+      case 'W':
+         wave_start = parse_time(optarg);
+         break;
+      case 'E':
+         wave_stop = parse_time(optarg);
+         break;
+      case 'D':
+         wave_set_depth(parse_int(optarg));
+         break;
+      case 'B':
+         opt_set_str("cover-db", optarg);
+         break;
+      case 'Q':
+         opt_set_str("pgo-collect", optarg);
+         break;
+      case 'L':
+         mode = LISTEN;
+         listen_addr = optarg;
+         break;
+      case 'a':
+         opt_set_str("activity", optarg);
+         break;
+      case 'M':
+         opt_set_int("perf-map", 1);
+         break;
+      case 'V':
+         {
+            const int lag = parse_int(optarg);
+            if (lag < 1)
+               fatal("VHPI asynchronous callback lag must be at least one");
+            opt_set_int("vhpi-async-lag", lag);
+         }
+         break;
+      case 'G':
+         if (optarg == NULL)
+            opt_set_int("rt-huge-pages", HUGE_PAGES_TRANSPARENT);
+         else if (strcmp(optarg, "explicit") == 0)
+            opt_set_int("rt-huge-pages", HUGE_PAGES_EXPLICIT);
+         else
+            fatal("invalid huge page mode: %s", optarg);
+         break;
       default:
          abort();
       }
    }
 
+   if (wave_stop <= wave_start)
+      fatal("--wave-stop must be later than --wave-start");
+
+   wave_set_window(wave_start, wave_stop);
+
+   if (job_file != NULL) {
+      // Worker threads, the shell, and waveform writers cannot be shared
+      // between forked jobs
+      if (mode == COMMAND)
+         fatal("the --jobs option cannot be used with --command");
+      else if (mode == LISTEN)
+         fatal("the --jobs option cannot be used with --listen");
+      else if (wave_fname != NULL)
+         fatal("the --jobs option cannot be used with --wave");
+      else if (opt_get_int("rt-threads") > 1)
+         fatal("the --jobs option cannot be used with --threads");
+   }
+   else if (checkpoint_at > 0)
+      fatal("the --checkpoint-at option requires --jobs");
+
    set_top_level(argv, next_cmd);
 
    ident_t ename = ident_prefix(top_level, ident_new("elab"), '.');
@@ -556,8 +1256,18 @@ static int run(int argc, char **argv)
 
    rt_restart(e);
 
-   if (mode == COMMAND)
+   if (job_file != NULL) {
+      if (checkpoint_at > 0)
+         rt_run_sim(checkpoint_at);
+
+      const bool passed = run_jobs(e, job_file, stop_time);
+      tree_read_end(ctx);
+      return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+   else if (mode == COMMAND)
       shell_run(e, ctx);
+   else if (mode == LISTEN)
+      server_run(e, listen_addr);
    else
       rt_run_sim(stop_time);
 
@@ -573,15 +1283,16 @@ static int run(int argc, char **argv)
 static int make_cmd(int argc, char **argv)
 {
    static struct option long_options[] = {
-      { "deps-only", no_argument, 0, 'd' },
-      { "native",    no_argument, 0, 'n' },
-      { "posix",     no_argument, 0, 'p' },
+      { "deps-only", no_argument,       0, 'd' },
+      { "native",    no_argument,       0, 'n' },
+      { "posix",     no_argument,       0, 'p' },
+      { "jobs",      required_argument, 0, 'j' },
       { 0, 0, 0, 0 }
    };
 
    const int next_cmd = scan_cmd(2, argc, argv);
-   int c, index = 0;
-   const char *spec = "";
+   int c, index = 0, jobs = 0;
+   const char *spec = "j:";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 0:
@@ -598,6 +1309,10 @@ static int make_cmd(int argc, char **argv)
       case 'p':
          opt_set_int("make-posix", 1);
          break;
+      case 'j':
+         if ((jobs = parse_int(optarg)) < 1)
+            fatal("number of jobs must be at least one");
+         break;
       default:
          abort();
       }
@@ -618,7 +1333,13 @@ static int make_cmd(int argc, char **argv)
       }
    }
 
-   make(targets, count, stdout);
+   if (jobs > 0) {
+      const int status = make_build(targets, count, jobs, process_command);
+      if (status != EXIT_SUCCESS)
+         return status;
+   }
+   else
+      make(targets, count, stdout);
 
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
@@ -670,6 +1391,44 @@ static int list_cmd(int argc, char **argv)
    return argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS;
 }
 
+static int cover_merge_cmd(int argc, char **argv)
+{
+   static struct option long_options[] = {
+      { "output", required_argument, 0, 'o' },
+      { 0, 0, 0, 0 }
+   };
+
+   const char *output = NULL;
+
+   const int next_cmd = scan_cmd(2, argc, argv);
+   int c, index = 0;
+   const char *spec = "o:";
+   while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
+      switch (c) {
+      case 0:
+         // Set a flag
+         break;
+      case 'o':
+         output = optarg;
+         break;
+      case '?':
+         fatal("unrecognised cover-merge option %s", argv[optind - 1]);
+      default:
+         abort();
+      }
+   }
+
+   if (optind == next_cmd)
+      fatal("missing coverage database files");
+
+   cover_merge(next_cmd - optind, argv + optind, output);
+
+   argc -= next_cmd - 1;
+   argv += next_cmd - 1;
+
+   return argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS;
+}
+
 static int syntax_cmd(int argc, char **argv)
 {
    static struct option long_options[] = {
@@ -763,20 +1522,42 @@ static int dump_cmd(int argc, char **argv)
 
 static void set_default_opts(void)
 {
-   opt_set_int("rt-stats", 0);
+   opt_set_int("rt-stats", STATS_NONE);
+   opt_set_int("phase-stats", STATS_NONE);
+   opt_set_int("rt-threads", 1);
+   opt_set_int("cycle-based", 0);
+   opt_set_int("lazy-jit", 0);
+   opt_set_int("rt-profile", 0);
+   opt_set_int("perf-map", 0);
+   opt_set_int("rt-huge-pages", HUGE_PAGES_NONE);
+   opt_set_int("wave-async", 0);
+   opt_set_int("fst-pack", 0);
+   opt_set_int("fst-parallel", 0);
+   opt_set_int("fst-repack", 1);
+   opt_set_int("fst-block", 0);
    opt_set_int("rt_trace_en", 0);
    opt_set_int("vhpi_trace_en", 0);
+   opt_set_int("vhpi-async-lag", 1024);
    opt_set_int("dump-llvm", 0);
-   opt_set_int("optimise", 1);
+   opt_set_int("optimise", 2);
+   opt_set_int("time-passes", 0);
+   opt_set_int("code-cache", 1);
    opt_set_int("native", 0);
+   opt_set_int("elab-jobs", 1);
+   opt_set_int("prune", 0);
+   opt_set_int("fuse", 0);
    opt_set_int("bootstrap", 0);
-   opt_set_int("cover", 0);
+   opt_set_int("cover", COVER_NONE);
    opt_set_int("stop-delta", 1000);
    opt_set_int("unit-test", 0);
    opt_set_int("prefer-explicit", 0);
    opt_set_int("make-deps-only", 0);
    opt_set_int("make-posix", 0);
    opt_set_str("dump-vcode", NULL);
+   opt_set_str("cover-db", NULL);
+   opt_set_str("pgo-collect", NULL);
+   opt_set_str("activity", NULL);
+   opt_set_str("pgo-use", NULL);
    opt_set_int("relax", 0);
    opt_set_int("ignore-time", 0);
    opt_set_int("force-init", 0);
@@ -792,6 +1573,7 @@ static void usage(void)
           " -e [OPTION]... UNIT\t\tElaborate and generate code for UNIT\n"
           " -r [OPTION]... UNIT\t\tExecute previously elaborated UNIT\n"
           " --codegen UNIT\t\t\tGenerate native shared library for UNIT\n"
+          " --cover-merge [OPTION]... FILE...\tMerge coverage databases\n"
           " --dump [OPTION]... UNIT\tPrint out previously analysed UNIT\n"
           " --list\t\t\t\tPrint all units in the library\n"
           " --make [OPTION]... [UNIT]...\tGenerate makefile to rebuild UNITs\n"
@@ -802,6 +1584,9 @@ static void usage(void)
           " -h, --help\t\tDisplay this message and exit\n"
           "     --ignore-time\tSkip source file timestamp check\n"
           " -L PATH\t\tAdd PATH to library search paths\n"
+          "     --lib-codec=NAME\tCompress library files with fastlz, lz4, "
+          "or none\n"
+          "     --lib-threads=N\tCompress library files on N threads\n"
           "     --map=LIB:PATH\tMap library LIB to PATH\n"
           "     --messages=STYLE\tSelect full or compact message format\n"
           "     --std=REV\t\tVHDL standard revision to use\n"
@@ -810,43 +1595,76 @@ static void usage(void)
           "\n"
           "Analyse options:\n"
           "     --bootstrap\tAllow compilation of STANDARD package\n"
+          " -j, --jobs=N\t\tAnalyse up to N files concurrently\n"
           "     --relax=RULES\tDisable certain pedantic rule checks\n"
+          "     --stats[=FMT]\tPrint time and memory for each phase (json)\n"
           "\n"
           "Elaborate options:\n"
-          "     --cover\t\tEnable code coverage reporting\n"
+          "     --cover[=MODE]\tEnable code coverage reporting (bitmap, once)\n"
           "     --disable-opt\tDisable LLVM optimisations\n"
           "     --dump-llvm\tPrint generated LLVM IR\n"
           "     --dump-vcode\tPrint generated intermediate code\n"
+          "     --fuse\t\tMerge small processes with the same sensitivity\n"
           " -g NAME=VALUE\t\tSet top level generic NAME to VALUE\n"
+          " -j, --jobs=N\t\tGenerate native code on N processes\n"
+          " -O0, -O1, -O2, -O3\tSelect the LLVM optimisation level\n"
           "     --native\t\tGenerate native code shared library\n"
+          "     --no-cache\t\tElaborate even if the design is up to date\n"
+          "     --pgo-use=FILE\tOptimise using profile from --pgo-collect\n"
+          "     --prune\t\tRemove logic that cannot affect top-level ports\n"
+          "     --stats[=FMT]\tPrint time and memory for each phase (json)\n"
+          "     --time-passes\tPrint time taken by each optimisation pass\n"
           " -V, --verbose\t\tPrint resource usage at each step\n"
           "\n"
           "Run options:\n"
+          "     --activity=FILE\tWrite switching activity to FILE in SAIF\n"
           " -b, --batch\t\tRun in batch mode (default)\n"
           " -c, --command\t\tRun in TCL command line mode\n"
+          "     --checkpoint-at=T\tRun to time T once before forking jobs\n"
+          "     --cover-db=FILE\tWrite coverage database to FILE\n"
+          "     --cycle-based\tRun combinational processes in level order\n"
           "     --exclude=GLOB\tExclude signals matching GLOB from wave dump\n"
           "     --exit-severity=S\tExit after assertion failure of severity S\n"
           "     --format=FMT\tWaveform format is one of lxt, fst, or vcd\n"
+          "     --fst-options=L\tComma separated list of FST writer options\n"
+          "     --huge-pages[=M]\tBack signal state with huge pages\n"
           "     --include=GLOB\tInclude signals matching GLOB in wave dump\n"
+          "     --jobs=FILE\tFork one simulation per line of FILE\n"
+          "     --lazy-jit\t\tOnly compile code when it is first used\n"
+          "     --listen=ADDR\tServe binary requests on a port or socket\n"
 #ifdef ENABLE_VHPI
           "     --load=PLUGIN\tLoad VHPI plugin at startup\n"
 #endif
-          "     --stats\t\tPrint statistics at end of run\n"
+          "     --perf-map\t\tWrite symbols for JIT code to /tmp/perf-PID.map\n"
+          "     --pgo-collect=FILE\tWrite process activation counts to FILE\n"
+          "     --profile\t\tReport time spent in each process\n"
+          "     --stats[=FMT]\tPrint statistics at end of run (detail, json)\n"
           "     --stop-delta=N\tStop after N delta cycles (default %d)\n"
           "     --stop-time=T\tStop after simulation time T (e.g. 5ns)\n"
+          "     --threads=N\tExecute processes on N threads\n"
           "     --trace\t\tTrace simulation events\n"
 #ifdef ENABLE_VHPI
+          "     --vhpi-async-lag=N\tQueue at most N asynchronous VHPI "
+          "callbacks\n"
           "     --vhpi-trace\tTrace VHPI calls and events\n"
 #endif
           " -w, --wave=FILE\tWrite waveform data; file name is optional\n"
+          "     --wave-async\tFormat FST waveform data on a separate thread\n"
+          "     --wave-depth=N\tOnly dump signals up to N levels below top\n"
+          "     --wave-start=T\tStart recording waveform data at time T\n"
+          "     --wave-stop=T\tStop recording waveform data at time T\n"
           "\n"
           "Dump options:\n"
           " -e, --elab\t\tDump an elaborated unit\n"
           " -b, --body\t\tDump package body\n"
           "     --nets\t\tShow mapping from signals to nets\n"
           "\n"
+          "Cover merge options:\n"
+          " -o, --output=FILE\tAlso write merged coverage database to FILE\n"
+          "\n"
           "Make options:\n"
           "     --deps-only\tOutput dependencies without actions\n"
+          " -j, --jobs=N\t\tRebuild out of date units directly on N processes\n"
           "     --native\t\tGenerate actions for native code generation\n"
           "     --posix\t\tStrictly POSIX compliant makefile\n"
           "\n",
@@ -899,6 +1717,19 @@ static message_style_t parse_message_style(const char *str)
    fatal("invalid message style '%s' (allowed are 'full' and 'compact')", str);
 }
 
+static fbuf_codec_t parse_lib_codec(const char *str)
+{
+   if (strcmp(str, "fastlz") == 0)
+      return FBUF_CODEC_FASTLZ;
+   else if (strcmp(str, "lz4") == 0)
+      return FBUF_CODEC_LZ4;
+   else if (strcmp(str, "none") == 0)
+      return FBUF_CODEC_NONE;
+
+   fatal("invalid library codec '%s' (allowed are 'fastlz', 'lz4', "
+         "and 'none')", str);
+}
+
 static void parse_library_map(char *str)
 {
    char *split = strchr(str, ':');
@@ -933,6 +1764,7 @@ static int process_command(int argc, char **argv)
       { "make",    no_argument, 0, 'm' },
       { "syntax",  no_argument, 0, 's' },
       { "list",    no_argument, 0, 'l' },
+      { "cover-merge", no_argument, 0, 'C' },
       { 0, 0, 0, 0 }
    };
 
@@ -958,6 +1790,8 @@ static int process_command(int argc, char **argv)
       return syntax_cmd(argc, argv);
    case 'l':
       return list_cmd(argc, argv);
+   case 'C':
+      return cover_merge_cmd(argc, argv);
    default:
       fatal("missing command, try %s --help for usage", PACKAGE);
       return EXIT_FAILURE;
@@ -989,6 +1823,8 @@ int main(int argc, char **argv)
       { "map",         required_argument, 0, 'p' },
       { "ignore-time", no_argument,       0, 'i' },
       { "force-init",  no_argument,       0, 'f' },
+      { "lib-codec",   required_argument, 0, 'C' },
+      { "lib-threads", required_argument, 0, 'T' },
       { 0, 0, 0, 0 }
    };
 
@@ -1033,6 +1869,12 @@ int main(int argc, char **argv)
       case 'f':
          opt_set_int("force-init", 1);
          break;
+      case 'C':
+         fbuf_set_codec(parse_lib_codec(optarg));
+         break;
+      case 'T':
+         fbuf_set_threads(parse_int(optarg));
+         break;
       case '?':
          fatal("unrecognised global option %s", argv[optind - 1]);
       default:
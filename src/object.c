@@ -20,6 +20,8 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
 
 DEFINE_ARRAY(tree);
 DEFINE_ARRAY(netid);
@@ -40,12 +42,72 @@ static const char *item_text_map[] = {
    "I_ATTRS",    "I_PTYPES",    "I_CHARS",    "I_CODE",       "I_FLAGS"
 };
 
+// Object markers with object kinds offset past them
+#define MARKER_NULL 0
+#define MARKER_BACK 1
+#define MARKER_KIND 2
+
+// Location tags
+#define LOC_TAG_INVALID   0
+#define LOC_TAG_SAME_FILE 1
+#define LOC_TAG_FILE      2
+#define LOC_TAG_NEW_FILE  3
+
+struct segment {
+   uint64_t        start;
+   uint64_t        end;
+   index_t         first;
+   index_t         count;
+   object_store_t *store;
+   object_t       *owner;
+   int             item;
+};
+
+struct object_store {
+   object_t       **objects;
+   unsigned         count;
+   unsigned         alloc;
+   fbuf_t          *file;
+   char            *fname;
+   segment_t       *segments;
+   unsigned         n_segments;
+   unsigned         pending;
+   bool             attached;
+   object_arena_t  *arena;
+};
+
+#define ARENA_CHUNK_SIZE (256 * 1024)
+
+typedef struct arena_chunk arena_chunk_t;
+
+struct arena_chunk {
+   arena_chunk_t *next;
+   size_t         used;
+   char           data[0];
+};
+
+struct object_arena {
+   object_arena_t  *next;
+   arena_chunk_t   *chunks;
+   object_t       **objects;
+   size_t           n_objects;
+   size_t           max_objects;
+   size_t           n_old;
+};
+
 static object_class_t *classes[4];
 static uint32_t        format_digest;
 static generation_t    next_generation = 1;
 static object_t      **all_objects = NULL;
 static size_t          max_objects = 256;   // Grows at runtime
 static size_t          n_objects_alloc = 0;
+static object_arena_t *all_arenas = NULL;
+static object_arena_t *active_arena = NULL;
+static size_t          n_old_objects = 0;   // Prefix of all_objects
+static size_t          n_old_at_major = 0;
+static object_t      **remembered = NULL;
+static size_t          n_remembered = 0;
+static size_t          max_remembered = 256;
 
 void object_lookup_failed(const char *name, const char **kind_text_map,
                           int kind, imask_t mask)
@@ -186,7 +248,7 @@ void object_one_time_init(void)
 
       // Increment this each time a incompatible change is made to the
       // on-disk format not expressed in the tree and type items table
-      const uint32_t format_fudge = 7;
+      const uint32_t format_fudge = 9;
 
       format_digest += format_fudge * UINT32_C(2654435761);
 
@@ -194,6 +256,8 @@ void object_one_time_init(void)
    }
 }
 
+static void *object_arena_alloc(object_arena_t *arena, size_t size);
+
 object_t *object_new(const object_class_t *class, int kind)
 {
    if (unlikely(kind >= class->last_kind))
@@ -201,21 +265,70 @@ object_t *object_new(const object_class_t *class, int kind)
 
    object_one_time_init();
 
-   object_t *object = xcalloc(class->object_size[kind]);
+   object_t *object;
+   if (active_arena != NULL)
+      object = object_arena_alloc(active_arena, class->object_size[kind]);
+   else {
+      object = xcalloc(class->object_size[kind]);
+
+      if (unlikely(all_objects == NULL))
+         all_objects = xmalloc(sizeof(object_t *) * max_objects);
+
+      ARRAY_APPEND(all_objects, object, n_objects_alloc, max_objects);
+   }
 
    object->kind  = kind;
    object->tag   = class->tag;
    object->index = UINT32_MAX;
 
-   if (unlikely(all_objects == NULL))
-      all_objects = xmalloc(sizeof(object_t *) * max_objects);
+   return object;
+}
 
-   ARRAY_APPEND(all_objects, object, n_objects_alloc, max_objects);
+void object_remember(object_t *object)
+{
+   if (unlikely(remembered == NULL))
+      remembered = xmalloc(sizeof(object_t *) * max_remembered);
 
-   return object;
+   object->flags |= OBJECT_F_REMEMBERED;
+   ARRAY_APPEND(remembered, object, n_remembered, max_remembered);
 }
 
-static void object_sweep(object_t *object)
+static void object_forget_all(void)
+{
+   for (size_t i = 0; i < n_remembered; i++)
+      remembered[i]->flags &= ~OBJECT_F_REMEMBERED;
+
+   n_remembered = 0;
+}
+
+static void object_store_release(object_store_t *store)
+{
+   if (store->attached || store->pending > 0)
+      return;
+
+   if (store->file != NULL)
+      fbuf_close(store->file);
+
+   free(store->fname);
+   free(store->segments);
+   free(store->objects);
+   free(store);
+}
+
+static void object_drop_segment(tree_array_t *a)
+{
+   segment_t *seg = (segment_t *)((uintptr_t)a->items & ~(uintptr_t)1);
+   assert(seg->owner != NULL);
+
+   seg->owner = NULL;
+   seg->store->pending--;
+   object_store_release(seg->store);
+
+   a->items = NULL;
+   a->count = 0;
+}
+
+static void object_free_items(object_t *object)
 {
    const object_class_t *class = classes[object->tag];
 
@@ -224,8 +337,13 @@ static void object_sweep(object_t *object)
    imask_t mask = 1;
    for (int n = 0; n < nitems; mask <<= 1) {
       if (has & mask) {
-         if (ITEM_TREE_ARRAY & mask)
-            free(object->items[n].tree_array.items);
+         if (ITEM_TREE_ARRAY & mask) {
+            tree_array_t *a = &(object->items[n].tree_array);
+            if (object_array_deferred(a))
+               object_drop_segment(a);
+            else
+               free(a->items);
+         }
          else if (ITEM_NETID_ARRAY & mask)
             free(object->items[n].netid_array.items);
          else if (ITEM_RANGE & mask)
@@ -241,28 +359,148 @@ static void object_sweep(object_t *object)
          n++;
       }
    }
+}
 
+static void object_sweep(object_t *object)
+{
+   object_free_items(object);
    free(object);
 }
 
-void object_gc(void)
+object_arena_t *object_arena_new(void)
+{
+   object_arena_t *arena = xcalloc(sizeof(object_arena_t));
+   arena->max_objects = 256;
+   arena->objects     = xmalloc(arena->max_objects * sizeof(object_t *));
+
+   arena->next = all_arenas;
+   all_arenas  = arena;
+
+   return arena;
+}
+
+object_arena_t *object_arena_select(object_arena_t *arena)
+{
+   object_arena_t *prev = active_arena;
+   active_arena = arena;
+   return prev;
+}
+
+void object_arena_free(object_arena_t *arena)
+{
+   assert(arena != active_arena);
+
+   for (object_arena_t **it = &all_arenas; *it != NULL; it = &((*it)->next)) {
+      if (*it == arena) {
+         *it = arena->next;
+         break;
+      }
+   }
+
+   // Drop objects from this arena out of the remembered set
+   bool any_remembered = false;
+   for (size_t i = 0; i < arena->n_old; i++) {
+      if (arena->objects[i]->flags & OBJECT_F_REMEMBERED) {
+         arena->objects[i]->flags &= ~OBJECT_F_REMEMBERED;
+         any_remembered = true;
+      }
+   }
+
+   if (any_remembered) {
+      size_t p = 0;
+      for (size_t i = 0; i < n_remembered; i++) {
+         if (remembered[i]->flags & OBJECT_F_REMEMBERED)
+            remembered[p++] = remembered[i];
+      }
+      n_remembered = p;
+   }
+
+   for (size_t i = 0; i < arena->n_objects; i++)
+      object_free_items(arena->objects[i]);
+
+   for (arena_chunk_t *c = arena->chunks, *next; c != NULL; c = next) {
+      next = c->next;
+      free(c);
+   }
+
+   free(arena->objects);
+   free(arena);
+}
+
+static void *object_arena_alloc(object_arena_t *arena, size_t size)
+{
+   size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+   assert(size <= ARENA_CHUNK_SIZE);
+
+   arena_chunk_t *c = arena->chunks;
+   if (c == NULL || c->used + size > ARENA_CHUNK_SIZE) {
+      // Fresh chunks are zeroed like objects from xcalloc
+      c = xcalloc(sizeof(arena_chunk_t) + ARENA_CHUNK_SIZE);
+      c->next = arena->chunks;
+      arena->chunks = c;
+   }
+
+   object_t *object = (object_t *)(c->data + c->used);
+   c->used += size;
+
+   ARRAY_APPEND(arena->objects, object, arena->n_objects, arena->max_objects);
+
+   return object;
+}
+
+static bool object_is_root(object_t *object)
+{
+   const object_class_t *class = classes[object->tag];
+
+   for (int j = 0; j < class->gc_num_roots; j++) {
+      if (class->gc_roots[j] == object->kind)
+         return true;
+   }
+
+   return false;
+}
+
+static void object_promote_arenas(void)
+{
+   // Arena objects are never swept but those allocated since the last
+   // collection may point at young objects without a write barrier
+   for (object_arena_t *a = all_arenas; a != NULL; a = a->next) {
+      for (size_t i = a->n_old; i < a->n_objects; i++)
+         a->objects[i]->flags |= OBJECT_F_OLD;
+      a->n_old = a->n_objects;
+   }
+}
+
+static void object_major_gc(void)
 {
    // Generation will be updated by tree_visit
    const generation_t base_gen = next_generation;
 
+   // Everything allocated from an arena lives until the arena is freed
+   // so treat those objects as roots
+   if (all_arenas != NULL) {
+      object_visit_ctx_t ctx = {
+         .count      = 0,
+         .postorder  = NULL,
+         .preorder   = NULL,
+         .context    = NULL,
+         .kind       = T_LAST_TREE_KIND,
+         .generation = next_generation++,
+         .deep       = true,
+         .lazy       = true
+      };
+
+      for (object_arena_t *a = all_arenas; a != NULL; a = a->next) {
+         for (size_t i = 0; i < a->n_objects; i++)
+            object_visit(a->objects[i], &ctx);
+      }
+   }
+
    // Mark
    for (unsigned i = 0; i < n_objects_alloc; i++) {
       assert(all_objects[i] != NULL);
 
-      const object_class_t *class = classes[all_objects[i]->tag];
-
-      bool top_level = false;
-      for (int j = 0; (j < class->gc_num_roots) && !top_level; j++) {
-         if (class->gc_roots[j] == all_objects[i]->kind)
-            top_level = true;
-      }
-
-      if (top_level) {
+      if (object_is_root(all_objects[i])) {
          object_visit_ctx_t ctx = {
             .count      = 0,
             .postorder  = NULL,
@@ -270,13 +508,16 @@ void object_gc(void)
             .context    = NULL,
             .kind       = T_LAST_TREE_KIND,
             .generation = next_generation++,
-            .deep       = true
+            .deep       = true,
+            .lazy       = true
          };
 
          object_visit(all_objects[i], &ctx);
       }
    }
 
+   object_forget_all();
+
    // Sweep
    for (unsigned i = 0; i < n_objects_alloc; i++) {
       object_t *object = all_objects[i];
@@ -285,18 +526,105 @@ void object_gc(void)
          all_objects[i] = NULL;
       }
    }
+}
 
-   // Compact
-   size_t p = 0;
-   for (unsigned i = 0; i < n_objects_alloc; i++) {
-      if (all_objects[i] != NULL)
+static void object_minor_gc(void)
+{
+   // Only young objects are traced: reachable old objects are only
+   // entered through the remembered set
+   object_visit_ctx_t ctx = {
+      .count      = 0,
+      .postorder  = NULL,
+      .preorder   = NULL,
+      .context    = NULL,
+      .kind       = T_LAST_TREE_KIND,
+      .generation = next_generation++,
+      .deep       = true,
+      .lazy       = true,
+      .young      = true
+   };
+
+   for (size_t i = 0; i < n_remembered; i++)
+      object_visit(remembered[i], &ctx);
+
+   for (object_arena_t *a = all_arenas; a != NULL; a = a->next) {
+      for (size_t i = a->n_old; i < a->n_objects; i++)
+         object_visit(a->objects[i], &ctx);
+   }
+
+   for (size_t i = n_old_objects; i < n_objects_alloc; i++) {
+      if (object_is_root(all_objects[i]))
+         object_visit(all_objects[i], &ctx);
+   }
+
+   object_forget_all();
+
+   for (size_t i = n_old_objects; i < n_objects_alloc; i++) {
+      object_t *object = all_objects[i];
+      if (object->generation != ctx.generation) {
+         object_sweep(object);
+         all_objects[i] = NULL;
+      }
+   }
+}
+
+void object_gc(void)
+{
+   struct timespec start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   // Collect the whole heap when the old generation has doubled in size
+   // since the last major collection
+   const bool major = (n_old_at_major == 0)
+      || (n_old_objects >= 2 * n_old_at_major);
+
+   size_t first;
+   if (major) {
+      object_major_gc();
+      first = 0;
+   }
+   else {
+      object_minor_gc();
+      first = n_old_objects;
+   }
+
+   object_promote_arenas();
+
+   // Compact and promote the survivors
+   size_t p = first;
+   for (size_t i = first; i < n_objects_alloc; i++) {
+      if (all_objects[i] != NULL) {
+         all_objects[i]->flags = OBJECT_F_OLD;
          all_objects[p++] = all_objects[i];
+      }
+   }
+
+   const size_t freed = n_objects_alloc - p;
+   n_objects_alloc = n_old_objects = p;
+
+   if (major)
+      n_old_at_major = MAX(p, 1);
+
+   if ((getenv("NVC_GC_VERBOSE") != NULL) || is_debugger_running()) {
+      struct timespec end;
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      const double ms = (end.tv_sec - start.tv_sec) * 1000.0
+         + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+      notef("GC: %s collection freed %zu objects; %zu allocated in %.1fms",
+            major ? "major" : "minor", freed, p, ms);
    }
+}
 
-   if ((getenv("NVC_GC_VERBOSE") != NULL) || is_debugger_running())
-      notef("GC: freed %zu objects; %zu allocated", n_objects_alloc - p, p);
+size_t object_count(void)
+{
+   // Objects on the garbage collected heap and in every arena
+   size_t count = n_objects_alloc;
+   for (object_arena_t *a = all_arenas; a != NULL; a = a->next)
+      count += a->n_objects;
 
-   n_objects_alloc = p;
+   return count;
 }
 
 void object_visit(object_t *object, object_visit_ctx_t *ctx)
@@ -307,6 +635,8 @@ void object_visit(object_t *object, object_visit_ctx_t *ctx)
 
    if ((object == NULL) || (object->generation == ctx->generation))
       return;
+   else if (ctx->young && object->flags == OBJECT_F_OLD)
+      return;
 
    object->generation = ctx->generation;
 
@@ -332,8 +662,13 @@ void object_visit(object_t *object, object_visit_ctx_t *ctx)
             object_visit((object_t *)object->items[i].tree, ctx);
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[i].tree_array);
-            for (unsigned j = 0; j < a->count; j++)
-               object_visit((object_t *)a->items[j], ctx);
+            if (object_array_deferred(a) && ctx->lazy)
+               ;   // Nothing in memory is reachable only from here
+            else {
+               object_array_check(a);
+               for (unsigned j = 0; j < a->count; j++)
+                  object_visit((object_t *)a->items[j], ctx);
+            }
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             type_array_t *a = &(object->items[i].type_array);
@@ -405,8 +740,13 @@ object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx)
       return ctx->cache[object->index];
    }
 
+   if (ctx->skip != NULL && ghash_get(ctx->skip, object) != NULL)
+      return object;
+
    const imask_t skip_mask = (I_REF | I_ATTRS | I_NETS);
 
+   object_write_barrier(object);
+
    const object_class_t *class = classes[object->tag];
 
    const imask_t has = class->has_map[object->kind];
@@ -422,6 +762,7 @@ object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx)
                (tree_t)object_rewrite((object_t *)object->items[n].tree, ctx);
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[n].tree_array);
+            object_array_check(a);
 
             for (size_t i = 0; i < a->count; i++)
                a->items[i] =
@@ -519,8 +860,10 @@ object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx)
 
 static void write_loc(loc_t *l, object_wr_ctx_t *ctx)
 {
+   // Most trees are in the same file as the previous tree and only a
+   // few lines after it so store just the difference
    if (l->file == NULL) {
-      write_u16(UINT16_C(0xfffe), ctx->file);  // Invalid location marker
+      write_uint(LOC_TAG_INVALID, ctx->file);
       return;
    }
 
@@ -538,40 +881,112 @@ static void write_loc(loc_t *l, object_wr_ctx_t *ctx)
 
       ctx->file_names[findex] = l->file;
 
-      write_u16(findex | UINT16_C(0x8000), ctx->file);
-      write_u16(len, ctx->file);
+      write_uint(LOC_TAG_NEW_FILE, ctx->file);
+      write_uint(findex, ctx->file);
+      write_uint(len, ctx->file);
       write_raw(l->file, len, ctx->file);
    }
-   else
-      write_u16(findex, ctx->file);
+   else if (findex == ctx->last_file)
+      write_uint(LOC_TAG_SAME_FILE, ctx->file);
+   else {
+      write_uint(LOC_TAG_FILE, ctx->file);
+      write_uint(findex, ctx->file);
+   }
 
-   const uint64_t merged =
-      ((uint64_t)l->first_line << 44)
-      | ((uint64_t)l->first_column << 32)
-      | ((uint64_t)l->last_line << 12)
-      | (uint64_t)l->last_column;
+   write_int((int64_t)l->first_line - ctx->last_line, ctx->file);
+   write_uint(l->first_column, ctx->file);
+   write_int((int64_t)l->last_line - l->first_line, ctx->file);
+   write_uint(l->last_column, ctx->file);
 
-   write_u64(merged, ctx->file);
+   ctx->last_file = findex;
+   ctx->last_line = l->first_line;
+}
+
+static bool object_deferrable(object_t *object, imask_t mask)
+{
+   // Statements of processes and subprogram bodies are only needed for
+   // code generation so are written as separate segments that can be
+   // skipped over when the unit is read back
+   if (object->tag != OBJECT_TAG_TREE || mask != I_STMTS)
+      return false;
+
+   switch (object->kind) {
+   case T_PROCESS:
+   case T_FUNC_BODY:
+   case T_PROC_BODY:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static void object_write_segment(const tree_array_t *a, object_wr_ctx_t *ctx)
+{
+   if (ctx->n_segments == ctx->segments_alloc) {
+      ctx->segments_alloc = MAX(ctx->segments_alloc * 2, 16);
+      ctx->segments = xrealloc(ctx->segments,
+                               ctx->segments_alloc * sizeof(segment_t));
+   }
+
+   const unsigned id = ctx->n_segments++;
+
+   write_uint(((uint64_t)a->count << 1) | 1, ctx->file);
+   write_uint(id, ctx->file);
+
+   // Each segment has its own identifier and file name tables so it
+   // can be read without the rest of the stream
+   ident_wr_ctx_t saved_ident = ctx->ident_ctx;
+   const char *saved_names[MAX_FILES];
+   memcpy(saved_names, ctx->file_names, sizeof(saved_names));
+   const int saved_file = ctx->last_file;
+   const unsigned saved_line = ctx->last_line;
+
+   ctx->ident_ctx  = ident_write_begin(ctx->file);
+   ctx->in_segment = true;
+   ctx->last_file  = -1;
+   ctx->last_line  = 0;
+   memset(ctx->file_names, '\0', sizeof(ctx->file_names));
+
+   const index_t first = ctx->n_objects;
+   const uint64_t start = fbuf_tell(ctx->file);
+
+   for (unsigned i = 0; i < a->count; i++)
+      object_write((object_t *)a->items[i], ctx);
+
+   ident_write_end(ctx->ident_ctx);
+
+   ctx->ident_ctx  = saved_ident;
+   ctx->in_segment = false;
+   ctx->last_file  = saved_file;
+   ctx->last_line  = saved_line;
+   memcpy(ctx->file_names, saved_names, sizeof(saved_names));
+
+   segment_t *seg = &(ctx->segments[id]);
+   seg->start = start;
+   seg->end   = fbuf_tell(ctx->file);
+   seg->first = first;
+   seg->count = ctx->n_objects - first;
 }
 
 void object_write(object_t *object, object_wr_ctx_t *ctx)
 {
    if (object == NULL) {
-      write_u16(UINT16_C(0xffff), ctx->file);  // Null marker
+      write_uint(MARKER_NULL, ctx->file);
       return;
    }
 
    if (object->generation == ctx->generation) {
-      // Already visited this tree
-      write_u16(UINT16_C(0xfffe), ctx->file);   // Back reference marker
-      write_u32(object->index, ctx->file);
+      // Already visited this tree: most references are to a recent
+      // object so store the distance back from the next index
+      write_uint(MARKER_BACK, ctx->file);
+      write_uint(ctx->n_objects - object->index, ctx->file);
       return;
    }
 
    object->generation = ctx->generation;
    object->index      = (ctx->n_objects)++;
 
-   write_u16(object->kind, ctx->file);
+   write_uint(object->kind + MARKER_KIND, ctx->file);
 
    if (object->tag == OBJECT_TAG_TREE)
       write_loc(&object->loc, ctx);
@@ -590,21 +1005,27 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
          else if (ITEM_TYPE & mask)
             object_write((object_t *)object->items[n].type, ctx);
          else if (ITEM_TREE_ARRAY & mask) {
-            const tree_array_t *a = &(object->items[n].tree_array);
-            write_u32(a->count, ctx->file);
-            for (unsigned i = 0; i < a->count; i++)
-               object_write((object_t *)a->items[i], ctx);
+            tree_array_t *a = &(object->items[n].tree_array);
+            object_array_check(a);
+            if (a->count > 0 && !ctx->in_segment
+                && object_deferrable(object, mask))
+               object_write_segment(a, ctx);
+            else {
+               write_uint((uint64_t)a->count << 1, ctx->file);
+               for (unsigned i = 0; i < a->count; i++)
+                  object_write((object_t *)a->items[i], ctx);
+            }
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             const type_array_t *a = &(object->items[n].type_array);
-            write_u16(a->count, ctx->file);
+            write_uint(a->count, ctx->file);
             for (unsigned i = 0; i < a->count; i++)
                object_write((object_t *)a->items[i], ctx);
          }
          else if (ITEM_INT64 & mask)
-            write_u64(object->items[n].ival, ctx->file);
+            write_int(object->items[n].ival, ctx->file);
          else if (ITEM_INT32 & mask)
-            write_u32(object->items[n].ival, ctx->file);
+            write_int((int32_t)object->items[n].ival, ctx->file);
          else if (ITEM_RANGE & mask) {
             if (object->items[n].range != NULL) {
                write_u8(object->items[n].range->kind, ctx->file);
@@ -615,10 +1036,14 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
                write_u8(UINT8_C(0xff), ctx->file);
          }
          else if (ITEM_NETID_ARRAY & mask) {
+            // Nets are usually numbered consecutively
             const netid_array_t *a = &(object->items[n].netid_array);
-            write_u32(a->count, ctx->file);
-            for (unsigned i = 0; i < a->count; i++)
-               write_u32(a->items[i], ctx->file);
+            write_uint(a->count, ctx->file);
+            int64_t prev = -1;
+            for (unsigned i = 0; i < a->count; i++) {
+               write_int((int64_t)a->items[i] - prev - 1, ctx->file);
+               prev = a->items[i];
+            }
          }
          else if (ITEM_DOUBLE & mask) {
             union { double d; uint64_t i; } u;
@@ -627,9 +1052,9 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
          }
          else if (ITEM_ATTRS & mask) {
             const attr_tab_t *attrs = &(object->items[n].attrs);
-            write_u16(attrs->num, ctx->file);
+            write_uint(attrs->num, ctx->file);
             for (unsigned i = 0; i < attrs->num; i++) {
-               write_u16(attrs->table[i].kind, ctx->file);
+               write_uint(attrs->table[i].kind, ctx->file);
                ident_write(attrs->table[i].name, ctx->ident_ctx);
 
                switch (attrs->table[i].kind) {
@@ -638,7 +1063,7 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
                   break;
 
                case A_INT:
-                  write_u32(attrs->table[i].ival, ctx->file);
+                  write_int((int32_t)attrs->table[i].ival, ctx->file);
                   break;
 
                case A_TREE:
@@ -652,7 +1077,7 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
          }
          else if (ITEM_RANGE_ARRAY & mask) {
             range_array_t *a = &(object->items[n].range_array);
-            write_u16(a->count, ctx->file);
+            write_uint(a->count, ctx->file);
             for (unsigned i = 0; i < a->count; i++) {
                write_u8(a->items[i].kind, ctx->file);
                object_write((object_t *)a->items[i].left, ctx);
@@ -680,6 +1105,12 @@ object_wr_ctx_t *object_write_begin(fbuf_t *f)
    ctx->generation = next_generation++;
    ctx->n_objects  = 0;
    ctx->ident_ctx  = ident_write_begin(f);
+   ctx->segments   = NULL;
+   ctx->n_segments = 0;
+   ctx->in_segment = false;
+   ctx->segments_alloc = 0;
+   ctx->last_file  = -1;
+   ctx->last_line  = 0;
    memset(ctx->file_names, '\0', sizeof(ctx->file_names));
 
    return ctx;
@@ -687,7 +1118,20 @@ object_wr_ctx_t *object_write_begin(fbuf_t *f)
 
 void object_write_end(object_wr_ctx_t *ctx)
 {
+   // The segment table follows the main stream and its position is
+   // stored uncompressed at the very end of the file
+   fbuf_put_trailer(ctx->file, fbuf_tell(ctx->file));
+
+   write_u32(ctx->n_segments, ctx->file);
+   for (unsigned i = 0; i < ctx->n_segments; i++) {
+      write_u64(ctx->segments[i].start, ctx->file);
+      write_u64(ctx->segments[i].end, ctx->file);
+      write_u32(ctx->segments[i].first, ctx->file);
+      write_u32(ctx->segments[i].count, ctx->file);
+   }
+
    ident_write_end(ctx->ident_ctx);
+   free(ctx->segments);
    free(ctx);
 }
 
@@ -696,52 +1140,223 @@ fbuf_t *object_write_file(object_wr_ctx_t *ctx)
    return ctx->file;
 }
 
+static const char *read_loc_file(object_rd_ctx_t *ctx, uint64_t index)
+{
+   if (index >= MAX_FILES || ctx->file_names[index] == NULL)
+      fatal("%s: invalid file name index %"PRIu64, ctx->db_fname, index);
+
+   return ctx->file_names[index];
+}
+
 static loc_t read_loc(object_rd_ctx_t *ctx)
 {
    const char *fname;
-   uint16_t fmarker = read_u16(ctx->file);
-   if (fmarker == UINT16_C(0xfffe))
+   uint64_t findex;
+   switch (read_uint(ctx->file)) {
+   case LOC_TAG_INVALID:
       return LOC_INVALID;
-   else if (fmarker & UINT16_C(0x8000)) {
-      uint16_t index = fmarker & UINT16_C(0x7fff);
-      assert(index < MAX_FILES);
-      uint16_t len = read_u16(ctx->file);
-      char *buf = xmalloc(len);
-      read_raw(buf, len, ctx->file);
-
-      ctx->file_names[index] = buf;
-      fname = buf;
-   }
-   else {
-      assert(fmarker < MAX_FILES);
-      fname = ctx->file_names[fmarker];
-      assert(fname != NULL);
+
+   case LOC_TAG_SAME_FILE:
+      findex = ctx->last_file;
+      fname = read_loc_file(ctx, findex);
+      break;
+
+   case LOC_TAG_FILE:
+      findex = read_uint(ctx->file);
+      fname = read_loc_file(ctx, findex);
+      break;
+
+   case LOC_TAG_NEW_FILE:
+      {
+         findex = read_uint(ctx->file);
+         if (findex >= MAX_FILES)
+            fatal("%s: invalid file name index %"PRIu64,
+                  ctx->db_fname, findex);
+
+         const uint64_t len = read_uint(ctx->file);
+         char *buf = xmalloc(len);
+         read_raw(buf, len, ctx->file);
+
+         ctx->file_names[findex] = buf;
+         fname = buf;
+      }
+      break;
+
+   default:
+      fatal("%s: invalid location tag", ctx->db_fname);
    }
 
    loc_t l = { .file = fname, .linebuf = NULL };
 
-   const uint64_t merged = read_u64(ctx->file);
+   l.first_line   = ctx->last_line + read_int(ctx->file);
+   l.first_column = read_uint(ctx->file);
+   l.last_line    = l.first_line + read_int(ctx->file);
+   l.last_column  = read_uint(ctx->file);
 
-   l.first_line   = (merged >> 44) & 0xfffff;
-   l.first_column = (merged >> 32) & 0xfff;
-   l.last_line    = (merged >> 12) & 0xfffff;
-   l.last_column  = merged & 0xfff;
+   ctx->last_file = findex;
+   ctx->last_line = l.first_line;
 
    return l;
 }
 
+static object_store_t *object_store_new(void)
+{
+   object_store_t *store = xcalloc(sizeof(object_store_t));
+   store->alloc    = 256;
+   store->objects  = xmalloc(store->alloc * sizeof(object_t *));
+   store->attached = true;
+   store->arena    = active_arena;
+
+   return store;
+}
+
+static void object_store_reserve(object_store_t *store, unsigned count)
+{
+   if (count > store->alloc) {
+      store->alloc = MAX(store->alloc * 2, next_power_of_2(count));
+      store->objects = xrealloc(store->objects,
+                                store->alloc * sizeof(object_t *));
+   }
+
+   for (unsigned i = store->count; i < count; i++)
+      store->objects[i] = NULL;
+
+   store->count = MAX(store->count, count);
+}
+
+static void object_store_put(object_store_t *store, object_t *object)
+{
+   object_store_reserve(store, object->index + 1);
+   store->objects[object->index] = object;
+}
+
+static void object_read_segment(segment_t *seg)
+{
+   object_store_t *store = seg->store;
+   object_t *owner = seg->owner;
+   assert(owner != NULL);
+
+   seg->owner = NULL;
+
+   // Reading a segment may fault in another segment through a back
+   // reference so restore the position afterwards
+   const uint64_t saved = fbuf_tell(store->file);
+   fbuf_seek(store->file, seg->start);
+
+   object_rd_ctx_t sub = {
+      .file      = store->file,
+      .ident_ctx = ident_read_begin(store->file),
+      .n_objects = seg->first,
+      .store     = store,
+      .db_fname  = store->fname,
+      .last_file = -1,
+      .last_line = 0
+   };
+
+   object_write_barrier(owner);
+
+   tree_array_t *a = &(owner->items[seg->item].tree_array);
+   const unsigned count = a->count;
+   a->items = NULL;
+   a->count = 0;
+
+   // Objects in the segment belong to the same arena as the rest of
+   // the unit so they are freed together
+   object_arena_t *prev = object_arena_select(store->arena);
+
+   tree_array_resize(a, count, NULL);
+   for (unsigned i = 0; i < count; i++)
+      a->items[i] = (tree_t)object_read(&sub, OBJECT_TAG_TREE);
+
+   object_arena_select(prev);
+
+   if (sub.n_objects != seg->first + seg->count)
+      fatal("segment of %s has %u objects but expected %u",
+            store->fname, sub.n_objects - seg->first,
+            seg->count);
+
+   ident_read_end(sub.ident_ctx);
+   fbuf_seek(store->file, saved);
+
+   store->pending--;
+   object_store_release(store);
+}
+
+static object_t *object_store_get(object_store_t *store, index_t index)
+{
+   assert(index < store->count);
+
+   if (unlikely(store->objects[index] == NULL)) {
+      // Find the unread segment containing this object
+      unsigned low = 0, high = store->n_segments;
+      while (low < high) {
+         const unsigned mid = (low + high) / 2;
+         const segment_t *seg = &(store->segments[mid]);
+         if (index < seg->first)
+            high = mid;
+         else if (index >= seg->first + seg->count)
+            low = mid + 1;
+         else {
+            if (seg->owner != NULL)
+               object_read_segment(&(store->segments[mid]));
+            break;
+         }
+      }
+   }
+
+   return store->objects[index];
+}
+
+static void object_skip_segment(object_rd_ctx_t *ctx, object_t *object,
+                                int item, unsigned count)
+{
+   object_store_t *store = ctx->store;
+
+   const unsigned id = read_uint(ctx->file);
+   if (id >= store->n_segments)
+      fatal("%s: invalid segment %u", ctx->db_fname, id);
+
+   segment_t *seg = &(store->segments[id]);
+   assert(seg->first == ctx->n_objects);
+
+   // Reserve the indices of objects in the segment so the numbering is
+   // the same as if it had been read in full
+   ctx->n_objects += seg->count;
+   object_store_reserve(store, ctx->n_objects);
+
+   seg->owner = object;
+   seg->item  = item;
+   store->pending++;
+
+   tree_array_t *a = &(object->items[item].tree_array);
+   a->count = count;
+   a->items = (tree_t *)((uintptr_t)seg | 1);
+
+   fbuf_seek(ctx->file, seg->end);
+}
+
+void object_load_array(tree_array_t *a)
+{
+   segment_t *seg = (segment_t *)((uintptr_t)a->items & ~(uintptr_t)1);
+   assert(&(seg->owner->items[seg->item].tree_array) == a);
+
+   object_read_segment(seg);
+}
+
 object_t *object_read(object_rd_ctx_t *ctx, int tag)
 {
-   uint16_t marker = read_u16(ctx->file);
-   if (marker == UINT16_C(0xffff))
-      return NULL;    // Null marker
-   else if (marker == UINT16_C(0xfffe)) {
-      // Back reference marker
-      index_t index = read_u32(ctx->file);
-      assert(index < ctx->n_objects);
-      return ctx->store[index];
+   const uint64_t value = read_uint(ctx->file);
+   if (value == MARKER_NULL)
+      return NULL;
+   else if (value == MARKER_BACK) {
+      const uint64_t dist = read_uint(ctx->file);
+      if (dist == 0 || dist > ctx->n_objects)
+         fatal("%s: invalid back reference", ctx->db_fname);
+      return object_store_get(ctx->store, ctx->n_objects - dist);
    }
 
+   const unsigned marker = value - MARKER_KIND;
+
    const object_class_t *class = classes[tag];
 
    assert(marker < class->last_kind);
@@ -755,11 +1370,7 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
    // This must be done early as a child node of this type may
    // reference upwards
    object->index = ctx->n_objects++;
-   if (ctx->n_objects == ctx->store_sz) {
-      ctx->store_sz *= 2;
-      ctx->store = xrealloc(ctx->store, ctx->store_sz * sizeof(tree_t));
-   }
-   ctx->store[object->index] = object;
+   object_store_put(ctx->store, object);
 
    const imask_t has = class->has_map[object->kind];
    const int nitems = class->object_nitems[object->kind];
@@ -774,20 +1385,27 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
             object->items[n].tree = (tree_t)object_read(ctx, OBJECT_TAG_TYPE);
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[n].tree_array);
-            tree_array_resize(a, read_u32(ctx->file), NULL);
-            for (unsigned i = 0; i < a->count; i++)
-               a->items[i] = (tree_t)object_read(ctx, OBJECT_TAG_TREE);
+            const uint64_t value = read_uint(ctx->file);
+            const unsigned count = value >> 1;
+
+            if (value & 1)
+               object_skip_segment(ctx, object, n, count);
+            else {
+               tree_array_resize(a, count, NULL);
+               for (unsigned i = 0; i < a->count; i++)
+                  a->items[i] = (tree_t)object_read(ctx, OBJECT_TAG_TREE);
+            }
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             type_array_t *a = &(object->items[n].type_array);
-            type_array_resize(a, read_u16(ctx->file), NULL);
+            type_array_resize(a, read_uint(ctx->file), NULL);
             for (unsigned i = 0; i < a->count; i++)
                a->items[i] = (type_t)object_read(ctx, OBJECT_TAG_TYPE);
          }
          else if (ITEM_INT64 & mask)
-            object->items[n].ival = read_u64(ctx->file);
+            object->items[n].ival = read_int(ctx->file);
          else if (ITEM_INT32 & mask)
-            object->items[n].ival = read_u32(ctx->file);
+            object->items[n].ival = (int32_t)read_int(ctx->file);
          else if (ITEM_RANGE & mask) {
             const uint8_t rmarker = read_u8(ctx->file);
             if (rmarker != UINT8_C(0xff)) {
@@ -802,7 +1420,7 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
          else if (ITEM_RANGE_ARRAY & mask) {
             range_array_t *a = &(object->items[n].range_array);
             range_t dummy = { NULL, NULL, 0 };
-            range_array_resize(a, read_u16(ctx->file), dummy);
+            range_array_resize(a, read_uint(ctx->file), dummy);
 
             for (unsigned i = 0; i < a->count; i++) {
                a->items[i].kind  = read_u8(ctx->file);
@@ -816,9 +1434,11 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
             ;
          else if (ITEM_NETID_ARRAY & mask) {
             netid_array_t *a = &(object->items[n].netid_array);
-            netid_array_resize(a, read_u32(ctx->file), NETID_INVALID);
+            netid_array_resize(a, read_uint(ctx->file), NETID_INVALID);
+
+            int64_t prev = -1;
             for (unsigned i = 0; i < a->count; i++)
-               a->items[i] = read_u32(ctx->file);
+               a->items[i] = prev = prev + read_int(ctx->file) + 1;
          }
          else if (ITEM_DOUBLE & mask) {
             union { uint64_t i; double d; } u;
@@ -828,14 +1448,14 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
          else if (ITEM_ATTRS & mask) {
             attr_tab_t *attrs = &(object->items[n].attrs);
 
-            attrs->num = read_u16(ctx->file);
+            attrs->num = read_uint(ctx->file);
             if (attrs->num > 0) {
                attrs->alloc = next_power_of_2(attrs->num);
                attrs->table = xmalloc(sizeof(attr_t) * attrs->alloc);
             }
 
             for (unsigned i = 0; i < attrs->num; i++) {
-               attrs->table[i].kind = read_u16(ctx->file);
+               attrs->table[i].kind = read_uint(ctx->file);
                attrs->table[i].name = ident_read(ctx->ident_ctx);
 
                switch (attrs->table[i].kind) {
@@ -844,7 +1464,7 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
                   break;
 
                case A_INT:
-                  attrs->table[i].ival = read_u32(ctx->file);
+                  attrs->table[i].ival = (int32_t)read_int(ctx->file);
                   break;
 
                case A_TREE:
@@ -871,13 +1491,7 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
 static void object_read_recover_fn(object_t *object, object_rd_ctx_t *ctx)
 {
    object->index = (ctx->n_objects)++;
-
-   if (object->index == ctx->store_sz) {
-      ctx->store_sz *= 2;
-      ctx->store = xrealloc(ctx->store, ctx->store_sz * sizeof(object_t *));
-   }
-
-   ctx->store[object->index] = object;
+   object_store_put(ctx->store, object);
 }
 
 object_rd_ctx_t *object_read_recover(object_t *object, const char *fname)
@@ -887,8 +1501,7 @@ object_rd_ctx_t *object_read_recover(object_t *object, const char *fname)
    object_one_time_init();
 
    object_rd_ctx_t *ctx = xcalloc(sizeof(object_rd_ctx_t));
-   ctx->store_sz  = 256;
-   ctx->store     = xcalloc(ctx->store_sz * sizeof(object_t *));
+   ctx->store     = object_store_new();
    ctx->n_objects = 0;
    ctx->db_fname  = strdup(fname);
 
@@ -923,13 +1536,41 @@ object_rd_ctx_t *object_read_begin(fbuf_t *f, const char *fname)
             "is more recent that the currently selected standard %s",
             fname, standard_text(std), standard_text(standard()));
 
+   object_store_t *store = object_store_new();
+
+   // Read the segment table before the main stream
+   const uint64_t pos = fbuf_tell(f);
+   fbuf_seek(f, fbuf_get_trailer(f));
+
+   if ((store->n_segments = read_u32(f)) > 0) {
+      store->segments = xmalloc(store->n_segments * sizeof(segment_t));
+      for (unsigned i = 0; i < store->n_segments; i++) {
+         segment_t *seg = &(store->segments[i]);
+         seg->start = read_u64(f);
+         seg->end   = read_u64(f);
+         seg->first = read_u32(f);
+         seg->count = read_u32(f);
+         seg->store = store;
+         seg->owner = NULL;
+         seg->item  = -1;
+      }
+
+      // Keep a separate mapping of the file for reading segments later
+      if ((store->file = fbuf_open(fname, FBUF_IN)) == NULL)
+         fatal_errno("%s", fname);
+      store->fname = strdup(fname);
+   }
+
+   fbuf_seek(f, pos);
+
    object_rd_ctx_t *ctx = xcalloc(sizeof(object_rd_ctx_t));
    ctx->file      = f;
    ctx->ident_ctx = ident_read_begin(f);
-   ctx->store_sz  = 256;
-   ctx->store     = xmalloc(ctx->store_sz * sizeof(object_t *));
+   ctx->store     = store;
    ctx->n_objects = 0;
    ctx->db_fname  = strdup(fname);
+   ctx->last_file = -1;
+   ctx->last_line = 0;
 
    return ctx;
 }
@@ -938,7 +1579,10 @@ void object_read_end(object_rd_ctx_t *ctx)
 {
    if (ctx->ident_ctx != NULL)
       ident_read_end(ctx->ident_ctx);
-   free(ctx->store);
+
+   ctx->store->attached = false;
+   object_store_release(ctx->store);
+
    free(ctx->db_fname);
    free(ctx);
 }
@@ -951,7 +1595,7 @@ fbuf_t *object_read_file(object_rd_ctx_t *ctx)
 object_t *object_read_recall(object_rd_ctx_t *ctx, index_t index)
 {
    assert(index < ctx->n_objects);
-   return ctx->store[index];
+   return object_store_get(ctx->store, index);
 }
 
 unsigned object_next_generation(void)
@@ -993,6 +1637,7 @@ bool object_copy_mark(object_t *object, object_copy_ctx_t *ctx)
             ;
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[n].tree_array);
+            object_array_check(a);
             for (unsigned i = 0; i < a->count; i++)
                marked = object_copy_mark((object_t *)a->items[i], ctx)
                   || marked;
@@ -1057,8 +1702,12 @@ object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx)
 
    assert(object->generation == ctx->generation);
 
-   if (object->index == UINT32_MAX)
+   if (object->index == UINT32_MAX) {
+      // Not copied so the new tree points at the original
+      if (ctx->shared != NULL)
+         ghash_put(ctx->shared, object, object);
       return object;
+   }
 
    assert(object->index < ctx->index);
 
@@ -1087,9 +1736,10 @@ object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx)
          else if (ITEM_DOUBLE & mask)
             copy->items[n].dval = object->items[n].dval;
          else if (ITEM_TREE_ARRAY & mask) {
-            const tree_array_t *from = &(object->items[n].tree_array);
+            tree_array_t *from = &(object->items[n].tree_array);
             tree_array_t *to = &(copy->items[n].tree_array);
 
+            object_array_check(from);
             tree_array_resize(to, from->count, NULL);
 
             for (size_t i = 0; i < from->count; i++)
@@ -1148,7 +1798,7 @@ object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx)
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             const type_array_t *from = &(object->items[n].type_array);
-            type_array_t *to = &(object->items[n].type_array);
+            type_array_t *to = &(copy->items[n].type_array);
 
             type_array_resize(to, from->count, NULL);
 
@@ -1173,6 +1823,8 @@ void object_replace(object_t *t, object_t *a)
 {
    const object_class_t *class = classes[t->tag];
 
+   object_write_barrier(t);
+
    object_change_kind(class, t, a->kind);
 
    const imask_t has = class->has_map[t->kind];
@@ -1194,9 +1846,11 @@ void object_replace(object_t *t, object_t *a)
          else if (ITEM_TREE & mask)
             t->items[n].tree = a->items[n].tree;
          else if (ITEM_TREE_ARRAY & mask) {
-            const tree_array_t *from = &(a->items[n].tree_array);
+            tree_array_t *from = &(a->items[n].tree_array);
             tree_array_t *to = &(t->items[n].tree_array);
 
+            object_array_check(from);
+            object_array_check(to);
             tree_array_resize(to, from->count, NULL);
 
             for (size_t i = 0; i < from->count; i++)
@@ -22,6 +22,7 @@
 #include "array.h"
 #include "tree.h"
 #include "type.h"
+#include "hash.h"
 
 #include <stdint.h>
 
@@ -175,9 +176,16 @@ typedef union {
    vcode_unit_t   code;
 } item_t;
 
+// Objects which survive a collection are promoted to the old generation
+// and a write to an old object adds it to the remembered set so a minor
+// collection need only trace young objects from those roots
+#define OBJECT_F_OLD        (1 << 0)
+#define OBJECT_F_REMEMBERED (1 << 1)
+
 typedef struct {
    uint8_t      kind;
-   uint8_t      tag;
+   uint8_t      tag : 6;
+   uint8_t      flags : 2;
    generation_t generation;
    index_t      index;
    loc_t        loc;
@@ -190,6 +198,7 @@ typedef struct {
    tree_copy_fn_t  callback;
    void           *context;
    object_t      **copied;
+   ghash_t        *shared;
 } object_copy_ctx_t;
 
 typedef struct {
@@ -199,6 +208,7 @@ typedef struct {
    tree_rewrite_fn_t fn;
    void             *context;
    size_t            cache_size;
+   ghash_t          *skip;
 } object_rewrite_ctx_t;
 
 typedef struct {
@@ -209,10 +219,16 @@ typedef struct {
    tree_kind_t      kind;
    unsigned         generation;
    bool             deep;
+   bool             lazy;
+   bool             young;
 } object_visit_ctx_t;
 
 typedef int change_allowed_t[2];
 
+typedef struct object_store object_store_t;
+typedef struct segment segment_t;
+typedef struct object_arena object_arena_t;
+
 typedef struct {
    const char             *name;
    const change_allowed_t *change_allowed;
@@ -233,16 +249,23 @@ typedef struct {
    unsigned        generation;
    unsigned        n_objects;
    const char     *file_names[MAX_FILES];
+   segment_t      *segments;
+   unsigned        n_segments;
+   unsigned        segments_alloc;
+   bool            in_segment;
+   int             last_file;   // Location of the last tree written
+   unsigned        last_line;
 } object_wr_ctx_t;
 
 typedef struct {
    fbuf_t         *file;
    ident_rd_ctx_t  ident_ctx;
    unsigned        n_objects;
-   object_t      **store;
-   unsigned        store_sz;
+   object_store_t *store;
    char           *db_fname;
    const char     *file_names[MAX_FILES];
+   int             last_file;
+   unsigned        last_line;
 } object_rd_ctx_t;
 
 __attribute__((noreturn))
@@ -257,12 +280,36 @@ void object_change_kind(const object_class_t *class,
 object_t *object_new(const object_class_t *class, int kind);
 void object_one_time_init(void);
 void object_gc(void);
+size_t object_count(void);
 void object_visit(object_t *object, object_visit_ctx_t *ctx);
 object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx);
 unsigned object_next_generation(void);
 object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx);
 bool object_copy_mark(object_t *object, object_copy_ctx_t *ctx);
 void object_replace(object_t *t, object_t *a);
+void object_load_array(tree_array_t *a);
+object_arena_t *object_arena_new(void);
+object_arena_t *object_arena_select(object_arena_t *arena);
+void object_arena_free(object_arena_t *arena);
+void object_remember(object_t *object);
+
+// Must be called before storing a reference to another object in
+// one of the items of `o'
+#define object_write_barrier(o) do {                                   \
+      if (unlikely(((o)->flags & (OBJECT_F_OLD | OBJECT_F_REMEMBERED)) \
+                   == OBJECT_F_OLD))                                   \
+         object_remember(o);                                           \
+   } while (0)
+
+// Statements of processes and subprogram bodies read from a library are
+// left on disk until first used and the array holds a tagged pointer
+#define object_array_deferred(a) \
+   unlikely((uintptr_t)(a)->items & 1)
+
+#define object_array_check(a) do {              \
+      if (object_array_deferred(a))             \
+         object_load_array(a);                  \
+   } while (0)
 
 void object_write(object_t *object, object_wr_ctx_t *ctx);
 object_wr_ctx_t *object_write_begin(fbuf_t *f);
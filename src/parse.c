@@ -50,14 +50,15 @@ typedef struct {
 
 static const char *perm_linebuf = NULL;
 static const char *perm_file_name = NULL;
-static int         n_token_next_start = 0;
 static int         n_row = 0;
-static bool        last_was_newline = true;
 static loc_t       start_loc;
 static loc_t       last_loc;
-static const char *read_ptr;
 static const char *file_start;
 static size_t      file_sz;
+static char       *scan_buf = NULL;
+static size_t      scan_sz;
+static size_t      scan_pos;
+static size_t      line_start;
 static int         n_errors = 0;
 static const char *hint_str = NULL;
 static int         n_correct = 0;
@@ -71,6 +72,7 @@ static int         nopt_hist = 0;
 
 loc_t yylloc;
 int yylex(void);
+void lexer_scan_buffer(char *buf, size_t size);
 
 #define F(list) list, ARRAY_LEN(list)
 #define scan(...) _scan(1, __VA_ARGS__, -1)
@@ -5489,52 +5491,39 @@ static tree_t p_design_unit(void)
 
 void begin_token(char *tok)
 {
+   // The lexer scans a private copy of the file mapped at the same
+   // offsets so positions can be found from the token pointer
+   const size_t offset = tok - scan_buf;
+   const int n_token_length = strlen(tok);
+
+   for (; scan_pos < offset + n_token_length; scan_pos++) {
+      if (scan_buf[scan_pos] == '\n') {
+         n_row++;
+         line_start = scan_pos + 1;
+      }
+   }
+
+   perm_linebuf = file_start + line_start;
+
+   int first_col, last_col;
    const char *newline = strrchr(tok, '\n');
-   int n_token_start, n_token_length;
    if (newline != NULL) {
-      n_token_start = 0;
-      n_token_length = strlen(tok) - (newline - tok);
-      n_token_next_start = n_token_length - 1;
+      first_col = 0;
+      last_col  = n_token_length - (newline - tok) - 1;
    }
    else {
-      n_token_start = n_token_next_start;
-      n_token_length = strlen(tok);
-      n_token_next_start += n_token_length;
+      first_col = offset - line_start;
+      last_col  = first_col + n_token_length - 1;
    }
 
-   const int last_col = n_token_start + n_token_length - 1;
-
    yylloc.first_line   = MIN(n_row, LINE_INVALID);
-   yylloc.first_column = MIN(n_token_start, COLUMN_INVALID);
+   yylloc.first_column = MIN(first_col, COLUMN_INVALID);
    yylloc.last_line    = MIN(n_row, LINE_INVALID);
    yylloc.last_column  = MIN(last_col, COLUMN_INVALID);
    yylloc.file         = perm_file_name;
    yylloc.linebuf      = perm_linebuf;
 }
 
-int get_next_char(char *b, int max_buffer)
-{
-   if (last_was_newline) {
-      n_row += 1;
-      perm_linebuf = read_ptr;
-      last_was_newline = false;
-   }
-
-   const bool eof = read_ptr >= file_start + file_sz;
-   if (eof)
-      return 0;
-   else
-      *b = *read_ptr++;
-
-   if (perm_linebuf == NULL)
-      perm_linebuf = read_ptr;
-
-   if (*b == '\n')
-      last_was_newline = true;
-
-   return *b == 0 ? 0 : 1;
-}
-
 void input_from_file(const char *file)
 {
    int fd = open(file, O_RDONLY);
@@ -5550,19 +5539,52 @@ void input_from_file(const char *file)
 
    file_sz = buf.st_size;
 
+   // Flex scans the input in place so needs a writable buffer with two
+   // trailing zero bytes: reserve zeroed pages and map a private copy of
+   // the file over the start. Error messages print source lines from a
+   // second read-only mapping as the lexer overwrites the byte after
+   // each token while it is being parsed.
+   char *old_buf = scan_buf;
+   const size_t old_sz = scan_sz;
+
+   const long pagesz = sysconf(_SC_PAGESIZE);
+   scan_sz = ((file_sz + 2 + pagesz - 1) / pagesz) * pagesz;
+
+   scan_buf = mmap(NULL, scan_sz, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (scan_buf == MAP_FAILED)
+      fatal_errno("mmap");
+
    if (file_sz > 0) {
       file_start = mmap(NULL, file_sz, PROT_READ, MAP_PRIVATE, fd, 0);
       if (file_start == MAP_FAILED)
          fatal_errno("mmap");
+
+      void *map = mmap(scan_buf, file_sz, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, fd, 0);
+      if (map == MAP_FAILED)
+         fatal_errno("mmap");
    }
    else
-      file_start = NULL;
+      file_start = scan_buf;
+
+   close(fd);
+
+   // Input stops at the first NUL character
+   const char *nul = memchr(file_start, '\0', file_sz);
+   const size_t scan_len = (nul == NULL) ? file_sz : nul - file_start;
+   scan_buf[scan_len] = scan_buf[scan_len + 1] = '\0';
+
+   lexer_scan_buffer(scan_buf, scan_len + 2);
+
+   if (old_buf != NULL)
+      munmap(old_buf, old_sz);
 
-   read_ptr           = file_start;
-   last_was_newline   = true;
    perm_file_name     = strdup(file);
-   n_row              = 0;
-   n_token_next_start = 0;
+   perm_linebuf       = file_start;
+   n_row              = 1;
+   scan_pos           = 0;
+   line_start         = 0;
 
    if (tokenq == NULL) {
       tokenq_sz = 128;
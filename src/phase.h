@@ -42,6 +42,10 @@ tree_t eval(tree_t fcall);
 // Elaborate a top level entity
 tree_t elab(tree_t top);
 
+// Return the previously elaborated design for a top level entity if
+// none of the units it depends on have changed since
+tree_t elab_cached(tree_t top);
+
 // Set the value of a top-level generic
 void elab_set_generic(const char *name, const char *value);
 
@@ -57,6 +61,10 @@ void dump_nets(tree_t top);
 // Link together bitcode packages with elaborated design
 void link_bc(tree_t top);
 
+// True if the code generated for an elaborated design is newer than
+// the design itself
+bool link_up_to_date(tree_t top);
+
 // Precompile native code for a package
 void link_package(tree_t pack);
 
@@ -67,9 +75,22 @@ bool pack_needs_cgen(tree_t t);
 // Groups nets which never have sub-elements assigned.
 void group_nets(tree_t top);
 
+// Remove processes and signals which cannot affect the top-level ports
+// or any other observable behaviour of an elaborated design
+void prune_design(tree_t top);
+
+// Merge small combinational processes with the same sensitivity list
+void fuse_processes(tree_t top);
+
 // Generate a makefile for the givein unit
 void make(tree_t *targets, int count, FILE *out);
 
+// Rebuild any out of date units needed by the targets running up to
+// jobs steps at once: each step passes the command line a generated
+// makefile would use to fn in a child process
+typedef int (*make_cmd_fn_t)(int argc, char **argv);
+int make_build(tree_t *targets, int count, int jobs, make_cmd_fn_t fn);
+
 // Set parser input file
 void input_from_file(const char *file);
 
@@ -82,4 +103,26 @@ int parse_errors(void);
 // Generate vcode for a design unit
 void lower_unit(tree_t unit);
 
+// Generate vcode for an elaborated design one process at a time:
+// lower_elab_begin generates the top-level declarations and each call
+// to lower_elab_process generates one process until lower_elab_end
+void lower_elab_begin(tree_t unit);
+vcode_unit_t lower_elab_process(tree_t unit, tree_t proc);
+void lower_elab_end(tree_t unit);
+
+// Free the vcode for a process or subprogram and anything nested in it
+void lower_release(tree_t body);
+
+// Generate vcode for a function body outside its enclosing unit so
+// it can be evaluated at compile time
+vcode_unit_t lower_func(tree_t body);
+
+// Record the time and memory used by a phase of compilation until the
+// matching call to stats_phase_end: phases may be nested
+void stats_phase_begin(const char *name);
+void stats_phase_end(void);
+
+// Print the statistics for each phase recorded since the last report
+void stats_phase_report(bool json);
+
 #endif  // _PHASE_H
@@ -60,8 +60,9 @@ typedef struct range {
 
 typedef struct tree_wr_ctx *tree_wr_ctx_t;
 typedef struct tree_rd_ctx *tree_rd_ctx_t;
+typedef struct tree_arena *tree_arena_t;
 
-typedef struct trie *ident_t;
+typedef struct ident *ident_t;
 
 typedef struct vcode_unit *vcode_unit_t;
 
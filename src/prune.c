@@ -0,0 +1,795 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "tree.h"
+#include "phase.h"
+#include "common.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+//
+// Remove processes and signals from an elaborated design that cannot
+// affect any observable behaviour
+//
+
+typedef struct {
+   tree_t     *items;
+   unsigned    count;
+   unsigned    max;
+} decl_list_t;
+
+typedef struct {
+   tree_t       proc;
+   bool         live;
+   bool         sink;
+   decl_list_t  reads;
+   decl_list_t  drives;
+} prune_proc_t;
+
+typedef struct {
+   prune_proc_t *proc;
+   hash_t       *read;
+   hash_t       *driven;
+   hash_t       *targets;
+} prune_visit_ctx_t;
+
+typedef struct {
+   hash_t *dead;
+   int     nprocs;
+   int     nsignals;
+} prune_rewrite_ctx_t;
+
+static void decl_list_add(decl_list_t *list, tree_t decl)
+{
+   if (list->count == list->max) {
+      list->max = MAX(list->max * 2, 4);
+      list->items = xrealloc(list->items, list->max * sizeof(tree_t));
+   }
+
+   list->items[list->count++] = decl;
+}
+
+static tree_t prune_target_ref(tree_t name)
+{
+   for (;;) {
+      switch (tree_kind(name)) {
+      case T_ARRAY_REF:
+      case T_ARRAY_SLICE:
+      case T_RECORD_REF:
+         name = tree_value(name);
+         break;
+      case T_REF:
+         return name;
+      default:
+         return NULL;
+      }
+   }
+}
+
+static void prune_target(tree_t target, prune_visit_ctx_t *ctx)
+{
+   if (tree_kind(target) == T_AGGREGATE) {
+      const int nassocs = tree_assocs(target);
+      for (int i = 0; i < nassocs; i++)
+         prune_target(tree_value(tree_assoc(target, i)), ctx);
+      return;
+   }
+   else if (tree_kind(target) == T_LITERAL)
+      return;   // Constant folding can cause this to appear
+
+   tree_t ref = prune_target_ref(target);
+   if (ref == NULL || tree_kind(tree_ref(ref)) != T_SIGNAL_DECL) {
+      // Driving a signal through an alias or some other name we do not
+      // understand so assume the process must be kept
+      ctx->proc->sink = true;
+      return;
+   }
+
+   tree_t decl = tree_ref(ref);
+   hash_put(ctx->targets, ref, decl);
+
+   if (hash_get(ctx->driven, decl) == NULL) {
+      hash_put(ctx->driven, decl, decl);
+      decl_list_add(&(ctx->proc->drives), decl);
+   }
+}
+
+static void prune_targets_visit_fn(tree_t t, void *_ctx)
+{
+   prune_target(tree_target(t), _ctx);
+}
+
+static void prune_reads_visit_fn(tree_t t, void *_ctx)
+{
+   prune_visit_ctx_t *ctx = _ctx;
+
+   switch (tree_kind(t)) {
+   case T_ASSERT:
+   case T_PCALL:
+      // Reports are observable and a procedure may perform file I/O or
+      // drive any signal passed to it
+      ctx->proc->sink = true;
+      break;
+
+   case T_FCALL:
+      if (tree_flags(tree_ref(t)) & TREE_F_IMPURE)
+         ctx->proc->sink = true;
+      break;
+
+   case T_REF:
+      {
+         tree_t decl = tree_ref(t);
+         switch (tree_kind(decl)) {
+         case T_SIGNAL_DECL:
+            if (hash_get(ctx->targets, t) != NULL)
+               break;   // Only assigned to here
+            else if (hash_get(ctx->read, decl) == NULL) {
+               hash_put(ctx->read, decl, decl);
+               decl_list_add(&(ctx->proc->reads), decl);
+            }
+            break;
+         case T_FILE_DECL:
+         case T_ALIAS:
+            ctx->proc->sink = true;
+            break;
+         case T_VAR_DECL:
+            if (tree_flags(decl) & TREE_F_SHARED)
+               ctx->proc->sink = true;
+            break;
+         default:
+            break;
+         }
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+static void prune_scan_proc(tree_t proc, prune_proc_t *p)
+{
+   p->proc = proc;
+   p->sink = (tree_kind(proc) != T_PROCESS);
+
+   prune_visit_ctx_t ctx = {
+      .proc    = p,
+      .read    = hash_new(64, true),
+      .driven  = hash_new(64, true),
+      .targets = hash_new(64, true)
+   };
+
+   // A signal which is only ever the target of an assignment does not
+   // make the process depend on its value
+   tree_visit_only(proc, prune_targets_visit_fn, &ctx, T_SIGNAL_ASSIGN);
+   tree_visit(proc, prune_reads_visit_fn, &ctx);
+
+   hash_free(ctx.read);
+   hash_free(ctx.driven);
+   hash_free(ctx.targets);
+}
+
+static void prune_mark_decl(tree_t decl, bool *live, hash_t *keep)
+{
+   const int nnets = tree_nets(decl);
+   for (int i = 0; i < nnets; i++)
+      live[tree_net(decl, i)] = true;
+
+   hash_put(keep, decl, decl);
+}
+
+static bool prune_any_live(tree_t decl, const bool *live)
+{
+   const int nnets = tree_nets(decl);
+   for (int i = 0; i < nnets; i++) {
+      if (live[tree_net(decl, i)])
+         return true;
+   }
+
+   return false;
+}
+
+typedef struct {
+   bool   *live;
+   hash_t *keep;
+} prune_seed_ctx_t;
+
+static void prune_seed_visit_fn(tree_t t, void *_ctx)
+{
+   prune_seed_ctx_t *ctx = _ctx;
+
+   tree_t decl = tree_ref(t);
+   if (tree_kind(decl) == T_SIGNAL_DECL)
+      prune_mark_decl(decl, ctx->live, ctx->keep);
+}
+
+static tree_t prune_rewrite_fn(tree_t t, void *_ctx)
+{
+   prune_rewrite_ctx_t *ctx = _ctx;
+
+   const tree_kind_t kind = tree_kind(t);
+   if (kind != T_PROCESS && kind != T_SIGNAL_DECL)
+      return t;
+   else if (hash_get(ctx->dead, t) == NULL)
+      return t;
+
+   if (kind == T_PROCESS)
+      ctx->nprocs++;
+   else
+      ctx->nsignals++;
+
+   return NULL;
+}
+
+typedef struct {
+   hash_t *cls;       // Signal declaration to first with the same nets
+   hash_t *bad;       // Classes whose value cannot be propagated
+   hash_t *drivers;   // Class to the only process driving it
+} prune_const_scan_t;
+
+typedef struct {
+   hash_t *consts;    // Signal declaration to its constant value
+   hash_t *targets;   // References which must not be replaced
+   hash_t *waits;     // Waits which may drop their constant triggers
+} prune_const_ctx_t;
+
+static void prune_const_poison(tree_t name, prune_const_scan_t *scan)
+{
+   tree_t ref = prune_target_ref(name);
+   if (ref == NULL || tree_kind(tree_ref(ref)) != T_SIGNAL_DECL)
+      return;
+
+   tree_t root = hash_get(scan->cls, tree_ref(ref));
+   if (root != NULL)
+      hash_put(scan->bad, root, root);
+}
+
+typedef struct {
+   prune_const_scan_t *scan;
+   tree_t              proc;
+} prune_driver_ctx_t;
+
+static void prune_const_driver(tree_t target, prune_driver_ctx_t *ctx)
+{
+   prune_const_scan_t *scan = ctx->scan;
+
+   if (tree_kind(target) == T_AGGREGATE) {
+      const int nassocs = tree_assocs(target);
+      for (int i = 0; i < nassocs; i++)
+         prune_const_driver(tree_value(tree_assoc(target, i)), ctx);
+      return;
+   }
+
+   tree_t ref = prune_target_ref(target);
+   if (ref == NULL || tree_kind(tree_ref(ref)) != T_SIGNAL_DECL)
+      return;
+
+   tree_t root = hash_get(scan->cls, tree_ref(ref));
+   if (root == NULL)
+      return;
+   else if (ref != target)
+      hash_put(scan->bad, root, root);   // Only part of the signal
+
+   tree_t other = hash_get(scan->drivers, root);
+   if (other == NULL)
+      hash_put(scan->drivers, root, ctx->proc);
+   else if (other != ctx->proc)
+      hash_put(scan->bad, root, root);
+}
+
+static void prune_const_driver_fn(tree_t t, void *ctx)
+{
+   prune_const_driver(tree_target(t), ctx);
+}
+
+static void prune_const_uses_fn(tree_t t, void *_ctx)
+{
+   prune_const_scan_t *scan = _ctx;
+
+   // Any use of a signal other than reading its value or waiting for
+   // it to change prevents replacing it with a constant
+
+   switch (tree_kind(t)) {
+   case T_ATTR_REF:
+      prune_const_poison(tree_name(t), scan);
+      break;
+
+   case T_PCALL:
+   case T_FCALL:
+      {
+         tree_t decl = tree_ref(t);
+         const int nports = tree_ports(decl);
+         const int nparams = tree_params(t);
+         for (int i = 0; i < nparams; i++) {
+            tree_t p = tree_param(t, i);
+            if (tree_kind(t) == T_FCALL && tree_subkind(p) == P_POS
+                && i < nports && tree_class(tree_port(decl, i)) != C_SIGNAL)
+               continue;
+
+            prune_const_poison(tree_value(p), scan);
+         }
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+static void prune_const_decl_fn(tree_t t, void *_ctx)
+{
+   prune_const_poison(t, _ctx);
+}
+
+static bool prune_is_const(tree_t t)
+{
+   switch (tree_kind(t)) {
+   case T_LITERAL:
+      return true;
+   case T_REF:
+      return tree_kind(tree_ref(t)) == T_ENUM_LIT;
+   default:
+      return false;
+   }
+}
+
+static tree_t prune_const_value(tree_t proc, tree_t *target)
+{
+   // Match the process generated for a concurrent assignment of a
+   // constant to the whole of a scalar signal
+
+   if (tree_kind(proc) != T_PROCESS || tree_stmts(proc) != 2
+       || tree_decls(proc) > 0)
+      return NULL;
+
+   tree_t s = tree_stmt(proc, 0);
+   tree_t w = tree_stmt(proc, 1);
+
+   if (tree_kind(s) != T_SIGNAL_ASSIGN || tree_kind(w) != T_WAIT)
+      return NULL;
+   else if (tree_triggers(w) > 0 || tree_has_delay(w) || tree_has_value(w))
+      return NULL;
+   else if (tree_waveforms(s) != 1 || tree_kind(tree_target(s)) != T_REF)
+      return NULL;
+
+   tree_t wave = tree_waveform(s, 0);
+   if (tree_has_delay(wave))
+      return NULL;
+
+   tree_t value = tree_value(wave);
+   if (!prune_is_const(value))
+      return NULL;
+   else if (tree_kind(value) == T_LITERAL && tree_subkind(value) != L_INT
+            && tree_subkind(value) != L_REAL)
+      return NULL;
+
+   *target = tree_target(s);
+   return value;
+}
+
+static bool prune_same_const(tree_t a, tree_t b)
+{
+   if (!prune_is_const(a) || !prune_is_const(b))
+      return false;
+   else if (tree_kind(a) != tree_kind(b))
+      return false;
+   else if (tree_kind(a) == T_REF)
+      return tree_ref(a) == tree_ref(b);
+   else if (tree_subkind(a) != tree_subkind(b))
+      return false;
+
+   switch (tree_subkind(a)) {
+   case L_INT:
+      return tree_ival(a) == tree_ival(b);
+   case L_REAL:
+      return tree_dval(a) == tree_dval(b);
+   default:
+      return false;
+   }
+}
+
+static bool prune_const_ref(tree_t t, prune_const_ctx_t *ctx)
+{
+   return tree_kind(t) == T_REF && hash_get(ctx->consts, tree_ref(t)) != NULL;
+}
+
+static tree_t prune_comb_wait(tree_t proc, prune_const_ctx_t *ctx)
+{
+   // Only the sensitivity list of a combinational process can lose
+   // constant triggers as the process then runs once at time zero and
+   // never depends on when an event occurred: this must leave at least
+   // one trigger or the process would become an implicit wait forever
+
+   if (tree_kind(proc) != T_PROCESS || !tree_attr_int(proc, comb_i, 0))
+      return NULL;
+
+   tree_t w = tree_stmt(proc, tree_stmts(proc) - 1);
+   assert(tree_kind(w) == T_WAIT);
+
+   if (tree_has_value(w) || tree_has_delay(w))
+      return NULL;
+
+   const int ntriggers = tree_triggers(w);
+   for (int i = 0; i < ntriggers; i++) {
+      if (!prune_const_ref(tree_trigger(w, i), ctx))
+         return w;
+   }
+
+   return NULL;
+}
+
+static void prune_const_protect_fn(tree_t t, void *_ctx)
+{
+   prune_const_ctx_t *ctx = _ctx;
+
+   // Other waits keep every trigger as a reference to the signal
+
+   if (hash_get(ctx->waits, t) != NULL)
+      return;
+
+   const int ntriggers = tree_triggers(t);
+   for (int i = 0; i < ntriggers; i++) {
+      tree_t trigger = tree_trigger(t, i);
+      if (prune_const_ref(trigger, ctx))
+         hash_put(ctx->targets, trigger, trigger);
+   }
+}
+
+static tree_t prune_const_wait(tree_t t, prune_const_ctx_t *ctx)
+{
+   // Remove triggers which were replaced by constants
+
+   if (hash_get(ctx->waits, t) == NULL)
+      return t;
+
+   const int ntriggers = tree_triggers(t);
+   int nkeep = 0;
+   for (int i = 0; i < ntriggers; i++) {
+      if (!prune_is_const(tree_trigger(t, i)))
+         nkeep++;
+   }
+
+   assert(nkeep > 0);
+
+   if (nkeep == ntriggers)
+      return t;
+
+   tree_t w = tree_new(T_WAIT);
+   tree_set_ident(w, tree_ident(t));
+   tree_set_loc(w, tree_loc(t));
+   if (tree_attr_int(t, static_i, 0))
+      tree_add_attr_int(w, static_i, 1);
+
+   for (int i = 0; i < ntriggers; i++) {
+      tree_t trigger = tree_trigger(t, i);
+      if (!prune_is_const(trigger))
+         tree_add_trigger(w, trigger);
+   }
+
+   return w;
+}
+
+static tree_t prune_const_rewrite_fn(tree_t t, void *_ctx)
+{
+   prune_const_ctx_t *ctx = _ctx;
+
+   switch (tree_kind(t)) {
+   case T_REF:
+      {
+         tree_t value = hash_get(ctx->consts, tree_ref(t));
+         if (value == NULL || hash_get(ctx->targets, t) != NULL)
+            return t;
+         else
+            return value;
+      }
+   case T_WAIT:
+      return prune_const_wait(t, ctx);
+   default:
+      return t;
+   }
+}
+
+static bool prune_transparent_resolution(type_t type)
+{
+   // A resolution function called with a single driver need not return
+   // the value of that driver so only those known to do so are allowed
+
+   while (type_is_array(type)
+          && (type_kind(type) != T_SUBTYPE || !type_has_resolution(type)))
+      type = type_elem(type);
+
+   if (type_kind(type) != T_SUBTYPE || !type_has_resolution(type))
+      return true;
+
+   tree_t fdecl = tree_ref(type_resolution(type));
+   return tree_ident(fdecl) == ident_new("IEEE.STD_LOGIC_1164.RESOLVED");
+}
+
+static void prune_constants(tree_t top, hash_t *keep, int nnets)
+{
+   // Signals driven only by a concurrent assignment of a constant are
+   // replaced by that value everywhere they are read: the assignment
+   // and signal are then removed by the main pass as neither is needed
+
+   prune_const_scan_t scan = {
+      .cls     = hash_new(1024, true),
+      .bad     = hash_new(256, true),
+      .drivers = hash_new(1024, true)
+   };
+
+   // Port maps give signals in different instances the same nets so
+   // group together declarations with identical nets and poison any
+   // which overlap partially
+
+   tree_t *owner = xcalloc(MAX(nnets, 1) * sizeof(tree_t));
+
+   const int ndecls = tree_decls(top);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top, i);
+      if (tree_kind(d) != T_SIGNAL_DECL) {
+         tree_visit_only(d, prune_const_decl_fn, &scan, T_REF);
+         continue;
+      }
+
+      const int dnets = tree_nets(d);
+      if (dnets == 0)
+         continue;
+
+      tree_t root = owner[tree_net(d, 0)];
+      if (root == NULL) {
+         hash_put(scan.cls, d, d);
+         for (int j = 0; j < dnets; j++) {
+            const netid_t nid = tree_net(d, j);
+            if (owner[nid] != NULL) {
+               hash_put(scan.bad, owner[nid], owner[nid]);
+               hash_put(scan.bad, d, d);
+            }
+            else
+               owner[nid] = d;
+         }
+      }
+      else {
+         hash_put(scan.cls, d, root);
+
+         bool same = tree_nets(root) == dnets;
+         for (int j = 0; same && j < dnets; j++)
+            same = tree_net(root, j) == tree_net(d, j);
+
+         if (!same)
+            hash_put(scan.bad, root, root);
+      }
+
+      if (hash_get(keep, d) != NULL)
+         hash_put(scan.bad, hash_get(scan.cls, d), d);
+      else if (!prune_transparent_resolution(tree_type(d)))
+         hash_put(scan.bad, hash_get(scan.cls, d), d);
+   }
+
+   free(owner);
+
+   const int nstmts = tree_stmts(top);
+   for (int i = 0; i < nstmts; i++) {
+      tree_t s = tree_stmt(top, i);
+
+      prune_driver_ctx_t dctx = {
+         .scan = &scan,
+         .proc = s
+      };
+      tree_visit_only(s, prune_const_driver_fn, &dctx, T_SIGNAL_ASSIGN);
+      tree_visit(s, prune_const_uses_fn, &scan);
+   }
+
+   prune_const_ctx_t ctx = {
+      .consts  = hash_new(256, true),
+      .targets = hash_new(256, true),
+      .waits   = hash_new(256, true)
+   };
+
+   hash_t *values = hash_new(256, true);
+   int nconsts = 0;
+
+   for (int i = 0; i < nstmts; i++) {
+      tree_t s = tree_stmt(top, i), target;
+      tree_t value = prune_const_value(s, &target);
+      if (value == NULL)
+         continue;
+
+      tree_t root = hash_get(scan.cls, tree_ref(target));
+      if (root == NULL || hash_get(scan.bad, root) != NULL)
+         continue;
+      else if (hash_get(scan.drivers, root) != s)
+         continue;
+
+      hash_put(values, root, value);
+      hash_put(ctx.targets, target, target);
+      nconsts++;
+   }
+
+   if (nconsts > 0) {
+      // Readers see the initial value before the driver first runs so
+      // the constant can only replace a signal that starts with it
+
+      for (int i = 0; i < ndecls; i++) {
+         tree_t d = tree_decl(top, i);
+         if (tree_kind(d) != T_SIGNAL_DECL || !tree_has_value(d))
+            continue;
+
+         tree_t root = hash_get(scan.cls, d);
+         tree_t value = (root != NULL) ? hash_get(values, root) : NULL;
+         if (value != NULL && prune_same_const(value, tree_value(d)))
+            hash_put(ctx.consts, d, value);
+      }
+
+      for (int i = 0; i < nstmts; i++) {
+         tree_t s = tree_stmt(top, i);
+
+         tree_t w = prune_comb_wait(s, &ctx);
+         if (w != NULL)
+            hash_put(ctx.waits, w, w);
+
+         tree_visit_only(s, prune_const_protect_fn, &ctx, T_WAIT);
+      }
+
+      tree_rewrite(top, prune_const_rewrite_fn, &ctx);
+
+      // Fold any expressions which are now constant
+      simplify(top);
+
+      if (opt_get_int("verbose"))
+         notef("propagated %d constant signals", nconsts);
+   }
+
+   hash_free(values);
+   hash_free(ctx.consts);
+   hash_free(ctx.targets);
+   hash_free(ctx.waits);
+   hash_free(scan.cls);
+   hash_free(scan.bad);
+   hash_free(scan.drivers);
+}
+
+void prune_design(tree_t top)
+{
+   const int nnets = tree_attr_int(top, nnets_i, 0);
+   bool *live = xcalloc(MAX(nnets, 1) * sizeof(bool));
+   hash_t *keep = hash_new(1024, true);
+
+   prune_seed_ctx_t seed = {
+      .live = live,
+      .keep = keep
+   };
+
+   // Ports of the top-level entity can be read with VHPI or dumped to
+   // a waveform, package signals may be read by code compiled with the
+   // package, and any signal named by another declaration is needed
+   // for that declaration to make sense
+
+   const int ndecls = tree_decls(top);
+   int depth = 0, package_depth = 0;
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top, i);
+
+      switch (tree_kind(d)) {
+      case T_HIER:
+         depth++;
+         if (package_depth == 0 && tree_subkind(d) == T_PACKAGE)
+            package_depth = depth;
+         break;
+      case T_SIGNAL_DECL:
+         if (package_depth > 0)
+            prune_mark_decl(d, live, keep);
+         else if (depth == 1 && tree_attr_int(d, fst_dir_i, -1) != -1)
+            prune_mark_decl(d, live, keep);
+         break;
+      default:
+         tree_visit_only(d, prune_seed_visit_fn, &seed, T_REF);
+         break;
+      }
+
+      depth -= tree_attr_int(d, scope_pop_i, 0);
+      if (depth < package_depth)
+         package_depth = 0;
+   }
+
+   prune_constants(top, keep, nnets);
+
+   const int nstmts = tree_stmts(top);
+   prune_proc_t *procs = xcalloc(MAX(nstmts, 1) * sizeof(prune_proc_t));
+   for (int i = 0; i < nstmts; i++)
+      prune_scan_proc(tree_stmt(top, i), &(procs[i]));
+
+   // A process is needed if it has an observable effect itself or it
+   // drives a net that is needed and then all the nets it reads are
+   // also needed: iterate until no more processes are added
+
+   bool changed;
+   do {
+      changed = false;
+      for (int i = 0; i < nstmts; i++) {
+         prune_proc_t *p = &(procs[i]);
+         if (p->live)
+            continue;
+
+         bool needed = p->sink;
+         for (unsigned j = 0; !needed && j < p->drives.count; j++)
+            needed = prune_any_live(p->drives.items[j], live);
+
+         if (!needed)
+            continue;
+
+         p->live = changed = true;
+
+         for (unsigned j = 0; j < p->reads.count; j++)
+            prune_mark_decl(p->reads.items[j], live, keep);
+
+         for (unsigned j = 0; j < p->drives.count; j++)
+            hash_put(keep, p->drives.items[j], p->drives.items[j]);
+      }
+   } while (changed);
+
+   hash_t *dead = hash_new(1024, true);
+   for (int i = 0; i < nstmts; i++) {
+      if (!procs[i].live)
+         hash_put(dead, procs[i].proc, procs[i].proc);
+
+      free(procs[i].reads.items);
+      free(procs[i].drives.items);
+   }
+   free(procs);
+
+   // The last declaration in each scope records how many scopes it
+   // closes so this must move to the previous declaration we keep
+
+   tree_t last = NULL;
+   const int nkept = tree_decls(top);
+   for (int i = 0; i < nkept; i++) {
+      tree_t d = tree_decl(top, i);
+      const bool remove =
+         tree_kind(d) == T_SIGNAL_DECL
+         && hash_get(keep, d) == NULL
+         && !prune_any_live(d, live);
+
+      if (!remove) {
+         last = d;
+         continue;
+      }
+
+      hash_put(dead, d, d);
+
+      const int pop = tree_attr_int(d, scope_pop_i, 0);
+      if (pop > 0) {
+         assert(last != NULL);   // Scope always begins with a T_HIER
+         tree_add_attr_int(last, scope_pop_i,
+                           tree_attr_int(last, scope_pop_i, 0) + pop);
+      }
+   }
+
+   prune_rewrite_ctx_t ctx = {
+      .dead = dead
+   };
+   tree_rewrite(top, prune_rewrite_fn, &ctx);
+
+   if (opt_get_int("verbose"))
+      notef("pruned %d processes and %d signals", ctx.nprocs, ctx.nsignals);
+
+   hash_free(dead);
+   hash_free(keep);
+   free(live);
+}
@@ -18,52 +18,231 @@
 #include "alloc.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Profiling shows a large proportion of simulation time is spent in
-// malloc and free. These routines provide a stack-based fixed-size
-// allocator that is faster and has better cache locality.
+// malloc and free. These routines provide a fixed-size allocator that
+// is faster and has better cache locality.
+//
+// Each thread has a pair of magazines for every stack as described in
+// Bonwick and Adams "Magazines and Vmem". A thread only goes to the
+// depot when both of its magazines are empty on allocation or both are
+// full on free. The depot lists are Treiber stacks whose heads pack a
+// magazine index in the low 32 bits with a generation count in the
+// high 32 bits to avoid the ABA problem. Magazines are never freed
+// until the stack is destroyed so a stale index is always safe to
+// dereference.
 
-#define INIT_ITEMS 128
+#define INIT_ITEMS   128
+#define SEGMENT_BITS 12
+#define SEGMENT_SIZE (1 << SEGMENT_BITS)
+#define MAX_SEGMENTS 256
 
 struct rt_chunk {
    void       *ptr;
    rt_chunk_t *next;
 };
 
-static void rt_alloc_add_objects(rt_alloc_stack_t s, size_t n)
+__thread rt_mag_cache_t *rt_mag_caches[RT_MAX_STACKS];
+
+static pthread_mutex_t  ids_lock = PTHREAD_MUTEX_INITIALIZER;
+static rt_alloc_stack_t ids[RT_MAX_STACKS];
+
+static rt_magazine_t *rt_mag_at(rt_alloc_stack_t s, uint32_t index)
+{
+   const uint32_t pos = index - 1;
+   rt_magazine_t **seg =
+      __atomic_load_n(&(s->segments[pos >> SEGMENT_BITS]), __ATOMIC_ACQUIRE);
+   return seg[pos & (SEGMENT_SIZE - 1)];
+}
+
+static rt_magazine_t *rt_mag_new(rt_alloc_stack_t s)
 {
-   rt_chunk_t *c = xmalloc(sizeof(rt_chunk_t));
-   c->next = s->chunks;
-   c->ptr  = xmalloc(n * s->item_sz);
+   // Caller must hold the stack lock
+
+   const uint32_t pos = s->n_mags;
+   if (pos == MAX_SEGMENTS * SEGMENT_SIZE)
+      fatal("too many objects allocated from %s stack", s->name);
+
+   if (s->segments[pos >> SEGMENT_BITS] == NULL) {
+      rt_magazine_t **seg = xcalloc(sizeof(rt_magazine_t *) * SEGMENT_SIZE);
+      __atomic_store_n(&(s->segments[pos >> SEGMENT_BITS]), seg,
+                       __ATOMIC_RELEASE);
+   }
+
+   rt_magazine_t *m = xmalloc(sizeof(rt_magazine_t));
+   m->index = pos + 1;
+   m->next  = 0;
+   m->count = 0;
 
-   char *p = c->ptr;
-   for (int i = 0; i < n; i++, p += s->item_sz)
-      rt_free(s, p);
+   s->segments[pos >> SEGMENT_BITS][pos & (SEGMENT_SIZE - 1)] = m;
+   __atomic_store_n(&(s->n_mags), pos + 1, __ATOMIC_RELEASE);
 
-   s->chunks = c;
+   return m;
+}
+
+static rt_magazine_t *rt_mag_filled(rt_alloc_stack_t s)
+{
+   // Create a new magazine full of fresh objects carved from a chunk
+   // that doubles in size each time it is exhausted
+
+   pthread_mutex_lock(&(s->lock));
+
+   rt_magazine_t *m = rt_mag_new(s);
+
+   for (int i = 0; i < RT_MAG_SIZE; i++) {
+      if (s->carve_left == 0) {
+         const size_t nitems = MAX(INIT_ITEMS, s->total_items);
+
+         rt_chunk_t *c = xmalloc(sizeof(rt_chunk_t));
+         c->next = s->chunks;
+         c->ptr  = xmalloc(nitems * s->item_sz);
+
+         s->chunks      = c;
+         s->carve       = c->ptr;
+         s->carve_left  = nitems;
+         s->total_items += nitems;
+      }
+
+      m->items[m->count++] = s->carve;
+      s->carve += s->item_sz;
+      s->carve_left--;
+   }
+
+   pthread_mutex_unlock(&(s->lock));
+   return m;
+}
+
+static rt_magazine_t *rt_mag_empty(rt_alloc_stack_t s)
+{
+   pthread_mutex_lock(&(s->lock));
+   rt_magazine_t *m = rt_mag_new(s);
+   pthread_mutex_unlock(&(s->lock));
+   return m;
+}
+
+static rt_magazine_t *rt_depot_pop(rt_alloc_stack_t s, uint64_t *head)
+{
+   uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+   for (;;) {
+      const uint32_t index = old & UINT32_MAX;
+      if (index == 0)
+         return NULL;
+
+      rt_magazine_t *m = rt_mag_at(s, index);
+      const uint32_t next = __atomic_load_n(&(m->next), __ATOMIC_RELAXED);
+      const uint64_t new = ((old >> 32) + 1) << 32 | next;
+
+      if (__atomic_compare_exchange_n(head, &old, new, true,
+                                      __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+         return m;
+   }
+}
+
+static void rt_depot_push(uint64_t *head, rt_magazine_t *m)
+{
+   uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+   for (;;) {
+      __atomic_store_n(&(m->next), old & UINT32_MAX, __ATOMIC_RELAXED);
+      const uint64_t new = ((old >> 32) + 1) << 32 | m->index;
+
+      if (__atomic_compare_exchange_n(head, &old, new, true,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+         return;
+   }
+}
+
+static rt_mag_cache_t *rt_mag_cache(rt_alloc_stack_t s)
+{
+   rt_mag_cache_t *c = rt_mag_caches[s->id];
+   if (likely(c != NULL))
+      return c;
+
+   // First use of this stack on the current thread
+
+   c = xmalloc(sizeof(rt_mag_cache_t));
+   c->live = 0;
+
+   if ((c->loaded = rt_depot_pop(s, &(s->full))) == NULL)
+      c->loaded = rt_mag_filled(s);
+
+   if ((c->previous = rt_depot_pop(s, &(s->empty))) == NULL)
+      c->previous = rt_mag_empty(s);
+
+   pthread_mutex_lock(&(s->lock));
+   c->next = s->caches;
+   s->caches = c;
+   pthread_mutex_unlock(&(s->lock));
+
+   return (rt_mag_caches[s->id] = c);
+}
+
+static void rt_mag_flush_stats(rt_alloc_stack_t s, rt_mag_cache_t *c)
+{
+   // The live count is only published when a thread visits the slow
+   // path so the peak may be underestimated by a few magazines
+
+   const int64_t live =
+      __atomic_add_fetch(&(s->live), c->live, __ATOMIC_RELAXED);
+   c->live = 0;
+
+   int64_t peak = __atomic_load_n(&(s->peak), __ATOMIC_RELAXED);
+   while (live > peak) {
+      if (__atomic_compare_exchange_n(&(s->peak), &peak, live, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+         break;
+   }
+
+   __atomic_add_fetch(&(s->slow_hits), 1, __ATOMIC_RELAXED);
 }
 
 rt_alloc_stack_t rt_alloc_stack_new(size_t size, const char *name)
 {
-   struct rt_alloc_stack *s = xmalloc(sizeof(struct rt_alloc_stack));
-   s->stack     = xmalloc(sizeof(void *) * INIT_ITEMS);
-   s->stack_sz  = INIT_ITEMS;
-   s->stack_top = 0;
-   s->item_sz   = size;
-   s->name      = name;
-   s->chunks    = NULL;
+   struct rt_alloc_stack *s = xcalloc(sizeof(struct rt_alloc_stack));
+   s->item_sz  = size;
+   s->name     = name;
+   s->segments = xcalloc(sizeof(rt_magazine_t **) * MAX_SEGMENTS);
+
+   pthread_mutex_init(&(s->lock), NULL);
 
-   rt_alloc_add_objects(s, INIT_ITEMS);
+   pthread_mutex_lock(&ids_lock);
+   for (s->id = 0; s->id < RT_MAX_STACKS && ids[s->id] != NULL; s->id++)
+      ;
+   if (s->id == RT_MAX_STACKS)
+      fatal_trace("too many allocation stacks");
+   ids[s->id] = s;
+   pthread_mutex_unlock(&ids_lock);
+
+   rt_mag_caches[s->id] = NULL;
 
    return s;
 }
 
 void rt_alloc_stack_destroy(rt_alloc_stack_t s)
 {
-   if (s->stack_top != s->stack_sz)
-      fatal("memory leak of %zu items from %s stack",
-            s->stack_sz - s->stack_top, s->name);
+   // All other threads using this stack must have exited
+
+   rt_alloc_stats_t stats;
+   rt_alloc_stack_stats(s, &stats);
+
+   if (stats.live != 0)
+      fatal("memory leak of %"PRIi64" items from %s stack",
+            stats.live, s->name);
+
+   while (s->caches != NULL) {
+      rt_mag_cache_t *tmp = s->caches->next;
+      free(s->caches);
+      s->caches = tmp;
+   }
+
+   for (uint32_t i = 0; i < s->n_mags; i++)
+      free(rt_mag_at(s, i + 1));
+
+   for (int i = 0; i < MAX_SEGMENTS; i++)
+      free(s->segments[i]);
+   free(s->segments);
 
    while (s->chunks != NULL) {
       rt_chunk_t *tmp = s->chunks->next;
@@ -72,18 +251,83 @@ void rt_alloc_stack_destroy(rt_alloc_stack_t s)
       s->chunks = tmp;
    }
 
-   free(s->stack);
+   rt_mag_caches[s->id] = NULL;
+
+   pthread_mutex_lock(&ids_lock);
+   ids[s->id] = NULL;
+   pthread_mutex_unlock(&ids_lock);
+
+   pthread_mutex_destroy(&(s->lock));
    free(s);
 }
 
+void rt_alloc_stack_stats(rt_alloc_stack_t s, rt_alloc_stats_t *stats)
+{
+   pthread_mutex_lock(&(s->lock));
+
+   int64_t live = __atomic_load_n(&(s->live), __ATOMIC_RELAXED);
+   for (rt_mag_cache_t *c = s->caches; c != NULL; c = c->next)
+      live += c->live;
+
+   stats->name      = s->name;
+   stats->live      = live;
+   stats->peak      = MAX(live, __atomic_load_n(&(s->peak), __ATOMIC_RELAXED));
+   stats->slow_hits = __atomic_load_n(&(s->slow_hits), __ATOMIC_RELAXED);
+   stats->magazines = s->n_mags;
+
+   pthread_mutex_unlock(&(s->lock));
+}
+
 void *rt_alloc_slow(rt_alloc_stack_t s)
 {
-   if (s->stack_top == 0) {
-      s->stack_sz *= 2;
-      s->stack = xrealloc(s->stack, sizeof(void *) * s->stack_sz);
+   rt_mag_cache_t *c = rt_mag_cache(s);
+
+   if (c->loaded->count == 0) {
+      rt_mag_flush_stats(s, c);
+
+      if (c->previous->count > 0) {
+         rt_magazine_t *tmp = c->loaded;
+         c->loaded = c->previous;
+         c->previous = tmp;
+      }
+      else {
+         rt_magazine_t *full = rt_depot_pop(s, &(s->full));
+         if (full == NULL)
+            full = rt_mag_filled(s);
+
+         rt_depot_push(&(s->empty), c->previous);
+         c->previous = c->loaded;
+         c->loaded = full;
+      }
+   }
+
+   c->live++;
+   return c->loaded->items[--c->loaded->count];
+}
+
+void rt_free_slow(rt_alloc_stack_t s, void *ptr)
+{
+   rt_mag_cache_t *c = rt_mag_cache(s);
+
+   if (c->loaded->count == RT_MAG_SIZE) {
+      rt_mag_flush_stats(s, c);
+
+      if (c->previous->count < RT_MAG_SIZE) {
+         rt_magazine_t *tmp = c->loaded;
+         c->loaded = c->previous;
+         c->previous = tmp;
+      }
+      else {
+         rt_magazine_t *empty = rt_depot_pop(s, &(s->empty));
+         if (empty == NULL)
+            empty = rt_mag_empty(s);
 
-      rt_alloc_add_objects(s, s->stack_sz / 2);
+         rt_depot_push(&(s->full), c->previous);
+         c->previous = c->loaded;
+         c->loaded = empty;
+      }
    }
 
-   return s->stack[--s->stack_top];
+   c->live--;
+   c->loaded->items[c->loaded->count++] = ptr;
 }
@@ -21,37 +21,92 @@
 #include "util.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
 
-typedef struct rt_chunk rt_chunk_t;
+// Objects are cached in per-thread magazines of RT_MAG_SIZE items so
+// the common case of alloc and free touches only thread local data.
+// Full and empty magazines are exchanged with a lock-free depot shared
+// by all threads.
 
-struct rt_alloc_stack {
-   void      **stack;
-   size_t      stack_sz;
-   size_t      stack_top;
-   size_t      item_sz;
+#define RT_MAG_SIZE   64
+#define RT_MAX_STACKS 16
+
+typedef struct rt_chunk     rt_chunk_t;
+typedef struct rt_magazine  rt_magazine_t;
+typedef struct rt_mag_cache rt_mag_cache_t;
+
+struct rt_magazine {
+   uint32_t  index;
+   uint32_t  next;
+   unsigned  count;
+   void     *items[RT_MAG_SIZE];
+};
+
+struct rt_mag_cache {
+   rt_magazine_t  *loaded;
+   rt_magazine_t  *previous;
+   int64_t         live;
+   rt_mag_cache_t *next;
+};
+
+typedef struct {
    const char *name;
-   rt_chunk_t *chunks;
+   int64_t     live;
+   int64_t     peak;
+   uint64_t    slow_hits;
+   uint32_t    magazines;
+} rt_alloc_stats_t;
+
+struct rt_alloc_stack {
+   unsigned          id;
+   size_t            item_sz;
+   const char       *name;
+   uint64_t          full;
+   uint64_t          empty;
+   rt_magazine_t  ***segments;
+   uint32_t          n_mags;
+   int64_t           live;
+   int64_t           peak;
+   uint64_t          slow_hits;
+   pthread_mutex_t   lock;
+   rt_chunk_t       *chunks;
+   char             *carve;
+   size_t            carve_left;
+   size_t            total_items;
+   rt_mag_cache_t   *caches;
 };
 
 typedef struct rt_alloc_stack *rt_alloc_stack_t;
 
+extern __thread rt_mag_cache_t *rt_mag_caches[RT_MAX_STACKS];
+
 rt_alloc_stack_t rt_alloc_stack_new(size_t size, const char *name);
 void rt_alloc_stack_destroy(rt_alloc_stack_t stack);
+void rt_alloc_stack_stats(rt_alloc_stack_t stack, rt_alloc_stats_t *stats);
 void *rt_alloc_slow(rt_alloc_stack_t stack);
+void rt_free_slow(rt_alloc_stack_t stack, void *ptr);
 
 static inline void *rt_alloc(rt_alloc_stack_t s)
 {
-   if (unlikely(s->stack_top == 0))
-      return rt_alloc_slow(s);
+   rt_mag_cache_t *c = rt_mag_caches[s->id];
+   if (likely(c != NULL && c->loaded->count > 0)) {
+      c->live++;
+      return c->loaded->items[--c->loaded->count];
+   }
    else
-      return s->stack[--s->stack_top];
+      return rt_alloc_slow(s);
 }
 
 static inline void rt_free(rt_alloc_stack_t s, void *ptr)
 {
-   assert(s->stack_top < s->stack_sz);
-
-   s->stack[s->stack_top++] = ptr;
+   rt_mag_cache_t *c = rt_mag_caches[s->id];
+   if (likely(c != NULL && c->loaded->count < RT_MAG_SIZE)) {
+      c->live--;
+      c->loaded->items[c->loaded->count++] = ptr;
+   }
+   else
+      rt_free_slow(s, ptr);
 }
 
 #endif  // _RT_ALLOC_H
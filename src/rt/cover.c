@@ -17,11 +17,18 @@
 
 #include "util.h"
 #include "cover.h"
+#include "lib.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <inttypes.h>
 
 #if 0
 #define CSS_DIR "/home/nick/nvc/data/"
@@ -32,6 +39,29 @@
 #define PERCENT_RED    50.0f
 #define PERCENT_ORANGE 90.0f
 
+#define COVER_DB_MAGIC   0x564f434e   // "NCOV"
+#define COVER_DB_VERSION 1
+
+// The database header is followed by the unit name padded to a multiple
+// of four bytes and then the statement and condition arrays
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t hash;
+   uint32_t nstmts;
+   uint32_t nconds;
+   uint32_t namelen;
+} cover_db_hdr_t;
+
+typedef struct {
+   void                 *map;
+   size_t                size;
+   const cover_db_hdr_t *hdr;
+   const char           *name;
+   const int32_t        *stmts;
+   const int32_t        *conds;
+} cover_db_t;
+
 typedef struct cover_hl cover_hl_t;
 typedef struct cover_file cover_file_t;
 
@@ -57,6 +87,8 @@ typedef struct {
 
 struct cover_file {
    const char   *name;
+   char         *url;
+   uint64_t      mtime;
    cover_line_t *lines;
    unsigned      n_lines;
    unsigned      alloc_lines;
@@ -84,6 +116,13 @@ typedef struct {
    const int32_t *conds;
 } report_ctx_t;
 
+typedef struct {
+   cover_file_t **files;
+   int            nfiles;
+   int            next;
+   const char    *dir;
+} report_job_t;
+
 static ident_t       stmt_tag_i;
 static ident_t       cond_tag_i;
 static ident_t       sub_cond_i;
@@ -198,6 +237,17 @@ static void cover_append_line(cover_file_t *f, const char *buf)
    l->hl   = NULL;
 }
 
+static char *cover_make_url(const char *name)
+{
+   char buf[256];
+   checked_sprintf(buf, sizeof(buf) - 6, "report_%s.html", name);
+   for (char *p = buf; *(p + 5) != '\0'; p++) {
+      if (*p == '/' || *p == '.')
+         *p = '_';
+   }
+   return strdup(buf);
+}
+
 static cover_file_t *cover_file(const loc_t *loc)
 {
    if (loc->file == NULL)
@@ -213,6 +263,8 @@ static cover_file_t *cover_file(const loc_t *loc)
 
    f = xmalloc(sizeof(cover_file_t));
    f->name        = loc->file;
+   f->url         = cover_make_url(loc->file);
+   f->mtime       = 0;
    f->n_lines     = 0;
    f->alloc_lines = 1024;
    f->lines       = xmalloc(sizeof(cover_line_t) * f->alloc_lines);
@@ -234,6 +286,10 @@ static cover_file_t *cover_file(const loc_t *loc)
    else {
       f->valid = true;
 
+      struct stat st;
+      if (fstat(fileno(fp), &st) == 0)
+         f->mtime = ((uint64_t)st.st_mtime << 32) ^ st.st_size;
+
       while (!feof(fp)) {
          char buf[1024];
          if (fgets(buf, sizeof(buf), fp) != NULL)
@@ -403,17 +459,6 @@ static void cover_report_line(FILE *fp, cover_line_t *l)
    fprintf(fp, "</td></tr>\n");
 }
 
-static const char *cover_file_url(cover_file_t *f)
-{
-   static char buf[256];
-   checked_sprintf(buf, sizeof(buf) - 6, "report_%s.html", f->name);
-   for (char *p = buf; *(p + 5) != '\0'; p++) {
-      if (*p == '/' || *p == '.')
-         *p = '_';
-   }
-   return buf;
-}
-
 static void cover_html_header(FILE *fp, const char *title, ...)
 {
     fprintf(fp,
@@ -444,7 +489,7 @@ static void cover_html_header(FILE *fp, const char *title, ...)
     fprintf(fp, "<ul class=\"nav\">\n");
     for (cover_file_t *f = files; f != NULL; f = f->next)
       fprintf(fp, "  <li><a href=\"%s\">%s</a></li>\n",
-              cover_file_url(f), f->name);
+              f->url, f->name);
     fprintf(fp, "</ul>\n");
     fprintf(fp, "</div>\n");
 
@@ -457,13 +502,87 @@ static void cover_html_footer(FILE *fp)
    fprintf(fp, "</div></body>\n</html>\n");
 }
 
+static uint64_t cover_hash_str(uint64_t hash, const char *str)
+{
+   if (str != NULL) {
+      for (const char *p = str; *p != '\0'; p++)
+         hash = (hash ^ (uint8_t)*p) * UINT64_C(1099511628211);
+   }
+   return (hash ^ 0xff) * UINT64_C(1099511628211);
+}
+
+static uint64_t cover_hash_int(uint64_t hash, uint64_t value)
+{
+   for (int i = 0; i < 8; i++, value >>= 8)
+      hash = (hash ^ (value & 0xff)) * UINT64_C(1099511628211);
+   return hash;
+}
+
+static uint64_t cover_file_hash(cover_file_t *f)
+{
+   // Everything that affects the content of the generated page: the
+   // source text, the coverage data for this file, and the list of
+   // files in the navigation bar
+
+   uint64_t hash = UINT64_C(14695981039346656037);
+   hash = cover_hash_str(hash, PACKAGE_STRING);
+   hash = cover_hash_str(hash, f->name);
+   hash = cover_hash_int(hash, f->mtime);
+   hash = cover_hash_int(hash, f->n_lines);
+
+   for (cover_file_t *it = files; it != NULL; it = it->next)
+      hash = cover_hash_str(hash, it->name);
+
+   for (int i = 0; i < f->n_lines; i++) {
+      const cover_line_t *l = &(f->lines[i]);
+      hash = cover_hash_int(hash, l->hits);
+      for (const cover_hl_t *hl = l->hl; hl != NULL; hl = hl->next) {
+         hash = cover_hash_int(hash, hl->start);
+         hash = cover_hash_int(hash, hl->end);
+         hash = cover_hash_int(hash, hl->kind);
+         hash = cover_hash_str(hash, hl->help);
+      }
+   }
+
+   return hash;
+}
+
+static bool cover_page_unchanged(const char *path, const char *stamp)
+{
+   FILE *fp = fopen(path, "r");
+   if (fp == NULL)
+      return false;
+
+   char buf[64];
+   const bool same = fgets(buf, sizeof(buf), fp) != NULL
+      && strcmp(buf, stamp) == 0;
+
+   fclose(fp);
+   return same;
+}
+
 static void cover_report_file(cover_file_t *f, const char *dir)
 {
-   char *buf = xasprintf("%s/%s", dir, cover_file_url(f));
-   FILE *fp = lib_fopen(lib_work(), buf, "w");
+   // May be called concurrently for different files so must not use
+   // any of the library functions that return static buffers
+
+   char stamp[64];
+   checked_sprintf(stamp, sizeof(stamp), "<!-- nvc coverage %016"PRIx64
+                   " -->\n", cover_file_hash(f));
+
+   char *path LOCAL = xasprintf("%s/%s/%s", lib_path(lib_work()),
+                                dir, f->url);
+
+   // Skip pages where neither the source nor the coverage changed since
+   // the previous report
+   if (f->valid && cover_page_unchanged(path, stamp))
+      return;
+
+   FILE *fp = fopen(path, "w");
    if (fp == NULL)
-      fatal("failed to create %s", buf);
-   free(buf);
+      fatal_errno("failed to create %s", path);
+
+   fputs(stamp, fp);
 
    cover_html_header(fp, "Coverage report for %s", f->name);
 
@@ -479,6 +598,57 @@ static void cover_report_file(cover_file_t *f, const char *dir)
    fclose(fp);
 }
 
+static void *cover_report_thread(void *arg)
+{
+   report_job_t *job = arg;
+
+   for (;;) {
+      const int next = __atomic_fetch_add(&(job->next), 1, __ATOMIC_RELAXED);
+      if (next >= job->nfiles)
+         break;
+
+      cover_report_file(job->files[next], job->dir);
+   }
+
+   return NULL;
+}
+
+static void cover_report_files(const char *dir)
+{
+   int nfiles = 0;
+   for (cover_file_t *f = files; f != NULL; f = f->next)
+      nfiles++;
+
+   report_job_t job = {
+      .files  = xmalloc(MAX(nfiles, 1) * sizeof(cover_file_t *)),
+      .nfiles = nfiles,
+      .next   = 0,
+      .dir    = dir
+   };
+
+   int n = 0;
+   for (cover_file_t *f = files; f != NULL; f = f->next)
+      job.files[n++] = f;
+
+   const long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+   const int nthreads = MIN(MAX(ncpus, 1), nfiles);
+
+   pthread_t *threads = xmalloc(MAX(nthreads, 1) * sizeof(pthread_t));
+   for (int i = 1; i < nthreads; i++) {
+      if (pthread_create(&(threads[i]), NULL, cover_report_thread, &job))
+         fatal_errno("pthread_create");
+   }
+
+   // The calling thread also generates pages
+   cover_report_thread(&job);
+
+   for (int i = 1; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+
+   free(threads);
+   free(job.files);
+}
+
 static const char *cover_percent(unsigned x, unsigned y)
 {
    const float pct = ((float)x / (float)y) * 100.0f;
@@ -557,9 +727,7 @@ void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
    lib_t work = lib_work();
    lib_mkdir(work, dir);
 
-   for (cover_file_t *f = files; f != NULL; f = f->next)
-      cover_report_file(f, dir);
-
+   cover_report_files(dir);
    cover_index(name, dir);
 
    char output[PATH_MAX];
@@ -578,3 +746,186 @@ void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
    notef("%s", buf);
    free(buf);
 }
+
+static uint32_t cover_design_hash(tree_t top)
+{
+   // Tags are only stable for a single elaboration of the design
+
+   const char *name = istr(tree_ident(top));
+   const lib_mtime_t mtime = lib_mtime(lib_work(), tree_ident(top));
+
+   uint32_t hash = 2166136261u;
+   for (const char *p = name; *p != '\0'; p++)
+      hash = (hash ^ (uint8_t)*p) * 16777619u;
+   for (int i = 0; i < 8; i++)
+      hash = (hash ^ ((mtime >> (i * 8)) & 0xff)) * 16777619u;
+
+   return hash;
+}
+
+static void cover_db_save(FILE *f, const char *name, uint32_t hash,
+                          const int32_t *stmts, int nstmts,
+                          const int32_t *conds, int nconds)
+{
+   const cover_db_hdr_t hdr = {
+      .magic   = COVER_DB_MAGIC,
+      .version = COVER_DB_VERSION,
+      .hash    = hash,
+      .nstmts  = nstmts,
+      .nconds  = (conds != NULL) ? nconds : 0,
+      .namelen = strlen(name)
+   };
+
+   const char pad[4] = { 0 };
+
+   bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+   ok = ok && fwrite(name, hdr.namelen, 1, f) == 1;
+   ok = ok && fwrite(pad, -hdr.namelen & 3, 1, f) <= 1;
+   ok = ok && fwrite(stmts, sizeof(int32_t), nstmts, f) == nstmts;
+   if (hdr.nconds > 0)
+      ok = ok && fwrite(conds, sizeof(int32_t), nconds, f) == nconds;
+
+   if (!ok)
+      fatal_errno("failed to write coverage database");
+}
+
+void cover_write_db(tree_t top, const char *file,
+                    const int32_t *stmts, const int32_t *conds)
+{
+   const char *name = istr(tree_ident(top));
+
+   FILE *f;
+   if (file == NULL) {
+      char *buf = xasprintf("%s.covdb",
+                            istr(ident_strip(tree_ident(top),
+                                             ident_new(".elab"))));
+      f = lib_fopen(lib_work(), buf, "w");
+      free(buf);
+   }
+   else
+      f = fopen(file, "w");
+
+   if (f == NULL)
+      fatal_errno("failed to create coverage database");
+
+   cover_db_save(f, name, cover_design_hash(top),
+                 stmts, tree_attr_int(top, ident_new("stmt_tags"), 0),
+                 conds, tree_attr_int(top, ident_new("cond_tags"), 0));
+
+   fclose(f);
+}
+
+static void cover_db_open(const char *file, cover_db_t *db)
+{
+   int fd = open(file, O_RDONLY);
+   if (fd < 0)
+      fatal_errno("cannot open %s", file);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("cannot stat %s", file);
+
+   db->size = st.st_size;
+   if (db->size < sizeof(cover_db_hdr_t))
+      fatal("%s is not a coverage database", file);
+
+   db->map = mmap(NULL, db->size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (db->map == MAP_FAILED)
+      fatal_errno("cannot map %s", file);
+
+   close(fd);
+
+   db->hdr = db->map;
+   if (db->hdr->magic != COVER_DB_MAGIC)
+      fatal("%s is not a coverage database", file);
+   else if (db->hdr->version != COVER_DB_VERSION)
+      fatal("%s was written by an incompatible version of "PACKAGE, file);
+
+   const size_t name_off = sizeof(cover_db_hdr_t);
+   const size_t stmts_off = name_off + ((db->hdr->namelen + 3) & ~3);
+   const size_t conds_off = stmts_off + db->hdr->nstmts * sizeof(int32_t);
+   const size_t end_off = conds_off + db->hdr->nconds * sizeof(int32_t);
+
+   if (end_off != db->size)
+      fatal("coverage database %s is corrupt", file);
+
+   db->name  = (const char *)db->map + name_off;
+   db->stmts = (const int32_t *)((const char *)db->map + stmts_off);
+   db->conds = (const int32_t *)((const char *)db->map + conds_off);
+}
+
+static void cover_merge_counts(int32_t *restrict acc,
+                               const int32_t *restrict in, size_t n)
+{
+   // Written so the compiler can vectorise the saturating add
+   for (size_t i = 0; i < n; i++) {
+      const uint32_t sum = (uint32_t)acc[i] + (uint32_t)in[i];
+      acc[i] = (sum > INT32_MAX) ? INT32_MAX : sum;
+   }
+}
+
+static void cover_merge_masks(int32_t *restrict acc,
+                              const int32_t *restrict in, size_t n)
+{
+   for (size_t i = 0; i < n; i++)
+      acc[i] |= in[i];
+}
+
+void cover_merge(int nfiles, char **files, const char *output)
+{
+   assert(nfiles > 0);
+
+   cover_db_t first;
+   cover_db_open(files[0], &first);
+
+   const uint32_t nstmts = first.hdr->nstmts;
+   const uint32_t nconds = first.hdr->nconds;
+
+   int32_t *stmts = xmalloc(MAX(nstmts, 1) * sizeof(int32_t));
+   int32_t *conds = xmalloc(MAX(nconds, 1) * sizeof(int32_t));
+   memcpy(stmts, first.stmts, nstmts * sizeof(int32_t));
+   memcpy(conds, first.conds, nconds * sizeof(int32_t));
+
+   for (int i = 1; i < nfiles; i++) {
+      cover_db_t db;
+      cover_db_open(files[i], &db);
+
+      if (db.hdr->hash != first.hdr->hash || db.hdr->nstmts != nstmts
+          || db.hdr->nconds != nconds)
+         fatal("coverage database %s does not match %s", files[i], files[0]);
+
+      cover_merge_counts(stmts, db.stmts, nstmts);
+      cover_merge_masks(conds, db.conds, nconds);
+
+      munmap(db.map, db.size);
+   }
+
+   char *name LOCAL = xmalloc(first.hdr->namelen + 1);
+   memcpy(name, first.name, first.hdr->namelen);
+   name[first.hdr->namelen] = '\0';
+
+   const uint32_t hash = first.hdr->hash;
+   munmap(first.map, first.size);
+
+   if (output != NULL) {
+      FILE *f = fopen(output, "w");
+      if (f == NULL)
+         fatal_errno("failed to create %s", output);
+
+      cover_db_save(f, name, hash, stmts, nstmts, conds, nconds);
+      fclose(f);
+   }
+
+   tree_t top = lib_get(lib_work(), ident_new(name));
+   if (top == NULL)
+      fatal("cannot find unit %s in library %s", name,
+            istr(lib_name(lib_work())));
+   else if (cover_design_hash(top) != hash)
+      fatal("design unit %s has been elaborated again since the coverage "
+            "databases were written", name);
+
+   cover_report(top, stmts, (nconds > 0) ? conds : NULL);
+
+   free(stmts);
+   free(conds);
+}
@@ -21,7 +21,17 @@
 #include "util.h"
 #include "tree.h"
 
+typedef enum {
+   COVER_NONE,
+   COVER_COUNT,
+   COVER_BITMAP,
+   COVER_ONCE
+} cover_mode_t;
+
 void cover_tag(tree_t top);
 void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds);
+void cover_write_db(tree_t top, const char *file,
+                    const int32_t *stmts, const int32_t *conds);
+void cover_merge(int nfiles, char **files, const char *output);
 
 #endif  // _COVER_H
@@ -20,16 +20,21 @@
 #include "tree.h"
 #include "common.h"
 #include "fstapi.h"
+#include "waveq.h"
 
 #include <assert.h>
 
 static tree_t   fst_top;
 static void    *fst_ctx;
 static uint64_t last_time;
+static uint64_t batch_time;
+static bool     fst_async = false;
+static size_t   block_limit = 0;
+static size_t   block_bytes = 0;
 
 typedef struct fst_data fst_data_t;
 
-typedef void (*fst_fmt_fn_t)(tree_t, watch_t *, fst_data_t *);
+typedef void (*fst_fmt_fn_t)(const void *, size_t, fst_data_t *);
 
 typedef struct {
    int64_t  mult;
@@ -37,8 +42,9 @@ typedef struct {
 } fst_unit_t;
 
 typedef union {
-   const char *map;
-   fst_unit_t *units;
+   const char  *map;
+   fst_unit_t  *units;
+   const char **literals;
 } fst_type_t;
 
 struct fst_data {
@@ -52,14 +58,26 @@ struct fst_data {
 
 static void fst_close(void)
 {
+   waveq_stop();
+
    fstWriterEmitTimeChange(fst_ctx, rt_now(NULL));
    fstWriterClose(fst_ctx);
 }
 
-static void fst_fmt_int(tree_t decl, watch_t *w, fst_data_t *data)
+static uint64_t fst_raw_scalar(const void *raw, size_t size)
+{
+   switch (size) {
+   case 1: return *(const uint8_t *)raw;
+   case 2: return *(const uint16_t *)raw;
+   case 4: return *(const uint32_t *)raw;
+   case 8: return *(const uint64_t *)raw;
+   default: return 0;
+   }
+}
+
+static void fst_fmt_int(const void *raw, size_t size, fst_data_t *data)
 {
-   uint64_t val;
-   rt_watch_value(w, &val, 1, false);
+   const uint64_t val = fst_raw_scalar(raw, size);
 
    char buf[data->size + 1];
    for (size_t i = 0; i < data->size; i++)
@@ -69,10 +87,9 @@ static void fst_fmt_int(tree_t decl, watch_t *w, fst_data_t *data)
    fstWriterEmitValueChange(fst_ctx, data->handle, buf);
 }
 
-static void fst_fmt_physical(tree_t decl, watch_t *w, fst_data_t *data)
+static void fst_fmt_physical(const void *raw, size_t size, fst_data_t *data)
 {
-   uint64_t val;
-   rt_watch_value(w, &val, 1, false);
+   const uint64_t val = fst_raw_scalar(raw, size);
 
    fst_unit_t *unit = data->type.units;
    while ((val % unit->mult) != 0)
@@ -86,11 +103,16 @@ static void fst_fmt_physical(tree_t decl, watch_t *w, fst_data_t *data)
       fst_ctx, data->handle, buf, strlen(buf));
 }
 
-static void fst_fmt_chars(tree_t decl, watch_t *w, fst_data_t *data)
+static void fst_fmt_chars(const void *raw, size_t size, fst_data_t *data)
 {
+   // Each element of a character or logic array is a single byte
    const int nvals = data->size;
+   const uint8_t *vals = raw;
    char buf[nvals + 1];
-   rt_watch_string(w, data->type.map, buf, nvals + 1);
+   for (int i = 0; i < nvals; i++)
+      buf[i] = data->type.map ? data->type.map[vals[i]] : vals[i];
+   buf[nvals] = '\0';
+
    if (likely(data->type.map != NULL))
       fstWriterEmitValueChange(fst_ctx, data->handle, buf);
    else
@@ -98,28 +120,78 @@ static void fst_fmt_chars(tree_t decl, watch_t *w, fst_data_t *data)
          fst_ctx, data->handle, buf, data->size);
 }
 
-static void fst_fmt_enum(tree_t decl, watch_t *w, fst_data_t *data)
+static void fst_fmt_enum(const void *raw, size_t size, fst_data_t *data)
 {
-   uint64_t val;
-   rt_watch_value(w, &val, 1, false);
-
-   tree_t lit = type_enum_literal(tree_type(decl), val);
-   const char *str = istr(tree_ident(lit));
+   const uint64_t val = fst_raw_scalar(raw, size);
+   const char *str = data->type.literals[val];
 
    fstWriterEmitVariableLengthValueChange(
       fst_ctx, data->handle, str, strlen(str));
 }
 
-static void fst_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
+static void fst_time_change(uint64_t now)
 {
    if (now != last_time) {
+      if (block_limit > 0 && block_bytes >= block_limit) {
+         // Start a new block so it can be compressed while the next one
+         // is being filled
+         fstWriterFlushContext(fst_ctx);
+         block_bytes = 0;
+      }
+
       fstWriterEmitTimeChange(fst_ctx, now);
       last_time = now;
    }
+}
+
+static void fst_emit(uint64_t now, void *user, const void *raw, size_t size)
+{
+   // Called on the writer thread in asynchronous mode so must not
+   // access any kernel or tree state
+
+   fst_time_change(now);
 
    fst_data_t *data = user;
-   if (likely(data != NULL))
-      (*data->fmt)(decl, w, data);
+   (*data->fmt)(raw, size, data);
+
+   block_bytes += size;
+}
+
+static void fst_time_cb(uint64_t now)
+{
+   if (fst_async)
+      batch_time = now;
+   else
+      fst_time_change(now);
+}
+
+static void fst_value_cb(watch_t *w, void *user)
+{
+   if (fst_async)
+      waveq_push(batch_time, user, w);
+   else {
+      const size_t size = rt_watch_bytes(w);
+      uint8_t raw[size];
+      rt_watch_copy(w, raw);
+
+      fst_data_t *data = user;
+      (*data->fmt)(raw, size, data);
+
+      block_bytes += size;
+   }
+}
+
+static const char **fst_make_literal_map(type_t type)
+{
+   type_t base = type_base_recur(type);
+
+   const int nlits = type_enum_literals(base);
+
+   const char **map = xmalloc(nlits * sizeof(const char *));
+   for (int i = 0; i < nlits; i++)
+      map[i] = istr(tree_ident(type_enum_literal(base, i)));
+
+   return map;
 }
 
 static fst_unit_t *fst_make_unit_map(type_t type)
@@ -254,6 +326,7 @@ static void fst_process_signal(tree_t d)
             vt = FST_VT_GEN_STRING;
             data->size = 0;
             data->fmt  = fst_fmt_enum;
+            data->type.literals = fst_make_literal_map(type);
          }
          else
             data->size = 1;
@@ -306,7 +379,7 @@ static void fst_process_signal(tree_t d)
 
    tree_add_attr_ptr(d, fst_data_i, data);
 
-   data->watch = rt_set_event_cb(d, fst_event_cb, data, true);
+   data->watch = wave_watch(d, data);
 }
 
 static void fst_process_hier(tree_t h)
@@ -360,13 +433,14 @@ void fst_restart(void)
    }
 
    last_time = UINT64_MAX;
+   fst_time_cb(0);
 
    for (int i = 0; i < ndecls; i++) {
       tree_t d = tree_decl(fst_top, i);
       if (tree_kind(d) == T_SIGNAL_DECL) {
          fst_data_t *data = tree_attr_ptr(d, fst_data_i);
-         if (likely(data != NULL))
-            fst_event_cb(0, d, data->watch, data);
+         if (likely(data != NULL) && data->watch != NULL)
+            fst_value_cb(data->watch, data);
       }
    }
 }
@@ -379,11 +453,25 @@ void fst_init(const char *file, tree_t top)
    fstWriterSetFileType(fst_ctx, FST_FT_VHDL);
    fstWriterSetTimescale(fst_ctx, -15);
    fstWriterSetVersion(fst_ctx, PACKAGE_STRING);
-   fstWriterSetPackType(fst_ctx, 0);
-   fstWriterSetRepackOnClose(fst_ctx, 1);
-   fstWriterSetParallelMode(fst_ctx, 0);
+   fstWriterSetPackType(fst_ctx, opt_get_int("fst-pack"));
+   fstWriterSetRepackOnClose(fst_ctx, opt_get_int("fst-repack"));
+
+   const bool parallel = opt_get_int("fst-parallel");
+#ifndef FST_WRITER_PARALLEL
+   if (parallel)
+      fatal("parallel FST compression requires NVC to be configured with "
+            "--enable-fst-pthread");
+#endif
+   fstWriterSetParallelMode(fst_ctx, parallel);
+
+   block_limit = opt_get_int("fst-block");
 
    atexit(fst_close);
 
    fst_top = top;
+
+   wave_set_emitter(fst_time_cb, fst_value_cb);
+
+   if ((fst_async = opt_get_int("wave-async")))
+      waveq_start(fst_emit);
 }
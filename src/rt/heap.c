@@ -26,8 +26,9 @@
 #define RIGHT(i)  ((i << 1) + 1)
 
 struct node {
-   void     *user;
-   uint64_t key;
+   void        *user;
+   uint64_t     key;
+   heap_slot_t *slot;
 };
 
 struct heap {
@@ -39,12 +40,22 @@ struct heap {
 #define NODE(h, i) (h->nodes[i - 1])
 #define KEY(h, i)  (NODE(h, i).key)
 #define USER(h, i) (NODE(h, i).user)
+#define SLOT(h, i) (NODE(h, i).slot)
+
+static inline void update_slot(heap_t h, size_t i)
+{
+   if (SLOT(h, i) != NULL)
+      *SLOT(h, i) = i;
+}
 
 static inline void exchange(heap_t h, size_t i, size_t j)
 {
    struct node tmp = NODE(h, j);
    NODE(h, j) = NODE(h, i);
    NODE(h, i) = tmp;
+
+   update_slot(h, i);
+   update_slot(h, j);
 }
 
 static void min_heapify(heap_t h, size_t i)
@@ -82,6 +93,25 @@ static inline void heap_decrease_key(heap_t h, size_t i, uint64_t key)
    }
 }
 
+static void heap_remove(heap_t h, size_t i)
+{
+   if (SLOT(h, i) != NULL)
+      *SLOT(h, i) = 0;
+
+   NODE(h, i) = NODE(h, h->size);
+   --(h->size);
+
+   if (i <= h->size) {
+      update_slot(h, i);
+
+      // The replacement may need to move either up or down the heap
+      if (i > 1 && KEY(h, PARENT(i)) > KEY(h, i))
+         heap_decrease_key(h, i, KEY(h, i));
+      else
+         min_heapify(h, i);
+   }
+}
+
 heap_t heap_new(size_t init_size)
 {
    struct heap *h = xmalloc(sizeof(struct heap));
@@ -103,9 +133,7 @@ void *heap_extract_min(heap_t h)
       fatal_trace("heap underflow");
 
    void *min = USER(h, 1);
-   NODE(h, 1) = NODE(h, h->size);
-   --(h->size);
-   min_heapify(h, 1);
+   heap_remove(h, 1);
    return min;
 }
 
@@ -118,6 +146,11 @@ void *heap_min(heap_t h)
 }
 
 void heap_insert(heap_t h, uint64_t key, void *user)
+{
+   heap_insert_slot(h, key, user, NULL);
+}
+
+void heap_insert_slot(heap_t h, uint64_t key, void *user, heap_slot_t *slot)
 {
    if (unlikely(h->size == h->max_size)) {
       h->max_size *= 2;
@@ -128,10 +161,20 @@ void heap_insert(heap_t h, uint64_t key, void *user)
 
    KEY(h, h->size) = UINT64_MAX;
    USER(h, h->size) = user;
+   SLOT(h, h->size) = slot;
 
+   update_slot(h, h->size);
    heap_decrease_key(h, h->size, key);
 }
 
+void heap_delete(heap_t h, heap_slot_t slot)
+{
+   if (unlikely(slot < 1 || slot > h->size))
+      fatal_trace("invalid heap slot %zu", (size_t)slot);
+
+   heap_remove(h, slot);
+}
+
 size_t heap_size(heap_t h)
 {
    return h->size;
@@ -23,6 +23,10 @@
 
 typedef struct heap *heap_t;
 
+// Position of an entry that can be used to delete it later: zero when
+// the entry is no longer in the queue
+typedef uintptr_t heap_slot_t;
+
 typedef void (*heap_walk_fn_t)(uint64_t key, void *user, void *context);
 
 heap_t heap_new(size_t init_size);
@@ -30,6 +34,8 @@ void heap_free(heap_t h);
 void *heap_extract_min(heap_t h);
 void *heap_min(heap_t h);
 void heap_insert(heap_t h, uint64_t key, void *user);
+void heap_insert_slot(heap_t h, uint64_t key, void *user, heap_slot_t *slot);
+void heap_delete(heap_t h, heap_slot_t slot);
 size_t heap_size(heap_t h);
 void heap_walk(heap_t h, heap_walk_fn_t fn, void *context);
 
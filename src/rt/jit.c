@@ -30,6 +30,7 @@
 #include <dlfcn.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <llvm-c/Core.h>
 #include <llvm-c/BitReader.h>
@@ -41,6 +42,15 @@ static LLVMExecutionEngineRef exec_engine = NULL;
 static bool using_jit = true;
 static void *dl_handle = NULL;
 
+#define JIT_PART_FUNCS 16
+#define JIT_MAX_PARTS  256
+
+#ifdef LLVM_HAS_MCJIT
+static FILE          *perf_map = NULL;
+static LLVMModuleRef  perf_mapped[JIT_MAX_PARTS];
+static int            n_perf_mapped = 0;
+#endif
+
 #ifdef LLVM_MANGLES_NAMES
 static char *jit_str_add(char *p, const char *s)
 {
@@ -113,6 +123,74 @@ static void *jit_search_loaded_syms(const char *name, bool required)
    return sym;
 }
 
+#ifdef LLVM_HAS_MCJIT
+typedef struct {
+   uintptr_t   addr;
+   const char *name;
+} perf_sym_t;
+
+static int jit_perf_sym_cmp(const void *a, const void *b)
+{
+   const uintptr_t aa = ((const perf_sym_t *)a)->addr;
+   const uintptr_t ab = ((const perf_sym_t *)b)->addr;
+   return (aa > ab) - (aa < ab);
+}
+
+static void jit_perf_map_module(LLVMModuleRef m)
+{
+   // Write the address of each function in a module that MCJIT has
+   // just compiled to /tmp/perf-PID.map so perf can name samples in
+   // generated code after the process or subprogram
+
+   for (int i = 0; i < n_perf_mapped; i++) {
+      if (perf_mapped[i] == m)
+         return;
+   }
+
+   assert(n_perf_mapped < JIT_MAX_PARTS);
+   perf_mapped[n_perf_mapped++] = m;
+
+   int nfuncs = 0;
+   for (LLVMValueRef fn = LLVMGetFirstFunction(m);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (!LLVMIsDeclaration(fn))
+         nfuncs++;
+   }
+
+   perf_sym_t *syms = xmalloc(sizeof(perf_sym_t) * MAX(nfuncs, 1));
+   int nsyms = 0;
+   for (LLVMValueRef fn = LLVMGetFirstFunction(m);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (LLVMIsDeclaration(fn))
+         continue;
+
+      const char *name = LLVMGetValueName(fn);
+      const uintptr_t addr = LLVMGetFunctionAddress(exec_engine, name);
+      if (addr != 0) {
+         syms[nsyms].addr = addr;
+         syms[nsyms].name = name;
+         nsyms++;
+      }
+   }
+
+   qsort(syms, nsyms, sizeof(perf_sym_t), jit_perf_sym_cmp);
+
+   // The size of each function is not available through the C API so
+   // assume it extends to the next function and the last one to the
+   // end of its page
+   const uintptr_t page = sysconf(_SC_PAGESIZE);
+   for (int i = 0; i < nsyms; i++) {
+      const uintptr_t end = (i + 1 < nsyms)
+         ? syms[i + 1].addr : (syms[i].addr + page) & ~(page - 1);
+      fprintf(perf_map, "%"PRIxPTR" %"PRIxPTR" %s\n", syms[i].addr,
+              end - syms[i].addr, syms[i].name);
+   }
+
+   fflush(perf_map);
+   free(syms);
+}
+#endif  // LLVM_HAS_MCJIT
+
 void *jit_fun_ptr(const char *name, bool required)
 {
    if (using_jit) {
@@ -124,7 +202,18 @@ void *jit_fun_ptr(const char *name, bool required)
             return jit_search_loaded_syms(name, required);
       }
 
+#ifdef LLVM_HAS_MCJIT
+      // Unlike LLVMGetPointerToGlobal this only generates code for the
+      // module containing the function and the modules it references
+      void *ptr = (void *)(uintptr_t)LLVMGetFunctionAddress(exec_engine, name);
+
+      if (perf_map != NULL)
+         jit_perf_map_module(LLVMGetGlobalParent(fn));
+
+      return ptr;
+#else
       return LLVMGetPointerToGlobal(exec_engine, fn);
+#endif
    }
    else
       return jit_var_ptr(name, required);
@@ -166,6 +255,133 @@ void jit_bind_fn(const char *name, void *ptr)
    }
 }
 
+#ifdef LLVM_HAS_MCJIT
+static bool jit_is_local(LLVMValueRef v)
+{
+   const LLVMLinkage linkage = LLVMGetLinkage(v);
+   return linkage == LLVMPrivateLinkage || linkage == LLVMInternalLinkage;
+}
+
+static int jit_make_visible(void)
+{
+   // Functions and mutable globals may now be referenced from another
+   // module so none of them can be private. Returns the number of
+   // function definitions
+
+   int count = 0, anon = 0;
+
+   for (LLVMValueRef fn = LLVMGetFirstFunction(module);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (LLVMIsDeclaration(fn))
+         continue;
+      else if (jit_is_local(fn))
+         LLVMSetLinkage(fn, LLVMExternalLinkage);
+      count++;
+   }
+
+   for (LLVMValueRef g = LLVMGetFirstGlobal(module);
+        g != NULL; g = LLVMGetNextGlobal(g)) {
+      if (LLVMIsDeclaration(g) || !jit_is_local(g))
+         continue;
+      else if (LLVMIsGlobalConstant(g))
+         continue;   // Copied into every module
+
+      const char *name = LLVMGetValueName(g);
+      if (*name == '\0') {
+         char *fresh LOCAL = xasprintf("_nvc_jit_anon%d", anon++);
+         LLVMSetValueName(g, fresh);
+      }
+
+      LLVMSetLinkage(g, LLVMExternalLinkage);
+   }
+
+   return count;
+}
+
+static void jit_strip_body(LLVMValueRef fn)
+{
+   // Break all references between instructions before deleting them
+
+   for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn);
+        bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+      for (LLVMValueRef i = LLVMGetFirstInstruction(bb);
+           i != NULL; i = LLVMGetNextInstruction(i)) {
+         LLVMTypeRef type = LLVMTypeOf(i);
+         if (LLVMGetTypeKind(type) != LLVMVoidTypeKind)
+            LLVMReplaceAllUsesWith(i, LLVMGetUndef(type));
+      }
+   }
+
+   for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn);
+        bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+      LLVMValueRef i;
+      while ((i = LLVMGetFirstInstruction(bb)) != NULL)
+         LLVMInstructionEraseFromParent(i);
+   }
+
+   LLVMBasicBlockRef bb;
+   while ((bb = LLVMGetFirstBasicBlock(fn)) != NULL)
+      LLVMDeleteBasicBlock(bb);
+
+   LLVMSetLinkage(fn, LLVMExternalLinkage);
+}
+
+static void jit_keep_part(LLVMModuleRef m, int part, int nparts, int nfuncs)
+{
+   // Keep the bodies of a contiguous run of functions and turn the
+   // rest into declarations. Code generation emits a process next to
+   // the subprograms it calls so these tend to end up together. Mutable
+   // globals are defined in the first module only
+
+   int index = 0;
+   for (LLVMValueRef fn = LLVMGetFirstFunction(m);
+        fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      if (LLVMIsDeclaration(fn))
+         continue;
+      else if ((int64_t)index++ * nparts / nfuncs != part)
+         jit_strip_body(fn);
+   }
+
+   if (part > 0) {
+      LLVMValueRef g = LLVMGetFirstGlobal(m);
+      while (g != NULL) {
+         LLVMValueRef next = LLVMGetNextGlobal(g);
+
+         if (LLVMGetLinkage(g) == LLVMAppendingLinkage)
+            LLVMDeleteGlobal(g);
+         else if (!LLVMIsDeclaration(g) && !jit_is_local(g)) {
+            LLVMSetInitializer(g, NULL);
+            LLVMSetLinkage(g, LLVMExternalLinkage);
+         }
+
+         g = next;
+      }
+   }
+}
+
+static int jit_split_module(LLVMModuleRef *parts)
+{
+   // Split the design into several modules which MCJIT compiles
+   // separately the first time a symbol they define is looked up so
+   // subprograms that are never called are never compiled
+
+   const int nfuncs = jit_make_visible();
+   const int nparts =
+      MAX(1, MIN((nfuncs + JIT_PART_FUNCS - 1) / JIT_PART_FUNCS,
+                 JIT_MAX_PARTS));
+
+   for (int i = 1; i < nparts; i++) {
+      parts[i] = LLVMCloneModule(module);
+      jit_keep_part(parts[i], i, nparts, nfuncs);
+   }
+
+   jit_keep_part(module, 0, nparts, nfuncs);
+   parts[0] = module;
+
+   return nparts;
+}
+#endif  // LLVM_HAS_MCJIT
+
 static void jit_init_llvm(const char *path)
 {
    if (module == NULL) {
@@ -188,10 +404,22 @@ static void jit_init_llvm(const char *path)
    struct LLVMMCJITCompilerOptions options;
    LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
 
+   LLVMModuleRef parts[JIT_MAX_PARTS] = { module };
+   const int nparts = opt_get_int("lazy-jit") ? jit_split_module(parts) : 1;
+
    char *error;
-   if (LLVMCreateMCJITCompilerForModule(&exec_engine, module, &options,
+   if (LLVMCreateMCJITCompilerForModule(&exec_engine, parts[0], &options,
                                         sizeof(options), &error))
       fatal("error creating MCJIT compiler: %s", error);
+
+   for (int i = 1; i < nparts; i++)
+      LLVMAddModule(exec_engine, parts[i]);
+
+   if (opt_get_int("perf-map")) {
+      char *fname LOCAL = xasprintf("/tmp/perf-%d.map", getpid());
+      if ((perf_map = fopen(fname, "w")) == NULL)
+         fatal_errno("%s", fname);
+   }
 #else
    LLVMInitializeNativeTarget();
    LLVMLinkInJIT();
@@ -210,8 +438,14 @@ static void jit_load_deps(tree_t top)
       char line[PATH_MAX];
       while (!feof(deps) && (fgets(line, sizeof(line), deps) != NULL)) {
          strtok(line, "\r\n");
-         if (dlopen(line, RTLD_LAZY | RTLD_GLOBAL) == NULL)
+         void *handle = dlopen(line, RTLD_LAZY | RTLD_GLOBAL);
+         if (handle == NULL)
             fatal("%s: %s", line, dlerror());
+
+         const int32_t *abi = dlsym(handle, RT_ABI_SYMBOL);
+         if (abi == NULL || *abi != RT_ABI_VERSION)
+            fatal("%s was built for a different version of the runtime: "
+                  "rebuild it with --codegen", line);
       }
 
       fclose(deps);
@@ -273,6 +507,14 @@ void jit_init(tree_t top)
 
 void jit_shutdown(void)
 {
+#ifdef LLVM_HAS_MCJIT
+   if (perf_map != NULL) {
+      fclose(perf_map);
+      perf_map = NULL;
+      n_perf_mapped = 0;
+   }
+#endif
+
    if (using_jit)
       LLVMDisposeExecutionEngine(exec_engine);
    else
@@ -31,13 +31,14 @@
 
 typedef struct lxt_data lxt_data_t;
 
-typedef void (*lxt_fmt_fn_t)(tree_t, watch_t *, lxt_data_t *);
+typedef void (*lxt_fmt_fn_t)(watch_t *, lxt_data_t *);
 
 struct lxt_data {
    struct lt_symbol *sym;
    lxt_fmt_fn_t      fmt;
    range_kind_t      dir;
    const char       *map;
+   type_t            type;
 };
 
 static struct lt_trace *trace = NULL;
@@ -57,7 +58,7 @@ static void lxt_close_trace(void)
    }
 }
 
-static void lxt_fmt_int(tree_t decl, watch_t *w, lxt_data_t *data)
+static void lxt_fmt_int(watch_t *w, lxt_data_t *data)
 {
    uint64_t val;
    rt_watch_value(w, &val, 1, false);
@@ -65,16 +66,16 @@ static void lxt_fmt_int(tree_t decl, watch_t *w, lxt_data_t *data)
    lt_emit_value_int(trace, data->sym, 0, val);
 }
 
-static void lxt_fmt_enum(tree_t decl, watch_t *w, lxt_data_t *data)
+static void lxt_fmt_enum(watch_t *w, lxt_data_t *data)
 {
    uint64_t val;
    rt_watch_value(w, &val, 1, false);
 
-   tree_t lit = type_enum_literal(tree_type(decl), val);
+   tree_t lit = type_enum_literal(data->type, val);
    lt_emit_value_string(trace, data->sym, 0, (char *)istr(tree_ident(lit)));
 }
 
-static void lxt_fmt_chars(tree_t decl, watch_t *w, lxt_data_t *data)
+static void lxt_fmt_chars(watch_t *w, lxt_data_t *data)
 {
    char bits[MAX_VALS + 1];
    rt_watch_string(w, data->map, bits, MAX_VALS + 1);
@@ -84,15 +85,18 @@ static void lxt_fmt_chars(tree_t decl, watch_t *w, lxt_data_t *data)
       lt_emit_value_string(trace, data->sym, 0, bits);
 }
 
-static void lxt_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
+static void lxt_time_cb(uint64_t now)
 {
    if (now != last_time) {
       lt_set_time64(trace, now);
       last_time = now;
    }
+}
 
+static void lxt_value_cb(watch_t *w, void *user)
+{
    lxt_data_t *data = user;
-   (*data->fmt)(decl, w, data);
+   (*data->fmt)(w, data);
 }
 
 static char *lxt_fmt_name(tree_t decl)
@@ -170,6 +174,8 @@ void lxt_restart(void)
       lxt_data_t *data = xmalloc(sizeof(lxt_data_t));
       memset(data, '\0', sizeof(lxt_data_t));
 
+      data->type = type;
+
       int flags = 0;
 
       if (type_is_array(type)) {
@@ -214,9 +220,9 @@ void lxt_restart(void)
 
       tree_add_attr_ptr(d, lxt_data_i, data);
 
-      watch_t *w = rt_set_event_cb(d, lxt_event_cb, data, true);
-
-      (*data->fmt)(d, w, data);
+      watch_t *w = wave_watch(d, data);
+      if (w != NULL)
+         (*data->fmt)(w, data);
    }
 
    last_time = (lxttime_t)-1;
@@ -231,5 +237,7 @@ void lxt_init(const char *filename, tree_t top)
 
    atexit(lxt_close_trace);
 
+   wave_set_emitter(lxt_time_cb, lxt_value_cb);
+
    lxt_top = top;
 }
@@ -0,0 +1,253 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "meta.h"
+#include "common.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define META_MAGIC   0x5445454d   // "MEET"
+#define META_VERSION 1
+
+// The file is this header followed by one entry per object index in
+// the unit and then a table of NUL terminated strings
+typedef struct {
+   uint32_t    magic;
+   uint32_t    version;
+   lib_mtime_t mtime;
+   uint32_t    nentries;
+   uint32_t    strtab_size;
+} meta_hdr_t;
+
+typedef struct {
+   uint32_t file;      // Offset in string table plus one or zero if unused
+   uint32_t first;     // First line and column packed as in loc_t
+   uint32_t last;
+   uint32_t name;      // Offset in string table plus one or zero
+   uint16_t kind;
+   uint16_t flags;
+} meta_entry_t;
+
+struct meta {
+   void               *map;
+   size_t              size;
+   const meta_entry_t *entries;
+   uint32_t            nentries;
+   const char         *strtab;
+};
+
+typedef struct {
+   meta_entry_t *entries;
+   uint32_t      nentries;
+   char         *strtab;
+   uint32_t      strtab_size;
+   uint32_t      strtab_max;
+   hash_t       *strings;
+   ident_t       is_report_i;
+} meta_wr_ctx_t;
+
+static uint32_t meta_string(meta_wr_ctx_t *ctx, const char *str)
+{
+   ident_t id = ident_new(str);
+
+   void *off = hash_get(ctx->strings, id);
+   if (off != NULL)
+      return (uintptr_t)off;
+
+   const size_t len = strlen(str) + 1;
+   if (ctx->strtab_size + len > ctx->strtab_max) {
+      ctx->strtab_max = MAX(ctx->strtab_max * 2, ctx->strtab_size + len);
+      ctx->strtab = xrealloc(ctx->strtab, ctx->strtab_max);
+   }
+
+   memcpy(ctx->strtab + ctx->strtab_size, str, len);
+
+   const uint32_t result = ctx->strtab_size + 1;
+   ctx->strtab_size += len;
+
+   hash_put(ctx->strings, id, (void *)(uintptr_t)result);
+   return result;
+}
+
+static void meta_visit_fn(tree_t t, void *_ctx)
+{
+   meta_wr_ctx_t *ctx = _ctx;
+
+   const uint32_t index = tree_index(t);
+   if (index >= ctx->nentries) {
+      const uint32_t nentries = MAX(index + 1, ctx->nentries * 2);
+      ctx->entries = xrealloc(ctx->entries, nentries * sizeof(meta_entry_t));
+      memset(ctx->entries + ctx->nentries, '\0',
+             (nentries - ctx->nentries) * sizeof(meta_entry_t));
+      ctx->nentries = nentries;
+   }
+
+   meta_entry_t *e = &(ctx->entries[index]);
+   const loc_t *loc = tree_loc(t);
+   const tree_kind_t kind = tree_kind(t);
+
+   e->file  = (loc->file != NULL) ? meta_string(ctx, loc->file) : 0;
+   e->first = loc->first_line | (loc->first_column << 20);
+   e->last  = loc->last_line | (loc->last_column << 20);
+   e->kind  = kind;
+   e->flags = 0;
+   e->name  = 0;
+
+   if (kind == T_PORT_DECL || kind == T_VAR_DECL)
+      e->name = meta_string(ctx, istr(tree_ident(t)));
+   else if (tree_attr_int(t, ctx->is_report_i, 0))
+      e->flags |= META_F_REPORT;
+}
+
+void meta_write(tree_t unit)
+{
+   // Record a location for every tree in the unit indexed in the same
+   // way as tree_read_recall
+
+   meta_wr_ctx_t ctx = {
+      .strings     = hash_new(256, true),
+      .is_report_i = ident_new("is_report")
+   };
+
+   tree_visit(unit, meta_visit_fn, &ctx);
+
+   // Trim unused entries from the end of the table
+   while (ctx.nentries > 0 && ctx.entries[ctx.nentries - 1].file == 0)
+      ctx.nentries--;
+
+   // The modification time of the unit file detects stale metadata
+   ident_t name = tree_ident(unit);
+   lib_mtime_t mtime = 0;
+   lib_stat(lib_work(), istr(name), &mtime);
+   char *fname = xasprintf("_%s.meta", istr(name));
+
+   FILE *f = lib_fopen(lib_work(), fname, "w");
+   if (f == NULL)
+      fatal_errno("failed to create metadata file %s", fname);
+
+   free(fname);
+
+   const meta_hdr_t hdr = {
+      .magic       = META_MAGIC,
+      .version     = META_VERSION,
+      .mtime       = mtime,
+      .nentries    = ctx.nentries,
+      .strtab_size = ctx.strtab_size
+   };
+
+   bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+   ok = ok && fwrite(ctx.entries, sizeof(meta_entry_t),
+                     ctx.nentries, f) == ctx.nentries;
+   ok = ok && fwrite(ctx.strtab, 1, ctx.strtab_size, f) == ctx.strtab_size;
+
+   if (!ok)
+      fatal_errno("failed to write metadata for %s", istr(name));
+
+   fclose(f);
+
+   free(ctx.entries);
+   free(ctx.strtab);
+   hash_free(ctx.strings);
+}
+
+meta_t *meta_open(lib_t lib, ident_t unit)
+{
+   char *fname = xasprintf("_%s.meta", istr(unit));
+   char path[PATH_MAX];
+   lib_realpath(lib, fname, path, sizeof(path));
+   free(fname);
+
+   // Metadata is optional so the caller falls back to loading the tree
+   // if it is missing or out of date
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size < sizeof(meta_hdr_t)) {
+      close(fd);
+      return NULL;
+   }
+
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED)
+      return NULL;
+
+   const meta_hdr_t *hdr = map;
+   const size_t strtab_off =
+      sizeof(meta_hdr_t) + hdr->nentries * sizeof(meta_entry_t);
+
+   lib_mtime_t mtime = 0;
+   lib_stat(lib, istr(unit), &mtime);
+
+   if (hdr->magic != META_MAGIC || hdr->version != META_VERSION
+       || strtab_off + hdr->strtab_size != st.st_size
+       || hdr->mtime != mtime) {
+      munmap(map, st.st_size);
+      return NULL;
+   }
+
+   meta_t *m = xmalloc(sizeof(meta_t));
+   m->map      = map;
+   m->size     = st.st_size;
+   m->entries  =
+      (const meta_entry_t *)((const char *)map + sizeof(meta_hdr_t));
+   m->nentries = hdr->nentries;
+   m->strtab   = (const char *)map + strtab_off;
+
+   return m;
+}
+
+bool meta_lookup(meta_t *m, uint32_t where, meta_info_t *info)
+{
+   if (where >= m->nentries)
+      return false;
+
+   const meta_entry_t *e = &(m->entries[where]);
+   if (e->file == 0)
+      return false;
+
+   info->loc.first_line   = e->first & 0xfffff;
+   info->loc.first_column = e->first >> 20;
+   info->loc.last_line    = e->last & 0xfffff;
+   info->loc.last_column  = e->last >> 20;
+   info->loc.file         = m->strtab + e->file - 1;
+   info->loc.linebuf      = NULL;
+
+   info->kind  = e->kind;
+   info->flags = e->flags;
+   info->name  = e->name ? m->strtab + e->name - 1 : NULL;
+
+   return true;
+}
+
+void meta_close(meta_t *m)
+{
+   munmap(m->map, m->size);
+   free(m);
+}
@@ -0,0 +1,47 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _META_H
+#define _META_H
+
+#include "tree.h"
+#include "lib.h"
+
+//
+// Runtime metadata describing the trees that generated code refers to
+// by their `where' index so that diagnostics do not need to load the
+// design unit
+//
+
+typedef struct meta meta_t;
+
+// The object at this index is a report statement
+#define META_F_REPORT (1 << 0)
+
+typedef struct {
+   loc_t        loc;
+   tree_kind_t  kind;
+   unsigned     flags;
+   const char  *name;   // Only for port and variable declarations
+} meta_info_t;
+
+void meta_write(tree_t unit);
+meta_t *meta_open(lib_t lib, ident_t unit);
+bool meta_lookup(meta_t *m, uint32_t where, meta_info_t *info);
+void meta_close(meta_t *m);
+
+#endif  // _META_H
@@ -17,45 +17,76 @@
 
 #include "netdb.h"
 #include "util.h"
+#include "lib.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 netdb_t *netdb_open(tree_t top)
 {
    char *name = xasprintf("_%s.netdb", istr(tree_ident(top)));
-   fbuf_t *f = lib_fbuf_open(lib_work(), name, FBUF_IN);
-   if (f == NULL)
-      fatal("failed to open net database file %s", name);
+   char path[PATH_MAX];
+   lib_realpath(lib_work(), name, path, sizeof(path));
    free(name);
 
-   netdb_t *db = xmalloc(sizeof(struct netdb));
-   db->groups = NULL;
-   db->max    = 0;
-   db->nnets  = 0;
-
-   groupid_t gid;
-   while ((gid = read_u32(f)) != GROUPID_INVALID) {
-      group_t *g = xmalloc(sizeof(struct group));
-      g->next   = db->groups;
-      g->gid    = gid;
-      g->first  = read_u32(f);
-      g->length = read_u32(f);
-
-      db->groups = g;
-      db->max    = MAX(db->max, gid);
-      db->nnets  = MAX(db->nnets, g->first + g->length);
-   }
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      fatal_errno("failed to open net database file %s", path);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("cannot stat %s", path);
+
+   if (st.st_size < sizeof(netdb_hdr_t))
+      fatal("%s is not a net database", path);
+
+   // The group arrays are used directly from the mapped file
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map == MAP_FAILED)
+      fatal_errno("cannot map %s", path);
+
+   close(fd);
 
-   fbuf_close(f);
+   const netdb_hdr_t *hdr = map;
+   if (hdr->magic != NETDB_MAGIC)
+      fatal("%s is not a net database", path);
+   else if (hdr->version != NETDB_VERSION)
+      fatal("%s was written by an incompatible version of "PACKAGE, path);
 
-   db->map = xmalloc(sizeof(groupid_t) * db->nnets);
-   for (netid_t i = 0; i < db->nnets; i++)
-      db->map[i] = GROUPID_INVALID;
+   const size_t first_off = sizeof(netdb_hdr_t);
+   const size_t length_off = first_off + hdr->ngroups * sizeof(netid_t);
+   const size_t flags_off = length_off + hdr->ngroups * sizeof(uint32_t);
 
-   for (group_t *it = db->groups; it != NULL; it = it->next) {
-      for (netid_t i = it->first; i < it->first + it->length; i++)
-         db->map[i] = it->gid;
+   if (flags_off + hdr->ngroups != st.st_size)
+      fatal("net database %s is corrupt", path);
+
+   netdb_t *db = xmalloc(sizeof(struct netdb));
+   db->map      = map;
+   db->map_size = st.st_size;
+   db->first    = (const netid_t *)((const char *)map + first_off);
+   db->length   = (const uint32_t *)((const char *)map + length_off);
+   db->flags    = (const uint8_t *)map + flags_off;
+   db->nnets    = hdr->nnets;
+   db->ngroups  = hdr->ngroups;
+   db->dense    = NULL;
+
+   if (db->nnets <= NETDB_DENSE_MAX) {
+      // Small designs can afford a direct map from net to group which
+      // avoids searching on every lookup
+      db->dense = xmalloc(sizeof(groupid_t) * db->nnets);
+      memset(db->dense, 0xff, sizeof(groupid_t) * db->nnets);
+
+      for (groupid_t gid = 0; gid < db->ngroups; gid++) {
+         const netid_t end = db->first[gid] + db->length[gid];
+         for (netid_t i = db->first[gid]; i < end; i++)
+            db->dense[i] = gid;
+      }
    }
 
    return db;
@@ -63,23 +94,20 @@ netdb_t *netdb_open(tree_t top)
 
 void netdb_close(netdb_t *db)
 {
-   while (db->groups != NULL) {
-      group_t *next = db->groups->next;
-      free(db->groups);
-      db->groups = next;
-   }
+   if (munmap(db->map, db->map_size) != 0)
+      fatal_errno("munmap");
 
-   free(db->map);
+   free(db->dense);
    free(db);
 }
 
 unsigned netdb_size(netdb_t *db)
 {
-   return db->max + 1;
+   return db->ngroups;
 }
 
 void netdb_walk(netdb_t *db, netdb_walk_fn_t fn)
 {
-   for (group_t *it = db->groups; it != NULL; it = it->next)
-      (*fn)(it->gid, it->first, it->length);
+   for (groupid_t gid = 0; gid < db->ngroups; gid++)
+      (*fn)(gid, db->first[gid], db->length[gid]);
 }
@@ -28,23 +28,48 @@ typedef uint32_t groupid_t;
 #define GROUPID_INVALID UINT32_MAX
 #define NETDB_DEBUG     0
 
+// No process can observe events on any net in the group
+#define GROUP_F_NO_READERS (1 << 0)
+
 typedef struct netdb netdb_t;
 typedef struct group group_t;
 
 typedef void (*netdb_walk_fn_t)(groupid_t, netid_t, unsigned);
 
+// Nets per design below which lookups use a dense map from net to
+// group rather than searching the sorted group boundaries
+#define NETDB_DENSE_MAX (1 << 22)
+
+#define NETDB_MAGIC   0x4244454e   // "NEDB"
+#define NETDB_VERSION 1
+
 struct group {
    group_t  *next;
    groupid_t gid;
    netid_t   first;
    unsigned  length;
+   unsigned  flags;
 };
 
+// The net database file is this header followed by arrays of the
+// first net and length of each group sorted by first net, then the
+// group flags. Group IDs are the index into these arrays.
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t ngroups;
+   uint32_t nnets;
+} netdb_hdr_t;
+
 struct netdb {
-   group_t   *groups;
-   groupid_t *map;
-   netid_t    nnets;
-   unsigned   max;
+   void           *map;
+   size_t          map_size;
+   const netid_t  *first;
+   const uint32_t *length;
+   const uint8_t  *flags;
+   groupid_t      *dense;
+   netid_t         nnets;
+   unsigned        ngroups;
 };
 
 netdb_t *netdb_open(tree_t top);
@@ -52,18 +77,43 @@ void netdb_close(netdb_t *db);
 unsigned netdb_size(netdb_t *db);
 void netdb_walk(netdb_t *db, netdb_walk_fn_t fn);
 
+static inline groupid_t netdb_search(const netdb_t *db, netid_t nid)
+{
+   // Branch-free binary search for the last group starting at or
+   // before the net
+
+   const netid_t *base = db->first;
+   unsigned n = db->ngroups;
+   while (n > 1) {
+      const unsigned half = n / 2;
+      base = (base[half] <= nid) ? base + half : base;
+      n -= half;
+   }
+
+   return base - db->first;
+}
+
 static inline groupid_t netdb_lookup(const netdb_t *db, netid_t nid)
 {
 #if NETDB_DEBUG
    assert(nid < db->nnets);
-   groupid_t gid = db->map[nid];
-   if (likely(gid != GROUPID_INVALID))
+   groupid_t gid = netdb_search(db, nid);
+   if (likely(nid >= db->first[gid]
+              && nid < db->first[gid] + db->length[gid]))
       return gid;
    else
       fatal_trace("net %d not in database", nid);
 #else
-   return db->map[nid];
+   if (likely(db->dense != NULL))
+      return db->dense[nid];
+   else
+      return netdb_search(db, nid);
 #endif
 }
 
+static inline unsigned netdb_flags(const netdb_t *db, groupid_t gid)
+{
+   return db->flags[gid];
+}
+
 #endif  // _NETDB_H
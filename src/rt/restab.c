@@ -0,0 +1,186 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "restab.h"
+
+#if defined __x86_64__ || defined __i386__
+#include <immintrin.h>
+#define RESTAB_AVX2 1
+#elif defined __aarch64__
+#include <arm_neon.h>
+#define RESTAB_NEON 1
+#endif
+
+// With at most 16 literals a row of the table fits in a single vector
+// register and a byte shuffle looks up a whole vector of values at
+// once. The two dimensional case selects the row for each element by
+// comparing against every literal in turn.
+
+typedef void (*map_fn_t)(const restab1_t, int8_t *, const int8_t *, size_t);
+typedef void (*fold_fn_t)(const restab2_t, int, int8_t *,
+                          const int8_t *, const int8_t *, size_t);
+
+static void restab_map_scalar(const restab1_t tab, int8_t *out,
+                              const int8_t *in, size_t n)
+{
+   for (size_t i = 0; i < n; i++)
+      out[i] = tab[(int)in[i]];
+}
+
+static void restab_fold_scalar(const restab2_t tab, int nlits, int8_t *out,
+                               const int8_t *a, const int8_t *b, size_t n)
+{
+   for (size_t i = 0; i < n; i++)
+      out[i] = tab[(int)a[i]][(int)b[i]];
+}
+
+#if RESTAB_AVX2
+
+__attribute__((target("avx2")))
+static void restab_map_avx2(const restab1_t tab, int8_t *out,
+                            const int8_t *in, size_t n)
+{
+   const __m256i row =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tab));
+
+   size_t i = 0;
+   for (; i + 32 <= n; i += 32) {
+      const __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+      _mm256_storeu_si256((__m256i *)(out + i),
+                          _mm256_shuffle_epi8(row, v));
+   }
+
+   restab_map_scalar(tab, out + i, in + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void restab_fold_avx2(const restab2_t tab, int nlits, int8_t *out,
+                             const int8_t *a, const int8_t *b, size_t n)
+{
+   if (n < 32) {
+      restab_fold_scalar(tab, nlits, out, a, b, n);
+      return;
+   }
+
+   __m256i rows[16];
+   for (int j = 0; j < nlits; j++)
+      rows[j] = _mm256_broadcastsi128_si256(
+         _mm_loadu_si128((const __m128i *)tab[j]));
+
+   size_t i = 0;
+   for (; i + 32 <= n; i += 32) {
+      const __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+      const __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+
+      __m256i r = _mm256_setzero_si256();
+      for (int j = 0; j < nlits; j++) {
+         const __m256i hit = _mm256_cmpeq_epi8(va, _mm256_set1_epi8(j));
+         const __m256i val = _mm256_shuffle_epi8(rows[j], vb);
+         r = _mm256_or_si256(r, _mm256_and_si256(hit, val));
+      }
+
+      _mm256_storeu_si256((__m256i *)(out + i), r);
+   }
+
+   restab_fold_scalar(tab, nlits, out + i, a + i, b + i, n - i);
+}
+
+#elif RESTAB_NEON
+
+static void restab_map_neon(const restab1_t tab, int8_t *out,
+                            const int8_t *in, size_t n)
+{
+   const int8x16_t row = vld1q_s8(tab);
+
+   size_t i = 0;
+   for (; i + 16 <= n; i += 16) {
+      const uint8x16_t v = vreinterpretq_u8_s8(vld1q_s8(in + i));
+      vst1q_s8(out + i, vqtbl1q_s8(row, v));
+   }
+
+   restab_map_scalar(tab, out + i, in + i, n - i);
+}
+
+static void restab_fold_neon(const restab2_t tab, int nlits, int8_t *out,
+                             const int8_t *a, const int8_t *b, size_t n)
+{
+   if (n < 16) {
+      restab_fold_scalar(tab, nlits, out, a, b, n);
+      return;
+   }
+
+   int8x16_t rows[16];
+   for (int j = 0; j < nlits; j++)
+      rows[j] = vld1q_s8(tab[j]);
+
+   size_t i = 0;
+   for (; i + 16 <= n; i += 16) {
+      const int8x16_t va = vld1q_s8(a + i);
+      const uint8x16_t vb = vreinterpretq_u8_s8(vld1q_s8(b + i));
+
+      int8x16_t r = vdupq_n_s8(0);
+      for (int j = 0; j < nlits; j++) {
+         const uint8x16_t hit = vceqq_s8(va, vdupq_n_s8(j));
+         r = vbslq_s8(hit, vqtbl1q_s8(rows[j], vb), r);
+      }
+
+      vst1q_s8(out + i, r);
+   }
+
+   restab_fold_scalar(tab, nlits, out + i, a + i, b + i, n - i);
+}
+
+#endif
+
+static map_fn_t  map_fn  = NULL;
+static fold_fn_t fold_fn = NULL;
+
+static void restab_select(void)
+{
+#if RESTAB_AVX2
+   if (__builtin_cpu_supports("avx2")) {
+      map_fn  = restab_map_avx2;
+      fold_fn = restab_fold_avx2;
+      return;
+   }
+#elif RESTAB_NEON
+   map_fn  = restab_map_neon;
+   fold_fn = restab_fold_neon;
+   return;
+#endif
+
+   map_fn  = restab_map_scalar;
+   fold_fn = restab_fold_scalar;
+}
+
+void restab_map(const restab1_t tab, int8_t *out, const int8_t *in, size_t n)
+{
+   if (unlikely(map_fn == NULL))
+      restab_select();
+
+   (*map_fn)(tab, out, in, n);
+}
+
+void restab_fold(const restab2_t tab, int nlits, int8_t *out,
+                 const int8_t *a, const int8_t *b, size_t n)
+{
+   if (unlikely(fold_fn == NULL))
+      restab_select();
+
+   (*fold_fn)(tab, nlits, out, a, b, n);
+}
@@ -0,0 +1,38 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _RESTAB_H
+#define _RESTAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Evaluate memoised resolution functions over arrays of enumeration
+// values with at most 16 literals. These use vector table lookups where
+// the host supports them.
+
+typedef int8_t restab1_t[16];
+typedef int8_t restab2_t[16][16];
+
+// out[i] = tab[in[i]]
+void restab_map(const restab1_t tab, int8_t *out, const int8_t *in, size_t n);
+
+// out[i] = tab[a[i]][b[i]] where all values are less than nlits
+void restab_fold(const restab2_t tab, int nlits, int8_t *out,
+                 const int8_t *a, const int8_t *b, size_t n);
+
+#endif  // _RESTAB_H
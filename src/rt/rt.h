@@ -23,11 +23,18 @@
 
 #include <stdint.h>
 
+// Increment when the interface between generated code and the runtime
+// changes so native libraries built by an older version are rejected
+#define RT_ABI_VERSION 2
+#define RT_ABI_SYMBOL  "_nvc_abi_version"
+
 typedef struct watch watch_t;
 
 typedef void (*sig_event_fn_t)(uint64_t now, tree_t, watch_t *, void *user);
 typedef void (*timeout_fn_t)(uint64_t now, void *user);
 typedef void (*rt_event_fn_t)(void *user);
+typedef void (*wave_time_fn_t)(uint64_t now);
+typedef void (*wave_emit_fn_t)(watch_t *, void *user);
 
 typedef enum {
    BOUNDS_ARRAY_TO,
@@ -56,16 +63,30 @@ typedef enum {
    BIT_VEC_XOR,
    BIT_VEC_XNOR,
    BIT_VEC_NAND,
-   BIT_VEC_NOR
+   BIT_VEC_NOR,
+   LOGIC_VEC_NOT,
+   LOGIC_VEC_AND,
+   LOGIC_VEC_OR,
+   LOGIC_VEC_XOR,
+   LOGIC_VEC_XNOR,
+   LOGIC_VEC_NAND,
+   LOGIC_VEC_NOR
 } bit_vec_op_kind_t;
 
+typedef enum {
+   IMAGE_GENERIC,
+   IMAGE_INTEGER,
+   IMAGE_REAL
+} image_kind_t;
+
 typedef enum {
    NET_F_ACTIVE     = (1 << 0),
    NET_F_EVENT      = (1 << 1),
    NET_F_FORCED     = (1 << 2),
-   NET_F_OWNS_MEM   = (1 << 3),
+   NET_F_IMPLICIT   = (1 << 3),
    NET_F_GLOBAL     = (1 << 4),
-   NET_F_LAST_VALUE = (1 << 5)
+   NET_F_LAST_VALUE = (1 << 5),
+   NET_F_NO_READERS = (1 << 6)
 } net_flags_t;
 
 typedef enum {
@@ -73,12 +94,18 @@ typedef enum {
    SCHED_STATIC     = (1 << 1)
 } sched_flags_t;
 
+// The sched event flags above this bit hold a mask of the enumeration
+// values that may wake a process waiting for an edge on a scalar signal
+#define SCHED_EDGE_SHIFT 8
+#define SCHED_EDGE_MAX   (32 - SCHED_EDGE_SHIFT)
+
 typedef enum {
    RT_START_OF_SIMULATION,
    RT_END_OF_SIMULATION,
    RT_END_OF_PROCESSES,
    RT_LAST_KNOWN_DELTA_CYCLE,
    RT_NEXT_TIME_STEP,
+   RT_END_OF_TIME_STEP,
 
    RT_LAST_EVENT
 } rt_event_t;
@@ -90,17 +117,36 @@ typedef enum {
    SEVERITY_FAILURE
 } rt_severity_t;
 
+typedef enum {
+   STATS_NONE,
+   STATS_SUMMARY,
+   STATS_DETAIL,
+   STATS_JSON
+} rt_stats_level_t;
+
+typedef enum {
+   HUGE_PAGES_NONE,
+   HUGE_PAGES_TRANSPARENT,
+   HUGE_PAGES_EXPLICIT
+} rt_huge_pages_t;
+
 void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx);
 void rt_end_of_tool(tree_t top);
 void rt_run_sim(uint64_t stop_time);
 void rt_run_interactive(uint64_t stop_time);
 void rt_restart(tree_t top);
+bool rt_checkpoint(void);
+bool rt_restore(void);
 void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user);
 watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
                          bool postponed);
+void rt_clear_event_cb(watch_t *w);
 void rt_set_global_cb(rt_event_t event, rt_event_fn_t fn, void *user);
 size_t rt_watch_value(watch_t *w, uint64_t *buf, size_t max, bool last);
 size_t rt_watch_string(watch_t *w, const char *map, char *buf, size_t max);
+size_t rt_watch_bytes(watch_t *w);
+void rt_watch_copy(watch_t *w, void *buf);
+void rt_watch_force(watch_t *w, const void *buf, bool propagate);
 size_t rt_signal_value(tree_t s, uint64_t *buf, size_t max);
 size_t rt_signal_string(tree_t s, const char *map, char *buf, size_t max);
 bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
@@ -117,6 +163,7 @@ void *jit_var_ptr(const char *name, bool required);
 void jit_bind_fn(const char *name, void *ptr);
 
 void shell_run(tree_t top, tree_rd_ctx_t ctx);
+void server_run(tree_t top, const char *addr);
 
 text_buf_t *pprint(struct tree *t, const uint64_t *values, size_t len);
 
@@ -133,6 +180,12 @@ void wave_include_glob(const char *glob);
 void wave_exclude_glob(const char *glob);
 void wave_include_file(const char *base);
 bool wave_should_dump(tree_t decl);
+void wave_set_emitter(wave_time_fn_t time_fn, wave_emit_fn_t emit_fn);
+watch_t *wave_watch(tree_t decl, void *user);
+void wave_flush(void);
+bool wave_enabled(void);
+void wave_set_depth(int depth);
+void wave_set_window(uint64_t start, uint64_t stop);
 
 #ifdef ENABLE_VHPI
 void vhpi_load_plugins(tree_t top, const char *plugins);
@@ -21,12 +21,16 @@
 #include "util.h"
 #include "alloc.h"
 #include "heap.h"
+#include "wheel.h"
+#include "restab.h"
 #include "common.h"
 #include "netdb.h"
 #include "cover.h"
 #include "hash.h"
+#include "meta.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdarg.h>
 #include <inttypes.h>
@@ -38,7 +42,11 @@
 #include <signal.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <time.h>
 #include <float.h>
+#include <pthread.h>
 
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
@@ -46,11 +54,37 @@
 
 #define TRACE_DELTAQ  1
 #define TRACE_PENDING 0
+#define EVENTQ_WHEEL  1
+
+#if EVENTQ_WHEEL
+typedef wheel_t eventq_t;
+#define eventq_new()         wheel_new()
+#define eventq_free          wheel_free
+#define eventq_insert        wheel_insert_slot
+#define eventq_delete        wheel_delete
+#define eventq_min           wheel_min
+#define eventq_extract_min   wheel_extract_min
+#define eventq_size          wheel_size
+#define eventq_walk          wheel_walk
+#else
+typedef heap_t eventq_t;
+#define eventq_new()         heap_new(512)
+#define eventq_free          heap_free
+#define eventq_insert        heap_insert_slot
+#define eventq_delete        heap_delete
+#define eventq_min           heap_min
+#define eventq_extract_min   heap_extract_min
+#define eventq_size          heap_size
+#define eventq_walk          heap_walk
+#endif
 
 typedef void (*proc_fn_t)(int32_t reset);
 typedef uint64_t (*resolution_fn_t)(void *vals, int32_t n);
 
 typedef struct netgroup   netgroup_t;
+typedef struct netgroup_cold netgroup_cold_t;
+typedef struct signal_chunk signal_chunk_t;
+typedef struct sparse_map sparse_map_t;
 typedef struct driver     driver_t;
 typedef struct rt_proc    rt_proc_t;
 typedef struct event      event_t;
@@ -60,15 +94,27 @@ typedef struct value      value_t;
 typedef struct watch_list watch_list_t;
 typedef struct res_memo   res_memo_t;
 typedef struct callback   callback_t;
+typedef struct deferred   deferred_t;
+typedef struct worker     worker_t;
+typedef struct implicit   implicit_t;
+typedef struct implicit_list implicit_list_t;
+typedef struct rt_clock   rt_clock_t;
 
 struct rt_proc {
-   tree_t    source;
-   proc_fn_t proc_fn;
-   uint32_t  wakeup_gen;
-   void     *tmp_stack;
-   uint32_t  tmp_alloc;
-   bool      postponed;
-   bool      pending;
+   tree_t       source;
+   proc_fn_t    proc_fn;
+   uint32_t     wakeup_gen;
+   event_t     *timeout;
+   sens_list_t *global;
+   sens_list_t *table;
+   void        *tmp_stack;
+   uint32_t     tmp_alloc;
+   int32_t      level;
+   bool         postponed;
+   bool         pending;
+   bool         serial;
+   uint64_t     prof_runs;
+   uint64_t     prof_ns;
 };
 
 typedef enum {
@@ -81,31 +127,51 @@ struct event {
    uint64_t      when;
    event_kind_t  kind;
    uint32_t      wakeup_gen;
+   heap_slot_t   slot;
    event_t      *delta_chain;
    rt_proc_t    *proc;
    netgroup_t   *group;
+   int32_t       driver;
+   uint32_t      ngroups;     // Consecutive groups updated by a driver event
    timeout_fn_t  timeout_fn;
    void         *timeout_user;
 };
 
 struct waveform {
-   uint64_t    when;
-   waveform_t *next;
-   value_t    *values;
+   uint64_t  when;
+   event_t  *event;
+   uint64_t  word;    // Value stored inline if it fits in a word
 };
 
+typedef enum {
+   SENS_FREE,
+   SENS_LINKED,
+   SENS_QUEUED
+} sens_state_t;
+
 struct sens_list {
    rt_proc_t    *proc;
    sens_list_t  *next;
    sens_list_t **reenq;
    uint32_t      wakeup_gen;
+   uint32_t      edge;        // Mask of values that wake the process
    netid_t       first;
    netid_t       last;
+   netid_t       max_last;
+   sens_list_t  *left;
+   sens_list_t  *right;
+   sens_list_t **list;        // Group list if owned by the process table
+   sens_list_t  *table_next;
+   sens_state_t  state;
 };
 
 struct driver {
    rt_proc_t  *proc;
    waveform_t *waveforms;
+   uint8_t    *values;    // Only used for values larger than a word
+   uint32_t    head;
+   uint32_t    count;
+   uint32_t    size;
 };
 
 struct value {
@@ -113,22 +179,117 @@ struct value {
    char     data[0];
 };
 
+// A signal toggled at a fixed interval by the kernel in place of a
+// process of the form "clk <= not clk after T"
+struct rt_clock {
+   rt_proc_t  *proc;
+   netgroup_t *group;
+   uint64_t    delay;
+   bool        logic;        // Toggled with the std_ulogic "not" table
+   rt_clock_t *next;
+};
+
+struct implicit_list {
+   implicit_t      *implicit;
+   implicit_list_t *next;
+};
+
+// An implicit signal such as S'STABLE updated directly by the kernel
+// when its prefix changes instead of by running a process
+struct implicit {
+   predef_attr_t    kind;
+   uint64_t         delay;
+   rt_proc_t       *proc;        // Owner of the implicit signal driver
+   unsigned         n_prefix;
+   netgroup_t     **prefix;
+   netgroup_t     **target;      // Group for each prefix group
+   implicit_list_t *links;
+   bool             pending;
+   implicit_t      *chain_pending;
+   implicit_t      *next;
+};
+
+// Fields used on every update of a group: these should fit in a
+// single cache line
 struct netgroup {
    netid_t       first;
    uint32_t      length;
    net_flags_t   flags;
-   void         *resolved;
-   void         *last_value;
-   value_t      *forcing;
    uint16_t      size;
    uint16_t      n_drivers;
+   void         *resolved;
    driver_t     *drivers;
    res_memo_t   *resolution;
-   uint64_t      last_event;
-   tree_t        sig_decl;
-   value_t      *free_values;
    sens_list_t  *pending;
-   watch_list_t *watching;
+   uint64_t      last_event;
+};
+
+// Rarely used fields kept in a parallel array indexed by group ID
+struct netgroup_cold {
+   void            *last_value;
+   value_t         *forcing;
+   hash_t          *driver_map;
+   tree_t           sig_decl;
+   watch_list_t    *watching;
+   implicit_list_t *implicit;
+};
+
+typedef enum {
+   PHASE_QUEUE,
+   PHASE_PROCESS,
+   PHASE_DRIVER,
+   PHASE_CALLBACK,
+   PHASE_POSTPONED,
+
+   PHASE_LAST
+} rt_phase_t;
+
+// Histogram with a power of two sized bucket for each bit of the value
+#define HIST_BUCKETS 33
+
+typedef struct {
+   uint64_t buckets[HIST_BUCKETS];
+   uint64_t count;
+   uint64_t sum;
+   uint64_t max;
+} histogram_t;
+
+// Per-group counters only allocated with --profile
+typedef struct {
+   uint64_t transactions;
+   uint64_t events;
+} group_prof_t;
+
+// Switching activity of each element of a group only allocated with
+// --activity and indexed by group ID
+typedef enum {
+   ACT_ZERO,
+   ACT_ONE,
+   ACT_X
+} act_state_t;
+
+typedef struct {
+   uint64_t toggles;
+   uint64_t last_change;
+   uint64_t time[3];      // Time spent in each act_state_t
+} act_elem_t;
+
+typedef struct {
+   const uint8_t *map;    // Signal value to act_state_t
+   act_elem_t     elems[0];
+} group_act_t;
+
+struct signal_chunk {
+   signal_chunk_t *next;
+   size_t          used;
+   size_t          size;
+   uint8_t         data[0];
+};
+
+struct sparse_map {
+   sparse_map_t *next;
+   size_t        size;
+   uint8_t      *data;
 };
 
 struct uarray {
@@ -142,7 +303,9 @@ struct uarray {
 
 struct loaded {
    const char    *name;
-   tree_rd_ctx_t read_ctx;
+   tree_rd_ctx_t  read_ctx;
+   meta_t        *meta;
+   bool           have_meta;
    struct loaded *next;
 };
 
@@ -174,13 +337,15 @@ struct watch_list {
 typedef enum {
    R_MEMO  = (1 << 0),
    R_IDENT = (1 << 1),
+   R_FOLD  = (1 << 2),
 } res_flags_t;
 
 struct res_memo {
    resolution_fn_t fn;
    res_flags_t     flags;
-   int8_t          tab2[16][16];
-   int8_t          tab1[16];
+   int             nlits;
+   restab2_t       tab2;
+   restab1_t       tab1;
 };
 
 typedef enum {
@@ -195,12 +360,84 @@ struct callback {
    callback_t    *next;
 };
 
+typedef enum {
+   DEFER_WAVEFORM,
+   DEFER_EVENT,
+   DEFER_PROCESS,
+   DEFER_ASSERT
+} defer_kind_t;
+
+struct deferred {
+   defer_kind_t kind;
+   unsigned     item;
+   union {
+      struct {
+         netgroup_t *group;
+         size_t      values;
+         int64_t     after;
+         int64_t     reject;
+      } waveform;
+      struct {
+         size_t  nids;
+         int32_t n;
+         int32_t flags;
+      } event;
+      struct {
+         int64_t delay;
+      } process;
+      struct {
+         size_t      msg;
+         int32_t     msg_len;
+         int8_t      severity;
+         int32_t     where;
+         const char *module;
+      } assert;
+   } u;
+};
+
+struct worker {
+   pthread_t   thread;
+   void       *tmp_stack;
+   unsigned    item;
+   deferred_t *ops;
+   size_t      n_ops;
+   size_t      max_ops;
+   size_t      replay;
+   uint8_t    *arena;
+   size_t      arena_sz;
+   size_t      arena_max;
+};
+
+typedef void (*pool_job_fn_t)(worker_t *, unsigned);
+
+struct worker_pool {
+   pthread_mutex_t  lock;
+   pthread_cond_t   start;
+   pthread_cond_t   done;
+   unsigned         generation;
+   unsigned         running;
+   bool             shutdown;
+   unsigned         next;
+   rt_proc_t      **batch;
+   unsigned        *owner;
+   sens_list_t    **batch_sl;
+   unsigned         n_batch;
+   unsigned         max_batch;
+   pool_job_fn_t    job;
+};
+
+typedef struct {
+   FILE  *file;
+   off_t  offset;      // Position when the last checkpoint was taken
+   bool   write;
+} open_file_t;
+
 static struct rt_proc   *procs = NULL;
-static struct rt_proc   *active_proc = NULL;
+static __thread rt_proc_t *active_proc = NULL;
 static struct loaded    *loaded = NULL;
 static struct run_queue  run_queue;
 
-static heap_t        eventq_heap = NULL;
+static eventq_t      eventq_heap = NULL;
 static size_t        n_procs = 0;
 static uint64_t      now = 0;
 static int           iteration = -1;
@@ -210,17 +447,26 @@ static nvc_rusage_t  ready_rusage;
 static jmp_buf       fatal_jmp;
 static bool          aborted = false;
 static netdb_t      *netdb = NULL;
-static netgroup_t   *groups = NULL;
+static netgroup_t      *groups = NULL;
+static netgroup_cold_t *groups_cold = NULL;
+static signal_chunk_t  *resolved_mem = NULL;
+static signal_chunk_t  *last_value_mem = NULL;
+static sparse_map_t    *sparse_mem = NULL;
 static sens_list_t  *pending = NULL;
 static sens_list_t  *resume = NULL;
 static sens_list_t  *postponed = NULL;
+static sens_list_t  *held = NULL;
 static watch_t      *watches = NULL;
 static watch_t      *callbacks = NULL;
 static event_t      *delta_proc = NULL;
 static event_t      *delta_driver = NULL;
+static implicit_t   *implicits = NULL;
+static implicit_t   *implicit_pending = NULL;
+static rt_clock_t   *clocks = NULL;
 static void         *global_tmp_stack = NULL;
-static void         *proc_tmp_stack = NULL;
+static __thread void *proc_tmp_stack = NULL;
 static uint32_t      global_tmp_alloc;
+static void         *tmp_stack_pool = NULL;
 static hash_t       *res_memo_hash = NULL;
 static side_effect_t init_side_effect = SIDE_EFFECT_ALLOW;
 static bool          force_stop;
@@ -229,7 +475,6 @@ static callback_t   *global_cbs[RT_LAST_EVENT];
 static rt_severity_t exit_severity = SEVERITY_ERROR;
 
 static rt_alloc_stack_t event_stack = NULL;
-static rt_alloc_stack_t waveform_stack = NULL;
 static rt_alloc_stack_t sens_list_stack = NULL;
 static rt_alloc_stack_t watch_stack = NULL;
 static rt_alloc_stack_t callback_stack = NULL;
@@ -238,21 +483,90 @@ static netgroup_t **active_groups;
 static unsigned     n_active_groups = 0;
 static unsigned     n_active_alloc = 0;
 
+static worker_t           *workers = NULL;
+static unsigned            n_workers = 0;
+static struct worker_pool  pool;
+static bool                parallel = false;
+static __thread worker_t  *defer_to = NULL;
+static pthread_mutex_t     serial_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t            n_par_batches = 0;
+static uint64_t            n_par_procs = 0;
+static uint64_t            n_stale_events = 0;
+static uint64_t            n_cancel_events = 0;
+static uint64_t            n_batched_events = 0;
+static uint64_t            n_transactions = 0;
+static uint64_t            n_implicit_updates = 0;
+static uint64_t            n_clock_ticks = 0;
+static uint64_t            n_resolution_calls = 0;
+static uint64_t            n_resolution_folds = 0;
+static unsigned            n_sparse_signals = 0;
+static uint64_t            sparse_signal_bytes = 0;
+static uint64_t            n_signal_events = 0;
+static bool                cycle_based = false;
+static int                 checkpoint_fd = -1;
+static open_file_t        *open_files = NULL;
+static unsigned            n_open_files = 0;
+static unsigned            max_open_files = 0;
+static uint64_t            n_held_procs = 0;
+static unsigned            n_tmp_stacks = 0;
+static uint64_t            n_tmp_reused = 0;
+static uint32_t            tmp_stack_hwm = 0;
+static bool                profiling = false;
+static const char         *pgo_collect = NULL;
+static rt_stats_level_t    stats_level = STATS_NONE;
+static rt_phase_t          cur_phase = PHASE_QUEUE;
+static uint64_t            phase_start = 0;
+static uint64_t            phase_ns[PHASE_LAST];
+static histogram_t         hist_deltas;
+static histogram_t         hist_run_queue;
+static histogram_t         hist_eventq;
+static histogram_t         hist_active;
+static rt_alloc_stats_t    alloc_stats[4];
+static rt_huge_pages_t     huge_pages = HUGE_PAGES_NONE;
+static group_prof_t       *group_prof = NULL;
+static group_act_t       **group_act = NULL;
+static const char         *activity_file = NULL;
+
 static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake);
-static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
-                                 rt_proc_t *driver);
-static bool rt_sched_driver(netgroup_t *group, uint64_t after,
-                            uint64_t reject, value_t *values);
+static event_t *deltaq_insert_driver(uint64_t delta, netgroup_t *group,
+                                     int driver);
+static void rt_sched_driver(netgroup_t *group, uint64_t after,
+                            uint64_t reject, const void *values,
+                            event_t **batch);
 static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
-                           rt_proc_t *proc, bool is_static);
+                           rt_proc_t *proc, bool is_static, uint32_t edge);
+static void rt_sched_global_event(netid_t first, netid_t last,
+                                  rt_proc_t *proc, bool is_static);
 static void *rt_tmp_alloc(size_t sz);
+static void rt_pool_run(pool_job_fn_t job);
+static void rt_touch_job(worker_t *w, unsigned index);
 static value_t *rt_alloc_value(netgroup_t *g);
+static void *rt_signal_alloc(signal_chunk_t **chunks, size_t sz);
+static void *rt_sparse_alloc(size_t sz);
 static tree_t rt_recall_tree(const char *unit, int32_t where);
+static void rt_recall_info(const char *unit, int32_t where, meta_info_t *info);
 static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn);
 static void _tracef(const char *fmt, ...);
-
-#define GLOBAL_TMP_STACK_SZ (1024 * 1024)
+static deferred_t *rt_defer(defer_kind_t kind);
+static size_t rt_defer_alloc(size_t sz);
+static size_t rt_defer_copy(const void *src, size_t sz);
+static void rt_sched_group_waveform(netgroup_t *g, const void *values,
+                                    int64_t after, int64_t reject,
+                                    event_t **batch);
+static void rt_free_implicits(void);
+static void rt_free_clocks(void);
+static void rt_update_group(netgroup_t *group, int driver, void *values);
+
+// Pages are only touched when used so the global stack can be large
+// enough for big aggregates created at reset
+#define GLOBAL_TMP_STACK_SZ (32 * 1024 * 1024)
 #define PROC_TMP_STACK_SZ   (64 * 1024)
+#define PAR_MIN_BATCH       8
+#define DRIVER_MAP_MIN      8
+#define DRIVER_RING_MIN     4
+#define SIGNAL_CHUNK_SZ     (1024 * 1024)
+#define HUGE_CHUNK_SZ       (2 * 1024 * 1024)
+#define SPARSE_SIGNAL_MIN   (4 * 1024 * 1024)
 
 #define TRACE(...) do {                                 \
       if (unlikely(trace_on)) _tracef(__VA_ARGS__);     \
@@ -274,6 +588,17 @@ static void _tracef(const char *fmt, ...);
 ////////////////////////////////////////////////////////////////////////////////
 // Utilities
 
+static inline netgroup_cold_t *rt_cold(const netgroup_t *g)
+{
+   return &(groups_cold[g - groups]);
+}
+
+static inline void rt_observe(netgroup_t *g)
+{
+   // Events on this group may now be observed
+   g->flags &= ~NET_F_NO_READERS;
+}
+
 static const char *fmt_group(const netgroup_t *g)
 {
    static const size_t BUF_LEN = 512;
@@ -282,14 +607,15 @@ static const char *fmt_group(const netgroup_t *g)
    const char *eptr = buf + BUF_LEN;
    char *p = buf;
 
-   p += checked_sprintf(p, eptr - p, "%s", istr(tree_ident(g->sig_decl)));
+   tree_t decl = rt_cold(g)->sig_decl;
+   p += checked_sprintf(p, eptr - p, "%s", istr(tree_ident(decl)));
 
-   groupid_t sig_group0 = netdb_lookup(netdb, tree_net(g->sig_decl, 0));
+   groupid_t sig_group0 = netdb_lookup(netdb, tree_net(decl, 0));
    netid_t sig_net0 = groups[sig_group0].first;
    int offset = g->first - sig_net0;
 
    const int length = g->length;
-   type_t type = tree_type(g->sig_decl);
+   type_t type = tree_type(decl);
    while (type_is_array(type)) {
       const int stride = type_width(type_elem(type));
       const int ndims = type_dims(type);
@@ -346,16 +672,118 @@ static inline uint64_t heap_key(uint64_t when, event_kind_t kind)
    return (when << 2) | (kind & 3);
 }
 
+static inline int rt_find_driver(netgroup_t *group, rt_proc_t *proc)
+{
+   // Return the index of the driver for group owned by proc or -1
+
+   if (group->n_drivers > DRIVER_MAP_MIN)
+      return (intptr_t)hash_get(rt_cold(group)->driver_map, proc) - 1;
+
+   for (int driver = 0; driver < group->n_drivers; driver++) {
+      if (likely(group->drivers[driver].proc == proc))
+         return driver;
+   }
+
+   return -1;
+}
+
+static inline uint32_t rt_driver_slot(const driver_t *d, uint32_t nth)
+{
+   // Index in the ring of the nth transaction where the first is the
+   // current driving value
+   return (d->head + nth) & (d->size - 1);
+}
+
+static inline bool rt_inline_value(size_t valuesz)
+{
+   return valuesz <= sizeof(uint64_t);
+}
+
+static inline uint64_t rt_value_word(const void *p, size_t valuesz)
+{
+   // Load a small value into a zero padded word so that values can be
+   // compared as integers
+   uint64_t word = 0;
+   switch (valuesz) {
+   case 1: memcpy(&word, p, 1); break;
+   case 2: memcpy(&word, p, 2); break;
+   case 4: memcpy(&word, p, 4); break;
+   case 8: memcpy(&word, p, 8); break;
+   default: memcpy(&word, p, valuesz); break;
+   }
+   return word;
+}
+
+static inline void *rt_driver_value(const netgroup_t *g, const driver_t *d,
+                                    uint32_t nth)
+{
+   const size_t valuesz = g->size * g->length;
+   const uint32_t slot = rt_driver_slot(d, nth);
+
+   if (rt_inline_value(valuesz))
+      return &(d->waveforms[slot].word);
+   else
+      return d->values + slot * valuesz;
+}
+
+static void rt_alloc_driver_ring(const netgroup_t *g, driver_t *d,
+                                 uint32_t size)
+{
+   // The transaction headers and values larger than a word share one
+   // allocation
+   assert((size & (size - 1)) == 0);
+
+   const size_t valuesz = g->size * g->length;
+   const size_t extra = rt_inline_value(valuesz) ? 0 : valuesz;
+   const size_t bytes = size * (sizeof(waveform_t) + extra);
+
+   // Large zeroed allocations are mapped on demand by the C library
+   // which lets the initial driver value of a memory be copied sparsely
+   waveform_t *waves =
+      valuesz >= SPARSE_SIGNAL_MIN ? xcalloc(bytes) : xmalloc(bytes);
+   uint8_t *values = extra ? (uint8_t *)(waves + size) : NULL;
+
+   for (uint32_t i = 0; i < d->count; i++) {
+      const uint32_t slot = rt_driver_slot(d, i);
+      waves[i] = d->waveforms[slot];
+      if (values != NULL)
+         memcpy(values + i * valuesz, d->values + slot * valuesz, valuesz);
+   }
+
+   free(d->waveforms);
+
+   d->waveforms = waves;
+   d->values    = values;
+   d->head      = 0;
+   d->size      = size;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Runtime support functions
 
-void     *_tmp_stack;
-uint32_t  _tmp_alloc;
+static __thread void     *_tmp_stack;
+static __thread uint32_t  _tmp_alloc;
+
+void **_tmp_stack_ptr(void)
+{
+   return &_tmp_stack;
+}
+
+uint32_t *_tmp_alloc_ptr(void)
+{
+   return &_tmp_alloc;
+}
 
 void _sched_process(int64_t delay)
 {
    TRACE("_sched_process delay=%s", fmt_time(delay));
-   deltaq_insert_proc(delay, active_proc);
+
+   if (unlikely(defer_to != NULL)) {
+      deferred_t *d = rt_defer(DEFER_PROCESS);
+      d->u.process.delay = delay;
+   }
+   else
+      deltaq_insert_proc(delay, active_proc);
 }
 
 void _sched_waveform(void *_nids, void *values, int32_t n,
@@ -372,6 +800,11 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
       fatal("postponed process %s cannot cause a delta cycle",
             istr(tree_ident(active_proc->source)));
 
+   // Zero delay transactions for consecutive groups share a single
+   // driver event as they are never cancelled from the delta queue
+   event_t *batch = NULL;
+   event_t **batchp = (after == 0) ? &batch : NULL;
+
    const uint8_t *vp = values;
    int offset = 0;
    while (offset < n) {
@@ -379,11 +812,15 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
       if (likely(nid != NETID_INVALID)) {
          netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
 
-         value_t *values_copy = rt_alloc_value(g);
-         memcpy(values_copy->data, vp, g->size * g->length);
-
-         if (!rt_sched_driver(g, after, reject, values_copy))
-            deltaq_insert_driver(after, g, active_proc);
+         if (unlikely(defer_to != NULL)) {
+            deferred_t *d = rt_defer(DEFER_WAVEFORM);
+            d->u.waveform.group  = g;
+            d->u.waveform.values = rt_defer_copy(vp, g->size * g->length);
+            d->u.waveform.after  = after;
+            d->u.waveform.reject = reject;
+         }
+         else
+            rt_sched_group_waveform(g, vp, after, reject, batchp);
 
          vp += g->size * g->length;
          offset += g->length;
@@ -402,29 +839,45 @@ void _sched_event(void *_nids, int32_t n, int32_t flags)
    TRACE("_sched_event %s n=%d flags=%d proc %s", fmt_net(nids[0]), n,
          flags, istr(tree_ident(active_proc->source)));
 
+   if (unlikely(defer_to != NULL)) {
+      deferred_t *d = rt_defer(DEFER_EVENT);
+      d->u.event.nids  = rt_defer_copy(nids, n * sizeof(int32_t));
+      d->u.event.n     = n;
+      d->u.event.flags = flags;
+      return;
+   }
+
    netgroup_t *g0 = &(groups[netdb_lookup(netdb, nids[0])]);
+   rt_observe(g0);
 
    if (g0->length == n) {
+      // The value filter for an edge qualified wait only applies to a
+      // single scalar net
+      const uint32_t edge = (n == 1 && g0->size == 1)
+         ? (uint32_t)flags >> SCHED_EDGE_SHIFT : 0;
+
       rt_sched_event(&(g0->pending), NETID_INVALID, NETID_INVALID,
-                     active_proc, flags & SCHED_STATIC);
+                     active_proc, flags & SCHED_STATIC, edge);
    }
    else {
       const bool global = !!(flags & SCHED_SEQUENTIAL);
       if (global) {
-         // Place on the global pending list
-         rt_sched_event(&pending, nids[0], nids[n - 1], active_proc,
-                        flags & SCHED_STATIC);
+         // Place in the global pending index
+         rt_sched_global_event(nids[0], nids[n - 1], active_proc,
+                               flags & SCHED_STATIC);
       }
 
       int offset = 0;
       netgroup_t *g = g0;
       for (;;) {
+         rt_observe(g);
+
          if (global)
             g->flags |= NET_F_GLOBAL;
          else {
             // Place on the net group's pending list
             rt_sched_event(&(g->pending), NETID_INVALID, NETID_INVALID,
-                           active_proc, flags & SCHED_STATIC);
+                           active_proc, flags & SCHED_STATIC, 0);
          }
 
          offset += g->length;
@@ -451,17 +904,15 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
       offset += g->length;
 
       // Try to find this process in the list of existing drivers
-      int driver;
-      for (driver = 0; driver < g->n_drivers; driver++) {
-         if (likely(g->drivers[driver].proc == active_proc))
-            break;
-      }
+      int driver = rt_find_driver(g, active_proc);
 
       // Allocate memory for drivers on demand
-      if (driver == g->n_drivers) {
+      if (driver == -1) {
+         driver = g->n_drivers;
+
          if ((g->n_drivers == 1) && (g->resolution == NULL))
-            fatal_at(tree_loc(g->sig_decl), "group %s has multiple drivers "
-                     "but no resolution function", fmt_group(g));
+            fatal_at(tree_loc(rt_cold(g)->sig_decl), "group %s has multiple "
+                     "drivers but no resolution function", fmt_group(g));
 
          const size_t driver_sz = sizeof(struct driver);
          g->drivers = xrealloc(g->drivers, (driver + 1) * driver_sz);
@@ -475,22 +926,64 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
          driver_t *d = &(g->drivers[driver]);
          d->proc = active_proc;
 
+         netgroup_cold_t *cold = rt_cold(g);
+         if (cold->driver_map != NULL)
+            hash_put(cold->driver_map, active_proc,
+                     (void *)(uintptr_t)(driver + 1));
+         else if (g->n_drivers > DRIVER_MAP_MIN) {
+            // Switch to a map from process to driver index for groups
+            // with many drivers such as tri-state buses
+            cold->driver_map = hash_new(DRIVER_MAP_MIN * 4, false);
+            for (int i = 0; i < g->n_drivers; i++)
+               hash_put(cold->driver_map, g->drivers[i].proc,
+                        (void *)(uintptr_t)(i + 1));
+         }
+
          const void *src = (init == NULL) ? g->resolved : initp;
 
          // Assign the initial value of the driver
-         waveform_t *dummy = rt_alloc(waveform_stack);
-         dummy->when   = 0;
-         dummy->next   = NULL;
-         dummy->values = rt_alloc_value(g);
-         memcpy(dummy->values->data, src, g->length * g->size);
-
-         d->waveforms = dummy;
+         rt_alloc_driver_ring(g, d, DRIVER_RING_MIN);
+         d->count = 1;
+         d->waveforms[0].when  = 0;
+         d->waveforms[0].event = NULL;
+         d->waveforms[0].word  = 0;
+
+         const size_t valuesz = g->length * g->size;
+         if (valuesz >= SPARSE_SIGNAL_MIN)
+            copy_sparse(rt_driver_value(g, d, 0), src, valuesz);
+         else
+            memcpy(rt_driver_value(g, d, 0), src, valuesz);
       }
 
       initp += g->length * g->size;
    }
 }
 
+static void *rt_tmp_stack_get(void)
+{
+   // Reuse a stack released by another process before mapping a new
+   // one: the caller must hold the serial lock when running in parallel
+
+   void *stack = tmp_stack_pool;
+   if (stack != NULL) {
+      tmp_stack_pool = *(void **)stack;
+      n_tmp_reused++;
+   }
+   else {
+      stack = mmap_guarded(PROC_TMP_STACK_SZ, "process temp stack");
+      n_tmp_stacks++;
+   }
+
+   return stack;
+}
+
+static void rt_tmp_stack_put(void *stack)
+{
+   // The stack is empty so the free list can be linked through it
+   *(void **)stack = tmp_stack_pool;
+   tmp_stack_pool = stack;
+}
+
 void _private_stack(void)
 {
    TRACE("_private_stack %p %d %d", active_proc->tmp_stack,
@@ -499,8 +992,14 @@ void _private_stack(void)
    if (active_proc->tmp_stack == NULL && _tmp_alloc > 0) {
       active_proc->tmp_stack = _tmp_stack;
 
-      proc_tmp_stack = mmap_guarded(PROC_TMP_STACK_SZ,
-                                    istr(tree_ident(active_proc->source)));
+      if (parallel)
+         pthread_mutex_lock(&serial_lock);
+
+      proc_tmp_stack = rt_tmp_stack_get();
+      tmp_stack_hwm = MAX(tmp_stack_hwm, _tmp_alloc);
+
+      if (parallel)
+         pthread_mutex_unlock(&serial_lock);
    }
 
    active_proc->tmp_alloc = _tmp_alloc;
@@ -522,6 +1021,7 @@ void _needs_last_value(const int32_t *nids, int32_t n)
    while (offset < n) {
       netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
       g->flags |= NET_F_LAST_VALUE;
+      rt_observe(g);
 
       offset += g->length;
    }
@@ -545,36 +1045,54 @@ void _set_initial(int32_t nid, const uint8_t *values, const int32_t *size_list,
    for (int i = 0; i < nparts; i++)
       total_size += size_list[i * 2] * size_list[(i * 2) + 1];
 
-   uint8_t *res_mem  = xmalloc(total_size * 2);
-   uint8_t *last_mem = res_mem + total_size;
+   // The resolved values of all signals are packed together in net ID
+   // order away from the rarely used last values. Very large signals
+   // such as memories are instead mapped lazily so that only the pages
+   // written during simulation use physical memory.
+   const bool sparse = total_size >= SPARSE_SIGNAL_MIN;
+   uint8_t *res_mem, *last_mem;
+   if (sparse) {
+      res_mem  = rt_sparse_alloc(total_size);
+      last_mem = rt_sparse_alloc(total_size);
+
+      copy_sparse(res_mem, values, total_size);
+      copy_sparse(last_mem, values, total_size);
+
+      n_sparse_signals++;
+      sparse_signal_bytes += total_size;
+   }
+   else {
+      res_mem  = rt_signal_alloc(&resolved_mem, total_size);
+      last_mem = rt_signal_alloc(&last_value_mem, total_size);
+   }
 
    const uint8_t *src = values;
    int offset = 0, part = 0, remain = size_list[1];
    while (part < nparts) {
       groupid_t gid = netdb_lookup(netdb, nid + offset);
       netgroup_t *g = &(groups[gid]);
+      netgroup_cold_t *cold = rt_cold(g);
 
       const int size = size_list[part * 2];
 
-      assert(g->sig_decl == NULL);
+      assert(cold->sig_decl == NULL);
       assert(remain >= g->length);
 
-      g->sig_decl   = decl;
-      g->resolution = memo;
-      g->size       = size;
-      g->resolved   = res_mem;
-      g->last_value = last_mem;
-
-      if (offset == 0)
-         g->flags |= NET_F_OWNS_MEM;
+      cold->sig_decl   = decl;
+      cold->last_value = last_mem;
+      g->resolution    = memo;
+      g->size          = size;
+      g->resolved      = res_mem;
 
       const int nbytes = g->length * size;
 
       res_mem += nbytes;
       last_mem += nbytes;
 
-      memcpy(g->resolved, src, nbytes);
-      memcpy(g->last_value, src, nbytes);
+      if (!sparse) {
+         memcpy(g->resolved, src, nbytes);
+         memcpy(cold->last_value, src, nbytes);
+      }
 
       offset += g->length;
       src    += nbytes;
@@ -608,9 +1126,26 @@ void _assert_fail(const uint8_t *msg, int32_t msg_len, int8_t severity,
       return;
    }
 
-   tree_t t = rt_recall_tree(module, where);
-   const loc_t *loc = tree_loc(t);
-   bool is_report = tree_attr_int(t, ident_new("is_report"), 0);
+   if (unlikely(defer_to != NULL)) {
+      // Report the assertion in process order after the batch completes
+      deferred_t *d = rt_defer(DEFER_ASSERT);
+      d->u.assert.msg_len  = msg_len;
+      d->u.assert.severity = severity;
+      d->u.assert.where    = where;
+      d->u.assert.module   = module;
+
+      const size_t len = (msg_len >= 0) ? msg_len : strlen((const char *)msg);
+      d->u.assert.msg = rt_defer_alloc(len + 1);
+
+      uint8_t *copy = defer_to->arena + d->u.assert.msg;
+      memcpy(copy, msg, len);
+      copy[len] = '\0';
+      return;
+   }
+
+   meta_info_t info;
+   rt_recall_info(module, where, &info);
+   const bool is_report = !!(info.flags & META_F_REPORT);
 
    char *copy = NULL;
    if (msg_len >= 0) {
@@ -631,7 +1166,7 @@ void _assert_fail(const uint8_t *msg, int32_t msg_len, int8_t severity,
    if (severity >= exit_severity)
       fn = fatal_at;
 
-   (*fn)(loc, "%s+%d: %s %s: %s\r\tProcess %s",
+   (*fn)(&info.loc, "%s+%d: %s %s: %s\r\tProcess %s",
          fmt_time(now), iteration,
          (is_report ? "Report" : "Assertion"),
          levels[severity],
@@ -646,18 +1181,19 @@ void _assert_fail(const uint8_t *msg, int32_t msg_len, int8_t severity,
 void _bounds_fail(int32_t where, const char *module, int32_t value,
                   int32_t min, int32_t max, int32_t kind, int32_t hint)
 {
-   tree_t t = rt_recall_tree(module, where);
-   const loc_t *loc = tree_loc(t);
+   meta_info_t info;
+   rt_recall_info(module, where, &info);
+   const loc_t *loc = &info.loc;
 
    const char *suffix = "";
-   tree_kind_t tkind = tree_kind(t);
-   if (tkind == T_PORT_DECL) {
-      tree_t call_site = rt_recall_tree(module, hint);
-      loc = tree_loc(call_site);
-      suffix = xasprintf(" for parameter %s", istr(tree_ident(t)));
+   meta_info_t call_site;
+   if (info.kind == T_PORT_DECL) {
+      rt_recall_info(module, hint, &call_site);
+      loc = &call_site.loc;
+      suffix = xasprintf(" for parameter %s", info.name);
    }
-   else if (tkind == T_VAR_DECL)
-      suffix = xasprintf(" for variable %s", istr(tree_ident(t)));
+   else if (info.kind == T_VAR_DECL)
+      suffix = xasprintf(" for variable %s", info.name);
 
    switch ((bounds_kind_t)kind) {
    case BOUNDS_ARRAY_TO:
@@ -670,8 +1206,10 @@ void _bounds_fail(int32_t where, const char *module, int32_t value,
       break;
 
    case BOUNDS_ENUM:
+      // Printing the type name needs the full tree
       fatal_at(loc, "value %d outside %s bounds %d to %d%s",
-               value, type_pp(tree_type(t)), min, max, suffix);
+               value, type_pp(tree_type(rt_recall_tree(module, where))),
+               min, max, suffix);
       break;
 
    case BOUNDS_TYPE_TO:
@@ -721,14 +1259,16 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
 
 void _div_zero(int32_t where, const char *module)
 {
-   tree_t t = rt_recall_tree(module, where);
-   fatal_at(tree_loc(t), "division by zero");
+   meta_info_t info;
+   rt_recall_info(module, where, &info);
+   fatal_at(&info.loc, "division by zero");
 }
 
 void _null_deref(int32_t where, const char *module)
 {
-   tree_t t = rt_recall_tree(module, where);
-   fatal_at(tree_loc(t), "null access dereference");
+   meta_info_t info;
+   rt_recall_info(module, where, &info);
+   fatal_at(&info.loc, "null access dereference");
 }
 
 int64_t _std_standard_now(void)
@@ -763,21 +1303,35 @@ void *_vec_load(const int32_t *nids, void *where,
    if (offset + g->length - skip > high) {
       // If the signal data is already contiguous return a pointer to
       // that rather than copying into the user buffer
-      void *r = unlikely(last) ? g->last_value : g->resolved;
+      void *r = unlikely(last) ? rt_cold(g)->last_value : g->resolved;
       return (uint8_t *)r + (skip * g->size);
    }
 
-   uint8_t *p = where;
+   // Groups belonging to the same signal are usually adjacent in memory
+   // so only start copying at the first discontinuity
+   uint8_t *start = NULL, *next = NULL, *p = NULL;
    for (;;) {
       const int to_copy = MIN(high - offset + 1, g->length - skip);
       const int bytes   = to_copy * g->size;
 
-      const void *src = unlikely(last) ? g->last_value : g->resolved;
+      uint8_t *src = unlikely(last) ? rt_cold(g)->last_value : g->resolved;
+      src += skip * g->size;
+
+      if (start == NULL)
+         start = src;
+      else if (p == NULL && src != next) {
+         const size_t done = next - start;
+         memcpy(where, start, done);
+         p = (uint8_t *)where + done;
+      }
 
-      memcpy(p, (uint8_t *)src + (skip * g->size), bytes);
+      if (p != NULL) {
+         memcpy(p, src, bytes);
+         p += bytes;
+      }
 
+      next = src + bytes;
       offset += g->length - skip;
-      p += bytes;
 
       if (offset > high)
          break;
@@ -787,6 +1341,9 @@ void *_vec_load(const int32_t *nids, void *where,
       skip = nids[offset] - g->first;
    }
 
+   if (p == NULL)
+      return start;
+
    // Signal data was non-contiguous so return the user buffer
    return where;
 }
@@ -838,6 +1395,40 @@ void _image(int64_t val, int32_t where, const char *module, struct uarray *u)
    u->dims[0].dir   = RANGE_TO;
 }
 
+void _image_int(int64_t val, struct uarray *u)
+{
+   char tmp[24], *p = tmp + sizeof(tmp);
+   uint64_t mag = (val < 0) ? -(uint64_t)val : val;
+   do {
+      *--p = '0' + (mag % 10);
+      mag /= 10;
+   } while (mag > 0);
+
+   if (val < 0)
+      *--p = '-';
+
+   const size_t len = tmp + sizeof(tmp) - p;
+   char *buf = rt_tmp_alloc(len);
+   memcpy(buf, p, len);
+
+   u->ptr = buf;
+   u->dims[0].left  = 1;
+   u->dims[0].right = len;
+   u->dims[0].dir   = RANGE_TO;
+}
+
+void _image_real(double val, struct uarray *u)
+{
+   const size_t max = 32;
+   char *buf = rt_tmp_alloc(max);
+   size_t len = snprintf(buf, max, "%.*g", DBL_DIG + 3, val);
+
+   u->ptr = buf;
+   u->dims[0].left  = 1;
+   u->dims[0].right = len;
+   u->dims[0].dir   = RANGE_TO;
+}
+
 void _bit_shift(int32_t kind, const uint8_t *data, int32_t len,
                 int8_t dir, int32_t shift, struct uarray *u)
 {
@@ -846,37 +1437,62 @@ void _bit_shift(int32_t kind, const uint8_t *data, int32_t len,
       shift = -shift;
    }
 
-   shift %= len;
-
    uint8_t *buf = rt_tmp_alloc(len);
 
-   for (int i = 0; i < len; i++) {
-      switch (kind) {
-      case BIT_SHIFT_SLL:
-         buf[i] = (i < len - shift) ? data[i + shift] : 0;
-         break;
-      case BIT_SHIFT_SRL:
-         buf[i] = (i >= shift) ? data[i - shift] : 0;
-         break;
-      case BIT_SHIFT_SLA:
-         buf[i] = (i < len - shift) ? data[i + shift] : data[len - 1];
-         break;
-      case BIT_SHIFT_SRA:
-         buf[i] = (i >= shift) ? data[i - shift] : data[0];
-         break;
-      case BIT_SHIFT_ROL:
-         buf[i] = (i < len - shift) ? data[i + shift] : data[(i + shift) % len];
-         break;
-      case BIT_SHIFT_ROR:
-         buf[i] = (i >= shift) ? data[i - shift] : data[len + i - shift];
-         break;
-      }
-   }
-
    u->ptr = buf;
    u->dims[0].left  = (dir == RANGE_TO) ? 0 : len - 1;
    u->dims[0].right = (dir == RANGE_TO) ? len - 1 : 0;
    u->dims[0].dir   = dir;
+
+   if (len == 0)
+      return;   // Null range has no fill element to read
+
+   shift %= len;
+
+   // Each shift is a move of the part of the vector that is kept plus
+   // a fill or a second move for the vacated elements
+   switch (kind) {
+   case BIT_SHIFT_SLL:
+      memcpy(buf, data + shift, len - shift);
+      memset(buf + len - shift, 0, shift);
+      break;
+   case BIT_SHIFT_SRL:
+      memset(buf, 0, shift);
+      memcpy(buf + shift, data, len - shift);
+      break;
+   case BIT_SHIFT_SLA:
+      memcpy(buf, data + shift, len - shift);
+      memset(buf + len - shift, data[len - 1], shift);
+      break;
+   case BIT_SHIFT_SRA:
+      memset(buf, data[0], shift);
+      memcpy(buf + shift, data, len - shift);
+      break;
+   case BIT_SHIFT_ROL:
+      memcpy(buf, data + shift, len - shift);
+      memcpy(buf + len - shift, data, shift);
+      break;
+   case BIT_SHIFT_ROR:
+      memcpy(buf, data + len - shift, shift);
+      memcpy(buf + shift, data, len - shift);
+      break;
+   }
+}
+
+static inline uint64_t rt_bit_vec_word(int32_t kind, uint64_t l, uint64_t r)
+{
+   const uint64_t ones = UINT64_C(0x0101010101010101);
+
+   switch (kind) {
+   case BIT_VEC_NOT:  return l ^ ones;
+   case BIT_VEC_AND:  return l & r;
+   case BIT_VEC_OR:   return l | r;
+   case BIT_VEC_XOR:  return l ^ r;
+   case BIT_VEC_XNOR: return l ^ r ^ ones;
+   case BIT_VEC_NAND: return (l & r) ^ ones;
+   case BIT_VEC_NOR:  return (l | r) ^ ones;
+   default:           return 0;
+   }
 }
 
 void _bit_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
@@ -888,41 +1504,23 @@ void _bit_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
 
    uint8_t *buf = rt_tmp_alloc(left_len);
 
-   switch (kind) {
-   case BIT_VEC_NOT:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !left[i];
-      break;
-
-   case BIT_VEC_AND:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = left[i] && right[i];
-      break;
-
-   case BIT_VEC_OR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = left[i] || right[i];
-      break;
-
-   case BIT_VEC_XOR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = left[i] ^ right[i];
-      break;
+   // Elements are always zero or one so eight at a time can be combined
+   // with bitwise operations on a machine word
 
-   case BIT_VEC_XNOR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !(left[i] ^ right[i]);
-      break;
+   int i = 0;
+   for (; i + 8 <= left_len; i += 8) {
+      uint64_t l, r = 0;
+      memcpy(&l, left + i, 8);
+      if (kind != BIT_VEC_NOT)
+         memcpy(&r, right + i, 8);
 
-   case BIT_VEC_NAND:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !(left[i] && right[i]);
-      break;
+      const uint64_t w = rt_bit_vec_word(kind, l, r);
+      memcpy(buf + i, &w, 8);
+   }
 
-   case BIT_VEC_NOR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !(left[i] || right[i]);
-      break;
+   for (; i < left_len; i++) {
+      const uint8_t r = (kind != BIT_VEC_NOT) ? right[i] : 0;
+      buf[i] = rt_bit_vec_word(kind, left[i], r) & 1;
    }
 
    u->ptr = buf;
@@ -931,6 +1529,141 @@ void _bit_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
    u->dims[0].dir   = left_dir;
 }
 
+#define SL_U 0
+#define SL_X 1
+#define SL_0 2
+#define SL_1 3
+
+// Tables from the IEEE.STD_LOGIC_1164 package body indexed by the
+// position of each std_ulogic value
+static const uint8_t logic_and_table[9][9] = {
+   { SL_U, SL_U, SL_0, SL_U, SL_U, SL_U, SL_0, SL_U, SL_U },
+   { SL_U, SL_X, SL_0, SL_X, SL_X, SL_X, SL_0, SL_X, SL_X },
+   { SL_0, SL_0, SL_0, SL_0, SL_0, SL_0, SL_0, SL_0, SL_0 },
+   { SL_U, SL_X, SL_0, SL_1, SL_X, SL_X, SL_0, SL_1, SL_X },
+   { SL_U, SL_X, SL_0, SL_X, SL_X, SL_X, SL_0, SL_X, SL_X },
+   { SL_U, SL_X, SL_0, SL_X, SL_X, SL_X, SL_0, SL_X, SL_X },
+   { SL_0, SL_0, SL_0, SL_0, SL_0, SL_0, SL_0, SL_0, SL_0 },
+   { SL_U, SL_X, SL_0, SL_1, SL_X, SL_X, SL_0, SL_1, SL_X },
+   { SL_U, SL_X, SL_0, SL_X, SL_X, SL_X, SL_0, SL_X, SL_X }
+};
+
+static const uint8_t logic_or_table[9][9] = {
+   { SL_U, SL_U, SL_U, SL_1, SL_U, SL_U, SL_U, SL_1, SL_U },
+   { SL_U, SL_X, SL_X, SL_1, SL_X, SL_X, SL_X, SL_1, SL_X },
+   { SL_U, SL_X, SL_0, SL_1, SL_X, SL_X, SL_0, SL_1, SL_X },
+   { SL_1, SL_1, SL_1, SL_1, SL_1, SL_1, SL_1, SL_1, SL_1 },
+   { SL_U, SL_X, SL_X, SL_1, SL_X, SL_X, SL_X, SL_1, SL_X },
+   { SL_U, SL_X, SL_X, SL_1, SL_X, SL_X, SL_X, SL_1, SL_X },
+   { SL_U, SL_X, SL_0, SL_1, SL_X, SL_X, SL_0, SL_1, SL_X },
+   { SL_1, SL_1, SL_1, SL_1, SL_1, SL_1, SL_1, SL_1, SL_1 },
+   { SL_U, SL_X, SL_X, SL_1, SL_X, SL_X, SL_X, SL_1, SL_X }
+};
+
+static const uint8_t logic_xor_table[9][9] = {
+   { SL_U, SL_U, SL_U, SL_U, SL_U, SL_U, SL_U, SL_U, SL_U },
+   { SL_U, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X },
+   { SL_U, SL_X, SL_0, SL_1, SL_X, SL_X, SL_0, SL_1, SL_X },
+   { SL_U, SL_X, SL_1, SL_0, SL_X, SL_X, SL_1, SL_0, SL_X },
+   { SL_U, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X },
+   { SL_U, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X },
+   { SL_U, SL_X, SL_0, SL_1, SL_X, SL_X, SL_0, SL_1, SL_X },
+   { SL_U, SL_X, SL_1, SL_0, SL_X, SL_X, SL_1, SL_0, SL_X },
+   { SL_U, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X, SL_X }
+};
+
+static const uint8_t logic_not_table[9] = {
+   SL_U, SL_X, SL_1, SL_0, SL_X, SL_X, SL_1, SL_0, SL_X
+};
+
+static void rt_logic_vec_slow(int32_t kind, const uint8_t *left,
+                              const uint8_t *right, uint8_t *buf, int len)
+{
+   for (int i = 0; i < len; i++) {
+      switch (kind) {
+      case LOGIC_VEC_NOT:
+         buf[i] = logic_not_table[left[i]];
+         break;
+      case LOGIC_VEC_AND:
+         buf[i] = logic_and_table[left[i]][right[i]];
+         break;
+      case LOGIC_VEC_OR:
+         buf[i] = logic_or_table[left[i]][right[i]];
+         break;
+      case LOGIC_VEC_XOR:
+         buf[i] = logic_xor_table[left[i]][right[i]];
+         break;
+      case LOGIC_VEC_XNOR:
+         buf[i] = logic_not_table[logic_xor_table[left[i]][right[i]]];
+         break;
+      case LOGIC_VEC_NAND:
+         buf[i] = logic_not_table[logic_and_table[left[i]][right[i]]];
+         break;
+      case LOGIC_VEC_NOR:
+         buf[i] = logic_not_table[logic_or_table[left[i]][right[i]]];
+         break;
+      }
+   }
+}
+
+void _logic_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
+                   int8_t left_dir, const uint8_t *right, int32_t right_len,
+                   int8_t right_dir, struct uarray *u)
+{
+   static const char *names[] = {
+      "not", "and", "or", "xor", "xnor", "nand", "nor"
+   };
+
+   if ((kind != LOGIC_VEC_NOT) && (left_len != right_len))
+      fatal("arguments of overloaded '%s' operator are not of the same "
+            "length", names[kind - LOGIC_VEC_NOT]);
+
+   uint8_t *buf = rt_tmp_alloc(left_len);
+
+   // The encodings of '0' and '1' differ only in the low bit so eight
+   // elements at a time can be combined with ordinary bitwise operations
+   // when none of them is a metavalue
+
+   const uint64_t ones = UINT64_C(0x0101010101010101);
+   const uint64_t twos = UINT64_C(0x0202020202020202);
+   const uint64_t mask = UINT64_C(0xfefefefefefefefe);
+
+   int i = 0;
+   for (; i + 8 <= left_len; i += 8) {
+      uint64_t l, r = twos, w = 0;
+      memcpy(&l, left + i, 8);
+      if (kind != LOGIC_VEC_NOT)
+         memcpy(&r, right + i, 8);
+
+      if ((l & mask) != twos || (r & mask) != twos) {
+         rt_logic_vec_slow(kind, left + i, right ? right + i : NULL,
+                           buf + i, 8);
+         continue;
+      }
+
+      switch (kind) {
+      case LOGIC_VEC_NOT:  w = l ^ ones; break;
+      case LOGIC_VEC_AND:  w = l & r; break;
+      case LOGIC_VEC_OR:   w = l | r; break;
+      case LOGIC_VEC_XOR:  w = (l ^ r) | twos; break;
+      case LOGIC_VEC_XNOR: w = (l ^ r ^ ones) | twos; break;
+      case LOGIC_VEC_NAND: w = (l & r) ^ ones; break;
+      case LOGIC_VEC_NOR:  w = (l | r) ^ ones; break;
+      }
+
+      memcpy(buf + i, &w, 8);
+   }
+
+   rt_logic_vec_slow(kind, left + i, right ? right + i : NULL,
+                     buf + i, left_len - i);
+
+   // The result has the range 1 to L'LENGTH like the package body
+   u->ptr = buf;
+   u->dims[0].left  = 1;
+   u->dims[0].right = left_len;
+   u->dims[0].dir   = RANGE_TO;
+}
+
 void _debug_out(int32_t val, int32_t reg)
 {
    printf("DEBUG: r%d val=%"PRIx32"\n", reg, val);
@@ -956,6 +1689,7 @@ int64_t _last_event(const int32_t *nids, int32_t n)
    int offset = 0;
    while (offset < n) {
       netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
+      rt_observe(g);
       if (g->last_event < now)
          last = MIN(last, now - g->last_event);
 
@@ -972,6 +1706,7 @@ int32_t _test_net_flag(const int32_t *nids, int32_t n, int32_t flag)
    int offset = 0;
    while (offset < n) {
       netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
+      rt_observe(g);
 
       if (g->flags & flag)
          return 1;
@@ -982,6 +1717,32 @@ int32_t _test_net_flag(const int32_t *nids, int32_t n, int32_t flag)
    return 0;
 }
 
+static void rt_add_open_file(FILE *f, bool write)
+{
+   // Files opened by the design are recorded so their positions can be
+   // saved and restored with a checkpoint
+
+   if (n_open_files == max_open_files) {
+      max_open_files = MAX(max_open_files * 2, 16);
+      open_files = xrealloc(open_files, max_open_files * sizeof(open_file_t));
+   }
+
+   open_files[n_open_files].file   = f;
+   open_files[n_open_files].offset = 0;
+   open_files[n_open_files].write  = write;
+   n_open_files++;
+}
+
+static void rt_remove_open_file(FILE *f)
+{
+   for (unsigned i = 0; i < n_open_files; i++) {
+      if (open_files[i].file == f) {
+         open_files[i] = open_files[--n_open_files];
+         return;
+      }
+   }
+}
+
 void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
                 int32_t name_len, int8_t mode)
 {
@@ -991,10 +1752,12 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
          *status = 1;   // STATUS_ERROR
          return;
       }
-      else
+      else {
          // This is to support closing a file implicitly when the
          // design is reset
+         rt_remove_open_file(*fp);
          fclose(*fp);
+      }
    }
 
    char *fname = xmalloc(name_len + 1);
@@ -1015,8 +1778,8 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
       *fp = stdin;
    else if (strcmp(fname, "STD_OUTPUT") == 0)
       *fp = stdout;
-   else
-      *fp = fopen(fname, mode_str[mode]);
+   else if ((*fp = fopen(fname, mode_str[mode])) != NULL)
+      rt_add_open_file(*fp, mode != 0);
 
    if (*fp == NULL) {
       if (status == NULL)
@@ -1073,10 +1836,34 @@ void _file_close(void **_fp)
    if (*fp == NULL)
       fatal("attempt to close already closed file");
 
+   rt_remove_open_file(*fp);
    fclose(*fp);
    *fp = NULL;
 }
 
+void _nvc_textio_read_chunk(void **_fp, uint8_t *chunk, int32_t *used,
+                            int8_t *eol)
+{
+   // The chunk size must match READ_CHUNK_T in the TEXTIO package body
+   const int max = 128;
+
+   FILE *f = *(FILE **)_fp;
+
+   TRACE("_nvc_textio_read_chunk fp=%p", _fp);
+
+   if (f == NULL)
+      fatal("read from closed file");
+
+   int n = 0, c = 0;
+   while (n < max && (c = getc(f)) != EOF && c != '\n') {
+      if (c != '\r')
+         chunk[n++] = c;
+   }
+
+   *used = n;
+   *eol  = (n < max);
+}
+
 int8_t _endfile(void *_f)
 {
    FILE *f = _f;
@@ -1115,6 +1902,8 @@ static void _tracef(const char *fmt, ...)
 
 static void deltaq_insert(event_t *e)
 {
+   e->slot = 0;
+
    if (e->when == now) {
       event_t **chain = (e->kind == E_DRIVER) ? &delta_driver : &delta_proc;
       e->delta_chain = *chain;
@@ -1122,12 +1911,42 @@ static void deltaq_insert(event_t *e)
    }
    else {
       e->delta_chain = NULL;
-      heap_insert(eventq_heap, heap_key(e->when, e->kind), e);
+      eventq_insert(eventq_heap, heap_key(e->when, e->kind), e, &(e->slot));
    }
 }
 
-static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
+static event_t *deltaq_extract(void)
 {
+   event_t *e = eventq_extract_min(eventq_heap);
+   if (e->kind == E_PROCESS && e->proc->timeout == e)
+      e->proc->timeout = NULL;
+   return e;
+}
+
+static void deltaq_cancel(event_t *e)
+{
+   // Remove a superseded event from the queue rather than waiting for
+   // it to be discarded when it reaches the front: events in the delta
+   // chains are not removed as they are about to be consumed anyway
+
+   if (e == NULL || e->slot == 0)
+      return;
+
+   eventq_delete(eventq_heap, e->slot);
+
+   if (e->kind == E_PROCESS && e->proc->timeout == e)
+      e->proc->timeout = NULL;
+
+   rt_free(event_stack, e);
+   n_cancel_events++;
+}
+
+static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
+{
+   // Any earlier timeout for this process must be stale as it has
+   // resumed since it was scheduled
+   deltaq_cancel(wake->timeout);
+
    event_t *e = rt_alloc(event_stack);
    e->when       = now + delta;
    e->kind       = E_PROCESS;
@@ -1135,19 +1954,25 @@ static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
    e->wakeup_gen = wake->wakeup_gen;
 
    deltaq_insert(e);
+
+   if (e->slot != 0)
+      wake->timeout = e;
 }
 
-static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
-                                 rt_proc_t *driver)
+static event_t *deltaq_insert_driver(uint64_t delta, netgroup_t *group,
+                                     int driver)
 {
    event_t *e = rt_alloc(event_stack);
    e->when       = now + delta;
    e->kind       = E_DRIVER;
    e->group      = group;
-   e->proc       = driver;
+   e->proc       = NULL;
+   e->driver     = driver;
+   e->ngroups    = 1;
    e->wakeup_gen = UINT32_MAX;
 
    deltaq_insert(e);
+   return e;
 }
 
 #if TRACE_DELTAQ > 0
@@ -1180,10 +2005,31 @@ static void deltaq_dump(void)
               istr(tree_ident(e->proc->source)),
               (e->wakeup_gen == e->proc->wakeup_gen) ? "" : " (stale)");
 
-   heap_walk(eventq_heap, deltaq_walk, NULL);
+   eventq_walk(eventq_heap, deltaq_walk, NULL);
 }
 #endif
 
+static bool rt_resolution_folds(type_t type)
+{
+   // The standard defines std_logic resolution as a fold of its table
+   // and other functions must have the FOLDABLE attribute set to true
+
+   while (type_is_array(type)
+          && (type_kind(type) != T_SUBTYPE || !type_has_resolution(type)))
+      type = type_elem(type);
+
+   if (type_kind(type) != T_SUBTYPE || !type_has_resolution(type))
+      return false;
+
+   tree_t fdecl = tree_ref(type_resolution(type));
+   if (tree_ident(fdecl) == ident_new("IEEE.STD_LOGIC_1164.RESOLVED"))
+      return true;
+
+   tree_t value = tree_attr_tree(fdecl, ident_new("FOLDABLE"));
+   return value != NULL && tree_kind(value) == T_REF
+      && tree_ident(value) == ident_new("TRUE");
+}
+
 static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
 {
    // Optimise some common resolution functions by memoising them
@@ -1198,6 +2044,7 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
    memo = xmalloc(sizeof(res_memo_t));
    memo->fn    = fn;
    memo->flags = 0;
+   memo->nlits = 0;
 
    hash_put(res_memo_hash, fn, memo);
 
@@ -1244,10 +2091,44 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
       identity = identity && (memo->tab1[i] == i);
    }
 
+   // The two value table can only be folded over any number of drivers
+   // if it is commutative and associative and the function is declared
+   // to resolve its drivers pairwise: calling it with a few values
+   // cannot show it does not depend on the number of drivers
+
+   bool result[16] = {};
+   for (int i = 0; i < nlits; i++) {
+      for (int j = 0; j < nlits; j++)
+         result[memo->tab2[i][j]] = true;
+   }
+
+   bool fold = rt_resolution_folds(type);
+   for (int i = 0; fold && i < nlits; i++) {
+      // Only values the table can produce need to resolve to themselves
+      // as partial results are folded with the next driver: std_logic
+      // resolves '-' with itself to 'X' which is never a result
+      fold = !result[i] || (memo->tab2[i][i] == i);
+
+      for (int j = 0; fold && j < nlits; j++) {
+         fold = (memo->tab2[i][j] == memo->tab2[j][i]);
+
+         for (int k = 0; fold && k < nlits; k++) {
+            const int8_t ij_k = memo->tab2[memo->tab2[i][j]][k];
+            const int8_t i_jk = memo->tab2[i][memo->tab2[j][k]];
+
+            int8_t args[3] = { i, j, k };
+            fold = (ij_k == i_jk) && ((*fn)(args, 3) == ij_k);
+         }
+      }
+   }
+
    if (init_side_effect != SIDE_EFFECT_OCCURRED) {
+      memo->nlits = nlits;
       memo->flags |= R_MEMO;
       if (identity)
          memo->flags |= R_IDENT;
+      if (fold)
+         memo->flags |= R_FOLD;
    }
 
    return memo;
@@ -1268,26 +2149,84 @@ static void rt_global_event(rt_event_t kind)
    }
 }
 
-static value_t *rt_alloc_value(netgroup_t *g)
+static void *rt_state_alloc(size_t sz)
+{
+   // Large arrays of simulation state are optionally backed by huge
+   // pages to reduce TLB misses in very large designs
+
+   if (huge_pages == HUGE_PAGES_NONE)
+      return xmalloc(sz);
+   else
+      return mmap_huge(sz, huge_pages == HUGE_PAGES_EXPLICIT);
+}
+
+static void rt_state_free(void *ptr, size_t sz)
+{
+   if (huge_pages == HUGE_PAGES_NONE)
+      free(ptr);
+   else
+      munmap_huge(ptr, sz);
+}
+
+static void *rt_signal_alloc(signal_chunk_t **chunks, size_t sz)
 {
-   if (g->free_values == NULL) {
-      value_t *v = xmalloc(sizeof(struct value) + (g->size * g->length));
-      v->next = NULL;
-      return v;
+   // Allocate memory for signal values from large chunks so that
+   // signals declared together are adjacent
+
+   sz = (sz + 7) & ~7;
+
+   signal_chunk_t *c = *chunks;
+   if (c == NULL || c->used + sz > c->size) {
+      const size_t chunksz = huge_pages == HUGE_PAGES_NONE
+         ? SIGNAL_CHUNK_SZ : HUGE_CHUNK_SZ - sizeof(signal_chunk_t);
+      const size_t size = MAX(sz, chunksz);
+      c = rt_state_alloc(sizeof(signal_chunk_t) + size);
+      c->next = *chunks;
+      c->used = 0;
+      c->size = size;
+      *chunks = c;
    }
-   else {
-      value_t *v = g->free_values;
-      g->free_values = v->next;
-      v->next = NULL;
-      return v;
+
+   void *ptr = c->data + c->used;
+   c->used += sz;
+   return ptr;
+}
+
+static void *rt_sparse_alloc(size_t sz)
+{
+   sparse_map_t *m = xmalloc(sizeof(sparse_map_t));
+   m->next = sparse_mem;
+   m->size = sz;
+   m->data = mmap_sparse(sz);
+
+   sparse_mem = m;
+   return m->data;
+}
+
+static void rt_sparse_free(void)
+{
+   while (sparse_mem != NULL) {
+      sparse_map_t *next = sparse_mem->next;
+      munmap_sparse(sparse_mem->data, sparse_mem->size);
+      free(sparse_mem);
+      sparse_mem = next;
+   }
+}
+
+static void rt_signal_free(signal_chunk_t *chunks)
+{
+   while (chunks != NULL) {
+      signal_chunk_t *next = chunks->next;
+      rt_state_free(chunks, sizeof(signal_chunk_t) + chunks->size);
+      chunks = next;
    }
 }
 
-static void rt_free_value(netgroup_t *g, value_t *v)
+static value_t *rt_alloc_value(netgroup_t *g)
 {
-   assert(v->next == NULL);
-   v->next = g->free_values;
-   g->free_values = v;
+   value_t *v = xmalloc(sizeof(struct value) + (g->size * g->length));
+   v->next = NULL;
+   return v;
 }
 
 static void *rt_tmp_alloc(size_t sz)
@@ -1300,56 +2239,288 @@ static void *rt_tmp_alloc(size_t sz)
 }
 
 static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
-                           rt_proc_t *proc, bool is_static)
+                           rt_proc_t *proc, bool is_static, uint32_t edge)
 {
-   // See if there is already a stale entry in the pending
-   // list for this process
-   sens_list_t *it = *list;
-   int count = 0;
-   for (; it != NULL; it = it->next, ++count) {
-      if ((it->proc == proc)
-          && (it->wakeup_gen != proc->wakeup_gen))
-         break;
+   sens_list_t *node = NULL;
+
+   if (is_static) {
+      // Static entries are created once at reset and put back on the
+      // same list each time the process resumes
+      node = rt_alloc(sens_list_stack);
+      node->list = NULL;
+   }
+   else {
+      // Each process keeps a table of the entries it has created for
+      // dynamic waits. An entry for this list which is still linked but
+      // belongs to an earlier wait can simply be revalidated, otherwise
+      // reuse any entry that is no longer on a list.
+      sens_list_t *spare = NULL;
+      for (sens_list_t *it = proc->table; it != NULL; it = it->table_next) {
+         if (it->state == SENS_LINKED && it->list == list
+             && it->wakeup_gen != proc->wakeup_gen) {
+            it->wakeup_gen = proc->wakeup_gen;
+            it->first      = first;
+            it->last       = last;
+            it->edge       = edge;
+            return;
+         }
+         else if (it->state == SENS_FREE && spare == NULL)
+            spare = it;
+      }
+
+      if ((node = spare) == NULL) {
+         node = rt_alloc(sens_list_stack);
+         node->table_next = proc->table;
+         proc->table = node;
+      }
+
+      node->list = list;
    }
 
-   if (it == NULL) {
-      sens_list_t *node = rt_alloc(sens_list_stack);
-      node->proc       = proc;
-      node->wakeup_gen = proc->wakeup_gen;
-      node->next       = *list;
-      node->first      = first;
-      node->last       = last;
-      node->reenq      = (is_static ? list : NULL);
+   node->proc       = proc;
+   node->wakeup_gen = proc->wakeup_gen;
+   node->next       = *list;
+   node->first      = first;
+   node->last       = last;
+   node->reenq      = (is_static ? list : NULL);
+   node->edge       = edge;
+   node->state      = SENS_LINKED;
+
+   *list = node;
+}
+
+static void rt_release_sens(sens_list_t *sl)
+{
+   // Entries owned by a process table are kept for its next wait
+   if (sl->list != NULL)
+      sl->state = SENS_FREE;
+   else
+      rt_free(sens_list_stack, sl);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Global pending index
+//
+// Processes sensitive to a sequential range of nets are kept in a treap
+// ordered by the first net and augmented with the maximum last net in
+// each subtree so an event only visits the entries it overlaps. Ties
+// are broken by the address of the entry which also determines its
+// priority.
+
+static inline uint32_t pending_prio(const sens_list_t *sl)
+{
+   uint64_t x = (uintptr_t)sl;
+   x ^= x >> 33;
+   x *= UINT64_C(0xff51afd7ed558ccd);
+   x ^= x >> 33;
+   return x;
+}
+
+static inline bool pending_less(const sens_list_t *a, const sens_list_t *b)
+{
+   return (a->first < b->first)
+      || ((a->first == b->first) && ((uintptr_t)a < (uintptr_t)b));
+}
+
+static inline void pending_update(sens_list_t *t)
+{
+   t->max_last = t->last;
+   if (t->left != NULL && t->left->max_last > t->max_last)
+      t->max_last = t->left->max_last;
+   if (t->right != NULL && t->right->max_last > t->max_last)
+      t->max_last = t->right->max_last;
+}
+
+static void pending_split(sens_list_t *t, const sens_list_t *key,
+                          sens_list_t **l, sens_list_t **r)
+{
+   if (t == NULL)
+      *l = *r = NULL;
+   else if (pending_less(t, key)) {
+      pending_split(t->right, key, &(t->right), r);
+      pending_update(t);
+      *l = t;
+   }
+   else {
+      pending_split(t->left, key, l, &(t->left));
+      pending_update(t);
+      *r = t;
+   }
+}
+
+static sens_list_t *pending_insert(sens_list_t *t, sens_list_t *sl)
+{
+   if (t == NULL || pending_prio(sl) > pending_prio(t)) {
+      // The new entry becomes the root of this subtree
+      pending_split(t, sl, &(sl->left), &(sl->right));
+      pending_update(sl);
+      return sl;
+   }
+   else if (pending_less(sl, t))
+      t->left = pending_insert(t->left, sl);
+   else
+      t->right = pending_insert(t->right, sl);
+
+   pending_update(t);
+   return t;
+}
+
+static sens_list_t *pending_merge(sens_list_t *a, sens_list_t *b)
+{
+   // All entries in a are ordered before those in b
+   if (a == NULL)
+      return b;
+   else if (b == NULL)
+      return a;
+   else if (pending_prio(a) > pending_prio(b)) {
+      a->right = pending_merge(a->right, b);
+      pending_update(a);
+      return a;
+   }
+   else {
+      b->left = pending_merge(a, b->left);
+      pending_update(b);
+      return b;
+   }
+}
+
+static sens_list_t *pending_remove(sens_list_t *t, sens_list_t *sl)
+{
+   assert(t != NULL);
+
+   if (t == sl)
+      return pending_merge(t->left, t->right);
+   else if (pending_less(sl, t))
+      t->left = pending_remove(t->left, sl);
+   else
+      t->right = pending_remove(t->right, sl);
+
+   pending_update(t);
+   return t;
+}
+
+static sens_list_t *pending_find(netid_t x, netid_t y)
+{
+   // Find any entry overlapping the range [x,y]
+   sens_list_t *t = pending;
+   while (t != NULL) {
+      if (t->first <= y && x <= t->last)
+         return t;
+      else if (t->left != NULL && t->left->max_last >= x)
+         t = t->left;
+      else
+         t = t->right;
+   }
+
+   return NULL;
+}
+
+static void pending_unlink_proc(sens_list_t *sl)
+{
+   // Remove a dynamic entry from the list of global entries owned by
+   // its process
+   sens_list_t **p = &(sl->proc->global);
+   while (*p != sl) {
+      assert(*p != NULL);
+      p = &((*p)->next);
+   }
+   *p = sl->next;
+   sl->next = NULL;
+}
+
+static void pending_free(sens_list_t *t)
+{
+   if (t != NULL) {
+      pending_free(t->left);
+      pending_free(t->right);
+      rt_free(sens_list_stack, t);
+   }
+}
+
+static void rt_sched_global_event(netid_t first, netid_t last,
+                                  rt_proc_t *proc, bool is_static)
+{
+   // See if this process has a stale entry in the index that can be
+   // reused
+   sens_list_t *it = NULL;
+   if (!is_static) {
+      for (it = proc->global; it != NULL; it = it->next) {
+         if (it->wakeup_gen != proc->wakeup_gen)
+            break;
+      }
+   }
 
-      *list = node;
+   if (it == NULL) {
+      it = rt_alloc(sens_list_stack);
+      it->proc  = proc;
+      it->reenq = (is_static ? &pending : NULL);
+      it->edge  = 0;
+      it->list  = NULL;
+
+      if (is_static)
+         it->next = NULL;
+      else {
+         it->next = proc->global;
+         proc->global = it;
+      }
    }
+   else
+      pending = pending_remove(pending, it);
+
+   it->wakeup_gen = proc->wakeup_gen;
+   it->first      = first;
+   it->last       = last;
+
+   pending = pending_insert(pending, it);
+}
+
+static void rt_reenq(sens_list_t *sl)
+{
+   // Add a static sensitivity list entry back to its pending list
+   if (sl->reenq == &pending)
+      pending = pending_insert(pending, sl);
    else {
-      // Reuse the stale entry
-      assert(!is_static);
-      it->wakeup_gen = proc->wakeup_gen;
-      it->first      = first;
-      it->last       = last;
+      sl->next = *(sl->reenq);
+      *(sl->reenq) = sl;
    }
 }
 
+static void rt_sched_group_waveform(netgroup_t *g, const void *values,
+                                    int64_t after, int64_t reject,
+                                    event_t **batch)
+{
+   rt_sched_driver(g, after, reject, values, batch);
+}
+
 #if TRACE_PENDING
-static void rt_dump_pending(void)
+static void rt_dump_pending_tree(sens_list_t *t)
 {
-   for (struct sens_list *it = pending; it != NULL; it = it->next) {
-      printf("%d..%d\t%s%s\n", it->first, it->last,
-             istr(tree_ident(it->proc->source)),
-             (it->wakeup_gen == it->proc->wakeup_gen) ? "" : " (stale)");
+   if (t != NULL) {
+      rt_dump_pending_tree(t->left);
+      printf("%d..%d\t%s%s\n", t->first, t->last,
+             istr(tree_ident(t->proc->source)),
+             (t->wakeup_gen == t->proc->wakeup_gen) ? "" : " (stale)");
+      rt_dump_pending_tree(t->right);
    }
 }
+
+static void rt_dump_pending(void)
+{
+   rt_dump_pending_tree(pending);
+}
 #endif  // TRACE_PENDING
 
 static void rt_reset_group(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
    memset(g, '\0', sizeof(netgroup_t));
+   memset(rt_cold(g), '\0', sizeof(netgroup_cold_t));
    g->first       = first;
    g->length      = length;
    g->last_event  = INT64_MAX;
+
+   if (netdb_flags(netdb, gid) & GROUP_F_NO_READERS)
+      g->flags |= NET_F_NO_READERS;
 }
 
 static void rt_free_delta_events(event_t *e)
@@ -1370,26 +2541,38 @@ static void rt_setup(tree_t top)
    can_create_delta = true;
 
    assert(resume == NULL);
+   held = NULL;
 
    rt_free_delta_events(delta_proc);
    rt_free_delta_events(delta_driver);
 
    if (eventq_heap != NULL)
-      heap_free(eventq_heap);
-   eventq_heap = heap_new(512);
+      eventq_free(eventq_heap);
+   eventq_heap = eventq_new();
 
    if (netdb == NULL) {
       netdb = netdb_open(top);
-      groups = xmalloc(sizeof(struct netgroup) * netdb_size(netdb));
+
+      const size_t ngroups = netdb_size(netdb);
+      groups = rt_state_alloc(sizeof(struct netgroup) * ngroups);
+      groups_cold = rt_state_alloc(sizeof(struct netgroup_cold) * ngroups);
+
+      if (n_workers > 0)
+         rt_pool_run(rt_touch_job);
+
+      if (profiling)
+         group_prof = xcalloc(sizeof(group_prof_t) * netdb_size(netdb));
    }
 
    if (procs == NULL) {
       n_procs = tree_stmts(top);
-      procs   = xmalloc(sizeof(struct rt_proc) * n_procs);
+      procs   = xcalloc(sizeof(struct rt_proc) * n_procs);
    }
 
    res_memo_hash = hash_new(128, true);
 
+   rt_free_implicits();
+   rt_free_clocks();
    netdb_walk(netdb, rt_reset_group);
 
    const int nstmts = tree_stmts(top);
@@ -1400,13 +2583,52 @@ static void rt_setup(tree_t top)
       procs[i].source     = p;
       procs[i].proc_fn    = jit_fun_ptr(istr(tree_ident(p)), true);
       procs[i].wakeup_gen = 0;
+      procs[i].timeout    = NULL;
+      procs[i].global     = NULL;
+      procs[i].table      = NULL;
       procs[i].postponed  = !!(tree_flags(p) & TREE_F_POSTPONED);
+      procs[i].serial     = !!tree_attr_int(p, serial_i, 0);
       procs[i].tmp_stack  = NULL;
       procs[i].tmp_alloc  = 0;
+      procs[i].level      = -1;
       procs[i].pending    = false;
+      procs[i].prof_runs  = 0;
+      procs[i].prof_ns    = 0;
+   }
+}
+
+static inline uint64_t rt_prof_clock(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+static inline bool rt_detailed_stats(void)
+{
+   return stats_level >= STATS_DETAIL;
+}
+
+static void rt_phase(rt_phase_t phase)
+{
+   // Charge the time since the last phase change to the current phase
+   if (unlikely(rt_detailed_stats()) && phase != cur_phase) {
+      const uint64_t clock = rt_prof_clock();
+      phase_ns[cur_phase] += clock - phase_start;
+      phase_start = clock;
+      cur_phase = phase;
    }
 }
 
+static void rt_hist_add(histogram_t *h, uint64_t value)
+{
+   const int bucket = (value == 0) ? 0 : 64 - __builtin_clzll(value);
+   h->buckets[MIN(bucket, HIST_BUCKETS - 1)]++;
+   h->count++;
+   h->sum += value;
+   h->max = MAX(h->max, value);
+}
+
 static void rt_run(struct rt_proc *proc, bool reset)
 {
    TRACE("%s process %s", reset ? "reset" : "run",
@@ -1431,10 +2653,38 @@ static void rt_run(struct rt_proc *proc, bool reset)
    }
 
    active_proc = proc;
-   (*proc->proc_fn)(reset ? 1 : 0);
+
+   if (unlikely(profiling)) {
+      const uint64_t start = rt_prof_clock();
+      (*proc->proc_fn)(reset ? 1 : 0);
+      proc->prof_ns += rt_prof_clock() - start;
+      proc->prof_runs++;
+   }
+   else {
+      (*proc->proc_fn)(reset ? 1 : 0);
+
+      if (unlikely(pgo_collect != NULL))
+         proc->prof_runs++;
+   }
 
    if (reset)
       global_tmp_alloc = _tmp_alloc;
+   else if (proc->tmp_stack != NULL && proc->tmp_alloc == 0
+            && proc->tmp_stack != global_tmp_stack) {
+      // The procedure which suspended has now returned so the private
+      // stack can be given to the next process that needs one
+      TRACE("release private stack at %p", proc->tmp_stack);
+
+      if (parallel)
+         pthread_mutex_lock(&serial_lock);
+
+      rt_tmp_stack_put(proc->tmp_stack);
+
+      if (parallel)
+         pthread_mutex_unlock(&serial_lock);
+
+      proc->tmp_stack = NULL;
+   }
 }
 
 static void rt_call_module_reset(ident_t name)
@@ -1461,7 +2711,7 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
 
    void *resolved = NULL;
    if (unlikely(group->flags & NET_F_FORCED)) {
-      resolved = group->forcing->data;
+      resolved = rt_cold(group)->forcing->data;
    }
    else if (group->resolution == NULL) {
       resolved = values;
@@ -1474,41 +2724,58 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
       // Resolution function has been memoised so do a table lookup
 
       resolved = alloca(valuesz);
-
-      for (int j = 0; j < group->length; j++) {
-         const int index = { ((const char *)values)[j] };
-         const int8_t r = group->resolution->tab1[index];
-         ((int8_t *)resolved)[j] = r;
-      }
+      restab_map(group->resolution->tab1, resolved, values, group->length);
    }
    else if ((group->resolution->flags & R_MEMO) && (group->n_drivers == 2)) {
       // Resolution function has been memoised so do a table lookup
 
       resolved = alloca(valuesz);
 
-      const char *p0 = group->drivers[0].waveforms->values->data;
-      const char *p1 = group->drivers[1].waveforms->values->data;
+      const void *p0 = rt_driver_value(group, &(group->drivers[0]), 0);
+      const void *p1 = rt_driver_value(group, &(group->drivers[1]), 0);
 
-      for (int j = 0; j < group->length; j++) {
-         int driving[2] = { p0[j], p1[j] };
-         if (likely(driver >= 0))
-            driving[driver] = ((const char *)values)[j];
+      if (likely(driver == 0))
+         p0 = values;
+      else if (likely(driver == 1))
+         p1 = values;
+
+      restab_fold(group->resolution->tab2, group->resolution->nlits,
+                  resolved, p0, p1, group->length);
+   }
+   else if (group->resolution->flags & R_FOLD) {
+      // Resolution function is associative so fold the memoised table
+      // over each driver in turn
 
-         const int8_t r = group->resolution->tab2[driving[0]][driving[1]];
-         ((int8_t *)resolved)[j] = r;
+      resolved = alloca(valuesz);
+
+      n_resolution_folds++;
+
+      const res_memo_t *memo = group->resolution;
+      for (int i = 0; i < group->n_drivers; i++) {
+         const void *p = (i == driver)
+            ? values : rt_driver_value(group, &(group->drivers[i]), 0);
+
+         if (i == 0)
+            memcpy(resolved, p, valuesz);
+         else
+            restab_fold(memo->tab2, memo->nlits, resolved, resolved, p,
+                        group->length);
       }
-  }
+   }
    else {
       // Must actually call resolution function in general case
 
+      n_resolution_calls++;
+
       resolved = alloca(valuesz);
 
       for (int j = 0; j < group->length; j++) {
 #define CALL_RESOLUTION_FN(type) do {                                   \
             type vals[group->n_drivers];                                \
             for (int i = 0; i < group->n_drivers; i++) {                \
-               const value_t *v = group->drivers[i].waveforms->values;  \
-               vals[i] = ((const type *)v->data)[j];                    \
+               const void *v =                                          \
+                  rt_driver_value(group, &(group->drivers[i]), 0);      \
+               vals[i] = ((const type *)v)[j];                          \
             }                                                           \
             if (likely(driver >= 0))                                    \
                vals[driver] = ((const type *)values)[j];                \
@@ -1520,6 +2787,20 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
       }
    }
 
+   if (group->flags & NET_F_NO_READERS) {
+      // Nothing can currently observe an event on this group so skip
+      // scheduling but keep 'last_event and 'last_value up to date in
+      // case a reader appears later
+      if (memcmp(group->resolved, resolved, valuesz) != 0) {
+         if (group->flags & NET_F_LAST_VALUE)
+            memcpy(rt_cold(group)->last_value, group->resolved, valuesz);
+         memcpy(group->resolved, resolved, valuesz);
+
+         group->last_event = now;
+      }
+      return 0;
+   }
+
    int32_t new_flags = NET_F_ACTIVE;
    if (memcmp(group->resolved, resolved, valuesz) != 0)
       new_flags |= NET_F_EVENT;
@@ -1529,7 +2810,7 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
    // only update it when there is an event
    if (new_flags & NET_F_EVENT) {
       if (group->flags & NET_F_LAST_VALUE)
-         memcpy(group->last_value, group->resolved, valuesz);
+         memcpy(rt_cold(group)->last_value, group->resolved, valuesz);
       memcpy(group->resolved, resolved, valuesz);
 
       group->last_event = now;
@@ -1542,83 +2823,541 @@ static void rt_group_inital(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
    if ((g->n_drivers == 1) && (g->resolution == NULL))
-      rt_resolve_group(g, -1, g->drivers[0].waveforms->values->data);
+      rt_resolve_group(g, -1, rt_driver_value(g, &(g->drivers[0]), 0));
    else if (g->n_drivers > 0)
       rt_resolve_group(g, -1, g->resolved);
 }
 
-static void rt_initial(tree_t top)
-{
-   // Initialisation is described in LRM 93 section 12.6.4
+typedef struct {
+   groupid_t group;
+   uint32_t  proc;
+} group_reader_t;
 
-   const int ncontext = tree_contexts(top);
-   for (int i = 0; i < ncontext; i++) {
-      tree_t c = tree_context(top, i);
-      ident_t unit_name = tree_ident(c);
-      rt_call_module_reset(unit_name);
+typedef struct {
+   group_reader_t *items;
+   size_t          count;
+   size_t          max;
+} reader_vec_t;
 
-      ident_t body = ident_prefix(unit_name, ident_new("body"), '-');
-      rt_call_module_reset(body);
+static void rt_add_reader(reader_vec_t *v, groupid_t gid, rt_proc_t *proc)
+{
+   if (v->count == v->max) {
+      v->max = MAX(v->max * 2, 64);
+      v->items = xrealloc(v->items, v->max * sizeof(group_reader_t));
    }
 
-   rt_call_module_reset(tree_ident(top));
+   v->items[v->count].group = gid;
+   v->items[v->count].proc  = proc - procs;
+   v->count++;
+}
 
-   for (size_t i = 0; i < n_procs; i++)
-      rt_run(&procs[i], true /* reset */);
+static void rt_global_readers(sens_list_t *t, reader_vec_t *v)
+{
+   // Collect the groups covered by static entries in the global index
+   if (t == NULL)
+      return;
 
-   TRACE("calculate initial driver values");
+   rt_global_readers(t->left, v);
+   rt_global_readers(t->right, v);
 
-   init_side_effect = SIDE_EFFECT_ALLOW;
-   netdb_walk(netdb, rt_group_inital);
+   if (t->reenq == NULL || t->proc->level < 0)
+      return;
 
-   TRACE("used %d bytes of global temporary stack", global_tmp_alloc);
+   netid_t nid = t->first;
+   while (nid <= t->last) {
+      const groupid_t gid = netdb_lookup(netdb, nid);
+      rt_add_reader(v, gid, t->proc);
+      nid = groups[gid].first + groups[gid].length;
+   }
 }
 
-static void rt_watch_signal(watch_t *w)
+static int rt_reader_cmp(const void *a, const void *b)
 {
-   const int nnets = tree_nets(w->signal);
-   int offset = 0;
-   while (offset < nnets) {
-      netid_t nid = tree_net(w->signal, offset);
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+   const group_reader_t *ra = a, *rb = b;
+   return (ra->group > rb->group) - (ra->group < rb->group);
+}
 
-      watch_list_t *link = xmalloc(sizeof(watch_list_t));
-      link->next  = g->watching;
-      link->watch = w;
+static void rt_levelise(void)
+{
+   // Order the combinational processes topologically so each can be
+   // held back until every combinational process that drives one of
+   // its inputs has run. Processes on a combinational loop, and any
+   // process downstream of a loop, are left unlevelised and are always
+   // scheduled by events as normal.
+
+   for (size_t i = 0; i < n_procs; i++) {
+      if (tree_attr_int(procs[i].source, comb_i, 0))
+         procs[i].level = 0;
+   }
 
-      g->watching = link;
+   reader_vec_t readers = { NULL, 0, 0 };
 
-      offset += g->length;
-      (w->n_groups)++;
+   const int ngroups = netdb_size(netdb);
+   for (int i = 0; i < ngroups; i++) {
+      for (sens_list_t *it = groups[i].pending; it != NULL; it = it->next) {
+         if (it->reenq != NULL && it->proc->level >= 0)
+            rt_add_reader(&readers, i, it->proc);
+      }
    }
 
-   w->groups = xmalloc(sizeof(netgroup_t *) * w->n_groups);
+   rt_global_readers(pending, &readers);
 
-   int ptr = 0;
-   offset = 0;
-   while (offset < nnets) {
-      netid_t nid = tree_net(w->signal, offset);
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
-      w->groups[ptr++] = g;
-      w->length += g->length;
-      offset += g->length;
-   }
-}
+   qsort(readers.items, readers.count, sizeof(group_reader_t),
+         rt_reader_cmp);
 
-static void rt_wakeup(sens_list_t *sl)
-{
-   // To avoid having each process keep a list of the signals it is
-   // sensitive to, each process has a "wakeup generation" number which
-   // is incremented after each wait statement and stored in the signal
-   // sensitivity list. We then ignore any sensitivity list elements
-   // where the generation doesn't match the current process wakeup
-   // generation: these correspond to stale "wait on" statements that
-   // have already resumed.
+   // Count the edges from each combinational writer to the readers of
+   // the groups it drives on the first pass and fill in the compressed
+   // adjacency lists on the second
+   uint32_t *indegree = xcalloc(n_procs * sizeof(uint32_t));
+   uint32_t *start    = xcalloc((n_procs + 1) * sizeof(uint32_t));
+   uint32_t *cursor   = NULL;
+   uint32_t *adj      = NULL;
 
-   if (sl->wakeup_gen == sl->proc->wakeup_gen || sl->reenq != NULL) {
-      TRACE("wakeup process %s%s", istr(tree_ident(sl->proc->source)),
-            sl->proc->postponed ? " [postponed]" : "");
-      ++(sl->proc->wakeup_gen);
+   for (int pass = 0; pass < 2; pass++) {
+      if (pass == 1) {
+         for (size_t i = 0; i < n_procs; i++)
+            start[i + 1] += start[i];
+
+         adj    = xmalloc(MAX(start[n_procs], 1) * sizeof(uint32_t));
+         cursor = xmalloc(n_procs * sizeof(uint32_t));
+         memcpy(cursor, start, n_procs * sizeof(uint32_t));
+      }
+
+      for (size_t r = 0; r < readers.count; ) {
+         const groupid_t gid = readers.items[r].group;
+         size_t end = r + 1;
+         while (end < readers.count && readers.items[end].group == gid)
+            end++;
+
+         netgroup_t *g = &(groups[gid]);
+         for (int d = 0; d < g->n_drivers; d++) {
+            const uint32_t w = g->drivers[d].proc - procs;
+            if (procs[w].level < 0)
+               continue;
+
+            for (size_t j = r; j < end; j++) {
+               if (pass == 0) {
+                  start[w + 1]++;
+                  indegree[readers.items[j].proc]++;
+               }
+               else
+                  adj[cursor[w]++] = readers.items[j].proc;
+            }
+         }
+
+         r = end;
+      }
+   }
+
+   free(readers.items);
+   free(cursor);
+
+   // Kahn's algorithm assigning each process the length of the longest
+   // chain of combinational processes leading to it
+   uint32_t *queue = xmalloc(MAX(n_procs, 1) * sizeof(uint32_t));
+   size_t qhead = 0, qtail = 0;
+   for (size_t i = 0; i < n_procs; i++) {
+      if (procs[i].level == 0 && indegree[i] == 0)
+         queue[qtail++] = i;
+   }
+
+   int max_level = -1;
+   while (qhead < qtail) {
+      const uint32_t p = queue[qhead++];
+      max_level = MAX(max_level, procs[p].level);
+
+      for (uint32_t e = start[p]; e < start[p + 1]; e++) {
+         const uint32_t q = adj[e];
+         procs[q].level = MAX(procs[q].level, procs[p].level + 1);
+         if (--indegree[q] == 0)
+            queue[qtail++] = q;
+      }
+   }
+
+   for (size_t i = 0; i < n_procs; i++) {
+      if (indegree[i] > 0)
+         procs[i].level = -1;
+   }
+
+   TRACE("levelised %zu combinational processes into %d levels",
+         qtail, max_level + 1);
+
+   free(queue);
+   free(adj);
+   free(start);
+   free(indegree);
+}
+
+static bool rt_implicit_init(rt_proc_t *proc)
+{
+   // Replace the process created for an implicit signal attribute with
+   // a driver updated directly by the kernel when the prefix changes
+
+   tree_t p = proc->source;
+   const int kind = tree_attr_int(p, implicit_i, -1);
+   if (kind == -1 || tree_stmts(p) != 2)
+      return false;
+
+   tree_t assign = tree_stmt(p, 0);
+   tree_t wait = tree_stmt(p, 1);
+
+   if (tree_kind(assign) != T_SIGNAL_ASSIGN || tree_triggers(wait) != 1)
+      return false;
+
+   tree_t trigger = tree_trigger(wait, 0);
+   if (tree_kind(trigger) != T_REF)
+      return false;   // Prefix was replaced by a constant
+
+   uint64_t delay = 0;
+   tree_t wave = tree_waveform(assign, tree_waveforms(assign) - 1);
+   if (tree_has_delay(wave)) {
+      tree_t d = tree_delay(wave);
+      if (tree_kind(d) != T_LITERAL || tree_subkind(d) != L_INT)
+         return false;
+      delay = tree_ival(d);
+   }
+
+   tree_t prefix = tree_ref(trigger);
+   tree_t target = tree_ref(tree_target(assign));
+
+   const int nprefix = tree_nets(prefix);
+   const int ntarget = tree_nets(target);
+
+   int ngroups = 0;
+   for (int offset = 0; offset < nprefix; ngroups++) {
+      netgroup_t *g = &(groups[netdb_lookup(netdb, tree_net(prefix, offset))]);
+
+      if (kind == ATTR_DELAYED) {
+         // Each transaction on the prefix is copied to the same nets
+         // of the delayed signal so the groups must line up
+         const netid_t nid = tree_net(target, offset);
+         netgroup_t *tg = &(groups[netdb_lookup(netdb, nid)]);
+         if (tg->first != nid || tg->length != g->length)
+            return false;
+      }
+
+      offset += g->length;
+   }
+
+   if (kind == ATTR_DELAYED && nprefix != ntarget)
+      return false;
+
+   implicit_t *imp = xcalloc(sizeof(implicit_t));
+   imp->kind     = kind;
+   imp->delay    = delay;
+   imp->proc     = proc;
+   imp->n_prefix = ngroups;
+   imp->prefix   = xmalloc(sizeof(netgroup_t *) * ngroups);
+   imp->target   = xmalloc(sizeof(netgroup_t *) * ngroups);
+   imp->links    = xmalloc(sizeof(implicit_list_t) * ngroups);
+   imp->next     = implicits;
+
+   implicits = imp;
+
+   int ptr = 0;
+   for (int offset = 0; offset < nprefix; ptr++) {
+      netgroup_t *g = &(groups[netdb_lookup(netdb, tree_net(prefix, offset))]);
+      const netid_t tnid =
+         tree_net(target, (kind == ATTR_DELAYED) ? offset : 0);
+
+      imp->prefix[ptr] = g;
+      imp->target[ptr] = &(groups[netdb_lookup(netdb, tnid)]);
+
+      implicit_list_t *link = &(imp->links[ptr]);
+      link->implicit = imp;
+      link->next     = rt_cold(g)->implicit;
+
+      rt_cold(g)->implicit = link;
+      rt_observe(g);
+      g->flags |= NET_F_IMPLICIT;
+
+      offset += g->length;
+   }
+
+   int32_t *nets = xmalloc(sizeof(int32_t) * ntarget);
+   for (int i = 0; i < ntarget; i++)
+      nets[i] = tree_net(target, i);
+
+   // The initial value of the driver is the default value of the
+   // implicit signal set when the design unit was reset
+   active_proc = proc;
+   _alloc_driver(nets, ntarget, nets, ntarget, NULL);
+
+   free(nets);
+
+   TRACE("process %s replaced by implicit signal", istr(tree_ident(p)));
+   return true;
+}
+
+static void rt_free_implicits(void)
+{
+   while (implicits != NULL) {
+      implicit_t *next = implicits->next;
+      free(implicits->prefix);
+      free(implicits->target);
+      free(implicits->links);
+      free(implicits);
+      implicits = next;
+   }
+
+   implicit_pending = NULL;
+}
+
+static bool rt_clock_init(rt_proc_t *proc)
+{
+   // Recognise the process for a concurrent assignment such as
+   // "clk <= not clk after T" which only wakes up because of its own
+   // transactions: the kernel can toggle the signal with a timeout
+   // instead of scheduling a transaction and running the process
+
+   tree_t p = proc->source;
+   if (tree_stmts(p) != 2 || tree_decls(p) > 0 || proc->postponed)
+      return false;
+
+   tree_t assign = tree_stmt(p, 0);
+   tree_t wait = tree_stmt(p, 1);
+
+   if (tree_kind(assign) != T_SIGNAL_ASSIGN || tree_kind(wait) != T_WAIT)
+      return false;
+   else if (tree_waveforms(assign) != 1 || tree_has_reject(assign))
+      return false;
+   else if (tree_triggers(wait) != 1 || tree_has_delay(wait)
+            || tree_has_value(wait))
+      return false;
+
+   tree_t target = tree_target(assign);
+   tree_t trigger = tree_trigger(wait, 0);
+   if (tree_kind(target) != T_REF || tree_kind(trigger) != T_REF)
+      return false;
+
+   tree_t decl = tree_ref(target);
+   if (tree_kind(decl) != T_SIGNAL_DECL || tree_ref(trigger) != decl
+       || tree_nets(decl) != 1)
+      return false;
+
+   tree_t wave = tree_waveform(assign, 0);
+   if (!tree_has_delay(wave))
+      return false;
+
+   tree_t delay = tree_delay(wave);
+   if (tree_kind(delay) != T_LITERAL || tree_subkind(delay) != L_INT
+       || tree_ival(delay) <= 0)
+      return false;
+
+   tree_t value = tree_value(wave);
+   if (tree_kind(value) != T_FCALL || tree_params(value) != 1)
+      return false;
+
+   tree_t arg = tree_value(tree_param(value, 0));
+   if (tree_kind(arg) != T_REF || tree_ref(arg) != decl)
+      return false;
+
+   tree_t fdecl = tree_ref(value);
+   ident_t builtin = tree_attr_str(fdecl, builtin_i);
+
+   bool logic;
+   if (builtin != NULL && icmp(builtin, "not"))
+      logic = false;
+   else if (icmp(tree_ident(fdecl), "IEEE.STD_LOGIC_1164.\"not\"")
+            && type_ident(type_base_recur(tree_type(decl))) == std_ulogic_i)
+      logic = true;
+   else
+      return false;
+
+   const int32_t nid = tree_net(decl, 0);
+   netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+   if (g->size != 1)
+      return false;
+
+   rt_clock_t *c = xmalloc(sizeof(rt_clock_t));
+   c->proc  = proc;
+   c->group = g;
+   c->delay = tree_ival(delay);
+   c->logic = logic;
+   c->next  = clocks;
+
+   clocks = c;
+
+   active_proc = proc;
+   _alloc_driver(&nid, 1, &nid, 1, NULL);
+
+   return true;
+}
+
+static void rt_clock_tick(uint64_t when, void *user)
+{
+   rt_clock_t *c = user;
+   netgroup_t *g = c->group;
+
+   const uint8_t old = *(uint8_t *)g->resolved;
+
+   uint8_t *current = rt_driver_value(g, &(g->drivers[0]), 0);
+   *current = c->logic ? logic_not_table[old] : !old;
+
+   rt_update_group(g, 0, current);
+   n_clock_ticks++;
+
+   // The process would only run again after an event
+   if (*(uint8_t *)g->resolved != old)
+      rt_set_timeout_cb(c->delay, rt_clock_tick, c);
+}
+
+static void rt_clock_start(void)
+{
+   for (rt_clock_t *c = clocks; c != NULL; c = c->next) {
+      if (c->group->n_drivers == 1)
+         rt_set_timeout_cb(c->delay, rt_clock_tick, c);
+      else {
+         // Other processes also drive the signal so the value of the
+         // next transaction depends on the resolved value
+         TRACE("clock %s has %d drivers", fmt_group(c->group),
+               c->group->n_drivers);
+         rt_run(c->proc, true /* reset */);
+      }
+   }
+}
+
+static void rt_free_clocks(void)
+{
+   while (clocks != NULL) {
+      rt_clock_t *next = clocks->next;
+      free(clocks);
+      clocks = next;
+   }
+}
+
+static void rt_activity_init(void)
+{
+   // Only bits of the standard logic types are counted as the other
+   // values have no meaningful switching activity
+
+   static const uint8_t bit_map[2] = { ACT_ZERO, ACT_ONE };
+   static const uint8_t logic_map[9] = {
+      ACT_X, ACT_X, ACT_ZERO, ACT_ONE, ACT_X, ACT_X, ACT_ZERO, ACT_ONE, ACT_X
+   };
+
+   const size_t ngroups = netdb_size(netdb);
+   if (group_act == NULL)
+      group_act = xcalloc(sizeof(group_act_t *) * ngroups);
+
+   for (size_t i = 0; i < ngroups; i++) {
+      netgroup_t *g = &(groups[i]);
+      tree_t decl = rt_cold(g)->sig_decl;
+
+      free(group_act[i]);
+      group_act[i] = NULL;
+
+      if (decl == NULL || g->size != 1)
+         continue;
+
+      type_t type = tree_type(decl);
+      while (type_is_array(type))
+         type = type_elem(type);
+
+      ident_t name = type_ident(type_base_recur(type));
+
+      const uint8_t *map = NULL;
+      if (name == std_ulogic_i)
+         map = logic_map;
+      else if (name == std_bit_i || name == std_bool_i)
+         map = bit_map;
+      else
+         continue;
+
+      group_act_t *act =
+         xcalloc(sizeof(group_act_t) + g->length * sizeof(act_elem_t));
+      act->map = map;
+
+      group_act[i] = act;
+      rt_observe(g);
+   }
+}
+
+static void rt_initial(tree_t top)
+{
+   // Initialisation is described in LRM 93 section 12.6.4
+
+   const int ncontext = tree_contexts(top);
+   for (int i = 0; i < ncontext; i++) {
+      tree_t c = tree_context(top, i);
+      ident_t unit_name = tree_ident(c);
+      rt_call_module_reset(unit_name);
+
+      ident_t body = ident_prefix(unit_name, ident_new("body"), '-');
+      rt_call_module_reset(body);
+   }
+
+   rt_call_module_reset(tree_ident(top));
+
+   for (size_t i = 0; i < n_procs; i++) {
+      if (!rt_implicit_init(&procs[i]) && !rt_clock_init(&procs[i]))
+         rt_run(&procs[i], true /* reset */);
+   }
+
+   rt_clock_start();
+
+   TRACE("calculate initial driver values");
+
+   init_side_effect = SIDE_EFFECT_ALLOW;
+   netdb_walk(netdb, rt_group_inital);
+
+   if (cycle_based)
+      rt_levelise();
+
+   if (activity_file != NULL)
+      rt_activity_init();
+
+   TRACE("used %d bytes of global temporary stack", global_tmp_alloc);
+}
+
+static void rt_watch_signal(watch_t *w)
+{
+   const int nnets = tree_nets(w->signal);
+   int offset = 0;
+   while (offset < nnets) {
+      netid_t nid = tree_net(w->signal, offset);
+      netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+
+      watch_list_t *link = xmalloc(sizeof(watch_list_t));
+      link->next  = rt_cold(g)->watching;
+      link->watch = w;
+
+      rt_cold(g)->watching = link;
+      rt_observe(g);
+
+      offset += g->length;
+      (w->n_groups)++;
+   }
+
+   w->groups = xmalloc(sizeof(netgroup_t *) * w->n_groups);
+
+   int ptr = 0;
+   offset = 0;
+   while (offset < nnets) {
+      netid_t nid = tree_net(w->signal, offset);
+      netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+      w->groups[ptr++] = g;
+      w->length += g->length;
+      offset += g->length;
+   }
+}
+
+static void rt_wakeup(sens_list_t *sl)
+{
+   // To avoid having each process keep a list of the signals it is
+   // sensitive to, each process has a "wakeup generation" number which
+   // is incremented after each wait statement and stored in the signal
+   // sensitivity list. We then ignore any sensitivity list elements
+   // where the generation doesn't match the current process wakeup
+   // generation: these correspond to stale "wait on" statements that
+   // have already resumed.
+
+   if (sl->wakeup_gen == sl->proc->wakeup_gen || sl->reenq != NULL) {
+      TRACE("wakeup process %s%s", istr(tree_ident(sl->proc->source)),
+            sl->proc->postponed ? " [postponed]" : "");
+      ++(sl->proc->wakeup_gen);
+
+      deltaq_cancel(sl->proc->timeout);
 
       if (unlikely(sl->proc->postponed)) {
          sl->next  = postponed;
@@ -1630,13 +3369,32 @@ static void rt_wakeup(sens_list_t *sl)
       }
 
       sl->proc->pending = true;
+      sl->state = SENS_QUEUED;
    }
    else
-      rt_free(sens_list_stack, sl);
+      rt_release_sens(sl);
 }
 
-static bool rt_sched_driver(netgroup_t *group, uint64_t after,
-                            uint64_t reject, value_t *values)
+static event_t *rt_batch_driver(netgroup_t *group, int driver,
+                                event_t **batch)
+{
+   // Extend the driver event for the previous group if this group
+   // follows it otherwise start a new batch with this group
+
+   event_t *e = *batch;
+   if (e != NULL && group == e->group + e->ngroups) {
+      e->ngroups++;
+      e->proc = active_proc;
+      n_batched_events++;
+      return e;
+   }
+
+   return (*batch = deltaq_insert_driver(0, group, driver));
+}
+
+static void rt_sched_driver(netgroup_t *group, uint64_t after,
+                            uint64_t reject, const void *values,
+                            event_t **batch)
 {
    if (unlikely(reject > after))
       fatal("signal %s pulse reject limit %s is greater than "
@@ -1644,63 +3402,117 @@ static bool rt_sched_driver(netgroup_t *group, uint64_t after,
 
    int driver = 0;
    if (unlikely(group->n_drivers != 1)) {
-      // Try to find this process in the list of existing drivers
-      for (driver = 0; driver < group->n_drivers; driver++) {
-         if (likely(group->drivers[driver].proc == active_proc))
-            break;
-      }
-
-      assert(driver != group->n_drivers);
+      driver = rt_find_driver(group, active_proc);
+      assert(driver != -1);
    }
 
    driver_t *d = &(group->drivers[driver]);
 
    const size_t valuesz = group->size * group->length;
+   const uint64_t when = now + after;
+
+   // Small values are held in the transaction header and compared as
+   // integers to avoid calls to memcmp and memcpy
+   const bool small = rt_inline_value(valuesz);
+   const uint64_t word = small ? rt_value_word(values, valuesz) : 0;
+
+   // Transactions are kept in time order after the current driving
+   // value so deleting them compacts the ring in place
+   uint32_t keep = 1, it = 1;
+   for (; it < d->count; it++) {
+      waveform_t *w = &(d->waveforms[rt_driver_slot(d, it)]);
+      if (w->when >= when)
+         break;
 
-   waveform_t *w = rt_alloc(waveform_stack);
-   w->when   = now + after;
-   w->next   = NULL;
-   w->values = values;
-
-   waveform_t *last = d->waveforms;
-   waveform_t *it   = last->next;
-   while ((it != NULL) && (it->when < w->when)) {
       // If the current transaction is within the pulse rejection interval
       // and the value is different to that of the new transaction then
       // delete the current transaction
-      if ((it->when >= w->when - reject)
-          && (memcmp(it->values->data, w->values->data, valuesz) != 0)) {
-         waveform_t *next = it->next;
-         last->next = next;
-         rt_free_value(group, it->values);
-         rt_free(waveform_stack, it);
-         it = next;
-      }
+      const void *wvalue = small ? NULL : rt_driver_value(group, d, it);
+      const bool differs = small
+         ? (w->word != word) : (memcmp(wvalue, values, valuesz) != 0);
+
+      if ((w->when >= when - reject) && differs)
+         deltaq_cancel(w->event);
       else {
-         last = it;
-         it = it->next;
+         if (keep != it) {
+            d->waveforms[rt_driver_slot(d, keep)] = *w;
+            if (!small)
+               memcpy(rt_driver_value(group, d, keep), wvalue, valuesz);
+         }
+         keep++;
       }
    }
-   w->next = NULL;
-   last->next = w;
 
-   // Delete all transactions later than this
-   // We could remove this transaction from the deltaq as well but the
-   // overhead of doing so is probably higher than the cost of waking
-   // up for the empty event
-   bool already_scheduled = false;
-   while (it != NULL) {
-      rt_free_value(group, it->values);
+   // Delete all transactions later than this and remove their events
+   // from the queue unless one can be reused for the new transaction
+   event_t *event = NULL;
+   for (; it < d->count; it++) {
+      waveform_t *w = &(d->waveforms[rt_driver_slot(d, it)]);
+      if (w->when == when)
+         event = w->event;
+      else
+         deltaq_cancel(w->event);
+   }
 
-      if (it->when == w->when)
-         already_scheduled = true;
+   d->count = keep;
 
-      waveform_t *next = it->next;
-      rt_free(waveform_stack, it);
-      it = next;
+   if (unlikely(d->count == d->size))
+      rt_alloc_driver_ring(group, d, d->size * 2);
+
+   waveform_t *w = &(d->waveforms[rt_driver_slot(d, d->count)]);
+   w->when  = when;
+   if (event != NULL)
+      w->event = event;
+   else if (batch != NULL)
+      w->event = rt_batch_driver(group, driver, batch);
+   else
+      w->event = deltaq_insert_driver(after, group, driver);
+
+   if (small)
+      w->word = word;
+   else
+      memcpy(rt_driver_value(group, d, d->count), values, valuesz);
+
+   d->count++;
+}
+
+static void rt_implicit_notify(netgroup_t *group, int32_t new_flags)
+{
+   // Implicit signals are updated once per cycle after all the
+   // explicit signals as described in LRM 93 section 12.6.2
+
+   for (implicit_list_t *it = rt_cold(group)->implicit;
+        it != NULL; it = it->next) {
+      implicit_t *imp = it->implicit;
+      if (imp->pending)
+         continue;
+      else if (!(new_flags & NET_F_EVENT)
+               && (imp->kind == ATTR_DELAYED || imp->kind == ATTR_STABLE))
+         continue;
+
+      imp->pending = true;
+      imp->chain_pending = implicit_pending;
+      implicit_pending = imp;
    }
+}
 
-   return already_scheduled;
+static void rt_activity_event(netgroup_t *group, group_act_t *act,
+                              const uint8_t *old)
+{
+   const uint8_t *new = group->resolved;
+   for (int i = 0; i < group->length; i++) {
+      if (old[i] == new[i])
+         continue;
+
+      act_elem_t *e = &(act->elems[i]);
+      const act_state_t from = act->map[old[i]], to = act->map[new[i]];
+
+      e->time[from] += now - e->last_change;
+      e->last_change = now;
+
+      if (from != to && from != ACT_X && to != ACT_X)
+         e->toggles++;
+   }
 }
 
 static void rt_update_group(netgroup_t *group, int driver, void *values)
@@ -1710,9 +3522,37 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
    TRACE("update group %s values=%s driver=%d",
          fmt_group(group), fmt_values(values, valuesz), driver);
 
+   group_act_t *act = NULL;
+   uint8_t *old = NULL;
+   if (unlikely(group_act != NULL) && (act = group_act[group - groups])) {
+      old = alloca(valuesz);
+      memcpy(old, group->resolved, valuesz);
+   }
+
    const int32_t new_flags = rt_resolve_group(group, driver, values);
+
+   if (unlikely(act != NULL) && (new_flags & NET_F_EVENT))
+      rt_activity_event(group, act, old);
+
+   n_transactions++;
+   if (new_flags & NET_F_EVENT)
+      n_signal_events++;
+
+   if (unlikely(group_prof != NULL)) {
+      group_prof_t *gp = &(group_prof[group - groups]);
+      gp->transactions++;
+      if (new_flags & NET_F_EVENT)
+         gp->events++;
+   }
+
+   if (new_flags == 0)
+      return;
+
    group->flags |= new_flags;
 
+   if (unlikely(group->flags & NET_F_IMPLICIT))
+      rt_implicit_notify(group, new_flags);
+
    if (unlikely(n_active_groups == n_active_alloc)) {
       n_active_alloc *= 2;
       const size_t newsz = n_active_alloc * sizeof(struct netgroup *);
@@ -1722,41 +3562,39 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
 
    // Wake up any processes sensitive to this group
    if (new_flags & NET_F_EVENT) {
-      sens_list_t *it, *last = NULL, *next = NULL;
+      sens_list_t *it, *next = NULL;
 
       // First wakeup everything on the group specific pending list
+      // except edge qualified waits that do not match the new value
+      sens_list_t **keep = &(group->pending);
       for (it = group->pending; it != NULL; it = next) {
          next = it->next;
-         rt_wakeup(it);
-         group->pending = next;
+         if (unlikely(it->edge != 0)
+             && !(it->edge & (1u << *(uint8_t *)group->resolved))) {
+            *keep = it;
+            keep = &(it->next);
+         }
+         else
+            rt_wakeup(it);
       }
+      *keep = NULL;
 
-      // Now check the global pending list
+      // Now check the global pending index
       if (group->flags & NET_F_GLOBAL) {
-         for (it = pending; it != NULL; it = next) {
-            next = it->next;
-
-            const netid_t x = group->first;
-            const netid_t y = group->first + group->length - 1;
-            const netid_t a = it->first;
-            const netid_t b = it->last;
-
-            const bool hit = (x <= b) && (a <= y);
-
-            if (hit) {
-               rt_wakeup(it);
-               if (last == NULL)
-                  pending = next;
-               else
-                  last->next = next;
-            }
-            else
-               last = it;
+         const netid_t x = group->first;
+         const netid_t y = group->first + group->length - 1;
+
+         while ((it = pending_find(x, y)) != NULL) {
+            pending = pending_remove(pending, it);
+            if (it->reenq == NULL)
+               pending_unlink_proc(it);
+            rt_wakeup(it);
          }
       }
 
       // Schedule any callbacks to run
-      for (watch_list_t *wl = group->watching; wl != NULL; wl = wl->next) {
+      for (watch_list_t *wl = rt_cold(group)->watching;
+           wl != NULL; wl = wl->next) {
          if (!wl->watch->pending) {
             wl->watch->chain_pending = callbacks;
             wl->watch->pending = true;
@@ -1766,31 +3604,108 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
    }
 }
 
-static void rt_update_driver(netgroup_t *group, rt_proc_t *proc)
+static void rt_update_driver(netgroup_t *group, int driver)
 {
-   if (likely(proc != NULL)) {
-      // Find the driver owned by proc
-      int driver;
-      for (driver = 0; driver < group->n_drivers; driver++) {
-         if (likely(group->drivers[driver].proc == proc))
-            break;
-      }
-      assert(driver != group->n_drivers);
+   if (likely(driver >= 0)) {
+      assert(driver < group->n_drivers);
+
+      driver_t *d = &(group->drivers[driver]);
+      assert(d->count > 0);
 
-      waveform_t *w_now  = group->drivers[driver].waveforms;
-      waveform_t *w_next = w_now->next;
+      waveform_t *w_next = &(d->waveforms[rt_driver_slot(d, 1)]);
 
-      if (likely((w_next != NULL) && (w_next->when == now))) {
-         rt_update_group(group, driver, w_next->values->data);
-         group->drivers[driver].waveforms = w_next;
-         rt_free_value(group, w_now->values);
-         rt_free(waveform_stack, w_now);
+      if (likely((d->count > 1) && (w_next->when == now))) {
+         rt_update_group(group, driver, rt_driver_value(group, d, 1));
+         w_next->event = NULL;
+         d->head = rt_driver_slot(d, 1);
+         d->count--;
       }
-      else
-         assert(w_now != NULL);
    }
    else if (group->flags & NET_F_FORCED)
-      rt_update_group(group, -1, group->forcing->data);
+      rt_update_group(group, -1, rt_cold(group)->forcing->data);
+}
+
+static void rt_update_drivers(event_t *e)
+{
+   if (likely(e->ngroups == 1)) {
+      rt_update_driver(e->group, e->driver);
+      return;
+   }
+
+   // A batched event updates the driver of the scheduling process in
+   // each group which may have a different index in every group
+   for (uint32_t i = 0; i < e->ngroups; i++) {
+      netgroup_t *g = e->group + i;
+      const int driver = (g->n_drivers == 1) ? 0 : rt_find_driver(g, e->proc);
+      assert(driver != -1);
+      rt_update_driver(g, driver);
+   }
+}
+
+static void rt_implicit_set(netgroup_t *group, const void *value)
+{
+   // Assign a new driving value to an implicit signal in the current
+   // cycle and discard any later transactions
+
+   assert(group->n_drivers == 1);
+   driver_t *d = &(group->drivers[0]);
+
+   for (uint32_t i = 1; i < d->count; i++)
+      deltaq_cancel(d->waveforms[rt_driver_slot(d, i)].event);
+   d->count = 1;
+
+   void *current = rt_driver_value(group, d, 0);
+   memcpy(current, value, group->size * group->length);
+
+   rt_update_group(group, 0, current);
+}
+
+static void rt_update_implicit(void)
+{
+   while (implicit_pending != NULL) {
+      implicit_t *imp = implicit_pending;
+      implicit_pending = imp->chain_pending;
+      imp->pending = false;
+
+      TRACE("update implicit signal %s", fmt_group(imp->target[0]));
+
+      active_proc = imp->proc;
+      n_implicit_updates++;
+
+      switch (imp->kind) {
+      case ATTR_DELAYED:
+         // Equivalent to a transport assignment of the prefix
+         for (unsigned i = 0; i < imp->n_prefix; i++) {
+            netgroup_t *g = imp->prefix[i];
+            if (g->flags & NET_F_EVENT)
+               rt_sched_driver(imp->target[i], imp->delay, 0,
+                               g->resolved, NULL);
+         }
+         break;
+
+      case ATTR_STABLE:
+      case ATTR_QUIET:
+         {
+            // FALSE until the prefix has been unchanged for the delay
+            const uint8_t f = 0, t = 1;
+            rt_implicit_set(imp->target[0], &f);
+            rt_sched_driver(imp->target[0], imp->delay, 0, &t, NULL);
+         }
+         break;
+
+      case ATTR_TRANSACTION:
+         {
+            // Toggles in each cycle where the prefix is active
+            netgroup_t *g = imp->target[0];
+            const uint8_t value = !*(uint8_t *)g->resolved;
+            rt_implicit_set(g, &value);
+         }
+         break;
+
+      default:
+         fatal_trace("invalid implicit signal kind %d", imp->kind);
+      }
+   }
 }
 
 static bool rt_stale_event(event_t *e)
@@ -1812,8 +3727,10 @@ static void rt_push_run_queue(event_t *e)
       }
    }
 
-   if (unlikely(rt_stale_event(e)))
+   if (unlikely(rt_stale_event(e))) {
       rt_free(event_stack, e);
+      n_stale_events++;
+   }
    else {
       run_queue.queue[(run_queue.wr)++] = e;
       if (e->kind == E_PROCESS)
@@ -1832,27 +3749,406 @@ static event_t *rt_pop_run_queue(void)
       return run_queue.queue[(run_queue.rd)++];
 }
 
-static void rt_iteration_limit(void)
+static void rt_iteration_limit(void)
+{
+   text_buf_t *buf = tb_new();
+   tb_printf(buf, "Iteration limit of %d delta cycles reached. "
+             "The following processes are active:\n",
+             opt_get_int("stop-delta"));
+
+   for (sens_list_t *it = resume; it != NULL; it = it->next) {
+      tree_t p = it->proc->source;
+      const loc_t *l = tree_loc(p);
+      tb_printf(buf, "  %-30s %s line %d\n", istr(tree_ident(p)),
+                l->file, l->first_line);
+   }
+
+   tb_printf(buf, "You can increase this limit with --stop-delta");
+
+   fatal("%s", tb_get(buf));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Parallel process execution
+//
+// Processes that resume in the same simulation cycle cannot observe each
+// others' effects until the next driver update phase. A batch of such
+// processes is run on a pool of worker threads and any calls into the
+// kernel that modify shared state are recorded in a per-thread log. Once
+// the whole batch has finished the logs are replayed on the main thread
+// in the order the processes would have run serially so the result is
+// identical to a single-threaded simulation. Processes marked serial at
+// elaboration access files or shared variables directly and are instead
+// run on the main thread in their turn during the replay.
+
+static deferred_t *rt_defer(defer_kind_t kind)
+{
+   worker_t *w = defer_to;
+
+   if (unlikely(w->n_ops == w->max_ops)) {
+      w->max_ops = MAX(w->max_ops * 2, 64);
+      w->ops = xrealloc(w->ops, w->max_ops * sizeof(deferred_t));
+   }
+
+   deferred_t *d = &(w->ops[w->n_ops++]);
+   d->kind = kind;
+   d->item = w->item;
+   return d;
+}
+
+static size_t rt_defer_alloc(size_t sz)
+{
+   worker_t *w = defer_to;
+
+   // Values are stored as offsets as the arena may move when it grows
+   const size_t offset = w->arena_sz;
+   w->arena_sz += (sz + 7) & ~7;
+
+   if (unlikely(w->arena_sz > w->arena_max)) {
+      w->arena_max = MAX(w->arena_max * 2, w->arena_sz);
+      w->arena = xrealloc(w->arena, w->arena_max);
+   }
+
+   return offset;
+}
+
+static size_t rt_defer_copy(const void *src, size_t sz)
+{
+   const size_t offset = rt_defer_alloc(sz);
+   memcpy(defer_to->arena + offset, src, sz);
+   return offset;
+}
+
+static void rt_batch_add(rt_proc_t *proc, sens_list_t *sl)
+{
+   if (unlikely(pool.n_batch == pool.max_batch)) {
+      pool.max_batch = MAX(pool.max_batch * 2, 128);
+      pool.batch = xrealloc(pool.batch, pool.max_batch * sizeof(rt_proc_t *));
+      pool.owner = xrealloc(pool.owner, pool.max_batch * sizeof(unsigned));
+      pool.batch_sl = xrealloc(pool.batch_sl,
+                               pool.max_batch * sizeof(sens_list_t *));
+   }
+
+   pool.batch_sl[pool.n_batch] = sl;
+   pool.batch[pool.n_batch++] = proc;
+}
+
+static void rt_batch_work(worker_t *w)
+{
+   // Processes are claimed dynamically from the shared batch so idle
+   // workers pick up the remaining work from busy ones
+   for (;;) {
+      const unsigned i = __atomic_fetch_add(&pool.next, 1, __ATOMIC_RELAXED);
+      if (i >= pool.n_batch)
+         break;
+
+      if (pool.batch[i]->serial)
+         continue;   // Run on the main thread during replay
+
+      pool.owner[i] = w - workers;
+      w->item = i;
+      rt_run(pool.batch[i], false /* reset */);
+   }
+}
+
+static void *rt_worker_thread(void *arg)
+{
+   worker_t *w = arg;
+
+   proc_tmp_stack = w->tmp_stack;
+   defer_to = w;
+
+   unsigned generation = 0;
+   for (;;) {
+      pthread_mutex_lock(&pool.lock);
+      while (pool.generation == generation && !pool.shutdown)
+         pthread_cond_wait(&pool.start, &pool.lock);
+      generation = pool.generation;
+      const bool shutdown = pool.shutdown;
+      pthread_mutex_unlock(&pool.lock);
+
+      if (shutdown)
+         break;
+
+      if (pool.job != NULL)
+         (*pool.job)(w, w - workers);
+      else
+         rt_batch_work(w);
+
+      pthread_mutex_lock(&pool.lock);
+      if (--pool.running == 0)
+         pthread_cond_signal(&pool.done);
+      pthread_mutex_unlock(&pool.lock);
+   }
+
+   return NULL;
+}
+
+static void rt_pool_run(pool_job_fn_t job)
+{
+   // Run a job other than a process batch once on every worker
+
+   pthread_mutex_lock(&pool.lock);
+   pool.job = job;
+   pool.running = n_workers - 1;
+   pool.generation++;
+   pthread_cond_broadcast(&pool.start);
+   pthread_mutex_unlock(&pool.lock);
+
+   (*job)(&(workers[0]), 0);
+
+   pthread_mutex_lock(&pool.lock);
+   while (pool.running > 0)
+      pthread_cond_wait(&pool.done, &pool.lock);
+   pool.job = NULL;
+   pthread_mutex_unlock(&pool.lock);
+}
+
+static void rt_touch_job(worker_t *w, unsigned index)
+{
+   // Write to each page in this worker's share of the group arrays so
+   // the kernel allocates it on the NUMA node the worker is running on
+
+   const size_t pagesz = sysconf(_SC_PAGESIZE);
+   const size_t ngroups = netdb_size(netdb);
+
+   struct { void *base; size_t size; } regions[] = {
+      { groups, sizeof(struct netgroup) * ngroups },
+      { groups_cold, sizeof(struct netgroup_cold) * ngroups }
+   };
+
+   for (int i = 0; i < ARRAY_LEN(regions); i++) {
+      const size_t npages = (regions[i].size + pagesz - 1) / pagesz;
+      const size_t first = (npages * index) / n_workers;
+      const size_t last = (npages * (index + 1)) / n_workers;
+
+      volatile uint8_t *p = regions[i].base;
+      for (size_t page = first; page < last; page++)
+         p[page * pagesz] = 0;
+   }
+}
+
+static void rt_batch_execute(void)
+{
+   for (unsigned i = 0; i < n_workers; i++) {
+      workers[i].n_ops    = 0;
+      workers[i].replay   = 0;
+      workers[i].arena_sz = 0;
+   }
+
+   pool.next = 0;
+
+   pthread_mutex_lock(&pool.lock);
+   pool.running = n_workers - 1;
+   pool.generation++;
+   pthread_cond_broadcast(&pool.start);
+   pthread_mutex_unlock(&pool.lock);
+
+   // The main thread acts as the first worker
+   defer_to = &(workers[0]);
+   rt_batch_work(&(workers[0]));
+   defer_to = NULL;
+
+   pthread_mutex_lock(&pool.lock);
+   while (pool.running > 0)
+      pthread_cond_wait(&pool.done, &pool.lock);
+   pthread_mutex_unlock(&pool.lock);
+
+   n_par_batches++;
+   n_par_procs += pool.n_batch;
+}
+
+static void rt_batch_replay(unsigned item)
+{
+   if (pool.batch[item]->serial) {
+      // Processes which share state other than signals run in turn
+      // once the rest of the batch has finished
+      rt_run(pool.batch[item], false /* reset */);
+      return;
+   }
+
+   worker_t *w = &(workers[pool.owner[item]]);
+
+   active_proc = pool.batch[item];
+
+   for (; w->replay < w->n_ops && w->ops[w->replay].item == item;
+        w->replay++) {
+      const deferred_t *d = &(w->ops[w->replay]);
+      switch (d->kind) {
+      case DEFER_WAVEFORM:
+         rt_sched_group_waveform(d->u.waveform.group,
+                                 w->arena + d->u.waveform.values,
+                                 d->u.waveform.after, d->u.waveform.reject,
+                                 NULL);
+         break;
+      case DEFER_EVENT:
+         _sched_event(w->arena + d->u.event.nids, d->u.event.n,
+                      d->u.event.flags);
+         break;
+      case DEFER_PROCESS:
+         deltaq_insert_proc(d->u.process.delay, active_proc);
+         break;
+      case DEFER_ASSERT:
+         _assert_fail(w->arena + d->u.assert.msg, d->u.assert.msg_len,
+                      d->u.assert.severity, d->u.assert.where,
+                      d->u.assert.module);
+         break;
+      }
+   }
+}
+
+static void rt_batch_flush(void)
+{
+   if (pool.n_batch == 0)
+      return;
+   else if (pool.n_batch < PAR_MIN_BATCH) {
+      // Not worth waking up the worker threads
+      for (unsigned i = 0; i < pool.n_batch; i++)
+         rt_run(pool.batch[i], false /* reset */);
+   }
+   else {
+      rt_batch_execute();
+
+      for (unsigned i = 0; i < pool.n_batch; i++)
+         rt_batch_replay(i);
+   }
+
+   pool.n_batch = 0;
+}
+
+static void rt_start_workers(int nthreads)
+{
+   n_workers = nthreads;
+   workers   = xcalloc(n_workers * sizeof(worker_t));
+
+   pthread_mutex_init(&pool.lock, NULL);
+   pthread_cond_init(&pool.start, NULL);
+   pthread_cond_init(&pool.done, NULL);
+
+   pool.generation = 0;
+   pool.shutdown   = false;
+
+   for (unsigned i = 1; i < n_workers; i++) {
+      workers[i].tmp_stack = mmap_guarded(PROC_TMP_STACK_SZ,
+                                          "worker temp stack");
+
+      if (pthread_create(&(workers[i].thread), NULL,
+                         rt_worker_thread, &(workers[i])) != 0)
+         fatal_errno("pthread_create");
+   }
+}
+
+static void rt_stop_workers(void)
+{
+   if (n_workers == 0)
+      return;
+
+   pthread_mutex_lock(&pool.lock);
+   pool.shutdown = true;
+   pthread_cond_broadcast(&pool.start);
+   pthread_mutex_unlock(&pool.lock);
+
+   for (unsigned i = 1; i < n_workers; i++)
+      pthread_join(workers[i].thread, NULL);
+
+   for (unsigned i = 0; i < n_workers; i++) {
+      free(workers[i].ops);
+      free(workers[i].arena);
+   }
+
+   free(workers);
+   free(pool.batch);
+   free(pool.owner);
+   free(pool.batch_sl);
+
+   workers   = NULL;
+   n_workers = 0;
+   parallel  = false;
+}
+
+static void rt_resume_processes_parallel(sens_list_t **list)
+{
+   for (sens_list_t *it = *list; it != NULL; it = it->next) {
+      if (it->proc->pending) {
+         rt_batch_add(it->proc, it);
+         it->proc->pending = false;
+      }
+   }
+
+   const bool use_workers = (pool.n_batch >= PAR_MIN_BATCH);
+   if (use_workers)
+      rt_batch_execute();
+
+   // Replay the effects of each process in the order they would have
+   // run serially interleaved with re-adding static sensitivity
+   unsigned item = 0;
+   sens_list_t *it = *list;
+   while (it != NULL) {
+      if (item < pool.n_batch && pool.batch_sl[item] == it) {
+         if (use_workers)
+            rt_batch_replay(item);
+         else
+            rt_run(it->proc, false /* reset */);
+         item++;
+      }
+
+      sens_list_t *next = it->next;
+
+      if (it->reenq == NULL)
+         rt_release_sens(it);
+      else
+         rt_reenq(it);
+
+      it = next;
+   }
+
+   pool.n_batch = 0;
+   *list = NULL;
+}
+
+static void rt_hold_levels(void)
 {
-   text_buf_t *buf = tb_new();
-   tb_printf(buf, "Iteration limit of %d delta cycles reached. "
-             "The following processes are active:\n",
-             opt_get_int("stop-delta"));
+   // In cycle based mode only the combinational processes at the lowest
+   // level with pending work run in this delta cycle: the rest are held
+   // until their inputs have settled so each evaluates once per change
+   // rather than once for each glitch on its inputs
+
+   if (held != NULL) {
+      sens_list_t *tail = held;
+      while (tail->next != NULL)
+         tail = tail->next;
+      tail->next = resume;
+      resume = held;
+      held = NULL;
+   }
 
+   int min_level = INT_MAX;
    for (sens_list_t *it = resume; it != NULL; it = it->next) {
-      tree_t p = it->proc->source;
-      const loc_t *l = tree_loc(p);
-      tb_printf(buf, "  %-30s %s line %d\n", istr(tree_ident(p)),
-                l->file, l->first_line);
+      if (it->proc->pending)
+         min_level = MIN(min_level, MAX(it->proc->level, 0));
    }
 
-   tb_printf(buf, "You can increase this limit with --stop-delta");
-
-   fatal("%s", tb_get(buf));
+   sens_list_t **p = &resume;
+   while (*p != NULL) {
+      sens_list_t *it = *p;
+      if (it->proc->pending && it->proc->level > min_level) {
+         *p = it->next;
+         it->next = held;
+         held = it;
+         n_held_procs++;
+      }
+      else
+         p = &(it->next);
+   }
 }
 
 static void rt_resume_processes(sens_list_t **list)
 {
+   if (parallel && list != &postponed) {
+      rt_resume_processes_parallel(list);
+      return;
+   }
+
    sens_list_t *it = *list;
    while (it != NULL) {
       if (it->proc->pending) {
@@ -1863,11 +4159,9 @@ static void rt_resume_processes(sens_list_t **list)
       sens_list_t *next = it->next;
 
       if (it->reenq == NULL)
-         rt_free(sens_list_stack, it);
-      else {
-         it->next = *(it->reenq);
-         *(it->reenq) = it;
-      }
+         rt_release_sens(it);
+      else
+         rt_reenq(it);
 
       it = next;
    }
@@ -1882,7 +4176,8 @@ static void rt_event_callback(bool postponed)
    for (it = callbacks; it != NULL; it = next) {
       next = it->chain_pending;
       if (it->postponed == postponed) {
-         (*it->fn)(now, it->signal, it, it->user_data);
+         if (likely(it->fn != NULL))
+            (*it->fn)(now, it->signal, it, it->user_data);
          it->pending = false;
 
          *last = it->chain_pending;
@@ -1895,26 +4190,27 @@ static void rt_event_callback(bool postponed)
 
 static inline bool rt_next_cycle_is_delta(void)
 {
-   return (delta_driver != NULL) || (delta_proc != NULL);
+   return (delta_driver != NULL) || (delta_proc != NULL) || (held != NULL);
 }
 
 static void rt_cycle(int stop_delta)
 {
    // Simulation cycle is described in LRM 93 section 12.6.4
 
-   const bool is_delta_cycle = (delta_driver != NULL) || (delta_proc != NULL);
+   const bool is_delta_cycle = rt_next_cycle_is_delta();
 
    if (is_delta_cycle)
       iteration = iteration + 1;
    else {
-      event_t *peek = heap_min(eventq_heap);
+      event_t *peek = eventq_min(eventq_heap);
       while (unlikely(rt_stale_event(peek))) {
          // Discard stale events
-         rt_free(event_stack, heap_extract_min(eventq_heap));
-         if (heap_size(eventq_heap) == 0)
+         rt_free(event_stack, deltaq_extract());
+         n_stale_events++;
+         if (eventq_size(eventq_heap) == 0)
             return;
          else
-            peek = heap_min(eventq_heap);
+            peek = eventq_min(eventq_heap);
       }
       now = peek->when;
       iteration = 0;
@@ -1945,27 +4241,40 @@ static void rt_cycle(int stop_delta)
       rt_global_event(RT_NEXT_TIME_STEP);
 
       for (;;) {
-         rt_push_run_queue(heap_extract_min(eventq_heap));
+         rt_push_run_queue(deltaq_extract());
 
-         if (heap_size(eventq_heap) == 0)
+         if (eventq_size(eventq_heap) == 0)
             break;
 
-         event_t *peek = heap_min(eventq_heap);
+         event_t *peek = eventq_min(eventq_heap);
          if (peek->when > now)
             break;
       }
    }
 
+   if (unlikely(rt_detailed_stats())) {
+      rt_hist_add(&hist_run_queue, run_queue.wr - run_queue.rd);
+      rt_hist_add(&hist_eventq, eventq_size(eventq_heap));
+   }
+
    event_t *event;
    while ((event = rt_pop_run_queue())) {
       switch (event->kind) {
       case E_PROCESS:
-         rt_run(event->proc, false /* reset */);
+         rt_phase(PHASE_PROCESS);
+         if (parallel)
+            rt_batch_add(event->proc, NULL);
+         else
+            rt_run(event->proc, false /* reset */);
          break;
       case E_DRIVER:
-         rt_update_driver(event->group, event->proc);
+         rt_batch_flush();
+         rt_phase(PHASE_DRIVER);
+         rt_update_drivers(event);
          break;
       case E_TIMEOUT:
+         rt_batch_flush();
+         rt_phase(PHASE_CALLBACK);
          (*event->timeout_fn)(now, event->timeout_user);
          break;
       }
@@ -1973,6 +4282,15 @@ static void rt_cycle(int stop_delta)
       rt_free(event_stack, event);
    }
 
+   rt_batch_flush();
+
+   if (implicit_pending != NULL) {
+      rt_phase(PHASE_DRIVER);
+      rt_update_implicit();
+   }
+
+   rt_phase(PHASE_CALLBACK);
+
    if (unlikely(now == 0 && iteration == 0)) {
       vcd_restart();
       lxt_restart();
@@ -1985,8 +4303,16 @@ static void rt_cycle(int stop_delta)
    rt_event_callback(false);
 
    // Run all processes that resumed because of signal events
+   if (cycle_based)
+      rt_hold_levels();
+   rt_phase(PHASE_PROCESS);
    rt_resume_processes(&resume);
+   rt_phase(PHASE_CALLBACK);
    rt_global_event(RT_END_OF_PROCESSES);
+   rt_phase(PHASE_QUEUE);
+
+   if (unlikely(rt_detailed_stats()))
+      rt_hist_add(&hist_active, n_active_groups);
 
    for (unsigned i = 0; i < n_active_groups; i++) {
       netgroup_t *g = active_groups[i];
@@ -1999,49 +4325,113 @@ static void rt_cycle(int stop_delta)
       rt_global_event(RT_LAST_KNOWN_DELTA_CYCLE);
 
       // Run any postponed processes
+      rt_phase(PHASE_POSTPONED);
       rt_resume_processes(&postponed);
 
       // Execute all postponed event callbacks
+      rt_phase(PHASE_CALLBACK);
       rt_event_callback(true);
+      wave_flush();
+      rt_global_event(RT_END_OF_TIME_STEP);
+      rt_phase(PHASE_QUEUE);
+
+      if (unlikely(rt_detailed_stats()))
+         rt_hist_add(&hist_deltas, iteration + 1);
 
       can_create_delta = true;
    }
 }
 
-static void rt_load_unit(const char *name)
+static struct loaded *rt_find_loaded(const char *name)
 {
-   ident_t name_i = ident_new(name);
+   struct loaded **it;
+   for (it = &loaded; *it != NULL; it = &((*it)->next)) {
+      if ((*it)->name == name)
+         return *it;
+   }
+
+   struct loaded *l = xmalloc(sizeof(struct loaded));
+   l->next      = NULL;
+   l->name      = name;
+   l->read_ctx  = NULL;
+   l->meta      = NULL;
+   l->have_meta = false;
+
+   return (*it = l);
+}
+
+static void rt_load_unit(struct loaded *l)
+{
+   ident_t name_i = ident_new(l->name);
    lib_t lib = lib_find(ident_until(name_i, '.'), true);
 
-   tree_rd_ctx_t ctx = NULL;
-   if (lib_get_ctx(lib, name_i, &ctx) == NULL)
-      fatal("cannot find unit %s", name);
+   if (lib_get_ctx(lib, name_i, &(l->read_ctx)) == NULL)
+      fatal("cannot find unit %s", l->name);
+}
 
-   struct loaded *l = xmalloc(sizeof(struct loaded));
-   l->next     = NULL;
-   l->name     = name;
-   l->read_ctx = ctx;
+static tree_t rt_recall_tree_serial(const char *unit, int32_t where)
+{
+   struct loaded *l = rt_find_loaded(unit);
+   if (l->read_ctx == NULL)
+      rt_load_unit(l);
 
-   if (loaded == NULL)
-      loaded = l;
-   else {
-      struct loaded *it;
-      for (it = loaded; it->next != NULL; it = it->next)
-         ;
-      it->next = l;
-   }
+   return tree_read_recall(l->read_ctx, where);
 }
 
 static tree_t rt_recall_tree(const char *unit, int32_t where)
 {
-   struct loaded *it;
-   for (it = loaded; it != NULL; it = it->next) {
-      if (it->name == unit)
-         return tree_read_recall(it->read_ctx, where);
+   // Loading units is not thread safe so worker threads must take turns
+   if (unlikely(parallel)) {
+      pthread_mutex_lock(&serial_lock);
+      tree_t t = rt_recall_tree_serial(unit, where);
+      pthread_mutex_unlock(&serial_lock);
+      return t;
+   }
+   else
+      return rt_recall_tree_serial(unit, where);
+}
+
+static void rt_recall_info_serial(const char *unit, int32_t where,
+                                  meta_info_t *info)
+{
+   // Diagnostics only need the location and a few properties of the
+   // tree which the metadata written by the code generator provides
+   // without loading the whole unit
+
+   struct loaded *l = rt_find_loaded(unit);
+   if (!l->have_meta) {
+      ident_t name_i = ident_new(unit);
+      lib_t lib = lib_find(ident_until(name_i, '.'), true);
+
+      l->meta      = meta_open(lib, name_i);
+      l->have_meta = true;
    }
 
-   rt_load_unit(unit);
-   return rt_recall_tree(unit, where);
+   if (l->meta != NULL && meta_lookup(l->meta, where, info))
+      return;
+
+   tree_t t = rt_recall_tree_serial(unit, where);
+
+   info->loc   = *tree_loc(t);
+   info->kind  = tree_kind(t);
+   info->flags = 0;
+   info->name  = NULL;
+
+   if (info->kind == T_PORT_DECL || info->kind == T_VAR_DECL)
+      info->name = istr(tree_ident(t));
+   else if (tree_attr_int(t, ident_new("is_report"), 0))
+      info->flags |= META_F_REPORT;
+}
+
+static void rt_recall_info(const char *unit, int32_t where, meta_info_t *info)
+{
+   if (unlikely(parallel)) {
+      pthread_mutex_lock(&serial_lock);
+      rt_recall_info_serial(unit, where, info);
+      pthread_mutex_unlock(&serial_lock);
+   }
+   else
+      rt_recall_info_serial(unit, where, info);
 }
 
 static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
@@ -2051,26 +4441,16 @@ static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
    assert(g->first == first);
    assert(g->length == length);
 
-   if (g->flags & NET_F_OWNS_MEM)
-      free(g->resolved);
+   netgroup_cold_t *cold = rt_cold(g);
 
-   free(g->forcing);
+   free(cold->forcing);
 
-   for (int j = 0; j < g->n_drivers; j++) {
-      while (g->drivers[j].waveforms != NULL) {
-         waveform_t *next = g->drivers[j].waveforms->next;
-         rt_free_value(g, g->drivers[j].waveforms->values);
-         rt_free(waveform_stack, g->drivers[j].waveforms);
-         g->drivers[j].waveforms = next;
-      }
-   }
+   for (int j = 0; j < g->n_drivers; j++)
+      free(g->drivers[j].waveforms);
    free(g->drivers);
 
-   while (g->free_values != NULL) {
-      value_t *next = g->free_values->next;
-      free(g->free_values);
-      g->free_values = next;
-   }
+   if (cold->driver_map != NULL)
+      hash_free(cold->driver_map);
 
    while (g->pending != NULL) {
       sens_list_t *next = g->pending->next;
@@ -2078,10 +4458,10 @@ static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
       g->pending = next;
    }
 
-   while (g->watching != NULL) {
-      watch_list_t *next = g->watching->next;
-      free(g->watching);
-      g->watching = next;
+   while (cold->watching != NULL) {
+      watch_list_t *next = cold->watching->next;
+      free(cold->watching);
+      cold->watching = next;
    }
 }
 
@@ -2089,16 +4469,29 @@ static void rt_cleanup(tree_t top)
 {
    assert(resume == NULL);
 
-   while (heap_size(eventq_heap) > 0)
-      rt_free(event_stack, heap_extract_min(eventq_heap));
+   if (stats_level != STATS_NONE) {
+      // Capture the allocator state at the end of the simulation
+      rt_alloc_stack_stats(event_stack, &(alloc_stats[0]));
+      rt_alloc_stack_stats(sens_list_stack, &(alloc_stats[1]));
+      rt_alloc_stack_stats(watch_stack, &(alloc_stats[2]));
+      rt_alloc_stack_stats(callback_stack, &(alloc_stats[3]));
+   }
+
+   while (eventq_size(eventq_heap) > 0)
+      rt_free(event_stack, eventq_extract_min(eventq_heap));
 
    rt_free_delta_events(delta_proc);
    rt_free_delta_events(delta_driver);
 
-   heap_free(eventq_heap);
+   eventq_free(eventq_heap);
    eventq_heap = NULL;
 
    netdb_walk(netdb, rt_cleanup_group);
+
+   rt_signal_free(resolved_mem);
+   rt_signal_free(last_value_mem);
+   resolved_mem = last_value_mem = NULL;
+   rt_sparse_free();
    netdb_close(netdb);
 
    while (watches != NULL) {
@@ -2108,11 +4501,8 @@ static void rt_cleanup(tree_t top)
       watches = next;
    }
 
-   while (pending != NULL) {
-      sens_list_t *next = pending->next;
-      rt_free(sens_list_stack, pending);
-      pending = next;
-   }
+   pending_free(pending);
+   pending = NULL;
 
    for (int i = 0; i < RT_LAST_EVENT; i++) {
       while (global_cbs[i] != NULL) {
@@ -2123,7 +4513,6 @@ static void rt_cleanup(tree_t top)
    }
 
    rt_alloc_stack_destroy(event_stack);
-   rt_alloc_stack_destroy(waveform_stack);
    rt_alloc_stack_destroy(sens_list_stack);
    rt_alloc_stack_destroy(watch_stack);
    rt_alloc_stack_destroy(callback_stack);
@@ -2133,26 +4522,254 @@ static void rt_cleanup(tree_t top)
 
 static bool rt_stop_now(uint64_t stop_time)
 {
-   if ((delta_driver != NULL) || (delta_proc != NULL))
+   if (rt_next_cycle_is_delta())
       return false;
-   else if (heap_size(eventq_heap) == 0)
+   else if (eventq_size(eventq_heap) == 0)
       return true;
    else if (force_stop)
       return true;
    else if (stop_time == UINT64_MAX)
       return false;
    else {
-      event_t *peek = heap_min(eventq_heap);
+      event_t *peek = eventq_min(eventq_heap);
       return peek->when > stop_time;
    }
 }
 
+static const char *phase_names[PHASE_LAST] = {
+   "queue", "process", "driver", "callback", "postponed"
+};
+
+static void rt_hist_print(const char *name, const histogram_t *h)
+{
+   notef("%s: count:%"PRIu64" mean:%.1f max:%"PRIu64, name, h->count,
+         h->count ? (double)h->sum / h->count : 0.0, h->max);
+
+   for (int i = 0; i < HIST_BUCKETS; i++) {
+      if (h->buckets[i] == 0)
+         continue;
+
+      const uint64_t lo = (i == 0) ? 0 : UINT64_C(1) << (i - 1);
+      const uint64_t hi = (i == 0) ? 0 : (UINT64_C(1) << i) - 1;
+      printf("  %10"PRIu64"..%-10"PRIu64" %12"PRIu64"\n",
+             lo, hi, h->buckets[i]);
+   }
+}
+
+static void rt_hist_json(FILE *f, const char *name, const histogram_t *h,
+                         bool last)
+{
+   fprintf(f, "  \"%s\": { \"count\": %"PRIu64", \"sum\": %"PRIu64", "
+           "\"max\": %"PRIu64", \"buckets\": [", name, h->count, h->sum,
+           h->max);
+
+   int nbuckets = HIST_BUCKETS;
+   while (nbuckets > 0 && h->buckets[nbuckets - 1] == 0)
+      nbuckets--;
+
+   for (int i = 0; i < nbuckets; i++)
+      fprintf(f, "%s%"PRIu64, i > 0 ? ", " : "", h->buckets[i]);
+
+   fprintf(f, "] }%s\n", last ? "" : ",");
+}
+
+static void rt_stats_json(const nvc_rusage_t *ru)
+{
+   // The bucket at index N counts values in [2^(N-1), 2^N) with values
+   // of zero in the first bucket
+
+   FILE *f = stdout;
+   fprintf(f, "{\n");
+   fprintf(f, "  \"setup_ms\": %u,\n  \"run_ms\": %u,\n"
+           "  \"maxrss_kb\": %u,\n", ready_rusage.ms, ru->ms, ru->rss);
+   fprintf(f, "  \"threads\": %u,\n  \"parallel_batches\": %"PRIu64",\n"
+           "  \"parallel_processes\": %"PRIu64",\n", n_workers,
+           n_par_batches, n_par_procs);
+   fprintf(f, "  \"transactions\": %"PRIu64",\n  \"events\": %"PRIu64",\n"
+           "  \"implicit_updates\": %"PRIu64",\n"
+           "  \"clock_ticks\": %"PRIu64",\n",
+           n_transactions, n_signal_events, n_implicit_updates,
+           n_clock_ticks);
+   fprintf(f, "  \"events_cancelled\": %"PRIu64",\n"
+           "  \"events_stale\": %"PRIu64",\n"
+           "  \"events_batched\": %"PRIu64",\n"
+           "  \"held_processes\": %"PRIu64",\n",
+           n_cancel_events, n_stale_events, n_batched_events, n_held_procs);
+   fprintf(f, "  \"resolution_calls\": %"PRIu64",\n"
+           "  \"resolution_folds\": %"PRIu64",\n",
+           n_resolution_calls, n_resolution_folds);
+   fprintf(f, "  \"sparse_signals\": %u,\n"
+           "  \"sparse_signal_bytes\": %"PRIu64",\n",
+           n_sparse_signals, sparse_signal_bytes);
+   fprintf(f, "  \"private_stacks\": %u,\n"
+           "  \"private_stacks_reused\": %"PRIu64",\n"
+           "  \"private_stack_hwm\": %u,\n",
+           n_tmp_stacks, n_tmp_reused, tmp_stack_hwm);
+
+   fprintf(f, "  \"alloc\": {");
+   for (int i = 0; i < ARRAY_LEN(alloc_stats); i++)
+      fprintf(f, "%s\n    \"%s\": { \"live\": %"PRIi64", \"peak\": %"PRIi64
+              ", \"slow\": %"PRIu64", \"magazines\": %u }", i > 0 ? "," : "",
+              alloc_stats[i].name, alloc_stats[i].live, alloc_stats[i].peak,
+              alloc_stats[i].slow_hits, alloc_stats[i].magazines);
+   fprintf(f, "\n  },\n");
+
+   fprintf(f, "  \"phase_ns\": {");
+   for (int i = 0; i < PHASE_LAST; i++)
+      fprintf(f, "%s \"%s\": %"PRIu64, i > 0 ? "," : "", phase_names[i],
+              phase_ns[i]);
+   fprintf(f, " },\n");
+
+   rt_hist_json(f, "deltas_per_step", &hist_deltas, false);
+   rt_hist_json(f, "run_queue", &hist_run_queue, false);
+   rt_hist_json(f, "event_queue", &hist_eventq, false);
+   rt_hist_json(f, "active_groups", &hist_active, true);
+   fprintf(f, "}\n");
+   fflush(f);
+}
+
 static void rt_stats_print(void)
 {
    nvc_rusage_t ru;
    nvc_rusage(&ru);
 
+   if (stats_level == STATS_JSON) {
+      rt_stats_json(&ru);
+      return;
+   }
+
    notef("setup:%ums run:%ums maxrss:%ukB", ready_rusage.ms, ru.ms, ru.rss);
+
+   if (n_workers > 0)
+      notef("threads:%u batches:%"PRIu64" parallel processes:%"PRIu64,
+            n_workers, n_par_batches, n_par_procs);
+
+   notef("transactions:%"PRIu64" events:%"PRIu64, n_transactions,
+         n_signal_events);
+   notef("events cancelled:%"PRIu64" stale:%"PRIu64" batched:%"PRIu64,
+         n_cancel_events, n_stale_events, n_batched_events);
+
+   if (cycle_based)
+      notef("held process evaluations:%"PRIu64, n_held_procs);
+
+   if (n_implicit_updates > 0)
+      notef("implicit signal updates:%"PRIu64, n_implicit_updates);
+
+   if (n_clock_ticks > 0)
+      notef("native clock ticks:%"PRIu64, n_clock_ticks);
+
+   if (n_resolution_calls > 0 || n_resolution_folds > 0)
+      notef("resolution calls:%"PRIu64" table folds:%"PRIu64,
+            n_resolution_calls, n_resolution_folds);
+
+   if (n_sparse_signals > 0)
+      notef("lazily mapped signals:%u size:%"PRIu64"kB", n_sparse_signals,
+            sparse_signal_bytes / 1024);
+
+   if (n_tmp_stacks > 0)
+      notef("private stacks:%u reused:%"PRIu64" high water:%u bytes",
+            n_tmp_stacks, n_tmp_reused, tmp_stack_hwm);
+
+   for (int i = 0; i < ARRAY_LEN(alloc_stats); i++)
+      notef("%s objects live:%"PRIi64" peak:%"PRIi64" slow:%"PRIu64
+            " magazines:%u", alloc_stats[i].name, alloc_stats[i].live,
+            alloc_stats[i].peak, alloc_stats[i].slow_hits,
+            alloc_stats[i].magazines);
+
+   if (stats_level == STATS_DETAIL) {
+      uint64_t total_ns = 0;
+      for (int i = 0; i < PHASE_LAST; i++)
+         total_ns += phase_ns[i];
+
+      for (int i = 0; i < PHASE_LAST; i++)
+         notef("phase %-9s %8"PRIu64"ms %5.1f%%", phase_names[i],
+               phase_ns[i] / 1000000,
+               total_ns ? (100.0 * phase_ns[i]) / total_ns : 0.0);
+
+      rt_hist_print("delta cycles per time step", &hist_deltas);
+      rt_hist_print("run queue length", &hist_run_queue);
+      rt_hist_print("event queue size", &hist_eventq);
+      rt_hist_print("active groups per cycle", &hist_active);
+      fflush(stdout);
+   }
+}
+
+static int rt_prof_proc_cmp(const void *a, const void *b)
+{
+   const rt_proc_t *pa = *(const rt_proc_t **)a;
+   const rt_proc_t *pb = *(const rt_proc_t **)b;
+
+   if (pa->prof_ns != pb->prof_ns)
+      return pa->prof_ns < pb->prof_ns ? 1 : -1;
+   else
+      return 0;
+}
+
+static int rt_prof_group_cmp(const void *a, const void *b)
+{
+   const group_prof_t *ga = &(group_prof[*(const groupid_t *)a]);
+   const group_prof_t *gb = &(group_prof[*(const groupid_t *)b]);
+
+   if (ga->transactions != gb->transactions)
+      return ga->transactions < gb->transactions ? 1 : -1;
+   else if (ga->events != gb->events)
+      return ga->events < gb->events ? 1 : -1;
+   else
+      return 0;
+}
+
+static void rt_profile_print(void)
+{
+   // Must be called before rt_cleanup as group names are formatted
+   // using the signal declarations
+
+   const int max_rows = 20;
+
+   rt_proc_t **sorted = xmalloc(sizeof(rt_proc_t *) * n_procs);
+   uint64_t total_ns = 0;
+   for (size_t i = 0; i < n_procs; i++) {
+      sorted[i] = &(procs[i]);
+      total_ns += procs[i].prof_ns;
+   }
+
+   qsort(sorted, n_procs, sizeof(rt_proc_t *), rt_prof_proc_cmp);
+
+   notef("process profile (%"PRIu64"ms in %zu processes)",
+         total_ns / 1000000, n_procs);
+   printf("%12s %12s %6s  %s\n", "Runs", "Time (us)", "%", "Process");
+   for (size_t i = 0; i < n_procs && i < max_rows; i++) {
+      if (sorted[i]->prof_runs == 0)
+         break;
+
+      printf("%12"PRIu64" %12"PRIu64" %6.2f  %s\n",
+             sorted[i]->prof_runs, sorted[i]->prof_ns / 1000,
+             total_ns ? (100.0 * sorted[i]->prof_ns) / total_ns : 0.0,
+             istr(tree_ident(sorted[i]->source)));
+   }
+
+   free(sorted);
+
+   const size_t ngroups = netdb_size(netdb);
+   groupid_t *gids = xmalloc(sizeof(groupid_t) * ngroups);
+   for (size_t i = 0; i < ngroups; i++)
+      gids[i] = i;
+
+   qsort(gids, ngroups, sizeof(groupid_t), rt_prof_group_cmp);
+
+   notef("signal profile (%zu groups)", ngroups);
+   printf("%12s %12s  %s\n", "Transactions", "Events", "Signal");
+   for (size_t i = 0; i < ngroups && i < max_rows; i++) {
+      const group_prof_t *gp = &(group_prof[gids[i]]);
+      if (gp->transactions == 0)
+         break;
+
+      const netgroup_t *g = &(groups[gids[i]]);
+      printf("%12"PRIu64" %12"PRIu64"  %s\n", gp->transactions, gp->events,
+             rt_cold(g)->sig_decl ? fmt_group(g) : "(anonymous)");
+   }
+
+   free(gids);
+   fflush(stdout);
 }
 
 static void rt_reset_coverage(tree_t top)
@@ -2174,8 +4791,203 @@ static void rt_emit_coverage(tree_t top)
 {
    const int32_t *cover_stmts = jit_var_ptr("cover_stmts", false);
    const int32_t *cover_conds = jit_var_ptr("cover_conds", false);
-   if (cover_stmts != NULL)
+   if (cover_stmts != NULL) {
+      cover_write_db(top, opt_get_str("cover-db"), cover_stmts, cover_conds);
       cover_report(top, cover_stmts, cover_conds);
+   }
+}
+
+static void rt_pgo_write(const char *fname)
+{
+   // Record how many times each process ran for nvc -e --pgo-use
+
+   FILE *f = fopen(fname, "w");
+   if (f == NULL)
+      fatal_errno("%s", fname);
+
+   fprintf(f, "# nvc process profile\n");
+   for (size_t i = 0; i < n_procs; i++)
+      fprintf(f, "%"PRIu64" %s\n", procs[i].prof_runs,
+              istr(tree_ident(procs[i].source)));
+
+   if (fclose(f) != 0)
+      fatal_errno("%s", fname);
+}
+
+static int rt_activity_cmp(const void *a, const void *b)
+{
+   // Sort by instance with the separator ordered before any other
+   // character so each instance is followed by all its children and
+   // the nets of an instance come before its children
+
+   const netgroup_t *ga = &(groups[*(const groupid_t *)a]);
+   const netgroup_t *gb = &(groups[*(const groupid_t *)b]);
+
+   const char *pa = istr(tree_ident(rt_cold(ga)->sig_decl));
+   const char *pb = istr(tree_ident(rt_cold(gb)->sig_decl));
+
+   const char *ea = strrchr(pa, ':'), *eb = strrchr(pb, ':');
+
+   for (; pa < ea && pb < eb; pa++, pb++) {
+      const int ca = (*pa == ':') ? 0 : (unsigned char)*pa;
+      const int cb = (*pb == ':') ? 0 : (unsigned char)*pb;
+      if (ca != cb)
+         return ca - cb;
+   }
+
+   if (pa != ea || pb != eb)
+      return (pa == ea) ? -1 : 1;
+
+   const int cmp = strcmp(ea, eb);
+   if (cmp != 0)
+      return cmp;
+   else
+      return (ga->first > gb->first) - (ga->first < gb->first);
+}
+
+static size_t rt_activity_common(const char *a, size_t alen,
+                                 const char *b, size_t blen)
+{
+   // Length of the longest common prefix of two instance paths which
+   // ends at a scope boundary
+
+   size_t common = 0;
+   for (size_t i = 0; ; i++) {
+      const bool aend = (i == alen || a[i] == ':');
+      const bool bend = (i == blen || b[i] == ':');
+      if (aend && bend)
+         common = i;
+
+      if (i == alen || i == blen || a[i] != b[i])
+         return common;
+   }
+}
+
+static void rt_activity_net(FILE *f, int indent, const netgroup_t *g,
+                            const group_act_t *act)
+{
+   tree_t decl = rt_cold(g)->sig_decl;
+   const char *name = strrchr(istr(tree_ident(decl)), ':') + 1;
+
+   type_t type = tree_type(decl);
+   const int offset = g->first - tree_net(decl, 0);
+
+   // Elements of one dimensional arrays are named by their index and
+   // anything else by the offset of the element in the signal
+   int64_t left = 0, dir = 1;
+   if (type_is_array(type) && type_dims(type) == 1
+       && !type_is_array(type_elem(type))) {
+      range_t r = type_dim(type, 0);
+      int64_t low, high;
+      range_bounds(r, &low, &high);
+      left = (r.kind == RANGE_TO) ? low : high;
+      dir  = (r.kind == RANGE_TO) ? 1 : -1;
+   }
+
+   for (int i = 0; i < g->length; i++) {
+      const act_elem_t *e = &(act->elems[i]);
+
+      uint64_t time[3];
+      memcpy(time, e->time, sizeof(time));
+      time[act->map[((const uint8_t *)g->resolved)[i]]] +=
+         now - e->last_change;
+
+      fprintf(f, "%*s(%s", indent, "", name);
+      if (type_is_array(type))
+         fprintf(f, "\\[%"PRIi64"\\]", left + dir * (offset + i));
+
+      fprintf(f, " (T0 %"PRIu64") (T1 %"PRIu64") (TX %"PRIu64")"
+              " (TC %"PRIu64"))\n", time[ACT_ZERO], time[ACT_ONE],
+              time[ACT_X], e->toggles);
+   }
+}
+
+static void rt_activity_write(const char *fname)
+{
+   // Write the switching activity in the Switching Activity Interchange
+   // Format with one INSTANCE scope for each level of the hierarchy
+
+   FILE *f = fopen(fname, "w");
+   if (f == NULL)
+      fatal_errno("%s", fname);
+
+   char tmbuf[64];
+   time_t t = time(NULL);
+   strftime(tmbuf, sizeof(tmbuf), "%a %b %d %T %Y", localtime(&t));
+
+   fprintf(f, "(SAIFILE\n(SAIFVERSION \"2.0\")\n(DIRECTION \"backward\")\n"
+           "(DATE \"%s\")\n(VENDOR \"nvc\")\n(PROGRAM_NAME \"nvc\")\n"
+           "(VERSION \""PACKAGE_VERSION"\")\n(DIVIDER / )\n"
+           "(TIMESCALE 1 fs)\n(DURATION %"PRIu64")\n", tmbuf, now);
+
+   const size_t ngroups = netdb_size(netdb);
+   groupid_t *gids = xmalloc(sizeof(groupid_t) * ngroups);
+   size_t count = 0;
+   for (size_t i = 0; i < ngroups; i++) {
+      if (group_act[i] != NULL)
+         gids[count++] = i;
+   }
+
+   qsort(gids, count, sizeof(groupid_t), rt_activity_cmp);
+
+   const char *scope = "";
+   size_t scope_len = 0;
+   int depth = 0;
+   bool in_net = false;
+
+   for (size_t i = 0; i < count; i++) {
+      const netgroup_t *g = &(groups[gids[i]]);
+
+      const char *path = istr(tree_ident(rt_cold(g)->sig_decl));
+      const size_t path_len = strrchr(path, ':') - path;
+
+      const size_t common =
+         rt_activity_common(scope, scope_len, path, path_len);
+
+      if (common != scope_len || common != path_len) {
+         if (in_net)
+            fprintf(f, "%*s)\n", depth * 2, "");
+         in_net = false;
+
+         for (size_t j = common; j < scope_len; j++) {
+            if (scope[j] == ':')
+               fprintf(f, "%*s)\n", --depth * 2, "");
+         }
+
+         for (size_t j = common; j < path_len; j++) {
+            if (path[j] != ':')
+               continue;
+
+            const char *name = path + j + 1;
+            const char *end = memchr(name, ':', path + path_len - name);
+            const int len = (end ? end : path + path_len) - name;
+            fprintf(f, "%*s(INSTANCE %.*s\n", depth++ * 2, "", len, name);
+         }
+
+         scope = path;
+         scope_len = path_len;
+      }
+
+      if (!in_net) {
+         fprintf(f, "%*s(NET\n", depth * 2, "");
+         in_net = true;
+      }
+
+      rt_activity_net(f, depth * 2 + 2, g, group_act[gids[i]]);
+   }
+
+   if (in_net)
+      fprintf(f, "%*s)\n", depth * 2, "");
+
+   while (depth > 0)
+      fprintf(f, "%*s)\n", --depth * 2, "");
+
+   fprintf(f, ")\n");
+
+   free(gids);
+
+   if (fclose(f) != 0)
+      fatal_errno("%s", fname);
 }
 
 static void rt_interrupt(void)
@@ -2208,6 +5020,8 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
    jit_bind_fn("_assert_fail", _assert_fail);
    jit_bind_fn("_vec_load", _vec_load);
    jit_bind_fn("_image", _image);
+   jit_bind_fn("_image_int", _image_int);
+   jit_bind_fn("_image_real", _image_real);
    jit_bind_fn("_debug_out", _debug_out);
    jit_bind_fn("_set_initial", _set_initial);
    jit_bind_fn("_file_open", _file_open);
@@ -2215,18 +5029,21 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
    jit_bind_fn("_file_write", _file_write);
    jit_bind_fn("_file_read", _file_read);
    jit_bind_fn("_endfile", _endfile);
+   jit_bind_fn("_nvc_textio_read_chunk", _nvc_textio_read_chunk);
    jit_bind_fn("_bounds_fail", _bounds_fail);
    jit_bind_fn("_bit_shift", _bit_shift);
    jit_bind_fn("_bit_vec_op", _bit_vec_op);
+   jit_bind_fn("_logic_vec_op", _logic_vec_op);
    jit_bind_fn("_test_net_flag", _test_net_flag);
    jit_bind_fn("_last_event", _last_event);
    jit_bind_fn("_div_zero", _div_zero);
    jit_bind_fn("_null_deref", _null_deref);
+   jit_bind_fn("_tmp_stack_ptr", _tmp_stack_ptr);
+   jit_bind_fn("_tmp_alloc_ptr", _tmp_alloc_ptr);
 
    trace_on = opt_get_int("rt_trace_en");
 
    event_stack     = rt_alloc_stack_new(sizeof(event_t), "event");
-   waveform_stack  = rt_alloc_stack_new(sizeof(waveform_t), "waveform");
    sens_list_stack = rt_alloc_stack_new(sizeof(sens_list_t), "sens_list");
    watch_stack     = rt_alloc_stack_new(sizeof(watch_t), "watch");
    callback_stack  = rt_alloc_stack_new(sizeof(callback_t), "callback");
@@ -2239,6 +5056,20 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
 
    global_tmp_alloc = 0;
 
+   const int nthreads = opt_get_int("rt-threads");
+   if (nthreads > 1 && n_workers == 0)
+      rt_start_workers(nthreads);
+
+   // Tracing uses shared format buffers so is incompatible with threads
+   parallel = (n_workers > 0) && !trace_on;
+
+   cycle_based = opt_get_int("cycle-based");
+   profiling   = opt_get_int("rt-profile");
+   pgo_collect = opt_get_str("pgo-collect");
+   activity_file = opt_get_str("activity");
+   stats_level = opt_get_int("rt-stats");
+   huge_pages  = opt_get_int("rt-huge-pages");
+
    rt_reset_coverage(top);
 
    nvc_rusage(&ready_rusage);
@@ -2246,12 +5077,23 @@ void rt_start_of_tool(tree_t top, tree_rd_ctx_t ctx)
 
 void rt_end_of_tool(tree_t top)
 {
+   rt_stop_workers();
+
+   if (profiling)
+      rt_profile_print();
+
+   if (pgo_collect != NULL)
+      rt_pgo_write(pgo_collect);
+
+   if (activity_file != NULL)
+      rt_activity_write(activity_file);
+
    rt_cleanup(top);
    rt_emit_coverage(top);
 
    jit_shutdown();
 
-   if (opt_get_int("rt-stats"))
+   if (stats_level != STATS_NONE)
       rt_stats_print();
 }
 
@@ -2259,10 +5101,18 @@ void rt_run_sim(uint64_t stop_time)
 {
    const int stop_delta = opt_get_int("stop-delta");
 
+   if (rt_detailed_stats()) {
+      cur_phase = PHASE_QUEUE;
+      phase_start = rt_prof_clock();
+   }
+
    rt_global_event(RT_START_OF_SIMULATION);
    while (!rt_stop_now(stop_time))
       rt_cycle(stop_delta);
    rt_global_event(RT_END_OF_SIMULATION);
+
+   if (rt_detailed_stats())
+      phase_ns[cur_phase] += rt_prof_clock() - phase_start;
 }
 
 static void rt_interactive_fatal(void)
@@ -2275,14 +5125,19 @@ void rt_run_interactive(uint64_t stop_time)
 {
    if (aborted)
       errorf("simulation has aborted and must be restarted");
-   else if ((heap_size(eventq_heap) == 0) && (delta_proc == NULL))
+   else if ((eventq_size(eventq_heap) == 0) && (delta_proc == NULL))
       warnf("no future simulation events");
    else {
       set_fatal_fn(rt_interactive_fatal);
 
+      // Cannot recover from a fatal error raised on a worker thread
+      const bool was_parallel = parallel;
+      parallel = false;
+
       if (setjmp(fatal_jmp) == 0)
          rt_run_sim(stop_time);
 
+      parallel = was_parallel;
       set_fatal_fn(NULL);
    }
 }
@@ -2294,6 +5149,106 @@ void rt_restart(tree_t top)
    aborted = false;
 }
 
+bool rt_checkpoint(void)
+{
+   // Returns true in the process which continues the simulation from
+   // the checkpoint or false if a checkpoint cannot be created
+
+   // The state of the simulation is spread across the kernel data
+   // structures, the generated code, and anything allocated on the heap
+   // by processes so the simplest complete snapshot is a copy-on-write
+   // fork. The original process keeps the checkpoint and waits while
+   // the child continues the simulation. If the child asks to restore
+   // a fresh copy is forked from the checkpoint.
+
+   if (n_workers > 0)
+      return false;   // Worker threads do not survive fork
+   else if (wave_enabled())
+      return false;   // Waveform writers cannot rewind their output
+
+   fflush(stdout);
+   fflush(stderr);
+
+   // Each copy shares the file offsets of the original so record the
+   // position of every file the design has open
+
+   for (unsigned i = 0; i < n_open_files; i++) {
+      open_file_t *of = &(open_files[i]);
+      if (of->write)
+         fflush(of->file);
+      of->offset = ftello(of->file);
+   }
+
+   for (;;) {
+      int fds[2];
+      if (pipe(fds) != 0)
+         fatal_errno("pipe");
+
+      const pid_t pid = fork();
+      if (pid < 0)
+         fatal_errno("fork");
+      else if (pid == 0) {
+         close(fds[0]);
+         if (checkpoint_fd != -1)
+            close(checkpoint_fd);
+         checkpoint_fd = fds[1];
+
+         // Discard anything written by a previous copy
+         for (unsigned i = 0; i < n_open_files; i++) {
+            open_file_t *of = &(open_files[i]);
+            if (of->write && ftruncate(fileno(of->file), of->offset) != 0)
+               fatal_errno("ftruncate");
+            if (fseeko(of->file, of->offset, SEEK_SET) != 0)
+               fatal_errno("fseeko");
+         }
+
+         return true;
+      }
+
+      close(fds[1]);
+
+      // The child handles interrupts while the checkpoint waits
+      signal(SIGINT, SIG_IGN);
+
+      int status;
+      while (waitpid(pid, &status, 0) != pid) {
+         if (errno != EINTR)
+            fatal_errno("waitpid");
+      }
+
+      char cmd;
+      const bool restore = (read(fds[0], &cmd, 1) == 1);
+      close(fds[0]);
+
+      if (!restore) {
+         // Output files and the terminal now belong to the child so
+         // exit without running any cleanup
+         if (WIFEXITED(status))
+            _exit(WEXITSTATUS(status));
+         else
+            _exit(EXIT_FAILURE);
+      }
+
+      notef("restoring checkpoint at %s", fmt_time(now));
+      fflush(stderr);
+   }
+}
+
+bool rt_restore(void)
+{
+   if (checkpoint_fd == -1)
+      return false;
+
+   fflush(stdout);
+   fflush(stderr);
+
+   const char cmd = 'R';
+   if (write(checkpoint_fd, &cmd, 1) != 1)
+      fatal_errno("write");
+
+   _exit(EXIT_SUCCESS);
+}
+
 void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user)
 {
    event_t *e = rt_alloc(event_stack);
@@ -2316,8 +5271,9 @@ watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
    if (fn == NULL) {
       // Find the first entry in the watch list and disable it
       for (watch_t *it = watches; it != NULL; it = it->chain_all) {
-         if ((it->signal == s) && (it->user_data == user)) {
-            it->pending = true;   // TODO: not a good way of doing this
+         if ((it->signal == s) && (it->user_data == user)
+             && (it->fn != NULL)) {
+            rt_clear_event_cb(it);
             break;
          }
       }
@@ -2351,6 +5307,28 @@ watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
    }
 }
 
+void rt_clear_event_cb(watch_t *w)
+{
+   // The watch itself is only freed at the end of the simulation as it
+   // may still be on the list of pending callbacks
+
+   for (int i = 0; i < w->n_groups; i++) {
+      watch_list_t **p = &(rt_cold(w->groups[i])->watching);
+      while (*p != NULL) {
+         if ((*p)->watch == w) {
+            watch_list_t *tmp = *p;
+            *p = tmp->next;
+            free(tmp);
+            break;
+         }
+         else
+            p = &((*p)->next);
+      }
+   }
+
+   w->fn = NULL;
+}
+
 void rt_set_global_cb(rt_event_t event, rt_event_fn_t fn, void *user)
 {
    assert(event < RT_LAST_EVENT);
@@ -2370,7 +5348,8 @@ size_t rt_watch_value(watch_t *w, uint64_t *buf, size_t max, bool last)
       netgroup_t *g = w->groups[i];
 
 #define SIGNAL_VALUE_EXPAND_U64(type) do {                              \
-         const type *sp = (type *)(last ? g->last_value : g->resolved); \
+         const type *sp =                                               \
+            (type *)(last ? rt_cold(g)->last_value : g->resolved);      \
          for (int j = 0; (j < g->length) && (offset + j < max); j++)    \
             buf[offset + j] = sp[j];                                    \
       } while (0)
@@ -2408,6 +5387,55 @@ static size_t rt_group_string(netgroup_t *group, const char *map,
    return bp - buf;
 }
 
+size_t rt_watch_bytes(watch_t *w)
+{
+   size_t bytes = 0;
+   for (int i = 0; i < w->n_groups; i++)
+      bytes += w->groups[i]->size * w->groups[i]->length;
+
+   return bytes;
+}
+
+void rt_watch_copy(watch_t *w, void *buf)
+{
+   // Copy the raw resolved values of all the watched groups so they can
+   // be formatted later without access to the kernel state
+
+   uint8_t *p = buf;
+   for (int i = 0; i < w->n_groups; i++) {
+      const netgroup_t *g = w->groups[i];
+      const size_t valuesz = g->size * g->length;
+      memcpy(p, g->resolved, valuesz);
+      p += valuesz;
+   }
+}
+
+void rt_watch_force(watch_t *w, const void *buf, bool propagate)
+{
+   // Inverse of rt_watch_copy: force every watched group to the raw
+   // values packed in buf
+
+   assert(!propagate || can_create_delta);
+
+   const uint8_t *p = buf;
+   for (int i = 0; i < w->n_groups; i++) {
+      netgroup_t *g = w->groups[i];
+      const size_t valuesz = g->size * g->length;
+
+      g->flags |= NET_F_FORCED;
+
+      netgroup_cold_t *cold = rt_cold(g);
+      if (cold->forcing == NULL)
+         cold->forcing = rt_alloc_value(g);
+
+      memcpy(cold->forcing->data, p, valuesz);
+      p += valuesz;
+
+      if (propagate)
+         deltaq_insert_driver(0, g, -1);
+   }
+}
+
 size_t rt_watch_string(watch_t *w, const char *map, char *buf, size_t max)
 {
    char *bp = buf;
@@ -2474,11 +5502,12 @@ bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
 
       g->flags |= NET_F_FORCED;
 
-      if (g->forcing == NULL)
-         g->forcing = rt_alloc_value(g);
+      netgroup_cold_t *cold = rt_cold(g);
+      if (cold->forcing == NULL)
+         cold->forcing = rt_alloc_value(g);
 
 #define SIGNAL_FORCE_EXPAND_U64(type) do {                              \
-         type *dp = (type *)g->forcing->data;                           \
+         type *dp = (type *)cold->forcing->data;                           \
          for (int i = 0; (i < g->length) && (offset + i < count); i++)  \
             dp[i] = buf[offset + i];                                    \
       } while (0)
@@ -2486,7 +5515,7 @@ bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
       FOR_ALL_SIZES(g->size, SIGNAL_FORCE_EXPAND_U64);
 
       if (propagate)
-         deltaq_insert_driver(0, g, NULL);
+         deltaq_insert_driver(0, g, -1);
 
       offset += g->length;
    }
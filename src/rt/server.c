@@ -0,0 +1,468 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "rt.h"
+#include "tree.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Binary protocol for driving a simulation from another process. Every
+// request and response starts with a header giving the operation or
+// status and the length of the payload that follows. All integers are
+// in host byte order as the client is expected to run on the same
+// machine. Signals are looked up once by name and then referred to by
+// an integer handle. Values are arrays of 64-bit integers with one
+// element per scalar sub-element as returned by rt_signal_value.
+
+typedef enum {
+   SERVER_LOOKUP  = 1,   // name -> u32 handle, u32 count
+   SERVER_READ    = 2,   // u32 handle... -> u64 value...
+   SERVER_FORCE   = 3,   // u32 handle, u64 value... -> nothing
+   SERVER_RUN     = 4,   // u64 fs (0 = forever) -> u64 now, u32 handle...
+   SERVER_WATCH   = 5,   // u32 handle... -> nothing
+   SERVER_UNWATCH = 6,   // u32 handle... -> nothing
+   SERVER_NOW     = 7,   // nothing -> u64 now
+   SERVER_QUIT    = 8    // nothing -> nothing
+} server_op_t;
+
+typedef enum {
+   SERVER_OK,
+   SERVER_ERROR          // Payload is the error message
+} server_status_t;
+
+typedef struct {
+   uint8_t  code;
+   uint8_t  pad[3];
+   uint32_t length;
+} server_hdr_t;
+
+typedef struct {
+   tree_t   decl;
+   uint32_t count;
+   watch_t *watch;
+   bool     changed;
+} server_sig_t;
+
+typedef struct {
+   uint8_t *data;
+   size_t   len;
+   size_t   max;
+} server_buf_t;
+
+static server_sig_t *sigs = NULL;
+static unsigned      n_sigs = 0;
+static unsigned      max_sigs = 0;
+static hash_t       *sig_hash = NULL;
+static uint32_t     *changed = NULL;
+static unsigned      n_changed = 0;
+static server_buf_t  req;
+static server_buf_t  resp;
+static char         *error_msg = NULL;
+
+static void server_reserve(server_buf_t *b, size_t len)
+{
+   if (b->len + len > b->max) {
+      b->max = MAX(b->max * 2, b->len + len);
+      b->data = xrealloc(b->data, b->max);
+   }
+}
+
+static void server_put(server_buf_t *b, const void *data, size_t len)
+{
+   server_reserve(b, len);
+   memcpy(b->data + b->len, data, len);
+   b->len += len;
+}
+
+__attribute__((format(printf, 1, 2)))
+static bool server_error(const char *fmt, ...)
+{
+   va_list ap;
+   va_start(ap, fmt);
+   free(error_msg);
+   error_msg = xvasprintf(fmt, ap);
+   va_end(ap);
+
+   return false;
+}
+
+static bool server_read_all(int fd, void *buf, size_t len)
+{
+   uint8_t *p = buf;
+   while (len > 0) {
+      const ssize_t n = read(fd, p, len);
+      if (n == 0)
+         return false;
+      else if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         fatal_errno("read");
+      }
+
+      p += n;
+      len -= n;
+   }
+
+   return true;
+}
+
+static void server_write_all(int fd, const void *buf, size_t len)
+{
+   const uint8_t *p = buf;
+   while (len > 0) {
+      const ssize_t n = write(fd, p, len);
+      if (n < 0) {
+         if (errno == EINTR)
+            continue;
+         fatal_errno("write");
+      }
+
+      p += n;
+      len -= n;
+   }
+}
+
+static void server_watch_cb(uint64_t now, tree_t decl, watch_t *w,
+                            void *user)
+{
+   const uint32_t handle = (uintptr_t)user;
+   if (!sigs[handle].changed) {
+      sigs[handle].changed = true;
+      changed[n_changed++] = handle;
+   }
+}
+
+static bool server_get_handles(const uint8_t *p, size_t len,
+                               const uint32_t **handles, size_t *count)
+{
+   if (len % sizeof(uint32_t) != 0)
+      return server_error("payload of %zu bytes is not a list of handles",
+                          len);
+
+   *handles = (const uint32_t *)p;
+   *count = len / sizeof(uint32_t);
+
+   for (size_t i = 0; i < *count; i++) {
+      if ((*handles)[i] >= n_sigs)
+         return server_error("invalid handle %u", (*handles)[i]);
+   }
+
+   return true;
+}
+
+static bool server_lookup(hash_t *decl_hash, const uint8_t *p, size_t len)
+{
+   char *name LOCAL = xmalloc(len + 1);
+   memcpy(name, p, len);
+   name[len] = '\0';
+
+   ident_t id = ident_new(name);
+
+   void *found = hash_get(sig_hash, id);
+   uint32_t handle;
+   if (found != NULL)
+      handle = (uintptr_t)found - 1;
+   else {
+      tree_t decl = hash_get(decl_hash, id);
+      if (decl == NULL || tree_kind(decl) != T_SIGNAL_DECL)
+         return server_error("signal not found: %s", name);
+
+      if (n_sigs == max_sigs) {
+         max_sigs = MAX(max_sigs * 2, 64);
+         sigs = xrealloc(sigs, max_sigs * sizeof(server_sig_t));
+         changed = xrealloc(changed, max_sigs * sizeof(uint32_t));
+      }
+
+      handle = n_sigs++;
+      sigs[handle].decl    = decl;
+      sigs[handle].count   = tree_nets(decl);
+      sigs[handle].watch   = NULL;
+      sigs[handle].changed = false;
+
+      hash_put(sig_hash, id, (void *)(uintptr_t)(handle + 1));
+   }
+
+   server_put(&resp, &handle, sizeof(uint32_t));
+   server_put(&resp, &(sigs[handle].count), sizeof(uint32_t));
+   return true;
+}
+
+static bool server_read(const uint8_t *p, size_t len)
+{
+   const uint32_t *handles;
+   size_t count;
+   if (!server_get_handles(p, len, &handles, &count))
+      return false;
+
+   for (size_t i = 0; i < count; i++) {
+      const server_sig_t *s = &(sigs[handles[i]]);
+      const size_t bytes = s->count * sizeof(uint64_t);
+      server_reserve(&resp, bytes);
+
+      uint64_t *values = (uint64_t *)(resp.data + resp.len);
+      rt_signal_value(s->decl, values, s->count);
+      resp.len += bytes;
+   }
+
+   return true;
+}
+
+static bool server_force(const uint8_t *p, size_t len)
+{
+   if (len < sizeof(uint32_t))
+      return server_error("missing handle for force");
+
+   uint32_t handle;
+   memcpy(&handle, p, sizeof(uint32_t));
+   if (handle >= n_sigs)
+      return server_error("invalid handle %u", handle);
+
+   const server_sig_t *s = &(sigs[handle]);
+   if (len - sizeof(uint32_t) != s->count * sizeof(uint64_t))
+      return server_error("expected %u values to force %s", s->count,
+                          istr(tree_ident(s->decl)));
+
+   uint64_t *values LOCAL = xmalloc(s->count * sizeof(uint64_t));
+   memcpy(values, p + sizeof(uint32_t), s->count * sizeof(uint64_t));
+
+   rt_force_signal(s->decl, values, s->count, rt_can_create_delta());
+   return true;
+}
+
+static bool server_run_for(const uint8_t *p, size_t len)
+{
+   if (len != sizeof(uint64_t))
+      return server_error("expected time for run");
+
+   uint64_t delta;
+   memcpy(&delta, p, sizeof(uint64_t));
+
+   const uint64_t start = rt_now(NULL);
+   const uint64_t stop_time =
+      (delta == 0 || delta > UINT64_MAX - start) ? UINT64_MAX : start + delta;
+
+   rt_run_interactive(stop_time);
+
+   const uint64_t now = rt_now(NULL);
+   server_put(&resp, &now, sizeof(uint64_t));
+   server_put(&resp, changed, n_changed * sizeof(uint32_t));
+
+   for (unsigned i = 0; i < n_changed; i++)
+      sigs[changed[i]].changed = false;
+   n_changed = 0;
+
+   return true;
+}
+
+static bool server_watch(const uint8_t *p, size_t len, bool enable)
+{
+   const uint32_t *handles;
+   size_t count;
+   if (!server_get_handles(p, len, &handles, &count))
+      return false;
+
+   for (size_t i = 0; i < count; i++) {
+      server_sig_t *s = &(sigs[handles[i]]);
+      if (enable && s->watch == NULL)
+         s->watch = rt_set_event_cb(s->decl, server_watch_cb,
+                                    (void *)(uintptr_t)handles[i], true);
+      else if (!enable && s->watch != NULL) {
+         rt_clear_event_cb(s->watch);
+         s->watch = NULL;
+      }
+   }
+
+   return true;
+}
+
+static bool server_dispatch(hash_t *decl_hash, server_op_t op,
+                            const uint8_t *p, size_t len)
+{
+   switch (op) {
+   case SERVER_LOOKUP:
+      return server_lookup(decl_hash, p, len);
+   case SERVER_READ:
+      return server_read(p, len);
+   case SERVER_FORCE:
+      return server_force(p, len);
+   case SERVER_RUN:
+      return server_run_for(p, len);
+   case SERVER_WATCH:
+      return server_watch(p, len, true);
+   case SERVER_UNWATCH:
+      return server_watch(p, len, false);
+   case SERVER_NOW:
+      {
+         const uint64_t now = rt_now(NULL);
+         server_put(&resp, &now, sizeof(uint64_t));
+         return true;
+      }
+   default:
+      return server_error("invalid request %d", op);
+   }
+}
+
+static int server_listen(const char *addr)
+{
+   const char *p = addr;
+   while (isdigit((int)*p))
+      p++;
+
+   const bool tcp = (*p == '\0' && p != addr);
+
+   int sock;
+   if (tcp) {
+      // A port number listens on the loopback interface only
+      const long port = strtol(addr, NULL, 10);
+      if (port <= 0 || port > 65535)
+         fatal("invalid port number %s", addr);
+
+      if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+         fatal_errno("socket");
+
+      const int one = 1;
+      setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      struct sockaddr_in sin;
+      memset(&sin, '\0', sizeof(sin));
+      sin.sin_family      = AF_INET;
+      sin.sin_port        = htons(port);
+      sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      if (bind(sock, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+         fatal_errno("cannot bind to port %ld", port);
+   }
+   else {
+      struct sockaddr_un sun;
+      memset(&sun, '\0', sizeof(sun));
+      sun.sun_family = AF_UNIX;
+
+      if (strlen(addr) >= sizeof(sun.sun_path))
+         fatal("socket path %s is too long", addr);
+      strcpy(sun.sun_path, addr);
+
+      if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+         fatal_errno("socket");
+
+      unlink(addr);
+      if (bind(sock, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+         fatal_errno("cannot bind to %s", addr);
+   }
+
+   if (listen(sock, 1) < 0)
+      fatal_errno("listen");
+
+   notef("waiting for connection on %s", addr);
+
+   int fd;
+   while ((fd = accept(sock, NULL, NULL)) < 0) {
+      if (errno != EINTR)
+         fatal_errno("accept");
+   }
+
+   close(sock);
+
+   if (tcp) {
+      // Requests and responses are small so do not wait to coalesce them
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   }
+
+   return fd;
+}
+
+void server_run(tree_t e, const char *addr)
+{
+   const int ndecls = tree_decls(e);
+   hash_t *decl_hash = hash_new(ndecls * 2, true);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(e, i);
+      hash_put(decl_hash, tree_ident(d), d);
+   }
+
+   sig_hash = hash_new(256, true);
+
+   const int fd = server_listen(addr);
+
+   server_hdr_t hdr;
+   while (server_read_all(fd, &hdr, sizeof(hdr))) {
+      req.len = 0;
+      server_reserve(&req, hdr.length);
+      if (!server_read_all(fd, req.data, hdr.length))
+         break;
+
+      if (hdr.code == SERVER_QUIT)
+         break;
+
+      // Leave space for the response header
+      resp.len = 0;
+      server_reserve(&resp, sizeof(server_hdr_t));
+      resp.len = sizeof(server_hdr_t);
+
+      server_hdr_t *rhdr = (server_hdr_t *)resp.data;
+      if (server_dispatch(decl_hash, hdr.code, req.data, hdr.length)) {
+         rhdr = (server_hdr_t *)resp.data;
+         rhdr->code = SERVER_OK;
+      }
+      else {
+         resp.len = sizeof(server_hdr_t);
+         server_put(&resp, error_msg, strlen(error_msg));
+         rhdr = (server_hdr_t *)resp.data;
+         rhdr->code = SERVER_ERROR;
+      }
+
+      memset(rhdr->pad, '\0', sizeof(rhdr->pad));
+      rhdr->length = resp.len - sizeof(server_hdr_t);
+
+      server_write_all(fd, resp.data, resp.len);
+   }
+
+   close(fd);
+
+   for (unsigned i = 0; i < n_sigs; i++) {
+      if (sigs[i].watch != NULL)
+         rt_clear_event_cb(sigs[i].watch);
+   }
+
+   free(sigs);
+   free(changed);
+   free(req.data);
+   free(resp.data);
+   free(error_msg);
+   hash_free(sig_hash);
+   hash_free(decl_hash);
+
+   sigs = NULL;
+   changed = NULL;
+   n_sigs = max_sigs = n_changed = 0;
+   memset(&req, '\0', sizeof(req));
+   memset(&resp, '\0', sizeof(resp));
+   error_msg = NULL;
+}
@@ -99,6 +99,45 @@ static int shell_cmd_restart(ClientData cd, Tcl_Interp *interp,
    return TCL_OK;
 }
 
+static int shell_cmd_checkpoint(ClientData cd, Tcl_Interp *interp,
+                                int objc, Tcl_Obj *const objv[])
+{
+   const char *help =
+      "checkpoint - Save the current simulation state\n"
+      "\n"
+      "Usage: checkpoint\n"
+      "\n"
+      "A later restore command returns the simulation to this point.\n"
+      "Only the most recent checkpoint can be restored.\n";
+
+   if (show_help(objc, objv, help))
+      return TCL_OK;
+
+   if (!rt_checkpoint())
+      return tcl_error(interp, "checkpoints cannot be used with multiple "
+                       "threads or waveform dumping");
+
+   printf("Checkpoint at %s\n", fmt_time(rt_now(NULL)));
+   return TCL_OK;
+}
+
+static int shell_cmd_restore(ClientData cd, Tcl_Interp *interp,
+                             int objc, Tcl_Obj *const objv[])
+{
+   const char *help =
+      "restore - Return to the most recent checkpoint\n"
+      "\n"
+      "Usage: restore\n";
+
+   if (show_help(objc, objv, help))
+      return TCL_OK;
+
+   if (!rt_restore())
+      return tcl_error(interp, "no checkpoint to restore");
+
+   return TCL_OK;
+}
+
 static int shell_cmd_run(ClientData cd, Tcl_Interp *interp,
                          int objc, Tcl_Obj *const objv[])
 {
@@ -512,6 +551,8 @@ void shell_run(tree_t e, struct tree_rd_ctx *ctx)
       CMD(quit,      NULL,       "Exit simulation"),
       CMD(run,       NULL,       "Start or resume simulation"),
       CMD(restart,   e,          "Restart simulation"),
+      CMD(checkpoint, NULL,      "Save the current simulation state"),
+      CMD(restore,   NULL,       "Return to the most recent checkpoint"),
       CMD(show,      decl_hash,  "Display simulation objects"),
       CMD(help,      shell_cmds, "Display this message"),
       CMD(copyright, NULL,       "Display copyright information"),
@@ -531,6 +572,11 @@ void shell_run(tree_t e, struct tree_rd_ctx *ctx)
 
    show_banner();
 
+   // A restored checkpoint shares the offset of standard input with the
+   // copy it replaces so must not read ahead into a private buffer
+   if (!isatty(fileno(stdin)))
+      setvbuf(stdin, NULL, _IONBF, 0);
+
    char *line;
    while ((line = shell_get_line())) {
       switch (Tcl_Eval(interp, line)) {
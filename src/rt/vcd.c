@@ -25,13 +25,22 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define VCD_BUF_SZ (1 << 20)
 
 typedef struct vcd_data vcd_data_t;
 
-typedef void (*vcd_fmt_fn_t)(tree_t, watch_t *, vcd_data_t *);
+typedef void (*vcd_fmt_fn_t)(watch_t *, vcd_data_t *);
 
 struct vcd_data {
    char          key[64];
+   char          tail[68];
+   size_t        tail_len;
    vcd_fmt_fn_t  fmt;
    range_kind_t  dir;
    const char   *map;
@@ -39,43 +48,176 @@ struct vcd_data {
    watch_t      *watch;
 };
 
-static FILE    *vcd_file;
-static tree_t   vcd_top;
-static ident_t  vcd_data_i;
-static uint64_t last_time;
+static char     *vcd_fname;
+static int       vcd_fd = -1;
+static gzFile    vcd_gz = NULL;
+static char     *vcd_buf;
+static size_t    vcd_len;
+static tree_t    vcd_top;
+static ident_t   vcd_data_i;
+static uint64_t  last_time;
+static bool      vcd_restarted = false;
+
+// All output is collected in a private buffer and written with a single
+// system call when it fills so formatting a value change never goes
+// through stdio
+
+static void vcd_flush(void)
+{
+   if (vcd_gz != NULL) {
+      if (vcd_len > 0 && gzwrite(vcd_gz, vcd_buf, vcd_len) != (int)vcd_len)
+         fatal("failed writing VCD output %s", vcd_fname);
+   }
+   else {
+      const char *p = vcd_buf;
+      size_t left = vcd_len;
+      while (left > 0) {
+         const ssize_t n = write(vcd_fd, p, left);
+         if (n < 0 && errno == EINTR)
+            continue;
+         else if (n < 0)
+            fatal_errno("failed writing VCD output %s", vcd_fname);
+
+         p += n;
+         left -= n;
+      }
+   }
+
+   vcd_len = 0;
+}
+
+static inline char *vcd_reserve(size_t n)
+{
+   assert(n <= VCD_BUF_SZ);
+
+   if (unlikely(vcd_len + n > VCD_BUF_SZ))
+      vcd_flush();
+
+   return vcd_buf + vcd_len;
+}
+
+static inline void vcd_put(const char *str, size_t len)
+{
+   memcpy(vcd_reserve(len), str, len);
+   vcd_len += len;
+}
+
+static void vcd_printf(const char *fmt, ...)
+{
+   // Only used for the header and declarations
+
+   va_list ap;
+   va_start(ap, fmt);
+   int n = vsnprintf(vcd_buf + vcd_len, VCD_BUF_SZ - vcd_len, fmt, ap);
+   va_end(ap);
+
+   if ((size_t)n >= VCD_BUF_SZ - vcd_len) {
+      vcd_flush();
+
+      va_start(ap, fmt);
+      n = vsnprintf(vcd_buf, VCD_BUF_SZ, fmt, ap);
+      va_end(ap);
+
+      if (n >= VCD_BUF_SZ)
+         fatal("VCD output line too long");
+   }
+
+   vcd_len += n;
+}
 
-static void vcd_fmt_int(tree_t decl, watch_t *w, vcd_data_t *data)
+static void vcd_open(void)
 {
+   const size_t len = strlen(vcd_fname);
+   if (len > 3 && strcmp(vcd_fname + len - 3, ".gz") == 0) {
+      if ((vcd_gz = gzopen(vcd_fname, "wb")) == NULL)
+         fatal_errno("failed to open VCD output %s", vcd_fname);
+   }
+   else {
+      vcd_fd = open(vcd_fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (vcd_fd < 0)
+         fatal_errno("failed to open VCD output %s", vcd_fname);
+   }
+}
+
+static void vcd_close(void)
+{
+   vcd_flush();
+
+   if (vcd_gz != NULL) {
+      gzclose(vcd_gz);
+      vcd_gz = NULL;
+   }
+   else {
+      close(vcd_fd);
+      vcd_fd = -1;
+   }
+}
+
+static void vcd_fmt_int(watch_t *w, vcd_data_t *data)
+{
+   const size_t bytes = rt_watch_bytes(w);
+   assert(bytes <= sizeof(uint64_t));
+
+   union {
+      uint8_t  u8;
+      uint16_t u16;
+      uint32_t u32;
+      uint64_t u64;
+   } raw;
+   rt_watch_copy(w, &raw);
+
    uint64_t val;
-   rt_watch_value(w, &val, 1, false);
+   switch (bytes) {
+   case 1: val = raw.u8; break;
+   case 2: val = raw.u16; break;
+   case 4: val = raw.u32; break;
+   default: val = raw.u64; break;
+   }
 
-   char buf[data->size + 1];
+   char *p = vcd_reserve(data->size + 1 + data->tail_len);
+   *p++ = 'b';
    for (size_t i = 0; i < data->size; i++)
-      buf[data->size - 1 - i] = (val & (1 << i)) ? '1' : '0';
-   buf[data->size] = '\0';
+      p[data->size - 1 - i] = (val & (UINT64_C(1) << i)) ? '1' : '0';
+   memcpy(p + data->size, data->tail, data->tail_len);
 
-   fprintf(vcd_file, "b%s %s\n", buf, data->key);
+   vcd_len += data->size + 1 + data->tail_len;
 }
 
-static void vcd_fmt_chars(tree_t decl, watch_t *w, vcd_data_t *data)
+static void vcd_fmt_chars(watch_t *w, vcd_data_t *data)
 {
-   const int nvals = data->size;
-   char buf[nvals + 1];
-   rt_watch_string(w, data->map, buf, nvals + 1);
+   const size_t nvals = rt_watch_bytes(w);
+   uint8_t raw[nvals];
+   rt_watch_copy(w, raw);
+
+   vcd_put("b", 1);
+
+   // Arrays wider than the buffer are written in several pieces
+   const uint8_t *vp = raw, *end = raw + nvals;
+   while (vp < end) {
+      const size_t chunk = MIN(end - vp, VCD_BUF_SZ / 2);
+      char *p = vcd_reserve(chunk);
+      for (size_t i = 0; i < chunk; i++)
+         p[i] = data->map[vp[i]];
+      vcd_len += chunk;
+      vp += chunk;
+   }
 
-   fprintf(vcd_file, "b%s %s\n", buf, data->key);
+   vcd_put(data->tail, data->tail_len);
 }
 
-static void vcd_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
+static void vcd_time_cb(uint64_t now)
 {
    if (now != last_time) {
-      fprintf(vcd_file, "#%"PRIu64"\n", now);
+      char *p = vcd_reserve(32);
+      vcd_len += checked_sprintf(p, 32, "#%"PRIu64"\n", now);
       last_time = now;
    }
+}
 
+static void vcd_value_cb(watch_t *w, void *user)
+{
    vcd_data_t *data = user;
-   if (likely(data != NULL))
-      (*data->fmt)(decl, w, data);
+   (*data->fmt)(w, data);
 }
 
 static void vcd_key_fmt(int key, char *buf)
@@ -90,16 +232,23 @@ static void vcd_key_fmt(int key, char *buf)
 
 static void vcd_emit_header(void)
 {
-   rewind(vcd_file);
+   if (vcd_restarted) {
+      // Discard anything written by a previous run
+      vcd_len = 0;
+      vcd_close();
+      vcd_open();
+   }
+
+   vcd_restarted = true;
 
    char tmbuf[64];
    time_t t = time(NULL);
    struct tm *tm = localtime(&t);
    strftime(tmbuf, sizeof(tmbuf), "%a, %d %b %Y %T %z", tm);
-   fprintf(vcd_file, "$date\n  %s\n$end\n", tmbuf);
+   vcd_printf("$date\n  %s\n$end\n", tmbuf);
 
-   fprintf(vcd_file, "$version\n  "PACKAGE_STRING"\n$end\n");
-   fprintf(vcd_file, "$timescale\n  1 fs\n$end\n");
+   vcd_printf("$version\n  "PACKAGE_STRING"\n$end\n");
+   vcd_printf("$timescale\n  1 fs\n$end\n");
 }
 
 static bool vcd_can_fmt_chars(type_t type, vcd_data_t *data)
@@ -193,11 +342,13 @@ static void vcd_process_signal(tree_t d, int *next_key)
 
    tree_add_attr_ptr(d, vcd_data_i, data);
 
-   data->watch = rt_set_event_cb(d, vcd_event_cb, data, true);
+   data->watch = wave_watch(d, data);
 
    vcd_key_fmt(*next_key, data->key);
+   data->tail_len = checked_sprintf(data->tail, sizeof(data->tail),
+                                    " %s\n", data->key);
 
-   fprintf(vcd_file, "$var reg %d %s %s $end\n",
+   vcd_printf("$var reg %d %s %s $end\n",
            (int)data->size, data->key, name);
 
    ++(*next_key);
@@ -205,7 +356,7 @@ static void vcd_process_signal(tree_t d, int *next_key)
 
 void vcd_restart(void)
 {
-   if (vcd_file == NULL)
+   if (vcd_fname == NULL)
       return;
 
    vcd_emit_header();
@@ -216,7 +367,7 @@ void vcd_restart(void)
       tree_t d = tree_decl(vcd_top, i);
       switch (tree_kind(d)) {
       case T_HIER:
-         fprintf(vcd_file, "$scope module %s $end\n", istr(tree_ident(d)));
+         vcd_printf("$scope module %s $end\n", istr(tree_ident(d)));
          break;
       case T_SIGNAL_DECL:
          if (wave_should_dump(d))
@@ -228,25 +379,26 @@ void vcd_restart(void)
 
       int npop = tree_attr_int(d, ident_new("scope_pop"), 0);
       while (npop-- > 0)
-         fprintf(vcd_file, "$upscope $end\n");
+         vcd_printf("$upscope $end\n");
    }
 
-   fprintf(vcd_file, "$enddefinitions $end\n");
+   vcd_printf("$enddefinitions $end\n");
 
-   fprintf(vcd_file, "$dumpvars\n");
+   vcd_printf("$dumpvars\n");
 
    last_time = UINT64_MAX;
+   vcd_time_cb(0);
 
    for (int i = 0; i < ndecls; i++) {
       tree_t d = tree_decl(vcd_top, i);
       if (tree_kind(d) == T_SIGNAL_DECL) {
          vcd_data_t *data = tree_attr_ptr(d, vcd_data_i);
-         if (likely(data != NULL))
-            vcd_event_cb(0, d, data->watch, data);
+         if (likely(data != NULL) && data->watch != NULL)
+            vcd_value_cb(data->watch, data);
       }
    }
 
-   fprintf(vcd_file, "$end\n");
+   vcd_printf("$end\n");
 }
 
 void vcd_init(const char *filename, tree_t top)
@@ -260,7 +412,13 @@ void vcd_init(const char *filename, tree_t top)
          "designs. If you are using GtkWave the --wave option will generate "
          "an FST file that overcomes these limitations.");
 
-   vcd_file = fopen(filename, "w");
-   if (vcd_file == NULL)
-      fatal_errno("failed to open VCD output %s", filename);
+   vcd_fname = strdup(filename);
+   vcd_buf   = xmalloc(VCD_BUF_SZ);
+   vcd_len   = 0;
+
+   vcd_open();
+
+   atexit(vcd_close);
+
+   wave_set_emitter(vcd_time_cb, vcd_value_cb);
 }
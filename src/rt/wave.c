@@ -19,6 +19,8 @@
 #include "util.h"
 #include "tree.h"
 
+#include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 typedef struct {
@@ -26,6 +28,12 @@ typedef struct {
    size_t len;
 } glob_t;
 
+typedef struct {
+   tree_t   decl;
+   watch_t *watch;
+   void    *user;
+} wave_entry_t;
+
 static int     n_incl = 0;
 static int     incl_sz = 0;
 static int     n_excl = 0;
@@ -33,6 +41,67 @@ static int     excl_sz = 0;
 static glob_t *incl;
 static glob_t *excl;
 
+// All the include and exclude patterns are compiled into a single
+// automaton that classifies a name in one pass over its characters. NFA
+// state i means the first part of some pattern has been matched up to
+// nfa_char[i] and the DFA states are built lazily from sets of these.
+// As with ident_glob a '*' matches one or more characters.
+
+#define DFA_MATCH_INCL  (1 << 0)
+#define DFA_MATCH_EXCL  (1 << 1)
+#define DFA_MAX_STATES  4096
+
+typedef struct {
+   int     *set;
+   int      nset;
+   unsigned hash;
+   uint8_t  flags;
+   int      next[256];
+} dfa_state_t;
+
+static char         *nfa_char = NULL;
+static uint8_t      *nfa_flags = NULL;
+static int           nfa_size = 0;
+static unsigned     *nfa_mark = NULL;
+static unsigned      nfa_gen = 0;
+static dfa_state_t **dfa = NULL;
+static int           dfa_nstates = 0;
+static int           dfa_max = 0;
+static int          *dfa_hash = NULL;
+static int           dfa_hash_sz = 0;
+static int           dfa_start = -1;
+static bool          dfa_valid = false;
+
+// Value changes are not written as each watch fires but collected in a
+// bitmap and emitted in index order by the kernel after the postponed
+// callbacks for a time step have run.
+// Only the settled value at the end of the time step is sampled so any
+// glitches across delta cycles are collapsed into a single change.
+
+static wave_entry_t   *entries = NULL;
+static int             n_entries = 0;
+static int             entries_sz = 0;
+static uint64_t       *dirty = NULL;
+static bool            any_dirty = false;
+static wave_time_fn_t  time_fn = NULL;
+static wave_emit_fn_t  emit_fn = NULL;
+static uint64_t        window_start = 0;
+static uint64_t        window_stop = UINT64_MAX;
+static bool            window_open = false;
+static int             max_depth = -1;
+
+static int wave_depth(tree_t decl)
+{
+   // Hierarchical names have the form :top:inst:...:name
+   int depth = -2;
+   for (const char *p = istr(tree_ident(decl)); *p != '\0'; p++) {
+      if (*p == ':')
+         depth++;
+   }
+
+   return depth;
+}
+
 void wave_include_glob(const char *glob)
 {
    if (n_incl == incl_sz) {
@@ -44,6 +113,7 @@ void wave_include_glob(const char *glob)
    incl[n_incl].len  = strlen(glob);
 
    n_incl++;
+   dfa_valid = false;
 }
 
 void wave_exclude_glob(const char *glob)
@@ -57,6 +127,7 @@ void wave_exclude_glob(const char *glob)
    excl[n_excl].len  = strlen(glob);
 
    n_excl++;
+   dfa_valid = false;
 }
 
 static void wave_process_file(const char *fname, bool include)
@@ -102,19 +173,338 @@ void wave_include_file(const char *base)
    wave_process_file(buf, false);
 }
 
+void wave_set_depth(int depth)
+{
+   max_depth = depth;
+}
+
+void wave_set_window(uint64_t start, uint64_t stop)
+{
+   window_start = start;
+   window_stop  = stop;
+}
+
+static unsigned dfa_hash_set(const int *set, int nset)
+{
+   unsigned h = 2166136261u;
+   for (int i = 0; i < nset; i++)
+      h = (h ^ set[i]) * 16777619u;
+   return h;
+}
+
+static void dfa_reset(void)
+{
+   for (int i = 0; i < dfa_nstates; i++) {
+      free(dfa[i]->set);
+      free(dfa[i]);
+   }
+   dfa_nstates = 0;
+
+   for (int i = 0; i < dfa_hash_sz; i++)
+      dfa_hash[i] = -1;
+
+   dfa_start = -1;
+}
+
+static void dfa_insert_hash(int index)
+{
+   const unsigned mask = dfa_hash_sz - 1;
+   for (unsigned slot = dfa[index]->hash & mask;; slot = (slot + 1) & mask) {
+      if (dfa_hash[slot] < 0) {
+         dfa_hash[slot] = index;
+         break;
+      }
+   }
+}
+
+static int dfa_lookup(int *set, int nset)
+{
+   // Returns the index of the DFA state with this set of NFA states
+   // taking ownership of set
+
+   const unsigned hash = dfa_hash_set(set, nset);
+   const unsigned mask = dfa_hash_sz - 1;
+
+   for (unsigned slot = hash & mask; dfa_hash_sz > 0;
+        slot = (slot + 1) & mask) {
+      const int index = dfa_hash[slot];
+      if (index < 0)
+         break;
+
+      dfa_state_t *d = dfa[index];
+      if (d->hash == hash && d->nset == nset
+          && memcmp(d->set, set, nset * sizeof(int)) == 0) {
+         free(set);
+         return index;
+      }
+   }
+
+   dfa_state_t *d = xmalloc(sizeof(dfa_state_t));
+   d->set   = set;
+   d->nset  = nset;
+   d->hash  = hash;
+   d->flags = 0;
+
+   for (int i = 0; i < nset; i++)
+      d->flags |= nfa_flags[set[i]];
+
+   for (int i = 0; i < 256; i++)
+      d->next[i] = -1;
+
+   if (dfa_nstates == dfa_max) {
+      dfa_max = MAX(dfa_max * 2, 64);
+      dfa = xrealloc(dfa, dfa_max * sizeof(dfa_state_t *));
+
+      dfa_hash_sz = dfa_max * 2;
+      dfa_hash = xrealloc(dfa_hash, dfa_hash_sz * sizeof(int));
+      for (int i = 0; i < dfa_hash_sz; i++)
+         dfa_hash[i] = -1;
+      for (int i = 0; i < dfa_nstates; i++)
+         dfa_insert_hash(i);
+   }
+
+   const int index = dfa_nstates++;
+   dfa[index] = d;
+   dfa_insert_hash(index);
+
+   return index;
+}
+
+static inline void dfa_add(int *set, int *nset, int nfa)
+{
+   if (nfa_mark[nfa] != nfa_gen) {
+      nfa_mark[nfa] = nfa_gen;
+      set[(*nset)++] = nfa;
+   }
+}
+
+static int dfa_cmp(const void *a, const void *b)
+{
+   return *(const int *)a - *(const int *)b;
+}
+
+static int dfa_step(int state, unsigned char c)
+{
+   dfa_state_t *d = dfa[state];
+   if (likely(d->next[c] >= 0))
+      return d->next[c];
+
+   // A star can expand every NFA state into two
+   int *set = xmalloc(MAX(d->nset * 2, 1) * sizeof(int));
+   int nset = 0;
+
+   nfa_gen++;
+   for (int i = 0; i < d->nset; i++) {
+      const int nfa = d->set[i];
+      if (nfa_char[nfa] == '*') {
+         dfa_add(set, &nset, nfa);
+         dfa_add(set, &nset, nfa + 1);
+      }
+      else if ((unsigned char)nfa_char[nfa] == c)
+         dfa_add(set, &nset, nfa + 1);
+   }
+
+   qsort(set, nset, sizeof(int), dfa_cmp);
+
+   return (d->next[c] = dfa_lookup(set, nset));
+}
+
+static void dfa_add_globs(const glob_t *globs, int count, uint8_t flag,
+                          int *pos)
+{
+   for (int i = 0; i < count; i++) {
+      memcpy(nfa_char + *pos, globs[i].text, globs[i].len);
+      memset(nfa_flags + *pos, '\0', globs[i].len);
+      *pos += globs[i].len;
+
+      nfa_char[*pos]  = '\0';
+      nfa_flags[*pos] = flag;
+      (*pos)++;
+   }
+}
+
+static int dfa_start_state(void)
+{
+   int *set = xmalloc(MAX(n_incl + n_excl, 1) * sizeof(int));
+   int nset = 0, pos = 0;
+
+   for (int i = 0; i < n_excl; pos += excl[i++].len + 1)
+      set[nset++] = pos;
+   for (int i = 0; i < n_incl; pos += incl[i++].len + 1)
+      set[nset++] = pos;
+
+   return dfa_lookup(set, nset);
+}
+
+static void dfa_build(void)
+{
+   dfa_reset();
+
+   nfa_size = 0;
+   for (int i = 0; i < n_excl; i++)
+      nfa_size += excl[i].len + 1;
+   for (int i = 0; i < n_incl; i++)
+      nfa_size += incl[i].len + 1;
+
+   nfa_char  = xrealloc(nfa_char, MAX(nfa_size, 1));
+   nfa_flags = xrealloc(nfa_flags, MAX(nfa_size, 1));
+   nfa_mark  = xrealloc(nfa_mark, MAX(nfa_size, 1) * sizeof(unsigned));
+   memset(nfa_mark, '\0', MAX(nfa_size, 1) * sizeof(unsigned));
+   nfa_gen = 0;
+
+   int pos = 0;
+   dfa_add_globs(excl, n_excl, DFA_MATCH_EXCL, &pos);
+   dfa_add_globs(incl, n_incl, DFA_MATCH_INCL, &pos);
+   assert(pos == nfa_size);
+
+   dfa_valid = true;
+}
+
+static uint8_t dfa_match(const char *str)
+{
+   if (unlikely(!dfa_valid))
+      dfa_build();
+   else if (unlikely(dfa_nstates > DFA_MAX_STATES)) {
+      // Throw away the cached states rather than use unbounded memory
+      // for pathological sets of patterns
+      dfa_reset();
+   }
+
+   if (dfa_start < 0)
+      dfa_start = dfa_start_state();
+
+   int state = dfa_start;
+   for (const char *p = str; *p != '\0'; p++) {
+      if (dfa[state]->nset == 0)
+         return 0;
+      state = dfa_step(state, (unsigned char)*p);
+   }
+
+   return dfa[state]->flags;
+}
+
 bool wave_should_dump(tree_t decl)
 {
-   ident_t name = tree_ident(decl);
+   if (max_depth >= 0 && wave_depth(decl) > max_depth)
+      return false;
+
+   if (n_incl == 0 && n_excl == 0)
+      return true;
+
+   const uint8_t flags = dfa_match(istr(tree_ident(decl)));
+   if (flags & DFA_MATCH_EXCL)
+      return false;
+   else if (flags & DFA_MATCH_INCL)
+      return true;
+   else
+      return (n_incl == 0);
+}
+
+static void wave_close_window(void)
+{
+   for (int i = 0; i < n_entries; i++) {
+      rt_clear_event_cb(entries[i].watch);
+      entries[i].watch = NULL;
+   }
+
+   window_open = false;
+}
+
+static void wave_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
+{
+   if (unlikely(now >= window_stop)) {
+      if (window_open)
+         wave_close_window();
+      return;
+   }
+
+   const uintptr_t index = (uintptr_t)user;
+   dirty[index / 64] |= UINT64_C(1) << (index % 64);
+   any_dirty = true;
+}
 
-   for (int i = 0; i < n_excl; i++) {
-      if (ident_glob(name, excl[i].text, excl[i].len))
-         return false;
+static void wave_open_window(uint64_t now, void *user)
+{
+   // Watches are only installed now so the kernel does no work for
+   // waveform dumping before the window opens. Every signal is written
+   // at the start of the window.
+
+   for (int i = 0; i < n_entries; i++) {
+      void *index = (void *)(uintptr_t)i;
+      entries[i].watch =
+         rt_set_event_cb(entries[i].decl, wave_event_cb, index, true);
+      dirty[i / 64] |= UINT64_C(1) << (i % 64);
    }
 
-   for (int i = 0; i < n_incl; i++) {
-      if (ident_glob(name, incl[i].text, incl[i].len))
-         return true;
+   any_dirty = (n_entries > 0);
+   window_open = true;
+}
+
+void wave_set_emitter(wave_time_fn_t time, wave_emit_fn_t emit)
+{
+   time_fn = time;
+   emit_fn = emit;
+}
+
+bool wave_enabled(void)
+{
+   return emit_fn != NULL;
+}
+
+watch_t *wave_watch(tree_t decl, void *user)
+{
+   assert(emit_fn != NULL);
+
+   if (n_entries == entries_sz) {
+      const int old_words = (entries_sz + 63) / 64;
+      entries_sz = MAX(entries_sz * 2, 256);
+      entries = xrealloc(entries, entries_sz * sizeof(wave_entry_t));
+
+      const int new_words = (entries_sz + 63) / 64;
+      dirty = xrealloc(dirty, new_words * sizeof(uint64_t));
+      memset(dirty + old_words, '\0',
+             (new_words - old_words) * sizeof(uint64_t));
+   }
+
+   if (n_entries == 0) {
+      if (window_start == 0)
+         window_open = true;
+      else
+         rt_set_timeout_cb(window_start, wave_open_window, NULL);
+   }
+
+   const uintptr_t index = n_entries++;
+   entries[index].decl  = decl;
+   entries[index].user  = user;
+   entries[index].watch = NULL;
+
+   if (window_open)
+      entries[index].watch =
+         rt_set_event_cb(decl, wave_event_cb, (void *)index, true);
+
+   // Returns NULL if the initial value should not be written
+   return entries[index].watch;
+}
+
+void wave_flush(void)
+{
+   if (!any_dirty)
+      return;
+
+   (*time_fn)(rt_now(NULL));
+
+   const int nwords = (n_entries + 63) / 64;
+   for (int i = 0; i < nwords; i++) {
+      uint64_t mask = dirty[i];
+      dirty[i] = 0;
+
+      while (mask != 0) {
+         const int index = (i * 64) + __builtin_ctzll(mask);
+         mask &= mask - 1;
+
+         (*emit_fn)(entries[index].watch, entries[index].user);
+      }
    }
 
-   return (n_incl == 0);
+   any_dirty = false;
 }
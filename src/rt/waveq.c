@@ -0,0 +1,211 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "waveq.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Records are packed into a circular buffer with the head and tail
+// positions as free running byte counts. A record never wraps around
+// the end of the buffer: if there is not enough space left before the
+// end then a marker record is written and the next record starts at
+// the beginning. Each side only takes the lock when it needs to sleep
+// or wake the other.
+
+#define RING_SIZE  (4 * 1024 * 1024)
+#define RING_WRAP  UINT32_MAX
+#define RING_ALIGN 8
+
+typedef struct {
+   uint64_t  now;
+   void     *user;
+   uint32_t  size;
+   uint32_t  pad;
+} record_t;
+
+static uint8_t         *ring = NULL;
+static uint64_t         head = 0;
+static uint64_t         tail = 0;
+static waveq_fn_t       callback = NULL;
+static pthread_t        thread;
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   not_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   not_empty = PTHREAD_COND_INITIALIZER;
+static bool             producer_waiting = false;
+static bool             consumer_waiting = false;
+static bool             stopping = false;
+
+static inline size_t waveq_align(size_t sz)
+{
+   return (sz + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1);
+}
+
+static void waveq_wake(bool *waiting, pthread_cond_t *cond)
+{
+   // The sleeper sets its flag and then checks the ring state while
+   // holding the lock so it cannot miss this wakeup
+   if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+      pthread_mutex_lock(&lock);
+      pthread_cond_signal(cond);
+      pthread_mutex_unlock(&lock);
+   }
+}
+
+static inline size_t waveq_space(void)
+{
+   return RING_SIZE - (head - __atomic_load_n(&tail, __ATOMIC_SEQ_CST));
+}
+
+static void waveq_wait_space(size_t need)
+{
+   // Block until at least need bytes are free
+   if (likely(waveq_space() >= need))
+      return;
+
+   pthread_mutex_lock(&lock);
+   __atomic_store_n(&producer_waiting, true, __ATOMIC_SEQ_CST);
+   while (waveq_space() < need)
+      pthread_cond_wait(&not_full, &lock);
+   __atomic_store_n(&producer_waiting, false, __ATOMIC_SEQ_CST);
+   pthread_mutex_unlock(&lock);
+}
+
+static void *waveq_thread(void *arg)
+{
+   for (;;) {
+      uint64_t avail = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+      if (avail == tail) {
+         pthread_mutex_lock(&lock);
+         __atomic_store_n(&consumer_waiting, true, __ATOMIC_SEQ_CST);
+         while ((avail = __atomic_load_n(&head, __ATOMIC_SEQ_CST)) == tail
+                && !stopping)
+            pthread_cond_wait(&not_empty, &lock);
+         __atomic_store_n(&consumer_waiting, false, __ATOMIC_SEQ_CST);
+         const bool stop = stopping && avail == tail;
+         pthread_mutex_unlock(&lock);
+
+         if (stop)
+            break;
+      }
+
+      uint64_t pos = tail;
+      while (pos != avail) {
+         const size_t idx = pos % RING_SIZE;
+         if (RING_SIZE - idx < sizeof(record_t)) {
+            pos += RING_SIZE - idx;
+            continue;
+         }
+
+         const record_t *r = (const record_t *)(ring + idx);
+         if (r->size == RING_WRAP) {
+            pos += RING_SIZE - idx;
+            continue;
+         }
+
+         (*callback)(r->now, r->user, r + 1, r->size);
+         pos += waveq_align(sizeof(record_t) + r->size);
+
+         // Release space as soon as possible so the producer does not
+         // wait for a whole batch to be processed
+         __atomic_store_n(&tail, pos, __ATOMIC_SEQ_CST);
+         waveq_wake(&producer_waiting, &not_full);
+      }
+   }
+
+   return NULL;
+}
+
+static void waveq_drain(void)
+{
+   waveq_wait_space(RING_SIZE);
+}
+
+void waveq_start(waveq_fn_t fn)
+{
+   assert(ring == NULL);
+
+   ring     = xmalloc(RING_SIZE);
+   head     = tail = 0;
+   callback = fn;
+   stopping = false;
+
+   if (pthread_create(&thread, NULL, waveq_thread, NULL) != 0)
+      fatal_errno("pthread_create");
+}
+
+void waveq_push(uint64_t now, void *user, watch_t *w)
+{
+   const size_t size = rt_watch_bytes(w);
+   const size_t need = waveq_align(sizeof(record_t) + size);
+
+   if (unlikely(need > RING_SIZE / 2)) {
+      // Too large to queue so wait until the consumer is idle and then
+      // call the function directly
+      waveq_drain();
+
+      void *buf = xmalloc(size);
+      rt_watch_copy(w, buf);
+      (*callback)(now, user, buf, size);
+      free(buf);
+      return;
+   }
+
+   uint64_t pos = head;
+   size_t idx = pos % RING_SIZE;
+   if (RING_SIZE - idx < need) {
+      // Skip to the start of the buffer
+      const size_t skip = RING_SIZE - idx;
+      waveq_wait_space(skip + need);
+
+      if (skip >= sizeof(record_t))
+         ((record_t *)(ring + idx))->size = RING_WRAP;
+
+      pos += skip;
+      idx = 0;
+   }
+   else
+      waveq_wait_space(need);
+
+   record_t *r = (record_t *)(ring + idx);
+   r->now  = now;
+   r->user = user;
+   r->size = size;
+   rt_watch_copy(w, r + 1);
+
+   __atomic_store_n(&head, pos + need, __ATOMIC_SEQ_CST);
+   waveq_wake(&consumer_waiting, &not_empty);
+}
+
+void waveq_stop(void)
+{
+   if (ring == NULL)
+      return;
+
+   pthread_mutex_lock(&lock);
+   stopping = true;
+   pthread_cond_signal(&not_empty);
+   pthread_mutex_unlock(&lock);
+
+   pthread_join(thread, NULL);
+
+   free(ring);
+   ring = NULL;
+}
@@ -0,0 +1,37 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _WAVEQ_H
+#define _WAVEQ_H
+
+#include "rt.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Single producer single consumer queue of signal value changes which
+// are passed to a callback on a background thread. The simulation
+// thread blocks when the queue is full so no changes are ever lost.
+
+typedef void (*waveq_fn_t)(uint64_t now, void *user, const void *raw,
+                           size_t size);
+
+void waveq_start(waveq_fn_t fn);
+void waveq_push(uint64_t now, void *user, watch_t *w);
+void waveq_stop(void);
+
+#endif  // _WAVEQ_H
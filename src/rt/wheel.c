@@ -0,0 +1,325 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "wheel.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each level of the wheel has 256 slots and each slot at level N covers
+// 256^N consecutive keys. A key is stored at the lowest level where all
+// the more significant bits match the base key so the first level only
+// ever contains entries whose key is exactly known from the slot index.
+// When the first level is exhausted the next occupied slot of a higher
+// level is cascaded down.
+
+#define SLOT_BITS   8
+#define NSLOTS      (1 << SLOT_BITS)
+#define NLEVELS     6
+#define NWORDS      (NSLOTS / 64)
+#define CHUNK_NODES 256
+
+typedef struct wnode  wnode_t;
+typedef struct wchunk wchunk_t;
+
+struct wnode {
+   uint64_t     key;
+   void        *user;
+   wnode_t     *next;
+   wnode_t    **pprev;
+   heap_slot_t *uslot;
+   heap_slot_t  hslot;
+   int8_t       level;
+   uint8_t      slot;
+};
+
+struct wchunk {
+   wchunk_t *next;
+   wnode_t   nodes[CHUNK_NODES];
+};
+
+typedef struct {
+   wnode_t  *slots[NSLOTS];
+   uint64_t  bitmap[NWORDS];
+} level_t;
+
+struct wheel {
+   uint64_t  base;
+   uint64_t  floor;
+   size_t    count;
+   level_t   levels[NLEVELS];
+   heap_t    overflow;
+   wnode_t  *free_nodes;
+   wchunk_t *chunks;
+};
+
+typedef struct {
+   heap_walk_fn_t  fn;
+   void           *context;
+} walk_ctx_t;
+
+static wnode_t *wheel_alloc_node(wheel_t w)
+{
+   if (unlikely(w->free_nodes == NULL)) {
+      wchunk_t *c = xmalloc(sizeof(wchunk_t));
+      c->next = w->chunks;
+      w->chunks = c;
+
+      for (int i = 0; i < CHUNK_NODES; i++) {
+         c->nodes[i].next = w->free_nodes;
+         w->free_nodes = &(c->nodes[i]);
+      }
+   }
+
+   wnode_t *n = w->free_nodes;
+   w->free_nodes = n->next;
+   return n;
+}
+
+static inline void wheel_free_node(wheel_t w, wnode_t *n)
+{
+   n->next = w->free_nodes;
+   w->free_nodes = n;
+}
+
+static void wheel_place(wheel_t w, wnode_t *n)
+{
+   const uint64_t diff = n->key ^ w->base;
+   const int level =
+      (diff == 0) ? 0 : (63 - __builtin_clzll(diff)) / SLOT_BITS;
+
+   if (unlikely(n->key < w->base || level >= NLEVELS)) {
+      n->level = -1;
+      heap_insert_slot(w->overflow, n->key, n, &(n->hslot));
+   }
+   else {
+      const int slot = (n->key >> (level * SLOT_BITS)) & (NSLOTS - 1);
+      level_t *l = &(w->levels[level]);
+
+      if ((n->next = l->slots[slot]) != NULL)
+         n->next->pprev = &(n->next);
+      n->pprev = &(l->slots[slot]);
+      n->level = level;
+      n->slot  = slot;
+
+      l->slots[slot] = n;
+      l->bitmap[slot / 64] |= UINT64_C(1) << (slot % 64);
+
+      w->count++;
+   }
+}
+
+static void wheel_unlink(wheel_t w, wnode_t *n)
+{
+   if (n->level < 0)
+      heap_delete(w->overflow, n->hslot);
+   else {
+      if ((*(n->pprev) = n->next) != NULL)
+         n->next->pprev = n->pprev;
+
+      level_t *l = &(w->levels[n->level]);
+      if (l->slots[n->slot] == NULL)
+         l->bitmap[n->slot / 64] &= ~(UINT64_C(1) << (n->slot % 64));
+
+      w->count--;
+   }
+
+   if (n->uslot != NULL)
+      *(n->uslot) = 0;
+}
+
+static int wheel_next_slot(const level_t *l, int from)
+{
+   // Find the first occupied slot with index greater or equal to from
+   int word = from / 64;
+   uint64_t mask = l->bitmap[word] & (~UINT64_C(0) << (from % 64));
+   for (;;) {
+      if (mask != 0)
+         return (word * 64) + __builtin_ctzll(mask);
+      else if (++word == NWORDS)
+         return -1;
+      else
+         mask = l->bitmap[word];
+   }
+}
+
+static wnode_t *wheel_peek(wheel_t w)
+{
+   // Advance the base key to the smallest key stored in the wheel
+
+   if (w->count == 0)
+      return NULL;
+
+   for (;;) {
+      const int slot0 = wheel_next_slot(&(w->levels[0]),
+                                        w->base & (NSLOTS - 1));
+      if (slot0 >= 0) {
+         w->base = (w->base & ~(uint64_t)(NSLOTS - 1)) | slot0;
+         return w->levels[0].slots[slot0];
+      }
+
+      int level, slot = -1;
+      for (level = 1; level < NLEVELS; level++) {
+         const int from = (w->base >> (level * SLOT_BITS)) & (NSLOTS - 1);
+         if ((slot = wheel_next_slot(&(w->levels[level]), from)) >= 0)
+            break;
+      }
+
+      assert(level < NLEVELS);
+
+      const int shift = level * SLOT_BITS;
+      const uint64_t upper_mask = ~((UINT64_C(1) << (shift + SLOT_BITS)) - 1);
+      w->base = (w->base & upper_mask) | ((uint64_t)slot << shift);
+
+      level_t *l = &(w->levels[level]);
+      wnode_t *it = l->slots[slot];
+      l->slots[slot] = NULL;
+      l->bitmap[slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+
+      while (it != NULL) {
+         wnode_t *next = it->next;
+         w->count--;
+         wheel_place(w, it);
+         it = next;
+      }
+   }
+}
+
+wheel_t wheel_new(void)
+{
+   struct wheel *w = xmalloc(sizeof(struct wheel));
+   memset(w->levels, '\0', sizeof(w->levels));
+   w->base       = 0;
+   w->floor      = 0;
+   w->count      = 0;
+   w->overflow   = heap_new(64);
+   w->free_nodes = NULL;
+   w->chunks     = NULL;
+
+   return w;
+}
+
+void wheel_free(wheel_t w)
+{
+   while (w->chunks != NULL) {
+      wchunk_t *next = w->chunks->next;
+      free(w->chunks);
+      w->chunks = next;
+   }
+
+   heap_free(w->overflow);
+   free(w);
+}
+
+void *wheel_extract_min(wheel_t w)
+{
+   wnode_t *n = wheel_peek(w);
+
+   if (heap_size(w->overflow) > 0) {
+      wnode_t *h = heap_min(w->overflow);
+      if (n == NULL || h->key < n->key)
+         n = h;
+   }
+
+   if (unlikely(n == NULL))
+      fatal_trace("wheel underflow");
+
+   wheel_unlink(w, n);
+   w->floor = n->key;
+
+   void *user = n->user;
+   wheel_free_node(w, n);
+   return user;
+}
+
+void *wheel_min(wheel_t w)
+{
+   wnode_t *n = wheel_peek(w);
+
+   if (heap_size(w->overflow) > 0) {
+      wnode_t *h = heap_min(w->overflow);
+      if (n == NULL || h->key < n->key)
+         return h->user;
+   }
+
+   if (unlikely(n == NULL))
+      fatal_trace("wheel underflow");
+
+   return n->user;
+}
+
+void wheel_insert(wheel_t w, uint64_t key, void *user)
+{
+   wheel_insert_slot(w, key, user, NULL);
+}
+
+void wheel_insert_slot(wheel_t w, uint64_t key, void *user, heap_slot_t *slot)
+{
+   if (w->count == 0) {
+      // The wheel can be repositioned at the last key extracted as all
+      // future keys are expected to be greater than this
+      w->base = w->floor;
+   }
+
+   wnode_t *n = wheel_alloc_node(w);
+   n->key   = key;
+   n->user  = user;
+   n->next  = NULL;
+   n->uslot = slot;
+
+   if (slot != NULL)
+      *slot = (heap_slot_t)n;
+
+   wheel_place(w, n);
+}
+
+void wheel_delete(wheel_t w, heap_slot_t slot)
+{
+   wnode_t *n = (wnode_t *)slot;
+   if (unlikely(n == NULL))
+      fatal_trace("invalid wheel slot");
+
+   wheel_unlink(w, n);
+   wheel_free_node(w, n);
+}
+
+size_t wheel_size(wheel_t w)
+{
+   return w->count + heap_size(w->overflow);
+}
+
+static void wheel_walk_overflow(uint64_t key, void *user, void *context)
+{
+   walk_ctx_t *ctx = context;
+   (*ctx->fn)(key, ((wnode_t *)user)->user, ctx->context);
+}
+
+void wheel_walk(wheel_t w, heap_walk_fn_t fn, void *context)
+{
+   for (int level = 0; level < NLEVELS; level++) {
+      for (int slot = 0; slot < NSLOTS; slot++) {
+         for (wnode_t *it = w->levels[level].slots[slot];
+              it != NULL; it = it->next)
+            (*fn)(it->key, it->user, context);
+      }
+   }
+
+   walk_ctx_t ctx = { fn, context };
+   heap_walk(w->overflow, wheel_walk_overflow, &ctx);
+}
@@ -34,6 +34,8 @@ typedef struct loop_stack  loop_stack_t;
 typedef struct type_set    type_set_t;
 typedef struct defer_check defer_check_t;
 typedef struct import_list import_list_t;
+typedef struct overload_memo overload_memo_t;
+typedef struct symbol      symbol_t;
 
 typedef bool (*defer_fn_t)(tree_t t);
 typedef bool (*static_fn_t)(tree_t t);
@@ -57,11 +59,22 @@ typedef enum {
    SCOPE_CONTEXT   = (1 << 3)
 } scope_flags_t;
 
+// Each visible name maps to a chain of symbols with those from inner
+// scopes first and in declaration order within a scope
+struct symbol {
+   ident_t   name;
+   tree_t    decl;
+   scope_t  *scope;
+   symbol_t *chain;     // Next visible declaration with the same name
+   symbol_t *journal;   // Previous symbol inserted into the same scope
+};
+
 struct scope {
    scope_t       *down;
+   unsigned       depth;
 
    defer_check_t *deferred;
-   hash_t        *decls;
+   symbol_t      *symbols;
    tree_t         subprog;
    wait_level_t   wait_level;
    impure_io_t    impure_io;
@@ -70,6 +83,21 @@ struct scope {
    ident_t        prefix;
    import_list_t *imported;
    scope_flags_t  flags;
+
+   unsigned       generation;
+};
+
+// Candidate functions for a call with only positional arguments in a
+// particular type context: valid until the visible declarations change
+struct overload_memo {
+   overload_memo_t *next;
+   int              nparams;
+   unsigned         n_types;
+   type_t          *types;
+   int              found_func;
+   int              n_found;
+   int              n_overloads;
+   tree_t           overloads[0];
 };
 
 struct loop_stack {
@@ -121,6 +149,10 @@ static int           errors = 0;
 static unsigned      relax = -1;
 static type_set_t   *top_type_set = NULL;
 static loop_stack_t *loop_stack = NULL;
+static unsigned      scope_generation = 0;
+static ghash_t      *symbol_table = NULL;
+static ghash_t      *overload_memos = NULL;
+static unsigned      memo_generation = 0;
 
 #define sem_error(t, ...) do {                        \
       error_at(t ? tree_loc(t) : NULL , __VA_ARGS__); \
@@ -130,8 +162,12 @@ static loop_stack_t *loop_stack = NULL;
 
 static void scope_push(ident_t prefix)
 {
+   if (symbol_table == NULL)
+      symbol_table = ghash_new(GHASH_PTR, 4096);
+
    scope_t *s = xmalloc(sizeof(scope_t));
-   s->decls      = hash_new(1024, false);
+   s->symbols    = NULL;
+   s->depth      = (top_scope ? top_scope->depth + 1 : 0);
    s->prefix     = prefix;
    s->imported   = NULL;
    s->down       = top_scope;
@@ -140,6 +176,7 @@ static void scope_push(ident_t prefix)
    s->deferred   = NULL;
    s->wait_level = WAITS_NO;
    s->impure_io  = 0;
+   s->generation = scope_generation;
 
    top_scope = s;
 }
@@ -155,7 +192,28 @@ static void scope_pop(void)
       top_scope->imported = tmp;
    }
 
-   hash_free(top_scope->decls);
+   // Symbols from this scope are at the head of each chain as every
+   // inner scope has already been popped
+   for (symbol_t *sym = top_scope->symbols, *next; sym != NULL; sym = next) {
+      next = sym->journal;
+
+      symbol_t *head = ghash_get(symbol_table, sym->name);
+      if (head != NULL && head->scope == top_scope) {
+         while (head != NULL && head->scope == top_scope)
+            head = head->chain;
+
+         if (head == NULL)
+            ghash_delete(symbol_table, sym->name);
+         else
+            ghash_put(symbol_table, sym->name, head);
+      }
+
+      free(sym);
+   }
+
+   // Any names declared while this scope was active are no longer visible
+   if (top_scope->generation != scope_generation)
+      scope_generation++;
 
    scope_t *s = top_scope;
    if (s->down != NULL && s->down->subprog == s->subprog) {
@@ -211,29 +269,37 @@ static void scope_apply_prefix(tree_t t)
                                      tree_ident(t), '.'));
 }
 
-static scope_t *scope_containing(scope_t *s, tree_t decl)
+static symbol_t *scope_lookup(ident_t name)
 {
-   int k = 0, tmp;
-   tree_t next;
-   ident_t name = tree_ident(decl);
-   while (tmp = k++, (next = hash_get_nth(s->decls, name, &tmp))) {
-      if (next == decl)
-         return s;
+   return symbol_table ? ghash_get(symbol_table, name) : NULL;
+}
+
+static scope_t *scope_containing(tree_t decl)
+{
+   for (symbol_t *sym = scope_lookup(tree_ident(decl));
+        sym != NULL; sym = sym->chain) {
+      if (sym->decl == decl)
+         return sym->scope;
    }
-   return s->down == NULL ? NULL : scope_containing(s->down, decl);
+
+   return NULL;
 }
 
 static tree_t scope_find_in(ident_t i, scope_t *s, bool recur, int k)
 {
    if (s == NULL)
       return NULL;
-   else {
-      void *value = hash_get_nth(s->decls, i, &k);
-      if (value != NULL)
-         return (tree_t)value;
-      else
-         return (recur ? scope_find_in(i, s->down, true, k) : NULL);
+
+   for (symbol_t *sym = scope_lookup(i); sym != NULL; sym = sym->chain) {
+      if (sym->scope->depth > s->depth)
+         continue;   // Declared in a scope nested inside `s'
+      else if (!recur && sym->scope != s)
+         break;
+      else if (k-- == 0)
+         return sym->decl;
    }
+
+   return NULL;
 }
 
 static tree_t scope_find(ident_t i)
@@ -246,24 +312,27 @@ static tree_t scope_find_nth(ident_t i, int n)
    return scope_find_in(i, top_scope, true, n);
 }
 
-static bool scope_walk(scope_t **where, hash_iter_t *now, tree_t *decl)
+static bool scope_walk(scope_t **where, symbol_t **now, tree_t *decl)
 {
-   const void *key;
-   void *value;
+   // Start with a NULL `now' to return each declaration in the top scope
+   // or every scope from `where' down
    scope_t *w = where == NULL ? top_scope : *where;
-   while (hash_iter(w->decls, now, &key, &value)) {
-      *decl = value;
-      if (tree_ident(*decl) != key)
+   symbol_t *sym = (*now == NULL) ? w->symbols : (*now)->journal;
+   for (; sym != NULL; sym = sym->journal) {
+      if (tree_ident(sym->decl) != sym->name)
          continue;   // Skip aliases
-      else
+      else {
+         *now  = sym;
+         *decl = sym->decl;
          return true;
+      }
    }
 
    if (where == NULL || w->down == NULL)
       return false;
    else {
       *where = w->down;
-      *now = HASH_BEGIN;
+      *now = NULL;
       return scope_walk(where, now, decl);
    }
 }
@@ -335,43 +404,72 @@ static void scope_insert_fields(type_t type, ident_t prefix)
    }
 }
 
+static void scope_replace(tree_t t, tree_t with)
+{
+   assert(top_scope != NULL);
+
+   for (symbol_t *sym = top_scope->symbols; sym != NULL; sym = sym->journal) {
+      if (sym->decl == t)
+         sym->decl = with;
+   }
+
+   scope_generation++;
+}
+
 static bool scope_insert_hiding(tree_t t, ident_t name, bool overload)
 {
    assert(top_scope != NULL);
 
-   tree_t existing;
-   int n = 0;
-   do {
-      if ((existing = scope_find_in(name, top_scope, false, n++))) {
-         if (existing == t)
-            return true;
-         else if (!overload)
-            sem_error(t, "%s already declared in this region", istr(name));
+   symbol_t *head = scope_lookup(name), *last = NULL;
+   for (symbol_t *sym = head; sym != NULL && sym->scope == top_scope;
+        last = sym, sym = sym->chain) {
+      tree_t existing = sym->decl;
+      if (existing == t)
+         return true;
+      else if (!overload)
+         sem_error(t, "%s already declared in this region", istr(name));
 
-         const tree_kind_t ekind = tree_kind(existing);
-         if (ekind == T_UNIT_DECL || ekind == T_LIBRARY)
-            continue;
+      const tree_kind_t ekind = tree_kind(existing);
+      if (ekind == T_UNIT_DECL || ekind == T_LIBRARY)
+         continue;
 
-         const bool builtin = (tree_attr_str(existing, builtin_i) != NULL);
-         if (builtin && type_eq(tree_type(t), tree_type(existing))) {
-            type_t arg0_type = type_param(tree_type(existing), 0);
+      const bool builtin = (tree_attr_str(existing, builtin_i) != NULL);
+      if (builtin && type_eq(tree_type(t), tree_type(existing))) {
+         type_t arg0_type = type_param(tree_type(existing), 0);
 
-            ident_t t_region = ident_runtil(tree_ident(t), '.');
-            ident_t e_region = ident_runtil(type_ident(arg0_type), '.');
+         ident_t t_region = ident_runtil(tree_ident(t), '.');
+         ident_t e_region = ident_runtil(type_ident(arg0_type), '.');
 
-            const bool same_region = (t_region == e_region);
+         const bool same_region = (t_region == e_region);
 
-            // Allow builtin functions to be hidden by explicit functins
-            // declared in the same region
-            if (same_region) {
-               hash_replace(top_scope->decls, existing, t);
-               return true;
-            }
+         // Allow builtin functions to be hidden by explicit functins
+         // declared in the same region
+         if (same_region) {
+            scope_replace(existing, t);
+            return true;
          }
       }
-   } while (existing != NULL);
+   }
+
+   // Goes after any other declarations of this name in the same region
+   symbol_t *sym = xmalloc(sizeof(symbol_t));
+   sym->name    = name;
+   sym->decl    = t;
+   sym->scope   = top_scope;
+   sym->journal = top_scope->symbols;
+
+   top_scope->symbols = sym;
+
+   if (last != NULL) {
+      sym->chain  = last->chain;
+      last->chain = sym;
+   }
+   else {
+      sym->chain = head;
+      ghash_put(symbol_table, name, sym);
+   }
 
-   hash_put(top_scope->decls, name, t);
+   scope_generation++;
 
    const tree_kind_t kind = tree_kind(t);
    const bool may_have_fields =
@@ -398,10 +496,100 @@ static void scope_insert_alias(tree_t t, ident_t name)
    (void)scope_insert_hiding(t, name, true);
 }
 
-static void scope_replace(tree_t t, tree_t with)
+static void overload_memo_flush(void)
 {
-   assert(top_scope != NULL);
-   hash_replace(top_scope->decls, t, with);
+   if (overload_memos != NULL) {
+      hash_iter_t it = HASH_BEGIN;
+      const void *key;
+      void *value;
+      while (ghash_iter(overload_memos, &it, &key, &value)) {
+         for (overload_memo_t *m = value, *next; m != NULL; m = next) {
+            next = m->next;
+            free(m->types);
+            free(m);
+         }
+      }
+
+      ghash_free(overload_memos);
+   }
+
+   overload_memos  = ghash_new(GHASH_PTR, 256);
+   memo_generation = scope_generation;
+}
+
+static bool overload_memo_key_ok(tree_t call)
+{
+   const int nparams = tree_params(call);
+   for (int i = 0; i < nparams; i++) {
+      if (tree_subkind(tree_param(call, i)) != P_POS)
+         return false;
+   }
+
+   return true;
+}
+
+static bool overload_memo_match(overload_memo_t *m, int nparams)
+{
+   if (m->nparams != nparams)
+      return false;
+
+   const unsigned n_types = top_type_set ? top_type_set->n_members : 0;
+   if (m->n_types != n_types)
+      return false;
+
+   for (unsigned i = 0; i < n_types; i++) {
+      if (m->types[i] != top_type_set->members[i])
+         return false;
+   }
+
+   return true;
+}
+
+static overload_memo_t *overload_memo_get(ident_t name, tree_t call)
+{
+   if ((overload_memos == NULL) || (memo_generation != scope_generation))
+      overload_memo_flush();
+
+   if (!overload_memo_key_ok(call))
+      return NULL;
+
+   const int nparams = tree_params(call);
+   for (overload_memo_t *m = ghash_get(overload_memos, name);
+        m != NULL; m = m->next) {
+      if (overload_memo_match(m, nparams))
+         return m;
+   }
+
+   return NULL;
+}
+
+static void overload_memo_put(ident_t name, tree_t call, tree_t *overloads,
+                              int n_overloads, int found_func, int n_found)
+{
+   if ((overload_memos == NULL) || (memo_generation != scope_generation))
+      overload_memo_flush();
+
+   if (!overload_memo_key_ok(call))
+      return;
+
+   const unsigned n_types = top_type_set ? top_type_set->n_members : 0;
+
+   overload_memo_t *m =
+      xmalloc(sizeof(overload_memo_t) + n_overloads * sizeof(tree_t));
+   m->nparams     = tree_params(call);
+   m->n_types     = n_types;
+   m->types       = xmalloc(MAX(n_types, 1) * sizeof(type_t));
+   m->found_func  = found_func;
+   m->n_found     = n_found;
+   m->n_overloads = n_overloads;
+   m->next        = ghash_get(overload_memos, name);
+
+   for (unsigned i = 0; i < n_types; i++)
+      m->types[i] = top_type_set->members[i];
+
+   memcpy(m->overloads, overloads, n_overloads * sizeof(tree_t));
+
+   ghash_put(overload_memos, name, m);
 }
 
 static void loop_push(ident_t name)
@@ -3842,88 +4030,110 @@ static bool sem_check_fcall(tree_t t)
    if (!sem_check_selected_name(name, t, NULL))
       return false;
 
-   tree_t decl;
+   tree_t decl = NULL;
    int n = 0, found_func = 0;
-   do {
-      if ((decl = scope_find_nth(name, n++))) {
-         if (!class_has_type(class_of(decl)))
-            continue;
 
-         switch (tree_kind(decl)) {
-         case T_FUNC_DECL:
-         case T_FUNC_BODY:
-            found_func++;
-            break;
-         case T_TYPE_DECL:
-            tree_change_kind(t, T_TYPE_CONV);
-            tree_set_ref(t, decl);
-            return sem_check_conversion(t);
-         case T_ALIAS:
-            if (tree_has_type(decl) && type_kind(tree_type(decl)) == T_FUNC) {
-               decl = tree_ref(tree_value(decl));
-               found_func++;
-               break;
-            }
-            // Fall-through
-         default:
+   // Calls with the same name and argument count in the same type context
+   // will find the same candidates until a new declaration is visible
+   overload_memo_t *memo = overload_memo_get(name, t);
+   if (memo != NULL) {
+      n           = memo->n_found;
+      found_func  = memo->found_func;
+      n_overloads = memo->n_overloads;
+
+      if (n_overloads > max_overloads) {
+         max_overloads = n_overloads;
+         overloads = xrealloc(overloads, max_overloads * sizeof(tree_t));
+      }
+
+      memcpy(overloads, memo->overloads, n_overloads * sizeof(tree_t));
+   }
+   else {
+      do {
+         if ((decl = scope_find_nth(name, n++))) {
             if (!class_has_type(class_of(decl)))
                continue;
-            else {
-               type_t type = tree_type(decl);
-               const bool is_array_ref =
-                  type_is_array(type)
-                  || (type_is_access(type) && type_is_array(type_access(type)));
-               if (is_array_ref) {
-                  // The grammar is ambiguous between function calls and
-                  // array references so must be an array reference
-                  tree_t ref = tree_new(T_REF);
-                  tree_set_ident(ref, name);
-                  tree_set_loc(ref, tree_loc(t));
-
-                  tree_change_kind(t, T_ARRAY_REF);
-                  tree_set_value(t, ref);
-
-                  return sem_check_array_ref(t);
+
+            switch (tree_kind(decl)) {
+            case T_FUNC_DECL:
+            case T_FUNC_BODY:
+               found_func++;
+               break;
+            case T_TYPE_DECL:
+               tree_change_kind(t, T_TYPE_CONV);
+               tree_set_ref(t, decl);
+               return sem_check_conversion(t);
+            case T_ALIAS:
+               if (tree_has_type(decl)
+                   && type_kind(tree_type(decl)) == T_FUNC) {
+                  decl = tree_ref(tree_value(decl));
+                  found_func++;
+                  break;
+               }
+               // Fall-through
+            default:
+               if (!class_has_type(class_of(decl)))
+                  continue;
+               else {
+                  type_t type = tree_type(decl);
+                  const bool is_array_ref =
+                     type_is_array(type)
+                     || (type_is_access(type)
+                         && type_is_array(type_access(type)));
+                  if (is_array_ref) {
+                     // The grammar is ambiguous between function calls and
+                     // array references so must be an array reference
+                     tree_t ref = tree_new(T_REF);
+                     tree_set_ident(ref, name);
+                     tree_set_loc(ref, tree_loc(t));
+
+                     tree_change_kind(t, T_ARRAY_REF);
+                     tree_set_value(t, ref);
+
+                     return sem_check_array_ref(t);
+                  }
+                  else
+                     continue;   // Look for the next matching name
                }
-               else
-                  continue;   // Look for the next matching name
             }
-         }
 
-         type_t func_type = tree_type(decl);
+            type_t func_type = tree_type(decl);
 
-         if (type_set_member(type_result(func_type))) {
-            // Number of arguments must match
-            if (!sem_check_arity(t, decl))
-               continue;
+            if (type_set_member(type_result(func_type))) {
+               // Number of arguments must match
+               if (!sem_check_arity(t, decl))
+                  continue;
 
-            // Same function may appear multiple times in the symbol
-            // table under different names
-            bool duplicate = false;
-            for (int i = 0; i < n_overloads; i++) {
-               if (overloads[i] == decl)
-                  duplicate = true;
-               else if (type_eq(tree_type(overloads[i]), func_type)) {
-                  const bool same_name =
-                     (tree_ident(overloads[i]) == tree_ident(decl));
-
-                  const bool hide_implicit =
-                     ((tree_attr_str(decl, builtin_i) != NULL)
-                      || (tree_attr_str(overloads[i], builtin_i) != NULL))
-                     && prefer_explicit;
-
-                  if (same_name || hide_implicit)
+               // Same function may appear multiple times in the symbol
+               // table under different names
+               bool duplicate = false;
+               for (int i = 0; i < n_overloads; i++) {
+                  if (overloads[i] == decl)
                      duplicate = true;
+                  else if (type_eq(tree_type(overloads[i]), func_type)) {
+                     const bool same_name =
+                        (tree_ident(overloads[i]) == tree_ident(decl));
+
+                     const bool hide_implicit =
+                        ((tree_attr_str(decl, builtin_i) != NULL)
+                         || (tree_attr_str(overloads[i], builtin_i) != NULL))
+                        && prefer_explicit;
+
+                     if (same_name || hide_implicit)
+                        duplicate = true;
+                  }
                }
-            }
 
-            if (!duplicate) {
-               // Found a matching function definition
-               ARRAY_APPEND(overloads, decl, n_overloads, max_overloads);
+               if (!duplicate) {
+                  // Found a matching function definition
+                  ARRAY_APPEND(overloads, decl, n_overloads, max_overloads);
+               }
             }
          }
-      }
-   } while (decl != NULL);
+      } while (decl != NULL);
+
+      overload_memo_put(name, t, overloads, n_overloads, found_func, n);
+   }
 
    if (n_overloads == 0) {
       if (type_set_restrict(type_is_array)) {
@@ -4442,7 +4652,7 @@ static bool sem_check_concat(tree_t t)
       }
       else {
          // Find all one dimensional array types with this element type
-         hash_iter_t it = HASH_BEGIN;
+         symbol_t *it = NULL;
          tree_t obj;
          scope_t *where = top_scope;
          type_t found[16];
@@ -5069,7 +5279,7 @@ static bool sem_check_pure_ref(tree_t ref, tree_t decl)
       && !(tree_flags(top_scope->subprog) & TREE_F_IMPURE);
 
    if (is_pure_func) {
-      scope_t *owner = scope_containing(top_scope, decl);
+      scope_t *owner = scope_containing(decl);
       if (owner != NULL && owner->subprog != top_scope->subprog)
          sem_error(ref, "invalid reference to %s inside pure function %s",
                    istr(tree_ident(decl)),
@@ -6771,6 +6981,11 @@ static bool sem_check_attr_spec(tree_t t)
 
    tree_add_attr_tree(obj_decl, tree_ident(t), value);
 
+   // Foreign procedures are implemented by the runtime and so can be
+   // called directly as they never suspend the calling process
+   if (tree_ident(t) == foreign_i && tree_kind(obj_decl) == T_PROC_DECL)
+      tree_add_attr_int(obj_decl, wait_level_i, WAITS_NO);
+
    return true;
 }
 
@@ -7053,7 +7268,7 @@ static bool sem_check_spec(tree_t t)
    }
    else {
       ident_t cname = tree_ident2(t);
-      hash_iter_t it = HASH_BEGIN;
+      symbol_t *it = NULL;
       tree_t obj;
       while (scope_walk(NULL, &it, &obj)) {
          if (tree_kind(obj) != T_INSTANCE)
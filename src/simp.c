@@ -211,11 +211,14 @@ static tree_t simp_ref(tree_t t)
    }
 }
 
-static tree_t simp_attr_delayed_transaction(tree_t t, predef_attr_t predef,
-                                            simp_ctx_t *ctx)
+static tree_t simp_attr_implicit_signal(tree_t t, predef_attr_t predef,
+                                        simp_ctx_t *ctx)
 {
+   // The process created here is only run if the kernel cannot update
+   // the implicit signal directly when the prefix changes
    tree_t name = tree_name(t);
-   assert(tree_kind(name) == T_REF);
+   if (tree_kind(name) != T_REF)
+      return t;
 
    tree_t decl = tree_ref(name);
 
@@ -223,9 +226,16 @@ static tree_t simp_attr_delayed_transaction(tree_t t, predef_attr_t predef,
    if (kind != T_SIGNAL_DECL && kind != T_PORT_DECL)
       return t;
 
-   char *sig_name LOCAL =
-      xasprintf("%s_%s", (predef == ATTR_DELAYED) ? "delayed" : "transaction",
-                istr(tree_ident(name)));
+   const char *prefix = NULL;
+   switch (predef) {
+   case ATTR_DELAYED:     prefix = "delayed"; break;
+   case ATTR_STABLE:      prefix = "stable"; break;
+   case ATTR_QUIET:       prefix = "quiet"; break;
+   case ATTR_TRANSACTION: prefix = "transaction"; break;
+   default: fatal_trace("invalid implicit signal attribute %d", predef);
+   }
+
+   char *sig_name LOCAL = xasprintf("%s_%s", prefix, istr(tree_ident(name)));
 
    tree_t s = tree_new(T_SIGNAL_DECL);
    tree_set_loc(s, tree_loc(t));
@@ -235,6 +245,7 @@ static tree_t simp_attr_delayed_transaction(tree_t t, predef_attr_t predef,
    tree_t p = tree_new(T_PROCESS);
    tree_set_loc(p, tree_loc(t));
    tree_set_ident(p, ident_prefix(tree_ident(s), ident_new("p"), '_'));
+   tree_add_attr_int(p, implicit_i, predef);
 
    tree_t r = make_ref(s);
 
@@ -273,6 +284,25 @@ static tree_t simp_attr_delayed_transaction(tree_t t, predef_attr_t predef,
       }
       break;
 
+   case ATTR_STABLE:
+   case ATTR_QUIET:
+      {
+         tree_set_value(s, get_bool_lit(t, true));
+
+         tree_t delay = tree_value(tree_param(t, 0));
+
+         tree_t w0 = tree_new(T_WAVEFORM);
+         tree_set_value(w0, get_bool_lit(t, false));
+
+         tree_t w1 = tree_new(T_WAVEFORM);
+         tree_set_value(w1, get_bool_lit(t, true));
+         tree_set_delay(w1, delay);
+
+         tree_add_waveform(a, w0);
+         tree_add_waveform(a, w1);
+      }
+      break;
+
    default:
       break;
    }
@@ -304,8 +334,10 @@ static tree_t simp_attr_ref(tree_t t, simp_ctx_t *ctx)
    const predef_attr_t predef = tree_attr_int(t, builtin_i, -1);
    switch (predef) {
    case ATTR_DELAYED:
+   case ATTR_STABLE:
+   case ATTR_QUIET:
    case ATTR_TRANSACTION:
-      return simp_attr_delayed_transaction(t, predef, ctx);
+      return simp_attr_implicit_signal(t, predef, ctx);
 
    case ATTR_LENGTH:
    case ATTR_LEFT:
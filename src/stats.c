@@ -0,0 +1,198 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "phase.h"
+#include "object.h"
+#include "vcode.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+//
+// Record the time and memory used by each compilation phase
+//
+
+#define MAX_DEPTH 8
+
+typedef struct {
+   const char *name;
+   int         depth;
+   int         parent;
+   unsigned    calls;
+   uint64_t    wall_ns;
+   uint64_t    cpu_ns;
+   unsigned    maxrss_kb;   // Peak at the end of the phase
+   int64_t     objects;     // Change in live trees and types
+   unsigned    units;       // Vcode units emitted
+   unsigned    ops;         // Vcode ops emitted
+} phase_stat_t;
+
+typedef struct {
+   int      index;
+   uint64_t wall_ns;
+   uint64_t cpu_ns;
+   size_t   objects;
+   unsigned units;
+   unsigned ops;
+} phase_frame_t;
+
+static phase_stat_t  *phases = NULL;
+static size_t         n_phases = 0;
+static size_t         max_phases = 0;
+static phase_frame_t  stack[MAX_DEPTH];
+static int            depth = 0;
+
+static uint64_t stats_clock(clockid_t which)
+{
+   struct timespec ts;
+   if (clock_gettime(which, &ts) != 0)
+      fatal_errno("clock_gettime");
+
+   return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static unsigned stats_maxrss(void)
+{
+   struct rusage ru;
+   if (getrusage(RUSAGE_SELF, &ru) < 0)
+      fatal_errno("getrusage");
+
+#ifdef __APPLE__
+   return ru.ru_maxrss / 1024;
+#else
+   return ru.ru_maxrss;
+#endif
+}
+
+static int stats_find_phase(const char *name)
+{
+   // Phases with the same name are combined only under the same parent
+   const int parent = (depth > 0) ? stack[depth - 1].index : -1;
+
+   for (size_t i = 0; i < n_phases; i++) {
+      if (phases[i].parent == parent && strcmp(phases[i].name, name) == 0)
+         return i;
+   }
+
+   if (phases == NULL) {
+      max_phases = 16;
+      phases = xmalloc(max_phases * sizeof(phase_stat_t));
+   }
+
+   phase_stat_t new = {
+      .name   = name,
+      .depth  = depth,
+      .parent = parent
+   };
+   ARRAY_APPEND(phases, new, n_phases, max_phases);
+
+   return n_phases - 1;
+}
+
+void stats_phase_begin(const char *name)
+{
+   if (depth == MAX_DEPTH)
+      fatal_trace("phase %s nested too deeply", name);
+
+   const int index = stats_find_phase(name);
+
+   phase_frame_t *f = &(stack[depth++]);
+   f->index   = index;
+   f->objects = object_count();
+   f->units   = vcode_emitted_units();
+   f->ops     = vcode_emitted_ops();
+   f->cpu_ns  = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+   f->wall_ns = stats_clock(CLOCK_MONOTONIC);
+}
+
+void stats_phase_end(void)
+{
+   const uint64_t wall_ns = stats_clock(CLOCK_MONOTONIC);
+   const uint64_t cpu_ns = stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+
+   assert(depth > 0);
+   phase_frame_t *f = &(stack[--depth]);
+   phase_stat_t *p = &(phases[f->index]);
+
+   p->calls++;
+   p->wall_ns  += wall_ns - f->wall_ns;
+   p->cpu_ns   += cpu_ns - f->cpu_ns;
+   p->objects  += (int64_t)object_count() - (int64_t)f->objects;
+   p->units    += vcode_emitted_units() - f->units;
+   p->ops      += vcode_emitted_ops() - f->ops;
+   p->maxrss_kb = MAX(p->maxrss_kb, stats_maxrss());
+}
+
+static void stats_report_json(void)
+{
+   FILE *f = stdout;
+   fprintf(f, "{\n  \"phases\": [");
+   for (size_t i = 0; i < n_phases; i++) {
+      const phase_stat_t *p = &(phases[i]);
+      fprintf(f, "%s\n    { \"name\": \"%s\", \"depth\": %d, "
+              "\"calls\": %u, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+              "\"maxrss_kb\": %u, \"objects\": %"PRIi64", "
+              "\"vcode_units\": %u, \"vcode_ops\": %u }",
+              i > 0 ? "," : "", p->name, p->depth, p->calls,
+              p->wall_ns / 1e6, p->cpu_ns / 1e6, p->maxrss_kb, p->objects,
+              p->units, p->ops);
+   }
+   fprintf(f, "\n  ]\n}\n");
+   fflush(f);
+}
+
+static void stats_report_text(void)
+{
+   printf("%-24s %6s %10s %10s %10s %9s %6s %8s\n", "Phase", "Calls",
+          "Wall ms", "CPU ms", "RSS kB", "Objects", "Units", "Ops");
+
+   uint64_t wall_ns = 0, cpu_ns = 0;
+   for (size_t i = 0; i < n_phases; i++) {
+      const phase_stat_t *p = &(phases[i]);
+      printf("%*s%-*s %6u %10.1f %10.1f %10u %9"PRIi64" %6u %8u\n",
+             p->depth * 2, "", 24 - p->depth * 2, p->name, p->calls,
+             p->wall_ns / 1e6, p->cpu_ns / 1e6, p->maxrss_kb, p->objects,
+             p->units, p->ops);
+
+      if (p->depth == 0) {
+         wall_ns += p->wall_ns;
+         cpu_ns  += p->cpu_ns;
+      }
+   }
+
+   printf("%-24s %6s %10.1f %10.1f\n", "Total", "", wall_ns / 1e6,
+          cpu_ns / 1e6);
+}
+
+void stats_phase_report(bool json)
+{
+   assert(depth == 0);
+
+   if (json)
+      stats_report_json();
+   else
+      stats_report_text();
+
+   // Each command in a chain like -a -e -r reports only its own phases
+   n_phases = 0;
+}
@@ -380,6 +380,21 @@ void tree_gc(void)
    object_gc();
 }
 
+tree_arena_t tree_arena_new(void)
+{
+   return (tree_arena_t)object_arena_new();
+}
+
+tree_arena_t tree_arena_select(tree_arena_t arena)
+{
+   return (tree_arena_t)object_arena_select((object_arena_t *)arena);
+}
+
+void tree_arena_free(tree_arena_t arena)
+{
+   object_arena_free((object_arena_t *)arena);
+}
+
 const loc_t *tree_loc(tree_t t)
 {
    assert(t != NULL);
@@ -454,6 +469,7 @@ tree_t tree_port(tree_t t, unsigned n)
 void tree_add_port(tree_t t, tree_t d)
 {
    tree_assert_decl(d);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_PORTS)->tree_array), d);
 }
 
@@ -482,6 +498,7 @@ tree_t tree_generic(tree_t t, unsigned n)
 void tree_add_generic(tree_t t, tree_t d)
 {
    tree_assert_decl(d);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_GENERICS)->tree_array), d);
 }
 
@@ -494,6 +511,7 @@ type_t tree_type(tree_t t)
 
 void tree_set_type(tree_t t, type_t ty)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_TYPE)->type = ty;
 }
 
@@ -518,6 +536,7 @@ void tree_add_param(tree_t t, tree_t e)
    assert(tree_kind(e) == T_PARAM);
    tree_assert_expr(tree_value(e));
 
+   object_write_barrier(&(t->object));
    tree_array_t *array = &(lookup_item(&tree_object, t, I_PARAMS)->tree_array);
 
    if (tree_subkind(e) == P_POS)
@@ -541,6 +560,7 @@ void tree_add_genmap(tree_t t, tree_t e)
 {
    tree_assert_expr(tree_value(e));
 
+   object_write_barrier(&(t->object));
    tree_array_t *array = &(lookup_item(&tree_object, t, I_GENMAPS)->tree_array);
 
    if (tree_subkind(e) == P_POS)
@@ -599,6 +619,7 @@ tree_t tree_char(tree_t t, unsigned n)
 void tree_add_char(tree_t t, tree_t ref)
 {
    assert((t->object.kind == T_LITERAL) && (tree_subkind(t) == L_STRING));
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_CHARS)->tree_array), ref);
 }
 
@@ -618,6 +639,7 @@ void tree_set_value(tree_t t, tree_t v)
 {
    if ((v != NULL) && (t->object.kind != T_ASSOC) && (t->object.kind != T_SPEC))
       tree_assert_expr(v);
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_VALUE)->tree = v;
 }
 
@@ -635,6 +657,7 @@ tree_t tree_decl(tree_t t, unsigned n)
 void tree_add_decl(tree_t t, tree_t d)
 {
    tree_assert_decl(d);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_DECLS)->tree_array), d);
 }
 
@@ -646,13 +669,17 @@ unsigned tree_stmts(tree_t t)
 tree_t tree_stmt(tree_t t, unsigned n)
 {
    item_t *item = lookup_item(&tree_object, t, I_STMTS);
+   object_array_check(&(item->tree_array));
    return tree_array_nth(&(item->tree_array), n);
 }
 
 void tree_add_stmt(tree_t t, tree_t s)
 {
    tree_assert_stmt(s);
-   tree_array_add(&(lookup_item(&tree_object, t, I_STMTS)->tree_array), s);
+   object_write_barrier(&(t->object));
+   tree_array_t *array = &(lookup_item(&tree_object, t, I_STMTS)->tree_array);
+   object_array_check(array);
+   tree_array_add(array, s);
 }
 
 unsigned tree_waveforms(tree_t t)
@@ -669,6 +696,7 @@ tree_t tree_waveform(tree_t t, unsigned n)
 void tree_add_waveform(tree_t t, tree_t w)
 {
    assert(w->object.kind == T_WAVEFORM);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_WAVES)->tree_array), w);
 }
 
@@ -686,6 +714,7 @@ tree_t tree_else_stmt(tree_t t, unsigned n)
 void tree_add_else_stmt(tree_t t, tree_t s)
 {
    tree_assert_stmt(s);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_ELSES)->tree_array), s);
 }
 
@@ -703,6 +732,7 @@ tree_t tree_cond(tree_t t, unsigned n)
 void tree_add_cond(tree_t t, tree_t c)
 {
    assert(c->object.kind == T_COND);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_CONDS)->tree_array), c);
 }
 
@@ -721,6 +751,7 @@ tree_t tree_delay(tree_t t)
 void tree_set_delay(tree_t t, tree_t d)
 {
    tree_assert_expr(d);
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_DELAY)->tree = d;
 }
 
@@ -738,6 +769,7 @@ tree_t tree_trigger(tree_t t, unsigned n)
 void tree_add_trigger(tree_t t, tree_t s)
 {
    tree_assert_expr(s);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_TRIGGERS)->tree_array), s);
 }
 
@@ -754,6 +786,7 @@ tree_t tree_op(tree_t t, unsigned n)
 void tree_add_op(tree_t t, tree_t s)
 {
    assert((s->object.kind == T_FUNC_DECL) || (s->object.kind == T_PROC_DECL));
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_OPS)->tree_array), s);
 }
 
@@ -766,6 +799,7 @@ tree_t tree_target(tree_t t)
 
 void tree_set_target(tree_t t, tree_t lhs)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_TARGET)->tree = lhs;
 }
 
@@ -783,6 +817,7 @@ bool tree_has_ref(tree_t t)
 
 void tree_set_ref(tree_t t, tree_t decl)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_REF)->tree = decl;
 }
 
@@ -817,6 +852,7 @@ bool tree_has_spec(tree_t t)
 
 void tree_set_spec(tree_t t, tree_t s)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_SPEC)->tree = s;
 }
 
@@ -835,6 +871,7 @@ void tree_add_context(tree_t t, tree_t ctx)
 {
    assert(ctx->object.kind == T_USE || ctx->object.kind == T_LIBRARY
           || ctx->object.kind == T_CTXREF);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&tree_object, t, I_CONTEXT)->tree_array), ctx);
 }
 
@@ -853,6 +890,7 @@ void tree_add_assoc(tree_t t, tree_t a)
 {
    assert(a->object.kind == T_ASSOC);
 
+   object_write_barrier(&(t->object));
    tree_array_t *array = &(lookup_item(&tree_object, t, I_ASSOCS)->tree_array);
 
    if (tree_subkind(a) == A_POS)
@@ -899,6 +937,7 @@ tree_t tree_severity(tree_t t)
 void tree_set_severity(tree_t t, tree_t s)
 {
    tree_assert_expr(s);
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_SEVERITY)->tree = s;
 }
 
@@ -917,6 +956,7 @@ bool tree_has_message(tree_t t)
 void tree_set_message(tree_t t, tree_t m)
 {
    tree_assert_expr(m);
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_MESSAGE)->tree = m;
 }
 
@@ -927,6 +967,7 @@ range_t tree_range(tree_t t)
 
 void tree_set_range(tree_t t, range_t r)
 {
+   object_write_barrier(&(t->object));
    item_t *item = lookup_item(&tree_object, t, I_RANGE);
    if (item->range == NULL)
       item->range = xmalloc(sizeof(range_t));
@@ -963,6 +1004,7 @@ tree_t tree_reject(tree_t t)
 void tree_set_reject(tree_t t, tree_t r)
 {
    tree_assert_expr(r);
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_REJECT)->tree = r;
 }
 
@@ -981,6 +1023,7 @@ tree_t tree_name(tree_t t)
 void tree_set_name(tree_t t, tree_t n)
 {
    tree_assert_expr(n);
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_NAME)->tree = n;
 }
 
@@ -991,6 +1034,7 @@ tree_t tree_file_mode(tree_t t)
 
 void tree_set_file_mode(tree_t t, tree_t m)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&tree_object, t, I_FILE_MODE)->tree = m;
 }
 
@@ -1194,16 +1238,24 @@ tree_t tree_attr_tree(tree_t t, ident_t name)
 void tree_add_attr_tree(tree_t t, ident_t name, tree_t val)
 {
    assert(val != NULL);
+   object_write_barrier(&(t->object));
    tree_add_attr(t, name, A_TREE)->tval = val;
 }
 
 tree_t tree_rewrite(tree_t t, tree_rewrite_fn_t fn, void *context)
+{
+   return tree_rewrite_skip(t, NULL, fn, context);
+}
+
+tree_t tree_rewrite_skip(tree_t t, ghash_t *skip, tree_rewrite_fn_t fn,
+                         void *context)
 {
    object_rewrite_ctx_t ctx = {
       .index      = 0,
       .generation = object_next_generation(),
       .fn         = fn,
-      .context    = context
+      .context    = context,
+      .skip       = skip
    };
 
    tree_t result = (tree_t)object_rewrite(&(t->object), &ctx);
@@ -1212,19 +1264,30 @@ tree_t tree_rewrite(tree_t t, tree_rewrite_fn_t fn, void *context)
 }
 
 tree_t tree_copy(tree_t t, tree_copy_fn_t fn, void *context)
+{
+   return tree_copy_shared(t, fn, context, NULL);
+}
+
+tree_t tree_copy_shared(tree_t t, tree_copy_fn_t fn, void *context,
+                        ghash_t *shared)
 {
    object_copy_ctx_t ctx = {
       .generation = object_next_generation(),
       .index      = 0,
       .callback   = fn,
       .context    = context,
-      .copied     = NULL
+      .copied     = NULL,
+      .shared     = shared
    };
 
    object_copy_mark(&(t->object), &ctx);
 
-   if (t->object.index == UINT32_MAX)
-      return t;   // Nothing to copy
+   if (t->object.index == UINT32_MAX) {
+      // Nothing to copy
+      if (shared != NULL)
+         ghash_put(shared, t, t);
+      return t;
+   }
 
    ctx.copied = xcalloc(sizeof(void *) * ctx.index);
 
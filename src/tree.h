@@ -22,6 +22,7 @@
 #include "ident.h"
 #include "prim.h"
 #include "type.h"
+#include "hash.h"
 
 #include <stdint.h>
 
@@ -335,8 +336,23 @@ tree_t tree_rewrite(tree_t t, tree_rewrite_fn_t fn, void *context);
 typedef bool (*tree_copy_fn_t)(tree_t t, void *context);
 tree_t tree_copy(tree_t t, tree_copy_fn_t fn, void *context);
 
+// Copy as tree_copy and add the root of each subtree the copy shares
+// with the original to the set `shared'; passing the same set to
+// tree_rewrite_skip then leaves those subtrees untouched
+tree_t tree_copy_shared(tree_t t, tree_copy_fn_t fn, void *context,
+                        ghash_t *shared);
+tree_t tree_rewrite_skip(tree_t t, ghash_t *skip, tree_rewrite_fn_t fn,
+                         void *context);
+
 void tree_gc(void);
 
+// Trees and types created while an arena is selected are allocated
+// from it rather than the garbage collected heap and are all freed
+// together by tree_arena_free
+tree_arena_t tree_arena_new(void);
+tree_arena_t tree_arena_select(tree_arena_t arena);
+void tree_arena_free(tree_arena_t arena);
+
 tree_wr_ctx_t tree_write_begin(fbuf_t *f);
 void tree_write(tree_t t, tree_wr_ctx_t ctx);
 void tree_write_end(tree_wr_ctx_t ctx);
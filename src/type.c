@@ -261,11 +261,13 @@ range_t type_dim(type_t t, unsigned n)
 
 void type_add_dim(type_t t, range_t r)
 {
+   object_write_barrier(&(t->object));
    range_array_add(&(lookup_item(&type_object, t, I_DIMS)->range_array), r);
 }
 
 void type_change_dim(type_t t, unsigned n, range_t r)
 {
+   object_write_barrier(&(t->object));
    item_t *item = lookup_item(&type_object, t, I_DIMS);
    assert(n < item->range_array.count);
    item->range_array.items[n] = r;
@@ -280,6 +282,7 @@ type_t type_base(type_t t)
 
 void type_set_base(type_t t, type_t b)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&type_object, t, I_BASE)->type = b;
 }
 
@@ -298,6 +301,7 @@ type_t type_elem(type_t t)
 
 void type_set_elem(type_t t, type_t e)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&type_object, t, I_ELEM)->type = e;
 }
 
@@ -384,6 +388,7 @@ tree_t type_unit(type_t t, unsigned n)
 
 void type_add_unit(type_t t, tree_t u)
 {
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&type_object, t, I_UNITS)->tree_array), u);
 }
 
@@ -401,6 +406,7 @@ tree_t type_enum_literal(type_t t, unsigned n)
 void type_enum_add_literal(type_t t, tree_t lit)
 {
    assert(tree_kind(lit) == T_ENUM_LIT);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&type_object, t, I_LITERALS)->tree_array), lit);
 }
 
@@ -417,11 +423,13 @@ type_t type_param(type_t t, unsigned n)
 
 void type_add_param(type_t t, type_t p)
 {
+   object_write_barrier(&(t->object));
    type_array_add(&(lookup_item(&type_object, t, I_PTYPES)->type_array), p);
 }
 
 void type_change_param(type_t t, unsigned n, type_t p)
 {
+   object_write_barrier(&(t->object));
    type_array_t *a = &(lookup_item(&type_object, t, I_PTYPES)->type_array);
    assert(n < a->count);
    a->items[n] = p;
@@ -448,6 +456,7 @@ tree_t type_field(type_t t, unsigned n)
 void type_add_field(type_t t, tree_t p)
 {
    assert(tree_kind(p) == T_FIELD_DECL);
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&type_object, t, I_FIELDS)->tree_array), p);
 }
 
@@ -464,6 +473,7 @@ tree_t type_decl(type_t t, unsigned n)
 
 void type_add_decl(type_t t, tree_t p)
 {
+   object_write_barrier(&(t->object));
    tree_array_add(&(lookup_item(&type_object, t, I_DECLS)->tree_array), p);
 }
 
@@ -476,6 +486,7 @@ type_t type_result(type_t t)
 
 void type_set_result(type_t t, type_t r)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&type_object, t, I_RESULT)->type = r;
 }
 
@@ -494,11 +505,13 @@ unsigned type_index_constrs(type_t t)
 
 void type_add_index_constr(type_t t, type_t c)
 {
+   object_write_barrier(&(t->object));
    type_array_add(&(lookup_item(&type_object, t, I_CONSTR)->type_array), c);
 }
 
 void type_change_index_constr(type_t t, unsigned n, type_t c)
 {
+   object_write_barrier(&(t->object));
    type_array_t *a = &(lookup_item(&type_object, t, I_CONSTR)->type_array);
    assert(n < a->count);
    a->items[n] = c;
@@ -512,6 +525,7 @@ type_t type_index_constr(type_t t, unsigned n)
 
 void type_set_resolution(type_t t, tree_t r)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&type_object, t, I_RESOLUTION)->tree = r;
 }
 
@@ -534,6 +548,7 @@ type_t type_access(type_t t)
 
 void type_set_access(type_t t, type_t a)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&type_object, t, I_ACCESS)->type = a;
 }
 
@@ -544,6 +559,7 @@ type_t type_file(type_t t)
 
 void type_set_file(type_t t, type_t f)
 {
+   object_write_barrier(&(t->object));
    lookup_item(&type_object, t, I_FILE)->type = f;
 }
 
@@ -558,6 +574,7 @@ tree_t type_body(type_t t)
 void type_set_body(type_t t, tree_t b)
 {
    assert(t->object.kind == T_PROTECTED);
+   object_write_barrier(&(t->object));
    item_t *item = lookup_item(&type_object, t, I_REF);
    item->tree = b;
 }
@@ -1147,6 +1147,124 @@ void *mmap_guarded(size_t sz, const char *tag)
    return ptr;
 }
 
+#define HUGE_PAGE_SZ (2 * 1024 * 1024)
+
+void *mmap_huge(size_t sz, bool explicit)
+{
+   // Map zeroed memory backed by huge pages where possible. Explicit
+   // huge pages must be reserved by the administrator so fall back to
+   // requesting transparent huge pages if none are available.
+
+   sz = (sz + HUGE_PAGE_SZ - 1) & ~(size_t)(HUGE_PAGE_SZ - 1);
+
+#if (defined __APPLE__ || defined __OpenBSD__)
+   const int flags = MAP_PRIVATE | MAP_ANON;
+#else
+   const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+
+#ifdef MAP_HUGETLB
+   if (explicit) {
+      void *ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+                       flags | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED)
+         return ptr;
+
+      static bool warned = false;
+      if (!warned) {
+         warnf("cannot allocate explicit huge pages: %s", strerror(errno));
+         warned = true;
+      }
+   }
+#endif
+
+   // Over-allocate so the start can be aligned to a huge page boundary
+   // which is required for the kernel to back it with huge pages
+   void *ptr = mmap(NULL, sz + HUGE_PAGE_SZ, PROT_READ | PROT_WRITE,
+                    flags, -1, 0);
+   if (ptr == MAP_FAILED)
+      fatal_errno("mmap");
+
+   const uintptr_t base = (uintptr_t)ptr;
+   const uintptr_t aligned =
+      (base + HUGE_PAGE_SZ - 1) & ~(uintptr_t)(HUGE_PAGE_SZ - 1);
+
+   if (aligned > base)
+      munmap(ptr, aligned - base);
+   if (aligned + sz < base + sz + HUGE_PAGE_SZ)
+      munmap((void *)(aligned + sz), base + HUGE_PAGE_SZ - aligned);
+
+#ifdef MADV_HUGEPAGE
+   madvise((void *)aligned, sz, MADV_HUGEPAGE);
+#endif
+
+   return (void *)aligned;
+}
+
+void munmap_huge(void *ptr, size_t sz)
+{
+   sz = (sz + HUGE_PAGE_SZ - 1) & ~(size_t)(HUGE_PAGE_SZ - 1);
+
+   if (munmap(ptr, sz) != 0)
+      fatal_errno("munmap");
+}
+
+void *mmap_sparse(size_t sz)
+{
+   // Reserve zeroed memory which the kernel only backs with physical
+   // pages when they are first written: untouched pages all share the
+   // single zero page copy-on-write
+
+#if (defined __APPLE__ || defined __OpenBSD__)
+   int flags = MAP_PRIVATE | MAP_ANON;
+#else
+   int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+#ifdef MAP_NORESERVE
+   flags |= MAP_NORESERVE;
+#endif
+
+   void *ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, flags, -1, 0);
+   if (ptr == MAP_FAILED)
+      fatal_errno("mmap");
+
+   return ptr;
+}
+
+void munmap_sparse(void *ptr, size_t sz)
+{
+   if (munmap(ptr, sz) != 0)
+      fatal_errno("munmap");
+}
+
+void copy_sparse(void *dest, const void *src, size_t sz)
+{
+   // Copy into memory from mmap_sparse without writing to any page
+   // where the source is all zero so those pages stay unmaterialised
+
+   const size_t pagesz = sysconf(_SC_PAGESIZE);
+   const uint8_t *sp = src;
+   uint8_t *dp = dest;
+
+   // Work in blocks aligned to the destination pages
+   size_t block = pagesz - ((uintptr_t)dp & (pagesz - 1));
+   while (sz > 0) {
+      block = MIN(block, sz);
+
+      bool zero = true;
+      for (size_t i = 0; zero && i < block; i++)
+         zero = (sp[i] == 0);
+
+      if (!zero)
+         memcpy(dp, sp, block);
+
+      sp += block;
+      dp += block;
+      sz -= block;
+      block = pagesz;
+   }
+}
+
 int checked_sprintf(char *buf, int len, const char *fmt, ...)
 {
    assert(len > 0);
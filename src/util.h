@@ -103,6 +103,11 @@ int ilog2(int64_t n) __attribute__((pure));
 int64_t ipow(int64_t x, int64_t y)  __attribute__((pure));
 
 void *mmap_guarded(size_t sz, const char *tag);
+void *mmap_huge(size_t sz, bool explicit);
+void munmap_huge(void *ptr, size_t sz);
+void *mmap_sparse(size_t sz);
+void munmap_sparse(void *ptr, size_t sz);
+void copy_sparse(void *dest, const void *src, size_t sz);
 
 typedef struct text_buf text_buf_t;
 
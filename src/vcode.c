@@ -18,6 +18,7 @@
 #include "util.h"
 #include "vcode.h"
 #include "array.h"
+#include "hash.h"
 
 #include <assert.h>
 #include <inttypes.h>
@@ -132,6 +133,8 @@ struct vcode_unit {
    param_array_t  params;
    unsigned       depth;
    bool           pure;
+   ghash_t       *extern_vars;
+   ghash_t       *extern_signals;
 };
 
 #define MASK_CONTEXT(x)   ((x) >> 24)
@@ -155,6 +158,11 @@ struct vcode_unit {
 
 static vcode_unit_t  active_unit = NULL;
 static vcode_block_t active_block = VCODE_INVALID_BLOCK;
+static unsigned      elided_checks = 0;
+static unsigned      emitted_units = 0;
+static unsigned      emitted_ops = 0;
+static unsigned      live_units = 0;
+static unsigned      peak_units = 0;
 
 static inline int64_t sadd64(int64_t a, int64_t b)
 {
@@ -218,6 +226,7 @@ static op_t *vcode_add_op(vcode_op_t kind)
    op->kind   = kind;
    op->result = VCODE_INVALID_REG;
 
+   emitted_ops++;
    return op;
 }
 
@@ -562,12 +571,663 @@ void vcode_opt(void)
    free(uses);
 }
 
+typedef struct {
+   vcode_op_t   kind;
+   int32_t      key;
+   int64_t      value;
+   vcode_type_t type;
+   vcode_reg_t  reg;
+   vcode_reg_t  reg2;
+} avail_t;
+
+DECLARE_AND_DEFINE_ARRAY(avail);
+
+static avail_t *vcode_find_avail(avail_array_t *avail, vcode_op_t kind,
+                                 int32_t key, int64_t value, vcode_type_t type)
+{
+   for (int i = avail->count - 1; i >= 0; i--) {
+      avail_t *a = &(avail->items[i]);
+      if (a->kind != kind || a->key != key || a->value != value)
+         continue;
+      else if (type == VCODE_INVALID_TYPE || vtype_eq(type, a->type))
+         return a;
+   }
+
+   return NULL;
+}
+
+static void vcode_kill_avail(avail_array_t *avail, vcode_op_t kind,
+                             int32_t key)
+{
+   // Entries are never removed as the array cannot shrink to zero
+   for (int i = 0; i < avail->count; i++) {
+      avail_t *a = &(avail->items[i]);
+      if (a->kind == kind && (key == -1 || a->key == key))
+         a->kind = VCODE_OP_COMMENT;
+   }
+}
+
+static avail_t *vcode_add_avail(avail_array_t *avail, vcode_op_t kind,
+                                int32_t key, int64_t value, vcode_type_t type,
+                                vcode_reg_t reg)
+{
+   avail_t *a = avail_array_alloc(avail);
+   a->kind  = kind;
+   a->key   = key;
+   a->value = value;
+   a->type  = type;
+   a->reg   = reg;
+   a->reg2  = VCODE_INVALID_REG;
+   return a;
+}
+
+static bool vcode_avail_is_memory(const avail_t *a)
+{
+   // Facts about variables only hold along a single path whereas facts
+   // about registers hold in every block the definition dominates
+   return a->kind == VCODE_OP_LOAD || a->kind == VCODE_OP_RESOLVED_ADDRESS;
+}
+
+static void vcode_erase_op(op_t *o, char *comment)
+{
+   o->kind    = VCODE_OP_COMMENT;
+   o->comment = comment;
+   vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+}
+
+static void vcode_erase_check(op_t *o, char *comment)
+{
+   vcode_erase_op(o, comment);
+   elided_checks++;
+}
+
+static void vcode_fold_to_const(op_t *o, int64_t value)
+{
+   o->kind  = VCODE_OP_CONST;
+   o->value = value;
+   o->type  = vcode_reg_type(o->result);
+   vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+
+   vcode_reg_data(o->result)->bounds = vtype_int(value, value);
+}
+
+static void vcode_fold_op(op_t *o)
+{
+   int64_t lconst, rconst;
+   if (o->args.count != 2
+       || !vcode_reg_const(o->args.items[0], &lconst)
+       || !vcode_reg_const(o->args.items[1], &rconst))
+      return;
+
+   switch (o->kind) {
+   case VCODE_OP_ADD:
+      vcode_fold_to_const(o, lconst + rconst);
+      break;
+   case VCODE_OP_SUB:
+      vcode_fold_to_const(o, lconst - rconst);
+      break;
+   case VCODE_OP_MUL:
+      vcode_fold_to_const(o, lconst * rconst);
+      break;
+   case VCODE_OP_CMP:
+      switch (o->cmp) {
+      case VCODE_CMP_EQ:
+         vcode_fold_to_const(o, lconst == rconst);
+         break;
+      case VCODE_CMP_NEQ:
+         vcode_fold_to_const(o, lconst != rconst);
+         break;
+      case VCODE_CMP_LT:
+         vcode_fold_to_const(o, lconst < rconst);
+         break;
+      case VCODE_CMP_GT:
+         vcode_fold_to_const(o, lconst > rconst);
+         break;
+      case VCODE_CMP_LEQ:
+         vcode_fold_to_const(o, lconst <= rconst);
+         break;
+      case VCODE_CMP_GEQ:
+         vcode_fold_to_const(o, lconst >= rconst);
+         break;
+      default:
+         break;
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+static vcode_reg_t vcode_resolve_alias(const vcode_reg_t *alias,
+                                       vcode_reg_t reg)
+{
+   while (alias[reg] != VCODE_INVALID_REG)
+      reg = alias[reg];
+   return reg;
+}
+
+static bool vcode_var_forwardable(vcode_var_t var, const bool *aliased)
+{
+   if (MASK_CONTEXT(var) == active_unit->depth)
+      return !aliased[MASK_INDEX(var)];
+   else
+      return vcode_var_data(var)->is_const;
+}
+
+static void vcode_forward_bounds(op_t *o, avail_array_t *avail)
+{
+   const vcode_reg_t reg = o->args.items[0];
+
+   if (vtype_includes(o->type, vcode_reg_data(reg)->bounds)) {
+      vcode_erase_check(o, xasprintf("Elided bounds check for r%d", reg));
+      return;
+   }
+
+   // A check that has already passed on every path here implies any
+   // later check against a wider range
+   for (int i = 0; i < avail->count; i++) {
+      const avail_t *a = &(avail->items[i]);
+      if (a->kind == VCODE_OP_BOUNDS && a->key == reg
+          && vtype_includes(o->type, a->type)) {
+         vcode_erase_check(o, xasprintf("Redundant bounds check for r%d",
+                                        reg));
+         return;
+      }
+   }
+
+   vcode_add_avail(avail, VCODE_OP_BOUNDS, reg, 0, o->type, reg);
+}
+
+static void vcode_forward_dynamic_bounds(op_t *o, avail_array_t *avail)
+{
+   const vcode_reg_t reg  = o->args.items[0];
+   const vcode_reg_t low  = o->args.items[1];
+   const vcode_reg_t high = o->args.items[2];
+
+   int64_t lconst, hconst;
+   if (reg == low || reg == high) {
+      vcode_erase_check(o, xasprintf("Elided dynamic bounds check for r%d",
+                                     reg));
+      return;
+   }
+   else if (vcode_reg_const(low, &lconst) && vcode_reg_const(high, &hconst)) {
+      vcode_type_t bounds = vcode_reg_bounds(reg);
+      if (lconst <= vtype_low(bounds) && hconst >= vtype_high(bounds)) {
+         vcode_erase_check(o, xasprintf("Elided dynamic bounds check for r%d",
+                                        reg));
+         return;
+      }
+   }
+
+   for (int i = 0; i < avail->count; i++) {
+      const avail_t *a = &(avail->items[i]);
+      if (a->kind == VCODE_OP_DYNAMIC_BOUNDS && a->key == reg
+          && a->reg == low && a->reg2 == high) {
+         vcode_erase_check(o, xasprintf("Redundant dynamic bounds check "
+                                        "for r%d", reg));
+         return;
+      }
+   }
+
+   avail_t *a = vcode_add_avail(avail, VCODE_OP_DYNAMIC_BOUNDS, reg, 0,
+                                VCODE_INVALID_TYPE, low);
+   a->reg2 = high;
+}
+
+static void vcode_forward_index_check(op_t *o, avail_array_t *avail)
+{
+   const vcode_reg_t rlow  = o->args.items[0];
+   const vcode_reg_t rhigh = o->args.items[1];
+
+   if (o->args.count == 2
+       && vtype_includes(o->type, vcode_reg_data(rlow)->bounds)
+       && vtype_includes(o->type, vcode_reg_data(rhigh)->bounds)) {
+      vcode_erase_check(o, xasprintf("Elided index check for r%d and r%d",
+                                     rlow, rhigh));
+      return;
+   }
+
+   const vcode_reg_t blow  =
+      o->args.count == 4 ? o->args.items[2] : VCODE_INVALID_REG;
+   const vcode_reg_t bhigh =
+      o->args.count == 4 ? o->args.items[3] : VCODE_INVALID_REG;
+
+   for (int i = 0; i < avail->count; i++) {
+      const avail_t *a = &(avail->items[i]);
+      if (a->kind != VCODE_OP_INDEX_CHECK || a->key != rlow
+          || a->value != rhigh || a->reg != blow || a->reg2 != bhigh)
+         continue;
+      else if (blow != VCODE_INVALID_REG || vtype_includes(o->type, a->type)) {
+         vcode_erase_check(o, xasprintf("Redundant index check for r%d "
+                                        "and r%d", rlow, rhigh));
+         return;
+      }
+   }
+
+   avail_t *a = vcode_add_avail(avail, VCODE_OP_INDEX_CHECK, rlow, rhigh,
+                                o->type, blow);
+   a->reg2 = bhigh;
+}
+
+static void vcode_forward_block(block_t *b, avail_array_t *avail,
+                                vcode_reg_t *alias, const bool *aliased)
+{
+   for (int i = 0; i < b->ops.count; i++) {
+      op_t *o = &(b->ops.items[i]);
+
+      for (int j = 0; j < o->args.count; j++) {
+         if (o->args.items[j] != VCODE_INVALID_REG)
+            o->args.items[j] = vcode_resolve_alias(alias, o->args.items[j]);
+      }
+
+      vcode_fold_op(o);
+
+      switch (o->kind) {
+      case VCODE_OP_CONST:
+         {
+            avail_t *a = vcode_find_avail(avail, VCODE_OP_CONST, 0,
+                                          o->value, o->type);
+            if (a != NULL) {
+               alias[o->result] = a->reg;
+               vcode_erase_op(o, xasprintf("Duplicate constant r%d",
+                                           o->result));
+            }
+            else
+               vcode_add_avail(avail, VCODE_OP_CONST, 0, o->value,
+                               o->type, o->result);
+         }
+         break;
+
+      case VCODE_OP_NETS:
+         {
+            avail_t *a = vcode_find_avail(avail, VCODE_OP_NETS, o->signal,
+                                          0, VCODE_INVALID_TYPE);
+            if (a != NULL) {
+               alias[o->result] = a->reg;
+               vcode_erase_op(o, xasprintf("Duplicate nets r%d", o->result));
+            }
+            else
+               vcode_add_avail(avail, VCODE_OP_NETS, o->signal, 0,
+                               VCODE_INVALID_TYPE, o->result);
+         }
+         break;
+
+      case VCODE_OP_UARRAY_LEFT:
+      case VCODE_OP_UARRAY_RIGHT:
+      case VCODE_OP_UARRAY_DIR:
+      case VCODE_OP_UARRAY_LEN:
+         {
+            vcode_type_t rtype = vcode_reg_type(o->result);
+            avail_t *a = vcode_find_avail(avail, o->kind, o->args.items[0],
+                                          o->dim, rtype);
+            if (a != NULL) {
+               alias[o->result] = a->reg;
+               vcode_erase_op(o, xasprintf("Duplicate %s r%d",
+                                           vcode_op_string(o->kind),
+                                           o->result));
+            }
+            else
+               vcode_add_avail(avail, o->kind, o->args.items[0], o->dim,
+                               rtype, o->result);
+         }
+         break;
+
+      case VCODE_OP_LOAD:
+         if (vcode_var_forwardable(o->address, aliased)) {
+            avail_t *a = vcode_find_avail(avail, VCODE_OP_LOAD, o->address,
+                                          0, VCODE_INVALID_TYPE);
+            if (a != NULL) {
+               alias[o->result] = a->reg;
+               vcode_erase_op(o, xasprintf("Redundant load of %s",
+                                           istr(vcode_var_name(o->address))));
+            }
+            else
+               vcode_add_avail(avail, VCODE_OP_LOAD, o->address, 0,
+                               VCODE_INVALID_TYPE, o->result);
+         }
+         break;
+
+      case VCODE_OP_STORE:
+         vcode_kill_avail(avail, VCODE_OP_RESOLVED_ADDRESS, o->address);
+         if (vcode_var_forwardable(o->address, aliased)) {
+            avail_t *a = vcode_find_avail(avail, VCODE_OP_LOAD, o->address,
+                                          0, VCODE_INVALID_TYPE);
+            if (a != NULL && a->reg == o->args.items[0])
+               vcode_erase_op(o, xasprintf("Redundant store to %s",
+                                           istr(vcode_var_name(o->address))));
+            else if (a != NULL)
+               a->reg = o->args.items[0];
+            else
+               vcode_add_avail(avail, VCODE_OP_LOAD, o->address, 0,
+                               VCODE_INVALID_TYPE, o->args.items[0]);
+         }
+         break;
+
+      case VCODE_OP_RESOLVED_ADDRESS:
+         if (vcode_find_avail(avail, VCODE_OP_RESOLVED_ADDRESS, o->address,
+                              o->signal, VCODE_INVALID_TYPE) != NULL)
+            vcode_erase_op(o, xasprintf("Duplicate resolved address of %s",
+                                        istr(vcode_var_name(o->address))));
+         else {
+            vcode_kill_avail(avail, VCODE_OP_LOAD, o->address);
+            vcode_add_avail(avail, VCODE_OP_RESOLVED_ADDRESS, o->address,
+                            o->signal, VCODE_INVALID_TYPE, VCODE_INVALID_REG);
+         }
+         break;
+
+      case VCODE_OP_BOUNDS:
+         if (vcode_reg_kind(o->args.items[0]) == VCODE_TYPE_INT)
+            vcode_forward_bounds(o, avail);
+         break;
+
+      case VCODE_OP_DYNAMIC_BOUNDS:
+         vcode_forward_dynamic_bounds(o, avail);
+         break;
+
+      case VCODE_OP_INDEX_CHECK:
+         vcode_forward_index_check(o, avail);
+         break;
+
+      case VCODE_OP_COND:
+         {
+            int64_t tconst;
+            if (vcode_reg_const(o->args.items[0], &tconst)) {
+               o->kind = VCODE_OP_JUMP;
+               o->targets.items[0] = o->targets.items[!tconst];
+               vcode_block_array_resize(&(o->targets), 1, VCODE_INVALID_BLOCK);
+               vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+            }
+         }
+         break;
+
+      case VCODE_OP_NESTED_FCALL:
+      case VCODE_OP_NESTED_PCALL:
+      case VCODE_OP_NESTED_RESUME:
+         // Nested subprograms may modify variables in this unit
+         vcode_kill_avail(avail, VCODE_OP_LOAD, -1);
+         break;
+
+      default:
+         break;
+      }
+   }
+}
+
+static int vcode_dom_intersect(const int *idom, const int *order, int a, int b)
+{
+   while (a != b) {
+      while (order[a] < order[b])
+         a = idom[a];
+      while (order[b] < order[a])
+         b = idom[b];
+   }
+
+   return a;
+}
+
+static void vcode_dominators(int nblocks, int **preds, const int *npreds,
+                             int *idom)
+{
+   // Cooper, Harvey and Kennedy's iterative algorithm over a reverse
+   // post-order: the extra node at index nblocks is a virtual root that
+   // precedes the entry block and every resume point
+
+   const int root = nblocks;
+
+   int *order = xmalloc((nblocks + 1) * sizeof(int));
+   int *rpo   = xmalloc((nblocks + 1) * sizeof(int));
+   int *stack = xmalloc((nblocks + 1) * sizeof(int));
+   int *next  = xmalloc((nblocks + 1) * sizeof(int));
+
+   for (int i = 0; i <= nblocks; i++) {
+      order[i] = -1;
+      idom[i]  = -1;
+      next[i]  = 0;
+   }
+
+   // Depth first search over successor lists built from the predecessor
+   // lists so post-order numbers increase towards the root
+   int **succs = xmalloc((nblocks + 1) * sizeof(int *));
+   int *nsuccs = xmalloc((nblocks + 1) * sizeof(int));
+   memset(nsuccs, '\0', (nblocks + 1) * sizeof(int));
+   for (int i = 0; i < nblocks; i++) {
+      for (int j = 0; j < npreds[i]; j++)
+         nsuccs[preds[i][j]]++;
+   }
+   for (int i = 0; i <= nblocks; i++) {
+      succs[i] = xmalloc((nsuccs[i] + 1) * sizeof(int));
+      nsuccs[i] = 0;
+   }
+   for (int i = 0; i < nblocks; i++) {
+      for (int j = 0; j < npreds[i]; j++) {
+         const int p = preds[i][j];
+         succs[p][nsuccs[p]++] = i;
+      }
+   }
+
+   int sp = 0, count = 0;
+   stack[sp++] = root;
+   order[root] = -2;
+   while (sp > 0) {
+      const int n = stack[sp - 1];
+      if (next[n] < nsuccs[n]) {
+         const int s = succs[n][next[n]++];
+         if (order[s] == -1) {
+            order[s] = -2;
+            stack[sp++] = s;
+         }
+      }
+      else {
+         order[n] = count;
+         rpo[count++] = n;
+         sp--;
+      }
+   }
+
+   idom[root] = root;
+
+   bool changed;
+   do {
+      changed = false;
+      for (int i = count - 2; i >= 0; i--) {
+         const int b = rpo[i];
+         int new_idom = -1;
+         for (int j = 0; j < npreds[b]; j++) {
+            const int p = preds[b][j];
+            if (idom[p] == -1)
+               continue;
+            else if (new_idom == -1)
+               new_idom = p;
+            else
+               new_idom = vcode_dom_intersect(idom, order, p, new_idom);
+         }
+
+         if (idom[b] != new_idom) {
+            idom[b] = new_idom;
+            changed = true;
+         }
+      }
+   } while (changed);
+
+   for (int i = 0; i <= nblocks; i++)
+      free(succs[i]);
+   free(succs);
+   free(nsuccs);
+   free(next);
+   free(stack);
+   free(rpo);
+   free(order);
+}
+
+void vcode_opt_forward(void)
+{
+   // Forward constants, loaded and stored values, nets, resolved
+   // addresses and passed checks through each block and into the blocks
+   // it dominates, then fold the operations and remove the checks that
+   // become redundant as a result
+
+   const int nblocks = active_unit->blocks.count;
+   const int nregs   = active_unit->regs.count;
+   const int nvars   = active_unit->vars.count;
+   const int root    = nblocks;
+
+   int **preds = xmalloc(nblocks * sizeof(int *));
+   int *npreds = xmalloc(nblocks * sizeof(int));
+   int *maxpreds = xmalloc(nblocks * sizeof(int));
+   for (int i = 0; i < nblocks; i++) {
+      preds[i]    = xmalloc(sizeof(int));
+      npreds[i]   = 0;
+      maxpreds[i] = 1;
+   }
+
+   bool *aliased = xmalloc((nvars + 1) * sizeof(bool));
+   memset(aliased, '\0', (nvars + 1) * sizeof(bool));
+
+   preds[0][npreds[0]++] = root;
+
+   for (int i = 0; i < nblocks; i++) {
+      block_t *b = &(active_unit->blocks.items[i]);
+      for (int j = 0; j < b->ops.count; j++) {
+         const op_t *o = &(b->ops.items[j]);
+
+         // Resume points after a wait or procedure call are entered from
+         // the top of the process so registers are not live into them
+         const bool local = o->kind == VCODE_OP_JUMP
+            || o->kind == VCODE_OP_COND || o->kind == VCODE_OP_CASE;
+
+         for (int k = 0; k < o->targets.count; k++) {
+            const vcode_block_t t = o->targets.items[k];
+            if (npreds[t] == maxpreds[t]) {
+               maxpreds[t] *= 2;
+               preds[t] = xrealloc(preds[t], maxpreds[t] * sizeof(int));
+            }
+            preds[t][npreds[t]++] = local ? i : root;
+         }
+
+         if (o->kind == VCODE_OP_INDEX
+             && MASK_CONTEXT(o->address) == active_unit->depth)
+            aliased[MASK_INDEX(o->address)] = true;
+      }
+   }
+
+   int *idom = xmalloc((nblocks + 1) * sizeof(int));
+   vcode_dominators(nblocks, preds, npreds, idom);
+
+   vcode_reg_t *alias = xmalloc(nregs * sizeof(vcode_reg_t));
+   for (int i = 0; i < nregs; i++)
+      alias[i] = VCODE_INVALID_REG;
+
+   avail_array_t *avail = xmalloc(nblocks * sizeof(avail_array_t));
+   memset(avail, '\0', nblocks * sizeof(avail_array_t));
+
+   for (int i = 0; i < nblocks; i++) {
+      // Code generation visits blocks in order so a register must be
+      // defined in an earlier block before it can be reused in this one
+      const int dom = idom[i];
+      if (dom >= 0 && dom < i) {
+         const bool single = npreds[i] == 1 && preds[i][0] == dom;
+         const avail_array_t *from = &(avail[dom]);
+         for (int j = 0; j < from->count; j++) {
+            const avail_t *a = &(from->items[j]);
+            if (a->kind == VCODE_OP_COMMENT)
+               continue;
+            else if (single || !vcode_avail_is_memory(a))
+               avail_array_add(&(avail[i]), *a);
+         }
+      }
+
+      vcode_forward_block(&(active_unit->blocks.items[i]), &(avail[i]),
+                          alias, aliased);
+   }
+
+   // Uses in blocks visited before their replacement was known
+   for (int i = 0; i < nblocks; i++) {
+      block_t *b = &(active_unit->blocks.items[i]);
+      for (int j = 0; j < b->ops.count; j++) {
+         op_t *o = &(b->ops.items[j]);
+         for (int k = 0; k < o->args.count; k++) {
+            if (o->args.items[k] != VCODE_INVALID_REG)
+               o->args.items[k] = vcode_resolve_alias(alias, o->args.items[k]);
+         }
+      }
+   }
+
+   for (int i = 0; i < nblocks; i++) {
+      free(avail[i].items);
+      free(preds[i]);
+   }
+   free(avail);
+   free(alias);
+   free(idom);
+   free(aliased);
+   free(maxpreds);
+   free(npreds);
+   free(preds);
+}
+
+unsigned vcode_elided_checks(void)
+{
+   return elided_checks;
+}
+
+unsigned vcode_emitted_units(void)
+{
+   return emitted_units;
+}
+
+unsigned vcode_emitted_ops(void)
+{
+   return emitted_ops;
+}
+
+unsigned vcode_peak_units(void)
+{
+   return peak_units;
+}
+
 void vcode_close(void)
 {
    active_unit  = NULL;
    active_block = -1;
 }
 
+void vcode_unit_unref(vcode_unit_t unit)
+{
+   assert(unit != NULL);
+
+   if (unit == active_unit)
+      vcode_close();
+
+   for (unsigned i = 0; i < unit->blocks.count; i++) {
+      block_t *b = &(unit->blocks.items[i]);
+      for (unsigned j = 0; j < b->ops.count; j++) {
+         op_t *o = &(b->ops.items[j]);
+         if (o->kind == VCODE_OP_COMMENT)
+            free(o->comment);
+         free(o->args.items);
+         free(o->targets.items);
+      }
+      free(b->ops.items);
+   }
+   free(unit->blocks.items);
+
+   for (unsigned i = 0; i < unit->types.count; i++) {
+      vtype_t *vt = &(unit->types.items[i]);
+      if (vt->kind == VCODE_TYPE_RECORD)
+         free(vt->fields.items);
+   }
+   free(unit->types.items);
+
+   free(unit->regs.items);
+   free(unit->vars.items);
+   free(unit->signals.items);
+   free(unit->params.items);
+   free(unit);
+
+   assert(live_units > 0);
+   live_units--;
+}
+
 int vcode_count_blocks(void)
 {
    assert(active_unit != NULL);
@@ -700,7 +1360,8 @@ unsigned vcode_get_subkind(int op)
    assert(o->kind == VCODE_OP_SCHED_EVENT || o->kind == VCODE_OP_BOUNDS
           || o->kind == VCODE_OP_VEC_LOAD || o->kind == VCODE_OP_BIT_VEC_OP
           || o->kind == VCODE_OP_INDEX_CHECK || o->kind == VCODE_OP_BIT_SHIFT
-          || o->kind == VCODE_OP_ALLOCA || o->kind == VCODE_OP_COVER_COND);
+          || o->kind == VCODE_OP_ALLOCA || o->kind == VCODE_OP_COVER_COND
+          || o->kind == VCODE_OP_IMAGE);
    return o->subkind;
 }
 
@@ -2384,6 +3045,13 @@ static unsigned vcode_unit_calc_depth(vcode_unit_t unit)
    return hops;
 }
 
+static void vcode_unit_created(void)
+{
+   emitted_units++;
+   if (++live_units > peak_units)
+      peak_units = live_units;
+}
+
 vcode_unit_t emit_function(ident_t name, vcode_unit_t context,
                            vcode_type_t result)
 {
@@ -2395,6 +3063,8 @@ vcode_unit_t emit_function(ident_t name, vcode_unit_t context,
    vu->depth   = vcode_unit_calc_depth(vu);
    vu->pure    = true;
 
+   vcode_unit_created();
+
    active_unit = vu;
    vcode_select_block(emit_block());
 
@@ -2410,6 +3080,8 @@ vcode_unit_t emit_procedure(ident_t name, vcode_unit_t context)
    vu->result  = VCODE_INVALID_TYPE;
    vu->depth   = vcode_unit_calc_depth(vu);
 
+   vcode_unit_created();
+
    active_unit = vu;
    vcode_select_block(emit_block());
 
@@ -2426,6 +3098,8 @@ vcode_unit_t emit_process(ident_t name, vcode_unit_t context)
    vu->context = context;
    vu->depth   = vcode_unit_calc_depth(vu);
 
+   vcode_unit_created();
+
    active_unit = vu;
    vcode_select_block(emit_block());
 
@@ -2439,6 +3113,8 @@ vcode_unit_t emit_context(ident_t name)
    vu->name    = name;
    vu->context = vu;
 
+   vcode_unit_created();
+
    active_unit = vu;
    vcode_select_block(emit_block());
 
@@ -2776,15 +3452,18 @@ vcode_var_t emit_extern_var(vcode_type_t type, vcode_type_t bounds,
    assert(active_unit != NULL);
    assert(active_unit->kind == VCODE_UNIT_CONTEXT);
 
+   if (active_unit->extern_vars == NULL)
+      active_unit->extern_vars = ghash_new(GHASH_PTR, 64);
+
    // Try to find an existing extern with this name
-   for (unsigned i = 0; i < active_unit->vars.count; i++) {
-      var_t *v = &(active_unit->vars.items[i]);
-      if (v->is_extern && v->name == name)
-         return MAKE_HANDLE(active_unit->depth, i);
-   }
+   void *existing = ghash_get(active_unit->extern_vars, name);
+   if (existing != NULL)
+      return (uintptr_t)existing - 1;
 
    vcode_var_t var = emit_var(type, bounds, name, false);
    vcode_var_data(var)->is_extern = true;
+
+   ghash_put(active_unit->extern_vars, name, (void *)(uintptr_t)(var + 1));
    return var;
 }
 
@@ -2832,16 +3511,19 @@ vcode_signal_t emit_extern_signal(vcode_type_t type, vcode_type_t bounds,
    assert(active_unit != NULL);
    assert(active_unit->kind == VCODE_UNIT_CONTEXT);
 
+   if (active_unit->extern_signals == NULL)
+      active_unit->extern_signals = ghash_new(GHASH_PTR, 64);
+
    // Try to find an existing extern with this name
-   for (unsigned i = 0; i < active_unit->vars.count; i++) {
-      signal_t *s = &(active_unit->signals.items[i]);
-      if (s->is_extern && s->name == name)
-         return i;
-   }
+   void *existing = ghash_get(active_unit->extern_signals, name);
+   if (existing != NULL)
+      return (uintptr_t)existing - 1;
 
    vcode_signal_t sig = emit_signal(type, bounds, name, VCODE_INVALID_VAR,
                                     NULL, 0);
    vcode_signal_data(sig)->is_extern = true;
+
+   ghash_put(active_unit->extern_signals, name, (void *)(uintptr_t)(sig + 1));
    return sig;
 }
 
@@ -3118,6 +3800,7 @@ void emit_bounds(vcode_reg_t reg, vcode_type_t bounds, bounds_kind_t kind,
       return;
    else if (vtype_includes(bounds, vcode_reg_data(reg)->bounds)) {
       emit_comment("Elided bounds check for r%d", reg);
+      elided_checks++;
       return;
    }
 
@@ -3352,11 +4035,12 @@ vcode_reg_t emit_abs(vcode_reg_t lhs)
    return op->result;
 }
 
-vcode_reg_t emit_image(vcode_reg_t value, uint32_t index)
+vcode_reg_t emit_image(vcode_reg_t value, image_kind_t kind, uint32_t index)
 {
    op_t *op = vcode_add_op(VCODE_OP_IMAGE);
    vcode_add_arg(op, value);
-   op->index = index;
+   op->index   = index;
+   op->subkind = kind;
 
    op->result = vcode_add_reg(
       vtype_uarray(1, vtype_char(), vtype_int(0, 127)));
@@ -4141,6 +4825,7 @@ void emit_dynamic_bounds(vcode_reg_t reg, vcode_reg_t low, vcode_reg_t high,
       vcode_type_t bounds = vcode_reg_bounds(reg);
       if (lconst <= vtype_low(bounds) && hconst >= vtype_high(bounds)) {
          emit_comment("Elided dynamic bounds check for r%d", reg);
+         elided_checks++;
          return;
       }
 
@@ -4152,6 +4837,7 @@ void emit_dynamic_bounds(vcode_reg_t reg, vcode_reg_t low, vcode_reg_t high,
    }
    else if (reg == low || reg == high) {
       emit_comment("Elided dynamic bounds check for r%d", reg);
+      elided_checks++;
       return;
    }
 
@@ -4210,6 +4896,7 @@ void emit_index_check(vcode_reg_t rlow, vcode_reg_t rhigh, vcode_type_t bounds,
    if (vtype_includes(bounds, vcode_reg_data(rlow)->bounds)
        && vtype_includes(bounds, vcode_reg_data(rhigh)->bounds)) {
       emit_comment("Elided index check for r%d and r%d", rlow, rhigh);
+      elided_checks++;
       return;
    }
 
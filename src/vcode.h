@@ -204,7 +204,13 @@ char *vtype_record_name(vcode_type_t type);
 vcode_type_t vtype_real(void);
 
 void vcode_opt(void);
+void vcode_opt_forward(void);
+unsigned vcode_elided_checks(void);
+unsigned vcode_emitted_units(void);
+unsigned vcode_emitted_ops(void);
+unsigned vcode_peak_units(void);
 void vcode_close(void);
+void vcode_unit_unref(vcode_unit_t unit);
 void vcode_dump(void);
 void vcode_select_unit(vcode_unit_t vu);
 void vcode_select_block(vcode_block_t block);
@@ -340,7 +346,7 @@ void emit_sched_waveform(vcode_reg_t nets, vcode_reg_t nnets,
 void emit_cond(vcode_reg_t test, vcode_block_t btrue, vcode_block_t bfalse);
 vcode_reg_t emit_neg(vcode_reg_t lhs);
 vcode_reg_t emit_abs(vcode_reg_t lhs);
-vcode_reg_t emit_image(vcode_reg_t value, uint32_t index);
+vcode_reg_t emit_image(vcode_reg_t value, image_kind_t kind, uint32_t index);
 void emit_comment(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 vcode_reg_t emit_select(vcode_reg_t test, vcode_reg_t rtrue,
                         vcode_reg_t rfalse);
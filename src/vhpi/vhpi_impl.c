@@ -37,9 +37,11 @@
 #include <dlfcn.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 typedef struct vhpi_cb  vhpi_cb_t;
 typedef struct vhpi_obj vhpi_obj_t;
+typedef struct vhpi_set vhpi_set_t;
 
 struct vhpi_cb {
    int         reason;
@@ -50,13 +52,16 @@ struct vhpi_cb {
    vhpiCbDataT data;
    int         list_pos;
    bool        has_handle;
+   bool        async;
 };
 
 typedef enum {
    VHPI_CALLBACK,
    VHPI_TREE,
    VHPI_TYPE,
-   VHPI_RANGE
+   VHPI_RANGE,
+   VHPI_ITERATOR,
+   VHPI_SET
 } vhpi_obj_kind_t;
 
 #define VHPI_ANY (vhpi_obj_kind_t)-1
@@ -71,22 +76,72 @@ struct vhpi_obj {
       tree_t  tree;
       type_t  type;
       void   *pointer;
-      range_t range;
+      range_t     range;
+      int         next;
+      vhpi_set_t *set;
    };
 };
 
+typedef struct {
+   vhpi_obj_t *obj;
+   watch_t    *watch;
+} vhpi_member_t;
+
+struct vhpi_set {
+   int            count;
+   vhpi_member_t *members;
+   size_t         size;
+   vhpiIntT      *bits;
+   vhpiValueT     changed;
+   vhpiSetCbFctT  cb_rtn;
+   void          *user_data;
+   bool           pending;
+   bool           released;
+};
+
 typedef struct {
    vhpi_obj_t **objects;
    unsigned     num;
    unsigned     max;
 } cb_list_t;
 
+typedef struct {
+   vhpiCbDataT  data;
+   vhpiTimeT    time;
+   vhpiValueT   value;
+   void        *buf;
+} vhpi_async_t;
+
+typedef struct {
+   vhpi_async_t    *ring;
+   unsigned         size;
+   unsigned         head;
+   unsigned         count;
+   bool             busy;
+   bool             stopping;
+   pthread_t        thread;
+   pthread_mutex_t  lock;
+   pthread_cond_t   not_full;
+   pthread_cond_t   not_empty;
+   pthread_cond_t   idle;
+} vhpi_async_queue_t;
+
 static cb_list_t       cb_list;
 static tree_t          top_level;
 static hash_t         *handle_hash;
+static hash_t         *name_hash;
+static tree_t         *sig_decls;
+static int             n_sig_decls;
 static vhpiErrorInfoT  last_error;
 static bool            trace_on = false;
 
+static vhpi_async_queue_t async_queue = {
+   .lock      = PTHREAD_MUTEX_INITIALIZER,
+   .not_full  = PTHREAD_COND_INITIALIZER,
+   .not_empty = PTHREAD_COND_INITIALIZER,
+   .idle      = PTHREAD_COND_INITIALIZER
+};
+
 const vhpiPhysT vhpiFS = { 0, 1 };
 const vhpiPhysT vhpiPS = { 0, 0x3e8 };
 const vhpiPhysT vhpiNS = { 0, 0xf4240 };
@@ -164,7 +219,9 @@ static uint64_t vhpi_time_to_native(const vhpiTimeT *time)
 
 static const char *vhpi_obj_kind_str(vhpi_obj_kind_t kind)
 {
-   const char *names[] = { "callback", "tree", "type", "range" };
+   const char *names[] = {
+      "callback", "tree", "type", "range", "iterator", "set"
+   };
    if ((unsigned int)kind > ARRAY_LEN(names))
       return "???";
    else
@@ -228,6 +285,12 @@ static const char *vhpi_pretty_handle(vhpiHandleT handle)
 
    case VHPI_RANGE:
       return "<range>";
+
+   case VHPI_ITERATOR:
+      return (buf = xasprintf("<iterator next=%d>", handle->next));
+
+   case VHPI_SET:
+      return (buf = xasprintf("<set count=%d>", handle->set->count));
    }
 
    return "<\?\?\?>";
@@ -398,6 +461,131 @@ static vhpi_obj_t *vhpi_range_to_obj(range_t r)
    return obj;
 }
 
+static void *vhpi_async_thread(void *arg)
+{
+   vhpi_async_queue_t *q = arg;
+
+   pthread_mutex_lock(&(q->lock));
+   for (;;) {
+      while (q->count == 0 && !q->stopping)
+         pthread_cond_wait(&(q->not_empty), &(q->lock));
+
+      if (q->count == 0)
+         break;
+
+      // Free the slot before running the callback so the kernel can
+      // keep queueing events while it runs
+      vhpi_async_t a = q->ring[q->head];
+      q->head = (q->head + 1) % q->size;
+      q->count--;
+      q->busy = true;
+      pthread_cond_signal(&(q->not_full));
+      pthread_mutex_unlock(&(q->lock));
+
+      a.data.time = &(a.time);
+      if (a.data.value != NULL)
+         a.data.value = &(a.value);
+
+      (*a.data.cb_rtn)(&(a.data));
+      free(a.buf);
+
+      pthread_mutex_lock(&(q->lock));
+      q->busy = false;
+      if (q->count == 0)
+         pthread_cond_broadcast(&(q->idle));
+   }
+   pthread_mutex_unlock(&(q->lock));
+
+   return NULL;
+}
+
+static void vhpi_async_start(void)
+{
+   vhpi_async_queue_t *q = &async_queue;
+
+   if (q->ring != NULL)
+      return;
+
+   q->size     = opt_get_int("vhpi-async-lag");
+   q->ring     = xmalloc(q->size * sizeof(vhpi_async_t));
+   q->head     = 0;
+   q->count    = 0;
+   q->stopping = false;
+
+   if (pthread_create(&(q->thread), NULL, vhpi_async_thread, q) != 0)
+      fatal_errno("pthread_create");
+}
+
+static void vhpi_async_drain(void)
+{
+   // Wait for all queued callbacks to finish
+   vhpi_async_queue_t *q = &async_queue;
+
+   if (q->ring == NULL)
+      return;
+
+   pthread_mutex_lock(&(q->lock));
+   while (q->count > 0 || q->busy)
+      pthread_cond_wait(&(q->idle), &(q->lock));
+   pthread_mutex_unlock(&(q->lock));
+}
+
+static void vhpi_async_stop(void)
+{
+   vhpi_async_queue_t *q = &async_queue;
+
+   if (q->ring == NULL)
+      return;
+
+   pthread_mutex_lock(&(q->lock));
+   q->stopping = true;
+   pthread_cond_signal(&(q->not_empty));
+   pthread_mutex_unlock(&(q->lock));
+
+   pthread_join(q->thread, NULL);
+
+   free(q->ring);
+   q->ring = NULL;
+}
+
+static void vhpi_async_push(vhpi_obj_t *obj)
+{
+   // Take a copy of everything the callback can see now as the kernel
+   // carries on simulating while it is waiting to run
+
+   vhpi_async_t a = {
+      .data = obj->cb.data,
+      .buf  = NULL
+   };
+
+   unsigned deltas;
+   const uint64_t now = rt_now(&deltas);
+   a.time.high = now >> 32;
+   a.time.low  = now & 0xffffffff;
+
+   const vhpiValueT *value = obj->cb.data.value;
+   if (value != NULL && obj->cb.data.obj != NULL) {
+      a.value.format  = value->format;
+      a.value.bufSize = value->bufSize;
+      if (value->bufSize > 0)
+         a.value.value.ptr = a.buf = xmalloc(value->bufSize);
+
+      if (vhpi_get_value(obj->cb.data.obj, &(a.value)) != 0)
+         a.data.value = NULL;
+   }
+
+   vhpi_async_queue_t *q = &async_queue;
+
+   pthread_mutex_lock(&(q->lock));
+   while (q->count == q->size)
+      pthread_cond_wait(&(q->not_full), &(q->lock));
+
+   q->ring[(q->head + q->count) % q->size] = a;
+   q->count++;
+   pthread_cond_signal(&(q->not_empty));
+   pthread_mutex_unlock(&(q->lock));
+}
+
 static void vhpi_fire_event(vhpi_obj_t *obj)
 {
    if (obj->cb.released) {
@@ -410,7 +598,16 @@ static void vhpi_fire_event(vhpi_obj_t *obj)
       // reference it afterwards
       const bool release = !obj->cb.has_handle && !obj->cb.repetitive;
       obj->cb.fired = true;
-      (*obj->cb.data.cb_rtn)(&(obj->cb.data));
+      if (obj->cb.async)
+         vhpi_async_push(obj);
+      else {
+         // Observers should have seen the whole run before anything
+         // reacts to the end of the simulation
+         if (obj->cb.reason == vhpiCbEndOfSimulation)
+            vhpi_async_drain();
+
+         (*obj->cb.data.cb_rtn)(&(obj->cb.data));
+      }
       if (release)
          vhpi_release_handle((vhpiHandleT)obj);
    }
@@ -435,6 +632,47 @@ static void vhpi_global_cb(void *user)
       vhpi_fire_event((vhpiHandleT)user);
 }
 
+static void vhpi_free_set(vhpi_obj_t *obj)
+{
+   free(obj->set->members);
+   free(obj->set->bits);
+   free(obj->set);
+   vhpi_free_obj(obj);
+}
+
+static void vhpi_set_flush_cb(void *user)
+{
+   vhpi_obj_t *obj = user;
+   vhpi_set_t *set = obj->set;
+
+   // The callback may release the set so defer freeing it until after
+   // it returns
+   if (!set->released && set->cb_rtn != NULL)
+      (*set->cb_rtn)((vhpiHandleT)obj, &(set->changed), set->user_data);
+
+   if (set->released)
+      vhpi_free_set(obj);
+   else {
+      VHPI_SENS_ZERO(&(set->changed));
+      set->pending = false;
+   }
+}
+
+static void vhpi_set_event_cb(uint64_t now, tree_t sig,
+                              watch_t *watch, void *user)
+{
+   vhpi_member_t *m = user;
+   vhpi_set_t *set = m->obj->set;
+
+   VHPI_SENS_SET(m - set->members, &(set->changed));
+
+   // Report all the members that changed in this time step together
+   if (!set->pending && set->cb_rtn != NULL) {
+      rt_set_global_cb(RT_END_OF_TIME_STEP, vhpi_set_flush_cb, m->obj);
+      set->pending = true;
+   }
+}
+
 static const char *vhpi_map_str_for_type(type_t type)
 {
    ident_t type_name;
@@ -454,6 +692,9 @@ static const char *vhpi_map_str_for_type(type_t type)
 static rt_event_t vhpi_get_rt_event(int reason)
 {
    switch (reason){
+   case vhpiCbEndOfTimeStep:
+   case vhpiCbRepEndOfTimeStep:
+      return RT_END_OF_TIME_STEP;
    case vhpiCbNextTimeStep:
    case vhpiCbRepNextTimeStep:
       return RT_NEXT_TIME_STEP;
@@ -523,12 +764,17 @@ vhpiHandleT vhpi_register_cb(vhpiCbDataT *cb_data_p, int32_t flags)
    obj->cb.enabled    = !(flags & vhpiDisableCb);
    obj->cb.data       = *cb_data_p;
    obj->cb.has_handle = !!(flags & vhpiReturnCb);
+   obj->cb.async      = !!(flags & vhpiAsyncCb);
    obj->cb.list_pos   = -1;
 
+   if (obj->cb.async)
+      vhpi_async_start();
+
    switch (cb_data_p->reason) {
    case vhpiCbRepEndOfProcesses:
    case vhpiCbRepLastKnownDeltaCycle:
    case vhpiCbRepNextTimeStep:
+   case vhpiCbRepEndOfTimeStep:
       obj->cb.repetitive = true;
       (obj->cb.reason)--;   // Non-repetitive constant
       // Fall-through
@@ -537,6 +783,7 @@ vhpiHandleT vhpi_register_cb(vhpiCbDataT *cb_data_p, int32_t flags)
    case vhpiCbEndOfSimulation:
    case vhpiCbLastKnownDeltaCycle:
    case vhpiCbNextTimeStep:
+   case vhpiCbEndOfTimeStep:
       rt_set_global_cb(vhpi_get_rt_event(cb_data_p->reason),
                        vhpi_global_cb, obj);
       vhpi_remember_cb(&cb_list, obj);
@@ -630,6 +877,30 @@ int vhpi_get_cb_info(vhpiHandleT object, vhpiCbDataT *cb_data_p)
    VHPI_MISSING;
 }
 
+static void vhpi_build_index(void)
+{
+   // Map hierarchical names to declarations so handles can be found
+   // without scanning the whole elaborated design each time
+
+   if (name_hash != NULL)
+      return;
+
+   const int ndecls = tree_decls(top_level);
+   name_hash = hash_new(ndecls * 2, false);
+   sig_decls = xmalloc(MAX(ndecls, 1) * sizeof(tree_t));
+   n_sig_decls = 0;
+
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top_level, i);
+      ident_t name = tree_ident(d);
+      if (hash_get(name_hash, name) == NULL)
+         hash_put(name_hash, name, d);
+
+      if (tree_kind(d) == T_SIGNAL_DECL)
+         sig_decls[n_sig_decls++] = d;
+   }
+}
+
 vhpiHandleT vhpi_handle_by_name(const char *name, vhpiHandleT scope)
 {
    vhpi_clear_error();
@@ -667,12 +938,11 @@ vhpiHandleT vhpi_handle_by_name(const char *name, vhpiHandleT scope)
    else
       search = ident_prefix(tree_ident(root), ident_new(name), ':');
 
-   const int ndecls = tree_decls(top_level);
-   for (int i = 0; i < ndecls; i++) {
-      tree_t d = tree_decl(top_level, i);
-      if (tree_ident(d) == search)
-         return (vhpiHandleT)vhpi_tree_to_obj(d, vhpiSigDeclK);
-   }
+   vhpi_build_index();
+
+   tree_t d = hash_get(name_hash, search);
+   if (d != NULL)
+      return (vhpiHandleT)vhpi_tree_to_obj(d, vhpiSigDeclK);
 
    vhpi_error(vhpiError, NULL, "object %s not found", istr(search));
    return NULL;
@@ -702,6 +972,28 @@ vhpiHandleT vhpi_handle_by_index(vhpiOneToManyT itRel,
          return vhpi_range_to_obj(type_dim(parent->type, index));
       }
 
+   case vhpiSigDecls:
+      {
+         if (!vhpi_validate_handle(parent, VHPI_TREE))
+            return NULL;
+         else if (parent->tree != top_level) {
+            vhpi_error(vhpiError, NULL, "relation %s is only supported for "
+                       "the root instance in vhpi_handle_by_index",
+                       vhpi_one_to_many_str(itRel));
+            return NULL;
+         }
+
+         vhpi_build_index();
+
+         if (index < 0 || index >= n_sig_decls) {
+            vhpi_error(vhpiError, NULL, "invalid signal declaration index %d",
+                       index);
+            return NULL;
+         }
+
+         return vhpi_tree_to_obj(sig_decls[index], vhpiSigDeclK);
+      }
+
    default:
       fatal_trace("relation %s not supported in vhpi_handle_by_index",
                   vhpi_one_to_many_str(itRel));
@@ -755,15 +1047,55 @@ vhpiHandleT vhpi_handle(vhpiOneToOneT type, vhpiHandleT referenceHandle)
 
 vhpiHandleT vhpi_iterator(vhpiOneToManyT type, vhpiHandleT handle)
 {
+   vhpi_clear_error();
+
    VHPI_TRACE("type=%s handle=%s", vhpi_one_to_many_str(type),
               vhpi_pretty_handle(handle));
 
-   VHPI_MISSING;
+   switch (type) {
+   case vhpiSigDecls:
+      {
+         if (!vhpi_validate_handle(handle, VHPI_TREE))
+            return NULL;
+         else if (handle->tree != top_level) {
+            vhpi_error(vhpiError, NULL, "relation %s is only supported for "
+                       "the root instance in vhpi_iterator",
+                       vhpi_one_to_many_str(type));
+            return NULL;
+         }
+
+         vhpi_build_index();
+
+         vhpi_obj_t *obj = xcalloc(sizeof(vhpi_obj_t));
+         obj->magic = VHPI_MAGIC;
+         obj->kind  = VHPI_ITERATOR;
+         obj->class = vhpiIteratorK;
+         obj->next  = 0;
+
+         return obj;
+      }
+
+   default:
+      fatal_trace("relation %s not supported in vhpi_iterator",
+                  vhpi_one_to_many_str(type));
+   }
 }
 
 vhpiHandleT vhpi_scan(vhpiHandleT iterator)
 {
-   VHPI_MISSING;
+   vhpi_clear_error();
+
+   VHPI_TRACE("iterator=%s", vhpi_pretty_handle(iterator));
+
+   if (!vhpi_validate_handle(iterator, VHPI_ITERATOR))
+      return NULL;
+
+   if (iterator->next < n_sig_decls)
+      return vhpi_tree_to_obj(sig_decls[(iterator->next)++], vhpiSigDeclK);
+
+   // The iterator is released automatically once exhausted
+   vhpi_free_obj(iterator);
+   return NULL;
 }
 
 vhpiIntT vhpi_get(vhpiIntPropertyT property, vhpiHandleT handle)
@@ -1384,6 +1716,7 @@ int vhpi_release_handle(vhpiHandleT handle)
       case vhpiCbRepLastKnownDeltaCycle:
       case vhpiCbRepNextTimeStep:
       case vhpiCbLastKnownDeltaCycle:
+      case vhpiCbEndOfTimeStep:
          vhpi_forget_cb(&cb_list, handle);
          vhpi_free_obj(handle);
          return 0;
@@ -1418,11 +1751,186 @@ int vhpi_release_handle(vhpiHandleT handle)
       }
       return 0;
 
+   case VHPI_ITERATOR:
+      vhpi_free_obj(handle);
+      return 0;
+
+   case VHPI_SET:
+      for (int i = 0; i < handle->set->count; i++)
+         rt_clear_event_cb(handle->set->members[i].watch);
+
+      if (handle->set->pending)
+         handle->set->released = true;
+      else
+         vhpi_free_set(handle);
+      return 0;
+
    default:
       assert(false);
    }
 }
 
+vhpiHandleT vhpi_create_set(const vhpiHandleT *members, int count,
+                            size_t *offsets)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("members=%p count=%d offsets=%p", members, count, offsets);
+
+   if (count <= 0) {
+      vhpi_error(vhpiError, NULL, "invalid member count %d in "
+                 "vhpi_create_set", count);
+      return NULL;
+   }
+
+   for (int i = 0; i < count; i++) {
+      if (!vhpi_validate_handle(members[i], VHPI_TREE))
+         return NULL;
+
+      if (tree_kind(members[i]->tree) != T_SIGNAL_DECL) {
+         vhpi_error(vhpiError, tree_loc(members[i]->tree),
+                    "object %s is not a signal",
+                    istr(tree_ident(members[i]->tree)));
+         return NULL;
+      }
+   }
+
+   vhpi_obj_t *obj = xmalloc(sizeof(vhpi_obj_t));
+   memset(obj, '\0', sizeof(vhpi_obj_t));
+
+   obj->class = vhpiAnyCollectionK;
+   obj->kind  = VHPI_SET;
+   obj->magic = VHPI_MAGIC;
+
+   const int nwords = (count + 31) / 32;
+
+   vhpi_set_t *set = xmalloc(sizeof(vhpi_set_t));
+   set->count     = count;
+   set->members   = xmalloc(sizeof(vhpi_member_t) * count);
+   set->size      = 0;
+   set->bits      = xmalloc(sizeof(vhpiIntT) * nwords);
+   set->cb_rtn    = NULL;
+   set->user_data = NULL;
+   set->pending   = false;
+   set->released  = false;
+
+   set->changed.format      = vhpiIntVecVal;
+   set->changed.numElems    = nwords;
+   set->changed.bufSize     = sizeof(vhpiIntT) * nwords;
+   set->changed.value.intgs = set->bits;
+   VHPI_SENS_ZERO(&(set->changed));
+
+   obj->set = set;
+
+   for (int i = 0; i < count; i++) {
+      // Postponed watches fire at most once per time step
+      vhpi_member_t *m = &(set->members[i]);
+      m->obj   = obj;
+      m->watch = rt_set_event_cb(members[i]->tree, vhpi_set_event_cb,
+                                 m, true);
+
+      if (offsets != NULL)
+         offsets[i] = set->size;
+      set->size += rt_watch_bytes(m->watch);
+   }
+
+   if (offsets != NULL)
+      offsets[count] = set->size;
+
+   return (vhpiHandleT)obj;
+}
+
+int vhpi_get_set_values(vhpiHandleT handle, void *buf, size_t size)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("handle=%s buf=%p size=%zu", vhpi_pretty_handle(handle),
+              buf, size);
+
+   if (!vhpi_validate_handle(handle, VHPI_SET))
+      return 1;
+
+   vhpi_set_t *set = handle->set;
+   if (size < set->size) {
+      vhpi_error(vhpiError, NULL, "buffer of %zu bytes is too small for "
+                 "set values of %zu bytes", size, set->size);
+      return 1;
+   }
+
+   uint8_t *p = buf;
+   for (int i = 0; i < set->count; i++) {
+      rt_watch_copy(set->members[i].watch, p);
+      p += rt_watch_bytes(set->members[i].watch);
+   }
+
+   return 0;
+}
+
+int vhpi_put_set_values(vhpiHandleT handle, const void *buf, size_t size,
+                        vhpiPutValueModeT mode)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("handle=%s buf=%p size=%zu mode=%d",
+              vhpi_pretty_handle(handle), buf, size, mode);
+
+   if (!vhpi_validate_handle(handle, VHPI_SET))
+      return 1;
+
+   vhpi_set_t *set = handle->set;
+   if (size < set->size) {
+      vhpi_error(vhpiError, NULL, "buffer of %zu bytes is too small for "
+                 "set values of %zu bytes", size, set->size);
+      return 1;
+   }
+
+   bool propagate = false;
+   switch (mode) {
+   case vhpiForcePropagate:
+      if (!rt_can_create_delta()) {
+         vhpi_error(vhpiError, NULL, "cannot force propagate signal "
+                    "during current simulation phase");
+         return 1;
+      }
+      propagate = true;
+      // Fall-through
+   case vhpiForce:
+      {
+         const uint8_t *p = buf;
+         for (int i = 0; i < set->count; i++) {
+            rt_watch_force(set->members[i].watch, p, propagate);
+            p += rt_watch_bytes(set->members[i].watch);
+         }
+      }
+      return 0;
+
+   default:
+      vhpi_error(vhpiFailure, NULL, "mode %d not supported in "
+                 "vhpi_put_set_values", mode);
+      return 1;
+   }
+}
+
+int vhpi_register_set_cb(vhpiHandleT handle, vhpiSetCbFctT cb_rtn,
+                         void *user_data)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("handle=%s cb_rtn=%p user_data=%p",
+              vhpi_pretty_handle(handle), cb_rtn, user_data);
+
+   if (!vhpi_validate_handle(handle, VHPI_SET))
+      return 1;
+
+   handle->set->cb_rtn    = cb_rtn;
+   handle->set->user_data = user_data;
+
+   if (!handle->set->pending)
+      VHPI_SENS_ZERO(&(handle->set->changed));
+
+   return 0;
+}
+
 vhpiHandleT vhpi_create(vhpiClassKindT kind,
                         vhpiHandleT handle1,
                         vhpiHandleT handle2)
@@ -1468,6 +1976,12 @@ void vhpi_load_plugins(tree_t top, const char *plugins)
 
    handle_hash = hash_new(1024, true);
 
+   if (name_hash != NULL) {
+      hash_free(name_hash);
+      free(sig_decls);
+      name_hash = NULL;
+   }
+
    trace_on = opt_get_int("vhpi_trace_en");
 
    vhpi_clear_error();
@@ -1498,4 +2012,5 @@ void vhpi_load_plugins(tree_t top, const char *plugins)
    } while ((tok = strtok(NULL, ",")));
 
    atexit(vhpi_check_for_leaks);
+   atexit(vhpi_async_stop);
 }
@@ -978,6 +978,11 @@ typedef struct vhpiCbDataS
 #define vhpiReturnCb  0x00000001
 #define vhpiDisableCb 0x00000010
 
+/* NVC extension: the callback only observes the design and is run on a
+   separate thread with a copy of the time and trigger value taken when
+   the event occurred. It must not call any other VHPI function. */
+#define vhpiAsyncCb   0x00000100
+
 /************** vhpiAutomaticRestoreP property values *************/
 typedef enum {
        vhpiRestoreAll       = 1,
@@ -1016,6 +1021,12 @@ XXTERN int vhpi_get_cb_info (vhpiHandleT object,
 #define VHPI_SENS_ISSET(obj, sens)  vhpi_sens_isset(obj, sens)
 #define VHPI_SENS_FIRST(sens)       vhpi_sens_first(sens)
 
+XXTERN int vhpi_sens_zero (vhpiValueT *sens);
+XXTERN int vhpi_sens_set (int obj, vhpiValueT *sens);
+XXTERN int vhpi_sens_clr (int obj, vhpiValueT *sens);
+XXTERN int vhpi_sens_isset (int obj, vhpiValueT *sens);
+XXTERN int vhpi_sens_first (vhpiValueT *sens);
+
 /* for obtaining handles */
 
 XXTERN vhpiHandleT vhpi_handle_by_name (const char *name,
@@ -1176,6 +1187,37 @@ XXTERN size_t vhpi_put_data (int32_t id,
                              void *dataLoc,
                              size_t numBytes);
 
+/* nvc extension: bulk access to a set of signals
+
+   The values of all members are packed in order as the raw bytes of
+   their scalar sub-elements. If offsets is not NULL it receives
+   count + 1 entries giving the byte offset of each member in the packed
+   buffer followed by the total size. The changed bitmap passed to the
+   callback may be inspected with the VHPI_SENS_* macros and is cleared
+   after the callback returns. Sets must be created after the start of
+   simulation and are freed with vhpi_release_handle. */
+
+typedef void (*vhpiSetCbFctT)(vhpiHandleT set,
+                              const vhpiValueT *changed,
+                              void *user_data);
+
+XXTERN vhpiHandleT vhpi_create_set (const vhpiHandleT *members,
+                                    int count,
+                                    size_t *offsets);
+
+XXTERN int vhpi_get_set_values (vhpiHandleT set,
+                                void *buf,
+                                size_t size);
+
+XXTERN int vhpi_put_set_values (vhpiHandleT set,
+                                const void *buf,
+                                size_t size,
+                                vhpiPutValueModeT mode);
+
+XXTERN int vhpi_register_set_cb (vhpiHandleT set,
+                                 vhpiSetCbFctT cb_rtn,
+                                 void *user_data);
+
 #ifdef VHPIEXTEND_FUNCTIONS
        VHPIEXTEND_FUNCTIONS
 #endif
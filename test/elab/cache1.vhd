@@ -0,0 +1,15 @@
+entity cache1 is
+    generic ( g : integer := 1 );
+end entity;
+
+architecture test of cache1 is
+    signal x : integer := g;
+begin
+
+    process is
+    begin
+        x <= x + 1;
+        wait;
+    end process;
+
+end architecture;
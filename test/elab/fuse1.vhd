@@ -0,0 +1,33 @@
+entity fuse1 is
+end entity;
+
+architecture test of fuse1 is
+
+    function wired_or(v : bit_vector) return bit is
+    begin
+        for i in v'range loop
+            if v(i) = '1' then
+                return '1';
+            end if;
+        end loop;
+        return '0';
+    end function;
+
+    subtype rbit is wired_or bit;
+
+    signal a, b, c    : bit;
+    signal x, y, z, w : bit;
+    signal r          : bit;
+    signal d          : rbit;
+
+begin
+
+    x <= a and b;                       -- Same sensitivity so fused
+    y <= b or a;
+    z <= a xor b after 1 ns;            -- Delayed
+    w <= reject 0 ns inertial a nand b; -- Has a reject limit
+    d <= a or b;                        -- Two drivers of the same net
+    d <= a and b;
+    r <= c;                             -- Different sensitivity
+
+end architecture;
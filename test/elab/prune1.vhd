@@ -0,0 +1,43 @@
+entity sub is
+    port ( i : in bit;
+           o : out bit );
+end entity;
+
+architecture test of sub is
+    signal unused : bit;                -- Never read
+begin
+    o <= not i;
+    unused <= i;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity prune1 is
+    port ( x : out bit );
+end entity;
+
+architecture test of prune1 is
+    signal a, b, c, y : bit;
+    signal tied       : bit := '0';     -- Replaced by its constant
+    signal zero       : bit := '0';     -- Only trigger of a process
+    signal one        : bit := '0';     -- Constant differs from initial
+    signal dead       : integer;        -- Never read
+begin
+
+    u: entity work.sub
+        port map ( a, b );
+
+    x    <= b and tied;
+    dead <= 5 when a = '1' else 3;
+    tied <= '0';
+    zero <= '0';
+    one  <= '1';
+    c    <= a;
+    y    <= not zero;
+
+    sink: process (c, y, one) is
+    begin
+        report "changed";
+    end process;
+
+end architecture;
@@ -0,0 +1,47 @@
+entity sub is
+    generic ( N : integer );
+    port (
+        x : in integer;
+        y : out integer );
+end entity;
+
+architecture test of sub is
+
+    function scale(v : integer) return integer is
+    begin
+        return v * N;
+    end function;
+
+    function peek return integer is
+    begin
+        return x;
+    end function;
+
+begin
+
+    y <= scale(x) + peek;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity share1 is
+end entity;
+
+architecture test of share1 is
+    signal x1, y1, x2, y2, x3, y3 : integer;
+begin
+
+    sub1_i: entity work.sub
+        generic map ( 2 )
+        port map ( x1, y1 );
+
+    sub2_i: entity work.sub
+        generic map ( 2 )
+        port map ( x2, y2 );
+
+    sub3_i: entity work.sub
+        generic map ( 3 )
+        port map ( x3, y3 );
+
+end architecture;
@@ -0,0 +1,21 @@
+entity readers1 is
+end entity;
+
+architecture test of readers1 is
+    signal a, b, c, d : bit;
+begin
+
+    process (a) is
+    begin
+        b <= a;
+    end process;
+
+    process is
+    begin
+        wait for 1 ns;
+        if c'event then
+            b <= d;
+        end if;
+    end process;
+
+end architecture;
@@ -0,0 +1,668 @@
+//
+//  Copyright (C) 2016  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "ident.h"
+#include "tree.h"
+#include "type.h"
+#include "common.h"
+#include "hash.h"
+#include "fbuf.h"
+#include "rt/heap.h"
+#include "rt/alloc.h"
+#include "rt/netdb.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#if defined __x86_64__ || defined __i386__
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+//
+// Microbenchmarks for the core data structures. Not run by "make
+// check": build with "make bin/microbench" and run with an optional
+// list of benchmark groups, for example
+//
+//   ./bin/microbench heap hash
+//
+// Every workload uses a fixed random seed so results are comparable
+// between runs and builds.
+//
+
+typedef struct {
+   const char *name;
+   void (*fn)(void);
+} bench_group_t;
+
+static struct timespec start_ts;
+static uint64_t        start_cycles;
+static uint64_t        start_allocs;
+static uint64_t        rand_state;
+
+static volatile uintptr_t sink;
+
+#ifdef __GLIBC__
+
+// Count calls to the allocator by interposing the public entry points
+// and forwarding to the real glibc implementations
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t n_allocs;
+
+void *malloc(size_t size)
+{
+   n_allocs++;
+   return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+   n_allocs++;
+   return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+   n_allocs++;
+   return __libc_realloc(ptr, size);
+}
+
+#define HAVE_ALLOC_COUNT 1
+#endif  // __GLIBC__
+
+static void rand_seed(uint64_t seed)
+{
+   rand_state = seed;
+}
+
+static uint64_t rand_next(void)
+{
+   // xorshift64* generator
+   rand_state ^= rand_state >> 12;
+   rand_state ^= rand_state << 25;
+   rand_state ^= rand_state >> 27;
+   return rand_state * UINT64_C(2685821657736338717);
+}
+
+static inline uint64_t read_cycles(void)
+{
+#ifdef HAVE_RDTSC
+   return __rdtsc();
+#else
+   return 0;
+#endif
+}
+
+static void bench_begin(void)
+{
+#ifdef HAVE_ALLOC_COUNT
+   start_allocs = n_allocs;
+#endif
+   clock_gettime(CLOCK_MONOTONIC, &start_ts);
+   start_cycles = read_cycles();
+}
+
+static void bench_end(const char *name, uint64_t ops)
+{
+   const uint64_t cycles = read_cycles() - start_cycles;
+
+   struct timespec end_ts;
+   clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+   const uint64_t ns = (end_ts.tv_sec - start_ts.tv_sec) * UINT64_C(1000000000)
+      + end_ts.tv_nsec - start_ts.tv_nsec;
+
+   printf("%-32s %10"PRIu64" ops %10.2f ns/op", name, ops, (double)ns / ops);
+
+#ifdef HAVE_RDTSC
+   printf(" %10.1f cycles/op", (double)cycles / ops);
+#endif
+
+#ifdef HAVE_ALLOC_COUNT
+   printf(" %8.3f allocs/op", (double)(n_allocs - start_allocs) / ops);
+#endif
+
+   printf("\n");
+   fflush(stdout);
+}
+
+static const char *size_name(unsigned n)
+{
+   static char buf[16];
+   if (n >= 1000000 && n % 1000000 == 0)
+      checked_sprintf(buf, sizeof(buf), "%uM", n / 1000000);
+   else if (n >= 1000 && n % 1000 == 0)
+      checked_sprintf(buf, sizeof(buf), "%uk", n / 1000);
+   else
+      checked_sprintf(buf, sizeof(buf), "%u", n);
+   return buf;
+}
+
+static void bench_heap(void)
+{
+   static const unsigned sizes[] = { 10000, 100000, 1000000, 10000000 };
+   const unsigned nhold = 1000000;
+
+   for (int i = 0; i < ARRAY_LEN(sizes); i++) {
+      const unsigned n = sizes[i];
+      char name[64];
+
+      rand_seed(i + 1);
+      heap_t h = heap_new(16);
+
+      checked_sprintf(name, sizeof(name), "heap_insert/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         heap_insert(h, rand_next() >> 24, (void *)(uintptr_t)(j + 1));
+      bench_end(name, n);
+
+      // Hold model: the queue stays the same size while each removed
+      // event schedules another one some time in the future
+      checked_sprintf(name, sizeof(name), "heap_hold/%s", size_name(n));
+      uint64_t now = 0;
+      bench_begin();
+      for (unsigned j = 0; j < nhold; j++) {
+         sink += (uintptr_t)heap_extract_min(h);
+         heap_insert(h, now + (rand_next() >> 32), (void *)(uintptr_t)1);
+         now += 16;
+      }
+      bench_end(name, nhold);
+
+      checked_sprintf(name, sizeof(name), "heap_extract_min/%s",
+                      size_name(n));
+      bench_begin();
+      while (heap_size(h) > 0)
+         sink += (uintptr_t)heap_extract_min(h);
+      bench_end(name, n);
+
+      heap_free(h);
+   }
+
+   const unsigned ndelete = 100000;
+   heap_slot_t *slots = xmalloc(ndelete * sizeof(heap_slot_t));
+   unsigned *order = xmalloc(ndelete * sizeof(unsigned));
+
+   rand_seed(42);
+   heap_t h = heap_new(ndelete);
+   for (unsigned i = 0; i < ndelete; i++) {
+      heap_insert_slot(h, rand_next() >> 24, (void *)(uintptr_t)(i + 1),
+                       &(slots[i]));
+      order[i] = i;
+   }
+
+   for (unsigned i = ndelete - 1; i > 0; i--) {
+      const unsigned j = rand_next() % (i + 1);
+      const unsigned tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+   }
+
+   bench_begin();
+   for (unsigned i = 0; i < ndelete; i++)
+      heap_delete(h, slots[order[i]]);
+   bench_end("heap_delete/100k", ndelete);
+
+   heap_free(h);
+   free(order);
+   free(slots);
+}
+
+static void bench_alloc(void)
+{
+   const unsigned nops = 10000000;
+   const unsigned batch = 256;
+   void *ptrs[batch];
+
+   rt_alloc_stack_t s = rt_alloc_stack_new(64, "microbench");
+
+   bench_begin();
+   for (unsigned i = 0; i < nops; i += batch) {
+      for (unsigned j = 0; j < batch; j++)
+         ptrs[j] = rt_alloc(s);
+      for (unsigned j = 0; j < batch; j++)
+         rt_free(s, ptrs[j]);
+   }
+   bench_end("rt_alloc+rt_free/64B", nops);
+
+   // Objects freed in a different order to allocation
+   rand_seed(7);
+   bench_begin();
+   for (unsigned i = 0; i < nops; i += batch) {
+      for (unsigned j = 0; j < batch; j++)
+         ptrs[j] = rt_alloc(s);
+      for (unsigned j = batch - 1; j > 0; j--) {
+         const unsigned k = rand_next() % (j + 1);
+         void *tmp = ptrs[j];
+         ptrs[j] = ptrs[k];
+         ptrs[k] = tmp;
+      }
+      for (unsigned j = 0; j < batch; j++)
+         rt_free(s, ptrs[j]);
+   }
+   bench_end("rt_alloc+rt_free/64B/shuffle", nops);
+
+   rt_alloc_stack_destroy(s);
+
+   bench_begin();
+   for (unsigned i = 0; i < nops; i += batch) {
+      for (unsigned j = 0; j < batch; j++)
+         ptrs[j] = malloc(64);
+      for (unsigned j = 0; j < batch; j++)
+         free(ptrs[j]);
+   }
+   bench_end("malloc+free/64B", nops);
+}
+
+static void **make_keys(unsigned n, uint64_t seed)
+{
+   // Pointer keys with the same alignment and spread as tree objects
+   // allocated from the heap
+
+   char *base = xmalloc(n * 48);
+   void **keys = xmalloc(n * sizeof(void *));
+   for (unsigned i = 0; i < n; i++)
+      keys[i] = base + i * 48;
+
+   rand_seed(seed);
+   for (unsigned i = n - 1; i > 0; i--) {
+      const unsigned j = rand_next() % (i + 1);
+      void *tmp = keys[i];
+      keys[i] = keys[j];
+      keys[j] = tmp;
+   }
+
+   return keys;
+}
+
+static void free_keys(void **keys, unsigned n)
+{
+   char *base = keys[0];
+   for (unsigned i = 1; i < n; i++)
+      base = MIN(base, (char *)keys[i]);
+   free(base);
+   free(keys);
+}
+
+static void bench_hash(void)
+{
+   static const unsigned sizes[] = { 10000, 1000000, 4000000 };
+
+   for (int i = 0; i < ARRAY_LEN(sizes); i++) {
+      const unsigned n = sizes[i];
+      void **keys = make_keys(n * 2, i + 1);
+      char name[64];
+
+      hash_t *h = hash_new(16, true);
+
+      checked_sprintf(name, sizeof(name), "hash_put/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         hash_put(h, keys[j], keys[j]);
+      bench_end(name, n);
+
+      checked_sprintf(name, sizeof(name), "hash_get/hit/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         sink += (uintptr_t)hash_get(h, keys[n - j - 1]);
+      bench_end(name, n);
+
+      checked_sprintf(name, sizeof(name), "hash_get/miss/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         sink += (uintptr_t)hash_get(h, keys[n + j]);
+      bench_end(name, n);
+
+      hash_free(h);
+      free_keys(keys, n * 2);
+   }
+}
+
+static void bench_ghash(void)
+{
+   static const unsigned sizes[] = { 10000, 1000000, 4000000 };
+
+   for (int i = 0; i < ARRAY_LEN(sizes); i++) {
+      const unsigned n = sizes[i];
+      void **keys = make_keys(n * 2, i + 1);
+      char name[64];
+
+      ghash_t *h = ghash_new(GHASH_PTR, 16);
+
+      checked_sprintf(name, sizeof(name), "ghash_put/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         ghash_put(h, keys[j], keys[j]);
+      bench_end(name, n);
+
+      checked_sprintf(name, sizeof(name), "ghash_get/hit/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         sink += (uintptr_t)ghash_get(h, keys[n - j - 1]);
+      bench_end(name, n);
+
+      checked_sprintf(name, sizeof(name), "ghash_get/miss/%s",
+                      size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         sink += (uintptr_t)ghash_get(h, keys[n + j]);
+      bench_end(name, n);
+
+      checked_sprintf(name, sizeof(name), "ghash_delete/%s", size_name(n));
+      bench_begin();
+      for (unsigned j = 0; j < n; j++)
+         sink += ghash_delete(h, keys[j]);
+      bench_end(name, n);
+
+      ghash_free(h);
+      free_keys(keys, n * 2);
+   }
+}
+
+static char *temp_file(const char *suffix)
+{
+   const char *tmpdir = getenv("TMPDIR") ?: "/tmp";
+   return xasprintf("%s/nvc-microbench-%d.%s", tmpdir, getpid(), suffix);
+}
+
+static void bench_fbuf(void)
+{
+   static const struct {
+      fbuf_codec_t codec;
+      const char  *name;
+   } codecs[] = {
+      { FBUF_CODEC_NONE,   "none" },
+      { FBUF_CODEC_FASTLZ, "fastlz" },
+      { FBUF_CODEC_LZ4,    "lz4" }
+   };
+
+   const unsigned nwords = 16 * 1024 * 1024;
+   char *fname = temp_file("fbuf");
+
+   for (int i = 0; i < ARRAY_LEN(codecs); i++) {
+      char name[64];
+      fbuf_set_codec(codecs[i].codec);
+
+      // Small values with many repeats like the serialised trees
+      rand_seed(i + 1);
+      fbuf_t *f = fbuf_open(fname, FBUF_OUT);
+      if (f == NULL)
+         fatal_errno("failed to open %s", fname);
+
+      checked_sprintf(name, sizeof(name), "fbuf_write_u32/%s",
+                      codecs[i].name);
+      bench_begin();
+      for (unsigned j = 0; j < nwords; j++)
+         write_u32(rand_next() % 1024, f);
+      fbuf_close(f);
+      bench_end(name, nwords);
+
+      if ((f = fbuf_open(fname, FBUF_IN)) == NULL)
+         fatal_errno("failed to open %s", fname);
+
+      checked_sprintf(name, sizeof(name), "fbuf_read_u32/%s",
+                      codecs[i].name);
+      bench_begin();
+      for (unsigned j = 0; j < nwords; j++)
+         sink += read_u32(f);
+      fbuf_close(f);
+      bench_end(name, nwords);
+   }
+
+   fbuf_set_codec(FBUF_CODEC_FASTLZ);
+   remove(fname);
+   free(fname);
+}
+
+static tree_t make_design(unsigned nsignals)
+{
+   // Something the shape of a flat elaborated netlist
+
+   type_t std_int = type_new(T_INTEGER);
+   type_set_ident(std_int, ident_new("STD.STANDARD.INTEGER"));
+
+   tree_t top = tree_new(T_ELAB);
+   tree_set_ident(top, ident_new("WORK.MICROBENCH.elab"));
+
+   tree_t *decls = xmalloc(nsignals * sizeof(tree_t));
+   for (unsigned i = 0; i < nsignals; i++) {
+      char buf[32];
+      checked_sprintf(buf, sizeof(buf), ":top:s%u", i);
+
+      tree_t value = tree_new(T_LITERAL);
+      tree_set_subkind(value, L_INT);
+      tree_set_ival(value, i);
+      tree_set_type(value, std_int);
+
+      tree_t s = tree_new(T_SIGNAL_DECL);
+      tree_set_ident(s, ident_new(buf));
+      tree_set_type(s, std_int);
+      tree_set_value(s, value);
+      tree_add_net(s, i);
+
+      tree_add_decl(top, s);
+      decls[i] = s;
+   }
+
+   rand_seed(99);
+   for (unsigned i = 0; i < nsignals; i++) {
+      char buf[32];
+      checked_sprintf(buf, sizeof(buf), ":top:p%u", i);
+
+      tree_t target = tree_new(T_REF);
+      tree_set_ident(target, tree_ident(decls[i]));
+      tree_set_ref(target, decls[i]);
+      tree_set_type(target, std_int);
+
+      tree_t input = decls[rand_next() % nsignals];
+
+      tree_t ref = tree_new(T_REF);
+      tree_set_ident(ref, tree_ident(input));
+      tree_set_ref(ref, input);
+      tree_set_type(ref, std_int);
+
+      tree_t wave = tree_new(T_WAVEFORM);
+      tree_set_value(wave, ref);
+
+      tree_t assign = tree_new(T_SIGNAL_ASSIGN);
+      tree_set_target(assign, target);
+      tree_add_waveform(assign, wave);
+
+      tree_t trigger = tree_new(T_REF);
+      tree_set_ident(trigger, tree_ident(input));
+      tree_set_ref(trigger, input);
+      tree_set_type(trigger, std_int);
+
+      tree_t wait = tree_new(T_WAIT);
+      tree_set_ident(wait, ident_new("wait"));
+      tree_add_trigger(wait, trigger);
+
+      tree_t p = tree_new(T_PROCESS);
+      tree_set_ident(p, ident_new(buf));
+      tree_add_stmt(p, assign);
+      tree_add_stmt(p, wait);
+
+      tree_add_stmt(top, p);
+   }
+
+   free(decls);
+   return top;
+}
+
+static void bench_object(void)
+{
+   static const unsigned sizes[] = { 10000, 100000 };
+
+   char *fname = temp_file("tree");
+
+   for (int i = 0; i < ARRAY_LEN(sizes); i++) {
+      const unsigned n = sizes[i];
+      char name[64];
+
+      tree_t top = make_design(n);
+      const unsigned nobjs = tree_visit(top, NULL, NULL);
+
+      fbuf_t *f = fbuf_open(fname, FBUF_OUT);
+      if (f == NULL)
+         fatal_errno("failed to open %s", fname);
+
+      checked_sprintf(name, sizeof(name), "object_write/%s", size_name(n));
+      bench_begin();
+      tree_wr_ctx_t wctx = tree_write_begin(f);
+      tree_write(top, wctx);
+      tree_write_end(wctx);
+      fbuf_close(f);
+      bench_end(name, nobjs);
+
+      if ((f = fbuf_open(fname, FBUF_IN)) == NULL)
+         fatal_errno("failed to open %s", fname);
+
+      checked_sprintf(name, sizeof(name), "object_read/%s", size_name(n));
+      bench_begin();
+      tree_rd_ctx_t rctx = tree_read_begin(f, fname);
+      tree_t copy = tree_read(rctx);
+      tree_read_end(rctx);
+      fbuf_close(f);
+      bench_end(name, nobjs);
+
+      const unsigned nread = tree_visit(copy, NULL, NULL);
+      if (nread != nobjs)
+         fatal("read %u objects but wrote %u", nread, nobjs);
+   }
+
+   remove(fname);
+   free(fname);
+}
+
+static void bench_netdb(void)
+{
+   static const unsigned sizes[] = { 100000, 10000000 };
+   const unsigned nlookups = 10000000;
+
+   for (int i = 0; i < ARRAY_LEN(sizes); i++) {
+      const unsigned nnets = sizes[i];
+      char name[64];
+
+      // Groups of one to eight nets as produced for a typical design
+      // with a mix of scalars and small vectors
+
+      netid_t *first = xmalloc(nnets * sizeof(netid_t));
+      uint32_t *length = xmalloc(nnets * sizeof(uint32_t));
+      groupid_t *dense = xmalloc(nnets * sizeof(groupid_t));
+
+      rand_seed(i + 1);
+      unsigned ngroups = 0;
+      for (netid_t nid = 0; nid < nnets; ngroups++) {
+         const unsigned len = MIN(1 + rand_next() % 8, nnets - nid);
+         first[ngroups]  = nid;
+         length[ngroups] = len;
+         for (unsigned j = 0; j < len; j++)
+            dense[nid++] = ngroups;
+      }
+
+      netid_t *nets = xmalloc(nlookups * sizeof(netid_t));
+      for (unsigned j = 0; j < nlookups; j++)
+         nets[j] = rand_next() % nnets;
+
+      netdb_t db = {
+         .first   = first,
+         .length  = length,
+         .dense   = dense,
+         .nnets   = nnets,
+         .ngroups = ngroups
+      };
+
+      checked_sprintf(name, sizeof(name), "netdb_lookup/dense/%s",
+                      size_name(nnets));
+      bench_begin();
+      for (unsigned j = 0; j < nlookups; j++)
+         sink += netdb_lookup(&db, nets[j]);
+      bench_end(name, nlookups);
+
+      db.dense = NULL;
+
+      checked_sprintf(name, sizeof(name), "netdb_lookup/search/%s",
+                      size_name(nnets));
+      bench_begin();
+      for (unsigned j = 0; j < nlookups; j++)
+         sink += netdb_lookup(&db, nets[j]);
+      bench_end(name, nlookups);
+
+      // Sequential access as when walking the nets of a signal
+      checked_sprintf(name, sizeof(name), "netdb_lookup/seq/%s",
+                      size_name(nnets));
+      bench_begin();
+      for (unsigned j = 0; j < nlookups; j++)
+         sink += netdb_lookup(&db, j % nnets);
+      bench_end(name, nlookups);
+
+      free(nets);
+      free(dense);
+      free(length);
+      free(first);
+   }
+}
+
+static const bench_group_t groups[] = {
+   { "heap",   bench_heap },
+   { "alloc",  bench_alloc },
+   { "hash",   bench_hash },
+   { "ghash",  bench_ghash },
+   { "fbuf",   bench_fbuf },
+   { "object", bench_object },
+   { "netdb",  bench_netdb }
+};
+
+int main(int argc, char **argv)
+{
+   term_init();
+   intern_strings();
+
+   for (int i = 1; i < argc; i++) {
+      bool found = false;
+      for (int j = 0; j < ARRAY_LEN(groups); j++) {
+         if (strcmp(argv[i], groups[j].name) == 0)
+            found = true;
+      }
+
+      if (!found) {
+         fprintf(stderr, "unknown benchmark group %s, choose from:", argv[i]);
+         for (int j = 0; j < ARRAY_LEN(groups); j++)
+            fprintf(stderr, " %s", groups[j].name);
+         fprintf(stderr, "\n");
+         return EXIT_FAILURE;
+      }
+   }
+
+   for (int j = 0; j < ARRAY_LEN(groups); j++) {
+      bool run = (argc == 1);
+      for (int i = 1; i < argc && !run; i++)
+         run = (strcmp(argv[i], groups[j].name) == 0);
+
+      if (run)
+         (*groups[j].fn)();
+   }
+
+   return EXIT_SUCCESS;
+}
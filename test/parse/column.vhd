@@ -0,0 +1,10 @@
+architecture a of e is
+begin
+	x <= bit'('1'); y <= c;
+    z <= a_very_long_identifier_name_which_goes_on_for_more_than_sixty_chars; w <= d;
+end architecture;
+
+architecture b of e is
+begin
+		v <= a_very_long_identifier_name_which_goes_on_for_more_than_sixty_chars ) ;
+end architecture;
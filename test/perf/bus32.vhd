@@ -0,0 +1,40 @@
+entity bus32 is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+architecture test of bus32 is
+
+    constant WIDTH   : integer := 32;
+    constant DRIVERS : integer := 32;
+    constant ITERS   : integer := 100000;
+
+    signal bus_s : std_logic_vector(WIDTH - 1 downto 0);
+    signal turn  : integer range 0 to DRIVERS - 1 := 0;
+begin
+
+    -- Each driver takes the bus in turn and tri-states it otherwise
+    drivers: for i in 0 to DRIVERS - 1 generate
+        process (turn) is
+        begin
+            if turn = i then
+                bus_s <= (others => '0');
+                bus_s(i) <= '1';
+            else
+                bus_s <= (others => 'Z');
+            end if;
+        end process;
+    end generate;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            turn <= i mod DRIVERS;
+            wait for 1 ns;
+            assert bus_s(i mod DRIVERS) = '1';
+        end loop;
+        wait;
+    end process;
+
+end architecture;
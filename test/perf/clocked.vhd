@@ -0,0 +1,48 @@
+entity clocked is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Many small clocked processes as found in RTL designs
+
+architecture test of clocked is
+
+    constant REGS  : integer := 2000;
+    constant ITERS : integer := 5000;
+
+    type count_array is array (0 to REGS - 1) of unsigned(15 downto 0);
+
+    signal clk   : std_logic := '0';
+    signal reset : std_logic := '1';
+    signal count : count_array;
+begin
+
+    regs: for i in 0 to REGS - 1 generate
+        process (clk) is
+        begin
+            if rising_edge(clk) then
+                if reset = '1' then
+                    count(i) <= to_unsigned(i, 16);
+                else
+                    count(i) <= count(i) + 1;
+                end if;
+            end if;
+        end process;
+    end generate;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            clk <= '1';
+            wait for 5 ns;
+            clk <= '0';
+            reset <= '0';
+            wait for 5 ns;
+        end loop;
+        assert count(0) = ITERS - 1;
+        wait;
+    end process;
+
+end architecture;
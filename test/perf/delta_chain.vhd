@@ -0,0 +1,31 @@
+entity delta_chain is
+end entity;
+
+-- A long chain of zero delay assignments so every change of the input
+-- ripples through many delta cycles
+
+architecture test of delta_chain is
+
+    constant DEPTH : integer := 1000;
+    constant ITERS : integer := 2000;
+
+    type int_array is array (0 to DEPTH) of integer;
+
+    signal chain : int_array := (others => 0);
+begin
+
+    stages: for i in 1 to DEPTH generate
+        chain(i) <= chain(i - 1) + 1;
+    end generate;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            chain(0) <= i;
+            wait for 1 ns;
+            assert chain(DEPTH) = i + DEPTH;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
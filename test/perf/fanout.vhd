@@ -0,0 +1,33 @@
+entity fanout is
+end entity;
+
+architecture test of fanout is
+
+    constant WAITERS : integer := 1000;
+    constant ITERS   : integer := 10000;
+
+    signal clk : bit := '0';
+begin
+
+    -- Many processes with dynamic waits on the same signal
+    waiters: for i in 1 to WAITERS generate
+        process is
+            variable count : natural := 0;
+        begin
+            wait until clk = '1';
+            count := count + 1;
+        end process;
+    end generate;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            clk <= '1';
+            wait for 1 ns;
+            clk <= '0';
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,45 @@
+entity memory is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- A large RAM modelled as a signal written and read every cycle
+
+architecture test of memory is
+
+    constant DEPTH : integer := 262144;
+    constant ITERS : integer := 200000;
+
+    type ram_t is array (0 to DEPTH - 1) of std_logic_vector(31 downto 0);
+
+    signal ram   : ram_t;
+    signal clk   : std_logic := '0';
+    signal addr  : integer range 0 to DEPTH - 1 := 0;
+    signal wdata : std_logic_vector(31 downto 0);
+    signal rdata : std_logic_vector(31 downto 0);
+begin
+
+    process (clk) is
+    begin
+        if rising_edge(clk) then
+            ram(addr) <= wdata;
+            rdata <= ram((addr * 7) mod DEPTH);
+        end if;
+    end process;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            addr <= (i * 13) mod DEPTH;
+            wdata <= std_logic_vector(to_unsigned(i, 32));
+            clk <= '1';
+            wait for 5 ns;
+            clk <= '0';
+            wait for 5 ns;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
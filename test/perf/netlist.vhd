@@ -0,0 +1,52 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity netlist_cell is
+    port ( a, b : in std_logic;
+           q    : out std_logic );
+end entity;
+
+architecture gates of netlist_cell is
+    signal n1, n2 : std_logic;
+begin
+    n1 <= a nand b;
+    n2 <= a nor b;
+    q  <= n1 xor n2;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity netlist is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+-- A large flat netlist of small cells to stress analysis, elaboration
+-- and code generation more than simulation
+
+architecture test of netlist is
+
+    constant CELLS : integer := 20000;
+    constant ITERS : integer := 100;
+
+    signal wire : std_logic_vector(0 to CELLS) := (others => '0');
+    signal b    : std_logic := '0';
+begin
+
+    cells: for i in 0 to CELLS - 1 generate
+        u: entity work.netlist_cell
+            port map ( a => wire(i), b => b, q => wire(i + 1) );
+    end generate;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            wire(0) <= not wire(0);
+            b <= not b;
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
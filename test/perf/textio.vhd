@@ -0,0 +1,48 @@
+entity textio is
+end entity;
+
+use std.textio.all;
+
+-- Writes a file of formatted lines and then reads it back
+
+architecture test of textio is
+
+    constant LINES : integer := 200000;
+
+begin
+
+    process is
+        file f       : text;
+        variable l   : line;
+        variable s   : string(1 to 5);
+        variable n   : integer;
+        variable m   : integer;
+        variable sum : integer := 0;
+    begin
+        file_open(f, "textio.txt", WRITE_MODE);
+        for i in 1 to LINES loop
+            write(l, string'("line "));
+            write(l, i);
+            write(l, ' ');
+            write(l, i mod 97);
+            writeline(f, l);
+        end loop;
+        file_close(f);
+
+        file_open(f, "textio.txt", READ_MODE);
+        while not endfile(f) loop
+            readline(f, l);
+            read(l, s);
+            read(l, n);
+            read(l, m);
+            sum := sum + m;
+            deallocate(l);
+        end loop;
+        file_close(f);
+
+        assert sum > 0;
+
+        wait;
+    end process;
+
+end architecture;
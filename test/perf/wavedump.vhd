@@ -0,0 +1,47 @@
+entity wavedump is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Toggles many signals every cycle to measure the cost of waveform
+-- dumping, for example with
+--   nvc -r --wave --fst-options=pack=lz4,parallel wavedump
+
+architecture test of wavedump is
+
+    constant WIDTH : integer := 64;
+    constant REGS  : integer := 256;
+    constant ITERS : integer := 20000;
+
+    type reg_array is array (0 to REGS - 1) of unsigned(WIDTH - 1 downto 0);
+
+    signal clk  : std_logic := '0';
+    signal regs : reg_array;
+    signal done : boolean := false;
+begin
+
+    clk <= not clk after 5 ns when not done;
+
+    chain: for i in 0 to REGS - 1 generate
+        process (clk) is
+            variable count : unsigned(WIDTH - 1 downto 0) := to_unsigned(i, WIDTH);
+        begin
+            if rising_edge(clk) then
+                count := count + i + 1;
+                regs(i) <= count;
+            end if;
+        end process;
+    end generate;
+
+    process is
+    begin
+        for i in 1 to ITERS loop
+            wait until rising_edge(clk);
+        end loop;
+        done <= true;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,30 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+use std.textio.all;
+
+entity abi1 is
+end entity;
+
+architecture test of abi1 is
+begin
+
+    -- Calls subprograms in each of the precompiled libraries which are
+    -- only loaded if their runtime ABI version matches
+
+    process is
+        variable u : unsigned(7 downto 0);
+        variable l : line;
+    begin
+        u := to_unsigned(200, 8) + 50;
+        assert to_integer(u) = 250;
+        assert to_x01(std_logic'('H')) = '1';
+        assert abs(sqrt(16.0) - 4.0) < 0.001;
+        write(l, to_integer(u));
+        assert l.all = "250";
+        deallocate(l);
+        wait;
+    end process;
+
+end architecture;
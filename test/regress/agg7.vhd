@@ -0,0 +1,61 @@
+entity agg7 is
+end entity;
+
+architecture test of agg7 is
+
+    type int_vec is array (natural range <>) of integer;
+    type real_vec is array (natural range <>) of real;
+    type rec is record
+        x : integer;
+        y : bit;
+    end record;
+    type rec_vec is array (natural range <>) of rec;
+
+    function fill_int(n, x : integer) return int_vec is
+        variable v : int_vec(1 to n) := (others => x);
+    begin
+        return v;
+    end function;
+
+    function fill_mixed(n : integer) return int_vec is
+        variable v : int_vec(n - 1 downto 0) := (0 => 5, 2 => 7, others => 3);
+    begin
+        return v;
+    end function;
+
+    function fill_real(n : integer) return real_vec is
+    begin
+        return real_vec'(1 to n => 1.5);
+    end function;
+
+    function fill_rec(n : integer) return rec_vec is
+        variable v : rec_vec(0 to n - 1) := (1 => (4, '1'), others => (2, '0'));
+    begin
+        return v;
+    end function;
+
+begin
+
+    process is
+        variable n : integer;
+    begin
+        n := 7;
+        wait for 1 ns;
+
+        assert fill_int(n, 42) = (42, 42, 42, 42, 42, 42, 42);
+        assert fill_int(0, 1)'length = 0;
+        assert fill_int(1, 9) = (1 => 9);
+
+        assert fill_mixed(n) = (3, 3, 3, 3, 7, 3, 5);
+        assert fill_mixed(3) = (7, 3, 5);
+
+        assert fill_real(3) = (1.5, 1.5, 1.5);
+
+        assert fill_rec(n)(0) = (2, '0');
+        assert fill_rec(n)(1) = (4, '1');
+        assert fill_rec(n)(6) = (2, '0');
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,33 @@
+entity alloca1 is
+end entity;
+
+architecture test of alloca1 is
+
+    type int_vec is array (natural range <>) of integer;
+
+    function rotate (v : int_vec(1 to 4)) return int_vec is
+    begin
+        return v(2 to 4) & v(1);
+    end function;
+
+begin
+
+    process is
+        variable v    : int_vec(1 to 4) := (1, 2, 3, 4);
+        variable pair : int_vec(1 to 2);
+        variable sum  : integer := 0;
+    begin
+        -- Each iteration uses fixed size temporaries which must neither
+        -- grow the stack nor keep values from earlier iterations: with
+        -- an allocation per iteration this loop overflows the stack
+        for i in 1 to 4000000 loop
+            v := rotate(v);
+            pair := (i, -i);
+            sum := sum + v(1) + pair(1) + pair(2);
+        end loop;
+        assert v = (1, 2, 3, 4);
+        assert sum = 10000000;
+        wait;
+    end process;
+
+end architecture;
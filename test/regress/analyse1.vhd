@@ -0,0 +1,26 @@
+use work.analyse1_pkg.all;
+
+entity analyse1 is
+end entity;
+
+architecture test of analyse1 is
+    signal a, b : integer := 0;
+    signal c    : bit;
+begin
+
+    u1: entity work.analyse1_ent
+        port map ( a, b );
+
+    u2: entity work.analyse1_other
+        port map ( c );
+
+    process is
+    begin
+        a <= 5;
+        wait for 1 ns;
+        assert b = 10 + width;
+        assert c = '1';
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,11 @@
+use work.analyse1_pkg.all;
+
+entity analyse1_ent is
+    port ( i : in integer;
+           o : out integer );
+end entity;
+
+architecture test of analyse1_ent is
+begin
+    o <= double(i) + width;
+end architecture;
@@ -0,0 +1,10 @@
+-- Does not depend on any other file
+
+entity analyse1_other is
+    port ( o : out bit );
+end entity;
+
+architecture test of analyse1_other is
+begin
+    o <= '1';
+end architecture;
@@ -0,0 +1,11 @@
+package analyse1_pkg is
+    constant width : integer := 8;
+    function double(x : integer) return integer;
+end package;
+
+package body analyse1_pkg is
+    function double(x : integer) return integer is
+    begin
+        return x * 2;
+    end function;
+end package body;
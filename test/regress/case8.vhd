@@ -0,0 +1,84 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity case8 is
+end entity;
+
+architecture test of case8 is
+
+    -- Every element value fits in the packed key
+    function decode4(x : std_logic_vector(3 downto 0)) return integer is
+    begin
+        case x is
+            when "0000" => return 0;
+            when "0101" => return 5;
+            when "1111" => return 15;
+            when "XXXX" => return -2;
+            when "ZZ01" => return -3;
+            when others => return -1;
+        end case;
+    end function;
+
+    -- Too wide for every element value so metavalues go to others
+    function decode32(x : std_logic_vector(31 downto 0)) return integer is
+    begin
+        case x is
+            when X"00000000" => return 0;
+            when X"deadbeef" => return 1;
+            when X"80000001" | X"7ffffffe" => return 2;
+            when X"ffffffff" => return 3;
+            when others => return -1;
+        end case;
+    end function;
+
+    function decode48(x : bit_vector(47 downto 0)) return integer is
+    begin
+        case x is
+            when X"000000000001" => return 1;
+            when X"800000000000" => return 2;
+            when X"123456789abc" => return 3;
+            when others => return -1;
+        end case;
+    end function;
+
+begin
+
+    process is
+        variable v4  : std_logic_vector(3 downto 0);
+        variable v32 : std_logic_vector(31 downto 0);
+    begin
+        v4 := "0101";
+        assert decode4(v4) = 5;
+        v4 := "XXXX";
+        assert decode4(v4) = -2;
+        v4 := "ZZ01";
+        assert decode4(v4) = -3;
+        v4 := "ZZ10";
+        assert decode4(v4) = -1;
+        v4 := "1111";
+        assert decode4(v4) = 15;
+
+        v32 := X"deadbeef";
+        assert decode32(v32) = 1;
+        v32 := X"7ffffffe";
+        assert decode32(v32) = 2;
+        v32 := X"80000001";
+        assert decode32(v32) = 2;
+        v32 := X"ffffffff";
+        assert decode32(v32) = 3;
+        v32(7) := 'X';
+        assert decode32(v32) = -1;
+        v32 := (others => 'H');
+        assert decode32(v32) = -1;
+        v32 := (others => '0');
+        assert decode32(v32) = 0;
+
+        assert decode48(X"000000000001") = 1;
+        assert decode48(X"800000000000") = 2;
+        assert decode48(X"123456789abc") = 3;
+        assert decode48(X"123456789abd") = -1;
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,5 @@
+run 3 ns
+checkpoint
+run
+restore
+run
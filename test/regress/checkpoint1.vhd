@@ -0,0 +1,37 @@
+entity checkpoint1 is
+end entity;
+
+use std.textio.all;
+
+architecture test of checkpoint1 is
+    file results : text open WRITE_MODE is "checkpoint1.txt";
+begin
+
+    process is
+        variable l : line;
+        variable n : integer;
+    begin
+        for i in 1 to 10 loop
+            wait for 1 ns;
+            write(l, i);
+            writeline(results, l);
+        end loop;
+
+        -- Reading the file back shows whether lines written before the
+        -- checkpoint was restored were discarded
+        file_close(results);
+        file_open(results, "checkpoint1.txt", READ_MODE);
+        for i in 1 to 10 loop
+            readline(results, l);
+            read(l, n);
+            assert n = i report "unexpected line " & integer'image(n)
+                severity failure;
+        end loop;
+        assert endfile(results) report "extra lines" severity failure;
+        file_close(results);
+
+        report "file ok";
+        wait;
+    end process;
+
+end architecture;
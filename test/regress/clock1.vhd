@@ -0,0 +1,55 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity clock1 is
+end entity;
+
+architecture test of clock1 is
+    signal a : bit := '0';
+    signal b : std_logic := '0';
+    signal c : std_logic;               -- Never toggles from 'U'
+    signal d : boolean := true;
+    signal e : std_logic := '0';        -- Has a second driver
+begin
+
+    a <= not a after 5 ns;
+    b <= not b after 2500 ps;
+    c <= not c after 5 ns;
+    d <= not d after 10 ns;
+    e <= not e after 5 ns;
+    e <= 'L';
+
+    process is
+        variable count : natural := 0;
+    begin
+        for i in 1 to 10 loop
+            wait until rising_edge(b);
+            count := count + 1;
+            assert now = (i - 1) * 5 ns + 2500 ps;
+        end loop;
+        assert count = 10;
+        wait;
+    end process;
+
+    process is
+    begin
+        wait for 1 ns;
+        assert a = '0';
+        assert d;
+        assert e = '0';
+        wait for 5 ns;
+        assert a = '1';
+        assert d;
+        assert e = '1';
+        wait for 5 ns;
+        assert a = '0';
+        assert not d;
+        assert c = 'U';
+        assert e = '0';
+        wait for 10 ns;
+        assert a = '0';
+        assert d;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,28 @@
+entity cover5 is
+end entity;
+
+architecture test of cover5 is
+    signal s, t : integer;
+begin
+
+    p1: process is
+        variable v : integer;
+    begin
+        v := 1;
+        s <= v;
+        wait for 1 ns;
+        v := 2;
+        wait;
+    end process;
+
+    p2: process is
+        variable v : integer;
+    begin
+        v := 3;
+        t <= v;
+        wait for 2 ns;
+        v := 4;
+        wait;
+    end process;
+
+end architecture;
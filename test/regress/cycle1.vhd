@@ -0,0 +1,36 @@
+entity cycle1 is
+end entity;
+
+architecture test of cycle1 is
+    signal clk     : bit := '0';
+    signal a, b, c : integer := 0;
+    signal y, q    : integer := 0;
+begin
+
+    clk <= not clk after 5 ns when now < 200 ns;
+
+    -- Reconvergent combinational paths of different depths
+    b <= a + 1;
+    c <= b * 2;
+    y <= b + c;
+
+    process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            q <= y;
+            a <= a + 1;
+        end if;
+    end process;
+
+    process is
+    begin
+        wait until clk = '1';
+        for i in 1 to 15 loop
+            wait until clk = '1';
+            assert q = 3 * i
+                report "q = " & integer'image(q) severity failure;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,65 @@
+entity delay3 is
+end entity;
+
+architecture test of delay3 is
+    signal x, y : integer := 0;
+    signal v    : bit_vector(1 to 16);
+begin
+
+    stim_p: process is
+    begin
+        -- More pending transactions than the initial ring size
+        x <= transport 1 after 1 ns, 2 after 2 ns, 3 after 3 ns, 4 after 4 ns,
+             5 after 5 ns, 6 after 6 ns, 7 after 7 ns;
+        v <= transport X"0001" after 1 ns, X"0010" after 2 ns,
+             X"0100" after 3 ns, X"1000" after 4 ns, X"ffff" after 5 ns;
+        wait for 1500 ps;
+        assert x = 1;
+        assert v = X"0001";
+
+        -- Transport delay removes the transactions at 4 ns to 7 ns
+        x <= transport 10 after 2 ns;
+        wait for 1 ns;                  -- 2.5 ns
+        assert x = 2;
+        assert v = X"0010";
+        wait for 1100 ps;               -- 3.6 ns
+        assert x = 10;
+        assert v = X"0100";
+        wait for 1 ns;                  -- 4.6 ns
+        assert x = 10;
+        assert v = X"1000";
+        wait for 3 ns;                  -- 7.6 ns
+        assert x = 10;
+        assert v = X"ffff";
+
+        -- The ring has now wrapped around
+        wait for 2400 ps;               -- 10 ns
+        x <= transport 20 after 1 ns, 21 after 2 ns, 22 after 3 ns,
+             23 after 4 ns, 24 after 5 ns;
+        wait for 2500 ps;               -- 12.5 ns
+        assert x = 21;
+        wait for 3 ns;                  -- 15.5 ns
+        assert x = 24;
+
+        -- Inertial delay rejects the earlier transaction
+        y <= 1 after 5 ns;
+        wait for 1 ns;                  -- 16.5 ns
+        y <= 2 after 5 ns;
+        wait for 4500 ps;               -- 21 ns
+        assert y = 0;
+        wait for 1 ns;                  -- 22 ns
+        assert y = 2;
+
+        -- A transaction with the same value as the new one survives the
+        -- reject limit
+        y <= transport 5 after 2 ns;
+        y <= reject 2 ns inertial 5 after 3 ns;
+        wait for 2700 ps;               -- 24.7 ns
+        assert y = 5;
+        wait for 1 ns;                  -- 25.7 ns
+        assert y = 5;
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,64 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity edge1 is
+end entity;
+
+architecture test of edge1 is
+    signal clk              : std_logic := '0';
+    signal bclk             : bit := '0';
+    signal nrise, nfall     : natural := 0;
+    signal nevent, nbit     : natural := 0;
+begin
+
+    process (clk) is
+    begin
+        if rising_edge(clk) then
+            nrise <= nrise + 1;
+        end if;
+    end process;
+
+    process (clk) is
+    begin
+        if falling_edge(clk) then
+            nfall <= nfall + 1;
+        end if;
+    end process;
+
+    process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            nevent <= nevent + 1;
+        end if;
+    end process;
+
+    process (bclk) is
+    begin
+        if bclk = '1' and bclk'event then
+            nbit <= nbit + 1;
+        end if;
+    end process;
+
+    process is
+    begin
+        clk <= '1';
+        bclk <= '1';
+        wait for 1 ns;
+        clk <= '0';
+        bclk <= '0';
+        wait for 1 ns;
+        clk <= 'H';                     -- Rising edge but not '1'
+        wait for 1 ns;
+        clk <= 'L';
+        wait for 1 ns;
+        clk <= 'X';
+        bclk <= '1';
+        wait for 1 ns;
+        assert nrise = 2 report integer'image(nrise);
+        assert nfall = 2 report integer'image(nfall);
+        assert nevent = 1 report integer'image(nevent);
+        assert nbit = 2 report integer'image(nbit);
+        wait;
+    end process;
+
+end architecture;
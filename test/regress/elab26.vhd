@@ -0,0 +1,88 @@
+entity elab26_leaf is
+    generic ( K : integer );
+    port ( i : in integer; o : out integer );
+end entity;
+
+architecture test of elab26_leaf is
+    constant TWICE : integer := K * 2;
+begin
+
+    process (i) is
+        function add (x : integer) return integer is
+        begin
+            return x + TWICE;
+        end function;
+    begin
+        o <= add(i);
+    end process;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity elab26_mid is
+    generic ( N : integer );
+    port ( i : in integer; o : out integer );
+end entity;
+
+architecture test of elab26_mid is
+    type int_vec is array (0 to N) of integer;
+    signal chain : int_vec;
+begin
+
+    chain(0) <= i;
+
+    g: for j in 1 to N generate
+        leaf: entity work.elab26_leaf
+            generic map ( K => j )
+            port map ( chain(j - 1), chain(j) );
+    end generate;
+
+    -- Not affected by the generic or the ports so shared between
+    -- every instance
+    check: process is
+        variable count : integer := 0;
+    begin
+        for k in 1 to 3 loop
+            count := count + k;
+        end loop;
+        assert count = 6;
+        wait;
+    end process;
+
+    o <= chain(N);
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity elab26 is
+end entity;
+
+architecture test of elab26 is
+    signal x, y1, y2, y3 : integer := 0;
+begin
+
+    m1: entity work.elab26_mid
+        generic map ( 1 )
+        port map ( x, y1 );
+
+    m2: entity work.elab26_mid
+        generic map ( 2 )
+        port map ( x, y2 );
+
+    m3: entity work.elab26_mid
+        generic map ( 3 )
+        port map ( y1, y3 );
+
+    process is
+    begin
+        x <= 10;
+        wait for 1 ns;
+        assert y1 = 10 + 2;
+        assert y2 = 10 + 2 + 4;
+        assert y3 = 12 + 2 + 4 + 6;
+        wait;
+    end process;
+
+end architecture;
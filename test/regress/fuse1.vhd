@@ -0,0 +1,50 @@
+entity fuse1 is
+end entity;
+
+architecture test of fuse1 is
+
+    function wired_or(v : bit_vector) return bit is
+    begin
+        for i in v'range loop
+            if v(i) = '1' then
+                return '1';
+            end if;
+        end loop;
+        return '0';
+    end function;
+
+    subtype rbit is wired_or bit;
+
+    signal a, b       : bit := '0';
+    signal x, y, z, w : bit;
+    signal d          : rbit;
+    signal n, m       : integer := 0;
+
+begin
+
+    x <= a and b;
+    y <= b or a;
+    z <= a xor b after 1 ns;
+    w <= reject 0 ns inertial a nand b;
+    d <= a;
+    d <= b;
+    n <= m + 1;
+    m <= 2 when a = '1' else 3 when b = '1' else 4;
+
+    stim: process is
+        procedure show is
+        begin
+            report bit'image(x) & bit'image(y) & bit'image(z) & bit'image(w)
+                & bit'image(d) & " " & integer'image(n);
+        end procedure;
+    begin
+        for i in 0 to 3 loop
+            a <= bit'val(i mod 2);
+            b <= bit'val(i / 2);
+            wait for 2 ns;
+            show;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,30 @@
+entity huge1 is
+end entity;
+
+architecture test of huge1 is
+    type int_vec is array (natural range <>) of integer;
+
+    signal v : bit_vector(1 to 4096);
+    signal n : int_vec(1 to 1024) := (others => 0);
+begin
+
+    stim: process is
+    begin
+        v(100) <= '1';
+        for i in n'range loop
+            n(i) <= i;
+        end loop;
+        wait for 1 ns;
+        assert v(100) = '1';
+        assert v(99) = '0';
+        for i in n'range loop
+            assert n(i) = i;
+        end loop;
+        v <= not v;
+        wait for 1 ns;
+        assert v(100) = '0';
+        assert v(4096) = '1';
+        wait;
+    end process;
+
+end architecture;
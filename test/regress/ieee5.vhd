@@ -0,0 +1,60 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity ieee5 is
+end entity;
+
+architecture test of ieee5 is
+    signal s : std_logic_vector(11 downto 0);
+
+    function get_left(v : std_logic_vector) return integer is
+    begin
+        return v'left;
+    end function;
+
+    function get_right(v : std_logic_vector) return integer is
+    begin
+        return v'right;
+    end function;
+
+begin
+
+    process is
+        variable x, y : std_logic_vector(11 downto 0);
+        variable v    : std_logic_vector(0 to 8);
+    begin
+        x := "010110100101";
+        y := "001111000011";
+        assert (x and y) = "000110000001";
+        assert (x or y) = "011111100111";
+        assert (x xor y) = "011001100110";
+        assert (x xnor y) = "100110011001";
+        assert (x nand y) = "111001111110";
+        assert (x nor y) = "100000011000";
+        assert (not x) = "101001011010";
+
+        -- Metavalues must propagate exactly as in the package body
+        v := "UX01ZWLH-";
+        assert (not v) = "UX10XX10X";
+        assert (v and "111111111") = "UX01XX01X";
+        assert (v and "000000000") = "000000000";
+        assert (v or "000000000") = "UX01XX01X";
+        assert (v or "111111111") = "111111111";
+        assert (v xor "000000000") = "UX01XX01X";
+        assert (v nand "111111111") = "UX10XX10X";
+
+        -- Result range is 1 to L'LENGTH
+        assert get_left(x and y) = 1;
+        assert get_right(x and y) = 12;
+        assert get_left(not v) = 1;
+
+        s <= x xor y;
+        wait for 1 ns;
+        assert s = "011001100110";
+        s <= s or "ZZZZZZZZZZZZ";
+        wait for 1 ns;
+        assert s = "X11XX11XX11X";
+        wait;
+    end process;
+
+end architecture;
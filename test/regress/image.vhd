@@ -15,10 +15,12 @@ end entity;
 use work.p.all;
 
 architecture test of image is
+    type state is (IDLE, RUNNING, DONE);
 begin
 
     process is
-        variable i : integer;
+        variable i  : integer;
+        variable st : state;
     begin
         report integer'image(4);
         report integer'image(-42);
@@ -27,6 +29,12 @@ begin
         report "i=" & integer'image(i) & " units";
         report character'image('c');
         print_char('X');
+        report boolean'image(true);
+        for s in state loop
+            st := s;
+            report "state=" & state'image(st) & "!";
+        end loop;
+        report real'image(1.5);
         wait for 10 ps;
         report time'image(now);
         wait;
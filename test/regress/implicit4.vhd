@@ -0,0 +1,54 @@
+entity implicit4 is
+end entity;
+
+architecture test of implicit4 is
+    signal x : integer := 0;
+    signal p : bit := '0';
+begin
+
+    process is
+        variable t : bit;
+    begin
+        assert x'stable;
+        assert x'quiet;
+        assert x'stable(5 ns);
+
+        -- Event on x
+        x <= 1;
+        wait for 0 ns;
+        assert not x'stable;
+        assert not x'quiet;
+        assert not x'stable(5 ns);
+        wait for 0 ns;
+        assert x'stable;
+        assert x'quiet;
+        assert not x'stable(5 ns);
+        wait for 4500 ps;
+        assert not x'stable(5 ns);
+        wait for 1 ns;
+        assert x'stable(5 ns);
+
+        -- Transaction without an event
+        t := x'transaction;
+        x <= 1;
+        wait for 0 ns;
+        assert x'stable;
+        assert not x'quiet;
+        assert x'stable(5 ns);
+        assert x'transaction /= t;
+        wait for 0 ns;
+        assert x'quiet;
+
+        -- Pulses shorter than the delay are not rejected
+        p <= '1';
+        wait for 1 ns;
+        p <= '0';
+        wait for 1500 ps;
+        assert p'delayed(2 ns) = '1';
+        wait for 1 ns;
+        assert p'delayed(2 ns) = '0';
+
+        wait;
+    end process;
+
+end architecture;
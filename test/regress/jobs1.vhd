@@ -0,0 +1,16 @@
+entity jobs1 is
+end entity;
+
+architecture test of jobs1 is
+begin
+
+    process is
+    begin
+        wait for 1 ns;
+        loop
+            report "tick";
+            wait for 2 ns;
+        end loop;
+    end process;
+
+end architecture;
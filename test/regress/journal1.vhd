@@ -0,0 +1,47 @@
+package pack is
+    constant width : integer := 4;
+    function double(x : integer) return integer;
+end package;
+
+package body pack is
+    function double(x : integer) return integer is
+    begin
+        return x * 2;
+    end function;
+end package body;
+
+-------------------------------------------------------------------------------
+
+use work.pack.all;
+
+entity journal1_sub is
+    port ( i : in integer;
+           o : out integer );
+end entity;
+
+architecture test of journal1_sub is
+begin
+    o <= double(i) + width;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity journal1 is
+end entity;
+
+architecture test of journal1 is
+    signal a, b : integer := 0;
+begin
+
+    u: entity work.journal1_sub
+        port map ( a, b );
+
+    process is
+    begin
+        a <= 3;
+        wait for 1 ns;
+        assert b = 10;
+        wait;
+    end process;
+
+end architecture;
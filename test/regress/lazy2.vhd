@@ -0,0 +1,223 @@
+entity lazy2 is
+end entity;
+
+architecture test of lazy2 is
+
+    function f0 (x : integer) return integer is
+    begin
+        return x;
+    end function;
+
+    function f1 (x : integer) return integer is
+    begin
+        return f0(x) + 1;
+    end function;
+
+    function f2 (x : integer) return integer is
+    begin
+        return f1(x) + 1;
+    end function;
+
+    function f3 (x : integer) return integer is
+    begin
+        return f2(x) + 1;
+    end function;
+
+    function f4 (x : integer) return integer is
+    begin
+        return f3(x) + 1;
+    end function;
+
+    function f5 (x : integer) return integer is
+    begin
+        return f4(x) + 1;
+    end function;
+
+    function f6 (x : integer) return integer is
+    begin
+        return f5(x) + 1;
+    end function;
+
+    function f7 (x : integer) return integer is
+    begin
+        return f6(x) + 1;
+    end function;
+
+    function f8 (x : integer) return integer is
+    begin
+        return f7(x) + 1;
+    end function;
+
+    function f9 (x : integer) return integer is
+    begin
+        return f8(x) + 1;
+    end function;
+
+    function f10 (x : integer) return integer is
+    begin
+        return f9(x) + 1;
+    end function;
+
+    function f11 (x : integer) return integer is
+    begin
+        return f10(x) + 1;
+    end function;
+
+    function f12 (x : integer) return integer is
+    begin
+        return f11(x) + 1;
+    end function;
+
+    function f13 (x : integer) return integer is
+    begin
+        return f12(x) + 1;
+    end function;
+
+    function f14 (x : integer) return integer is
+    begin
+        return f13(x) + 1;
+    end function;
+
+    function f15 (x : integer) return integer is
+    begin
+        return f14(x) + 1;
+    end function;
+
+    function f16 (x : integer) return integer is
+    begin
+        return f15(x) + 1;
+    end function;
+
+    function f17 (x : integer) return integer is
+    begin
+        return f16(x) + 1;
+    end function;
+
+    function f18 (x : integer) return integer is
+    begin
+        return f17(x) + 1;
+    end function;
+
+    function f19 (x : integer) return integer is
+    begin
+        return f18(x) + 1;
+    end function;
+
+    function f20 (x : integer) return integer is
+    begin
+        return f19(x) + 1;
+    end function;
+
+    function f21 (x : integer) return integer is
+    begin
+        return f20(x) + 1;
+    end function;
+
+    function f22 (x : integer) return integer is
+    begin
+        return f21(x) + 1;
+    end function;
+
+    function f23 (x : integer) return integer is
+    begin
+        return f22(x) + 1;
+    end function;
+
+    function f24 (x : integer) return integer is
+    begin
+        return f23(x) + 1;
+    end function;
+
+    function f25 (x : integer) return integer is
+    begin
+        return f24(x) + 1;
+    end function;
+
+    function f26 (x : integer) return integer is
+    begin
+        return f25(x) + 1;
+    end function;
+
+    function f27 (x : integer) return integer is
+    begin
+        return f26(x) + 1;
+    end function;
+
+    function f28 (x : integer) return integer is
+    begin
+        return f27(x) + 1;
+    end function;
+
+    function f29 (x : integer) return integer is
+    begin
+        return f28(x) + 1;
+    end function;
+
+    function f30 (x : integer) return integer is
+    begin
+        return f29(x) + 1;
+    end function;
+
+    function f31 (x : integer) return integer is
+    begin
+        return f30(x) + 1;
+    end function;
+
+    function f32 (x : integer) return integer is
+    begin
+        return f31(x) + 1;
+    end function;
+
+    function f33 (x : integer) return integer is
+    begin
+        return f32(x) + 1;
+    end function;
+
+    function f34 (x : integer) return integer is
+    begin
+        return f33(x) + 1;
+    end function;
+
+    function f35 (x : integer) return integer is
+    begin
+        return f34(x) + 1;
+    end function;
+
+    function f36 (x : integer) return integer is
+    begin
+        return f35(x) + 1;
+    end function;
+
+    function f37 (x : integer) return integer is
+    begin
+        return f36(x) + 1;
+    end function;
+
+    function f38 (x : integer) return integer is
+    begin
+        return f37(x) + 1;
+    end function;
+
+    function f39 (x : integer) return integer is
+    begin
+        return f38(x) + 1;
+    end function;
+
+    signal x, y : integer := 0;
+
+begin
+
+    x <= f39(1) after 1 ns;
+
+    y <= f20(x);
+
+    process is
+    begin
+        wait for 2 ns;
+        assert x = 40;
+        assert y = 60;
+        assert f5(0) = 5;
+        wait;
+    end process;
+
+end architecture;
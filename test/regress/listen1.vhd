@@ -0,0 +1,10 @@
+entity listen1 is
+end entity;
+
+architecture test of listen1 is
+    signal x : integer;
+begin
+
+    x <= 1 after 1 ns;
+
+end architecture;
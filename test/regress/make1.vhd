@@ -0,0 +1,25 @@
+package make1_pack is
+    constant WIDTH : integer := 8;
+end package;
+
+-------------------------------------------------------------------------------
+
+entity make1 is
+end entity;
+
+use work.make1_pack.all;
+
+architecture test of make1 is
+    signal x : bit_vector(1 to WIDTH);
+begin
+
+    process is
+    begin
+        x <= (others => '1');
+        wait for 1 ns;
+        assert x = (1 to WIDTH => '1');
+        report "done";
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,42 @@
+package meta1_pack is
+    procedure say (x : integer);
+    function divide (x, y : integer) return integer;
+end package;
+
+package body meta1_pack is
+
+    procedure say (x : integer) is
+    begin
+        report "say " & integer'image(x);
+        assert x < 2 report "x too big" severity warning;
+    end procedure;
+
+    function divide (x, y : integer) return integer is
+    begin
+        return x / y;
+    end function;
+
+end package body;
+
+-------------------------------------------------------------------------------
+
+entity meta1 is
+end entity;
+
+use work.meta1_pack.all;
+
+architecture test of meta1 is
+    signal zero : integer := 0;
+begin
+
+    process is
+    begin
+        wait for 1 ns;
+        say(1);
+        say(2);
+        wait for 1 ns;
+        assert divide(5, zero) = 0;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,40 @@
+entity native1 is
+end entity;
+
+architecture test of native1 is
+
+    function sum (v : integer_vector) return integer is
+        variable r : integer := 0;
+    begin
+        for i in v'range loop
+            r := r + v(i);
+        end loop;
+        return r;
+    end function;
+
+    signal a, b, c, d : integer := 0;
+
+begin
+
+    a <= 1, 2 after 1 ns, 3 after 2 ns;
+
+    b <= a * 2;
+
+    c <= sum((a, b));
+
+    process (c) is
+    begin
+        d <= d + c;
+    end process;
+
+    check: process is
+    begin
+        wait for 5 ns;
+        assert a = 3;
+        assert b = 6;
+        assert c = sum((3, 6));
+        assert d = 30;
+        wait;
+    end process;
+
+end architecture;
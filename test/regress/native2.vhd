@@ -0,0 +1,18 @@
+entity native2 is
+end entity;
+
+architecture test of native2 is
+    signal x : integer := 0;
+begin
+
+    x <= x + 1 after 1 ns when x < 10;
+
+    process is
+    begin
+        wait for 20 ns;
+        assert x = 10;
+        report "done";
+        wait;
+    end process;
+
+end architecture;
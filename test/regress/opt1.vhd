@@ -0,0 +1,32 @@
+entity opt1 is
+end entity;
+
+architecture test of opt1 is
+
+    function fact (n : natural) return natural is
+    begin
+        if n = 0 then
+            return 1;
+        else
+            return n * fact(n - 1);
+        end if;
+    end function;
+
+    signal x : natural := 1;
+
+begin
+
+    process is
+        variable sum : natural := 0;
+    begin
+        for i in 0 to 5 loop
+            sum := sum + fact(i);
+        end loop;
+        assert sum = 154;
+        x <= sum;
+        wait for 1 ns;
+        assert x = 154;
+        wait;
+    end process;
+
+end architecture;
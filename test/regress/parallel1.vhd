@@ -0,0 +1,85 @@
+entity parallel1 is
+end entity;
+
+use std.textio.all;
+
+architecture test of parallel1 is
+    constant N     : integer := 16;
+    constant TICKS : integer := 3;
+
+    type int_vec is array (natural range <>) of integer;
+
+    signal clk   : bit := '0';
+    signal count : int_vec(0 to N - 1) := (others => 0);
+
+    shared variable total : integer := 0;
+
+    file results : text open WRITE_MODE is "parallel1.txt";
+begin
+
+    gen: for i in 0 to N - 1 generate
+
+        -- Only communicates through signals so may run on any thread
+        counter: process (clk) is
+        begin
+            if clk'event and clk = '1' then
+                count(i) <= count(i) + i;
+                report "count " & integer'image(i);
+            end if;
+        end process;
+
+        -- Updates a shared variable and writes to a file so must run
+        -- on the main thread in turn
+        logger: process (clk) is
+            variable l : line;
+        begin
+            if clk'event and clk = '1' then
+                total := total + i;
+                write(l, i);
+                write(l, ' ');
+                write(l, total);
+                writeline(results, l);
+            end if;
+        end process;
+
+    end generate;
+
+    stim: process is
+        variable l     : line;
+        variable i     : integer;
+        variable t     : integer;
+        variable last  : integer := 0;
+        variable lines : integer := 0;
+        variable sum   : integer := 0;
+    begin
+        for j in 1 to TICKS loop
+            clk <= '1';
+            wait for 1 ns;
+            clk <= '0';
+            wait for 1 ns;
+        end loop;
+
+        for j in 0 to N - 1 loop
+            assert count(j) = TICKS * j;
+        end loop;
+
+        file_close(results);
+        file_open(results, "parallel1.txt", READ_MODE);
+        while not endfile(results) loop
+            readline(results, l);
+            read(l, i);
+            read(l, t);
+            assert t >= last report "total decreased";
+            last := t;
+            sum := sum + i;
+            lines := lines + 1;
+        end loop;
+        file_close(results);
+
+        report "lines " & integer'image(lines);
+        report "sum " & integer'image(sum);
+        report "total " & integer'image(total);
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,41 @@
+entity perfmap1_sub is
+    port ( x : in integer; y : out integer );
+end entity;
+
+architecture test of perfmap1_sub is
+begin
+
+    y <= x * 2;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity perfmap1 is
+end entity;
+
+architecture test of perfmap1 is
+
+    function inc (x : integer) return integer is
+    begin
+        return x + 1;
+    end function;
+
+    signal a, b : integer := 0;
+
+begin
+
+    u: entity work.perfmap1_sub
+        port map ( a, b );
+
+    process is
+    begin
+        for i in 1 to 10 loop
+            a <= inc(a);
+            wait for 1 ns;
+            assert b = 2 * i;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,33 @@
+entity pgo1 is
+end entity;
+
+architecture test of pgo1 is
+    signal clk   : bit := '0';
+    signal count : natural := 0;
+    signal rst   : bit := '1';
+begin
+
+    clk <= not clk after 5 ns when now < 10 us;
+
+    hot: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            if rst = '1' then
+                count <= 0;
+            else
+                count <= count + 1;
+            end if;
+        end if;
+    end process;
+
+    cold: process is
+    begin
+        wait for 12 ns;
+        rst <= '0';
+        wait for 10 us;
+        assert count = 999;
+        report "count is " & integer'image(count);
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,27 @@
+entity proc12 is
+end entity;
+
+architecture test of proc12 is
+
+    procedure delay (s : string) is
+        variable copy : string(1 to s'length) := s;
+    begin
+        wait for 1 ns;
+        assert copy = s;
+    end procedure;
+
+begin
+
+    process is
+    begin
+        wait for 1 ns;
+        for i in 1 to 100 loop
+            -- The private stack kept while suspended in the procedure is
+            -- released when the process suspends here and then reused
+            delay("iteration" & integer'image(i));
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,78 @@
+entity proc13_sub is
+    generic ( W : integer );
+    port ( i : in integer; o : out integer );
+end entity;
+
+architecture test of proc13_sub is
+    signal s1, s2, s3 : integer := 0;
+begin
+
+    p1: process (i) is
+    begin
+        s1 <= i + W;
+    end process;
+
+    p2: process (s1) is
+        variable v : integer;
+    begin
+        v := s1 * 2;
+        s2 <= v;
+    end process;
+
+    p3: process (s2) is
+        type int_vec is array (1 to W) of integer;
+        variable tmp : int_vec;
+        variable sum : integer;
+    begin
+        sum := 0;
+        for k in tmp'range loop
+            tmp(k) := s2 + k;
+            sum := sum + tmp(k);
+        end loop;
+        s3 <= sum;
+    end process;
+
+    o <= s3;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity proc13 is
+end entity;
+
+-- The gold file checks that only the context, EXPECT and a single
+-- process have vcode at any one time during elaboration
+
+architecture test of proc13 is
+    type int_vec is array (1 to 8) of integer;
+    signal i, o : int_vec := (others => 0);
+
+    function expect (n, w : integer) return integer is
+    begin
+        -- sum of ((n + w) * 2 + k) for k in 1 to w
+        return (n + w) * 2 * w + w * (w + 1) / 2;
+    end function;
+begin
+
+    g: for n in 1 to 8 generate
+        u: entity work.proc13_sub
+            generic map ( n )
+            port map ( i(n), o(n) );
+    end generate;
+
+    stim: process is
+    begin
+        for n in 1 to 8 loop
+            i(n) <= n * 10;
+        end loop;
+        wait for 1 ns;
+        for n in 1 to 8 loop
+            assert o(n) = expect(n * 10, n)
+                report "bad output " & integer'image(o(n)) & " from "
+                & integer'image(n);
+        end loop;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,20 @@
+entity profile1 is
+end entity;
+
+architecture test of profile1 is
+    signal x, y : integer := 0;
+begin
+
+    process is
+    begin
+        for i in 1 to 10 loop
+            x <= i;                     -- Ten events
+            if i <= 5 then
+                y <= 1;                 -- Five transactions and one event
+            end if;
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
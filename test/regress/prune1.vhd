@@ -0,0 +1,41 @@
+entity prune1 is
+end entity;
+
+architecture test of prune1 is
+    signal zero  : bit := '0';          -- Tied off to its initial value
+    signal count : integer := 0;
+    signal sum   : integer;
+    signal inv   : bit;
+    signal done  : boolean := false;
+begin
+
+    zero <= '0';
+
+    inv <= not zero;                    -- Only trigger is constant
+
+    sum <= count + 1 when zero = '0' else count - 1;
+
+    stim: process is
+    begin
+        wait until zero = '1' for 1 ns;
+        assert now = 1 ns;
+        wait on zero for 1 ns;
+        assert now = 2 ns;
+        assert inv = '1';
+        assert sum = 1;
+        count <= 5;
+        wait for 1 ns;
+        assert sum = 6;
+        done <= true;
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait for 10 ns;
+        assert done report "stimulus process did not resume"
+            severity failure;
+        wait;
+    end process;
+
+end architecture;
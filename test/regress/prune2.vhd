@@ -0,0 +1,38 @@
+entity prune2 is
+end entity;
+
+architecture test of prune2 is
+    signal one  : bit := '0';           -- Constant differs from initial
+    signal n    : integer := 1;
+    signal m    : integer;
+    signal done : boolean := false;
+begin
+
+    one <= '1';
+    n   <= 2;
+
+    m <= n * 2;
+
+    stim: process is
+    begin
+        assert one = '0';
+        assert n = 1;
+        wait until one = '1';
+        assert now = 0 ns;
+        assert n = 2;
+        wait on n for 1 ns;
+        assert now = 1 ns;
+        assert m = 4;
+        done <= true;
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait for 10 ns;
+        assert done report "stimulus process did not resume"
+            severity failure;
+        wait;
+    end process;
+
+end architecture;
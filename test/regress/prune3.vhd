@@ -0,0 +1,39 @@
+entity prune3_sub is
+    port ( i : in integer;
+           o : out integer );
+end entity;
+
+architecture test of prune3_sub is
+    signal scratch : integer;           -- Never read
+begin
+    o <= i * 2;
+    scratch <= i + 1;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity prune3 is
+end entity;
+
+architecture test of prune3 is
+    signal a, b, c : integer := 0;
+    signal dead    : integer;           -- Never read
+begin
+
+    u: entity work.prune3_sub
+        port map ( a, b );
+
+    dead <= b + c;
+    c    <= b + 1;
+
+    stim: process is
+    begin
+        for i in 1 to 3 loop
+            a <= i;
+            wait for 1 ns;
+            report "b = " & integer'image(b) & " c = " & integer'image(c);
+        end loop;
+        wait;
+    end process;
+
+end architecture;
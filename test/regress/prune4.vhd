@@ -0,0 +1,32 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity prune4 is
+end entity;
+
+architecture test of prune4 is
+
+    function invert (x : bit_vector) return bit is
+    begin
+        return not x(x'low);
+    end function;
+
+    subtype inv_bit is invert bit;
+
+    signal inv  : inv_bit := '0';       -- Resolved value is not the driver
+    signal tied : std_logic := '0';     -- Replaced by its constant
+
+begin
+
+    inv  <= '0';
+    tied <= '0';
+
+    process is
+    begin
+        wait for 1 ns;
+        assert inv = '1' report "inv replaced by its driver";
+        assert tied = '0';
+        wait;
+    end process;
+
+end architecture;
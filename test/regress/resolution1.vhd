@@ -0,0 +1,85 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity resolution1 is
+end entity;
+
+architecture test of resolution1 is
+
+    type level is (lo, hi);
+    type level_vector is array (natural range <>) of level;
+
+    -- Folds like a wired or for up to three drivers but not four
+    function by_count(x : level_vector) return level is
+        variable r : level := lo;
+    begin
+        if x'length >= 4 then
+            return hi;
+        end if;
+        for i in x'range loop
+            if x(i) = hi then
+                r := hi;
+            end if;
+        end loop;
+        return r;
+    end function;
+
+    function wired_or(x : level_vector) return level is
+    begin
+        for i in x'range loop
+            if x(i) = hi then
+                return hi;
+            end if;
+        end loop;
+        return lo;
+    end function;
+
+    attribute foldable : boolean;
+    attribute foldable of wired_or : function is true;
+
+    subtype count_level is by_count level;
+    subtype or_level is wired_or level;
+
+    signal s3 : std_logic := 'Z';
+    signal s4 : std_logic_vector(1 to 3) := "ZZZ";
+    signal c  : count_level;
+    signal w  : or_level;
+
+begin
+
+    s3 <= 'Z';
+    s3 <= 'H';
+    s3 <= 'L' after 1 ns;
+
+    s4 <= "ZZ1";
+    s4 <= "HZZ";
+    s4 <= "ZLZ";
+    s4 <= "Z0Z" after 1 ns;
+
+    c <= lo;
+    c <= lo;
+    c <= lo;
+    c <= lo;
+
+    w <= lo;
+    w <= lo;
+    w <= lo;
+    w <= lo;
+    w <= hi after 1 ns;
+
+    process is
+    begin
+        wait for 0 ns;
+        assert s3 = 'H';
+        assert s4 = "HL1";
+        assert c = hi;
+        assert w = lo;
+        wait for 1 ns;
+        assert s3 = 'W';
+        assert s4 = "H01";
+        assert c = hi;
+        assert w = hi;
+        wait;
+    end process;
+
+end architecture;
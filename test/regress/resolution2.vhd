@@ -0,0 +1,35 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity resolution2 is
+end entity;
+
+architecture test of resolution2 is
+    signal bus4 : std_logic := 'Z';
+begin
+
+    -- Four drivers so the std_logic table is folded over the drivers
+    -- rather than looked up for a pair or calling RESOLVED
+
+    bus4 <= 'Z', '1' after 1 ns, 'Z' after 2 ns;
+    bus4 <= 'Z', 'L' after 2 ns;
+    bus4 <= 'Z', '-' after 3 ns;
+    bus4 <= 'H', '0' after 4 ns;
+
+    process is
+    begin
+        wait for 0 ns;
+        assert bus4 = 'H';
+        wait for 1 ns;
+        assert bus4 = '1';
+        wait for 1 ns;
+        assert bus4 = 'W';
+        wait for 1 ns;
+        assert bus4 = 'X';
+        wait for 1 ns;
+        assert bus4 = 'X';
+        report "done";
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,34 @@
+entity saif1_sub is
+end entity;
+
+architecture test of saif1_sub is
+    signal s : boolean := false;
+begin
+
+    s <= true after 2 ns;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity saif1 is
+end entity;
+
+architecture test of saif1 is
+    signal a : bit := '0';
+    signal l : std_logic := 'U';
+    signal v : bit_vector(1 downto 0) := "00";
+begin
+
+    a <= '1' after 1 ns, '0' after 3 ns;
+
+    l <= '0' after 1 ns, 'H' after 2 ns, 'X' after 3 ns;
+
+    v <= "01" after 2 ns, "11" after 4 ns;
+
+    u: entity work.saif1_sub;
+
+end architecture;
@@ -0,0 +1,39 @@
+entity shift3 is
+end entity;
+
+architecture test of shift3 is
+    signal n : integer := 0;
+begin
+
+    process is
+        variable v  : bit_vector(1 to 0);
+        variable d  : bit_vector(0 downto 1);
+        variable r  : bit_vector(1 to 0);
+        variable rd : bit_vector(0 downto 1);
+    begin
+        n <= 3;
+        wait for 1 ns;
+
+        -- Shift amount is not known until run time
+        r := v sll n;
+        r := v srl n;
+        r := v sla n;
+        r := v sra n;
+        r := v rol n;
+        r := v ror n;
+        r := v sla -n;
+        r := v sra -n;
+
+        rd := d sll n;
+        rd := d sla n;
+        rd := d sra n;
+        rd := d ror n;
+
+        assert r'length = 0;
+        assert rd'length = 0;
+        assert (v sra n) = r;
+        report "done";
+        wait;
+    end process;
+
+end architecture;
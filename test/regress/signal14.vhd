@@ -0,0 +1,59 @@
+entity signal14 is
+end entity;
+
+architecture test of signal14 is
+    type rec is record
+        a, b : integer;
+        c    : bit_vector(1 to 4);
+        d    : boolean;
+    end record;
+
+    signal v : bit_vector(1 to 8) := (others => '0');
+    signal r : rec := (0, 0, "0000", false);
+    signal n : natural := 0;
+begin
+
+    v(5 to 8) <= "1010" when n = 1 else "0000";
+
+    stim: process is
+    begin
+        n <= 1;
+        r <= (1, 2, "1010", true);
+        wait for 0 ns;
+
+        -- Every element of the record updates in the same delta
+        assert r = (1, 2, "1010", true);
+        assert r'event;
+
+        -- Assigning v(2) on its own splits v(1 to 4) into three groups
+        -- which the next assignment updates together
+        v(2) <= '1';
+        wait for 0 ns;
+        assert v = "01001010";
+        v(1 to 4) <= "1011";
+        wait for 0 ns;
+        assert v = "10111010";
+
+        -- A second zero delay assignment replaces the first
+        r <= (5, 6, "0101", false);
+        r <= (7, 8, "1111", true);
+        wait for 0 ns;
+        assert r = (7, 8, "1111", true);
+        wait for 0 ns;
+        assert r = (7, 8, "1111", true);
+
+        -- Delayed transactions are still rejected individually
+        r.a <= 10 after 5 ns;
+        r <= (20, 21, "0000", false) after 2 ns;
+        wait for 3 ns;
+        assert r = (20, 21, "0000", false);
+        wait for 3 ns;
+        assert r.a = 20 report "delayed transaction was not rejected";
+
+        n <= 2;
+        wait for 1 ns;
+        assert v = "10110000";
+        wait;
+    end process;
+
+end architecture;
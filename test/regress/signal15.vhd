@@ -0,0 +1,88 @@
+entity signal15 is
+end entity;
+
+architecture test of signal15 is
+    type int_vec is array (1 to 2) of integer;
+
+    signal b  : bit;
+    signal i  : integer;
+    signal r  : real;
+    signal t  : time;
+    signal iv : int_vec;
+    signal v8 : bit_vector(1 to 8);
+    signal v9 : bit_vector(1 to 9);
+begin
+
+    stim_p: process is
+    begin
+        b  <= '1';
+        i  <= -5;
+        r  <= -1.5;
+        t  <= 5 ns;
+        iv <= (1, -1);
+        v8 <= X"a5";
+        v9 <= "101010101";
+        wait for 0 ns;
+        assert b = '1' and b'event;
+        assert i = -5 and i'event;
+        assert r = -1.5 and r'event;
+        assert t = 5 ns and t'event;
+        assert iv = (1, -1) and iv'event;
+        assert v8 = X"a5" and v8'event;
+        assert v9 = "101010101" and v9'event;
+
+        -- Assigning the same value is a transaction but not an event
+        b  <= '1';
+        i  <= -5;
+        r  <= -1.5;
+        t  <= 5 ns;
+        iv <= (1, -1);
+        v8 <= X"a5";
+        v9 <= "101010101";
+        wait for 0 ns;
+        assert b'active and not b'event;
+        assert i'active and not i'event;
+        assert r'active and not r'event;
+        assert t'active and not t'event;
+        assert iv'active and not iv'event;
+        assert v8'active and not v8'event;
+        assert v9'active and not v9'event;
+
+        -- Several pending transactions of each size
+        i  <= 1 after 1 ns, 2 after 2 ns, 3 after 3 ns;
+        r  <= 0.5 after 1 ns, 1.0e100 after 2 ns;
+        iv <= (2, 3) after 1 ns, (integer'low, integer'high) after 2 ns;
+        v9 <= "111111111" after 1 ns, "000000001" after 2 ns;
+        wait for 1500 ps;
+        assert i = 1;
+        assert r = 0.5;
+        assert iv = (2, 3);
+        assert v9 = "111111111";
+        wait for 1 ns;
+        assert i = 2;
+        assert r = 1.0e100;
+        assert iv = (integer'low, integer'high);
+        assert v9 = "000000001";
+        assert v9'last_value = "111111111";
+        wait for 1 ns;
+        assert i = 3;
+
+        -- Inertial rejection compares values of each size
+        i  <= 7 after 2 ns;
+        iv <= (4, 5) after 2 ns;
+        v9 <= "000000011" after 2 ns;
+        wait for 1 ns;
+        i  <= 7 after 2 ns;             -- Previous transaction kept
+        iv <= (4, 6) after 2 ns;        -- Previous transaction rejected
+        v9 <= "000000011" after 2 ns;   -- Previous transaction kept
+        wait for 1500 ps;
+        assert i = 7;
+        assert iv = (integer'low, integer'high);
+        assert v9 = "000000011";
+        wait for 1 ns;
+        assert iv = (4, 6);
+
+        wait;
+    end process;
+
+end architecture;
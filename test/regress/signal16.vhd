@@ -0,0 +1,19 @@
+entity signal16 is
+end entity;
+
+architecture test of signal16 is
+    signal x : bit_vector(1 to 4);
+begin
+
+    process is
+        variable r : delay_length := 2 ns;
+        variable d : delay_length := 1 ns;
+    begin
+        x(2) <= '1';
+        wait for 1 ns;
+        assert x = "0100";
+        x(2) <= reject r inertial '0' after d;  -- Error
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,51 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity signal17 is
+end entity;
+
+architecture test of signal17 is
+
+    -- Each of these signals is large enough that its storage is mapped
+    -- lazily rather than allocated from the signal chunks
+
+    constant SIZE : positive := 2 ** 22;
+
+    type mem_t is array (0 to SIZE - 1) of std_logic;
+
+    signal m1 : mem_t;
+    signal m2 : mem_t := (0 => '0', others => '1');
+
+begin
+
+    process is
+    begin
+        assert m1(0) = 'U';
+        assert m1(SIZE - 1) = 'U';
+        assert m2(0) = '0';
+        assert m2(1) = '1';
+        assert m2(SIZE - 1) = '1';
+
+        m1(5) <= '1';
+        m1(SIZE - 1) <= '0';
+        m2(SIZE / 2) <= 'Z';
+        wait for 1 ns;
+
+        assert m1(4) = 'U';
+        assert m1(5) = '1';
+        assert m1(SIZE - 1) = '0';
+        assert m1(5)'last_value = 'U';
+        assert m2(SIZE / 2) = 'Z';
+        assert m2(SIZE / 2 + 1) = '1';
+        assert m2(0) = '0';
+
+        m1 <= (others => '0');
+        wait for 1 ns;
+
+        assert m1(5) = '0';
+        assert m1(SIZE / 2) = '0';
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,43 @@
+package signal18_pkg is
+    signal s : integer := 0;
+
+    impure function s_last_event return delay_length;
+end package;
+
+package body signal18_pkg is
+
+    -- The reference to s'last_event is not visible when grouping the
+    -- nets of signal18 so s starts out with no readers
+
+    impure function s_last_event return delay_length is
+    begin
+        return s'last_event;
+    end function;
+
+end package body;
+
+-------------------------------------------------------------------------------
+
+use work.signal18_pkg.all;
+
+entity signal18 is
+end entity;
+
+architecture test of signal18 is
+begin
+
+    driver: process is
+    begin
+        s <= 1 after 1 ns, 2 after 3 ns;
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait for 5 ns;
+        assert s = 2;
+        assert s_last_event = 2 ns;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,22 @@
+entity stats2 is
+end entity;
+
+architecture test of stats2 is
+    signal x, y : integer := 0;
+begin
+
+    p1: process is
+    begin
+        for i in 1 to 10 loop
+            x <= i;
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    p2: process (x) is
+    begin
+        y <= x * 2;
+    end process;
+
+end architecture;
@@ -0,0 +1,76 @@
+entity textio4 is
+end entity;
+
+use std.textio.all;
+
+architecture test of textio4 is
+begin
+
+    process is
+        file tmp      : text;
+        variable l    : line;
+        variable long : string(1 to 300);
+        variable int  : integer;
+        variable good : boolean;
+    begin
+        for i in long'range loop
+            long(i) := character'val(character'pos('a') + (i mod 26));
+        end loop;
+
+        file_open(tmp, "tmp.txt", WRITE_MODE);
+        write(l, long);
+        writeline(tmp, l);
+        write(l, long(1 to 128));
+        writeline(tmp, l);
+        writeline(tmp, l);
+        write(l, string'("  42 -17 +5 2147483647 -2147483648 x"));
+        writeline(tmp, l);
+        write(l, string'("99999999999 crlf") & CR);
+        writeline(tmp, l);
+        write(l, string'("no newline"));
+        write(tmp, l.all);
+        file_close(tmp);
+
+        file_open(tmp, "tmp.txt", READ_MODE);
+
+        -- Lines longer than one chunk
+        readline(tmp, l);
+        assert l'length = 300;
+        assert l.all = long;
+
+        readline(tmp, l);
+        assert l'length = 128;
+        assert l.all = long(1 to 128);
+
+        readline(tmp, l);
+        assert l'length = 0;
+
+        readline(tmp, l);
+        read(l, int);
+        assert int = 42;
+        read(l, int);
+        assert int = -17;
+        read(l, int);
+        assert int = 5;
+        read(l, int);
+        assert int = integer'high;
+        read(l, int);
+        assert int = integer'low;
+        read(l, int, good);
+        assert not good;
+        assert l.all = " x";
+
+        readline(tmp, l);
+        read(l, int, good);
+        assert not good;                -- Overflow
+        assert l.all = "99999999999 crlf";
+
+        readline(tmp, l);
+        assert l.all = "no newline";
+        assert endfile(tmp);
+
+        file_close(tmp);
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,23 @@
+entity vhpi4 is
+end entity;
+
+architecture test of vhpi4 is
+    signal a : bit_vector(7 downto 0) := X"00";
+    signal b : integer := 0;
+    signal c : bit := '0';
+begin
+
+    process is
+    begin
+        for i in 1 to 5 loop
+            wait for 1 ns;
+            a <= not a;
+            if i mod 2 = 0 then
+                b <= b + 1;
+            end if;
+        end loop;
+        assert c = '1' report "VHPI plugin did not force C" severity failure;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,17 @@
+entity vhpi5 is
+end entity;
+
+architecture test of vhpi5 is
+    signal x : integer := 0;
+begin
+
+    process is
+    begin
+        for i in 1 to 50 loop
+            wait for 1 ns;
+            x <= i;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
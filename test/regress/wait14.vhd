@@ -0,0 +1,64 @@
+entity wait14 is
+end entity;
+
+architecture test of wait14 is
+    type nat_vec is array (1 to 4) of natural;
+
+    signal a, b, c   : bit_vector(1 to 8) := (others => '0');
+    signal na, nb    : natural := 0;
+    signal nab       : natural := 0;
+    signal nc        : nat_vec := (others => 0);
+begin
+
+    pa: process (a) is
+    begin
+        na <= na + 1;
+    end process;
+
+    pb: process is
+    begin
+        wait on b;
+        nb <= nb + 1;
+    end process;
+
+    pab: process is
+    begin
+        wait on a, b;
+        nab <= nab + 1;
+    end process;
+
+    g: for i in 1 to 4 generate
+        pc: process is
+        begin
+            wait on c;
+            nc(i) <= nc(i) + 1;
+        end process;
+    end generate;
+
+    stim: process is
+    begin
+        wait for 1 ns;
+        a(3) <= '1';                    -- Wakes pa, pab
+        wait for 1 ns;
+        b(1 to 2) <= "11";              -- Wakes pb, pab
+        wait for 1 ns;
+        c(8) <= '1';                    -- Wakes all pc
+        wait for 1 ns;
+        a(5) <= '1';                    -- Wakes pa, pb, pab once
+        b(8) <= '1';
+        wait for 1 ns;
+        assert na = 3;
+        assert nb = 2;
+        assert nab = 3;
+        assert nc = (1, 1, 1, 1);
+        a <= a;                         -- No event
+        c(1 to 4) <= "1111";
+        wait for 1 ns;
+        assert na = 3;
+        assert nab = 3;
+        assert nc = (2, 2, 2, 2);
+        report "done";
+        wait;
+    end process;
+
+end architecture;
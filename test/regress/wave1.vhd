@@ -0,0 +1,25 @@
+entity wave1 is
+end entity;
+
+architecture test of wave1 is
+    signal v   : bit_vector(1 to 1024);
+    signal cnt : integer := 0;
+    signal s   : string(1 to 5) := "hello";
+begin
+
+    process is
+    begin
+        -- Enough changes to wrap around the queue several times
+        for i in 1 to 10000 loop
+            v   <= not v;
+            cnt <= i;
+            wait for 1 ns;
+        end loop;
+        s <= "world";
+        wait for 1 ns;
+        assert cnt = 10000;
+        assert v = (v'range => '0');
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,24 @@
+entity wave2 is
+end entity;
+
+architecture test of wave2 is
+    signal a : bit;
+    signal n : integer range 0 to 15;
+begin
+
+    process is
+    begin
+        wait for 1 ns;
+        a <= '1';                       -- Glitch is not dumped
+        n <= 5;
+        wait for 0 ns;
+        a <= '0';
+        wait for 1 ns;
+        a <= '1';
+        n <= 3;
+        wait for 0 ns;
+        n <= 7;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,22 @@
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity wave3 is
+end entity;
+
+architecture test of wave3 is
+    signal i : integer := 0;
+    signal v : std_logic_vector(1 to 9) := (others => '0');
+begin
+
+    process is
+    begin
+        wait for 1 ns;
+        i <= -1;                        -- All 32 bits set
+        v <= "UX01ZWLH-";
+        wait for 1 ns;
+        i <= integer'high;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,47 @@
+entity wave4_leaf is
+end entity;
+
+architecture test of wave4_leaf is
+    signal c : bit;
+begin
+
+    c <= '1' after 3 ns;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity wave4_sub is
+end entity;
+
+architecture test of wave4_sub is
+    signal b : bit;
+begin
+
+    b <= '1' after 3 ns;
+
+    v: entity work.wave4_leaf;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity wave4 is
+end entity;
+
+architecture test of wave4 is
+    signal a : bit;
+begin
+
+    process is
+    begin
+        for i in 1 to 6 loop
+            wait for 1 ns;
+            a <= not a;
+        end loop;
+        wait;
+    end process;
+
+    u: entity work.wave4_sub;
+
+end architecture;
@@ -0,0 +1,29 @@
+entity wave5_sub is
+end entity;
+
+architecture test of wave5_sub is
+    signal x1, z : bit;
+begin
+
+    x1 <= '1' after 5 ns;
+    z  <= '1' after 6 ns;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity wave5 is
+end entity;
+
+architecture test of wave5 is
+    signal x1, x2, y1, y2 : bit;
+begin
+
+    x1 <= '1' after 1 ns;
+    x2 <= '1' after 2 ns;               -- Excluded by *2
+    y1 <= '1' after 3 ns;
+    y2 <= '1' after 4 ns;               -- Excluded by *2
+
+    u: entity work.wave5_sub;           -- Excluded by :wave5:u:*
+
+end architecture;
@@ -40,9 +40,23 @@
 #define F_COVER   (1 << 7)
 #define F_GENERIC (1 << 8)
 #define F_RELAX   (1 << 9)
+#define F_CYCLE   (1 << 10)
+#define F_JOBS    (1 << 11)
+#define F_WAVE    (1 << 12)
+#define F_MERGE   (1 << 13)
+#define F_REPEAT  (1 << 14)
+#define F_PGO     (1 << 15)
+#define F_SAIF    (1 << 16)
+#define F_MAKE    (1 << 17)
+#define F_PRUNE   (1 << 18)
+#define F_THREADS (1 << 19)
+#define F_SHELL   (1 << 20)
+#define F_FUSE    (1 << 21)
+#define F_SPLIT   (1 << 22)
 
 typedef struct test test_t;
 typedef struct generic generic_t;
+typedef struct option option_t;
 typedef struct arglist arglist_t;
 
 struct generic {
@@ -51,6 +65,11 @@ struct generic {
    generic_t *next;
 };
 
+struct option {
+   char     *text;
+   option_t *next;
+};
+
 struct test {
    char      *name;
    test_t    *next;
@@ -58,6 +77,10 @@ struct test {
    char      *stop;
    generic_t *generics;
    char      *relax;
+   option_t  *analyse_opts;
+   option_t  *extra_files;
+   option_t  *elab_opts;
+   option_t  *run_opts;
 };
 
 struct arglist {
@@ -82,6 +105,17 @@ static bool is_comment(const char *str)
    return str[0] == '#';
 }
 
+static void add_option(option_t **list, const char *text)
+{
+   // Extra command line options are passed in the order given
+   option_t *o = calloc(sizeof(option_t), 1);
+   o->text = strdup(text);
+
+   for (; *list != NULL; list = &((*list)->next))
+      ;
+   *list = o;
+}
+
 static bool parse_test_list(int argc, char **argv)
 {
    char testlist[PATH_MAX];
@@ -164,6 +198,32 @@ static bool parse_test_list(int argc, char **argv)
             test->flags |= F_OPT;
          else if (strcmp(opt, "cover") == 0)
             test->flags |= F_COVER;
+         else if (strcmp(opt, "cycle") == 0)
+            test->flags |= F_CYCLE;
+         else if (strcmp(opt, "jobs") == 0)
+            test->flags |= F_JOBS;
+         else if (strcmp(opt, "wave") == 0)
+            test->flags |= F_WAVE;
+         else if (strcmp(opt, "merge") == 0)
+            test->flags |= F_MERGE;
+         else if (strcmp(opt, "repeat") == 0)
+            test->flags |= F_REPEAT;
+         else if (strcmp(opt, "pgo") == 0)
+            test->flags |= F_PGO;
+         else if (strcmp(opt, "saif") == 0)
+            test->flags |= F_SAIF;
+         else if (strcmp(opt, "make") == 0)
+            test->flags |= F_MAKE;
+         else if (strcmp(opt, "prune") == 0)
+            test->flags |= F_PRUNE;
+         else if (strcmp(opt, "threads") == 0)
+            test->flags |= F_THREADS;
+         else if (strcmp(opt, "shell") == 0)
+            test->flags |= F_SHELL;
+         else if (strcmp(opt, "fuse") == 0)
+            test->flags |= F_FUSE;
+         else if (strcmp(opt, "split") == 0)
+            test->flags |= F_SPLIT;
          else if (strncmp(opt, "g", 1) == 0) {
             char *value = strchr(opt, '=');
             if (value == NULL) {
@@ -191,6 +251,14 @@ static bool parse_test_list(int argc, char **argv)
             test->flags |= F_RELAX;
             test->relax = strdup(value + 1);
          }
+         else if (strncmp(opt, "analyse=", 8) == 0)
+            add_option(&(test->analyse_opts), opt + 8);
+         else if (strncmp(opt, "extra=", 6) == 0)
+            add_option(&(test->extra_files), opt + 6);
+         else if (strncmp(opt, "elab=", 5) == 0)
+            add_option(&(test->elab_opts), opt + 5);
+         else if (strncmp(opt, "run=", 4) == 0)
+            add_option(&(test->run_opts), opt + 4);
          else {
             fprintf(stderr, "Error on testlist line %d: invalid option %s in "
                  "test %s\n", lineno, opt, name);
@@ -239,7 +307,7 @@ static void signal_handler(int sig)
 {
 }
 
-static bool run_cmd(FILE *log, arglist_t **args)
+static bool run_cmd(FILE *log, const char *input, arglist_t **args)
 {
    fflush(stdout);
    fflush(stderr);
@@ -253,9 +321,9 @@ static bool run_cmd(FILE *log, arglist_t **args)
       dup2(fileno(log), STDOUT_FILENO);
       dup2(fileno(log), STDERR_FILENO);
 
-      int nullfd = open("/dev/null", O_WRONLY);
-      if (nullfd != -1)
-         dup2(nullfd, STDIN_FILENO);
+      int infd = open(input ?: "/dev/null", O_RDONLY);
+      if (infd != -1)
+         dup2(infd, STDIN_FILENO);
 
       char **argv = calloc((*args)->count + 1, sizeof(char *));
       arglist_t *it = *args;
@@ -320,6 +388,89 @@ static void chomp(char *str)
       str[len - 1] = '\0';
 }
 
+static bool match_gold(FILE *goldf, FILE *f, bool consecutive)
+{
+   // Each gold line must be a substring of a later line of output and
+   // if consecutive is set only the first gold line may skip output and
+   // nothing may follow the last
+   char gold_line[256];
+   char out_line[256];
+   bool first = true;
+   while (fgets(gold_line, sizeof(gold_line), goldf)) {
+      chomp(gold_line);
+
+      bool match = false;
+      while (!match && fgets(out_line, sizeof(out_line), f)) {
+         chomp(out_line);
+         match = strstr(out_line, gold_line) != NULL;
+         if (consecutive && !first)
+            break;
+      }
+
+      if (!match) {
+         set_attr(ANSI_FG_RED);
+         printf("failed (no match)\n");
+         set_attr(ANSI_FG_CYAN);
+         printf("%s\n", gold_line);
+         set_attr(ANSI_RESET);
+         return false;
+      }
+
+      first = false;
+   }
+
+   if (consecutive && fgets(out_line, sizeof(out_line), f)) {
+      set_attr(ANSI_FG_RED);
+      printf("failed (extra output)\n");
+      set_attr(ANSI_FG_CYAN);
+      printf("%s", out_line);
+      set_attr(ANSI_RESET);
+      return false;
+   }
+
+   return true;
+}
+
+static bool match_output(test_t *test, const char *ext, bool *missing)
+{
+   // Compare a file written by the simulation with its gold file where
+   // the header contains the date so only the lines from the first gold
+   // line to the end are compared exactly
+
+   char goldname[PATH_MAX];
+   snprintf(goldname, PATH_MAX, "%s/regress/gold/%s.%s",
+            test_dir, test->name, ext);
+
+   char outname[PATH_MAX];
+   snprintf(outname, PATH_MAX, "%s.%s", test->name, ext);
+
+   FILE *goldf = fopen(goldname, "r");
+   if (goldf == NULL) {
+      set_attr(ANSI_FG_RED);
+      printf("failed (missing gold file)\n");
+      set_attr(ANSI_RESET);
+      *missing = true;
+      return false;
+   }
+
+   FILE *f = fopen(outname, "r");
+   if (f == NULL) {
+      set_attr(ANSI_FG_RED);
+      printf("failed (missing %s file)\n", ext);
+      set_attr(ANSI_RESET);
+      fclose(goldf);
+      *missing = true;
+      return false;
+   }
+
+   const bool result = match_gold(goldf, f, true);
+
+   fclose(f);
+   fclose(goldf);
+
+   return result;
+}
+
 static bool run_test(test_t *test)
 {
    bool result = false;
@@ -355,29 +506,94 @@ static bool run_test(test_t *test)
    }
 
    arglist_t *args = NULL;
-   push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
-   push_std(test, &args);
 
-   push_arg(&args, "-a");
-   push_arg(&args, "%s/regress/%s.vhd", test_dir, test->name);
+   const int nbuilds = (test->flags & F_REPEAT) ? 2 : 1;
+   for (int build = 0; build < nbuilds; build++) {
+      if (build > 0) {
+         // Build the design again from scratch so code generation can
+         // reuse the native code cached by the first build
+         if (!run_cmd(outf, NULL, &args))
+            goto out_print;
+      }
 
-   if (test->flags & F_RELAX)
-      push_arg(&args, "--relax=%s", test->relax);
+      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
 
-   push_arg(&args, "-e");
-   push_arg(&args, "%s", test->name);
+      push_arg(&args, "-a");
+
+      for (option_t *o = test->analyse_opts; o != NULL; o = o->next)
+         push_arg(&args, "%s", o->text);
+
+      // Other files are analysed first in the same command
+      for (option_t *o = test->extra_files; o != NULL; o = o->next)
+         push_arg(&args, "%s/regress/%s.vhd", test_dir, o->text);
+
+      push_arg(&args, "%s/regress/%s.vhd", test_dir, test->name);
+
+      if (test->flags & F_RELAX)
+         push_arg(&args, "--relax=%s", test->relax);
+
+      if (test->flags & F_SPLIT) {
+         // Analyse in a separate process so elaboration reads the units
+         // back from the library on disk
+         if (!run_cmd(outf, NULL, &args))
+            goto out_print;
+
+         push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+         push_std(test, &args);
+      }
+
+      push_arg(&args, "-e");
+      push_arg(&args, "%s", test->name);
 
-   if (!(test->flags & F_OPT))
-      push_arg(&args, "--disable-opt");
+      if (!(test->flags & F_OPT))
+         push_arg(&args, "--disable-opt");
 
-   if (test->flags & F_COVER)
-      push_arg(&args, "--cover");
+      if (test->flags & F_COVER)
+         push_arg(&args, "--cover");
 
-   for (generic_t *g = test->generics; g != NULL; g = g->next)
-      push_arg(&args, "-g%s=%s", g->name, g->value);
+      if (test->flags & F_PRUNE)
+         push_arg(&args, "--prune");
+
+      if (test->flags & F_FUSE)
+         push_arg(&args, "--fuse");
+
+      for (generic_t *g = test->generics; g != NULL; g = g->next)
+         push_arg(&args, "-g%s=%s", g->name, g->value);
+
+      for (option_t *o = test->elab_opts; o != NULL; o = o->next)
+         push_arg(&args, "%s", o->text);
+   }
+
+   if (test->flags & F_MAKE) {
+      // Analyse again so the elaborated design is out of date and then
+      // rebuild it from the rules generated by --make
+      if (!run_cmd(outf, NULL, &args))
+         goto out_print;
+
+      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
+      push_arg(&args, "-a");
+      push_arg(&args, "%s/regress/%s.vhd", test_dir, test->name);
+
+      if (!run_cmd(outf, NULL, &args))
+         goto out_print;
+
+      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
+      push_arg(&args, "--make");
+      push_arg(&args, "--jobs=2");
+      push_arg(&args, "%s", test->name);
+
+      if (!run_cmd(outf, NULL, &args))
+         goto out_print;
+
+      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
+   }
 
    if (test->flags & F_FAIL) {
-      if (!run_cmd(outf, &args))
+      if (!run_cmd(outf, NULL, &args))
          goto out_print;
 
       push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
@@ -389,12 +605,81 @@ static bool run_test(test_t *test)
    if (test->flags & F_STOP)
       push_arg(&args, "--stop-time=%s", test->stop);
 
+   if (test->flags & F_CYCLE)
+      push_arg(&args, "--cycle-based");
+
+   if (test->flags & F_JOBS)
+      push_arg(&args, "--jobs=%s/regress/%s.jobs", test_dir, test->name);
+
+   if (test->flags & F_WAVE) {
+      push_arg(&args, "--format=vcd");
+      push_arg(&args, "--wave=%s.vcd", test->name);
+   }
+
+   if (test->flags & F_MERGE)
+      push_arg(&args, "--cover-db=%s-1.covdb", test->name);
+
+   if (test->flags & F_PGO)
+      push_arg(&args, "--pgo-collect=%s.prof", test->name);
+
+   if (test->flags & F_SAIF)
+      push_arg(&args, "--activity=%s.saif", test->name);
+
+   for (option_t *o = test->run_opts; o != NULL; o = o->next)
+      push_arg(&args, "%s", o->text);
+
+   if (test->flags & F_THREADS)
+      push_arg(&args, "--threads=4");
+
+   char input[PATH_MAX];
+   if (test->flags & F_SHELL) {
+      push_arg(&args, "--command");
+      snprintf(input, PATH_MAX, "%s/regress/%s.tcl", test_dir, test->name);
+   }
+
    if (test->flags & F_VHPI)
       push_arg(&args, "--load=%s/../lib/%s.so%s", bin_dir, test->name, EXEEXT);
 
    push_arg(&args, "%s", test->name);
 
-   result = run_cmd(outf, &args);
+   result = run_cmd(outf, (test->flags & F_SHELL) ? input : NULL, &args);
+
+   if (result && (test->flags & F_MERGE)) {
+      // Run again without the stop time and merge the coverage with
+      // that of the first run
+      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
+      push_arg(&args, "-r");
+      push_arg(&args, "--cover-db=%s-2.covdb", test->name);
+      push_arg(&args, "%s", test->name);
+
+      if ((result = run_cmd(outf, NULL, &args))) {
+         push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+         push_std(test, &args);
+         push_arg(&args, "--cover-merge");
+         push_arg(&args, "%s-1.covdb", test->name);
+         push_arg(&args, "%s-2.covdb", test->name);
+
+         result = run_cmd(outf, NULL, &args);
+      }
+   }
+
+   if (result && (test->flags & F_PGO)) {
+      // Elaborate again using the profile from the first run
+      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
+      push_arg(&args, "-e");
+      push_arg(&args, "%s", test->name);
+
+      if (!(test->flags & F_OPT))
+         push_arg(&args, "--disable-opt");
+
+      push_arg(&args, "--pgo-use=%s.prof", test->name);
+      push_arg(&args, "-r");
+      push_arg(&args, "%s", test->name);
+
+      result = run_cmd(outf, NULL, &args);
+   }
 
    if (test->flags & F_FAIL)
       result = !result;
@@ -416,29 +701,23 @@ static bool run_test(test_t *test)
       outf = freopen("out", "r", outf);
       assert(outf != NULL);
 
-      char gold_line[256];
-      char out_line[256];
-      while (fgets(gold_line, sizeof(gold_line), goldf)) {
-         chomp(gold_line);
+      result = match_gold(goldf, outf, false);
 
-         bool match = false;
-         while (!match && fgets(out_line, sizeof(out_line), outf)) {
-            chomp(out_line);
-            match = strstr(out_line, gold_line) != NULL;
-         }
+      fclose(goldf);
+   }
 
-         if (!match) {
-            set_attr(ANSI_FG_RED);
-            printf("failed (no match)\n");
-            set_attr(ANSI_FG_CYAN);
-            printf("%s\n", gold_line);
-            set_attr(ANSI_RESET);
-            result = false;
-            break;
-         }
-      }
+   if (result && (test->flags & F_WAVE)) {
+      bool missing = false;
+      result = match_output(test, "vcd", &missing);
+      if (missing)
+         goto out_close;
+   }
 
-      fclose(goldf);
+   if (result && (test->flags & F_SAIF)) {
+      bool missing = false;
+      result = match_output(test, "saif", &missing);
+      if (missing)
+         goto out_close;
    }
 
  out_print:
@@ -501,6 +780,17 @@ int main(int argc, char **argv)
       return EXIT_FAILURE;
    }
 
+   // Keep native code cached by the tests out of the user's home
+   if (mkdir("cache", 0777) != 0 && errno != EEXIST) {
+      fprintf(stderr, "Failed to make logs/cache directory: %s\n",
+              strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   char cache_dir[PATH_MAX];
+   realpath("cache", cache_dir);
+   setenv("NVC_CACHE_DIR", cache_dir, 1);
+
    bool pass = true;
    for (test_t *it = test_list; it != NULL; it = it->next) {
       if (!run_test(it))
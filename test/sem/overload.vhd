@@ -0,0 +1,42 @@
+entity overload is
+end entity;
+
+architecture test of overload is
+    type t1 is range 0 to 10;
+    type t2 is range 0 to 10;
+
+    function f (x : integer) return t1 is
+    begin
+        return t1(x);
+    end function;
+
+    signal s1 : t1;
+    signal s2 : t2;
+begin
+
+    process is
+    begin
+        s1 <= f(1);                     -- OK
+        s2 <= f(1);                     -- Error
+        wait;
+    end process;
+
+    process is
+        function f (x : integer) return t2 is
+        begin
+            return t2(x);
+        end function;
+    begin
+        s1 <= f(1);                     -- OK
+        s2 <= f(1);                     -- OK
+        wait;
+    end process;
+
+    process is
+    begin
+        s2 <= f(1);                     -- Error
+        s1 <= f(1);                     -- OK
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,44 @@
+entity shadow is
+end entity;
+
+architecture test of shadow is
+    type t1 is range 0 to 10;
+    type t2 is range 0 to 10;
+
+    signal x : t1;
+    signal y : t1;
+begin
+
+    process is
+        variable x : t2;
+        variable v : t2;
+    begin
+        v := x;                         -- OK
+        y <= x;                         -- Error
+        wait;
+    end process;
+
+    process is
+        variable v : t2;
+    begin
+        y <= x;                         -- OK
+        v := x;                         -- Error
+        wait;
+    end process;
+
+    process is
+        function f return t2 is
+            constant x : t2 := 1;
+        begin
+            return x;                   -- OK
+        end function;
+
+        variable v : t2;
+    begin
+        v := f;                         -- OK
+        v := x;                         -- Error
+        y <= x;                         -- OK
+        wait;
+    end process;
+
+end architecture;
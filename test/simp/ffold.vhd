@@ -87,6 +87,50 @@ architecture a of ffold is
     signal s6 : integer := case1(7);
     signal s7 : integer := adddef;
     signal s8 : boolean := chain2("foo", "hello");
+
+    function fact(n : natural) return natural is
+    begin
+        if n <= 1 then
+            return 1;
+        else
+            return n * fact(n - 1);
+        end if;
+    end function;
+
+    function popcount(x : natural) return natural is
+        variable bits : bit_vector(7 downto 0) := (others => '0');
+        variable n    : natural := x;
+        variable r    : natural := 0;
+    begin
+        for i in 0 to 7 loop
+            if n mod 2 = 1 then
+                bits(i) := '1';
+            end if;
+            n := n / 2;
+        end loop;
+        for i in bits'range loop
+            if bits(i) = '1' then
+                r := r + 1;
+            end if;
+        end loop;
+        return r;
+    end function;
+
+    signal s9  : integer := fact(6);
+    signal s10 : integer := popcount(2#10110110#);
+
+    type table_t is array (0 to 7) of natural;
+
+    function squares return table_t is
+        variable t : table_t;
+    begin
+        for i in t'range loop
+            t(i) := i * i;
+        end loop;
+        return t;
+    end function;
+
+    signal s11 : table_t := squares;
 begin
 
 end architecture;
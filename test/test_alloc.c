@@ -0,0 +1,106 @@
+#include "rt/alloc.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NTHREADS 4
+#define NITEMS   1000
+#define NROUNDS  200
+
+START_TEST(test_basic)
+{
+   rt_alloc_stack_t s = rt_alloc_stack_new(sizeof(int), "test");
+
+   int *items[NITEMS];
+   for (int i = 0; i < NITEMS; i++) {
+      items[i] = rt_alloc(s);
+      *items[i] = i;
+   }
+
+   for (int i = 0; i < NITEMS; i++) {
+      fail_unless(*items[i] == i);
+      for (int j = i + 1; j < NITEMS; j++)
+         fail_if(items[i] == items[j]);
+   }
+
+   rt_alloc_stats_t stats;
+   rt_alloc_stack_stats(s, &stats);
+   fail_unless(stats.live == NITEMS);
+   fail_unless(stats.peak >= stats.live);
+
+   for (int i = 0; i < NITEMS; i++)
+      rt_free(s, items[i]);
+
+   rt_alloc_stack_stats(s, &stats);
+   fail_unless(stats.live == 0);
+   fail_unless(stats.slow_hits > 0);
+
+   rt_alloc_stack_destroy(s);
+}
+END_TEST
+
+static void *stress_thread(void *arg)
+{
+   rt_alloc_stack_t s = arg;
+   uint64_t *items[NITEMS];
+   const uint64_t tag = (uintptr_t)pthread_self();
+
+   for (int round = 0; round < NROUNDS; round++) {
+      const int n = 1 + (random() % NITEMS);
+      for (int i = 0; i < n; i++) {
+         items[i] = rt_alloc(s);
+         *items[i] = tag + i;
+      }
+
+      for (int i = 0; i < n; i++) {
+         if (*items[i] != tag + i)
+            return (void *)1;
+         rt_free(s, items[i]);
+      }
+   }
+
+   return NULL;
+}
+
+START_TEST(test_threads)
+{
+   rt_alloc_stack_t s = rt_alloc_stack_new(sizeof(uint64_t), "test");
+
+   pthread_t threads[NTHREADS];
+   for (int i = 0; i < NTHREADS; i++)
+      pthread_create(&(threads[i]), NULL, stress_thread, s);
+
+   for (int i = 0; i < NTHREADS; i++) {
+      void *result;
+      pthread_join(threads[i], &result);
+      fail_unless(result == NULL);
+   }
+
+   rt_alloc_stats_t stats;
+   rt_alloc_stack_stats(s, &stats);
+   fail_unless(stats.live == 0);
+
+   rt_alloc_stack_destroy(s);
+}
+END_TEST
+
+int main(void)
+{
+   Suite *s = suite_create("alloc");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_test(tc_core, test_basic);
+   tcase_add_test(tc_core, test_threads);
+   suite_add_tcase(s, tc_core);
+
+   SRunner *sr = srunner_create(s);
+   srunner_run_all(sr, CK_NORMAL);
+
+   int nfail = srunner_ntests_failed(sr);
+
+   srunner_free(sr);
+
+   return nfail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -429,6 +429,217 @@ START_TEST(test_jcore1)
 }
 END_TEST
 
+START_TEST(test_share1)
+{
+   input_from_file(TESTDIR "/elab/share1.vhd");
+
+   const error_t expect[] = {
+      { -1, NULL }
+   };
+   expect_errors(expect);
+
+   tree_t e = run_elab();
+   fail_if(e == NULL);
+
+   int nscale = 0, npeek = 0;
+
+   const int ndecls = tree_decls(e);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t t = tree_decl(e, i);
+      if (tree_kind(t) != T_FUNC_BODY)
+         continue;
+      else if (strstr(istr(tree_ident(t)), "scale") != NULL)
+         nscale++;
+      else if (strstr(istr(tree_ident(t)), "peek") != NULL)
+         npeek++;
+   }
+
+   fail_unless(nscale == 2);   // One for each distinct generic value
+   fail_unless(npeek == 3);    // Reads a port so cannot be shared
+}
+END_TEST
+
+START_TEST(test_cache1)
+{
+   input_from_file(TESTDIR "/elab/cache1.vhd");
+
+   tree_t top = run_elab();
+   fail_if(top == NULL);
+
+   tree_t ent = lib_get(lib_work(), ident_new("WORK.CACHE1"));
+   fail_if(ent == NULL);
+
+   // Nothing has changed since elaboration
+   fail_unless(elab_cached(ent) == top);
+
+   // Options that change the design invalidate the cached copy
+   opt_set_int("cover", 1);
+   fail_unless(elab_cached(ent) == NULL);
+   opt_set_int("cover", 0);
+   fail_unless(elab_cached(ent) == top);
+
+   elab_set_generic("G", "2");
+   fail_unless(elab_cached(ent) == NULL);
+}
+END_TEST
+
+static tree_t find_decl(tree_t top, const char *name)
+{
+   ident_t id = ident_new(name);
+   const int ndecls = tree_decls(top);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top, i);
+      if (tree_ident(d) == id)
+         return d;
+   }
+
+   return NULL;
+}
+
+static tree_t find_driver(tree_t top, tree_t decl)
+{
+   const int nstmts = tree_stmts(top);
+   for (int i = 0; i < nstmts; i++) {
+      tree_t p = tree_stmt(top, i);
+      tree_t s = tree_stmt(p, 0);
+      if (tree_kind(s) != T_SIGNAL_ASSIGN)
+         continue;
+
+      tree_t target = tree_target(s);
+      if (tree_kind(target) == T_REF && tree_ref(target) == decl)
+         return p;
+   }
+
+   return NULL;
+}
+
+START_TEST(test_prune1)
+{
+   input_from_file(TESTDIR "/elab/prune1.vhd");
+
+   opt_set_int("prune", 1);
+
+   tree_t top = run_elab();
+   fail_if(top == NULL);
+
+   // Processes driving only unread signals are removed along with the
+   // signals themselves and the constant assignment to tied
+
+   fail_unless(tree_stmts(top) == 7);
+
+   fail_if(find_decl(top, ":prune1:x") == NULL);
+   fail_if(find_decl(top, ":prune1:a") == NULL);
+   fail_if(find_decl(top, ":prune1:b") == NULL);
+   fail_if(find_decl(top, ":prune1:c") == NULL);
+   fail_if(find_decl(top, ":prune1:y") == NULL);
+   fail_unless(find_decl(top, ":prune1:dead") == NULL);
+   fail_unless(find_decl(top, ":prune1:tied") == NULL);
+   fail_unless(find_decl(top, ":prune1:u:unused") == NULL);
+
+   // The constant is not the initial value so must still be driven
+
+   tree_t one = find_decl(top, ":prune1:one");
+   fail_if(one == NULL);
+   fail_if(find_driver(top, one) == NULL);
+
+   // The only trigger of this process is constant but it must keep
+   // it so it does not wait forever
+
+   tree_t zero = find_decl(top, ":prune1:zero");
+   fail_if(zero == NULL);
+
+   tree_t py = find_driver(top, find_decl(top, ":prune1:y"));
+   fail_if(py == NULL);
+   tree_t w = tree_stmt(py, tree_stmts(py) - 1);
+   fail_unless(tree_kind(w) == T_WAIT);
+   fail_unless(tree_triggers(w) == 1);
+   fail_unless(tree_kind(tree_trigger(w, 0)) == T_REF);
+   fail_unless(tree_ref(tree_trigger(w, 0)) == zero);
+}
+END_TEST
+
+static int count_assigns(tree_t proc, tree_t decl)
+{
+   int count = 0;
+   const int nstmts = tree_stmts(proc);
+   for (int i = 0; i < nstmts; i++) {
+      tree_t s = tree_stmt(proc, i);
+      if (tree_kind(s) != T_SIGNAL_ASSIGN)
+         continue;
+
+      tree_t target = tree_target(s);
+      if (tree_kind(target) == T_REF && tree_ref(target) == decl)
+         count++;
+   }
+
+   return count;
+}
+
+static tree_t find_assign(tree_t top, const char *name)
+{
+   tree_t decl = find_decl(top, name);
+   fail_if(decl == NULL);
+
+   tree_t proc = NULL;
+   const int nstmts = tree_stmts(top);
+   for (int i = 0; i < nstmts; i++) {
+      tree_t p = tree_stmt(top, i);
+      if (count_assigns(p, decl) > 0) {
+         fail_unless(proc == NULL);
+         proc = p;
+      }
+   }
+
+   fail_if(proc == NULL);
+   return proc;
+}
+
+START_TEST(test_fuse1)
+{
+   input_from_file(TESTDIR "/elab/fuse1.vhd");
+
+   opt_set_int("fuse", 1);
+
+   tree_t top = run_elab();
+   fail_if(top == NULL);
+
+   tree_t px = find_assign(top, ":fuse1:x");
+   tree_t py = find_assign(top, ":fuse1:y");
+   tree_t pz = find_assign(top, ":fuse1:z");
+   tree_t pw = find_assign(top, ":fuse1:w");
+   tree_t pr = find_assign(top, ":fuse1:r");
+
+   // Processes with the same sensitivity are merged
+   fail_unless(px == py);
+   fail_unless(tree_attr_int(px, comb_i, 0));
+
+   // Delayed assignments and reject limits are never merged
+   fail_unless(tree_stmts(pz) == 2);
+   fail_unless(tree_stmts(pw) == 2);
+
+   // Different sensitivity
+   fail_unless(tree_stmts(pr) == 2);
+
+   // Each driver of d must stay in a different process and the first
+   // joins x and y
+   tree_t d = find_decl(top, ":fuse1:d");
+   fail_if(d == NULL);
+
+   const int nstmts = tree_stmts(top);
+   int ndrivers = 0;
+   for (int i = 0; i < nstmts; i++) {
+      const int n = count_assigns(tree_stmt(top, i), d);
+      fail_if(n > 1);
+      ndrivers += n;
+   }
+   fail_unless(ndrivers == 2);
+   fail_unless(count_assigns(px, d) == 1);
+
+   fail_unless(tree_stmts(px) == 4);
+   fail_unless(nstmts == 5);
+}
+END_TEST
+
 int main(void)
 {
    Suite *s = suite_create("elab");
@@ -461,6 +672,10 @@ int main(void)
    tcase_add_test(tc, test_libbind3);
    tcase_add_test(tc, test_issue251);
    tcase_add_test(tc, test_jcore1);
+   tcase_add_test(tc, test_share1);
+   tcase_add_test(tc, test_cache1);
+   tcase_add_test(tc, test_prune1);
+   tcase_add_test(tc, test_fuse1);
    suite_add_tcase(s, tc);
 
    return nvc_run_test(s);
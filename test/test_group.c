@@ -91,17 +91,23 @@ START_TEST(test_group_one)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
 
-   fail_unless(group_add(&ctx, 0, 1) == 0);
-   fail_unless(group_add(&ctx, 2, 1) == 1);
-   fail_unless(group_add(&ctx, 3, 1) == 2);
+   group_add(&ctx, 0, 1);
+   group_add(&ctx, 2, 1);
+   group_add(&ctx, 3, 1);
 
-   fail_unless(group_add(&ctx, 0, 1) == 0);
+   group_add(&ctx, 0, 1);
 
-   fail_unless(group_add(&ctx, 0, 5) == GROUPID_INVALID);
+   group_add(&ctx, 0, 5);
+   group_build(&ctx);
 
    fail_unless(ctx.next_gid == 5);
 
    fail_unless(group_sanity_check(&ctx, 4));
+
+   const group_expect_t expect[] = {
+      { 0, 0 }, { 1, 1 }, { 2, 2 }, { 3, 3 }, { 4, 4 }
+   };
+   group_expect(&ctx, expect, ARRAY_LEN(expect));
 }
 END_TEST
 
@@ -110,10 +116,16 @@ START_TEST(test_group_two)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
 
-   fail_unless(group_add(&ctx, 0, 4) == 0);
-   fail_if(group_add(&ctx, 1, 2) == GROUPID_INVALID);
+   group_add(&ctx, 0, 4);
+   group_add(&ctx, 1, 2);
+   group_build(&ctx);
 
    fail_unless(group_sanity_check(&ctx, 3));
+
+   const group_expect_t expect[] = {
+      { 0, 0 }, { 1, 2 }, { 3, 3 }
+   };
+   group_expect(&ctx, expect, ARRAY_LEN(expect));
 }
 END_TEST
 
@@ -124,6 +136,7 @@ START_TEST(test_group_three)
 
    group_add(&ctx, 0, 5);
    group_add(&ctx, 1, 4);
+   group_build(&ctx);
 
    fail_unless(group_sanity_check(&ctx, 4));
 }
@@ -136,6 +149,7 @@ START_TEST(test_group_four)
 
    group_add(&ctx, 0, 5);
    group_add(&ctx, 0, 4);
+   group_build(&ctx);
 
    fail_unless(group_sanity_check(&ctx, 4));
 }
@@ -148,6 +162,7 @@ START_TEST(test_group_five)
 
    group_add(&ctx, 2, 4);
    group_add(&ctx, 0, 4);
+   group_build(&ctx);
 
    fail_unless(group_sanity_check(&ctx, 5));
 }
@@ -160,6 +175,7 @@ START_TEST(test_group_six)
 
    group_add(&ctx, 0, 8);
    group_add(&ctx, 1, 8);
+   group_build(&ctx);
 
    fail_unless(group_sanity_check(&ctx, 8));
 }
@@ -174,6 +190,7 @@ START_TEST(test_issue72)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -194,6 +211,7 @@ START_TEST(test_issue73)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -215,6 +233,7 @@ START_TEST(test_slice1)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -237,6 +256,7 @@ START_TEST(test_arrayref1)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -264,6 +284,7 @@ START_TEST(test_issue95)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -286,6 +307,7 @@ START_TEST(test_arrayref2)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -309,6 +331,7 @@ START_TEST(test_recref1)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -331,6 +354,7 @@ START_TEST(test_array3)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -353,6 +377,7 @@ START_TEST(test_issue250)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -376,6 +401,7 @@ START_TEST(test_recref2)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -398,6 +424,7 @@ START_TEST(test_arrayref3)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -421,6 +448,7 @@ START_TEST(test_jcore2)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -444,6 +472,7 @@ START_TEST(test_jcore4)
    group_nets_ctx_t ctx;
    group_test_init(&ctx, NULL);
    tree_visit(top, group_nets_visit_fn, &ctx);
+   group_build(&ctx);
 
    const int nnets = tree_attr_int(top, ident_new("nnets"), 0);
    fail_unless(group_sanity_check(&ctx, nnets - 1));
@@ -456,6 +485,49 @@ START_TEST(test_jcore4)
 }
 END_TEST
 
+START_TEST(test_readers1)
+{
+   input_from_file(TESTDIR "/group/readers1.vhd");
+
+   tree_t top = run_elab();
+   fail_if(top == NULL);
+
+   group_nets_ctx_t ctx;
+   group_test_init(&ctx, NULL);
+   tree_visit(top, group_nets_visit_fn, &ctx);
+
+   fail_unless(ctx.observed[0]);    // a
+   fail_if(ctx.observed[1]);        // b
+   fail_unless(ctx.observed[2]);    // c
+   fail_if(ctx.observed[3]);        // d
+}
+END_TEST
+
+START_TEST(test_netdb_search)
+{
+   // Sorted group boundaries as they are mapped from the net database
+   static const netid_t first[] = { 0, 3, 4, 10, 11, 16, 17 };
+   static const uint32_t length[] = { 3, 1, 6, 1, 5, 1, 8 };
+
+   for (unsigned n = 1; n <= ARRAY_LEN(first); n++) {
+      const netdb_t db = {
+         .first   = first,
+         .length  = length,
+         .dense   = NULL,
+         .nnets   = first[n - 1] + length[n - 1],
+         .ngroups = n
+      };
+
+      for (netid_t nid = 0; nid < db.nnets; nid++) {
+         const groupid_t gid = netdb_lookup(&db, nid);
+         fail_unless(gid < n);
+         fail_unless(nid >= first[gid] && nid < first[gid] + length[gid],
+                     "net %d found in group %d with %u groups", nid, gid, n);
+      }
+   }
+}
+END_TEST
+
 int main(void)
 {
    Suite *s = suite_create("group");
@@ -480,6 +552,8 @@ int main(void)
    tcase_add_test(tc_core, test_arrayref3);
    tcase_add_test(tc_core, test_jcore2);
    tcase_add_test(tc_core, test_jcore4);
+   tcase_add_test(tc_core, test_readers1);
+   tcase_add_test(tc_core, test_netdb_search);
    suite_add_tcase(s, tc_core);
 
    return nvc_run_test(s);
@@ -67,6 +67,168 @@ START_TEST(test_replace)
 }
 END_TEST;
 
+START_TEST(test_ghash_basic)
+{
+   ghash_t *h = ghash_new(GHASH_PTR, 8);
+
+   ghash_put(h, VOIDP(1516), VOIDP(6));
+   ghash_put(h, VOIDP(151670), VOIDP(4));
+   ghash_put(h, VOIDP(61), VOIDP(1));
+   ghash_put(h, VOIDP(1516), VOIDP(7));
+
+   fail_unless(ghash_members(h) == 3);
+   fail_unless(ghash_get(h, VOIDP(1516)) == VOIDP(7));
+   fail_unless(ghash_get(h, VOIDP(151670)) == VOIDP(4));
+   fail_unless(ghash_get(h, VOIDP(61)) == VOIDP(1));
+   fail_unless(ghash_get(h, VOIDP(62)) == NULL);
+
+   fail_unless(ghash_delete(h, VOIDP(151670)));
+   fail_if(ghash_delete(h, VOIDP(151670)));
+   fail_unless(ghash_get(h, VOIDP(151670)) == NULL);
+   fail_unless(ghash_members(h) == 2);
+
+   ghash_free(h);
+}
+END_TEST;
+
+START_TEST(test_ghash_order)
+{
+   ghash_t *h = ghash_new(GHASH_INT, 0);
+
+   for (int i = 0; i < 1000; i++)
+      ghash_put_int(h, i * 7919 - 500, VOIDP(i + 1));
+
+   for (int i = 0; i < 1000; i += 3)
+      fail_unless(ghash_delete_int(h, i * 7919 - 500));
+
+   // Reinserting a deleted key moves it to the end
+   ghash_put_int(h, -500, VOIDP(1));
+
+   hash_iter_t it = HASH_BEGIN;
+   int64_t key;
+   void *value;
+   int prev = 0, n = 0;
+   while (ghash_iter_int(h, &it, &key, &value)) {
+      const int i = (uintptr_t)value - 1;
+      fail_unless(key == i * 7919 - 500);
+      if (n++ < 666) {
+         fail_unless(i % 3 != 0);
+         fail_unless(i > prev || n == 1);
+         prev = i;
+      }
+      else
+         fail_unless(i == 0);
+   }
+
+   fail_unless(n == 667);
+   fail_unless(ghash_members(h) == 667);
+
+   ghash_free(h);
+}
+END_TEST;
+
+START_TEST(test_ghash_str)
+{
+   ghash_t *h = ghash_new(GHASH_STR, 16);
+
+   char buf[32];
+   for (int i = 0; i < 500; i++) {
+      snprintf(buf, sizeof(buf), "key%d", i);
+      ghash_put(h, buf, VOIDP(i + 1));
+   }
+
+   for (int i = 0; i < 500; i++) {
+      snprintf(buf, sizeof(buf), "key%d", i);
+      fail_unless(ghash_get(h, buf) == VOIDP(i + 1));
+   }
+
+   fail_unless(ghash_get(h, "key500") == NULL);
+   fail_unless(ghash_delete(h, "key42"));
+   fail_unless(ghash_get(h, "key42") == NULL);
+
+   ghash_free(h);
+}
+END_TEST;
+
+START_TEST(test_ghash_churn)
+{
+   // Interleave insertions and deletions against a reference array
+   static const int N = 4096;
+   void *shadow[N];
+   memset(shadow, '\0', sizeof(shadow));
+
+   ghash_t *h = ghash_new(GHASH_INT, 0);
+
+   for (int i = 0; i < 100000; i++) {
+      const int key = random() % N;
+      if (random() % 3 == 0) {
+         fail_unless(ghash_delete_int(h, key) == (shadow[key] != NULL));
+         shadow[key] = NULL;
+      }
+      else {
+         shadow[key] = VOIDP(i + 1);
+         ghash_put_int(h, key, shadow[key]);
+      }
+   }
+
+   unsigned count = 0;
+   for (int i = 0; i < N; i++) {
+      fail_unless(ghash_get_int(h, i) == shadow[i]);
+      count += (shadow[i] != NULL);
+   }
+
+   fail_unless(ghash_members(h) == count);
+
+   ghash_free(h);
+}
+END_TEST;
+
+static double elapsed_ms(const struct timespec *start)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - start->tv_sec) * 1e3
+      + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+START_TEST(test_perf)
+{
+   static const int N = 1 << 16;
+
+   void **keys = xmalloc(N * sizeof(void *));
+   for (int i = 0; i < N; i++)
+      keys[i] = VOIDP(((random() << 4) | 8));
+
+   struct timespec start;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   hash_t *h = hash_new(16, true);
+   for (int i = 0; i < N; i++)
+      hash_put(h, keys[i], VOIDP(i));
+   for (int r = 0; r < 64; r++) {
+      for (int i = 0; i < N; i++)
+         fail_unless(hash_get(h, keys[i]) != NULL || i == 0);
+   }
+   hash_free(h);
+   printf("hash_t   %d puts, %d gets: %.1f ms\n", N, 64 * N,
+          elapsed_ms(&start));
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   ghash_t *g = ghash_new(GHASH_PTR, 16);
+   for (int i = 0; i < N; i++)
+      ghash_put(g, keys[i], VOIDP(i));
+   for (int r = 0; r < 64; r++) {
+      for (int i = 0; i < N; i++)
+         fail_unless(ghash_get(g, keys[i]) != NULL || i == 0);
+   }
+   ghash_free(g);
+   printf("ghash_t  %d puts, %d gets: %.1f ms\n", N, 64 * N,
+          elapsed_ms(&start));
+
+   free(keys);
+}
+END_TEST;
+
 int main(void)
 {
    srandom((unsigned)time(NULL));
@@ -77,6 +239,11 @@ int main(void)
    tcase_add_test(tc_core, test_basic);
    tcase_add_test(tc_core, test_rand);
    tcase_add_test(tc_core, test_replace);
+   tcase_add_test(tc_core, test_ghash_basic);
+   tcase_add_test(tc_core, test_ghash_order);
+   tcase_add_test(tc_core, test_ghash_str);
+   tcase_add_test(tc_core, test_ghash_churn);
+   tcase_add_test(tc_core, test_perf);
    suite_add_tcase(s, tc_core);
 
    SRunner *sr = srunner_create(s);
@@ -1,4 +1,5 @@
 #include "rt/heap.h"
+#include "rt/wheel.h"
 
 #include <check.h>
 #include <stdlib.h>
@@ -82,6 +83,218 @@ START_TEST(test_rand)
 }
 END_TEST
 
+START_TEST(test_wheel_basic)
+{
+   wheel_t w = wheel_new();
+
+   wheel_insert(w, 5, (void*)5);
+   wheel_insert(w, 2, (void*)2);
+   wheel_insert(w, 62, (void*)62);
+   wheel_insert(w, 1000000, (void*)1000000);
+   wheel_insert(w, UINT64_MAX, (void*)UINT64_MAX);
+
+   fail_unless(wheel_size(w) == 5);
+
+   fail_unless(wheel_min(w) == (void*)2);
+
+   fail_unless(wheel_extract_min(w) == (void*)2);
+   fail_unless(wheel_extract_min(w) == (void*)5);
+   fail_unless(wheel_extract_min(w) == (void*)62);
+   fail_unless(wheel_extract_min(w) == (void*)1000000);
+   fail_unless(wheel_extract_min(w) == (void*)UINT64_MAX);
+
+   fail_unless(wheel_size(w) == 0);
+
+   wheel_free(w);
+}
+END_TEST
+
+START_TEST(test_wheel_walk)
+{
+   wheel_t w = wheel_new();
+
+   wheel_insert(w, 5, (void*)5);
+   wheel_insert(w, 2, (void*)2);
+   wheel_insert(w, 62000, (void*)62000);
+
+   uint64_t last = 0;
+   wheel_walk(w, walk_fn, &last);
+
+   fail_unless(last == 62000);
+
+   wheel_free(w);
+}
+END_TEST
+
+START_TEST(test_wheel_rand)
+{
+   // Compare against the binary heap with keys scheduled relative to
+   // the last extracted key as in the simulation kernel
+
+   wheel_t w = wheel_new();
+
+   uintptr_t now = 0;
+   for (int i = 0; i < 100000; i++) {
+      if ((random() % 3) < 2 || heap_size(h) == 0) {
+         uintptr_t delay;
+         switch (random() % 4) {
+         case 0: delay = random() % 256; break;
+         case 1: delay = random() % 100000; break;
+         case 2: delay = (uintptr_t)random() << 16; break;
+         default: delay = 1 + random() % 4; break;
+         }
+
+         const uintptr_t key = now + delay + 1;
+         heap_insert(h, key, (void*)key);
+         wheel_insert(w, key, (void*)key);
+      }
+      else {
+         fail_unless(wheel_min(w) == heap_min(h));
+         now = (uintptr_t)heap_extract_min(h);
+         fail_unless(wheel_extract_min(w) == (void*)now);
+      }
+
+      fail_unless(wheel_size(w) == heap_size(h));
+   }
+
+   while (heap_size(h) > 0)
+      fail_unless(wheel_extract_min(w) == heap_extract_min(h));
+
+   fail_unless(wheel_size(w) == 0);
+
+   wheel_free(w);
+}
+END_TEST
+
+START_TEST(test_delete)
+{
+   static const int N = 1000;
+   heap_slot_t slots[N];
+
+   for (int i = 0; i < N; i++) {
+      const uintptr_t key = (i * 7919) % N;
+      heap_insert_slot(h, key, (void*)key, &(slots[key]));
+   }
+
+   for (int i = 0; i < N; i += 3) {
+      fail_if(slots[i] == 0);
+      heap_delete(h, slots[i]);
+      fail_unless(slots[i] == 0);
+   }
+
+   fail_unless(heap_size(h) == N - (N + 2) / 3);
+
+   uintptr_t last = 0;
+   while (heap_size(h) > 0) {
+      const uintptr_t key = (uintptr_t)heap_extract_min(h);
+      fail_if(key % 3 == 0);
+      fail_if(key < last);
+      fail_unless(slots[key] == 0);
+      last = key;
+   }
+}
+END_TEST
+
+START_TEST(test_wheel_delete)
+{
+   static const int N = 1000;
+   heap_slot_t slots[N];
+
+   wheel_t w = wheel_new();
+
+   // Use a mixture of near and distant keys so that entries are deleted
+   // both from the wheel proper and from the overflow heap
+   for (int i = 0; i < N; i++) {
+      const uintptr_t key = (i * 7919) % N;
+      wheel_insert_slot(w, key << ((key % 5) * 12), (void*)key,
+                        &(slots[key]));
+   }
+
+   for (int i = 0; i < N; i += 3) {
+      fail_if(slots[i] == 0);
+      wheel_delete(w, slots[i]);
+      fail_unless(slots[i] == 0);
+   }
+
+   fail_unless(wheel_size(w) == N - (N + 2) / 3);
+
+   uint64_t last = 0;
+   while (wheel_size(w) > 0) {
+      const uintptr_t key = (uintptr_t)wheel_extract_min(w);
+      const uint64_t real = (uint64_t)key << ((key % 5) * 12);
+      fail_if(key % 3 == 0);
+      fail_if(real < last);
+      fail_unless(slots[key] == 0);
+      last = real;
+   }
+
+   wheel_free(w);
+}
+END_TEST
+
+static double elapsed_ms(const struct timespec *start)
+{
+   struct timespec end;
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   return (end.tv_sec - start->tv_sec) * 1000.0
+      + (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+START_TEST(test_throughput)
+{
+   // Simulate a set of clocks with fixed periods each rescheduling
+   // themselves when popped: the bottom bits of the key identify the
+   // clock as the kind bits do in the kernel
+
+   static const int nclocks = 1024;
+   static const int nevents = 2000000;
+
+   uintptr_t periods[nclocks];
+   for (int i = 0; i < nclocks; i++)
+      periods[i] = (1000 + (random() % 64) * 250) << 10;
+
+   struct timespec start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for (int i = 0; i < nclocks; i++)
+      heap_insert(h, periods[i] | i, (void*)(periods[i] | i));
+
+   uintptr_t sum_heap = 0;
+   for (int i = 0; i < nevents; i++) {
+      const uintptr_t key = (uintptr_t)heap_extract_min(h);
+      const uintptr_t next = key + periods[key % nclocks];
+      heap_insert(h, next, (void*)next);
+      sum_heap += key;
+   }
+
+   const double heap_ms = elapsed_ms(&start);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   wheel_t w = wheel_new();
+
+   for (int i = 0; i < nclocks; i++)
+      wheel_insert(w, periods[i] | i, (void*)(periods[i] | i));
+
+   uintptr_t sum_wheel = 0;
+   for (int i = 0; i < nevents; i++) {
+      const uintptr_t key = (uintptr_t)wheel_extract_min(w);
+      const uintptr_t next = key + periods[key % nclocks];
+      wheel_insert(w, next, (void*)next);
+      sum_wheel += key;
+   }
+
+   const double wheel_ms = elapsed_ms(&start);
+
+   wheel_free(w);
+
+   fail_unless(sum_heap == sum_wheel);
+
+   printf("heap: %.1fms wheel: %.1fms for %d events\n",
+          heap_ms, wheel_ms, nevents);
+}
+END_TEST
+
 int main(void)
 {
    srandom((unsigned)time(NULL));
@@ -93,8 +306,19 @@ int main(void)
    tcase_add_test(tc_core, test_basic);
    tcase_add_test(tc_core, test_rand);
    tcase_add_test(tc_core, test_walk);
+   tcase_add_test(tc_core, test_delete);
+   tcase_add_test(tc_core, test_wheel_basic);
+   tcase_add_test(tc_core, test_wheel_walk);
+   tcase_add_test(tc_core, test_wheel_rand);
+   tcase_add_test(tc_core, test_wheel_delete);
    suite_add_tcase(s, tc_core);
 
+   TCase *tc_perf = tcase_create("Perf");
+   tcase_add_checked_fixture(tc_perf, setup, teardown);
+   tcase_set_timeout(tc_perf, 60);
+   tcase_add_test(tc_perf, test_throughput);
+   suite_add_tcase(s, tc_perf);
+
    SRunner *sr = srunner_create(s);
    srunner_run_all(sr, CK_NORMAL);
 
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 
 START_TEST(test_ident_new)
 {
@@ -240,6 +241,42 @@ START_TEST(test_interned)
 }
 END_TEST
 
+#define NTHREADS 4
+#define NIDENTS  10000
+
+static void *intern_thread(void *arg)
+{
+   ident_t *result = arg;
+   for (int i = 0; i < NIDENTS; i++) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "top.u%d.s%d", i % 97, i);
+      result[i] = ident_new(buf);
+   }
+
+   return NULL;
+}
+
+START_TEST(test_threads)
+{
+   static ident_t result[NTHREADS][NIDENTS];
+   pthread_t threads[NTHREADS];
+
+   for (int i = 0; i < NTHREADS; i++)
+      pthread_create(&(threads[i]), NULL, intern_thread, result[i]);
+
+   for (int i = 0; i < NTHREADS; i++)
+      pthread_join(threads[i], NULL);
+
+   for (int i = 0; i < NIDENTS; i++) {
+      for (int j = 1; j < NTHREADS; j++)
+         fail_unless(result[j][i] == result[0][i]);
+   }
+
+   fail_unless(icmp(result[0][123], "top.u26.s123"));
+   fail_unless(ident_runtil(result[0][5], '.') == ident_new("top.u5"));
+}
+END_TEST
+
 int main(void)
 {
    srandom((unsigned)time(NULL));
@@ -262,6 +299,7 @@ int main(void)
    tcase_add_test(tc_core, test_rfrom);
    tcase_add_test(tc_core, test_from);
    tcase_add_test(tc_core, test_interned);
+   tcase_add_test(tc_core, test_threads);
    suite_add_tcase(s, tc_core);
 
    SRunner *sr = srunner_create(s);
@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <inttypes.h>
 
 static lib_t work;
 
@@ -259,6 +261,316 @@ START_TEST(test_lib_save)
 }
 END_TEST
 
+static void index_count_fn(ident_t ident, int kind, void *context)
+{
+   if (strncmp(istr(ident), "index", 5) == 0) {
+      fail_unless(kind == T_ENTITY);
+      (*(int *)context)++;
+   }
+}
+
+START_TEST(test_lib_index)
+{
+   // The index records the modification time of every unit so it can
+   // be found without loading the unit
+   const int nunits = 50;
+   for (int i = 0; i < nunits; i++) {
+      char name[16];
+      checked_sprintf(name, sizeof(name), "index%d", i);
+
+      tree_t ent = tree_new(T_ENTITY);
+      tree_set_ident(ent, ident_new(name));
+      lib_put(work, ent);
+   }
+
+   lib_save(work);
+   lib_free(work);
+
+   lib_add_search_path("/tmp");
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   int count = 0;
+   lib_walk_index(work, index_count_fn, &count);
+   fail_unless(count == nunits);
+
+   for (int i = 0; i < nunits; i++) {
+      char buf[16];
+      checked_sprintf(buf, sizeof(buf), "index%d", i);
+
+      ident_t name = ident_new(buf);
+      const lib_mtime_t mtime = lib_mtime(work, name);
+      fail_if(mtime == 0);
+
+      tree_t ent = lib_get(work, name);
+      fail_if(ent == NULL);
+      fail_unless(tree_ident(ent) == name);
+      fail_unless(lib_mtime(work, name) == mtime);
+   }
+
+   fail_unless(lib_get(work, ident_new("index_missing")) == NULL);
+}
+END_TEST
+
+START_TEST(test_lib_lazy)
+{
+   {
+      tree_t ar = tree_new(T_ARCH);
+      tree_set_ident(ar, ident_new("lazy"));
+      tree_set_ident2(ar, ident_new("foo"));
+
+      for (int i = 0; i < 10; i++) {
+         tree_t pr = tree_new(T_PROCESS);
+         tree_set_ident(pr, ident_new("proc"));
+         tree_add_stmt(ar, pr);
+
+         for (int j = 0; j < 5; j++) {
+            tree_t s = tree_new(T_NULL);
+            tree_set_ident(s, ident_new("null"));
+            tree_add_stmt(pr, s);
+
+            // Back reference from the main stream into a segment
+            if (i == 3 && j == 2)
+               tree_add_attr_tree(ar, ident_new("stmt"), s);
+         }
+      }
+
+      lib_put(work, ar);
+   }
+
+   lib_save(work);
+   lib_free(work);
+
+   lib_add_search_path("/tmp");
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   {
+      tree_rd_ctx_t ctx;
+      tree_t ar = lib_get_ctx(work, ident_new("lazy"), &ctx);
+      fail_if(ar == NULL);
+      fail_unless(tree_stmts(ar) == 10);
+
+      tree_gc();
+
+      tree_t s = tree_attr_tree(ar, ident_new("stmt"));
+      fail_if(s == NULL);
+      fail_unless(tree_stmt(tree_stmt(ar, 3), 2) == s);
+
+      for (int i = 0; i < 10; i++) {
+         tree_t pr = tree_stmt(ar, i);
+         fail_unless(tree_stmts(pr) == 5);
+         tree_t last = tree_stmt(pr, 4);
+         fail_unless(tree_kind(last) == T_NULL);
+         fail_unless(tree_read_recall(ctx, tree_index(last)) == last);
+      }
+
+      tree_t pr = tree_stmt(ar, 7);
+      fail_unless(tree_read_recall(ctx, tree_index(pr)) == pr);
+   }
+}
+END_TEST
+
+START_TEST(test_lib_codec)
+{
+   const fbuf_codec_t codecs[] = {
+      FBUF_CODEC_LZ4, FBUF_CODEC_NONE, FBUF_CODEC_FASTLZ
+   };
+
+   fbuf_set_threads(2);
+
+   for (int i = 0; i < ARRAY_LEN(codecs); i++) {
+      fbuf_set_codec(codecs[i]);
+
+      tree_t ent = tree_new(T_ENTITY);
+      tree_set_ident(ent, ident_new("codec"));
+      for (int j = 0; j < 5000; j++) {
+         tree_t p = tree_new(T_PORT_DECL);
+         tree_set_ident(p, ident_uniq("p"));
+         tree_set_subkind(p, PORT_IN);
+         tree_set_type(p, type_universal_int());
+         tree_add_port(ent, p);
+      }
+
+      lib_put(work, ent);
+      lib_save(work);
+      lib_free(work);
+
+      lib_add_search_path("/tmp");
+      work = lib_find(ident_new("test_lib"), false);
+      fail_if(work == NULL);
+
+      ent = lib_get(work, ident_new("codec"));
+      fail_if(ent == NULL);
+      fail_unless(tree_ports(ent) == 5000);
+      fail_unless(tree_subkind(tree_port(ent, 4999)) == PORT_IN);
+   }
+}
+END_TEST
+
+START_TEST(test_lib_arena)
+{
+   // Units read from disk are freed with the library even when some of
+   // their statements have not been loaded yet
+   for (int i = 0; i < 2; i++) {
+      lib_add_search_path("/tmp");
+      work = lib_find(ident_new("test_lib"), false);
+      fail_if(work == NULL);
+
+      tree_t ar = lib_get(work, ident_new("lazy"));
+      fail_if(ar == NULL);
+      fail_unless(tree_stmts(tree_stmt(ar, 2)) == 5);
+
+      tree_gc();
+
+      if (i == 1) {
+         tree_t s = tree_attr_tree(ar, ident_new("stmt"));
+         fail_unless(tree_stmt(tree_stmt(ar, 3), 2) == s);
+      }
+
+      lib_free(work);
+   }
+
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+}
+END_TEST
+
+START_TEST(test_lib_gc)
+{
+   tree_t ent = tree_new(T_ENTITY);
+   tree_set_ident(ent, ident_new("gc_test"));
+
+   tree_gc();
+
+   // Young object only reachable through a write to an old object
+   tree_t p = tree_new(T_PORT_DECL);
+   tree_set_ident(p, ident_new("young"));
+   tree_add_port(ent, p);
+
+   for (int i = 0; i < 100; i++)
+      (void)tree_new(T_PORT_DECL);
+
+   tree_gc();
+
+   for (int i = 0; i < 100; i++)
+      tree_set_ident(tree_new(T_SIGNAL_DECL), ident_new("garbage"));
+
+   fail_unless(tree_port(ent, 0) == p);
+   fail_unless(tree_kind(p) == T_PORT_DECL);
+   fail_unless(tree_ident(p) == ident_new("young"));
+
+   tree_gc();
+
+   fail_unless(tree_ident(tree_port(ent, 0)) == ident_new("young"));
+}
+END_TEST
+
+START_TEST(test_lib_journal)
+{
+   // Each save only appends the units it wrote to the index journal
+   // which must be merged with the index when the library is opened
+   const char *names[] = { "journal1", "journal2" };
+   const unsigned before = lib_index_size(work);
+
+   for (int i = 0; i < ARRAY_LEN(names); i++) {
+      tree_t ent = tree_new(T_ENTITY);
+      tree_set_ident(ent, ident_new(names[i]));
+
+      lib_put(work, ent);
+      lib_save(work);
+      lib_free(work);
+
+      lib_add_search_path("/tmp");
+      work = lib_find(ident_new("test_lib"), false);
+      fail_if(work == NULL);
+   }
+
+   fail_unless(lib_index_size(work) == before + ARRAY_LEN(names));
+
+   for (int i = 0; i < ARRAY_LEN(names); i++) {
+      tree_t ent = lib_get(work, ident_new(names[i]));
+      fail_if(ent == NULL);
+      fail_unless(tree_kind(ent) == T_ENTITY);
+      fail_unless(lib_mtime(work, ident_new(names[i])) != 0);
+   }
+}
+END_TEST
+
+START_TEST(test_lib_varint)
+{
+   // Values either side of each boundary in the variable length integer
+   // encoding must be read back unchanged
+   static const int64_t values[] = {
+      0, 1, -1, 63, -64, 64, -65, 127, 128, 8191, -8192, 8192, -8193,
+      INT32_MAX, INT32_MIN, INT64_MAX, INT64_MIN
+   };
+
+   // Net IDs are stored as deltas which may be negative
+   static const netid_t nets[] = { 100, 3, 70000, 4, 0, UINT32_MAX - 1 };
+
+   {
+      tree_t ent = tree_new(T_ENTITY);
+      tree_set_ident(ent, ident_new("varint"));
+
+      for (int i = 0; i < ARRAY_LEN(values); i++) {
+         char name[16];
+         checked_sprintf(name, sizeof(name), "c%d", i);
+
+         tree_t lit = tree_new(T_LITERAL);
+         tree_set_subkind(lit, L_INT);
+         tree_set_ival(lit, values[i]);
+
+         tree_t c = tree_new(T_CONST_DECL);
+         tree_set_ident(c, ident_new(name));
+         tree_set_type(c, type_universal_int());
+         tree_set_value(c, lit);
+         tree_add_decl(ent, c);
+      }
+
+      tree_t sig = tree_new(T_SIGNAL_DECL);
+      tree_set_ident(sig, ident_new("s"));
+      tree_set_type(sig, type_universal_int());
+      for (int i = 0; i < ARRAY_LEN(nets); i++)
+         tree_add_net(sig, nets[i]);
+      tree_add_decl(ent, sig);
+
+      tree_add_attr_int(ent, ident_new("min"), INT_MIN);
+      tree_add_attr_int(ent, ident_new("max"), INT_MAX);
+
+      lib_put(work, ent);
+   }
+
+   tree_gc();
+
+   lib_save(work);
+   lib_free(work);
+
+   lib_add_search_path("/tmp");
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   tree_t ent = lib_get(work, ident_new("varint"));
+   fail_if(ent == NULL);
+   fail_unless(tree_decls(ent) == ARRAY_LEN(values) + 1);
+
+   for (int i = 0; i < ARRAY_LEN(values); i++) {
+      tree_t lit = tree_value(tree_decl(ent, i));
+      fail_unless(tree_ival(lit) == values[i],
+                  "expected %"PRIi64" have %"PRIi64, values[i],
+                  tree_ival(lit));
+   }
+
+   tree_t sig = tree_decl(ent, ARRAY_LEN(values));
+   fail_unless(tree_nets(sig) == ARRAY_LEN(nets));
+   for (int i = 0; i < ARRAY_LEN(nets); i++)
+      fail_unless(tree_net(sig, i) == nets[i]);
+
+   fail_unless(tree_attr_int(ent, ident_new("min"), 0) == INT_MIN);
+   fail_unless(tree_attr_int(ent, ident_new("max"), 0) == INT_MAX);
+}
+END_TEST
+
 int main(void)
 {
    register_trace_signal_handlers();
@@ -270,6 +582,13 @@ int main(void)
    tcase_add_test(tc_core, test_lib_new);
    tcase_add_test(tc_core, test_lib_fopen);
    tcase_add_test(tc_core, test_lib_save);
+   tcase_add_test(tc_core, test_lib_index);
+   tcase_add_test(tc_core, test_lib_lazy);
+   tcase_add_test(tc_core, test_lib_codec);
+   tcase_add_test(tc_core, test_lib_arena);
+   tcase_add_test(tc_core, test_lib_gc);
+   tcase_add_test(tc_core, test_lib_journal);
+   tcase_add_test(tc_core, test_lib_varint);
    suite_add_tcase(s, tc_core);
 
    SRunner *sr = srunner_create(s);
@@ -2432,6 +2432,137 @@ START_TEST(test_tag)
 }
 END_TEST
 
+START_TEST(test_forward)
+{
+   opt_set_int("optimise", 2);
+
+   vcode_unit_t context = emit_context(ident_new("forward"));
+   emit_process(ident_new("forward.proc"), context);
+
+   vcode_type_t t = vtype_int(0, 100);
+   vcode_var_t v = emit_var(t, t, ident_new("v"), false);
+   vcode_var_t w = emit_var(t, t, ident_new("w"), false);
+
+   vcode_block_t b1 = emit_block();
+   vcode_block_t b2 = emit_block();
+   vcode_block_t b3 = emit_block();
+
+   vcode_reg_t five = emit_const(t, 5);
+   emit_store(five, v);
+   emit_cond(emit_cmp(VCODE_CMP_EQ, emit_load(w), five), b1, b2);
+
+   // Only reachable from block 0 so v is known to be five here
+   vcode_select_block(b1);
+   vcode_reg_t three = emit_const(t, 3);
+   vcode_reg_t sum = emit_add(emit_load(v), three);
+   emit_store(sum, w);
+   vcode_reg_t wval = emit_load(w);
+   emit_store(wval, w);
+   emit_cond(emit_cmp(VCODE_CMP_GT, wval, three), b3, b2);
+
+   vcode_select_block(b2);
+   emit_store(emit_load(v), w);
+   emit_jump(b3);
+
+   vcode_select_block(b3);
+   emit_wait(b3, VCODE_INVALID_REG);
+
+   vcode_opt_forward();
+   vcode_opt();
+
+   EXPECT_BB(0) = {
+      { VCODE_OP_CONST, .value = 5 },
+      { VCODE_OP_STORE, .name = "v" },
+      { VCODE_OP_LOAD, .name = "w" },
+      { VCODE_OP_CMP, .cmp = VCODE_CMP_EQ },
+      { VCODE_OP_COND, .target = 1, .target_else = 2 },
+   };
+
+   CHECK_BB(0);
+
+   EXPECT_BB(1) = {
+      { VCODE_OP_CONST, .value = 8 },
+      { VCODE_OP_STORE, .name = "w" },
+      { VCODE_OP_JUMP, .target = 3 },
+   };
+
+   CHECK_BB(1);
+
+   EXPECT_BB(2) = {
+      { VCODE_OP_LOAD, .name = "v" },
+      { VCODE_OP_STORE, .name = "w" },
+      { VCODE_OP_JUMP, .target = 3 },
+   };
+
+   CHECK_BB(2);
+
+   vcode_close();
+}
+END_TEST
+
+START_TEST(test_checks)
+{
+   opt_set_int("optimise", 2);
+
+   vcode_unit_t context = emit_context(ident_new("checks"));
+   emit_process(ident_new("checks.proc"), context);
+
+   vcode_type_t t = vtype_int(0, 1000);
+   vcode_var_t x = emit_var(t, t, ident_new("x"), false);
+   vcode_var_t y = emit_var(t, t, ident_new("y"), false);
+
+   vcode_block_t b1 = emit_block();
+   vcode_block_t b2 = emit_block();
+   vcode_block_t b3 = emit_block();
+   vcode_block_t b4 = emit_block();
+
+   vcode_reg_t xval = emit_load(x);
+   vcode_reg_t yval = emit_load(y);
+   emit_bounds(xval, vtype_int(0, 10), BOUNDS_INDEX_TO, 0, 0);
+   emit_dynamic_bounds(xval, yval, emit_const(t, 50),
+                       emit_const(vtype_offset(), 0), 0, 0);
+   emit_cond(emit_cmp(VCODE_CMP_EQ, xval, yval), b1, b2);
+
+   vcode_select_block(b1);
+   emit_store(emit_const(t, 1), x);
+   emit_jump(b3);
+
+   vcode_select_block(b2);
+   emit_jump(b3);
+
+   // Block 0 dominates this block so its checks have already passed but
+   // the value of x is no longer known
+   vcode_select_block(b3);
+   emit_bounds(xval, vtype_int(0, 20), BOUNDS_INDEX_TO, 0, 0);
+   emit_bounds(xval, vtype_int(5, 20), BOUNDS_INDEX_TO, 0, 0);
+   emit_dynamic_bounds(xval, yval, emit_const(t, 50),
+                       emit_const(vtype_offset(), 0), 0, 0);
+   emit_store(emit_load(x), y);
+   emit_wait(b4, VCODE_INVALID_REG);
+
+   vcode_select_block(b4);
+   emit_wait(b4, VCODE_INVALID_REG);
+
+   const unsigned before = vcode_elided_checks();
+
+   vcode_opt_forward();
+   vcode_opt();
+
+   fail_unless(vcode_elided_checks() == before + 2);
+
+   EXPECT_BB(3) = {
+      { VCODE_OP_BOUNDS, .low = 5, .high = 20 },
+      { VCODE_OP_LOAD, .name = "x" },
+      { VCODE_OP_STORE, .name = "y" },
+      { VCODE_OP_WAIT, .target = 4 },
+   };
+
+   CHECK_BB(3);
+
+   vcode_close();
+}
+END_TEST
+
 int main(void)
 {
    Suite *s = suite_create("lower");
@@ -2488,6 +2619,8 @@ int main(void)
    tcase_add_test(tc, test_issue215);
    tcase_add_test(tc, test_choice1);
    tcase_add_test(tc, test_tag);
+   tcase_add_test(tc, test_forward);
+   tcase_add_test(tc, test_checks);
    suite_add_tcase(s, tc);
 
    return nvc_run_test(s);
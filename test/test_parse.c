@@ -2625,6 +2625,79 @@ START_TEST(test_issue222)
 }
 END_TEST
 
+static loc_t column_error_loc;
+static int   column_nerrors;
+
+static void column_error_fn(const char *msg, const loc_t *loc)
+{
+   if (column_nerrors++ == 0)
+      column_error_loc = *loc;
+}
+
+START_TEST(test_column)
+{
+   tree_t a, s, v;
+   const loc_t *l;
+
+   input_from_file(TESTDIR "/parse/column.vhd");
+
+   a = parse();
+   fail_if(a == NULL);
+   fail_unless(tree_kind(a) == T_ARCH);
+
+   // A tab counts as a single column
+   s = tree_stmt(a, 0);
+   l = tree_loc(s);
+   fail_unless(l->first_line == 3);
+   fail_unless(l->first_column == 1);
+
+   v = tree_value(tree_waveform(tree_cond(s, 0), 0));
+   fail_unless(tree_kind(v) == T_QUALIFIED);
+   fail_unless(tree_kind(tree_value(v)) == T_REF);
+   fail_unless(tree_ident(tree_value(v)) == ident_new("'1'"));
+
+   // Tokens after a qualified expression are not shifted
+   s = tree_stmt(a, 1);
+   l = tree_loc(s);
+   fail_unless(l->first_line == 3);
+   fail_unless(l->first_column == 17);
+
+   v = tree_value(tree_waveform(tree_cond(s, 0), 0));
+   l = tree_loc(v);
+   fail_unless(l->first_column == 22);
+   fail_unless(l->last_column == 22);
+
+   s = tree_stmt(a, 2);
+   v = tree_value(tree_waveform(tree_cond(s, 0), 0));
+   l = tree_loc(v);
+   fail_unless(l->first_line == 4);
+   fail_unless(l->first_column == 9);
+   fail_unless(l->last_column == 75);
+
+   s = tree_stmt(a, 3);
+   l = tree_loc(s);
+   fail_unless(l->first_line == 4);
+   fail_unless(l->first_column == 37);
+
+   v = tree_value(tree_waveform(tree_cond(s, 0), 0));
+   l = tree_loc(v);
+   fail_unless(l->first_column == 83);
+
+   error_fn_t prev = set_error_fn(column_error_fn, false);
+   column_nerrors = 0;
+
+   while (parse() != NULL)
+      ;
+
+   set_error_fn(prev, false);
+
+   fail_unless(column_nerrors > 0);
+   fail_unless(column_error_loc.first_line == 9);
+   fail_unless(column_error_loc.first_column == 75);
+   fail_unless(column_error_loc.last_column == 75);
+}
+END_TEST
+
 int main(void)
 {
    Suite *s = suite_create("parse");
@@ -2665,6 +2738,7 @@ int main(void)
    tcase_add_test(tc_core, test_issue205);
    tcase_add_test(tc_core, test_context);
    tcase_add_test(tc_core, test_issue222);
+   tcase_add_test(tc_core, test_column);
    suite_add_tcase(s, tc_core);
 
    return nvc_run_test(s);
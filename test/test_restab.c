@@ -0,0 +1,93 @@
+#include "rt/restab.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void random_table(restab2_t tab2, restab1_t tab1, int nlits)
+{
+   for (int i = 0; i < nlits; i++) {
+      tab1[i] = random() % nlits;
+      for (int j = 0; j < nlits; j++)
+         tab2[i][j] = random() % nlits;
+   }
+}
+
+static void random_values(int8_t *v, int nlits, size_t n)
+{
+   for (size_t i = 0; i < n; i++)
+      v[i] = random() % nlits;
+}
+
+START_TEST(test_map)
+{
+   restab2_t tab2;
+   restab1_t tab1;
+
+   for (int nlits = 2; nlits <= 16; nlits++) {
+      random_table(tab2, tab1, nlits);
+
+      for (size_t n = 0; n < 200; n += 1 + (n / 8)) {
+         int8_t in[n + 1], out[n + 1];
+         random_values(in, nlits, n);
+         out[n] = 0x55;
+
+         restab_map(tab1, out, in, n);
+
+         for (size_t i = 0; i < n; i++)
+            fail_unless(out[i] == tab1[(int)in[i]]);
+         fail_unless(out[n] == 0x55);
+      }
+   }
+}
+END_TEST
+
+START_TEST(test_fold)
+{
+   restab2_t tab2;
+   restab1_t tab1;
+
+   for (int nlits = 2; nlits <= 16; nlits++) {
+      random_table(tab2, tab1, nlits);
+
+      for (size_t n = 0; n < 200; n += 1 + (n / 8)) {
+         int8_t a[n + 1], b[n + 1], out[n + 1];
+         random_values(a, nlits, n);
+         random_values(b, nlits, n);
+         out[n] = 0x55;
+
+         restab_fold(tab2, nlits, out, a, b, n);
+
+         for (size_t i = 0; i < n; i++)
+            fail_unless(out[i] == tab2[(int)a[i]][(int)b[i]]);
+         fail_unless(out[n] == 0x55);
+
+         // The output may alias the first input
+         restab_fold(tab2, nlits, a, a, b, n);
+         fail_unless(memcmp(a, out, n) == 0);
+      }
+   }
+}
+END_TEST
+
+int main(void)
+{
+   srandom((unsigned)time(NULL));
+
+   Suite *s = suite_create("restab");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_test(tc_core, test_map);
+   tcase_add_test(tc_core, test_fold);
+   suite_add_tcase(s, tc_core);
+
+   SRunner *sr = srunner_create(s);
+   srunner_run_all(sr, CK_NORMAL);
+
+   int nfail = srunner_ntests_failed(sr);
+
+   srunner_free(sr);
+
+   return nfail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1683,6 +1683,41 @@ START_TEST(test_issue293)
 }
 END_TEST
 
+START_TEST(test_overload)
+{
+   input_from_file(TESTDIR "/sem/overload.vhd");
+
+   const error_t expect[] = {
+      { 20, "no matching function F" },
+      { 37, "no matching function F" },
+      { -1, NULL }
+   };
+   expect_errors(expect);
+
+   parse_and_check(T_ENTITY, T_ARCH);
+
+   fail_unless(sem_errors() == ARRAY_LEN(expect) - 1);
+}
+END_TEST
+
+START_TEST(test_shadow)
+{
+   input_from_file(TESTDIR "/sem/shadow.vhd");
+
+   const error_t expect[] = {
+      { 17, "type of value T2 does not match type of target T1" },
+      { 25, "type of value T1 does not match type of target T2" },
+      { 39, "type of value T1 does not match type of target T2" },
+      { -1, NULL }
+   };
+   expect_errors(expect);
+
+   parse_and_check(T_ENTITY, T_ARCH);
+
+   fail_unless(sem_errors() == ARRAY_LEN(expect) - 1);
+}
+END_TEST
+
 int main(void)
 {
    Suite *s = suite_create("sem");
@@ -1767,6 +1802,8 @@ int main(void)
    tcase_add_test(tc_core, test_dwlau);
    tcase_add_test(tc_core, test_jcore1);
    tcase_add_test(tc_core, test_issue293);
+   tcase_add_test(tc_core, test_overload);
+   tcase_add_test(tc_core, test_shadow);
    suite_add_tcase(s, tc_core);
 
    return nvc_run_test(s);
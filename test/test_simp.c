@@ -292,6 +292,14 @@ START_TEST(test_ffold)
    fail_unless(folded_i(tree_value(tree_decl(a, 11)), 5));
    fail_unless(folded_i(tree_value(tree_decl(a, 12)), 10));
    fail_unless(folded_b(tree_value(tree_decl(a, 13)), true));
+   fail_unless(folded_i(tree_value(tree_decl(a, 16)), 720));
+   fail_unless(folded_i(tree_value(tree_decl(a, 17)), 5));
+
+   tree_t table = tree_value(tree_decl(a, 20));
+   fail_unless(tree_kind(table) == T_AGGREGATE);
+   fail_unless(tree_assocs(table) == 8);
+   for (int i = 0; i < 8; i++)
+      fail_unless(folded_i(tree_value(tree_assoc(table, i)), i * i));
 }
 END_TEST
 
@@ -39,12 +39,16 @@ static void setup(void)
    lib_set_work(lib_tmp("work"));
    opt_set_int("bootstrap", 0);
    opt_set_int("cover", 0);
+   opt_set_int("prune", 0);
+   opt_set_int("fuse", 0);
    opt_set_int("unit-test", 1);
    opt_set_int("prefer-explicit", 0);
    opt_set_str("dump-vcode", NULL);
    opt_set_int("relax", 0);
    opt_set_int("ignore-time", 0);
    opt_set_int("verbose", 0);
+   opt_set_int("native", 0);
+   opt_set_int("optimise", 0);
    intern_strings();
 }
 
@@ -71,6 +71,21 @@ static void start_of_sim(const vhpiCbDataT *cb_data)
    check_error();
    fail_unless(phys_to_i64(weight_right) == 4000);
 
+   vhpiHandleT handle_x2 = vhpi_handle_by_index(vhpiSigDecls, root, 0);
+   check_error();
+   fail_unless(handle_x2 == handle_x);
+   vhpi_release_handle(handle_x2);
+
+   int nsigs = 0;
+   vhpiHandleT it = vhpi_iterator(vhpiSigDecls, root);
+   check_error();
+   for (vhpiHandleT h = vhpi_scan(it); h != NULL; h = vhpi_scan(it)) {
+      fail_unless(h == handle_x);
+      vhpi_release_handle(h);
+      nsigs++;
+   }
+   fail_unless(nsigs == 1);
+
    vhpi_release_handle(handle_weight_cons);
    vhpi_release_handle(handle_weight_type);
    vhpi_release_handle(handle_x);
@@ -0,0 +1,128 @@
+#include "vhpi_user.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define fail_if(x)                                                      \
+   if (x) vhpi_assert(vhpiFailure, "assertion '%s' failed at %s:%d",    \
+                      #x, __FILE__, __LINE__)
+#define fail_unless(x) fail_if(!(x))
+
+static vhpiHandleT handle_ab;
+static vhpiHandleT handle_c;
+static size_t      offsets[3];
+static int         ncalls = 0;
+
+static void check_error(void)
+{
+   vhpiErrorInfoT info;
+   if (vhpi_check_error(&info))
+      vhpi_assert(vhpiFailure, "unexpected error '%s'", info.message);
+}
+
+static void set_changed(vhpiHandleT set, const vhpiValueT *changed,
+                        void *user_data)
+{
+   vhpiTimeT now;
+   vhpi_get_time(&now, NULL);
+
+   const int step = now.low / 1000000;
+   vhpi_printf("set_changed at %d ns", step);
+
+   fail_unless(set == handle_ab);
+   fail_unless(user_data == &ncalls);
+   fail_unless(step == ++ncalls);
+
+   fail_unless(VHPI_SENS_ISSET(0, (vhpiValueT *)changed) == 1);
+   fail_unless(VHPI_SENS_ISSET(1, (vhpiValueT *)changed) == (step % 2 == 0));
+   fail_unless(VHPI_SENS_FIRST((vhpiValueT *)changed) == 0);
+
+   unsigned char buf[64];
+   fail_unless(vhpi_get_set_values(set, buf, sizeof(buf)) == 0);
+   check_error();
+
+   for (size_t i = offsets[0]; i < offsets[1]; i++)
+      fail_unless(buf[i] == step % 2);
+
+   int32_t b;
+   memcpy(&b, buf + offsets[1], sizeof(int32_t));
+   fail_unless(b == step / 2);
+}
+
+static void end_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("end_of_sim");
+
+   fail_unless(ncalls == 5);
+
+   vhpi_release_handle(handle_ab);
+   vhpi_release_handle(handle_c);
+}
+
+static void start_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("start_of_sim");
+
+   vhpiHandleT root = vhpi_handle(vhpiRootInst, NULL);
+   check_error();
+   fail_if(root == NULL);
+
+   vhpiHandleT members[3];
+   members[0] = vhpi_handle_by_name("a", root);
+   check_error();
+   members[1] = vhpi_handle_by_name("b", root);
+   check_error();
+   members[2] = vhpi_handle_by_name("c", root);
+   check_error();
+
+   handle_ab = vhpi_create_set(members, 2, offsets);
+   check_error();
+   fail_if(handle_ab == NULL);
+   fail_unless(offsets[0] == 0);
+   fail_unless(offsets[1] == 8);
+   fail_unless(offsets[2] == offsets[1] + sizeof(int32_t));
+
+   vhpi_register_set_cb(handle_ab, set_changed, &ncalls);
+   check_error();
+
+   handle_c = vhpi_create_set(members + 2, 1, NULL);
+   check_error();
+
+   unsigned char small[4];
+   fail_unless(vhpi_get_set_values(handle_ab, small, sizeof(small)) == 1);
+
+   vhpiErrorInfoT info;
+   fail_unless(vhpi_check_error(&info));
+
+   const unsigned char one = 1;
+   vhpi_put_set_values(handle_c, &one, sizeof(one), vhpiForcePropagate);
+   check_error();
+
+   for (int i = 0; i < 3; i++)
+      vhpi_release_handle(members[i]);
+   vhpi_release_handle(root);
+}
+
+static void startup()
+{
+   vhpiCbDataT cb_data1 = {
+      .reason = vhpiCbStartOfSimulation,
+      .cb_rtn = start_of_sim,
+   };
+   vhpi_register_cb(&cb_data1, 0);
+   check_error();
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbEndOfSimulation,
+      .cb_rtn = end_of_sim,
+   };
+   vhpi_register_cb(&cb_data2, 0);
+   check_error();
+}
+
+void (*vhpi_startup_routines[])() = {
+   startup,
+   NULL
+};
@@ -0,0 +1,106 @@
+#include "vhpi_user.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define fail_if(x)                                                      \
+   if (x) vhpi_assert(vhpiFailure, "assertion '%s' failed at %s:%d",    \
+                      #x, __FILE__, __LINE__)
+#define fail_unless(x) fail_if(!(x))
+
+#define NEVENTS 50
+
+static vhpiHandleT handle_x;
+static vhpiValueT  x_value = { .format = vhpiIntVal };
+static int         ncalls = 0;
+static int32_t     values[NEVENTS];
+static uint32_t    times[NEVENTS];
+
+static void check_error(void)
+{
+   vhpiErrorInfoT info;
+   if (vhpi_check_error(&info))
+      vhpi_assert(vhpiFailure, "unexpected error '%s'", info.message);
+}
+
+static void x_value_change(const vhpiCbDataT *cb_data)
+{
+   // Runs on the dispatch thread so must not call into VHPI: just
+   // record what was seen and check it at the end of simulation
+
+   if (ncalls == NEVENTS) {
+      ncalls++;
+      return;
+   }
+
+   values[ncalls] = cb_data->value ? cb_data->value->value.intg : -1;
+   times[ncalls]  = cb_data->time->low;
+
+   // Slow enough that the kernel fills the queue and has to wait
+   usleep(100);
+
+   ncalls++;
+}
+
+static void end_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("end_of_sim");
+
+   // All asynchronous callbacks should have finished by now
+   fail_unless(ncalls == NEVENTS);
+
+   for (int i = 0; i < NEVENTS; i++) {
+      fail_unless(values[i] == i + 1);
+      fail_unless(times[i] == (i + 1) * 1000000);
+   }
+
+   vhpi_release_handle(handle_x);
+}
+
+static void start_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("start_of_sim");
+
+   vhpiHandleT root = vhpi_handle(vhpiRootInst, NULL);
+   check_error();
+   fail_if(root == NULL);
+
+   handle_x = vhpi_handle_by_name("x", root);
+   check_error();
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbValueChange,
+      .cb_rtn = x_value_change,
+      .obj    = handle_x,
+      .value  = &x_value
+   };
+   vhpi_register_cb(&cb_data2, vhpiAsyncCb);
+   check_error();
+
+   vhpi_release_handle(root);
+}
+
+static void startup()
+{
+   vhpiCbDataT cb_data1 = {
+      .reason = vhpiCbStartOfSimulation,
+      .cb_rtn = start_of_sim,
+   };
+   vhpi_register_cb(&cb_data1, 0);
+   check_error();
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbEndOfSimulation,
+      .cb_rtn = end_of_sim,
+   };
+   vhpi_register_cb(&cb_data2, 0);
+   check_error();
+}
+
+void (*vhpi_startup_routines[])() = {
+   startup,
+   NULL
+};
@@ -0,0 +1,113 @@
+#!/bin/sh
+#
+# Run the designs in test/perf as benchmarks and print the results as
+# JSON. Must be run from the build directory after the standard
+# libraries are built, for example
+#
+#   make bench BENCH_RUNS=5 > results.json
+#   ../tools/bench.sh clocked memory
+#
+# Each benchmark is analysed, elaborated, and run BENCH_RUNS times and
+# the fastest time of each step is reported together with the peak
+# resident set size and counters from the last run.
+#
+
+runs=${BENCH_RUNS:-3}
+build=$(pwd)
+srcdir=$(cd "$(dirname "$0")/.." && pwd)/test/perf
+nvc="$build/bin/nvc"
+
+export NVC_LIBPATH="$build/lib"
+
+if [ ! -x "$nvc" ]; then
+  echo "$nvc not found: run from the build directory" 1>&2
+  exit 1
+fi
+
+benches="$*"
+if [ -z "$benches" ]; then
+  benches=$(cd $srcdir && ls *.vhd | sed 's/\.vhd$//')
+fi
+
+work=$(mktemp -d ${TMPDIR:-/tmp}/nvc-bench.XXXXXX)
+trap 'rm -rf $work' EXIT
+
+now_ms () {
+  echo $(($(date +%s%N) / 1000000))
+}
+
+# Extract an integer field from the --stats=json output
+stat () {
+  sed -n "s/^ *\"$1\": \([0-9]*\).*/\1/p" $work/stats.json | head -1
+}
+
+min () {
+  [ -z "$1" ] && echo $2 && return
+  [ "$2" -lt "$1" ] && echo $2 || echo $1
+}
+
+run_opts () {
+  case $1 in
+    wavedump) echo "--wave=$work/wave.fst" ;;
+    *) ;;
+  esac
+}
+
+echo "["
+first=yes
+for b in $benches; do
+  if [ ! -f $srcdir/$b.vhd ]; then
+    echo "no benchmark $b" 1>&2
+    exit 1
+  fi
+
+  best_a= ; best_e= ; best_r= ; rss=0
+
+  i=0
+  while [ $i -lt $runs ]; do
+    i=$((i + 1))
+    rm -rf $work/work
+
+    t0=$(now_ms)
+    (cd $work && $nvc -a $srcdir/$b.vhd) 1>&2 || exit 1
+    t1=$(now_ms)
+    (cd $work && $nvc -e --native --no-cache $b) 1>&2 || exit 1
+    t2=$(now_ms)
+    (cd $work && $nvc -r --stats=json $(run_opts $b) $b) \
+      > $work/run.out || exit 1
+    t3=$(now_ms)
+
+    # Only the statistics follow the opening brace
+    sed -n '/^{$/,$p' $work/run.out > $work/stats.json
+
+    best_a=$(min "$best_a" $((t1 - t0)))
+    best_e=$(min "$best_e" $((t2 - t1)))
+    best_r=$(min "$best_r" $(stat run_ms))
+
+    r=$(stat maxrss_kb)
+    [ "$r" -gt "$rss" ] && rss=$r
+  done
+
+  events=$(stat events)
+  deltas=$(sed -n 's/^ *"deltas_per_step": { "count": [0-9]*, "sum": \([0-9]*\).*/\1/p' \
+             $work/stats.json)
+
+  [ $first = yes ] || echo "  ,"
+  first=no
+
+  cat <<EOF
+  {
+    "name": "$b",
+    "runs": $runs,
+    "analyse_ms": $best_a,
+    "elab_ms": $best_e,
+    "run_ms": $best_r,
+    "maxrss_kb": $rss,
+    "transactions": $(stat transactions),
+    "events": $events,
+    "events_per_sec": $((events * 1000 / (best_r > 0 ? best_r : 1))),
+    "delta_cycles": ${deltas:-0}
+  }
+EOF
+done
+echo "]"